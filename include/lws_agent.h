@@ -19,6 +19,7 @@
 #include "lws_defs.h"
 #include "lws_trans.h"
 #include "lws_dev.h"
+#include "lws_loc.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -160,6 +161,9 @@ typedef void (*lws_agent_on_dialog_state_changed_f)(
 
 /**
  * @brief 收到远端SDP回调
+ *
+ * 初始应答时触发；会话中re-INVITE/UPDATE引起媒体变化时也会再次触发。
+ *
  * @param agent Agent实例
  * @param dialog Dialog实例
  * @param sdp 远端SDP字符串
@@ -172,6 +176,66 @@ typedef void (*lws_agent_on_remote_sdp_f)(
     void* userdata
 );
 
+/**
+ * @brief 收到MESSAGE回调（RFC 3428）
+ *
+ * 设置该回调后agent自动回复200，未设置时回复405。
+ *
+ * @param agent Agent实例
+ * @param from 发送方地址
+ * @param content_type Content-Type（缺省为"text/plain"）
+ * @param body 消息体（可能不以'\0'结尾）
+ * @param len 消息体长度
+ * @param userdata 用户数据
+ */
+typedef void (*lws_agent_on_message_f)(
+    lws_agent_t* agent,
+    const lws_sip_addr_t* from,
+    const char* content_type,
+    const void* body,
+    int len,
+    void* userdata
+);
+
+/**
+ * @brief MESSAGE投递结果回调
+ *
+ * 每个lws_agent_send_message()返回的ID恰好回调一次。
+ *
+ * @param agent Agent实例
+ * @param msg_id 消息ID
+ * @param status_code SIP最终响应码（2xx为投递成功，408为超时）
+ * @param latency_us 发出请求到收到最终响应的时延（微秒）
+ * @param userdata 用户数据
+ */
+typedef void (*lws_agent_on_message_result_f)(
+    lws_agent_t* agent,
+    uint32_t msg_id,
+    int status_code,
+    uint32_t latency_us,
+    void* userdata
+);
+
+/**
+ * @brief 收到DTMF回调
+ *
+ * RFC 4733 telephone-event与SIP INFO（application/dtmf-relay）两种方式
+ * 收到的按键都通过此回调通知。
+ *
+ * @param agent Agent实例
+ * @param dialog Dialog实例
+ * @param digit 按键（'0'-'9', '*', '#', 'A'-'D'）
+ * @param duration_ms 按键时长（毫秒）
+ * @param userdata 用户数据
+ */
+typedef void (*lws_agent_on_dtmf_f)(
+    lws_agent_t* agent,
+    lws_dialog_t* dialog,
+    char digit,
+    int duration_ms,
+    void* userdata
+);
+
 /**
  * @brief Agent错误回调
  * @param agent Agent实例
@@ -186,6 +250,28 @@ typedef void (*lws_agent_on_error_f)(
     void* userdata
 );
 
+/**
+ * @brief Registrar鉴权回调（内嵌registrar模式）
+ *
+ * 收到带Authorization的REGISTER时调用，由应用提供用户密码。
+ *
+ * @param agent Agent实例
+ * @param username 用户名
+ * @param realm Realm
+ * @param password 输出密码
+ * @param size 密码缓冲区大小
+ * @param userdata 用户数据
+ * @return 0用户存在，-1用户不存在
+ */
+typedef int (*lws_agent_on_registrar_auth_f)(
+    lws_agent_t* agent,
+    const char* username,
+    const char* realm,
+    char* password,
+    size_t size,
+    void* userdata
+);
+
 /**
  * @brief Agent事件回调集合
  */
@@ -195,7 +281,11 @@ typedef struct {
     lws_agent_on_incoming_call_f on_incoming_call;         /**< 来电回调 */
     lws_agent_on_dialog_state_changed_f on_dialog_state_changed; /**< Dialog状态变化回调 */
     lws_agent_on_remote_sdp_f on_remote_sdp;               /**< 远端SDP回调 */
+    lws_agent_on_message_f on_message;                     /**< 收到MESSAGE回调（NULL=回复405） */
+    lws_agent_on_message_result_f on_message_result;       /**< MESSAGE投递结果回调 */
+    lws_agent_on_dtmf_f on_dtmf;                           /**< 收到DTMF回调 */
     lws_agent_on_error_f on_error;                         /**< 错误回调 */
+    lws_agent_on_registrar_auth_f on_registrar_auth;       /**< Registrar鉴权回调（NULL=不鉴权） */
     void* userdata;                                         /**< 用户数据 */
 } lws_agent_handler_t;
 
@@ -223,6 +313,24 @@ typedef struct {
 
     /* User-Agent */
     char user_agent[LWS_MAX_USER_AGENT_LEN];    /**< User-Agent字符串 */
+
+    /* 内嵌Registrar */
+    int enable_registrar;                       /**< 启用内嵌registrar（处理REGISTER，否则回复405） */
+    char registrar_realm[LWS_MAX_REALM_LEN];    /**< Digest realm（空=domain） */
+    int registrar_max_expires;                  /**< 最大注册有效期（秒，0=3600） */
+    uint32_t registrar_capacity;                /**< 预期AOR数量（0=默认） */
+
+    /* 媒体 */
+    int media_socket_pool;                      /**< 预绑定RTP socket数量（0=不使用池，默认4） */
+    int enable_dtx;                             /**< 静音时停止发送音频（VAD/DTX，对端须接受CN） */
+    int enable_voice_proc;                      /**< 启用内置回声消除、降噪和AGC */
+    int enable_ice;                             /**< offer/answer携带ICE候选并做连通性检查 */
+    char stun_server[LWS_MAX_HOSTNAME_LEN];     /**< STUN服务器（"host[:port]"，空=仅host候选） */
+    int trickle_ice;                            /**< 先发SDP，后续候选经SIP INFO（application/sdpfrag）发送 */
+    int ice_lite;                               /**< ICE-lite（公网媒体服务器），隐含enable_ice */
+
+    /* MESSAGE */
+    int message_window;                         /**< 最大在途MESSAGE数量（0=64） */
 } lws_agent_config_t;
 
 /* ========================================
@@ -352,6 +460,49 @@ int lws_agent_hangup(
     lws_dialog_t* dialog
 );
 
+/**
+ * @brief 保持呼叫（re-INVITE，a=sendonly）
+ *
+ * 复用已有媒体会话：socket、编码器状态不变，仅停止接收远端媒体；
+ * 远端拒绝时自动恢复原方向。
+ *
+ * @param agent Agent实例
+ * @param dialog Dialog实例（须为CONFIRMED状态）
+ * @return 0成功，LWS_EBUSY已有re-INVITE/UPDATE进行中，其他为错误码
+ */
+int lws_agent_hold(
+    lws_agent_t* agent,
+    lws_dialog_t* dialog
+);
+
+/**
+ * @brief 恢复被保持的呼叫（re-INVITE，a=sendrecv）
+ * @param agent Agent实例
+ * @param dialog Dialog实例（须为CONFIRMED状态）
+ * @return 0成功，LWS_EBUSY已有re-INVITE/UPDATE进行中，其他为错误码
+ */
+int lws_agent_resume(
+    lws_agent_t* agent,
+    lws_dialog_t* dialog
+);
+
+/**
+ * @brief 以媒体会话当前的本地SDP重新发起offer
+ *
+ * 应答通过lws_sess_update_remote_sdp增量应用到已有媒体会话，
+ * 变化时触发on_remote_sdp回调。收到491时按RFC 3261 §14.1自动延迟重试。
+ *
+ * @param agent Agent实例
+ * @param dialog Dialog实例（须为CONFIRMED状态）
+ * @param use_update 非0使用UPDATE (RFC 3311)，0使用re-INVITE
+ * @return 0成功，LWS_EBUSY已有re-INVITE/UPDATE进行中，其他为错误码
+ */
+int lws_agent_reoffer(
+    lws_agent_t* agent,
+    lws_dialog_t* dialog,
+    int use_update
+);
+
 /**
  * @brief 取消呼叫（CANCEL）
  * @param agent Agent实例
@@ -363,6 +514,57 @@ int lws_agent_cancel_call(
     lws_dialog_t* dialog
 );
 
+/**
+ * @brief 发送DTMF
+ *
+ * 协商了telephone-event时按RFC 4733在媒体流中发送，否则逐个按键发送
+ * SIP INFO（application/dtmf-relay）。
+ *
+ * @param agent Agent实例
+ * @param dialog Dialog实例（需已建立）
+ * @param digits 按键序列（'0'-'9', '*', '#', 'A'-'D'）
+ * @param duration_ms 每个按键的时长（毫秒，<=0使用默认100ms）
+ * @return 0成功，<0错误码
+ */
+int lws_agent_send_dtmf(
+    lws_agent_t* agent,
+    lws_dialog_t* dialog,
+    const char* digits,
+    int duration_ms
+);
+
+/* ========================================
+ * MESSAGE API (RFC 3428)
+ * ======================================== */
+
+/**
+ * @brief 发送SIP MESSAGE
+ *
+ * 非阻塞：在途MESSAGE未达到message_window时立即发送，否则复制后排队，
+ * 在收到响应腾出窗口时按顺序发出。结果通过on_message_result回调。
+ *
+ * @param agent Agent实例
+ * @param target_uri 目标URI（"sip:user@domain"或用户名）
+ * @param content_type Content-Type（NULL="text/plain"）
+ * @param body 消息体
+ * @param len 消息体长度
+ * @return >0消息ID，<0错误码
+ */
+int lws_agent_send_message(
+    lws_agent_t* agent,
+    const char* target_uri,
+    const char* content_type,
+    const void* body,
+    int len
+);
+
+/**
+ * @brief 获取未完成的MESSAGE数量（在途+排队）
+ * @param agent Agent实例
+ * @return 消息数量，<0错误码
+ */
+int lws_agent_get_message_pending(lws_agent_t* agent);
+
 /* ========================================
  * Dialog查询API
  * ======================================== */
@@ -437,6 +639,37 @@ int lws_agent_get_dialogs(
     int max_count
 );
 
+/* ========================================
+ * Registrar API
+ * ======================================== */
+
+/**
+ * @brief 查询AOR已注册的Contact（内嵌registrar模式）
+ *
+ * 发往本域用户的INVITE会自动路由到第一个有效Contact，
+ * 应用也可以用此接口实现并行/顺序振铃。
+ *
+ * @param agent Agent实例
+ * @param aor AOR（格式："sip:user@domain"）
+ * @param contacts 输出Contact数组
+ * @param max_count 数组大小
+ * @return 有效Contact数量
+ */
+int lws_agent_lookup_contacts(
+    lws_agent_t* agent,
+    const char* aor,
+    lws_loc_contact_t* contacts,
+    int max_count
+);
+
+/**
+ * @brief 获取registrar统计（绑定数量、每绑定内存占用）
+ * @param agent Agent实例
+ * @param stats 输出统计
+ * @return 0成功，-1未启用registrar
+ */
+int lws_agent_get_registrar_stats(lws_agent_t* agent, lws_loc_stats_t* stats);
+
 /* ========================================
  * 辅助函数
  * ======================================== */
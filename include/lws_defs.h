@@ -46,6 +46,7 @@ extern "C" {
 #define LWS_MAX_CALL_ID_LEN     128     /**< Call-ID最大长度 */
 #define LWS_MAX_TAG_LEN         64      /**< Tag最大长度 */
 #define LWS_MAX_URI_LEN         512     /**< SIP URI最大长度 */
+#define LWS_MAX_CONTENT_TYPE_LEN 128    /**< Content-Type最大长度 */
 
 #define LWS_DEFAULT_REGISTER_EXPIRES  3600  /**< 默认注册过期时间(秒) */
 
@@ -63,6 +64,8 @@ extern "C" {
 
 #define LWS_DEFAULT_STUN_PORT   3478    /**< STUN默认端口 */
 #define LWS_DEFAULT_TURN_PORT   3478    /**< TURN默认端口 */
+#define LWS_MAX_STUN_SERVERS    4       /**< 并行查询的STUN服务器数量上限 */
+#define LWS_DEFAULT_ICE_GATHER_TIMEOUT_MS 3000 /**< ICE收集默认截止时间(毫秒) */
 
 /* ========================================
  * MQTT相关常量
@@ -79,6 +82,8 @@ extern "C" {
 #define LWS_MAX_DEV_NAME_LEN    64      /**< 设备名称最大长度 */
 #define LWS_MAX_DEV_ID_LEN      128     /**< 设备ID最大长度 */
 #define LWS_MAX_CODEC_NAME_LEN  32      /**< 编解码名称最大长度 */
+#define LWS_MAX_CODECS          8       /**< 每路媒体最大编解码数量 */
+#define LWS_MAX_FMTP_LEN        256     /**< a=fmtp参数最大长度（含H.264 sprop-parameter-sets） */
 
 /* 音频相关 */
 #define LWS_DEFAULT_SAMPLE_RATE     8000    /**< 默认采样率 */
@@ -86,6 +91,7 @@ extern "C" {
 #define LWS_DEFAULT_FRAME_DURATION  20      /**< 默认帧时长(毫秒) */
 #define LWS_MAX_AUDIO_FRAME_SIZE    1024    /**< 最大音频帧大小(采样数) */
 #define LWS_MAX_AUDIO_SAMPLES_20MS  960     /**< 20ms最大采样数 (48kHz) */
+#define LWS_DEFAULT_RECORD_QUEUE_MS 500     /**< 默认录音队列时长(毫秒)，写入跟不上时超出部分丢弃 */
 
 /* 视频相关 */
 #define LWS_DEFAULT_VIDEO_WIDTH     640     /**< 默认视频宽度 */
@@ -57,7 +57,8 @@ typedef enum {
     LWS_AUDIO_FMT_PCM_S16LE,    /**< PCM signed 16-bit little-endian */
     LWS_AUDIO_FMT_PCM_S16BE,    /**< PCM signed 16-bit big-endian */
     LWS_AUDIO_FMT_PCMU,         /**< G.711 μ-law */
-    LWS_AUDIO_FMT_PCMA          /**< G.711 A-law */
+    LWS_AUDIO_FMT_PCMA,         /**< G.711 A-law */
+    LWS_AUDIO_FMT_OPUS          /**< Opus编码包（仅文件写入，lws_dev_write_audio_packet） */
 } lws_audio_format_t;
 
 /**
@@ -268,6 +269,47 @@ int lws_dev_read_audio(lws_dev_t* dev, void* buf, int samples);
  */
 int lws_dev_write_audio(lws_dev_t* dev, const void* data, int samples);
 
+/**
+ * @brief 设备能否直接写入该编码的音频包（直通录音，不经解码）
+ *
+ * 目前只有文件写入设备支持，且format须与设备配置的音频格式一致。
+ *
+ * @return 1支持，0不支持
+ */
+int lws_dev_audio_packet_supported(lws_dev_t* dev, lws_audio_format_t format);
+
+/**
+ * @brief 写入一个编码后的音频包（直通录音）
+ *
+ * pts与samples以设备采样率为单位，须等于编码的RTP时钟（G.711为8000，
+ * Opus为48000）。pts大于已写入的长度时中间的空隙由设备补齐（G.711写
+ * 静音，Opus在时间戳中留出空隙），小于已写入长度的包（重复或过晚）
+ * 被丢弃。
+ *
+ * @param dev 设备实例
+ * @param data 编码后的包（RTP负载）
+ * @param bytes 字节数
+ * @param pts 第一个采样在录音中的位置
+ * @param samples 包的时长（采样数）
+ * @return 写入的采样数，0丢弃，-1失败或不支持
+ */
+int lws_dev_write_audio_packet(lws_dev_t* dev, const void* data, int bytes,
+                               int64_t pts, int samples);
+
+/**
+ * @brief 结束当前录音文件，按新的音频格式写入下一段
+ *
+ * 录音中途编码改变时使用：同一轨道不能混入不同格式的音频。目前只有
+ * 文件写入设备支持，下一段写入"<名称>.<序号><扩展名>"（如call.mp4
+ * 之后为call.1.mp4），轨道按新的格式创建，位置从0开始。
+ *
+ * @param dev 设备实例（已启动）
+ * @param format 下一段的音频格式
+ * @param sample_rate 下一段的采样率
+ * @return 0成功，-1不支持或失败（失败后设备不再写入音频）
+ */
+int lws_dev_next_audio_segment(lws_dev_t* dev, lws_audio_format_t format, int sample_rate);
+
 /**
  * @brief 获取音频缓冲区可用空间（播放设备）
  * @param dev 设备实例
@@ -304,6 +346,13 @@ int lws_dev_read_video(lws_dev_t* dev, void* buf, int size);
  */
 int lws_dev_write_video(lws_dev_t* dev, const void* data, int size);
 
+/**
+ * @brief 请求下一帧为关键帧（采集设备，用于响应对端PLI/FIR）
+ * @param dev 设备实例
+ * @return 0成功，-1失败或设备不支持
+ */
+int lws_dev_request_keyframe(lws_dev_t* dev);
+
 /* ========================================
  * 时间戳API
  * ======================================== */
@@ -391,6 +440,9 @@ void lws_dev_init_file_reader_config(lws_dev_config_t* config, const char* file_
 
 /**
  * @brief 初始化文件写入配置
+ *
+ * 文件名以.wav结尾时写WAV（仅音频，PCM S16LE/PCMA/PCMU），否则写MP4。
+ *
  * @param config 配置结构体
  * @param file_path 文件路径
  */
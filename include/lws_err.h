@@ -157,6 +157,9 @@ extern "C" {
 /** Media session connection timeout */
 #define LWS_ERR_MEDIA_TIMEOUT   LWS_MAKE_ERROR(LWS_MODULE_MEDIA, 0x0005)
 
+/** DTLS-SRTP handshake failed */
+#define LWS_ERR_MEDIA_DTLS      LWS_MAKE_ERROR(LWS_MODULE_MEDIA, 0x0006)
+
 /* ========================================
  * Error code string conversion
  * ======================================== */
@@ -226,6 +229,7 @@ static inline const char* lws_err_string(int32_t errcode)
         case LWS_ERR_MEDIA_ICE:     return "Failed to gather ICE candidates";
         case LWS_ERR_MEDIA_SDP:     return "Failed to set remote SDP";
         case LWS_ERR_MEDIA_TIMEOUT: return "Media session connection timeout";
+        case LWS_ERR_MEDIA_DTLS:    return "DTLS-SRTP handshake failed";
 
         default:                    return "Unknown error";
     }
@@ -0,0 +1,226 @@
+/**
+ * @file lws_graph.h
+ * @brief 媒体处理图：source / filter / sink节点与引用计数帧
+ *
+ * 节点之间传递lws_frame_t。一个节点可以连接多个下游节点，同一帧以引用
+ * 的方式依次交给每个下游（扇出不复制）。process只借用帧：返回后帧可能
+ * 被释放，需要保留（如异步录音）时调用lws_frame_ref()。
+ *
+ * 修改帧数据前须确认独占：lws_frame_writable()为真时可原地修改，否则
+ * 用lws_frame_copy()得到副本。扇出时除最后一个下游外，帧都被其他下游
+ * 共享，因此原地处理的filter通常放在链路中扇出之前。
+ *
+ * 图不加锁，所有调用须在同一线程（会话中为lws_sess_loop）；帧的引用
+ * 计数是原子的，可以交给其他线程释放。
+ */
+
+#ifndef __LWS_GRAPH_H__
+#define __LWS_GRAPH_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * 帧
+ * ======================================== */
+
+/**
+ * @brief 帧类型
+ */
+typedef enum {
+    LWS_FRAME_AUDIO = 0,            /**< 交错的16位PCM */
+    LWS_FRAME_VIDEO = 1,            /**< 编码后的视频帧 */
+    LWS_FRAME_AUDIO_CODED = 2       /**< 编码后的音频包（RTP载荷，samples为时长） */
+} lws_frame_kind_t;
+
+/**
+ * @brief 引用计数的媒体帧
+ *
+ * 头部与数据在同一块内存中，由lws_frame_alloc()分配。
+ */
+typedef struct {
+    lws_frame_kind_t kind;          /**< 帧类型 */
+    uint8_t* data;                  /**< 数据 */
+    int size;                       /**< 有效字节数 */
+    int capacity;                   /**< data可用字节数 */
+    int samples;                    /**< 每声道采样数（音频） */
+    int sample_rate;                /**< 采样率（音频） */
+    int channels;                   /**< 声道数（音频） */
+    uint32_t timestamp;             /**< RTP时间戳 */
+    uint64_t time_us;               /**< 采集或接收时刻（微秒） */
+    int refcount;                   /**< 引用计数（只读，使用lws_frame_ref/unref） */
+} lws_frame_t;
+
+/**
+ * @brief 分配帧（引用计数为1，其它字段为0）
+ * @param capacity 数据区字节数
+ * @return 帧，内存不足返回NULL
+ */
+lws_frame_t* lws_frame_alloc(int capacity);
+
+/**
+ * @brief 增加引用
+ * @return frame
+ */
+lws_frame_t* lws_frame_ref(lws_frame_t* frame);
+
+/**
+ * @brief 释放引用，最后一个引用释放时回收内存
+ * @param frame 帧（可为NULL）
+ */
+void lws_frame_unref(lws_frame_t* frame);
+
+/**
+ * @brief 是否只有调用者持有（可原地修改）
+ */
+int lws_frame_writable(const lws_frame_t* frame);
+
+/**
+ * @brief 复制帧（数据与元数据），引用计数为1
+ * @return 副本，内存不足返回NULL
+ */
+lws_frame_t* lws_frame_copy(const lws_frame_t* frame);
+
+/* ========================================
+ * 节点
+ * ======================================== */
+
+typedef struct lws_graph lws_graph_t;
+typedef struct lws_graph_node lws_graph_node_t;
+
+/**
+ * @brief 节点类型
+ */
+typedef enum {
+    LWS_NODE_SOURCE = 0,            /**< 产生帧（lws_graph_emit），无输入 */
+    LWS_NODE_FILTER = 1,            /**< 处理输入帧并以lws_graph_emit输出 */
+    LWS_NODE_SINK = 2               /**< 消费帧，无输出 */
+} lws_node_type_t;
+
+/**
+ * @brief 节点实现
+ */
+typedef struct {
+    const char* name;               /**< 节点名（lws_graph_find） */
+    lws_node_type_t type;           /**< 节点类型 */
+
+    /**
+     * 处理一帧（source为NULL）。frame为借用，返回后不可再访问，除非已
+     * lws_frame_ref。filter可对同一帧或新帧调用lws_graph_emit，也可以
+     * 不输出（丢弃或缓存）。返回值只用于统计，非0计为错误。
+     */
+    int (*process)(void* ctx, lws_graph_node_t* node, lws_frame_t* frame);
+
+    void (*destroy)(void* ctx);     /**< 图销毁时调用（可为NULL） */
+} lws_node_ops_t;
+
+/**
+ * @brief 节点定义（ops与其实例参数），用于配置中的节点列表
+ */
+typedef struct {
+    const lws_node_ops_t* ops;      /**< 节点实现 */
+    void* ctx;                      /**< 传给process/destroy的参数 */
+} lws_node_def_t;
+
+/**
+ * @brief 节点统计（CPU时间只计本节点的process，不含下游）
+ */
+typedef struct {
+    uint64_t frames;                /**< 处理（source为输出）的帧数 */
+    uint64_t errors;                /**< process返回非0的次数 */
+    uint64_t total_us;              /**< process累计耗时（微秒） */
+    uint32_t max_us;                /**< 单帧最长耗时（微秒） */
+} lws_node_stats_t;
+
+/* ========================================
+ * 图
+ * ======================================== */
+
+#define LWS_GRAPH_MAX_OUTPUTS   4   /**< 每个节点的下游数上限 */
+#define LWS_GRAPH_MAX_DEPTH     16  /**< 一帧经过的最长节点链 */
+
+/**
+ * @brief 创建空图
+ * @return 图，内存不足返回NULL
+ */
+lws_graph_t* lws_graph_create(void);
+
+/**
+ * @brief 销毁图及所有节点（调用各节点的destroy）
+ * @param graph 图（可为NULL）
+ */
+void lws_graph_destroy(lws_graph_t* graph);
+
+/**
+ * @brief 添加节点（尚未连接）
+ * @param graph 图
+ * @param ops 节点实现（须在图的生命周期内有效）
+ * @param ctx 节点参数
+ * @return 节点，失败返回NULL
+ */
+lws_graph_node_t* lws_graph_add(lws_graph_t* graph, const lws_node_ops_t* ops, void* ctx);
+
+/**
+ * @brief 连接from的输出到to的输入
+ *
+ * 下游按连接顺序接收帧。sink不能作为from，source不能作为to。
+ *
+ * @return 0成功，-1参数无效、已连接、形成环或下游已满
+ */
+int lws_graph_link(lws_graph_node_t* from, lws_graph_node_t* to);
+
+/**
+ * @brief 断开连接
+ * @return 0成功，-1未连接
+ */
+int lws_graph_unlink(lws_graph_node_t* from, lws_graph_node_t* to);
+
+/**
+ * @brief 按名称查找节点
+ * @return 第一个同名节点，未找到返回NULL
+ */
+lws_graph_node_t* lws_graph_find(lws_graph_t* graph, const char* name);
+
+/**
+ * @brief 把帧交给node的全部下游（source产生帧、filter输出时调用）
+ *
+ * 同步调用下游的process，调用者仍持有frame。
+ *
+ * @return 接收该帧的下游数，-1参数无效
+ */
+int lws_graph_emit(lws_graph_node_t* node, lws_frame_t* frame);
+
+/**
+ * @brief 搭建链路：defs中的filter依次串在from之后，sink并联在最后一个filter上
+ *
+ * 会话用它把配置中的节点插入标准链路（采集→语音处理→…→编码，
+ * 解包→…→播放/录音）。
+ *
+ * @param graph 图
+ * @param from 链路起点
+ * @param defs 节点定义（source被忽略）
+ * @param count defs中的数量
+ * @return 最后一个filter（无filter时为from），失败返回NULL
+ */
+lws_graph_node_t* lws_graph_build(lws_graph_t* graph, lws_graph_node_t* from,
+                                  const lws_node_def_t* defs, int count);
+
+/**
+ * @brief 节点名
+ */
+const char* lws_graph_node_name(const lws_graph_node_t* node);
+
+/**
+ * @brief 节点统计
+ * @return 0成功，-1参数无效
+ */
+int lws_graph_node_stats(const lws_graph_node_t* node, lws_node_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_GRAPH_H__ */
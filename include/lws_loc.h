@@ -0,0 +1,169 @@
+/**
+ * @file lws_loc.h
+ * @brief lwsip location service (registrar binding store)
+ *
+ * 嵌入式registrar使用的位置服务：
+ * - 以AOR（Address of Record）为key的开放寻址哈希表
+ * - 每个AOR支持多个Contact绑定（多设备注册）
+ * - 所有绑定共享一个按过期时间排序的最小堆索引，
+ *   过期处理由调用方周期性驱动（lws_loc_expire），不为每个绑定创建定时器
+ * - 查询不分配内存，返回的Contact指针在下一次修改前有效
+ */
+
+#ifndef __LWS_LOC_H__
+#define __LWS_LOC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lws_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * 常量定义
+ * ======================================== */
+
+#define LWS_LOC_MAX_CONTACTS    8       /**< 每个AOR最大Contact数量 */
+#define LWS_LOC_DEFAULT_CAPACITY 64     /**< 默认哈希表初始容量 */
+
+/* ========================================
+ * 类型定义
+ * ======================================== */
+
+/* 前向声明 */
+typedef struct lws_loc_t lws_loc_t;
+
+/**
+ * @brief 查询结果中的Contact
+ */
+typedef struct {
+    const char* contact;        /**< Contact URI（指向内部存储，下一次修改前有效） */
+    int expires;                /**< 剩余有效期（秒） */
+} lws_loc_contact_t;
+
+/**
+ * @brief 位置服务统计
+ */
+typedef struct {
+    uint32_t aor_count;         /**< AOR数量 */
+    uint32_t binding_count;     /**< 绑定数量 */
+    uint32_t slot_count;        /**< 哈希表槽位数 */
+    uint64_t memory_bytes;      /**< 总内存占用（字节，含哈希表和堆索引） */
+    uint32_t bytes_per_binding; /**< 平均每个绑定的内存占用（字节） */
+    uint64_t expired_total;     /**< 累计过期绑定数 */
+} lws_loc_stats_t;
+
+/**
+ * @brief 绑定过期回调
+ * @param aor AOR
+ * @param contact 过期的Contact URI
+ * @param userdata 用户数据
+ */
+typedef void (*lws_loc_on_expired_f)(
+    const char* aor,
+    const char* contact,
+    void* userdata
+);
+
+/* ========================================
+ * 核心API
+ * ======================================== */
+
+/**
+ * @brief 创建位置服务
+ * @param capacity 预期AOR数量（0=默认），用于预分配哈希表
+ * @return 位置服务实例，失败返回NULL
+ */
+lws_loc_t* lws_loc_create(uint32_t capacity);
+
+/**
+ * @brief 销毁位置服务
+ * @param loc 位置服务实例
+ */
+void lws_loc_destroy(lws_loc_t* loc);
+
+/**
+ * @brief 添加/刷新/删除绑定
+ *
+ * expires > 0 时添加或刷新 (aor, contact) 绑定；expires == 0 时删除该绑定。
+ * 当AOR的绑定数达到LWS_LOC_MAX_CONTACTS时，最早过期的绑定被替换。
+ *
+ * @param loc 位置服务实例
+ * @param aor AOR（如"sip:1001@example.com"）
+ * @param contact Contact URI
+ * @param expires 有效期（秒）
+ * @param now_ms 当前单调时间（毫秒）
+ * @return LWS_OK成功，其他为错误码
+ */
+int lws_loc_bind(
+    lws_loc_t* loc,
+    const char* aor,
+    const char* contact,
+    int expires,
+    uint64_t now_ms
+);
+
+/**
+ * @brief 删除AOR的所有绑定（Contact: *）
+ * @param loc 位置服务实例
+ * @param aor AOR
+ * @return 删除的绑定数量
+ */
+int lws_loc_unbind_all(lws_loc_t* loc, const char* aor);
+
+/**
+ * @brief 查询AOR的有效Contact（用于INVITE路由）
+ * @param loc 位置服务实例
+ * @param aor AOR
+ * @param contacts 输出Contact数组
+ * @param max_count 数组大小
+ * @param now_ms 当前单调时间（毫秒）
+ * @return 有效Contact数量，未找到返回0
+ */
+int lws_loc_lookup(
+    lws_loc_t* loc,
+    const char* aor,
+    lws_loc_contact_t* contacts,
+    int max_count,
+    uint64_t now_ms
+);
+
+/**
+ * @brief 处理已过期的绑定
+ *
+ * 从过期索引中弹出所有 expires_at <= now_ms 的绑定，复杂度O(k log n)。
+ *
+ * @param loc 位置服务实例
+ * @param now_ms 当前单调时间（毫秒）
+ * @param on_expired 过期回调（可为NULL）
+ * @param userdata 用户数据
+ * @return 过期的绑定数量
+ */
+int lws_loc_expire(
+    lws_loc_t* loc,
+    uint64_t now_ms,
+    lws_loc_on_expired_f on_expired,
+    void* userdata
+);
+
+/**
+ * @brief 获取下一个绑定的过期时间
+ * @param loc 位置服务实例
+ * @return 过期时间（毫秒），没有绑定返回0
+ */
+uint64_t lws_loc_next_expiry(lws_loc_t* loc);
+
+/**
+ * @brief 获取统计信息（含内存占用）
+ * @param loc 位置服务实例
+ * @param stats 输出统计
+ */
+void lws_loc_get_stats(lws_loc_t* loc, lws_loc_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LWS_LOC_H__
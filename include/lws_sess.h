@@ -17,6 +17,7 @@
 #include <stddef.h>
 #include "lws_defs.h"
 #include "lws_dev.h"
+#include "lws_graph.h"
 
 /* Forward declarations for types (we use librtp/libice directly) */
 typedef struct lws_rtp_t lws_rtp_t;
@@ -39,13 +40,33 @@ typedef enum {
     LWS_RTP_PAYLOAD_G722 = 9,       /**< G.722 */
     LWS_RTP_PAYLOAD_L16_2 = 10,     /**< L16 stereo */
     LWS_RTP_PAYLOAD_L16_1 = 11,     /**< L16 mono */
+    LWS_RTP_PAYLOAD_CN = 13,        /**< RFC 3389 comfort noise */
     LWS_RTP_PAYLOAD_OPUS = 96,      /**< Opus (dynamic) */
     LWS_RTP_PAYLOAD_H264 = 97,      /**< H.264 (dynamic) */
     LWS_RTP_PAYLOAD_H265 = 98,      /**< H.265 (dynamic) */
     LWS_RTP_PAYLOAD_VP8 = 99,       /**< VP8 (dynamic) */
-    LWS_RTP_PAYLOAD_VP9 = 100       /**< VP9 (dynamic) */
+    LWS_RTP_PAYLOAD_VP9 = 100,      /**< VP9 (dynamic) */
+    LWS_RTP_PAYLOAD_TELEPHONE_EVENT = 101, /**< RFC 4733 telephone-event (dynamic) */
+    LWS_RTP_PAYLOAD_RTX = 102,      /**< RFC 4588 视频重传格式 (dynamic) */
+    LWS_RTP_PAYLOAD_RED = 103       /**< RFC 2198 冗余音频格式 (dynamic) */
 } lws_rtp_payload_t;
 
+/**
+ * @brief 协商后的编解码条目
+ *
+ * 动态payload type允许两个方向不同（如本端offer 96，对端answer 111），
+ * 发送使用send_pt，接收按recv_pt识别。
+ */
+typedef struct {
+    lws_rtp_payload_t codec;        /**< 编解码类型 */
+    char name[LWS_MAX_CODEC_NAME_LEN]; /**< a=rtpmap编码名称 */
+    int send_pt;                    /**< 发送使用的payload type（对端的接收PT） */
+    int recv_pt;                    /**< 接收的payload type（本端SDP中声明） */
+    int clock_rate;                 /**< RTP时钟频率 */
+    int channels;                   /**< 声道数 */
+    char fmtp[LWS_MAX_FMTP_LEN];    /**< 本端SDP中的a=fmtp参数（空表示无） */
+} lws_sess_codec_t;
+
 /**
  * @brief RTP统计信息
  */
@@ -95,6 +116,16 @@ typedef enum {
     LWS_MEDIA_DIR_INACTIVE          /**< 不活动 */
 } lws_media_dir_t;
 
+/**
+ * @brief 远端SDP更新引起的变化（lws_sess_update_remote_sdp返回值）
+ */
+typedef enum {
+    LWS_SESS_CHANGE_DIR   = 0x01,   /**< 协商后的媒体方向变化（保持/恢复） */
+    LWS_SESS_CHANGE_CODEC = 0x02,   /**< 音频编码变化 */
+    LWS_SESS_CHANGE_ADDR  = 0x04,   /**< 远端RTP地址/端口变化 */
+    LWS_SESS_CHANGE_SSRC  = 0x08    /**< 远端SSRC变化 */
+} lws_sess_change_t;
+
 /**
  * @brief 媒体传输模式
  */
@@ -103,8 +134,26 @@ typedef enum {
     LWS_TRANSPORT_MODE_RTP_DIRECT   /**< RTP直连模式（不使用ICE，直接RTP通信或通过TURN中转） */
 } lws_transport_mode_t;
 
+/**
+ * @brief SRTP策略
+ */
+typedef enum {
+    LWS_SRTP_MODE_OFF,              /**< 明文RTP（RTP/AVP） */
+    LWS_SRTP_MODE_OPTIONAL,         /**< offer为RTP/AVP并附带a=crypto，对端支持时加密 */
+    LWS_SRTP_MODE_REQUIRED          /**< offer为RTP/SAVP，对端不支持SRTP时协商失败 */
+} lws_srtp_mode_t;
+
+/**
+ * @brief SRTP密钥交换方式
+ */
+typedef enum {
+    LWS_SRTP_KEYING_SDES,           /**< a=crypto（RFC 4568），SIP中继常用 */
+    LWS_SRTP_KEYING_DTLS            /**< DTLS-SRTP（RFC 5763/5764），WebRTC要求 */
+} lws_srtp_keying_t;
+
 /* 前向声明 */
 typedef struct lws_sess_t lws_sess_t;
+typedef struct lws_sess_sock_pool_t lws_sess_sock_pool_t;
 
 /**
  * @brief 会话统计信息
@@ -115,6 +164,45 @@ typedef struct {
     lws_rtp_stats_t video_stats;    /**< 视频RTP统计 */
     uint64_t start_time;            /**< 会话开始时间（微秒） */
     uint64_t duration;              /**< 会话时长（微秒） */
+
+    /* 语音处理（每个采集帧） */
+    uint32_t audio_proc_avg_us;     /**< 平均处理时间（微秒） */
+    uint32_t audio_proc_max_us;     /**< 最长处理时间（微秒） */
+    uint64_t audio_proc_overruns;   /**< 超出audio_proc_budget_us的帧数 */
+    int echo_delay_ms;              /**< 内置AEC估计的回声延迟（-1为未知） */
+
+    /* 视频丢包恢复与发送平滑 */
+    uint64_t video_nacks_recv;      /**< 对端NACK请求的包数 */
+    uint64_t video_nacks_sent;      /**< 本端NACK请求的包数 */
+    uint64_t video_retransmits;     /**< 重传的包数 */
+    uint64_t video_recovered;       /**< 经重传恢复的包数 */
+    uint64_t video_keyframe_requests; /**< 收到的PLI/FIR数 */
+    uint32_t video_pacing_avg_us;   /**< 包在发送队列中的平均等待（微秒） */
+    uint32_t video_pacing_max_us;   /**< 包在发送队列中的最长等待（微秒） */
+
+    /* SRTP */
+    uint64_t srtp_dropped;          /**< 认证失败或重放而丢弃的包数 */
+
+    /* 冗余音频（RFC 2198） */
+    int audio_red_level;            /**< 当前每包重复的之前帧数（0为未协商或不冗余） */
+    uint64_t audio_red_recovered;   /**< 由冗余块重建的丢失包数 */
+    double audio_effective_loss;    /**< 冗余恢复后的丢包率（0.0-1.0），未协商RED时同loss_rate */
+
+    /* 打包时长 */
+    int audio_ptime;                /**< 当前发送的每包时长（毫秒） */
+
+    /* 录音（异步写入） */
+    uint64_t record_frames;         /**< 已写入的帧数 */
+    uint64_t record_dropped;        /**< 队列满而丢弃的帧数 */
+    uint32_t record_max_write_us;   /**< 单次写入最长耗时（微秒） */
+
+    /* RTP直连（对称RTP） */
+    uint32_t rtp_latches;           /**< 媒体改发往实际源地址的次数 */
+    uint64_t rtp_source_dropped;    /**< 来自未验证源地址而丢弃的包数 */
+
+    /* ICE */
+    int ice_connect_ms;             /**< 开始连通性检查到选定候选对的时间（毫秒），-1为未连通或未用ICE */
+    uint32_t ice_checks_sent;       /**< 发出的连通性检查（含重传与consent检查） */
 } lws_sess_stats_t;
 
 /* ========================================
@@ -159,6 +247,20 @@ typedef void (*lws_sess_on_candidate_f)(
     void* userdata
 );
 
+/**
+ * @brief ICE候选收集完成回调
+ *
+ * 所有STUN事务完成或收集截止时间到达时调用一次；此时本地SDP已包含
+ * 全部候选。
+ *
+ * @param sess 会话实例
+ * @param userdata 用户数据
+ */
+typedef void (*lws_sess_on_gathering_done_f)(
+    lws_sess_t* sess,
+    void* userdata
+);
+
 /**
  * @brief 媒体连接建立回调
  * @param sess 会话实例
@@ -195,6 +297,24 @@ typedef void (*lws_sess_on_error_f)(
     void* userdata
 );
 
+/**
+ * @brief 收到DTMF回调（RFC 4733 telephone-event）
+ *
+ * 每个事件回调一次：收到结束包时，或结束包全部丢失而事件超时/被下一个
+ * 事件取代时。
+ *
+ * @param sess 会话实例
+ * @param digit 按键（'0'-'9'、'*'、'#'、'A'-'D'）
+ * @param duration_ms 事件时长（毫秒）
+ * @param userdata 用户数据
+ */
+typedef void (*lws_sess_on_dtmf_f)(
+    lws_sess_t* sess,
+    char digit,
+    int duration_ms,
+    void* userdata
+);
+
 /**
  * @brief 会话事件回调集合
  */
@@ -202,9 +322,11 @@ typedef struct {
     lws_sess_on_state_changed_f on_state_changed;   /**< 状态变化回调 */
     lws_sess_on_sdp_ready_f on_sdp_ready;           /**< SDP就绪回调 */
     lws_sess_on_candidate_f on_candidate;           /**< 新candidate回调 */
+    lws_sess_on_gathering_done_f on_gathering_done; /**< candidate收集完成回调 */
     lws_sess_on_connected_f on_connected;           /**< 连接建立回调 */
     lws_sess_on_disconnected_f on_disconnected;     /**< 连接断开回调 */
     lws_sess_on_error_f on_error;                   /**< 错误回调 */
+    lws_sess_on_dtmf_f on_dtmf;                     /**< 收到DTMF回调 */
     void* userdata;                                  /**< 用户数据 */
 } lws_sess_handler_t;
 
@@ -212,27 +334,74 @@ typedef struct {
  * 配置
  * ======================================== */
 
+/**
+ * @brief 语音处理阶段（采集与编码之间，可替换内置实现）
+ *
+ * 所有回调都在lws_sess_loop中调用。render收到写入播放设备的每一帧，
+ * 作为回声消除的参考信号；capture原地处理采集帧。
+ */
+typedef struct {
+    void* (*create)(int sample_rate, int frame_samples, void* param); /**< 创建实例，失败返回NULL */
+    void (*destroy)(void* ctx);                                        /**< 销毁实例 */
+    void (*render)(void* ctx, const int16_t* pcm, int samples);        /**< 播放帧（可为NULL） */
+    void (*capture)(void* ctx, int16_t* pcm, int samples);             /**< 采集帧 */
+    void* param;                                                       /**< 传给create的参数 */
+} lws_audio_proc_t;
+
 /**
  * @brief 会话配置
  */
 typedef struct {
-    /* ICE配置 (可选，仅当远程SDP包含ICE属性时使用) */
+    /* ICE配置 (可选，enable_ice或远程SDP包含ICE属性时使用) */
+    int enable_ice;                 /**< offer中收集并携带ICE候选 */
     const char* stun_server;        /**< STUN服务器地址 */
     uint16_t stun_port;             /**< STUN端口 */
-    const char* turn_server;        /**< TURN服务器地址（可选） */
-    uint16_t turn_port;             /**< TURN端口 */
+    const char* stun_servers[LWS_MAX_STUN_SERVERS]; /**< 额外的STUN服务器（"host[:port]"，与stun_server并行查询） */
+    int ice_gather_timeout_ms;      /**< 候选收集截止时间（毫秒），0为LWS_DEFAULT_ICE_GATHER_TIMEOUT_MS */
+    const char* turn_server;        /**< TURN服务器地址（"host[:port]"，可选；ICE收集时分配中继候选） */
+    uint16_t turn_port;             /**< TURN端口，0为LWS_DEFAULT_TURN_PORT */
     const char* turn_username;      /**< TURN用户名 */
     const char* turn_password;      /**< TURN密码 */
     int trickle_ice;                /**< 启用trickle ICE */
+    int ice_aggressive;             /**< 作为controlling方积极提名（每个检查都带USE-CANDIDATE），否则常规提名 */
+    int ice_lite;                   /**< ICE-lite（公网服务器）：只有host候选，无状态应答检查，锁定对端提名的路径；隐含enable_ice，忽略STUN/trickle */
 
     /* 音频配置 */
     int enable_audio;               /**< 启用音频 */
-    lws_rtp_payload_t audio_codec;  /**< 音频编解码 */
+    lws_rtp_payload_t audio_codec;  /**< 音频编解码（audio_codec_count为0时使用） */
+    lws_rtp_payload_t audio_codecs[LWS_MAX_CODECS]; /**< 音频编解码优先级列表（可选） */
+    int audio_codec_count;          /**< audio_codecs中的数量，0表示audio_codec优先，其后为G.711/G.722 */
+    int telephone_event;            /**< 协商RFC 4733 telephone-event */
+    int comfort_noise;              /**< 协商RFC 3389舒适噪声(CN) */
+    int dtx;                        /**< VAD判定静音时停止发送，仅周期发送CN（需对端接受CN） */
+    int audio_red;                  /**< RFC 2198冗余音频：每包最多重复的之前帧数（0为关闭，上限3），按对端RTCP报告的丢包率自适应 */
+    int audio_ptime;                /**< 打包时长（毫秒，20的倍数）：以a=ptime声明并按此发送；0为自动（对端声明a=maxptime时按包头开销选择） */
+    int audio_maxptime;             /**< 以a=maxptime声明的接收上限，同时是自动选择的时延上限（毫秒），0为60 */
     int audio_sample_rate;          /**< 音频采样率 */
     int audio_channels;             /**< 音频声道数 */
     lws_dev_t* audio_capture_dev;   /**< 音频采集设备 */
     lws_dev_t* audio_playback_dev;  /**< 音频播放设备 */
     lws_dev_t* audio_record_dev;    /**< 音频录音设备 (可选，用于录制接收到的音频) */
+    int record_queue_ms;            /**< 录音队列时长（毫秒）：录音由后台线程批量写入，写入跟不上时超出的帧丢弃并计数；0为LWS_DEFAULT_RECORD_QUEUE_MS，-1为在媒体线程同步写入 */
+    int record_stereo;              /**< 录制双方：左声道为本端采集（编码器输入），右声道为对端（解码输出），按时间对齐、缺失处补静音；audio_record_dev须为双声道（如lws_dev_file的.wav），总是后台写入 */
+    int record_transcode;           /**< 录音经解码后写入PCM；为0（默认）且协商的编码为PCMU/PCMA/Opus、audio_record_dev支持该编码的包（lws_dev_audio_packet_supported）时，直接写入收到的RTP负载（直通录音，不解码不重编码），总是后台写入；通话中切换编码时设备开始新的分段（lws_dev_next_audio_segment），新编码能直通则继续直通，否则录解码音频，设备不支持分段时停止录音；record_stereo时不适用 */
+
+    /* 语音处理（采集→编码） */
+    int enable_aec;                 /**< 回声消除（以播放信号为参考，采样率不超过16kHz） */
+    int enable_ns;                  /**< 降噪 */
+    int enable_agc;                 /**< 自动增益控制 */
+    const lws_audio_proc_t* audio_proc; /**< 自定义处理阶段（可选，设置后替代内置AEC/NS/AGC） */
+    int audio_proc_budget_us;       /**< 每帧处理时间预算（微秒），0为帧长的25% */
+
+    /*
+     * 音频处理图（lws_sess_get_graph）：采集 capture → audio-proc → … → encoder
+     * （record_stereo时并联record-local），接收 rtp → … → playback / record。
+     * 以下节点按定义顺序插入：filter串在链路中，sink与末端节点并联
+     */
+    const lws_node_def_t* audio_tx_nodes; /**< 采集侧追加节点（语音处理之后、编码之前） */
+    int audio_tx_node_count;        /**< audio_tx_nodes中的数量 */
+    const lws_node_def_t* audio_rx_nodes; /**< 接收侧追加节点（解包之后、播放与录音之前） */
+    int audio_rx_node_count;        /**< audio_rx_nodes中的数量 */
 
     /* 视频配置 */
     int enable_video;               /**< 启用视频 */
@@ -240,6 +409,7 @@ typedef struct {
     int video_width;                /**< 视频宽度 */
     int video_height;               /**< 视频高度 */
     int video_fps;                  /**< 视频帧率 */
+    int video_nack;                 /**< 视频NACK/RTX重传与PLI/FIR（RFC 4585/4588） */
     lws_dev_t* video_capture_dev;   /**< 视频采集设备 */
     lws_dev_t* video_display_dev;   /**< 视频显示设备 */
 
@@ -249,8 +419,21 @@ typedef struct {
     /* RTCP */
     int enable_rtcp;                /**< 启用RTCP */
 
+    /* RTP直连 */
+    int symmetric_rtp;              /**< 对称RTP：媒体发往实际收到RTP的源地址（NAT后的对端），按SSRC验证新源地址 */
+
+    /* 传输复用 */
+    int bundle;                     /**< 音视频共用音频的端口与ICE候选对（BUNDLE，RFC 8843），对端不支持时各用独立端口 */
+
+    /* 媒体加密 */
+    lws_srtp_mode_t srtp_mode;      /**< SRTP策略（AES-CM/HMAC-SHA1、AES-GCM） */
+    lws_srtp_keying_t srtp_keying;  /**< offer的密钥交换方式（应答时跟随对端offer） */
+
     /* 抖动缓冲区 */
     int jitter_buffer_ms;           /**< 抖动缓冲区大小（毫秒） */
+
+    /* 网络 */
+    lws_sess_sock_pool_t* sock_pool; /**< 预绑定的媒体socket池（可选，NULL则创建时绑定） */
 } lws_sess_config_t;
 
 /* ========================================
@@ -276,6 +459,13 @@ void lws_sess_destroy(lws_sess_t* sess);
 
 /**
  * @brief 开始收集ICE candidates
+ *
+ * 未启用ICE时立即生成SDP并回调on_sdp_ready。启用ICE时（enable_ice，或
+ * 应答含ICE属性的offer）收集所有接口的host候选，并行向各STUN服务器查询
+ * server-reflexive候选，每发现一个候选回调on_candidate，收集完成或截止
+ * 时间到达后回调on_gathering_done；on_sdp_ready在收集完成后回调，
+ * trickle_ice时则在收集开始时立即回调。收集进度由lws_sess_loop驱动。
+ *
  * @param sess 会话实例
  * @return 0成功，-1失败
  */
@@ -290,20 +480,97 @@ int lws_sess_gather_candidates(lws_sess_t* sess);
 int lws_sess_set_remote_sdp(lws_sess_t* sess, const char* sdp);
 
 /**
- * @brief 添加远端ICE candidate（trickle ICE）
+ * @brief 应用会话中的新远端SDP（re-INVITE/UPDATE的offer或answer）
+ *
+ * 与当前协商结果逐项比较（方向、编码、远端RTP地址、SSRC），只对
+ * 变化的部分做增量调整：socket、ICE、RTCP会话和编码器的SSRC/序号
+ * 均保持不变。作为应答方时本地SDP随之更新（内容变化时o=版本递增），
+ * 可通过lws_sess_get_local_sdp获取。
+ *
  * @param sess 会话实例
- * @param candidate Candidate字符串（SDP格式）
+ * @param sdp 远端SDP字符串
+ * @return 变化掩码（lws_sess_change_t组合，0表示无变化），-1失败（如无共同编码）
+ */
+int lws_sess_update_remote_sdp(lws_sess_t* sess, const char* sdp);
+
+/**
+ * @brief 修改本端媒体方向（保持/恢复）
+ *
+ * 重新生成本地SDP作为新的offer（o=版本递增），由调用方通过
+ * re-INVITE或UPDATE发送（发送时调用lws_sess_set_offer_pending）；
+ * 应答到达后调用lws_sess_update_remote_sdp。不改变offer状态。
+ *
+ * @param sess 会话实例
+ * @param dir 本端期望的媒体方向（保持通常为SENDONLY，恢复为SENDRECV）
+ * @return 0成功，-1失败
+ */
+int lws_sess_set_media_dir(lws_sess_t* sess, lws_media_dir_t dir);
+
+/**
+ * @brief 标记本地SDP作为offer已发出（1）或offer/answer已结束（0）
+ *
+ * 会话中以本地SDP作为offer发出re-INVITE/UPDATE（或在200中携带offer）
+ * 时置1，其后的lws_sess_update_remote_sdp按answer处理并清除；最终响应
+ * 被拒绝、超时或发送失败时由调用方置0，之后的远端SDP按offer处理。
+ *
+ * @param sess 会话实例
+ * @param pending 1为offer等待answer，0为没有进行中的offer
  * @return 0成功，-1失败
  */
+int lws_sess_set_offer_pending(lws_sess_t* sess, int pending);
+
+/**
+ * @brief 添加远端ICE candidate（trickle ICE，RFC 8838）
+ *
+ * 可在lws_sess_start_ice之前或连通性检查进行中调用，新候选立即配对并
+ * 加入检查表。只使用component 1（RTCP与RTP复用）的UDP/IPv4候选。
+ *
+ * @param sess 会话实例
+ * @param candidate Candidate字符串（"candidate:..."，可带"a="前缀）
+ * @return 0成功，-1失败（格式错误、重复、未使用ICE）
+ */
 int lws_sess_add_remote_candidate(lws_sess_t* sess, const char* candidate);
 
 /**
- * @brief 开始ICE连接
+ * @brief 对端候选已全部给出（收到a=end-of-candidates，RFC 8840）
+ *
+ * 此后所有候选对失败即判定ICE失败，无需等待检查超时。非trickle的远端
+ * SDP由lws_sess_set_remote_sdp自动处理。
+ *
+ * @param sess 会话实例
+ * @return 0成功，-1未使用ICE
+ */
+int lws_sess_end_of_candidates(lws_sess_t* sess);
+
+/**
+ * @brief 开始ICE连通性检查
+ *
+ * ICE模式下进入CONNECTING状态，检查由lws_sess_loop驱动：按Ta节拍发送，
+ * 触发检查优先。offerer为controlling方，按ice_aggressive积极或常规提名；
+ * 选定候选对后进入CONNECTED并回调on_connected，所有候选对失败或超时
+ * 回调on_error（LWS_ERR_MEDIA_ICE）。连通后定期做consent检查
+ * （RFC 7675），对端失去响应时回调on_disconnected。
+ * RTP直连模式下直接进入CONNECTED。
+ *
  * @param sess 会话实例
  * @return 0成功，-1失败
  */
 int lws_sess_start_ice(lws_sess_t* sess);
 
+/**
+ * @brief 发送DTMF（RFC 4733 telephone-event）
+ *
+ * 按键加入发送队列，由lws_sess_loop按包间隔发出：事件首包带M标记，
+ * 之后每个包时长递增，结束包（E标记）冗余发送3次；事件期间暂停音频，
+ * 与音频共用SSRC和序号空间。须已协商telephone-event。
+ *
+ * @param sess 会话实例
+ * @param digits 按键串（'0'-'9'、'*'、'#'、'A'-'D'）
+ * @param duration_ms 每个按键时长（毫秒，<=0使用默认100）
+ * @return 0成功，-1失败（未协商、按键非法或队列已满）
+ */
+int lws_sess_send_dtmf(lws_sess_t* sess, const char* digits, int duration_ms);
+
 /**
  * @brief 会话事件循环（驱动媒体发送）
  *
@@ -326,6 +593,36 @@ int lws_sess_loop(lws_sess_t* sess, int timeout_ms);
  */
 void lws_sess_stop(lws_sess_t* sess);
 
+/* ========================================
+ * 媒体socket池
+ * ======================================== */
+
+/**
+ * @brief 创建媒体socket池
+ *
+ * 预先创建并绑定UDP socket，lws_sess_create时直接取用，避免在
+ * 信令处理路径上执行socket/bind/getsockname。socket随会话销毁而
+ * 关闭，不回收复用（避免收到上一路呼叫的残留媒体包）。
+ * 池本身不加锁，须与lws_sess_create在同一线程使用。
+ *
+ * @param capacity 池中保持的空闲socket数量
+ * @return socket池，失败返回NULL
+ */
+lws_sess_sock_pool_t* lws_sess_sock_pool_create(int capacity);
+
+/**
+ * @brief 销毁媒体socket池（关闭所有空闲socket）
+ * @param pool socket池
+ */
+void lws_sess_sock_pool_destroy(lws_sess_sock_pool_t* pool);
+
+/**
+ * @brief 补充socket池到目标数量（应在空闲时调用）
+ * @param pool socket池
+ * @return 当前空闲socket数量
+ */
+int lws_sess_sock_pool_fill(lws_sess_sock_pool_t* pool);
+
 /* ========================================
  * 状态查询
  * ======================================== */
@@ -344,6 +641,19 @@ lws_sess_state_t lws_sess_get_state(lws_sess_t* sess);
  */
 const char* lws_sess_get_local_sdp(lws_sess_t* sess);
 
+/**
+ * @brief 获取协商后的音频编解码表
+ *
+ * 按优先级排列，第一个非telephone-event条目为当前发送编码。
+ * 远端SDP应用前返回本端offer中的编解码。
+ *
+ * @param sess 会话实例
+ * @param codecs 输出数组
+ * @param max 数组容量
+ * @return 条目数量，-1失败
+ */
+int lws_sess_get_codecs(lws_sess_t* sess, lws_sess_codec_t* codecs, int max);
+
 /**
  * @brief 获取会话统计信息
  * @param sess 会话实例
@@ -373,6 +683,16 @@ lws_rtp_t* lws_sess_get_video_rtp(lws_sess_t* sess);
  */
 lws_ice_t* lws_sess_get_ice(lws_sess_t* sess);
 
+/**
+ * @brief 获取音频处理图（查看节点统计、运行中增删tap）
+ *
+ * 只能在调用lws_sess_loop的线程中操作。
+ *
+ * @param sess 会话实例
+ * @return 处理图，未启用音频时返回NULL
+ */
+lws_graph_t* lws_sess_get_graph(lws_sess_t* sess);
+
 /* ========================================
  * 辅助函数
  * ======================================== */
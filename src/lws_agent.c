@@ -13,14 +13,17 @@
 #include "lws_intl.h"
 #include "lws_agent.h"
 #include "lws_sess.h"
+#include "lws_sdp.h"
 #include "lws_defs.h"
 #include "lws_err.h"
 #include "lws_timer.h"
+#include "lws_dtls.h"
 #include "lws_mem.h"
 #include "lws_log.h"
 #include "lws_auth.h"  /* SIP Digest Authentication */
 
 #include <time.h>  /* For time() */
+#include <psa/crypto.h>
 
 /* libsip headers */
 #include "sip-agent.h"
@@ -37,6 +40,9 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <ctype.h>
 
 /* ========================================
  * Internal structures
@@ -60,6 +66,25 @@ typedef struct lws_dialog_intl_t {
     char local_sdp[2048];            /**< 本地SDP */
     char remote_sdp[2048];           /**< 远端SDP */
 
+    /* 会话中SDP协商 (re-INVITE/UPDATE) */
+    int reoffer_pending;             /**< 本端re-INVITE/UPDATE等待最终响应 */
+    struct sip_uac_transaction_t* reoffer_t; /**< 进行中的re-INVITE/UPDATE，响应回调据此找回dialog */
+    lws_media_dir_t media_dir;       /**< 本端期望的媒体方向 */
+    lws_media_dir_t reoffer_prev_dir; /**< offer被拒绝时恢复的方向 */
+    int reoffer_use_update;          /**< 491后重试时使用UPDATE */
+    uint64_t reoffer_retry_ms;       /**< 491后的重试时间 (0=无) */
+
+    /* 来电媒体会话延迟创建 */
+    int setup_pending;               /**< 在setup_queue中等待创建媒体会话 */
+    int answer_pending;              /**< 媒体会话就绪前应用层已应答 */
+    struct list_head setup_node;     /**< setup_queue节点 */
+
+    /* Trickle ICE：dialog确认前产生的候选暂存，确认后经INFO发出 */
+    char trickle_buf[1024];          /**< 待发送的"a=candidate:..."行 */
+    int trickle_len;
+    int trickle_eoc;                 /**< 待发送a=end-of-candidates */
+    int trickle_retry;               /**< 上次INFO发送失败，待重发 */
+
     /* 双向链表节点 */
     struct list_head list_node;
 } lws_dialog_intl_t;
@@ -85,6 +110,8 @@ struct lws_agent_t {
     /* Dialog management */
     struct list_head dialogs;        /**< Dialog双向链表头 */
     int dialog_count;                 /**< Dialog数量 */
+    struct list_head setup_queue;    /**< 等待创建媒体会话的来电 (FIFO) */
+    lws_sess_sock_pool_t* sock_pool; /**< 预绑定的媒体socket池 */
 
     /* SIP registration */
     struct sip_uac_transaction_t* register_txn;
@@ -99,8 +126,37 @@ struct lws_agent_t {
     lws_dev_t* audio_playback_dev;   /**< Audio playback device (shared by all dialogs) */
     lws_dev_t* audio_record_dev;     /**< Audio recording device (shared by all dialogs) */
     int audio_codec;                 /**< Audio codec for all sessions */
+
+    /* Embedded registrar */
+    lws_loc_t* location;             /**< Location service (NULL if registrar disabled) */
+    char nonce_secret[40];           /**< Secret keying the digest nonces */
+    lws_auth_nonce_table_t nonces;   /**< Outstanding nonces and their nonce counts */
+
+    /* SIP MESSAGE (RFC 3428) */
+    struct list_head msg_inflight;   /**< 已发送、等待最终响应的MESSAGE */
+    struct list_head msg_queue;      /**< 超出窗口、等待发送的MESSAGE (FIFO) */
+    int msg_inflight_count;          /**< 在途MESSAGE数量 */
+    int msg_window;                  /**< 最大在途MESSAGE数量 */
+    uint32_t msg_next_id;            /**< 下一个消息ID */
 };
 
+/**
+ * @brief 出站MESSAGE上下文
+ *
+ * 直接发送的消息只记录ID和发送时间；排队的消息在结构体后
+ * 连续存放目标URI、Content-Type和消息体，发送后即不再使用。
+ */
+typedef struct {
+    lws_agent_t* agent;
+    uint32_t id;
+    uint64_t send_us;                /**< 请求发出时间（单调时钟，微秒） */
+    const char* target;              /**< 排队时有效 */
+    const char* content_type;        /**< 排队时有效 */
+    const void* body;                /**< 排队时有效 */
+    int body_len;
+    struct list_head node;
+} lws_msg_intl_t;
+
 /* ========================================
  * Forward declarations
  * ======================================== */
@@ -109,6 +165,7 @@ struct lws_agent_t {
 static void sess_on_sdp_ready(lws_sess_t* sess, const char* sdp, void* userdata);
 static void sess_on_connected(lws_sess_t* sess, void* userdata);
 static void sess_on_disconnected(lws_sess_t* sess, const char* reason, void* userdata);
+static void sess_on_dtmf(lws_sess_t* sess, char digit, int duration_ms, void* userdata);
 
 /* UAC callback for REGISTER/unREGISTER responses */
 static int uac_onreply_callback(void* param, const struct sip_message_t* reply,
@@ -136,6 +193,23 @@ static int sip_uas_onack(void* param, const struct sip_message_t* req,
 static int sip_uas_onbye(void* param, const struct sip_message_t* req,
                         struct sip_uas_transaction_t* t,
                         const struct cstring_t* id);
+static int sip_uas_onupdate(void* param, const struct sip_message_t* req,
+                           struct sip_uas_transaction_t* t,
+                           const struct cstring_t* id,
+                           const void* data, int bytes);
+static int sip_uas_onmessage(void* param, const struct sip_message_t* req,
+                            struct sip_uas_transaction_t* t,
+                            const struct cstring_t* id,
+                            const void* data, int bytes);
+static int sip_uas_oninfo(void* param, const struct sip_message_t* req,
+                         struct sip_uas_transaction_t* t,
+                         const struct cstring_t* id,
+                         const struct cstring_t* package,
+                         const void* data, int bytes);
+
+/* Mid-dialog offer/answer (re-INVITE/UPDATE) */
+static int dialog_apply_remote_sdp(lws_dialog_intl_t* dlg, const void* data, int bytes);
+static int dialog_send_reoffer(lws_agent_t* agent, lws_dialog_intl_t* dlg, int use_update);
 
 /* ========================================
  * Dialog management
@@ -194,6 +268,7 @@ static lws_dialog_intl_t* lws_agent_create_dialog(lws_agent_t* agent,
 
     dlg->agent = agent;
     dlg->state = LWS_DIALOG_STATE_NULL;
+    dlg->media_dir = LWS_MEDIA_DIR_SENDRECV;
 
     /* 插入链表头 */
     list_insert_after(&dlg->list_node, &agent->dialogs);
@@ -212,6 +287,11 @@ static void lws_agent_destroy_dialog(lws_agent_t* agent, lws_dialog_intl_t* dlg)
     list_remove(&dlg->list_node);
     agent->dialog_count--;
 
+    if (dlg->setup_pending) {
+        list_remove(&dlg->setup_node);
+        dlg->setup_pending = 0;
+    }
+
     /* NOTE: Do NOT manually release invite_txn here!
      * libsip manages the lifecycle of transactions that were successfully sent.
      * Manually releasing would cause double-release and assertion failures.
@@ -233,6 +313,26 @@ static void lws_agent_destroy_dialog(lws_agent_t* agent, lws_dialog_intl_t* dlg)
     lws_free(dlg);
 }
 
+/**
+ * @brief 单调时钟（毫秒），用于registrar过期和re-INVITE重试
+ */
+static uint64_t agent_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 单调时钟（微秒），用于MESSAGE投递时延
+ */
+static uint64_t agent_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
 /* ========================================
  * Media session callbacks
  * ======================================== */
@@ -266,6 +366,11 @@ static void sess_on_sdp_ready(lws_sess_t* sess, const char* sdp, void* userdata)
 
         /* 添加Content-Type header */
         sip_uac_add_header(dlg->invite_txn, "Content-Type", "application/sdp");
+        if (agent->config.trickle_ice) {
+            /* RFC 8840 §5：候选经INFO (Info-Package: trickle-ice) 交换 */
+            sip_uac_add_header(dlg->invite_txn, "Supported", "trickle-ice");
+            sip_uac_add_header(dlg->invite_txn, "Recv-Info", "trickle-ice");
+        }
 
         /* 发送INVITE */
         int ret = sip_uac_send(dlg->invite_txn, sdp, strlen(sdp),
@@ -288,6 +393,10 @@ static void sess_on_sdp_ready(lws_sess_t* sess, const char* sdp, void* userdata)
 
         /* 添加Content-Type header */
         sip_uas_add_header(dlg->uas_txn, "Content-Type", "application/sdp");
+        if (agent->config.trickle_ice) {
+            sip_uas_add_header(dlg->uas_txn, "Supported", "trickle-ice");
+            sip_uas_add_header(dlg->uas_txn, "Recv-Info", "trickle-ice");
+        }
 
         /* 发送200 OK */
         int ret = sip_uas_reply(dlg->uas_txn, 200, sdp, strlen(sdp), agent);
@@ -355,6 +464,421 @@ static void sess_on_disconnected(lws_sess_t* sess, const char* reason, void* use
     /* TODO: 可以在这里通知应用层媒体已断开 */
 }
 
+/**
+ * @brief Trickle INFO最终响应
+ */
+static int uac_ontrickle(void* param, const struct sip_message_t* reply,
+                         struct sip_uac_transaction_t* t, int code)
+{
+    LWS_UNUSED(param);
+    LWS_UNUSED(reply);
+    LWS_UNUSED(t);
+
+    if (code >= 300) {
+        lws_log_warn(LWS_ERR_SIP_SEND, "Trickle ICE INFO rejected with %d\n", code);
+    }
+    return 0;
+}
+
+/**
+ * @brief sdpfrag的头部：ICE凭据、m=行和a=mid (RFC 8840 §9.1)
+ *
+ * 取自发给对端的本地SDP：ufrag标识候选所属的ICE会话，m=行（端口为9）
+ * 和a=mid标识候选所属的媒体流。
+ */
+static int trickle_write_header(const char* local_sdp, char* buf, int size)
+{
+    lws_sdp_t desc;
+    lws_sdp_str_t ufrag, pwd;
+    const lws_sdp_media_t* m;
+    int len;
+    int n;
+
+    if (lws_sdp_parse(&desc, local_sdp, -1) != 0 || desc.media_count == 0) {
+        return -1;
+    }
+
+    /* 单一传输：候选属于第一个m=行（BUNDLE时为其标签） */
+    m = &desc.media[0];
+    if (!lws_sdp_media_ice(&desc, m, &ufrag, &pwd)) {
+        return -1;
+    }
+
+    len = snprintf(buf, size, "a=ice-ufrag:%.*s\r\na=ice-pwd:%.*s\r\nm=%.*s 9 %.*s",
+                   ufrag.n, ufrag.p, pwd.n, pwd.p, m->type.n, m->type.p,
+                   m->proto.n, m->proto.p);
+    if (len < 0 || len >= size) return -1;
+
+    for (int i = 0; i < m->fmt_count; i++) {
+        n = snprintf(buf + len, size - len, " %d", m->fmts[i].pt);
+        if (n < 0 || n >= size - len) return -1;
+        len += n;
+    }
+
+    n = snprintf(buf + len, size - len, "\r\n");
+    if (n < 0 || n >= size - len) return -1;
+    len += n;
+
+    if (m->mid.n > 0) {
+        n = snprintf(buf + len, size - len, "a=mid:%.*s\r\n", m->mid.n, m->mid.p);
+        if (n < 0 || n >= size - len) return -1;
+        len += n;
+    }
+    return len;
+}
+
+/**
+ * @brief 经SIP INFO发送暂存的候选（application/sdpfrag，Info-Package: trickle-ice）
+ *
+ * INFO只能在dialog内发送：主叫在200 OK后、被叫在ACK后才能发出，
+ * 之前产生的候选留在trickle_buf中。
+ */
+static void dialog_flush_trickle(lws_dialog_intl_t* dlg)
+{
+    lws_agent_t* agent = dlg->agent;
+    char body[sizeof(dlg->trickle_buf) + 640];
+    int len;
+    int n;
+    int ret;
+
+    if (dlg->state != LWS_DIALOG_STATE_CONFIRMED || !dlg->sip_dialog ||
+        (dlg->trickle_len == 0 && dlg->trickle_eoc != 1)) {
+        return;
+    }
+
+    len = trickle_write_header(dlg->local_sdp, body, sizeof(body));
+    if (len < 0) {
+        lws_log_error(LWS_ERR_SIP_SEND, "No ICE credentials in local SDP for trickle ICE\n");
+        return;
+    }
+
+    n = snprintf(body + len, sizeof(body) - len, "%.*s%s", dlg->trickle_len, dlg->trickle_buf,
+                 dlg->trickle_eoc == 1 ? "a=end-of-candidates\r\n" : "");
+    if (n < 0 || n >= (int)sizeof(body) - len) {
+        return;
+    }
+    len += n;
+
+    struct sip_uac_transaction_t* t = sip_uac_info(agent->sip_agent, dlg->sip_dialog,
+                                                   "trickle-ice", uac_ontrickle, agent);
+    if (!t) {
+        lws_log_error(LWS_ERR_SIP_SEND, "Failed to create trickle ICE INFO\n");
+        dlg->trickle_retry = 1;
+        return;
+    }
+    sip_uac_add_header(t, "Content-Type", "application/sdpfrag");
+    ret = sip_uac_send(t, body, len, &agent->sip_transport, agent);
+    sip_uac_transaction_release(t);
+    if (ret != 0) {
+        /* 保留待发送内容，下次flush（或lws_agent_loop）重发 */
+        lws_log_error(LWS_ERR_SIP_SEND, "Failed to send trickle ICE INFO\n");
+        dlg->trickle_retry = 1;
+        return;
+    }
+
+    /* 发送成功后才清空 */
+    dlg->trickle_retry = 0;
+    dlg->trickle_len = 0;
+    if (dlg->trickle_eoc == 1) {
+        dlg->trickle_eoc = 2;  /* 已发送 */
+    }
+}
+
+/**
+ * @brief 新本地候选回调（trickle ICE）
+ */
+static void sess_on_candidate(lws_sess_t* sess, const char* candidate, void* userdata)
+{
+    lws_dialog_intl_t* dlg = (lws_dialog_intl_t*)userdata;
+    LWS_UNUSED(sess);
+
+    /* SDP发出前产生的候选已包含在SDP中 */
+    if (!dlg || !dlg->agent->config.trickle_ice || !dlg->local_sdp[0]) {
+        return;
+    }
+
+    int n = snprintf(dlg->trickle_buf + dlg->trickle_len,
+                     sizeof(dlg->trickle_buf) - dlg->trickle_len, "a=%s\r\n", candidate);
+    if (n < 0 || n >= (int)sizeof(dlg->trickle_buf) - dlg->trickle_len) {
+        dlg->trickle_buf[dlg->trickle_len] = '\0';
+        lws_log_warn(LWS_ERROR, "Trickle ICE buffer full, candidate dropped\n");
+        return;
+    }
+    dlg->trickle_len += n;
+    dialog_flush_trickle(dlg);
+}
+
+/**
+ * @brief 本地候选收集完成回调
+ */
+static void sess_on_gathering_done(lws_sess_t* sess, void* userdata)
+{
+    lws_dialog_intl_t* dlg = (lws_dialog_intl_t*)userdata;
+    LWS_UNUSED(sess);
+
+    if (!dlg || !dlg->agent->config.trickle_ice || !dlg->local_sdp[0]) {
+        return;
+    }
+
+    dlg->trickle_eoc = 1;
+    dialog_flush_trickle(dlg);
+}
+
+/**
+ * @brief 收到RFC 4733 DTMF回调
+ */
+static void sess_on_dtmf(lws_sess_t* sess, char digit, int duration_ms, void* userdata)
+{
+    lws_dialog_intl_t* dlg = (lws_dialog_intl_t*)userdata;
+    LWS_UNUSED(sess);
+
+    if (!dlg || !dlg->agent->handler.on_dtmf) {
+        return;
+    }
+
+    dlg->agent->handler.on_dtmf(dlg->agent, &dlg->public, digit, duration_ms,
+                                dlg->agent->handler.userdata);
+}
+
+/**
+ * @brief 为dialog创建媒体会话（主叫、被叫共用同一份配置）
+ *
+ * 以lws_sess_init_audio_config的默认值为基础（采样率、RTCP、jitter buffer），
+ * 再叠加agent的设备和语音处理配置。
+ */
+static lws_sess_t* dialog_create_sess(lws_agent_t* agent, lws_dialog_intl_t* dlg,
+                                      lws_sess_sock_pool_t* sock_pool)
+{
+    lws_sess_config_t sess_config;
+    lws_sess_init_audio_config(&sess_config,
+                               agent->config.stun_server[0] ? agent->config.stun_server : NULL,
+                               agent->audio_codec);
+    sess_config.sock_pool = sock_pool;
+
+    /* Copy device references from agent */
+    sess_config.audio_capture_dev = agent->audio_capture_dev;
+    sess_config.audio_playback_dev = agent->audio_playback_dev;
+    sess_config.audio_record_dev = agent->audio_record_dev;
+    sess_config.comfort_noise = 1;
+    sess_config.dtx = agent->config.enable_dtx;
+    sess_config.enable_aec = agent->config.enable_voice_proc;
+    sess_config.enable_ns = agent->config.enable_voice_proc;
+    sess_config.enable_agc = agent->config.enable_voice_proc;
+    sess_config.enable_ice = agent->config.enable_ice;
+    sess_config.trickle_ice = agent->config.trickle_ice;
+    sess_config.ice_lite = agent->config.ice_lite;
+    sess_config.symmetric_rtp = 1;              /* NAT后的话机在SDP中只有私网地址 */
+
+    lws_sess_handler_t sess_handler;
+    memset(&sess_handler, 0, sizeof(sess_handler));
+    sess_handler.on_sdp_ready = sess_on_sdp_ready;
+    sess_handler.on_connected = sess_on_connected;
+    sess_handler.on_disconnected = sess_on_disconnected;
+    sess_handler.on_dtmf = sess_on_dtmf;
+    sess_handler.on_candidate = sess_on_candidate;
+    sess_handler.on_gathering_done = sess_on_gathering_done;
+    sess_handler.userdata = dlg;
+
+    return lws_sess_create(&sess_config, &sess_handler);
+}
+
+/* ========================================
+ * Embedded registrar
+ * ======================================== */
+
+#define REGISTRAR_NONCE_MAX_AGE     300     /* 秒 */
+#define REGISTRAR_DEFAULT_EXPIRES   3600    /* 秒 */
+
+/* 每次lws_agent_loop最多创建的来电媒体会话数 */
+#define AGENT_SETUP_BATCH           4
+
+/* 默认最大在途MESSAGE数量 */
+#define AGENT_MESSAGE_WINDOW        64
+
+/**
+ * @brief 规范化AOR："sip:user@host"，host转小写并去掉端口
+ */
+static void registrar_make_aor(const char* user, size_t user_len,
+                               const char* host, size_t host_len,
+                               char* aor, size_t size)
+{
+    char lower[LWS_MAX_DOMAIN_LEN];
+    size_t i;
+
+    for (i = 0; i < host_len && i < sizeof(lower) - 1; i++) {
+        if (host[i] == ':' || host[i] == ';') {
+            break;
+        }
+        lower[i] = (char)tolower((unsigned char)host[i]);
+    }
+    lower[i] = '\0';
+
+    snprintf(aor, size, "sip:%.*s@%s", (int)user_len, user, lower);
+}
+
+/**
+ * @brief 从URI中提取host和port（"<sip:user@host:port;params>"）
+ */
+static int registrar_uri_to_addr(const char* uri, size_t len, lws_addr_t* addr)
+{
+    const char* end = uri + len;
+    const char* p = uri;
+    const char* at;
+
+    if (p < end && *p == '<') {
+        p++;
+    }
+    if ((size_t)(end - p) > 4 && strncasecmp(p, "sips:", 5) == 0) {
+        p += 5;
+    } else if ((size_t)(end - p) > 3 && strncasecmp(p, "sip:", 4) == 0) {
+        p += 4;
+    }
+
+    at = memchr(p, '@', end - p);
+    if (at) {
+        p = at + 1;
+    }
+
+    const char* host = p;
+    while (p < end && *p != ':' && *p != ';' && *p != '>' && *p != '?' && *p != ' ') {
+        p++;
+    }
+    if (p == host || (size_t)(p - host) >= sizeof(addr->ip)) {
+        return -1;
+    }
+
+    memcpy(addr->ip, host, p - host);
+    addr->ip[p - host] = '\0';
+    addr->port = (p < end && *p == ':') ? (uint16_t)atoi(p + 1) : 5060;
+    if (addr->port == 0) {
+        addr->port = 5060;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 根据Request-URI解析发送目标
+ *
+ * 从已编码的请求行解析，重传时使用同一份数据，目标保持一致。
+ * Request-URI是本域已注册的AOR时发往其Contact，否则发往URI中的主机。
+ *
+ * @return 0已解析，-1使用默认路由（registrar）
+ */
+static int registrar_resolve_request(lws_agent_t* agent, const void* data,
+                                     size_t bytes, lws_addr_t* to)
+{
+    const char* p = (const char*)data;
+    const char* end = p + bytes;
+
+    /* 响应不走这里 */
+    if (bytes < 8 || strncmp(p, "SIP/2.0", 7) == 0) {
+        return -1;
+    }
+
+    const char* uri = memchr(p, ' ', end - p);
+    if (!uri) {
+        return -1;
+    }
+    uri++;
+    const char* uri_end = memchr(uri, ' ', end - uri);
+    if (!uri_end) {
+        return -1;
+    }
+
+    /* user@host */
+    const char* scheme_end = memchr(uri, ':', uri_end - uri);
+    const char* at = memchr(uri, '@', uri_end - uri);
+    if (scheme_end && at && at > scheme_end) {
+        char aor[LWS_MAX_URI_LEN];
+        lws_loc_contact_t contact;
+
+        registrar_make_aor(scheme_end + 1, at - scheme_end - 1,
+                           at + 1, uri_end - at - 1, aor, sizeof(aor));
+        if (lws_loc_lookup(agent->location, aor, &contact, 1, agent_now_ms()) > 0) {
+            return registrar_uri_to_addr(contact.contact, strlen(contact.contact), to);
+        }
+    }
+
+    /* 未注册：仅当没有配置上游registrar时直接发往URI主机 */
+    if (agent->config.registrar[0] != '\0') {
+        return -1;
+    }
+
+    return registrar_uri_to_addr(uri, uri_end - uri, to);
+}
+
+/**
+ * @brief 校验REGISTER的Digest凭证
+ * @return 0通过，1 nonce过期（stale），-1需要质询
+ */
+static int registrar_authenticate(lws_agent_t* agent, const struct sip_message_t* req,
+                                  const char* realm)
+{
+    const struct cstring_t* header = sip_message_get_header_by_name(req, "Authorization");
+    if (!header || header->n == 0) {
+        return -1;
+    }
+
+    char value[1024];
+    snprintf(value, sizeof(value), "%.*s", (int)header->n, header->p);
+
+    lws_auth_authorization_t auth;
+    if (lws_auth_parse_authorization(value, &auth) < 0 || strcmp(auth.realm, realm) != 0) {
+        return -1;
+    }
+
+    /* 凭证的用户名必须与To中的用户一致，防止用A的密码注册B */
+    if ((size_t)req->to.uri.user.n != strlen(auth.username) ||
+        strncmp(req->to.uri.user.p, auth.username, req->to.uri.user.n) != 0) {
+        lws_log_warn(LWS_ERR_SIP_AUTH, "[REGISTRAR] Auth user %s does not match To\n",
+                     auth.username);
+        return -1;
+    }
+
+    /* 摘要URI必须是本请求的Request-URI，防止截获的凭证用于其他目标 */
+    const struct sip_uri_t* ruri = &req->u.c.uri;
+    char request_uri[LWS_MAX_URI_LEN];
+    snprintf(request_uri, sizeof(request_uri), "%.*s:%.*s%s%.*s",
+             (int)ruri->scheme.n, ruri->scheme.p,
+             (int)ruri->user.n, ruri->user.p, ruri->user.n ? "@" : "",
+             (int)ruri->host.n, ruri->host.p);
+    if (lws_auth_check_uri(&auth, request_uri) != 0) {
+        lws_log_warn(LWS_ERR_SIP_AUTH, "[REGISTRAR] Auth uri %s does not match %s\n",
+                     auth.uri, request_uri);
+        return -1;
+    }
+
+    char password[LWS_MAX_PASSWORD_LEN];
+    if (agent->handler.on_registrar_auth(agent, auth.username, realm, password,
+                                         sizeof(password), agent->handler.userdata) != 0) {
+        return -1;
+    }
+
+    int ret = lws_auth_verify_response(&auth, "REGISTER", password);
+    memset(password, 0, sizeof(password));
+    if (ret != 0) {
+        return -1;
+    }
+
+    /* 摘要正确但nonce过期：让客户端用新nonce重试 */
+    if (lws_auth_check_nonce(agent->nonce_secret, auth.nonce,
+                             (uint32_t)time(NULL), REGISTRAR_NONCE_MAX_AGE) != 0) {
+        return 1;
+    }
+
+    /* 每个(nonce, nc)只接受一次，截获的REGISTER无法重放 */
+    return lws_auth_nonce_use(&agent->nonces, &auth) == 0 ? 0 : 1;
+}
+
+static void registrar_on_expired(const char* aor, const char* contact, void* userdata)
+{
+    LWS_UNUSED(userdata);
+    LWS_UNUSED(aor);
+    LWS_UNUSED(contact);
+    lws_log_debug("[REGISTRAR] Binding expired: %s -> %s\n", aor, contact);
+}
+
 /* ========================================
  * sip_transport_t implementation
  * ======================================== */
@@ -389,6 +913,15 @@ static int sip_transport_send(void* transport, const void* data, size_t bytes)
     /* 发送到registrar server */
     lws_addr_t to;
 
+    /* Registrar模式：请求按Request-URI路由到已注册的Contact */
+    if (agent->location && registrar_resolve_request(agent, data, bytes, &to) == 0) {
+        if (lws_trans_send(agent->trans, data, (int)bytes, &to) < 0) {
+            lws_log_error(LWS_ERR_SIP_SEND, "Failed to send SIP message\n");
+            return -1;
+        }
+        return 0;
+    }
+
     /* Parse registrar address - may be "host" or "host:port" format */
     const char* colon = strchr(agent->config.registrar, ':');
     if (colon) {
@@ -480,108 +1013,278 @@ static int sip_uas_onregister(void* param, const struct sip_message_t* req,
                               struct sip_uas_transaction_t* t, const char* user,
                               const char* location, int expires)
 {
-    LWS_UNUSED(req);
+    lws_agent_t* agent = (lws_agent_t*)param;
     LWS_UNUSED(user);
-    LWS_UNUSED(location);
-    LWS_UNUSED(expires);
 
-    /* Not supported as UAS (we're UAC only for now) */
-    sip_uas_reply(t, 405, NULL, 0, param);  /* Method Not Allowed */
+    if (!agent->location) {
+        /* Registrar mode disabled: we're UAC only */
+        sip_uas_reply(t, 405, NULL, 0, param);  /* Method Not Allowed */
+        return 0;
+    }
 
-    return 0;
-}
+    const char* realm = agent->config.registrar_realm[0] ?
+                        agent->config.registrar_realm : agent->config.domain;
+
+    /* Digest鉴权（RFC 3261 22.4） */
+    if (agent->handler.on_registrar_auth) {
+        int auth = registrar_authenticate(agent, req, realm);
+        if (auth != 0) {
+            char nonce[LWS_AUTH_NONCE_LEN + 1];
+            char challenge[512];
+            lws_auth_nonce_issue(&agent->nonces, agent->nonce_secret, (uint32_t)time(NULL),
+                                 nonce, sizeof(nonce));
+            lws_auth_build_challenge_header(realm, nonce, auth > 0,
+                                            challenge, sizeof(challenge));
+            sip_uas_add_header(t, "WWW-Authenticate", challenge);
+            sip_uas_reply(t, 401, NULL, 0, param);  /* Unauthorized */
+            return 0;
+        }
+    }
 
-static int sip_uas_oninvite(void* param, const struct sip_message_t* req,
-                            struct sip_uas_transaction_t* t,
-                            struct sip_dialog_t* redialog,
-                            const struct cstring_t* id,
-                            const void* data, int bytes)
-{
-    lws_agent_t* agent = (lws_agent_t*)param;
-    LWS_UNUSED(id);
+    /* AOR取自To头 */
+    char aor[LWS_MAX_URI_LEN];
+    registrar_make_aor(req->to.uri.user.p, req->to.uri.user.n,
+                       req->to.uri.host.p, req->to.uri.host.n, aor, sizeof(aor));
 
-    /* Extract call-ID */
-    char call_id[LWS_MAX_CALL_ID_LEN];
-    snprintf(call_id, sizeof(call_id), "%.*s", (int)req->callid.n, req->callid.p);
+    int max_expires = agent->config.registrar_max_expires > 0 ?
+                      agent->config.registrar_max_expires : REGISTRAR_DEFAULT_EXPIRES;
+    if (expires < 0) {
+        expires = REGISTRAR_DEFAULT_EXPIRES;
+    }
+    expires = LWS_MIN(expires, max_expires);
 
-    /* Create dialog */
-    lws_dialog_intl_t* dlg = lws_agent_create_dialog(agent, call_id, NULL, NULL);
-    if (!dlg) {
-        sip_uas_reply(t, 500, NULL, 0, param);  /* Internal Server Error */
-        return -1;
-    }
-
-    dlg->sip_dialog = redialog;
-    dlg->state = LWS_DIALOG_STATE_INCOMING;
-    dlg->public.direction = LWS_DIALOG_INCOMING;
-
-    /* 保存UAS transaction (增加引用计数) */
-    sip_uas_transaction_addref(t);
-    dlg->uas_txn = t;
+    uint64_t now = agent_now_ms();
 
-    /* 保存remote SDP */
-    if (data && bytes > 0) {
-        int len = LWS_MIN(bytes, (int)sizeof(dlg->remote_sdp) - 1);
-        memcpy(dlg->remote_sdp, data, len);
-        dlg->remote_sdp[len] = '\0';
+    if (!location || !location[0] || strcmp(location, "*") == 0) {
+        if (location && location[0] == '*') {
+            /* Contact: * 只允许 Expires: 0 */
+            if (expires != 0) {
+                sip_uas_reply(t, 400, NULL, 0, param);  /* Bad Request */
+                return 0;
+            }
+            int removed = lws_loc_unbind_all(agent->location, aor);
+            LWS_UNUSED(removed);  /* 仅用于日志 */
+            lws_log_info("[REGISTRAR] %s: removed %d bindings\n", aor, removed);
+        }
+        /* 无Contact：仅查询当前绑定 */
+    } else {
+        int ret = lws_loc_bind(agent->location, aor, location, expires, now);
+        if (ret != LWS_OK) {
+            lws_log_error(ret, "[REGISTRAR] Failed to bind %s -> %s\n", aor, location);
+            sip_uas_reply(t, 500, NULL, 0, param);  /* Server Internal Error */
+            return 0;
+        }
+        lws_log_info("[REGISTRAR] %s -> %s (expires=%d)\n", aor, location, expires);
+    }
+
+    /* 200 OK携带当前全部绑定 */
+    lws_loc_contact_t contacts[LWS_LOC_MAX_CONTACTS];
+    int count = lws_loc_lookup(agent->location, aor, contacts, LWS_LOC_MAX_CONTACTS, now);
+    int i;
+    for (i = 0; i < count; i++) {
+        char contact[LWS_MAX_URI_LEN + 32];
+        if (contacts[i].contact[0] == '<') {
+            snprintf(contact, sizeof(contact), "%s;expires=%d",
+                     contacts[i].contact, contacts[i].expires);
+        } else {
+            snprintf(contact, sizeof(contact), "<%s>;expires=%d",
+                     contacts[i].contact, contacts[i].expires);
+        }
+        sip_uas_add_header(t, "Contact", contact);
     }
 
-    /* 创建媒体会话 (UAS, 使用agent的设备配置) */
-    lws_sess_config_t sess_config;
-    memset(&sess_config, 0, sizeof(sess_config));
-    sess_config.enable_audio = 1;
-    sess_config.enable_video = 0;
-    sess_config.media_dir = LWS_MEDIA_DIR_SENDRECV;  /* 双向媒体 */
-
-    /* Copy device references from agent */
-    sess_config.audio_capture_dev = agent->audio_capture_dev;
-    sess_config.audio_playback_dev = agent->audio_playback_dev;
-    sess_config.audio_record_dev = agent->audio_record_dev;
-    sess_config.audio_codec = agent->audio_codec;
-
-    lws_sess_handler_t sess_handler;
-    memset(&sess_handler, 0, sizeof(sess_handler));
-    sess_handler.on_sdp_ready = sess_on_sdp_ready;
-    sess_handler.on_connected = sess_on_connected;
-    sess_handler.on_disconnected = sess_on_disconnected;
-    sess_handler.userdata = dlg;
+    sip_uas_reply(t, 200, NULL, 0, param);
+    return 0;
+}
 
-    dlg->sess = lws_sess_create(&sess_config, &sess_handler);
+/**
+ * @brief 为来电创建媒体会话（由lws_agent_loop从setup_queue中调用）
+ */
+static int dialog_setup_incoming_media(lws_agent_t* agent, lws_dialog_intl_t* dlg)
+{
+    /* 创建媒体会话 (UAS, 使用agent的设备配置和预绑定socket) */
+    dlg->sess = dialog_create_sess(agent, dlg, agent->sock_pool);
     if (!dlg->sess) {
         lws_log_error(LWS_ERR_MEDIA_SESSION, "Failed to create media session for UAS\n");
-        lws_agent_destroy_dialog(agent, dlg);
-        sip_uas_reply(t, 500, NULL, 0, param);  /* Internal Server Error */
-        return -1;
+        return 500;  /* Internal Server Error */
     }
 
-    lws_log_info("[MEDIA_SESSION] Media session created for incoming call (Call-ID: %s)\n", call_id);
+    lws_log_info("[MEDIA_SESSION] Media session created for incoming call (Call-ID: %s)\n",
+                 dlg->public.call_id);
 
     /* 设置远程SDP到媒体会话层 (如果INVITE包含SDP) */
-    if (data && bytes > 0) {
+    if (dlg->remote_sdp[0]) {
         int ret = lws_sess_set_remote_sdp(dlg->sess, dlg->remote_sdp);
         if (ret != 0) {
             lws_log_error(LWS_ERR_MEDIA_SESSION, "Failed to set remote SDP for UAS\n");
-            lws_agent_destroy_dialog(agent, dlg);
-            sip_uas_reply(t, 488, NULL, 0, param);  /* Not Acceptable Here */
-            return -1;
+            return 488;  /* Not Acceptable Here */
         }
         lws_log_info("[MEDIA_SESSION] Remote SDP set from INVITE\n");
     }
 
-    /* 解析From地址 */
-    lws_sip_addr_t from_addr;
-    memset(&from_addr, 0, sizeof(from_addr));
+    return 0;
+}
+
+/**
+ * @brief 处理setup_queue，每次最多max_count个，避免突发来电占满一次循环
+ */
+static void agent_process_setup_queue(lws_agent_t* agent, int max_count)
+{
+    while (max_count-- > 0 && !list_empty(&agent->setup_queue)) {
+        lws_dialog_intl_t* dlg = list_entry(agent->setup_queue.next,
+                                            lws_dialog_intl_t, setup_node);
+        list_remove(&dlg->setup_node);
+        dlg->setup_pending = 0;
+
+        int code = dialog_setup_incoming_media(agent, dlg);
+        if (code != 0) {
+            lws_dialog_state_t old_state = dlg->state;
+
+            if (dlg->uas_txn) {
+                sip_uas_reply(dlg->uas_txn, code, NULL, 0, agent);
+            }
+            dlg->state = LWS_DIALOG_STATE_FAILED;
+
+            if (agent->handler.on_dialog_state_changed) {
+                agent->handler.on_dialog_state_changed(agent, &dlg->public, old_state,
+                                                       LWS_DIALOG_STATE_FAILED,
+                                                       agent->handler.userdata);
+            }
+            lws_agent_destroy_dialog(agent, dlg);
+            continue;
+        }
+
+        /* 应用层已在会话就绪前应答 */
+        if (dlg->answer_pending) {
+            dlg->answer_pending = 0;
+            lws_agent_answer_call(agent, &dlg->public);
+        }
+    }
+}
+
+/**
+ * @brief 回复会话中的offer：200携带本端SDP (answer，或无SDP请求时的offer)
+ */
+static void uas_reply_with_local_sdp(lws_dialog_intl_t* dlg, struct sip_uas_transaction_t* t)
+{
+    const char* sdp = lws_sess_get_local_sdp(dlg->sess);
+
+    if (sdp) {
+        LWS_STRNCPY(dlg->local_sdp, sdp, sizeof(dlg->local_sdp));
+        sip_uas_add_header(t, "Content-Type", "application/sdp");
+        sip_uas_reply(t, 200, sdp, (int)strlen(sdp), dlg->agent);
+    } else {
+        sip_uas_reply(t, 200, NULL, 0, dlg->agent);
+    }
+}
+
+/**
+ * @brief re-INVITE：在已有媒体会话上增量应用新的offer
+ */
+static int sip_uas_onreinvite(lws_agent_t* agent, const char* call_id,
+                              struct sip_uas_transaction_t* t,
+                              struct sip_dialog_t* dialog,
+                              const void* data, int bytes)
+{
+    lws_dialog_intl_t* dlg = lws_agent_find_dialog(agent, call_id);
+    if (!dlg || !dlg->sess) {
+        sip_uas_reply(t, 481, NULL, 0, agent);  /* Call/Transaction Does Not Exist */
+        return 0;
+    }
+
+    lws_log_info("Received re-INVITE (Call-ID: %s)\n", call_id);
+
+    /* 双方同时发起offer (glare)，RFC 3261 §14.2 */
+    if (dlg->reoffer_pending) {
+        sip_uas_reply(t, 491, NULL, 0, agent);  /* Request Pending */
+        return 0;
+    }
+
+    if (!dlg->sip_dialog) {
+        dlg->sip_dialog = dialog;
+    }
+
+    /* 无SDP的re-INVITE：200携带本端offer，answer在ACK中 */
+    if (!data || bytes <= 0) {
+        lws_sess_set_offer_pending(dlg->sess, 1);
+    } else if (dialog_apply_remote_sdp(dlg, data, bytes) < 0) {
+        sip_uas_reply(t, 488, NULL, 0, agent);  /* Not Acceptable Here */
+        return 0;
+    }
+
+    uas_reply_with_local_sdp(dlg, t);
+    return 0;
+}
 
-    /* 解析From URI */
-    snprintf(from_addr.username, LWS_MAX_USERNAME_LEN, "%.*s",
+/**
+ * @brief 从请求的From头解析地址
+ */
+static void sip_request_from_addr(const struct sip_message_t* req, lws_sip_addr_t* addr)
+{
+    memset(addr, 0, sizeof(*addr));
+
+    snprintf(addr->username, LWS_MAX_USERNAME_LEN, "%.*s",
              (int)req->from.uri.user.n, req->from.uri.user.p);
-    snprintf(from_addr.domain, LWS_MAX_DOMAIN_LEN, "%.*s",
+    snprintf(addr->domain, LWS_MAX_DOMAIN_LEN, "%.*s",
              (int)req->from.uri.host.n, req->from.uri.host.p);
-    from_addr.port = 0;  /* Port is embedded in host string, use default */
+    addr->port = 0;  /* Port is embedded in host string, use default */
     if (req->from.nickname.n > 0) {
-        snprintf(from_addr.nickname, LWS_MAX_NICKNAME_LEN, "%.*s",
+        snprintf(addr->nickname, LWS_MAX_NICKNAME_LEN, "%.*s",
                  (int)req->from.nickname.n, req->from.nickname.p);
     }
+}
+
+static int sip_uas_oninvite(void* param, const struct sip_message_t* req,
+                            struct sip_uas_transaction_t* t,
+                            struct sip_dialog_t* redialog,
+                            const struct cstring_t* id,
+                            const void* data, int bytes)
+{
+    lws_agent_t* agent = (lws_agent_t*)param;
+    LWS_UNUSED(id);
+
+    /* Extract call-ID */
+    char call_id[LWS_MAX_CALL_ID_LEN];
+    snprintf(call_id, sizeof(call_id), "%.*s", (int)req->callid.n, req->callid.p);
+
+    /* libsip仅对已建立dialog内的INVITE传入redialog */
+    if (redialog) {
+        return sip_uas_onreinvite(agent, call_id, t, redialog, data, bytes);
+    }
+
+    /* Create dialog */
+    lws_dialog_intl_t* dlg = lws_agent_create_dialog(agent, call_id, NULL, NULL);
+    if (!dlg) {
+        sip_uas_reply(t, 500, NULL, 0, param);  /* Internal Server Error */
+        return -1;
+    }
+
+    dlg->state = LWS_DIALOG_STATE_INCOMING;
+    dlg->public.direction = LWS_DIALOG_INCOMING;
+
+    /* 保存UAS transaction (增加引用计数) */
+    sip_uas_transaction_addref(t);
+    dlg->uas_txn = t;
+
+    /* 保存remote SDP */
+    if (data && bytes > 0) {
+        int len = LWS_MIN(bytes, (int)sizeof(dlg->remote_sdp) - 1);
+        memcpy(dlg->remote_sdp, data, len);
+        dlg->remote_sdp[len] = '\0';
+    }
+
+    /*
+     * 立即回复100 Trying，媒体会话（socket、SDP协商、candidate收集）
+     * 放入setup_queue由lws_agent_loop创建，INVITE突发时不阻塞信令处理
+     */
+    sip_uas_reply(t, 100, NULL, 0, param);
+
+    dlg->setup_pending = 1;
+    list_insert_before(&dlg->setup_node, &agent->setup_queue);
+
+    /* 解析From地址 */
+    lws_sip_addr_t from_addr;
+    sip_request_from_addr(req, &from_addr);
 
     /* 通知应用层 */
     if (agent->handler.on_incoming_call) {
@@ -590,7 +1293,7 @@ static int sip_uas_oninvite(void* param, const struct sip_message_t* req,
     }
 
     /* 应用层应该调用lws_agent_answer_call()来应答，或lws_agent_reject_call()拒绝 */
-    /* 不在这里自动回复，让应用层决定 */
+    /* 不在这里自动回复，让应用层决定；媒体会话未就绪时应答会被延迟执行 */
 
     return 0;
 }
@@ -601,16 +1304,39 @@ static int sip_uas_onack(void* param, const struct sip_message_t* req,
                         const struct cstring_t* id, int code,
                         const void* data, int bytes)
 {
-    LWS_UNUSED(param);
-    LWS_UNUSED(req);
+    lws_agent_t* agent = (lws_agent_t*)param;
     LWS_UNUSED(t);
-    LWS_UNUSED(dialog);
     LWS_UNUSED(id);
-    LWS_UNUSED(code);
-    LWS_UNUSED(data);
-    LWS_UNUSED(bytes);
 
     /* ACK received, call established */
+    if (!dialog || code < 200 || code >= 300) {
+        return 0;
+    }
+
+    char call_id[LWS_MAX_CALL_ID_LEN];
+    snprintf(call_id, sizeof(call_id), "%.*s", (int)req->callid.n, req->callid.p);
+
+    lws_dialog_intl_t* dlg = lws_agent_find_dialog(agent, call_id);
+    if (!dlg) {
+        return 0;
+    }
+
+    /* 被叫方在ACK时才拿到dialog，后续BYE/re-INVITE需要 */
+    if (!dlg->sip_dialog) {
+        dlg->sip_dialog = dialog;
+    }
+    dialog_flush_trickle(dlg);
+
+    /* 无SDP的re-INVITE：answer在ACK中，ACK结束200中的offer */
+    if (dlg->sess && dlg->state == LWS_DIALOG_STATE_CONFIRMED) {
+        if (data && bytes > 0) {
+            dialog_apply_remote_sdp(dlg, data, bytes);
+        }
+        if (!dlg->reoffer_pending) {
+            lws_sess_set_offer_pending(dlg->sess, 0);
+        }
+    }
+
     return 0;
 }
 
@@ -630,24 +1356,270 @@ static int sip_uas_onbye(void* param, const struct sip_message_t* req,
 
     /* Find dialog */
     lws_dialog_intl_t* dlg = lws_agent_find_dialog(agent, call_id);
-    if (dlg) {
-        lws_dialog_state_t old_state = dlg->state;
-        dlg->state = LWS_DIALOG_STATE_TERMINATED;
+    if (dlg) {
+        lws_dialog_state_t old_state = dlg->state;
+        dlg->state = LWS_DIALOG_STATE_TERMINATED;
+
+        /* 通知应用层 */
+        if (agent->handler.on_dialog_state_changed) {
+            agent->handler.on_dialog_state_changed(agent, &dlg->public,
+                                                   old_state, LWS_DIALOG_STATE_TERMINATED,
+                                                   agent->handler.userdata);
+        }
+
+        /* 销毁dialog */
+        lws_agent_destroy_dialog(agent, dlg);
+    }
+
+    /* Send 200 OK */
+    sip_uas_reply(t, 200, NULL, 0, param);
+
+    return 0;
+}
+
+static int sip_uas_onupdate(void* param, const struct sip_message_t* req,
+                           struct sip_uas_transaction_t* t,
+                           const struct cstring_t* id,
+                           const void* data, int bytes)
+{
+    lws_agent_t* agent = (lws_agent_t*)param;
+    LWS_UNUSED(id);
+
+    char call_id[LWS_MAX_CALL_ID_LEN];
+    snprintf(call_id, sizeof(call_id), "%.*s", (int)req->callid.n, req->callid.p);
+
+    lws_dialog_intl_t* dlg = lws_agent_find_dialog(agent, call_id);
+    if (!dlg || !dlg->sess) {
+        sip_uas_reply(t, 481, NULL, 0, param);  /* Call/Transaction Does Not Exist */
+        return 0;
+    }
+
+    lws_log_info("Received UPDATE (Call-ID: %s)\n", call_id);
+
+    /* 不带SDP的UPDATE（如session refresh），直接确认 */
+    if (!data || bytes <= 0) {
+        sip_uas_reply(t, 200, NULL, 0, param);
+        return 0;
+    }
+
+    if (dlg->reoffer_pending) {
+        sip_uas_reply(t, 491, NULL, 0, param);  /* Request Pending */
+        return 0;
+    }
+
+    if (dialog_apply_remote_sdp(dlg, data, bytes) < 0) {
+        sip_uas_reply(t, 488, NULL, 0, param);  /* Not Acceptable Here */
+        return 0;
+    }
+
+    uas_reply_with_local_sdp(dlg, t);
+    return 0;
+}
+
+static int sip_uas_onmessage(void* param, const struct sip_message_t* req,
+                            struct sip_uas_transaction_t* t,
+                            const struct cstring_t* id,
+                            const void* data, int bytes)
+{
+    lws_agent_t* agent = (lws_agent_t*)param;
+    LWS_UNUSED(id);
+
+    if (!agent->handler.on_message) {
+        sip_uas_reply(t, 405, NULL, 0, param);  /* Method Not Allowed */
+        return 0;
+    }
+
+    /* RFC 3428: 接收即确认，不等待应用层处理 */
+    sip_uas_reply(t, 200, NULL, 0, param);
+
+    lws_sip_addr_t from_addr;
+    sip_request_from_addr(req, &from_addr);
+
+    char content_type[LWS_MAX_CONTENT_TYPE_LEN];
+    const struct cstring_t* ctype = sip_message_get_header_by_name(req, "Content-Type");
+    if (ctype && ctype->n > 0) {
+        snprintf(content_type, sizeof(content_type), "%.*s", (int)ctype->n, ctype->p);
+    } else {
+        snprintf(content_type, sizeof(content_type), "text/plain");
+    }
+
+    agent->handler.on_message(agent, &from_addr, content_type,
+                              data, (data && bytes > 0) ? bytes : 0,
+                              agent->handler.userdata);
+    return 0;
+}
+
+/**
+ * @brief 解析DTMF INFO消息体
+ *
+ * application/dtmf-relay: "Signal=5\r\nDuration=160\r\n"
+ * application/dtmf:       "5"
+ *
+ * @return 0成功，-1无法识别
+ */
+static int parse_dtmf_info(const char* ctype, int ctype_len, const char* body, int len,
+                           char* digit, int* duration_ms)
+{
+    static const char valid[] = "0123456789*#ABCD";
+    char buf[256];
+    const char* p;
+
+    if (!body || len <= 0) {
+        return -1;
+    }
+    snprintf(buf, sizeof(buf), "%.*s", len, body);
+
+    *digit = '\0';
+    *duration_ms = 0;
+    if (ctype_len >= 22 && strncasecmp(ctype, "application/dtmf-relay", 22) == 0) {
+        for (p = buf; *p; ) {
+            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+            if (strncasecmp(p, "Signal", 6) == 0) {
+                p += 6;
+                while (*p == ' ' || *p == '=') p++;
+                *digit = (char)toupper((unsigned char)*p);
+            } else if (strncasecmp(p, "Duration", 8) == 0) {
+                p += 8;
+                while (*p == ' ' || *p == '=') p++;
+                *duration_ms = atoi(p);
+            }
+            p = strchr(p, '\n');
+            if (!p) {
+                break;
+            }
+        }
+    } else if (ctype_len >= 16 && strncasecmp(ctype, "application/dtmf", 16) == 0) {
+        for (p = buf; *p == ' ' || *p == '\t'; p++) {
+        }
+        *digit = (char)toupper((unsigned char)*p);
+    } else {
+        return -1;
+    }
+
+    if (!*digit || !strchr(valid, *digit)) {
+        return -1;
+    }
+    if (*duration_ms <= 0) {
+        *duration_ms = 100;
+    }
+    return 0;
+}
+
+/**
+ * @brief 取sdpfrag的下一行（不含行尾），过长的行跳过
+ * @return 1取到一行，0已到末尾
+ */
+static int sdpfrag_next_line(const char** p, const char* end, char* line, size_t size)
+{
+    while (*p < end) {
+        const char* eol = *p;
+
+        while (eol < end && *eol != '\r' && *eol != '\n') {
+            eol++;
+        }
+        size_t n = (size_t)(eol - *p);
+        const char* start = *p;
+        *p = eol + 1;
+
+        if (n > 0 && n < size) {
+            memcpy(line, start, n);
+            line[n] = '\0';
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 将收到的sdpfrag交给媒体会话
+ *
+ * ufrag与远端SDP中的不一致（旧一代或ICE重启后的候选）时整体丢弃，RFC 8840 §9.2。
+ */
+static void dialog_apply_trickle(lws_dialog_intl_t* dlg, const char* data, int bytes)
+{
+    const char* end = data + bytes;
+    const char* p = data;
+    char line[256];
+    int ufrag_ok = 0;
+
+    if (!dlg->sess || !data) {
+        return;
+    }
+
+    lws_sdp_t desc;
+    lws_sdp_str_t ufrag, pwd;
+    if (lws_sdp_parse(&desc, dlg->remote_sdp, -1) != 0 || desc.media_count == 0 ||
+        !lws_sdp_media_ice(&desc, &desc.media[0], &ufrag, &pwd)) {
+        lws_log_warn(LWS_ERR_SIP_CALL, "Trickle ICE INFO without remote ICE credentials ignored\n");
+        return;
+    }
+
+    while (sdpfrag_next_line(&p, end, line, sizeof(line))) {
+        if (strncmp(line, "a=ice-ufrag:", 12) == 0) {
+            ufrag_ok = lws_sdp_str_eq(ufrag, line + 12);
+            break;
+        }
+    }
+    if (!ufrag_ok) {
+        lws_log_warn(LWS_ERR_SIP_CALL,
+                     "Trickle ICE INFO for another ICE session ignored (Call-ID: %s)\n",
+                     dlg->public.call_id);
+        return;
+    }
+
+    p = data;
+    while (sdpfrag_next_line(&p, end, line, sizeof(line))) {
+        if (strcmp(line, "a=end-of-candidates") == 0) {
+            lws_sess_end_of_candidates(dlg->sess);
+        } else if (strncmp(line, "a=candidate:", 12) == 0) {
+            lws_sess_add_remote_candidate(dlg->sess, line);
+        }
+    }
+}
+
+static int sip_uas_oninfo(void* param, const struct sip_message_t* req,
+                         struct sip_uas_transaction_t* t,
+                         const struct cstring_t* id,
+                         const struct cstring_t* package,
+                         const void* data, int bytes)
+{
+    lws_agent_t* agent = (lws_agent_t*)param;
+    LWS_UNUSED(id);
+
+    char call_id[LWS_MAX_CALL_ID_LEN];
+    snprintf(call_id, sizeof(call_id), "%.*s", (int)req->callid.n, req->callid.p);
+
+    lws_dialog_intl_t* dlg = lws_agent_find_dialog(agent, call_id);
+    if (!dlg) {
+        sip_uas_reply(t, 481, NULL, 0, param);  /* Call/Transaction Does Not Exist */
+        return 0;
+    }
 
-        /* 通知应用层 */
-        if (agent->handler.on_dialog_state_changed) {
-            agent->handler.on_dialog_state_changed(agent, &dlg->public,
-                                                   old_state, LWS_DIALOG_STATE_TERMINATED,
-                                                   agent->handler.userdata);
-        }
+    const struct cstring_t* ctype = sip_message_get_header_by_name(req, "Content-Type");
 
-        /* 销毁dialog */
-        lws_agent_destroy_dialog(agent, dlg);
+    /* Trickle ICE：application/sdpfrag，每行一个a=candidate或a=end-of-candidates */
+    if ((package && package->n == 11 && strncasecmp(package->p, "trickle-ice", 11) == 0) ||
+        (ctype && ctype->n >= 19 && strncasecmp(ctype->p, "application/sdpfrag", 19) == 0)) {
+        sip_uas_reply(t, 200, NULL, 0, param);
+        dialog_apply_trickle(dlg, (const char*)data, bytes);
+        return 0;
+    }
+
+    char digit;
+    int duration_ms;
+    if (!ctype || parse_dtmf_info(ctype->p, (int)ctype->n, (const char*)data, bytes,
+                                  &digit, &duration_ms) != 0) {
+        sip_uas_reply(t, 415, NULL, 0, param);  /* Unsupported Media Type */
+        return 0;
     }
 
-    /* Send 200 OK */
     sip_uas_reply(t, 200, NULL, 0, param);
 
+    lws_log_info("Received DTMF '%c' via INFO (Call-ID: %s)\n", digit, call_id);
+    if (agent->handler.on_dtmf) {
+        agent->handler.on_dtmf(agent, &dlg->public, digit, duration_ms,
+                               agent->handler.userdata);
+    }
     return 0;
 }
 
@@ -770,6 +1742,14 @@ lws_agent_t* lws_agent_create(const lws_agent_config_t* config,
     /* Initialize dialog list */
     LIST_INIT_HEAD(&agent->dialogs);
     agent->dialog_count = 0;
+    LIST_INIT_HEAD(&agent->setup_queue);
+
+    /* SIP MESSAGE */
+    LIST_INIT_HEAD(&agent->msg_inflight);
+    LIST_INIT_HEAD(&agent->msg_queue);
+    agent->msg_window = config->message_window > 0 ?
+                        config->message_window : AGENT_MESSAGE_WINDOW;
+    agent->msg_next_id = 1;
 
     /* Create transport */
     lws_trans_config_t trans_config = {0};
@@ -802,9 +1782,42 @@ lws_agent_t* lws_agent_create(const lws_agent_config_t* config,
         .oninvite = sip_uas_oninvite,
         .onack = sip_uas_onack,
         .onbye = sip_uas_onbye,
+        .onupdate = sip_uas_onupdate,
+        .onmessage = sip_uas_onmessage,
+        .oninfo = sip_uas_oninfo,
         /* TODO: Add other callbacks */
     };
 
+    /* Embedded registrar */
+    if (config->enable_registrar) {
+        agent->location = lws_loc_create(config->registrar_capacity);
+        if (!agent->location) {
+            lws_trans_destroy(agent->trans);
+            lws_free(agent);
+            return NULL;
+        }
+
+        /* nonce密钥不可预测，否则可伪造任意时间的nonce */
+        uint8_t secret[16];
+        if (psa_crypto_init() != PSA_SUCCESS ||
+            psa_generate_random(secret, sizeof(secret)) != PSA_SUCCESS) {
+            lws_log_error(LWS_ERROR, "Failed to generate registrar nonce secret\n");
+            lws_loc_destroy(agent->location);
+            lws_trans_destroy(agent->trans);
+            lws_free(agent);
+            return NULL;
+        }
+        for (size_t i = 0; i < sizeof(secret); i++) {
+            snprintf(agent->nonce_secret + i * 2, 3, "%02x", secret[i]);
+        }
+        memset(secret, 0, sizeof(secret));
+    }
+
+    /* 媒体socket池 (可选) */
+    if (config->media_socket_pool > 0) {
+        agent->sock_pool = lws_sess_sock_pool_create(config->media_socket_pool);
+    }
+
     /* Initialize libsip timer system (global resource) */
     lws_timer_init();
 
@@ -812,6 +1825,8 @@ lws_agent_t* lws_agent_create(const lws_agent_config_t* config,
     agent->sip_agent = sip_agent_create(&uas_handler);
     if (!agent->sip_agent) {
         lws_log_error(LWS_ERR_SIP_CREATE, "Failed to create SIP agent\n");
+        lws_sess_sock_pool_destroy(agent->sock_pool);
+        lws_loc_destroy(agent->location);
         lws_trans_destroy(agent->trans);
         lws_free(agent);
         return NULL;
@@ -840,14 +1855,28 @@ void lws_agent_destroy(lws_agent_t* agent)
         sip_agent_destroy(agent->sip_agent);
     }
 
+    /* 未完成的MESSAGE：transaction已随sip_agent销毁，不再回调 */
+    list_for_each_safe(pos, n, &agent->msg_inflight) {
+        lws_free(list_entry(pos, lws_msg_intl_t, node));
+    }
+    list_for_each_safe(pos, n, &agent->msg_queue) {
+        lws_free(list_entry(pos, lws_msg_intl_t, node));
+    }
+
     /* Cleanup libsip timer system (global resource) */
     lws_timer_cleanup();
 
+    /* Drop the cached DTLS certificate (global resource) */
+    lws_dtls_cleanup();
+
     /* Destroy transport */
     if (agent->trans) {
         lws_trans_destroy(agent->trans);
     }
 
+    lws_loc_destroy(agent->location);
+    lws_sess_sock_pool_destroy(agent->sock_pool);
+
     lws_free(agent);
 }
 
@@ -1072,6 +2101,18 @@ int lws_agent_loop(lws_agent_t* agent, int timeout_ms)
         return ret;
     }
 
+    /* 来电媒体会话：setup_queue为空时补充socket池（空闲时做系统调用） */
+    if (!list_empty(&agent->setup_queue)) {
+        agent_process_setup_queue(agent, AGENT_SETUP_BATCH);
+    } else {
+        lws_sess_sock_pool_fill(agent->sock_pool);
+    }
+
+    /* Registrar: 清理过期绑定（只检查过期堆顶，无过期时O(1)） */
+    if (agent->location) {
+        lws_loc_expire(agent->location, agent_now_ms(), registrar_on_expired, agent);
+    }
+
     /* Drive all dialog media sessions */
     struct list_head *pos;
     lws_dialog_intl_t* dlg;
@@ -1083,6 +2124,17 @@ int lws_agent_loop(lws_agent_t* agent, int timeout_ms)
             dialog_count++;
             lws_sess_loop(dlg->sess, 1);  /* Short timeout since we're iterating */
         }
+
+        /* 491后延迟重发re-INVITE/UPDATE */
+        if (dlg->reoffer_retry_ms && agent_now_ms() >= dlg->reoffer_retry_ms) {
+            dlg->reoffer_retry_ms = 0;
+            dialog_send_reoffer(agent, dlg, dlg->reoffer_use_update);
+        }
+
+        /* 发送失败的trickle INFO */
+        if (dlg->trickle_retry) {
+            dialog_flush_trickle(dlg);
+        }
     }
 
     static int log_counter = 0;
@@ -1344,6 +2396,9 @@ static int uac_oninvite(void* param, const struct sip_message_t* reply,
             }
         }
 
+        /* 200 OK前收集到的候选 */
+        dialog_flush_trickle(dlg);
+
         /* Send ACK for 200 OK */
         /* Note: libsip automatically handles ACK for 2xx, we just need to
          * call sip_uac_ack if we have additional SDP to send */
@@ -1387,110 +2442,436 @@ static int uac_oninvite(void* param, const struct sip_message_t* reply,
         char request_uri[512];
         snprintf(request_uri, sizeof(request_uri), "%s", dlg->public.remote_uri);
 
-        if (lws_auth_generate_response(&challenge, &creds, "INVITE",
-                                       request_uri, &auth_response) != 0) {
-            lws_log_error(0, "[AUTH] Failed to generate auth response for INVITE\n");
-            dlg->state = LWS_DIALOG_STATE_FAILED;
-            return -1;
-        }
+        if (lws_auth_generate_response(&challenge, &creds, "INVITE",
+                                       request_uri, &auth_response) != 0) {
+            lws_log_error(0, "[AUTH] Failed to generate auth response for INVITE\n");
+            dlg->state = LWS_DIALOG_STATE_FAILED;
+            return -1;
+        }
+
+        lws_log_info("[AUTH] Generated response: %s\n", auth_response.response);
+
+        /* Build Authorization header */
+        char auth_header_value[2048];
+        if (lws_auth_build_authorization_header(&auth_response, agent->username,
+                                               auth_header_value,
+                                               sizeof(auth_header_value)) != 0) {
+            lws_log_error(0, "[AUTH] Failed to build auth header for INVITE\n");
+            dlg->state = LWS_DIALOG_STATE_FAILED;
+            return -1;
+        }
+
+        lws_log_info("[AUTH] Sending authenticated INVITE\n");
+
+        /* Build From header */
+        char from[512];
+        if (strlen(agent->config.nickname) > 0) {
+            snprintf(from, sizeof(from), "\"%s\" <%s>",
+                    agent->config.nickname, dlg->public.local_uri);
+        } else {
+            snprintf(from, sizeof(from), "<%s>", dlg->public.local_uri);
+        }
+
+        /* Create new authenticated INVITE transaction */
+        struct sip_uac_transaction_t* new_txn = sip_uac_invite(agent->sip_agent,
+                                                               from,
+                                                               dlg->public.remote_uri,
+                                                               uac_oninvite,
+                                                               dlg);
+        if (!new_txn) {
+            lws_log_error(LWS_ERR_SIP_CALL, "[AUTH] Failed to create authenticated INVITE transaction\n");
+            dlg->state = LWS_DIALOG_STATE_FAILED;
+            return -1;
+        }
+
+        /* Add Authorization header */
+        const char* auth_header_name = (code == 401) ? "Authorization" : "Proxy-Authorization";
+        int ret = sip_uac_add_header(new_txn, auth_header_name, auth_header_value);
+        if (ret != 0) {
+            lws_log_error(0, "[AUTH] Failed to add %s header: %d\n", auth_header_name, ret);
+            sip_uac_transaction_release(new_txn);
+            dlg->state = LWS_DIALOG_STATE_FAILED;
+            return -1;
+        }
+
+        /* Get SDP from session and send authenticated INVITE with SDP */
+        const char* sdp = NULL;
+        if (dlg->sess) {
+            sdp = lws_sess_get_local_sdp(dlg->sess);
+        }
+
+        if (sdp && strlen(sdp) > 0) {
+            ret = sip_uac_send(new_txn, sdp, strlen(sdp), &agent->sip_transport, agent);
+        } else {
+            lws_log_error(0, "[AUTH] No SDP available for authenticated INVITE\n");
+            ret = sip_uac_send(new_txn, NULL, 0, &agent->sip_transport, agent);
+        }
+
+        if (ret != 0) {
+            lws_log_error(0, "[AUTH] Failed to send authenticated INVITE: %d\n", ret);
+            sip_uac_transaction_release(new_txn);
+            dlg->state = LWS_DIALOG_STATE_FAILED;
+            return -1;
+        }
+
+        lws_log_info("[AUTH] Authenticated INVITE sent successfully\n");
+
+        /* Replace old transaction */
+        if (dlg->invite_txn) {
+            sip_uac_transaction_release(dlg->invite_txn);
+        }
+        dlg->invite_txn = new_txn;
+
+        return 0;
+    }
+    else if (code >= 300) {
+        /* 3xx, 4xx, 5xx, 6xx - Failure */
+        dlg->state = LWS_DIALOG_STATE_FAILED;
+
+        lws_log_warn(LWS_ERR_SIP_CALL, "Call failed with code %d\n", code);
+    }
+
+    /* Trigger state change callback */
+    if (old_state != dlg->state && agent->handler.on_dialog_state_changed) {
+        agent->handler.on_dialog_state_changed(agent, (lws_dialog_t*)dlg,
+                                               old_state, dlg->state,
+                                               agent->handler.userdata);
+    }
+
+    /* Trigger remote SDP callback for 200 OK */
+    if (code >= 200 && code < 300 && agent->handler.on_remote_sdp) {
+        if (strlen(dlg->remote_sdp) > 0) {
+            lws_log_info("[MEDIA_SESSION] Media session established (UAC received 200 OK + SDP)\n");
+            agent->handler.on_remote_sdp(agent, (lws_dialog_t*)dlg,
+                                        dlg->remote_sdp,
+                                        agent->handler.userdata);
+        }
+    }
+
+    return 0;
+}
+
+/* ========================================
+ * Mid-dialog offer/answer (re-INVITE/UPDATE)
+ * ======================================== */
+
+/**
+ * @brief 将会话中收到的SDP增量应用到已有媒体会话
+ * @return 变化掩码，-1表示不可接受（保留原SDP）
+ */
+static int dialog_apply_remote_sdp(lws_dialog_intl_t* dlg, const void* data, int bytes)
+{
+    lws_agent_t* agent = dlg->agent;
+    char sdp[sizeof(dlg->remote_sdp)];
+    int len = LWS_MIN(bytes, (int)sizeof(sdp) - 1);
+
+    memcpy(sdp, data, len);
+    sdp[len] = '\0';
+
+    int changes = lws_sess_update_remote_sdp(dlg->sess, sdp);
+    if (changes < 0) {
+        lws_log_warn(LWS_ERR_MEDIA_SDP, "[MEDIA_SESSION] Mid-dialog SDP rejected (Call-ID: %s)\n",
+                     dlg->public.call_id);
+        return -1;
+    }
+
+    memcpy(dlg->remote_sdp, sdp, len + 1);
+
+    const char* local_sdp = lws_sess_get_local_sdp(dlg->sess);
+    if (local_sdp) {
+        LWS_STRNCPY(dlg->local_sdp, local_sdp, sizeof(dlg->local_sdp));
+    }
+
+    lws_log_info("[MEDIA_SESSION] Mid-dialog SDP applied (changes=0x%x)\n", changes);
+
+    if (changes && agent->handler.on_remote_sdp) {
+        agent->handler.on_remote_sdp(agent, &dlg->public, dlg->remote_sdp,
+                                    agent->handler.userdata);
+    }
+
+    return changes;
+}
+
+/**
+ * @brief 查找发出该re-INVITE/UPDATE的dialog
+ *
+ * 事务的回调参数是agent而不是dialog：挂断或收到BYE时dialog可能在
+ * 最终响应（481/408/超时）到达前已被释放，此时找不到而忽略响应。
+ */
+static lws_dialog_intl_t* reoffer_find_dialog(lws_agent_t* agent,
+                                              const struct sip_uac_transaction_t* t)
+{
+    struct list_head* pos;
+    lws_dialog_intl_t* dlg;
+
+    list_for_each(pos, &agent->dialogs) {
+        dlg = list_entry(pos, lws_dialog_intl_t, list_node);
+        if (dlg->reoffer_t == t) {
+            return dlg;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief re-INVITE/UPDATE最终响应处理
+ */
+static void reoffer_on_response(lws_agent_t* agent, const struct sip_uac_transaction_t* t,
+                                const struct sip_message_t* reply, int code)
+{
+    lws_dialog_intl_t* dlg;
+
+    if (code < 200) {
+        return;
+    }
+
+    dlg = reoffer_find_dialog(agent, t);
+    if (!dlg) {
+        lws_log_debug("Re-offer response %d for a terminated dialog ignored\n", code);
+        return;
+    }
+
+    dlg->reoffer_pending = 0;
+    dlg->reoffer_t = NULL;
+
+    if (code < 300 && reply && reply->payload && reply->size > 0) {
+        dialog_apply_remote_sdp(dlg, reply->payload, reply->size);
+    }
+
+    /* 任何最终响应都结束本端offer，491重试时重新登记 */
+    if (dlg->sess) {
+        lws_sess_set_offer_pending(dlg->sess, 0);
+    }
+
+    if (code < 300) {
+        return;
+    }
+
+    if (code == 491) {
+        /* RFC 3261 §14.1: Call-ID的拥有者(主叫)等待2.1~4秒，否则0~2秒 */
+        int delay_ms = dlg->public.direction == LWS_DIALOG_OUTGOING ?
+                       2100 + rand() % 1900 : rand() % 2000;
+        dlg->reoffer_retry_ms = agent_now_ms() + (uint64_t)delay_ms;
+        lws_log_info("[MEDIA_SESSION] Re-offer glare (491), retry in %d ms\n", delay_ms);
+        return;
+    }
+
+    /* offer被拒绝：会话保持原协商结果，本端方向回退 */
+    lws_log_warn(LWS_ERR_SIP_CALL, "[MEDIA_SESSION] Re-offer rejected with %d (Call-ID: %s)\n",
+                 code, dlg->public.call_id);
+    if (dlg->media_dir != dlg->reoffer_prev_dir && dlg->sess) {
+        dlg->media_dir = dlg->reoffer_prev_dir;
+        lws_sess_set_media_dir(dlg->sess, dlg->media_dir);
+    }
+}
+
+static int uac_onreinvite(void* param, const struct sip_message_t* reply,
+                          struct sip_uac_transaction_t* t,
+                          struct sip_dialog_t* dialog, const struct cstring_t* id,
+                          int code)
+{
+    LWS_UNUSED(dialog);
+    LWS_UNUSED(id);
+
+    lws_log_info("UAC re-INVITE response: %d\n", code);
+    reoffer_on_response((lws_agent_t*)param, t, reply, code);
+    return 0;
+}
+
+static int uac_onupdate(void* param, const struct sip_message_t* reply,
+                        struct sip_uac_transaction_t* t, int code)
+{
+    lws_log_info("UAC UPDATE response: %d\n", code);
+    reoffer_on_response((lws_agent_t*)param, t, reply, code);
+    return 0;
+}
+
+/**
+ * @brief 发送re-INVITE/UPDATE，offer为媒体会话当前的本地SDP
+ */
+static int dialog_send_reoffer(lws_agent_t* agent, lws_dialog_intl_t* dlg, int use_update)
+{
+    const char* sdp = lws_sess_get_local_sdp(dlg->sess);
+    if (!sdp) {
+        return LWS_ERROR;
+    }
+
+    struct sip_uac_transaction_t* t = use_update ?
+        sip_uac_update(agent->sip_agent, dlg->sip_dialog, uac_onupdate, agent) :
+        sip_uac_reinvite(agent->sip_agent, dlg->sip_dialog, uac_onreinvite, agent);
+    if (!t) {
+        lws_log_error(LWS_ERR_SIP_CALL, "Failed to create %s transaction\n",
+                     use_update ? "UPDATE" : "re-INVITE");
+        return LWS_ERR_SIP_CALL;
+    }
+
+    sip_uac_add_header(t, "Content-Type", "application/sdp");
+
+    /* 最终响应可能在sip_uac_send中到达，发送前登记 */
+    LWS_STRNCPY(dlg->local_sdp, sdp, sizeof(dlg->local_sdp));
+    dlg->reoffer_pending = 1;
+    dlg->reoffer_t = t;
+    dlg->reoffer_use_update = use_update;
+    dlg->reoffer_retry_ms = 0;
+    lws_sess_set_offer_pending(dlg->sess, 1);
+
+    int ret = sip_uac_send(t, sdp, strlen(sdp), &agent->sip_transport, agent);
+    sip_uac_transaction_release(t);
+    if (ret < 0) {
+        lws_log_error(LWS_ERR_SIP_SEND, "Failed to send %s: %d\n",
+                     use_update ? "UPDATE" : "re-INVITE", ret);
+        dlg->reoffer_pending = 0;
+        dlg->reoffer_t = NULL;
+        lws_sess_set_offer_pending(dlg->sess, 0);
+        return LWS_ERR_SIP_SEND;
+    }
+
+    lws_log_info("%s sent (Call-ID: %s)\n", use_update ? "UPDATE" : "re-INVITE",
+                 dlg->public.call_id);
+    return LWS_OK;
+}
+
+static int dialog_check_reoffer(lws_dialog_intl_t* dlg)
+{
+    if (!dlg->sip_dialog || !dlg->sess || dlg->state != LWS_DIALOG_STATE_CONFIRMED) {
+        lws_log_error(LWS_ERROR, "Dialog not established for re-offer (state: %d)\n", dlg->state);
+        return LWS_ERROR;
+    }
+
+    if (dlg->reoffer_pending || dlg->reoffer_retry_ms) {
+        return LWS_EBUSY;
+    }
+
+    return LWS_OK;
+}
+
+static int dialog_change_media_dir(lws_agent_t* agent, lws_dialog_intl_t* dlg,
+                                   lws_media_dir_t dir)
+{
+    int ret = dialog_check_reoffer(dlg);
+    if (ret != LWS_OK) {
+        return ret;
+    }
+
+    dlg->reoffer_prev_dir = dlg->media_dir;
+    dlg->media_dir = dir;
+    lws_sess_set_media_dir(dlg->sess, dir);
 
-        lws_log_info("[AUTH] Generated response: %s\n", auth_response.response);
+    ret = dialog_send_reoffer(agent, dlg, 0);
+    if (ret != LWS_OK) {
+        dlg->media_dir = dlg->reoffer_prev_dir;
+        lws_sess_set_media_dir(dlg->sess, dlg->media_dir);
+    }
 
-        /* Build Authorization header */
-        char auth_header_value[2048];
-        if (lws_auth_build_authorization_header(&auth_response, agent->username,
-                                               auth_header_value,
-                                               sizeof(auth_header_value)) != 0) {
-            lws_log_error(0, "[AUTH] Failed to build auth header for INVITE\n");
-            dlg->state = LWS_DIALOG_STATE_FAILED;
-            return -1;
-        }
+    return ret;
+}
 
-        lws_log_info("[AUTH] Sending authenticated INVITE\n");
+/* ========================================
+ * SIP MESSAGE (RFC 3428)
+ * ======================================== */
 
-        /* Build From header */
-        char from[512];
-        if (strlen(agent->config.nickname) > 0) {
-            snprintf(from, sizeof(from), "\"%s\" <%s>",
-                    agent->config.nickname, dlg->public.local_uri);
-        } else {
-            snprintf(from, sizeof(from), "<%s>", dlg->public.local_uri);
-        }
+static int message_send(lws_agent_t* agent, lws_msg_intl_t* msg,
+                        const char* target, const char* content_type,
+                        const void* body, int len);
 
-        /* Create new authenticated INVITE transaction */
-        struct sip_uac_transaction_t* new_txn = sip_uac_invite(agent->sip_agent,
-                                                               from,
-                                                               dlg->public.remote_uri,
-                                                               uac_oninvite,
-                                                               dlg);
-        if (!new_txn) {
-            lws_log_error(LWS_ERR_SIP_CALL, "[AUTH] Failed to create authenticated INVITE transaction\n");
-            dlg->state = LWS_DIALOG_STATE_FAILED;
-            return -1;
+/**
+ * @brief 窗口有空位时按FIFO发送排队的MESSAGE
+ */
+static void message_pump(lws_agent_t* agent)
+{
+    while (agent->msg_inflight_count < agent->msg_window &&
+           !list_empty(&agent->msg_queue)) {
+        lws_msg_intl_t* msg = list_entry(agent->msg_queue.next, lws_msg_intl_t, node);
+        list_remove(&msg->node);
+
+        if (message_send(agent, msg, msg->target, msg->content_type,
+                         msg->body, msg->body_len) != 0) {
+            /* 发送失败同样通过回调通知，保证每个ID都有结果 */
+            if (agent->handler.on_message_result) {
+                agent->handler.on_message_result(agent, msg->id, 503, 0,
+                                                 agent->handler.userdata);
+            }
+            lws_free(msg);
         }
+    }
+}
 
-        /* Add Authorization header */
-        const char* auth_header_name = (code == 401) ? "Authorization" : "Proxy-Authorization";
-        int ret = sip_uac_add_header(new_txn, auth_header_name, auth_header_value);
-        if (ret != 0) {
-            lws_log_error(0, "[AUTH] Failed to add %s header: %d\n", auth_header_name, ret);
-            sip_uac_transaction_release(new_txn);
-            dlg->state = LWS_DIALOG_STATE_FAILED;
-            return -1;
-        }
+static int uac_onmessage(void* param, const struct sip_message_t* reply,
+                         struct sip_uac_transaction_t* t, int code)
+{
+    lws_msg_intl_t* msg = (lws_msg_intl_t*)param;
+    lws_agent_t* agent = msg->agent;
+    LWS_UNUSED(reply);
+    LWS_UNUSED(t);
 
-        /* Get SDP from session and send authenticated INVITE with SDP */
-        const char* sdp = NULL;
-        if (dlg->sess) {
-            sdp = lws_sess_get_local_sdp(dlg->sess);
-        }
+    /* 临时响应不结束transaction */
+    if (code < 200) {
+        return 0;
+    }
 
-        if (sdp && strlen(sdp) > 0) {
-            ret = sip_uac_send(new_txn, sdp, strlen(sdp), &agent->sip_transport, agent);
-        } else {
-            lws_log_error(0, "[AUTH] No SDP available for authenticated INVITE\n");
-            ret = sip_uac_send(new_txn, NULL, 0, &agent->sip_transport, agent);
-        }
+    uint64_t latency_us = agent_now_us() - msg->send_us;
 
-        if (ret != 0) {
-            lws_log_error(0, "[AUTH] Failed to send authenticated INVITE: %d\n", ret);
-            sip_uac_transaction_release(new_txn);
-            dlg->state = LWS_DIALOG_STATE_FAILED;
-            return -1;
-        }
+    list_remove(&msg->node);
+    agent->msg_inflight_count--;
 
-        lws_log_info("[AUTH] Authenticated INVITE sent successfully\n");
+    if (agent->handler.on_message_result) {
+        agent->handler.on_message_result(agent, msg->id, code,
+                                         (uint32_t)LWS_MIN(latency_us, UINT32_MAX),
+                                         agent->handler.userdata);
+    }
+    lws_free(msg);
 
-        /* Replace old transaction */
-        if (dlg->invite_txn) {
-            sip_uac_transaction_release(dlg->invite_txn);
-        }
-        dlg->invite_txn = new_txn;
+    message_pump(agent);
+    return 0;
+}
 
-        return 0;
+/**
+ * @brief 创建并发送MESSAGE transaction，成功后msg进入在途链表
+ */
+static int message_send(lws_agent_t* agent, lws_msg_intl_t* msg,
+                        const char* target, const char* content_type,
+                        const void* body, int len)
+{
+    char local_uri[256];
+    snprintf(local_uri, sizeof(local_uri), "sip:%s@%s",
+             agent->config.username, agent->config.domain);
+
+    char from[512];
+    if (strlen(agent->config.nickname) > 0) {
+        snprintf(from, sizeof(from), "\"%s\" <%s>", agent->config.nickname, local_uri);
+    } else {
+        snprintf(from, sizeof(from), "<%s>", local_uri);
     }
-    else if (code >= 300) {
-        /* 3xx, 4xx, 5xx, 6xx - Failure */
-        dlg->state = LWS_DIALOG_STATE_FAILED;
 
-        lws_log_warn(LWS_ERR_SIP_CALL, "Call failed with code %d\n", code);
+    char to_uri[256];
+    if (strstr(target, "sip:") == target) {
+        snprintf(to_uri, sizeof(to_uri), "%s", target);
+    } else {
+        snprintf(to_uri, sizeof(to_uri), "sip:%s@%s", target, agent->config.domain);
     }
 
-    /* Trigger state change callback */
-    if (old_state != dlg->state && agent->handler.on_dialog_state_changed) {
-        agent->handler.on_dialog_state_changed(agent, (lws_dialog_t*)dlg,
-                                               old_state, dlg->state,
-                                               agent->handler.userdata);
+    struct sip_uac_transaction_t* t = sip_uac_message(agent->sip_agent, from, to_uri,
+                                                      uac_onmessage, msg);
+    if (!t) {
+        lws_log_error(LWS_ERR_SIP_SEND, "Failed to create MESSAGE transaction\n");
+        return -1;
     }
 
-    /* Trigger remote SDP callback for 200 OK */
-    if (code >= 200 && code < 300 && agent->handler.on_remote_sdp) {
-        if (strlen(dlg->remote_sdp) > 0) {
-            lws_log_info("[MEDIA_SESSION] Media session established (UAC received 200 OK + SDP)\n");
-            agent->handler.on_remote_sdp(agent, (lws_dialog_t*)dlg,
-                                        dlg->remote_sdp,
-                                        agent->handler.userdata);
-        }
+    sip_uac_add_header(t, "Content-Type", content_type);
+
+    /* 先入在途链表：本地环回时响应可能在sip_uac_send返回前到达 */
+    msg->send_us = agent_now_us();
+    list_insert_before(&msg->node, &agent->msg_inflight);
+    agent->msg_inflight_count++;
+
+    int ret = sip_uac_send(t, body, len, &agent->sip_transport, agent);
+    sip_uac_transaction_release(t);
+    if (ret != 0) {
+        lws_log_error(LWS_ERR_SIP_SEND, "Failed to send MESSAGE: %d\n", ret);
+        list_remove(&msg->node);
+        agent->msg_inflight_count--;
+        return -1;
     }
 
     return 0;
@@ -1559,27 +2940,7 @@ lws_dialog_t* lws_agent_make_call(lws_agent_t* agent, const char* target_uri)
     }
 
     /* 创建媒体会话 (使用agent的设备配置) */
-    lws_sess_config_t sess_config;
-    memset(&sess_config, 0, sizeof(sess_config));
-    /* TODO: 配置STUN服务器等参数 */
-    sess_config.enable_audio = 1;
-    sess_config.enable_video = 0;
-    sess_config.media_dir = LWS_MEDIA_DIR_SENDRECV;  /* 双向媒体 */
-
-    /* Copy device references from agent */
-    sess_config.audio_capture_dev = agent->audio_capture_dev;
-    sess_config.audio_playback_dev = agent->audio_playback_dev;
-    sess_config.audio_record_dev = agent->audio_record_dev;
-    sess_config.audio_codec = agent->audio_codec;
-
-    lws_sess_handler_t sess_handler;
-    memset(&sess_handler, 0, sizeof(sess_handler));
-    sess_handler.on_sdp_ready = sess_on_sdp_ready;
-    sess_handler.on_connected = sess_on_connected;
-    sess_handler.on_disconnected = sess_on_disconnected;
-    sess_handler.userdata = dlg;
-
-    dlg->sess = lws_sess_create(&sess_config, &sess_handler);
+    dlg->sess = dialog_create_sess(agent, dlg, NULL);
     if (!dlg->sess) {
         lws_log_error(LWS_ERR_MEDIA, "Failed to create media session\n");
         sip_uac_transaction_release(dlg->invite_txn);
@@ -1629,7 +2990,15 @@ int lws_agent_answer_call(lws_agent_t* agent, lws_dialog_t* dialog)
         return LWS_ERROR;
     }
 
-    /* Verify media session exists (should be created in sip_uas_oninvite) */
+    /* 媒体会话仍在setup_queue中：就绪后自动应答 */
+    if (dlg->setup_pending) {
+        dlg->answer_pending = 1;
+        lws_log_info("Answer deferred until media session is ready (Call-ID: %s)\n",
+                     dlg->public.call_id);
+        return LWS_OK;
+    }
+
+    /* Verify media session exists (created from setup_queue in lws_agent_loop) */
     if (!dlg->sess) {
         lws_log_error(LWS_ERROR, "No media session for dialog\n");
         return LWS_ERROR;
@@ -1799,6 +3168,119 @@ int lws_agent_hangup(lws_agent_t* agent, lws_dialog_t* dialog)
     return LWS_OK;
 }
 
+static int uac_oninfo(void* param, const struct sip_message_t* reply,
+                      struct sip_uac_transaction_t* t, int code)
+{
+    LWS_UNUSED(param);
+    LWS_UNUSED(reply);
+    LWS_UNUSED(t);
+
+    if (code >= 300) {
+        lws_log_warn(LWS_ERR_SIP_SEND, "DTMF INFO rejected with %d\n", code);
+    }
+    return 0;
+}
+
+int lws_agent_send_dtmf(lws_agent_t* agent, lws_dialog_t* dialog,
+                        const char* digits, int duration_ms)
+{
+    if (!agent || !dialog || !digits || !digits[0]) {
+        return LWS_EINVAL;
+    }
+
+    lws_dialog_intl_t* dlg = (lws_dialog_intl_t*)dialog;
+    if (dlg->state != LWS_DIALOG_STATE_CONFIRMED || !dlg->sip_dialog) {
+        lws_log_error(LWS_ERROR, "Dialog not confirmed, cannot send DTMF\n");
+        return LWS_ERROR;
+    }
+
+    if (duration_ms <= 0) {
+        duration_ms = 100;
+    }
+
+    /* 协商了telephone-event时在媒体流中发送 (RFC 4733) */
+    if (dlg->sess) {
+        lws_sess_codec_t codecs[LWS_MAX_CODECS];
+        int count = lws_sess_get_codecs(dlg->sess, codecs, LWS_MAX_CODECS);
+        for (int i = 0; i < count; i++) {
+            if (codecs[i].codec == LWS_RTP_PAYLOAD_TELEPHONE_EVENT) {
+                return lws_sess_send_dtmf(dlg->sess, digits, duration_ms) == 0 ?
+                       LWS_OK : LWS_EINVAL;
+            }
+        }
+    }
+
+    /* 否则每个按键发送一个SIP INFO (application/dtmf-relay) */
+    for (const char* p = digits; *p; p++) {
+        char digit = (char)toupper((unsigned char)*p);
+        if (!strchr("0123456789*#ABCD", digit)) {
+            lws_log_error(LWS_EINVAL, "Invalid DTMF digit '%c'\n", *p);
+            return LWS_EINVAL;
+        }
+    }
+
+    for (const char* p = digits; *p; p++) {
+        char body[64];
+        int len = snprintf(body, sizeof(body), "Signal=%c\r\nDuration=%d\r\n",
+                           toupper((unsigned char)*p), duration_ms);
+
+        struct sip_uac_transaction_t* t = sip_uac_info(agent->sip_agent, dlg->sip_dialog,
+                                                       NULL, uac_oninfo, agent);
+        if (!t) {
+            lws_log_error(LWS_ERR_SIP_SEND, "Failed to create INFO transaction\n");
+            return LWS_ERR_SIP_SEND;
+        }
+
+        sip_uac_add_header(t, "Content-Type", "application/dtmf-relay");
+        int ret = sip_uac_send(t, body, len, &agent->sip_transport, agent);
+        sip_uac_transaction_release(t);
+        if (ret != 0) {
+            lws_log_error(LWS_ERR_SIP_SEND, "Failed to send DTMF INFO: %d\n", ret);
+            return LWS_ERR_SIP_SEND;
+        }
+    }
+
+    lws_log_info("Sent DTMF \"%s\" via SIP INFO (Call-ID: %s)\n", digits, dialog->call_id);
+    return LWS_OK;
+}
+
+int lws_agent_hold(lws_agent_t* agent, lws_dialog_t* dialog)
+{
+    if (!agent || !dialog) {
+        return LWS_EINVAL;
+    }
+
+    return dialog_change_media_dir(agent, (lws_dialog_intl_t*)dialog,
+                                   LWS_MEDIA_DIR_SENDONLY);
+}
+
+int lws_agent_resume(lws_agent_t* agent, lws_dialog_t* dialog)
+{
+    if (!agent || !dialog) {
+        return LWS_EINVAL;
+    }
+
+    return dialog_change_media_dir(agent, (lws_dialog_intl_t*)dialog,
+                                   LWS_MEDIA_DIR_SENDRECV);
+}
+
+int lws_agent_reoffer(lws_agent_t* agent, lws_dialog_t* dialog, int use_update)
+{
+    if (!agent || !dialog) {
+        return LWS_EINVAL;
+    }
+
+    lws_dialog_intl_t* dlg = (lws_dialog_intl_t*)dialog;
+
+    int ret = dialog_check_reoffer(dlg);
+    if (ret != LWS_OK) {
+        return ret;
+    }
+
+    dlg->reoffer_prev_dir = dlg->media_dir;
+    return dialog_send_reoffer(agent, dlg, use_update);
+}
+
 int lws_agent_cancel_call(lws_agent_t* agent, lws_dialog_t* dialog)
 {
     if (!agent || !dialog) {
@@ -1903,6 +3385,119 @@ lws_agent_state_t lws_agent_get_state(lws_agent_t* agent)
     return agent ? agent->state : LWS_AGENT_STATE_IDLE;
 }
 
+/* ========================================
+ * SIP MESSAGE API
+ * ======================================== */
+
+int lws_agent_send_message(lws_agent_t* agent, const char* target_uri,
+                           const char* content_type, const void* body, int len)
+{
+    if (!agent || !target_uri || !target_uri[0] || (len > 0 && !body) || len < 0) {
+        return LWS_EINVAL;
+    }
+
+    if (!content_type || !content_type[0]) {
+        content_type = "text/plain";
+    }
+
+    /* 窗口有空位且无排队消息时直接发送，避免复制消息体 */
+    int direct = agent->msg_inflight_count < agent->msg_window &&
+                 list_empty(&agent->msg_queue);
+
+    size_t target_len = strlen(target_uri) + 1;
+    size_t ctype_len = strlen(content_type) + 1;
+    size_t extra = direct ? 0 : target_len + ctype_len + (size_t)len;
+
+    lws_msg_intl_t* msg = (lws_msg_intl_t*)lws_malloc(sizeof(lws_msg_intl_t) + extra);
+    if (!msg) {
+        return LWS_ENOMEM;
+    }
+    memset(msg, 0, sizeof(*msg));
+    msg->agent = agent;
+    msg->id = agent->msg_next_id++;
+    if (agent->msg_next_id > INT32_MAX) {
+        agent->msg_next_id = 1;  /* ID以int返回，0保留为无效ID */
+    }
+
+    /* 响应可能在sip_uac_send返回前到达并释放msg，先保存ID */
+    int id = (int)msg->id;
+
+    if (direct) {
+        if (message_send(agent, msg, target_uri, content_type, body, len) != 0) {
+            lws_free(msg);
+            return LWS_ERR_SIP_SEND;
+        }
+        return id;
+    }
+
+    char* p = (char*)(msg + 1);
+    memcpy(p, target_uri, target_len);
+    msg->target = p;
+    p += target_len;
+    memcpy(p, content_type, ctype_len);
+    msg->content_type = p;
+    p += ctype_len;
+    if (len > 0) {
+        memcpy(p, body, len);
+    }
+    msg->body = p;
+    msg->body_len = len;
+
+    list_insert_before(&msg->node, &agent->msg_queue);
+    return id;
+}
+
+int lws_agent_get_message_pending(lws_agent_t* agent)
+{
+    if (!agent) {
+        return LWS_EINVAL;
+    }
+
+    int queued = 0;
+    struct list_head* pos;
+    list_for_each(pos, &agent->msg_queue) {
+        queued++;
+    }
+
+    return agent->msg_inflight_count + queued;
+}
+
+/* ========================================
+ * Registrar APIs
+ * ======================================== */
+
+int lws_agent_lookup_contacts(lws_agent_t* agent, const char* aor,
+                              lws_loc_contact_t* contacts, int max_count)
+{
+    if (!agent || !agent->location || !aor || !contacts || max_count <= 0) {
+        return 0;
+    }
+
+    /* 与REGISTER入库时相同的规范化 */
+    char key[LWS_MAX_URI_LEN];
+    const char* user = aor;
+    if (strncasecmp(user, "sip:", 4) == 0) {
+        user += 4;
+    }
+    const char* at = strchr(user, '@');
+    if (!at) {
+        return 0;
+    }
+    registrar_make_aor(user, at - user, at + 1, strlen(at + 1), key, sizeof(key));
+
+    return lws_loc_lookup(agent->location, key, contacts, max_count, agent_now_ms());
+}
+
+int lws_agent_get_registrar_stats(lws_agent_t* agent, lws_loc_stats_t* stats)
+{
+    if (!agent || !agent->location || !stats) {
+        return LWS_EINVAL;
+    }
+
+    lws_loc_get_stats(agent->location, stats);
+    return LWS_OK;
+}
+
 /* ========================================
  * Dialog query APIs
  * ======================================== */
@@ -2224,6 +3819,8 @@ void lws_agent_init_default_config(
     config->registrar_port = 5060;
     config->auto_register = 1;
     config->register_expires = 3600;
+    config->media_socket_pool = 4;
+    config->message_window = AGENT_MESSAGE_WINDOW;
 
     /* Default User-Agent */
     snprintf(config->user_agent, LWS_MAX_USER_AGENT_LEN,
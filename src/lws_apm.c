@@ -0,0 +1,768 @@
+/**
+ * @file lws_apm.c
+ * @brief Voice processing implementation (AEC, NS, AGC)
+ *
+ * 回声消除：
+ * - 播放信号(render)写入环形缓冲，采集帧按估计的延迟取对应的参考信号
+ * - 延迟估计：4ms块包络（去均值）在0~500ms范围内做泄漏互相关，取峰值
+ * - NLMS：Q14定点系数，int32累加（按模运算，最终结果不溢出即正确）
+ * - 双讲检测：Geigel判决，门限由远端单讲时的近端/远端峰值比学习得到；
+ *   步长再按回声估计/残差能量比缩放
+ *
+ * 降噪：50%重叠的sqrt-Hann窗FFT，维纳增益（decision-directed先验SNR），
+ * 增益下限-20dB，避免音乐噪声。
+ *
+ * AGC：按语音帧功率估计电平，增益慢升快降，并保证输出不削波。
+ */
+
+#include <string.h>
+
+#include "lws_apm.h"
+#include "lws_mem.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define APM_USE_NEON    1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define APM_USE_SSE2    1
+#endif
+
+/* ========================================
+ * Tuning
+ * ======================================== */
+
+#define AEC_MU_Q15          16384   /* NLMS步长0.5 */
+#define AEC_FAR_ACTIVE      64      /* 远端峰值低于此值时不自适应 */
+#define AEC_DT_INIT         1.0f    /* 回声路径峰值比初值 */
+#define AEC_DT_STEP         0.02f   /* 分位数跟踪步长 */
+#define AEC_DT_MARGIN       1.5f    /* Geigel门限 = 峰值比 * 1.5 */
+#define AEC_DT_MIN          0.5f    /* Geigel门限范围 */
+#define AEC_DT_MAX          8.0f
+#define AEC_MU_MIN          0.125f  /* 变步长下限（相对AEC_MU_Q15） */
+#define AEC_BLOCK_MS        4       /* 延迟估计的包络块长 */
+#define AEC_DELAY_MARGIN    2       /* 参考信号提前的块数（滤波器覆盖延迟抖动） */
+#define AEC_CORR_LEAK       0.995f  /* 互相关泄漏系数（约0.8秒） */
+#define AEC_MEAN_SMOOTH     0.05f   /* 包络均值平滑系数 */
+#define AEC_CORR_MIN        0.3f    /* 接受延迟估计的最小归一化相关 */
+#define AEC_DELAY_STABLE    50      /* 新延迟需连续胜出的块数（200ms） */
+
+#define NS_INIT_FRAMES      8       /* 开始时直接平均得到噪声谱 */
+#define NS_NOISE_SMOOTH     0.1f
+#define NS_NOISE_RISE       1.01f   /* 语音期间噪声估计缓慢上升（约3dB/s） */
+#define NS_SPEECH_SNR       3.0f    /* 超过噪声估计3倍的bin不更新噪声 */
+#define NS_DD_ALPHA         0.98f
+#define NS_GAIN_MIN         0.1f    /* -20dB */
+
+#define AGC_TARGET_POWER    17040000.0f /* -18dBov */
+#define AGC_SPEECH_POWER    10737.0f    /* -50dBov，低于此值不更新电平 */
+#define AGC_MAX_GAIN        10.0f       /* +20dB */
+#define AGC_MIN_GAIN        0.25f       /* -12dB */
+#define AGC_GAIN_RISE       1.02f       /* 每帧最多上升约0.17dB */
+
+/* ========================================
+ * Internal structure
+ * ======================================== */
+
+struct lws_apm_t {
+    int flags;
+    int sample_rate;
+    int frame_samples;
+
+    /* Render history (far end) */
+    int16_t* far;
+    int far_size;
+    uint64_t far_total;             /* Render samples received */
+
+    /* Delay estimator */
+    int block;                      /* Samples per envelope block */
+    int lags;                       /* Blocks searched */
+    int env_size;                   /* Far envelope ring size */
+    float* far_env;
+    float* corr;
+    float far_acc;
+    int far_acc_n;
+    float near_acc;
+    int near_acc_n;
+    float far_mean;
+    float near_mean;
+    float far_var;
+    float near_var;
+    int delay_blocks;               /* Accepted estimate, -1 unknown */
+    int cand_blocks;
+    int cand_count;
+
+    /* NLMS */
+    int taps;
+    int delay;                      /* Reference offset in samples */
+    int16_t* w;                     /* Q14 taps, w[0] multiplies the oldest sample */
+    int16_t* xh;                    /* Reference window for one frame */
+    float dt_ratio;                 /* Near/far peak ratio of the echo path (90% quantile) */
+    float echo_energy;              /* Smoothed echo estimate energy per frame */
+    float err_energy;               /* Smoothed residual energy per frame */
+
+    /* Noise suppressor */
+    int fft_size;
+    int hop;
+    int ns_pos;
+    int ns_frames;
+    float* ns_buf;                  /* Analysis buffer (fft_size) */
+    float* ns_out;                  /* Output ready for the current hop */
+    float* ns_ola;                  /* Overlap-add tail */
+    float* window;                  /* sqrt-Hann */
+    float* tw_cos;
+    float* tw_sin;
+    float* re;
+    float* im;
+    float* noise;                   /* Noise power per bin */
+    float* prev_clean;              /* Previous clean power per bin (DD) */
+
+    /* AGC */
+    float agc_level;
+    float agc_gain;
+};
+
+/* ========================================
+ * Math helpers (no libm)
+ * ======================================== */
+
+static double dsqrt(double x)
+{
+    double r;
+    int i;
+
+    if (x <= 0.0) {
+        return 0.0;
+    }
+    r = x > 1.0 ? x * 0.5 : 1.0;
+    for (i = 0; i < 64; i++) {
+        double n = 0.5 * (r + x / r);
+        if (n == r) {
+            break;
+        }
+        r = n;
+    }
+    return r;
+}
+
+static int16_t sat16(int32_t v)
+{
+    if (v > 32767) return 32767;
+    if (v < -32768) return -32768;
+    return (int16_t)v;
+}
+
+/* ========================================
+ * NLMS inner loops
+ * ======================================== */
+
+/**
+ * @brief sum(w[i] * x[i]); n is a multiple of 8
+ *
+ * 累加按模2^32进行：中间结果溢出不影响最终结果。
+ */
+static int32_t dot_q14(const int16_t* w, const int16_t* x, int n)
+{
+#if defined(APM_USE_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    int32x2_t sum;
+    int i;
+
+    for (i = 0; i < n; i += 8) {
+        int16x8_t vw = vld1q_s16(w + i);
+        int16x8_t vx = vld1q_s16(x + i);
+        acc = vmlal_s16(acc, vget_low_s16(vw), vget_low_s16(vx));
+        acc = vmlal_s16(acc, vget_high_s16(vw), vget_high_s16(vx));
+    }
+    sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+    return vget_lane_s32(vpadd_s32(sum, sum), 0);
+#elif defined(APM_USE_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    int32_t lanes[4];
+    int i;
+
+    for (i = 0; i < n; i += 8) {
+        __m128i vw = _mm_loadu_si128((const __m128i*)(w + i));
+        __m128i vx = _mm_loadu_si128((const __m128i*)(x + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(vw, vx));
+    }
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return (int32_t)((uint32_t)lanes[0] + (uint32_t)lanes[1] +
+                     (uint32_t)lanes[2] + (uint32_t)lanes[3]);
+#else
+    uint32_t acc = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        acc += (uint32_t)((int32_t)w[i] * x[i]);
+    }
+    return (int32_t)acc;
+#endif
+}
+
+/**
+ * @brief w[i] += round(x[i] * g / 2^15) (saturating); n is a multiple of 8,
+ *        |g| < 16384
+ *
+ * 必须舍入：截断会让每个系数每次更新都偏向负方向。
+ */
+static void update_q14(int16_t* w, const int16_t* x, int16_t g, int n)
+{
+#if defined(APM_USE_NEON)
+    int i;
+    for (i = 0; i < n; i += 8) {
+        int16x8_t vx = vld1q_s16(x + i);
+        vst1q_s16(w + i, vqaddq_s16(vld1q_s16(w + i), vqrdmulhq_n_s16(vx, g)));
+    }
+#elif defined(APM_USE_SSE2)
+    __m128i g2 = _mm_set1_epi16((int16_t)(g * 2));
+    int i;
+    for (i = 0; i < n; i += 8) {
+        __m128i vx = _mm_loadu_si128((const __m128i*)(x + i));
+        __m128i vw = _mm_loadu_si128((const __m128i*)(w + i));
+        /* 高16位 + 低16位的最高位 = 四舍五入 */
+        __m128i hi = _mm_mulhi_epi16(vx, g2);
+        __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(vx, g2), 15);
+        _mm_storeu_si128((__m128i*)(w + i), _mm_adds_epi16(vw, _mm_add_epi16(hi, lo)));
+    }
+#else
+    int i;
+    for (i = 0; i < n; i++) {
+        w[i] = sat16((int32_t)w[i] + (((int32_t)x[i] * (g * 2) + 0x8000) >> 16));
+    }
+#endif
+}
+
+/* ========================================
+ * Echo canceller
+ * ======================================== */
+
+static int16_t far_get(const lws_apm_t* apm, int64_t idx)
+{
+    if (idx < 0 || (uint64_t)idx >= apm->far_total ||
+        apm->far_total - (uint64_t)idx > (uint64_t)apm->far_size) {
+        return 0;
+    }
+    return apm->far[idx % apm->far_size];
+}
+
+static float block_env(float energy, int n)
+{
+    return (float)dsqrt(energy / (float)n);
+}
+
+/**
+ * @brief A near-end envelope block is complete: update the correlation
+ * @param anchor Render sample index played at the end of the block
+ */
+static void delay_update(lws_apm_t* apm, float env, int64_t anchor)
+{
+    int64_t fb = anchor / apm->block;
+    int64_t done = (int64_t)(apm->far_total / apm->block);
+    float n = env - apm->near_mean;
+    float norm;
+    int best = 0;
+    int l;
+
+    apm->near_mean += (env - apm->near_mean) * AEC_MEAN_SMOOTH;
+    if (anchor < 0 || apm->far_mean < AEC_FAR_ACTIVE / 4) {
+        return;
+    }
+
+    apm->near_var = apm->near_var * AEC_CORR_LEAK + n * n;
+    for (l = 0; l < apm->lags; l++) {
+        int64_t b = fb - l;
+        float f;
+
+        if (b < 0 || b >= done || done - b > apm->env_size) {
+            continue;
+        }
+        f = apm->far_env[b % apm->env_size] - apm->far_mean;
+        apm->corr[l] = apm->corr[l] * AEC_CORR_LEAK + n * f;
+        if (apm->corr[l] > apm->corr[best]) {
+            best = l;
+        }
+    }
+
+    norm = (float)dsqrt((double)apm->near_var * apm->far_var);
+    if (norm <= 0.0f || apm->corr[best] < AEC_CORR_MIN * norm) {
+        apm->cand_count = 0;
+        return;
+    }
+
+    if (best != apm->cand_blocks) {
+        apm->cand_blocks = best;
+        apm->cand_count = 0;
+    }
+    if (++apm->cand_count < AEC_DELAY_STABLE || best == apm->delay_blocks) {
+        return;
+    }
+
+    /* 延迟变化超过一块时重新收敛 */
+    if (apm->delay_blocks < 0 || best > apm->delay_blocks + 1 || best < apm->delay_blocks - 1) {
+        int d = best - AEC_DELAY_MARGIN;
+        apm->delay = (d > 0 ? d : 0) * apm->block;
+        memset(apm->w, 0, apm->taps * sizeof(int16_t));
+    }
+    apm->delay_blocks = best;
+}
+
+static void far_block(lws_apm_t* apm, float env)
+{
+    uint64_t b = apm->far_total / apm->block - 1;
+    float f;
+
+    apm->far_env[b % apm->env_size] = env;
+    apm->far_mean += (env - apm->far_mean) * AEC_MEAN_SMOOTH;
+    f = env - apm->far_mean;
+    apm->far_var = apm->far_var * AEC_CORR_LEAK + f * f;
+}
+
+static void aec_process(lws_apm_t* apm, int16_t* pcm, int n)
+{
+    int64_t base = (int64_t)apm->far_total - n - apm->delay - (apm->taps - 1);
+    int64_t energy = 0;
+    int64_t near_energy = 0;
+    int64_t err_energy = 0;
+    int64_t echo_energy = 0;
+    int xmax = 0, near_peak = 0;
+    int mu;
+    int far_active, dt = 0;
+    int i, k;
+
+    /* 近端包络（延迟估计） */
+    for (k = 0; k < n; k++) {
+        apm->near_acc += (float)pcm[k] * pcm[k];
+        if (++apm->near_acc_n == apm->block) {
+            delay_update(apm, block_env(apm->near_acc, apm->block),
+                         (int64_t)apm->far_total - n + k);
+            apm->near_acc = 0.0f;
+            apm->near_acc_n = 0;
+        }
+    }
+
+    for (i = 0; i < apm->taps - 1 + n; i++) {
+        int16_t x = far_get(apm, base + i);
+        int ax = x < 0 ? -x : x;
+        apm->xh[i] = x;
+        if (ax > xmax) xmax = ax;
+    }
+    for (k = 0; k < n; k++) {
+        int a = pcm[k] < 0 ? -pcm[k] : pcm[k];
+        if (a > near_peak) near_peak = a;
+    }
+
+    /*
+     * Geigel双讲检测：近端峰值超过远端峰值的thr倍时冻结自适应。
+     * 回声路径的峰值比按90%分位数跟踪（仅用未判为双讲的帧）。
+     */
+    far_active = xmax >= AEC_FAR_ACTIVE;
+    if (far_active) {
+        float ratio = (float)near_peak / (float)xmax;
+        float thr = apm->dt_ratio * AEC_DT_MARGIN;
+
+        if (thr < AEC_DT_MIN) thr = AEC_DT_MIN;
+        if (thr > AEC_DT_MAX) thr = AEC_DT_MAX;
+        dt = ratio > thr;
+        if (!dt && near_peak >= AEC_FAR_ACTIVE) {
+            apm->dt_ratio += ratio > apm->dt_ratio ? AEC_DT_STEP * 0.9f : -AEC_DT_STEP * 0.1f;
+        }
+    }
+
+    for (i = 0; i < apm->taps; i++) {
+        energy += (int32_t)apm->xh[i] * apm->xh[i];
+    }
+
+    /*
+     * 变步长：回声估计占残差的比例越小（未收敛或有近端语音）步长越小，
+     * 弥补Geigel漏检的双讲。
+     */
+    mu = AEC_MU_Q15;
+    if (apm->echo_energy < apm->err_energy) {
+        float r = apm->echo_energy / (apm->err_energy + 1.0f);
+        mu = (int)(AEC_MU_Q15 * (r > AEC_MU_MIN ? r : AEC_MU_MIN));
+    }
+
+    for (k = 0; k < n; k++) {
+        const int16_t* x = apm->xh + k;
+        int32_t y = dot_q14(apm->w, x, apm->taps);
+        int16_t e = sat16((int32_t)pcm[k] - ((y + (1 << 13)) >> 14));
+
+        if (far_active && !dt) {
+            int64_t g = ((int64_t)mu * e * 16384) /
+                        (energy + (int64_t)apm->taps * 1024);
+            if (g > 16383) g = 16383;
+            if (g < -16383) g = -16383;
+            if (g != 0) {
+                update_q14(apm->w, x, (int16_t)g, apm->taps);
+            }
+        }
+
+        if (k + 1 < n) {
+            energy += (int32_t)x[apm->taps] * x[apm->taps] - (int32_t)x[0] * x[0];
+        }
+        near_energy += (int32_t)pcm[k] * pcm[k];
+        err_energy += (int32_t)e * e;
+        echo_energy += (int64_t)(pcm[k] - e) * (pcm[k] - e);
+        pcm[k] = e;
+    }
+
+    if (far_active) {
+        apm->echo_energy += ((float)echo_energy - apm->echo_energy) * 0.5f;
+        apm->err_energy += ((float)err_energy - apm->err_energy) * 0.5f;
+    }
+
+    /* 发散保护：残差明显大于输入时重置滤波器 */
+    if (err_energy > 4 * near_energy + (int64_t)n * 1024) {
+        memset(apm->w, 0, apm->taps * sizeof(int16_t));
+        apm->echo_energy = 0.0f;
+    }
+}
+
+/* ========================================
+ * Noise suppressor
+ * ======================================== */
+
+static void fft(lws_apm_t* apm, float* re, float* im, int inverse)
+{
+    int n = apm->fft_size;
+    int i, j, len;
+
+    for (i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (len = 2; len <= n; len <<= 1) {
+        int step = n / len;
+        for (i = 0; i < n; i += len) {
+            for (j = 0; j < len / 2; j++) {
+                float wr = apm->tw_cos[j * step];
+                float wi = inverse ? apm->tw_sin[j * step] : -apm->tw_sin[j * step];
+                int a = i + j, b = i + j + len / 2;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+static void ns_block(lws_apm_t* apm)
+{
+    int n = apm->fft_size;
+    int hop = apm->hop;
+    float* re = apm->re;
+    float* im = apm->im;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        re[i] = apm->ns_buf[i] * apm->window[i];
+        im[i] = 0.0f;
+    }
+    fft(apm, re, im, 0);
+
+    for (i = 0; i <= n / 2; i++) {
+        float p = re[i] * re[i] + im[i] * im[i];
+        float noise = apm->noise[i];
+        float post, prio, g;
+
+        if (apm->ns_frames < NS_INIT_FRAMES) {
+            noise += (p - noise) / (float)(apm->ns_frames + 1);
+        } else if (p < noise * NS_SPEECH_SNR) {
+            noise += (p - noise) * NS_NOISE_SMOOTH;
+        } else {
+            noise *= NS_NOISE_RISE;
+        }
+        if (noise < 1e-3f) {
+            noise = 1e-3f;
+        }
+        apm->noise[i] = noise;
+
+        post = p / noise;
+        prio = NS_DD_ALPHA * apm->prev_clean[i] / noise +
+               (1.0f - NS_DD_ALPHA) * (post > 1.0f ? post - 1.0f : 0.0f);
+        g = prio / (1.0f + prio);
+        if (g < NS_GAIN_MIN) {
+            g = NS_GAIN_MIN;
+        }
+        apm->prev_clean[i] = g * g * p;
+
+        re[i] *= g;
+        im[i] *= g;
+        if (i > 0 && i < n / 2) {
+            re[n - i] = re[i];
+            im[n - i] = -im[i];
+        }
+    }
+    apm->ns_frames++;
+
+    fft(apm, re, im, 1);
+    for (i = 0; i < hop; i++) {
+        apm->ns_out[i] = apm->ns_ola[i] + re[i] * apm->window[i] / (float)n;
+        apm->ns_ola[i] = re[hop + i] * apm->window[hop + i] / (float)n;
+    }
+    memmove(apm->ns_buf, apm->ns_buf + hop, hop * sizeof(float));
+}
+
+static void ns_process(lws_apm_t* apm, int16_t* pcm, int n)
+{
+    int k;
+
+    for (k = 0; k < n; k++) {
+        float out = apm->ns_out[apm->ns_pos];
+
+        apm->ns_buf[apm->hop + apm->ns_pos] = (float)pcm[k];
+        pcm[k] = sat16((int32_t)(out + (out < 0.0f ? -0.5f : 0.5f)));
+        if (++apm->ns_pos == apm->hop) {
+            ns_block(apm);
+            apm->ns_pos = 0;
+        }
+    }
+}
+
+/* ========================================
+ * AGC
+ * ======================================== */
+
+static void agc_process(lws_apm_t* apm, int16_t* pcm, int n)
+{
+    float power = 0.0f;
+    float target, gain, start, limit;
+    int peak = 1;
+    int k;
+
+    for (k = 0; k < n; k++) {
+        int a = pcm[k] < 0 ? -pcm[k] : pcm[k];
+        power += (float)pcm[k] * pcm[k];
+        if (a > peak) peak = a;
+    }
+    power /= (float)n;
+
+    /* 电平估计：上升快、下降慢 */
+    if (power > AGC_SPEECH_POWER) {
+        float coef = power > apm->agc_level ? 0.3f : 0.05f;
+        apm->agc_level += (power - apm->agc_level) * coef;
+    }
+
+    target = (float)dsqrt(AGC_TARGET_POWER / apm->agc_level);
+    if (target > AGC_MAX_GAIN) target = AGC_MAX_GAIN;
+    if (target < AGC_MIN_GAIN) target = AGC_MIN_GAIN;
+    limit = 32767.0f / (float)peak;
+    if (target > limit) {
+        target = limit;
+    }
+
+    gain = apm->agc_gain;
+    if (target < gain) {
+        gain = target;
+    } else if (target > gain * AGC_GAIN_RISE) {
+        gain *= AGC_GAIN_RISE;
+    } else {
+        gain = target;
+    }
+
+    /* 帧内线性过渡，避免增益跳变；起点也不超过本帧的削波限 */
+    start = apm->agc_gain < limit ? apm->agc_gain : limit;
+    for (k = 0; k < n; k++) {
+        float g = start + (gain - start) * (float)(k + 1) / (float)n;
+        float v = (float)pcm[k] * g;
+        pcm[k] = sat16((int32_t)(v + (v < 0.0f ? -0.5f : 0.5f)));
+    }
+    apm->agc_gain = gain;
+}
+
+/* ========================================
+ * Public API
+ * ======================================== */
+
+static int ns_init(lws_apm_t* apm)
+{
+    double c, s;
+    double ck = 1.0, sk = 0.0;
+    int n, i;
+
+    n = apm->sample_rate <= 8000 ? 256 : (apm->sample_rate <= 16000 ? 512 : 1024);
+    apm->fft_size = n;
+    apm->hop = n / 2;
+
+    apm->ns_buf = (float*)lws_calloc(n, sizeof(float));
+    apm->ns_out = (float*)lws_calloc(n / 2, sizeof(float));
+    apm->ns_ola = (float*)lws_calloc(n / 2, sizeof(float));
+    apm->window = (float*)lws_calloc(n, sizeof(float));
+    apm->tw_cos = (float*)lws_calloc(n / 2, sizeof(float));
+    apm->tw_sin = (float*)lws_calloc(n / 2, sizeof(float));
+    apm->re = (float*)lws_calloc(n, sizeof(float));
+    apm->im = (float*)lws_calloc(n, sizeof(float));
+    apm->noise = (float*)lws_calloc(n / 2 + 1, sizeof(float));
+    apm->prev_clean = (float*)lws_calloc(n / 2 + 1, sizeof(float));
+    if (!apm->ns_buf || !apm->ns_out || !apm->ns_ola || !apm->window ||
+        !apm->tw_cos || !apm->tw_sin || !apm->re || !apm->im ||
+        !apm->noise || !apm->prev_clean) {
+        return -1;
+    }
+
+    /* cos/sin(pi/n)：从pi/2开始半角递推 */
+    c = 0.0;
+    s = 1.0;
+    for (i = 4; i <= n; i <<= 1) {
+        c = dsqrt((1.0 + c) * 0.5);
+        s = s / (2.0 * c);
+    }
+
+    /* window[i] = sin(pi*i/n)，twiddle = exp(2*pi*j*k/n) */
+    for (i = 0; i < n; i++) {
+        double t;
+        apm->window[i] = (float)sk;
+        if ((i & 1) == 0) {
+            apm->tw_cos[i / 2] = (float)ck;
+            apm->tw_sin[i / 2] = (float)sk;
+        }
+        t = ck * c - sk * s;
+        sk = sk * c + ck * s;
+        ck = t;
+    }
+    return 0;
+}
+
+lws_apm_t* lws_apm_create(int sample_rate, int frame_samples, int flags)
+{
+    lws_apm_t* apm;
+
+    if (sample_rate <= 0 || frame_samples <= 0) {
+        return NULL;
+    }
+
+    apm = (lws_apm_t*)lws_calloc(1, sizeof(*apm));
+    if (!apm) {
+        return NULL;
+    }
+
+    if (sample_rate > LWS_APM_AEC_MAX_RATE) {
+        flags &= ~LWS_APM_AEC;
+    }
+    apm->flags = flags;
+    apm->sample_rate = sample_rate;
+    apm->frame_samples = frame_samples;
+    apm->agc_level = AGC_TARGET_POWER;
+    apm->agc_gain = 1.0f;
+
+    if (flags & LWS_APM_AEC) {
+        apm->taps = (sample_rate * LWS_APM_TAIL_MS / 1000 + 7) & ~7;
+        apm->block = sample_rate * AEC_BLOCK_MS / 1000;
+        apm->lags = LWS_APM_MAX_DELAY_MS / AEC_BLOCK_MS + 1;
+        apm->env_size = apm->lags + frame_samples / apm->block + 2;
+        apm->far_size = sample_rate * LWS_APM_MAX_DELAY_MS / 1000 + apm->taps +
+                        2 * frame_samples;
+        apm->delay_blocks = -1;
+        apm->cand_blocks = -1;
+        apm->dt_ratio = AEC_DT_INIT;
+
+        apm->far = (int16_t*)lws_calloc(apm->far_size, sizeof(int16_t));
+        apm->far_env = (float*)lws_calloc(apm->env_size, sizeof(float));
+        apm->corr = (float*)lws_calloc(apm->lags, sizeof(float));
+        apm->w = (int16_t*)lws_calloc(apm->taps, sizeof(int16_t));
+        apm->xh = (int16_t*)lws_calloc(apm->taps + frame_samples, sizeof(int16_t));
+        if (!apm->far || !apm->far_env || !apm->corr || !apm->w || !apm->xh) {
+            lws_apm_destroy(apm);
+            return NULL;
+        }
+    }
+
+    if ((flags & LWS_APM_NS) && ns_init(apm) != 0) {
+        lws_apm_destroy(apm);
+        return NULL;
+    }
+
+    return apm;
+}
+
+void lws_apm_destroy(lws_apm_t* apm)
+{
+    if (!apm) {
+        return;
+    }
+
+    lws_free(apm->far);
+    lws_free(apm->far_env);
+    lws_free(apm->corr);
+    lws_free(apm->w);
+    lws_free(apm->xh);
+    lws_free(apm->ns_buf);
+    lws_free(apm->ns_out);
+    lws_free(apm->ns_ola);
+    lws_free(apm->window);
+    lws_free(apm->tw_cos);
+    lws_free(apm->tw_sin);
+    lws_free(apm->re);
+    lws_free(apm->im);
+    lws_free(apm->noise);
+    lws_free(apm->prev_clean);
+    lws_free(apm);
+}
+
+int lws_apm_flags(const lws_apm_t* apm)
+{
+    return apm ? apm->flags : 0;
+}
+
+void lws_apm_render(lws_apm_t* apm, const int16_t* pcm, int samples)
+{
+    int k;
+
+    if (!apm || !(apm->flags & LWS_APM_AEC)) {
+        return;
+    }
+
+    for (k = 0; k < samples; k++) {
+        apm->far[apm->far_total % apm->far_size] = pcm[k];
+        apm->far_total++;
+        apm->far_acc += (float)pcm[k] * pcm[k];
+        if (++apm->far_acc_n == apm->block) {
+            far_block(apm, block_env(apm->far_acc, apm->block));
+            apm->far_acc = 0.0f;
+            apm->far_acc_n = 0;
+        }
+    }
+}
+
+void lws_apm_capture(lws_apm_t* apm, int16_t* pcm, int samples)
+{
+    if (!apm) {
+        return;
+    }
+
+    while (samples > 0) {
+        int n = samples < apm->frame_samples ? samples : apm->frame_samples;
+
+        if (apm->flags & LWS_APM_AEC) {
+            aec_process(apm, pcm, n);
+        }
+        if (apm->flags & LWS_APM_NS) {
+            ns_process(apm, pcm, n);
+        }
+        if (apm->flags & LWS_APM_AGC) {
+            agc_process(apm, pcm, n);
+        }
+        pcm += n;
+        samples -= n;
+    }
+}
+
+int lws_apm_delay_ms(const lws_apm_t* apm)
+{
+    if (!apm || apm->delay_blocks < 0) {
+        return -1;
+    }
+    return apm->delay_blocks * AEC_BLOCK_MS;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file lws_apm.h
+ * @brief Voice processing between capture and the encoder (AEC, NS, AGC)
+ *
+ * The built-in stage runs, in this order:
+ * - Acoustic echo canceller: fixed-point NLMS filter over the playback
+ *   signal (the "render" stream), aligned by an envelope correlation delay
+ *   estimator so the taps only have to cover the room response.
+ * - Noise suppressor: decision-directed Wiener gain per FFT bin, noise
+ *   spectrum tracked during speech pauses. Adds half an FFT block of
+ *   latency (16 ms at 8 kHz and 16 kHz, about 10 ms at 48 kHz).
+ * - AGC: slow digital gain towards a target speech level, limited so the
+ *   output does not clip.
+ *
+ * The NLMS inner loops use NEON or SSE2 when the compiler targets them.
+ * Floating point is used without libm.
+ */
+
+#ifndef __LWS_APM_H__
+#define __LWS_APM_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Constants
+ * ======================================== */
+
+#define LWS_APM_AEC             0x01    /**< Echo cancellation */
+#define LWS_APM_NS              0x02    /**< Noise suppression */
+#define LWS_APM_AGC             0x04    /**< Automatic gain control */
+
+#define LWS_APM_AEC_MAX_RATE    16000   /**< AEC is dropped above this sample rate */
+#define LWS_APM_TAIL_MS         64      /**< Echo tail covered by the filter */
+#define LWS_APM_MAX_DELAY_MS    500     /**< Longest playback-to-capture delay searched */
+
+typedef struct lws_apm_t lws_apm_t;
+
+/* ========================================
+ * API
+ * ======================================== */
+
+/**
+ * @brief Create a processing stage
+ * @param sample_rate Sample rate of both streams (mono 16-bit)
+ * @param frame_samples Largest frame passed to lws_apm_render/lws_apm_capture
+ * @param flags LWS_APM_* components to enable
+ * @return Stage, NULL on failure
+ */
+lws_apm_t* lws_apm_create(int sample_rate, int frame_samples, int flags);
+
+/**
+ * @brief Destroy a processing stage
+ */
+void lws_apm_destroy(lws_apm_t* apm);
+
+/**
+ * @brief Components actually running
+ *
+ * LWS_APM_AEC is cleared when the sample rate is above LWS_APM_AEC_MAX_RATE.
+ */
+int lws_apm_flags(const lws_apm_t* apm);
+
+/**
+ * @brief Feed a frame that is being written to the playback device
+ *
+ * Call this for everything played out, in the same thread as
+ * lws_apm_capture.
+ */
+void lws_apm_render(lws_apm_t* apm, const int16_t* pcm, int samples);
+
+/**
+ * @brief Process a captured frame in place
+ */
+void lws_apm_capture(lws_apm_t* apm, int16_t* pcm, int samples);
+
+/**
+ * @brief Estimated playback-to-capture delay
+ * @return Delay in milliseconds, -1 while unknown
+ */
+int lws_apm_delay_ms(const lws_apm_t* apm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_APM_H__ */
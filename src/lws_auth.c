@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 
 #ifdef __APPLE__
@@ -272,3 +273,304 @@ int lws_auth_build_authorization_header(const lws_auth_response_t* response,
 
     return 0;
 }
+
+/* ========================================
+ * Server side (registrar) implementation
+ * ======================================== */
+
+int lws_auth_generate_nonce(const char* secret, uint32_t timestamp, uint32_t seq,
+                            char* nonce, size_t nonce_len) {
+    if (!secret || !nonce || nonce_len < LWS_AUTH_NONCE_LEN + 1) {
+        return -1;
+    }
+
+    /* nonce = hex(timestamp) + hex(seq) + MD5(hex(timestamp):hex(seq):secret) */
+    char input[256];
+    char digest[33];
+    snprintf(input, sizeof(input), "%08x:%08x:%s", timestamp, seq, secret);
+    calculate_md5(input, digest);
+
+    snprintf(nonce, nonce_len, "%08x%08x%s", timestamp, seq, digest);
+    return 0;
+}
+
+int lws_auth_check_nonce(const char* secret, const char* nonce,
+                         uint32_t now, uint32_t max_age) {
+    if (!secret || !nonce || strlen(nonce) != LWS_AUTH_NONCE_LEN) {
+        return -1;
+    }
+
+    char hex[9];
+    memcpy(hex, nonce, 8);
+    hex[8] = '\0';
+    uint32_t timestamp = (uint32_t)strtoul(hex, NULL, 16);
+    memcpy(hex, nonce + 8, 8);
+    uint32_t seq = (uint32_t)strtoul(hex, NULL, 16);
+
+    char expected[LWS_AUTH_NONCE_LEN + 1];
+    if (lws_auth_generate_nonce(secret, timestamp, seq, expected, sizeof(expected)) < 0 ||
+        strcmp(expected, nonce) != 0) {
+        return -1;
+    }
+
+    if (timestamp > now || now - timestamp > max_age) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int lws_auth_nonce_issue(lws_auth_nonce_table_t* table, const char* secret, uint32_t now,
+                         char* nonce, size_t nonce_len) {
+    if (!table || lws_auth_generate_nonce(secret, now, table->next_seq++, nonce, nonce_len) < 0) {
+        return -1;
+    }
+
+    /* 空位或最早签发的nonce（过期的总是最早的） */
+    int slot = 0;
+    for (int i = 0; i < LWS_AUTH_NONCE_SLOTS; i++) {
+        if (table->slots[i].nonce[0] == '\0') {
+            slot = i;
+            break;
+        }
+        if (table->slots[i].issued < table->slots[slot].issued) {
+            slot = i;
+        }
+    }
+
+    memcpy(table->slots[slot].nonce, nonce, LWS_AUTH_NONCE_LEN + 1);
+    table->slots[slot].issued = now;
+    table->slots[slot].nc = 0;
+    return 0;
+}
+
+int lws_auth_nonce_use(lws_auth_nonce_table_t* table, const lws_auth_authorization_t* auth) {
+    if (!table || !auth) {
+        return -1;
+    }
+
+    for (int i = 0; i < LWS_AUTH_NONCE_SLOTS; i++) {
+        if (table->slots[i].nonce[0] == '\0' || strcmp(table->slots[i].nonce, auth->nonce) != 0) {
+            continue;
+        }
+
+        uint32_t nc = UINT32_MAX;  /* 无qop：nonce只能用一次 */
+        if (auth->qop[0] != '\0') {
+            char* end = NULL;
+            unsigned long v = strtoul(auth->nc, &end, 16);
+            if (strlen(auth->nc) != 8 || *end != '\0' || v == 0) {
+                return -1;
+            }
+            nc = (uint32_t)v;
+        }
+
+        if (table->slots[i].nc >= nc) {
+            lws_log_warn(0, "[AUTH] Replayed nonce count %s for %s\n", auth->nc, auth->username);
+            return -1;
+        }
+        table->slots[i].nc = nc;
+        return 0;
+    }
+
+    return -1;
+}
+
+int lws_auth_build_challenge_header(const char* realm, const char* nonce, int stale,
+                                    char* header, size_t header_len) {
+    if (!realm || !nonce || !header) {
+        return -1;
+    }
+
+    int written = snprintf(header, header_len,
+                           "Digest realm=\"%s\", nonce=\"%s\", algorithm=MD5, qop=\"auth\"%s",
+                           realm, nonce, stale ? ", stale=true" : "");
+    if (written < 0 || (size_t)written >= header_len) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int lws_auth_parse_authorization(const char* header, lws_auth_authorization_t* auth) {
+    if (!header || !auth) {
+        return -1;
+    }
+
+    memset(auth, 0, sizeof(lws_auth_authorization_t));
+
+    /* Skip scheme */
+    while (*header == ' ') {
+        header++;
+    }
+    if (strncasecmp(header, "Digest", 6) != 0) {
+        return -1;
+    }
+    const char* p = header + 6;
+
+    /*
+     * Tokenize name=value pairs instead of strstr() lookups: parameter names
+     * such as "nc" also occur inside other names ("nonce", "cnonce").
+     */
+    while (*p) {
+        while (*p == ' ' || *p == ',' || *p == '\t') {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+
+        const char* name = p;
+        while (*p && *p != '=' && *p != ' ' && *p != ',') {
+            p++;
+        }
+        size_t name_len = p - name;
+        while (*p == ' ') {
+            p++;
+        }
+        if (*p != '=') {
+            continue;
+        }
+        p++;
+        while (*p == ' ') {
+            p++;
+        }
+
+        const char* value;
+        size_t value_len;
+        if (*p == '"') {
+            value = ++p;
+            while (*p && *p != '"') {
+                p++;
+            }
+            value_len = p - value;
+            if (*p == '"') {
+                p++;
+            }
+        } else {
+            value = p;
+            while (*p && *p != ',' && *p != ' ') {
+                p++;
+            }
+            value_len = p - value;
+        }
+
+        char* dst = NULL;
+        size_t dst_len = 0;
+#define AUTH_PARAM(field) \
+        if (name_len == strlen(#field) && strncasecmp(name, #field, name_len) == 0) { \
+            dst = auth->field; dst_len = sizeof(auth->field); \
+        }
+        AUTH_PARAM(username)
+        else AUTH_PARAM(realm)
+        else AUTH_PARAM(nonce)
+        else AUTH_PARAM(uri)
+        else AUTH_PARAM(response)
+        else AUTH_PARAM(algorithm)
+        else AUTH_PARAM(qop)
+        else AUTH_PARAM(cnonce)
+        else AUTH_PARAM(nc)
+        else AUTH_PARAM(opaque)
+#undef AUTH_PARAM
+
+        if (dst) {
+            if (value_len >= dst_len) {
+                value_len = dst_len - 1;
+            }
+            memcpy(dst, value, value_len);
+            dst[value_len] = '\0';
+        }
+    }
+
+    if (auth->username[0] == '\0' || auth->nonce[0] == '\0' ||
+        auth->uri[0] == '\0' || auth->response[0] == '\0') {
+        lws_log_error(0, "[AUTH] Incomplete Authorization header\n");
+        return -1;
+    }
+
+    if (auth->algorithm[0] == '\0') {
+        strcpy(auth->algorithm, "MD5");
+    }
+
+    return 0;
+}
+
+int lws_auth_verify_response(const lws_auth_authorization_t* auth,
+                             const char* method,
+                             const char* password) {
+    if (!auth || !method || !password) {
+        return -1;
+    }
+
+    if (strcasecmp(auth->algorithm, "MD5") != 0) {
+        lws_log_error(0, "[AUTH] Unsupported algorithm: %s\n", auth->algorithm);
+        return -1;
+    }
+
+    char input[1024];
+    char ha1[33];
+    char ha2[33];
+    char expected[33];
+
+    /* HA1 = MD5(username:realm:password) */
+    snprintf(input, sizeof(input), "%s:%s:%s", auth->username, auth->realm, password);
+    calculate_md5(input, ha1);
+
+    /* HA2 = MD5(method:uri) */
+    snprintf(input, sizeof(input), "%s:%s", method, auth->uri);
+    calculate_md5(input, ha2);
+
+    if (auth->qop[0] != '\0') {
+        snprintf(input, sizeof(input), "%s:%s:%s:%s:%s:%s",
+                 ha1, auth->nonce, auth->nc, auth->cnonce, auth->qop, ha2);
+    } else {
+        snprintf(input, sizeof(input), "%s:%s:%s", ha1, auth->nonce, ha2);
+    }
+    calculate_md5(input, expected);
+
+    if (strcasecmp(expected, auth->response) != 0) {
+        lws_log_debug("[AUTH] Digest mismatch for %s\n", auth->username);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Split a SIP URI into scheme, userinfo and hostport (parameters dropped)
+ */
+static void split_uri(const char* uri, const char** scheme, size_t* scheme_len,
+                      const char** user, size_t* user_len,
+                      const char** host, size_t* host_len) {
+    const char* colon = strchr(uri, ':');
+    const char* p = colon ? colon + 1 : uri;
+    const char* end = p + strcspn(p, ";?>");
+    const char* at = memchr(p, '@', end - p);
+
+    *scheme = uri;
+    *scheme_len = colon ? (size_t)(colon - uri) : 0;
+    *user = p;
+    *user_len = at ? (size_t)(at - p) : 0;
+    *host = at ? at + 1 : p;
+    *host_len = end - *host;
+}
+
+int lws_auth_check_uri(const lws_auth_authorization_t* auth, const char* request_uri) {
+    const char *s1, *u1, *h1, *s2, *u2, *h2;
+    size_t s1_len, u1_len, h1_len, s2_len, u2_len, h2_len;
+
+    if (!auth || !request_uri) {
+        return -1;
+    }
+
+    split_uri(auth->uri, &s1, &s1_len, &u1, &u1_len, &h1, &h1_len);
+    split_uri(request_uri, &s2, &s2_len, &u2, &u2_len, &h2, &h2_len);
+
+    if (s1_len != s2_len || strncasecmp(s1, s2, s1_len) != 0 ||
+        u1_len != u2_len || strncmp(u1, u2, u1_len) != 0 ||
+        h1_len != h2_len || strncasecmp(h1, h2, h1_len) != 0) {
+        lws_log_debug("[AUTH] Digest uri %s does not match %s\n", auth->uri, request_uri);
+        return -1;
+    }
+
+    return 0;
+}
@@ -17,6 +17,9 @@ extern "C" {
  * Data structures
  * ======================================== */
 
+#define LWS_AUTH_NONCE_LEN      48      /**< Length of a server nonce (without NUL) */
+#define LWS_AUTH_NONCE_SLOTS    64      /**< Outstanding nonces a registrar tracks */
+
 /**
  * @brief Digest authentication challenge from server
  */
@@ -51,6 +54,38 @@ typedef struct {
     char opaque[256];       /**< Opaque value */
 } lws_auth_response_t;
 
+/**
+ * @brief Digest credentials received by a server (Authorization header)
+ */
+typedef struct {
+    char username[64];      /**< Username */
+    char realm[256];        /**< Authentication realm */
+    char nonce[256];        /**< Nonce echoed by the client */
+    char uri[512];          /**< Digest URI */
+    char response[33];      /**< Client response (32 hex chars + null) */
+    char algorithm[16];     /**< Algorithm */
+    char qop[64];           /**< Quality of protection */
+    char cnonce[128];       /**< Client nonce */
+    char nc[16];            /**< Nonce count (8 hex digits) */
+    char opaque[256];       /**< Opaque value */
+} lws_auth_authorization_t;
+
+/**
+ * @brief Nonces issued by a registrar, each with the highest nonce count accepted
+ *
+ * Makes every (nonce, nc) pair single-use so a captured request cannot be
+ * replayed. When full, the oldest nonce is dropped; its client gets a stale
+ * challenge on the next request.
+ */
+typedef struct {
+    struct {
+        char nonce[LWS_AUTH_NONCE_LEN + 1];
+        uint32_t issued;    /**< Issue time (seconds) */
+        uint32_t nc;        /**< Highest nonce count accepted (0 = unused) */
+    } slots[LWS_AUTH_NONCE_SLOTS];
+    uint32_t next_seq;      /**< Sequence embedded in the next nonce */
+} lws_auth_nonce_table_t;
+
 /* ========================================
  * Public API
  * ======================================== */
@@ -91,6 +126,105 @@ int lws_auth_build_authorization_header(const lws_auth_response_t* response,
                                        char* header,
                                        size_t header_len);
 
+/* ========================================
+ * Server side (registrar) API
+ * ======================================== */
+
+/**
+ * @brief Generate a server nonce
+ *
+ * The nonce embeds the issue time, a sequence number and a digest keyed by
+ * a server secret, so a registrar can check its origin and age later. The
+ * sequence keeps nonces issued within the same second distinct.
+ *
+ * @param secret Server secret
+ * @param timestamp Issue time (seconds)
+ * @param seq Sequence number
+ * @param nonce Output buffer (at least LWS_AUTH_NONCE_LEN + 1 bytes)
+ * @param nonce_len Size of output buffer
+ * @return 0 on success, -1 on failure
+ */
+int lws_auth_generate_nonce(const char* secret, uint32_t timestamp, uint32_t seq,
+                            char* nonce, size_t nonce_len);
+
+/**
+ * @brief Validate a nonce generated by lws_auth_generate_nonce()
+ * @param secret Server secret
+ * @param nonce Nonce echoed by the client
+ * @param now Current time (seconds)
+ * @param max_age Maximum nonce age (seconds)
+ * @return 0 if valid, 1 if valid but stale, -1 if forged or malformed
+ */
+int lws_auth_check_nonce(const char* secret, const char* nonce,
+                         uint32_t now, uint32_t max_age);
+
+/**
+ * @brief Generate a nonce and record it as outstanding
+ * @param table Nonce table of the registrar
+ * @param secret Server secret
+ * @param now Current time (seconds)
+ * @param nonce Output buffer (at least LWS_AUTH_NONCE_LEN + 1 bytes)
+ * @param nonce_len Size of output buffer
+ * @return 0 on success, -1 on failure
+ */
+int lws_auth_nonce_issue(lws_auth_nonce_table_t* table, const char* secret, uint32_t now,
+                         char* nonce, size_t nonce_len);
+
+/**
+ * @brief Accept the nonce count of verified credentials at most once
+ *
+ * With qop the nc must be higher than any accepted before for the nonce
+ * (RFC 2617 §3.2.2); without qop the nonce is single-use.
+ *
+ * @param table Nonce table of the registrar
+ * @param auth Credentials whose digest was verified
+ * @return 0 if accepted, -1 if replayed or the nonce is not outstanding
+ */
+int lws_auth_nonce_use(lws_auth_nonce_table_t* table, const lws_auth_authorization_t* auth);
+
+/**
+ * @brief Build WWW-Authenticate or Proxy-Authenticate header value
+ * @param realm Authentication realm
+ * @param nonce Server nonce
+ * @param stale Set stale=true (nonce expired, credentials were valid)
+ * @param header Output buffer for header value
+ * @param header_len Size of output buffer
+ * @return 0 on success, -1 on failure
+ */
+int lws_auth_build_challenge_header(const char* realm, const char* nonce, int stale,
+                                    char* header, size_t header_len);
+
+/**
+ * @brief Parse Authorization or Proxy-Authorization header
+ * @param header The header value (e.g., "Digest username=\"alice\", ...")
+ * @param auth Output structure to store parsed credentials
+ * @return 0 on success, -1 on failure
+ */
+int lws_auth_parse_authorization(const char* header, lws_auth_authorization_t* auth);
+
+/**
+ * @brief Verify a client digest response
+ * @param auth Parsed Authorization header
+ * @param method SIP method of the request
+ * @param password Password of auth->username
+ * @return 0 if the response matches, -1 otherwise
+ */
+int lws_auth_verify_response(const lws_auth_authorization_t* auth,
+                             const char* method,
+                             const char* password);
+
+/**
+ * @brief Check that the digest URI names the Request-URI (RFC 2617 §3.2.2.5)
+ *
+ * Scheme and host are compared case-insensitively, the user part exactly;
+ * URI parameters and headers are ignored.
+ *
+ * @param auth Parsed Authorization header
+ * @param request_uri Request-URI of the request carrying it
+ * @return 0 if they match, -1 otherwise
+ */
+int lws_auth_check_uri(const lws_auth_authorization_t* auth, const char* request_uri);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,772 @@
+/**
+ * @file lws_codec.c
+ * @brief RTP codec registry and SDP offer/answer negotiation implementation
+ *
+ * 编解码协商按RFC 3264进行：
+ * - offer：按本端优先级列出编解码，动态PT在96-127中分配
+ * - answer：选择本端优先级最高且对端提供的编解码，沿用对端的PT
+ * - 收到answer：以对端PT发送，仍按本端offer的PT接收（非对称映射）
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "lws_codec.h"
+
+/* ========================================
+ * Codec registry
+ * ======================================== */
+
+#define PT_DYNAMIC_MIN  96
+#define PT_DYNAMIC_MAX  127
+
+/* RFC 6184 §8.1: profile-level-id缺省为42 00 0A */
+#define H264_DEFAULT_PROFILE_LEVEL_ID   0x42000a
+
+static const lws_codec_info_t s_codecs[] = {
+    /* codec                          name               clock  ch  static  fmtp                                           video aux */
+    { LWS_RTP_PAYLOAD_PCMU,            "PCMU",            8000,  1,  0,      NULL,                                          0,    0 },
+    { LWS_RTP_PAYLOAD_PCMA,            "PCMA",            8000,  1,  8,      NULL,                                          0,    0 },
+    /* G.722以16kHz采样，但RTP时钟按历史原因为8000 (RFC 3551 §4.5.2) */
+    { LWS_RTP_PAYLOAD_G722,            "G722",            8000,  1,  9,      NULL,                                          0,    0 },
+    { LWS_RTP_PAYLOAD_L16_2,           "L16",             44100, 2,  10,     NULL,                                          0,    0 },
+    { LWS_RTP_PAYLOAD_L16_1,           "L16",             44100, 1,  11,     NULL,                                          0,    0 },
+    /* RFC 7587: rtpmap固定为opus/48000/2，实际声道由fmtp的stereo参数决定 */
+    { LWS_RTP_PAYLOAD_OPUS,            "opus",            48000, 2,  -1,     "minptime=10;useinbandfec=1",                  0,    0 },
+    { LWS_RTP_PAYLOAD_H264,            "H264",            90000, 1,  -1,     "profile-level-id=42e01f;packetization-mode=1", 1,    0 },
+    { LWS_RTP_PAYLOAD_H265,            "H265",            90000, 1,  -1,     NULL,                                          1,    0 },
+    { LWS_RTP_PAYLOAD_VP8,             "VP8",             90000, 1,  -1,     NULL,                                          1,    0 },
+    { LWS_RTP_PAYLOAD_VP9,             "VP9",             90000, 1,  -1,     NULL,                                          1,    0 },
+    /* 时钟频率随所伴随的音频编码变化 (RFC 4733 §7.1.1) */
+    { LWS_RTP_PAYLOAD_TELEPHONE_EVENT, "telephone-event", 8000,  1,  -1,     "0-16",                                        0,    1 },
+    /* 8kHz使用静态PT 13，其它时钟频率动态分配 (RFC 3389 §5) */
+    { LWS_RTP_PAYLOAD_CN,              "CN",              8000,  1,  13,     NULL,                                          0,    1 },
+    /* fmtp的apt随所重传的视频编码变化 (RFC 4588 §8.6) */
+    { LWS_RTP_PAYLOAD_RTX,             "rtx",             90000, 1,  -1,     NULL,                                          1,    1 },
+    /* 时钟、声道与fmtp随所冗余的音频编码变化 (RFC 2198 §5) */
+    { LWS_RTP_PAYLOAD_RED,             "red",             8000,  1,  -1,     NULL,                                          0,    1 },
+};
+
+/* 辅助格式，按offer中的顺序 */
+static const struct {
+    int flag;
+    lws_rtp_payload_t codec;
+} s_aux_formats[] = {
+    { LWS_CODEC_AUX_TE, LWS_RTP_PAYLOAD_TELEPHONE_EVENT },
+    { LWS_CODEC_AUX_CN, LWS_RTP_PAYLOAD_CN },
+};
+
+#define AUX_FORMAT_COUNT ((int)(sizeof(s_aux_formats) / sizeof(s_aux_formats[0])))
+
+#define CODEC_COUNT ((int)(sizeof(s_codecs) / sizeof(s_codecs[0])))
+
+const lws_codec_info_t* lws_codec_info(lws_rtp_payload_t codec)
+{
+    int i;
+    for (i = 0; i < CODEC_COUNT; i++) {
+        if (s_codecs[i].codec == codec) {
+            return &s_codecs[i];
+        }
+    }
+    return NULL;
+}
+
+/* ========================================
+ * fmtp helpers
+ * ======================================== */
+
+static lws_sdp_str_t str_trim(const char* p, const char* end)
+{
+    lws_sdp_str_t s;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    s.p = p;
+    s.n = (int)(end - p);
+    return s;
+}
+
+int lws_codec_fmtp_param(lws_sdp_str_t fmtp, const char* name, lws_sdp_str_t* value)
+{
+    const char* p = fmtp.p;
+    const char* end = fmtp.p + fmtp.n;
+    int name_len = (int)strlen(name);
+
+    while (p < end) {
+        const char* sep = memchr(p, ';', end - p);
+        const char* item_end = sep ? sep : end;
+        const char* eq = memchr(p, '=', item_end - p);
+
+        if (eq) {
+            lws_sdp_str_t key = str_trim(p, eq);
+            if (key.n == name_len && strncasecmp(key.p, name, name_len) == 0) {
+                *value = str_trim(eq + 1, item_end);
+                return 1;
+            }
+        }
+        p = sep ? sep + 1 : end;
+    }
+
+    return 0;
+}
+
+static int fmtp_int(lws_sdp_str_t fmtp, const char* name, int def)
+{
+    lws_sdp_str_t v;
+    int n = 0;
+    int i;
+
+    if (!lws_codec_fmtp_param(fmtp, name, &v) || v.n == 0) {
+        return def;
+    }
+    for (i = 0; i < v.n; i++) {
+        if (v.p[i] < '0' || v.p[i] > '9') {
+            return def;
+        }
+        n = n * 10 + (v.p[i] - '0');
+    }
+    return n;
+}
+
+/**
+ * @brief profile-level-id as 0xPPCCLL (profile_idc, constraint flags, level_idc)
+ */
+static int h264_profile_level_id(lws_sdp_str_t fmtp)
+{
+    lws_sdp_str_t v;
+    int id = 0;
+    int i;
+
+    if (!lws_codec_fmtp_param(fmtp, "profile-level-id", &v) || v.n != 6) {
+        return H264_DEFAULT_PROFILE_LEVEL_ID;
+    }
+    for (i = 0; i < 6; i++) {
+        char c = v.p[i];
+        int d;
+        if (c >= '0' && c <= '9') d = c - '0';
+        else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+        else return H264_DEFAULT_PROFILE_LEVEL_ID;
+        id = (id << 4) | d;
+    }
+    return id;
+}
+
+/**
+ * @brief Whether an H.264 profile can be decoded as (constrained) baseline
+ *
+ * Baseline (profile_idc 0x42)，或constraint_set1_flag置位的其它profile
+ * （如4de01f，码流同时满足Constrained Baseline约束）。
+ */
+static int h264_baseline_compatible(int profile_level_id)
+{
+    int profile_idc = (profile_level_id >> 16) & 0xff;
+    int constraints = (profile_level_id >> 8) & 0xff;
+    return profile_idc == 0x42 || (constraints & 0x40) != 0;
+}
+
+/* ========================================
+ * Format matching
+ * ======================================== */
+
+/**
+ * @brief Identify the codec of an offered/answered format
+ * @return Codec description, NULL if unknown
+ */
+static const lws_codec_info_t* fmt_codec(const lws_sdp_fmt_t* fmt)
+{
+    int i;
+
+    if (fmt->encoding.n == 0) {
+        /* 静态PT可省略rtpmap */
+        for (i = 0; i < CODEC_COUNT; i++) {
+            if (s_codecs[i].static_pt >= 0 && s_codecs[i].static_pt == fmt->pt) {
+                return &s_codecs[i];
+            }
+        }
+        return NULL;
+    }
+
+    for (i = 0; i < CODEC_COUNT; i++) {
+        const lws_codec_info_t* info = &s_codecs[i];
+        if ((int)strlen(info->name) != fmt->encoding.n ||
+            strncasecmp(info->name, fmt->encoding.p, fmt->encoding.n) != 0) {
+            continue;
+        }
+        if (info->aux) {
+            return info;
+        }
+        if (fmt->clock_rate != info->clock_rate) {
+            continue;
+        }
+        /* Opus的声道字段恒为2，不参与比较 */
+        if (info->codec != LWS_RTP_PAYLOAD_OPUS && fmt->channels != info->channels) {
+            continue;
+        }
+        return info;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Fill an entry with a symmetric payload type
+ */
+static void entry_init(lws_sess_codec_t* e, const lws_codec_info_t* info,
+                       int pt, int clock_rate)
+{
+    memset(e, 0, sizeof(*e));
+    e->codec = info->codec;
+    snprintf(e->name, sizeof(e->name), "%s", info->name);
+    e->send_pt = pt;
+    e->recv_pt = pt;
+    e->clock_rate = clock_rate;
+    e->channels = info->channels;
+    if (info->fmtp) {
+        snprintf(e->fmtp, sizeof(e->fmtp), "%s", info->fmtp);
+    }
+}
+
+/**
+ * @brief Build the answer parameters for an offered format
+ * @return 0 if the format is acceptable, -1 otherwise
+ */
+static int answer_params(const lws_codec_info_t* info, const lws_sdp_fmt_t* fmt,
+                         lws_sess_codec_t* e)
+{
+    if (info->codec == LWS_RTP_PAYLOAD_H264) {
+        int mode = fmtp_int(fmt->fmtp, "packetization-mode", 0);
+        int remote = h264_profile_level_id(fmt->fmtp);
+        lws_sdp_str_t local_fmtp = { info->fmtp, (int)strlen(info->fmtp) };
+        int local = h264_profile_level_id(local_fmtp);
+        int level;
+
+        /* 仅支持Single NAL和Non-interleaved (STAP-A/FU-A) */
+        if (mode != 0 && mode != 1) {
+            return -1;
+        }
+        if (!h264_baseline_compatible(remote)) {
+            return -1;
+        }
+        /* 应答的level不超过offer和本端能力 (RFC 6184 §8.2.2) */
+        level = LWS_MIN(remote & 0xff, local & 0xff);
+        snprintf(e->fmtp, sizeof(e->fmtp), "profile-level-id=%04x%02x;packetization-mode=%d",
+                 (remote >> 8) & 0xffff, level, mode);
+        return 0;
+    }
+
+    if (info->aux) {
+        /* telephone-event：回应对端声明的事件范围；CN无参数 */
+        lws_sdp_str_copy(e->fmtp, sizeof(e->fmtp), fmt->fmtp);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Primary payload type of a RED format ("0/0" -> 0)
+ * @return Payload type, -1 if the fmtp is missing or malformed
+ */
+static int red_primary_pt(lws_sdp_str_t fmtp)
+{
+    int pt = 0;
+    int i;
+
+    for (i = 0; i < fmtp.n && fmtp.p[i] != '/'; i++) {
+        if (fmtp.p[i] < '0' || fmtp.p[i] > '9' || pt > PT_DYNAMIC_MAX) {
+            return -1;
+        }
+        pt = pt * 10 + (fmtp.p[i] - '0');
+    }
+    return i > 0 && pt <= PT_DYNAMIC_MAX ? pt : -1;
+}
+
+/**
+ * @brief Whether an answered format corresponds to one of our offered entries
+ */
+static int answer_matches(const lws_sess_codec_t* e, const lws_codec_info_t* info,
+                          const lws_sdp_fmt_t* fmt)
+{
+    if (e->codec != info->codec) {
+        return 0;
+    }
+    if (info->aux) {
+        return fmt->clock_rate == 0 || fmt->clock_rate == e->clock_rate;
+    }
+    if (info->codec == LWS_RTP_PAYLOAD_H264) {
+        lws_sdp_str_t ours = { e->fmtp, (int)strlen(e->fmtp) };
+        return fmtp_int(fmt->fmtp, "packetization-mode", 0) ==
+               fmtp_int(ours, "packetization-mode", 0);
+    }
+    return 1;
+}
+
+/* ========================================
+ * Offer / answer
+ * ======================================== */
+
+/**
+ * @brief Payload type for an offered format
+ *
+ * 静态PT（仅在其定义的时钟频率下），否则优先使用枚举值，
+ * 再取96-127中最小的空闲值。
+ *
+ * @return Payload type, -1 if the dynamic range is exhausted
+ */
+static int offer_pt(const uint8_t* used, const lws_codec_info_t* info, int clock_rate)
+{
+    int pt;
+
+    if (info->static_pt >= 0 && clock_rate == info->clock_rate) {
+        return info->static_pt;
+    }
+    if ((int)info->codec >= PT_DYNAMIC_MIN && (int)info->codec <= PT_DYNAMIC_MAX &&
+        !used[info->codec]) {
+        return (int)info->codec;
+    }
+    for (pt = PT_DYNAMIC_MIN; pt <= PT_DYNAMIC_MAX && used[pt]; pt++) {
+    }
+    return pt <= PT_DYNAMIC_MAX ? pt : -1;
+}
+
+int lws_codec_offer(lws_codec_table_t* table, const lws_rtp_payload_t* prefs,
+                    int count, int aux)
+{
+    uint8_t used[PT_DYNAMIC_MAX + 1];
+    int rates[LWS_MAX_CODECS];
+    int rate_count = 0;
+    int i, j, k;
+
+    memset(table, 0, sizeof(*table));
+    memset(used, 0, sizeof(used));
+
+    for (i = 0; i < count && table->count < LWS_MAX_CODECS; i++) {
+        const lws_codec_info_t* info = lws_codec_info(prefs[i]);
+        int pt;
+
+        if (!info || info->aux || lws_codec_find(table, info->codec, 0)) {
+            continue;
+        }
+
+        pt = offer_pt(used, info, info->clock_rate);
+        if (pt < 0) {
+            break;
+        }
+        used[pt] = 1;
+        entry_init(&table->entries[table->count++], info, pt, info->clock_rate);
+
+        if (!info->video) {
+            for (j = 0; j < rate_count && rates[j] != info->clock_rate; j++) {
+            }
+            if (j == rate_count) {
+                rates[rate_count++] = info->clock_rate;
+            }
+        }
+    }
+
+    if (table->count == 0) {
+        return -1;
+    }
+
+    /* RTX：每个视频编码一个，apt指向所重传的编码 */
+    if (aux & LWS_CODEC_AUX_RTX) {
+        const lws_codec_info_t* rtx = lws_codec_info(LWS_RTP_PAYLOAD_RTX);
+        int video_count = table->count;
+        for (i = 0; i < video_count && table->count < LWS_MAX_CODECS; i++) {
+            lws_sess_codec_t* e;
+            int pt;
+            if (!lws_codec_info(table->entries[i].codec)->video) {
+                continue;
+            }
+            pt = offer_pt(used, rtx, rtx->clock_rate);
+            if (pt < 0) {
+                break;
+            }
+            used[pt] = 1;
+            e = &table->entries[table->count++];
+            entry_init(e, rtx, pt, rtx->clock_rate);
+            snprintf(e->fmtp, sizeof(e->fmtp), "apt=%d", table->entries[i].recv_pt);
+        }
+    }
+
+    /* 辅助格式：每个音频时钟频率一个 */
+    for (k = 0; k < AUX_FORMAT_COUNT; k++) {
+        const lws_codec_info_t* info = lws_codec_info(s_aux_formats[k].codec);
+        if (!(aux & s_aux_formats[k].flag)) {
+            continue;
+        }
+        for (i = 0; i < rate_count && table->count < LWS_MAX_CODECS; i++) {
+            int pt = offer_pt(used, info, rates[i]);
+            if (pt < 0) {
+                break;
+            }
+            used[pt] = 1;
+            entry_init(&table->entries[table->count++], info, pt, rates[i]);
+        }
+    }
+
+    /* RED：每个音频编码一个，排在telephone-event/CN之后，PT不足时先舍弃 */
+    if (aux & LWS_CODEC_AUX_RED) {
+        const lws_codec_info_t* red = lws_codec_info(LWS_RTP_PAYLOAD_RED);
+        int codec_count = table->count;
+        for (i = 0; i < codec_count && table->count < LWS_MAX_CODECS; i++) {
+            const lws_sess_codec_t* primary = &table->entries[i];
+            lws_sess_codec_t* e;
+            int pt;
+            if (lws_codec_info(primary->codec)->video || lws_codec_info(primary->codec)->aux) {
+                continue;
+            }
+            pt = offer_pt(used, red, primary->clock_rate);
+            if (pt < 0) {
+                break;
+            }
+            used[pt] = 1;
+            e = &table->entries[table->count++];
+            entry_init(e, red, pt, primary->clock_rate);
+            e->channels = primary->channels;
+            snprintf(e->fmtp, sizeof(e->fmtp), "%d/%d", primary->recv_pt, primary->recv_pt);
+        }
+    }
+
+    return table->count;
+}
+
+int lws_codec_answer(lws_codec_table_t* table, const lws_rtp_payload_t* prefs,
+                     int count, int aux, const lws_sdp_media_t* offer)
+{
+    const lws_sess_codec_t* primary;
+    int i, j, k;
+
+    memset(table, 0, sizeof(*table));
+
+    /* 本端优先级最高、且对端提供的编解码 */
+    for (i = 0; i < count && table->count == 0; i++) {
+        const lws_codec_info_t* info = lws_codec_info(prefs[i]);
+        if (!info || info->aux) {
+            continue;
+        }
+        for (j = 0; j < offer->fmt_count; j++) {
+            const lws_sdp_fmt_t* fmt = &offer->fmts[j];
+            lws_sess_codec_t* e = &table->entries[0];
+
+            if (fmt_codec(fmt) != info) {
+                continue;
+            }
+            entry_init(e, info, fmt->pt, info->clock_rate);
+            if (answer_params(info, fmt, e) == 0) {
+                table->count = 1;
+                break;
+            }
+        }
+    }
+
+    if (table->count == 0) {
+        return -1;
+    }
+    primary = &table->entries[0];
+
+    /* 视频只接受重传所选编码的RTX */
+    if (lws_codec_info(primary->codec)->video) {
+        for (j = 0; (aux & LWS_CODEC_AUX_RTX) && j < offer->fmt_count; j++) {
+            const lws_sdp_fmt_t* fmt = &offer->fmts[j];
+            const lws_codec_info_t* info = fmt_codec(fmt);
+            if (info && info->codec == LWS_RTP_PAYLOAD_RTX &&
+                fmtp_int(fmt->fmtp, "apt", -1) == primary->recv_pt) {
+                lws_sess_codec_t* e = &table->entries[table->count++];
+                entry_init(e, info, fmt->pt, info->clock_rate);
+                answer_params(info, fmt, e);
+                break;
+            }
+        }
+        return table->count;
+    }
+
+    /* 辅助格式须与所选编码的时钟频率一致 */
+    for (k = 0; k < AUX_FORMAT_COUNT; k++) {
+        if (!(aux & s_aux_formats[k].flag)) {
+            continue;
+        }
+        for (j = 0; j < offer->fmt_count; j++) {
+            const lws_sdp_fmt_t* fmt = &offer->fmts[j];
+            const lws_codec_info_t* info = fmt_codec(fmt);
+            int clock_rate;
+
+            if (!info || info->codec != s_aux_formats[k].codec) {
+                continue;
+            }
+            /* 静态PT 13可省略rtpmap */
+            clock_rate = fmt->clock_rate ? fmt->clock_rate : info->clock_rate;
+            if (clock_rate == primary->clock_rate) {
+                lws_sess_codec_t* e = &table->entries[table->count];
+                entry_init(e, info, fmt->pt, clock_rate);
+                answer_params(info, fmt, e);
+                table->count++;
+                break;
+            }
+        }
+    }
+
+    /* RED只接受冗余所选编码的格式 */
+    for (j = 0; (aux & LWS_CODEC_AUX_RED) && j < offer->fmt_count; j++) {
+        const lws_sdp_fmt_t* fmt = &offer->fmts[j];
+        const lws_codec_info_t* info = fmt_codec(fmt);
+        if (info && info->codec == LWS_RTP_PAYLOAD_RED &&
+            fmt->clock_rate == primary->clock_rate &&
+            red_primary_pt(fmt->fmtp) == primary->recv_pt) {
+            lws_sess_codec_t* e = &table->entries[table->count++];
+            entry_init(e, info, fmt->pt, primary->clock_rate);
+            e->channels = primary->channels;
+            answer_params(info, fmt, e);
+            break;
+        }
+    }
+
+    return table->count;
+}
+
+int lws_codec_apply_answer(lws_codec_table_t* table, const lws_sdp_media_t* answer)
+{
+    lws_codec_table_t result;
+    uint8_t taken[LWS_MAX_CODECS];
+    int i, j;
+
+    memset(&result, 0, sizeof(result));
+    memset(taken, 0, sizeof(taken));
+
+    for (i = 0; i < answer->fmt_count && result.count < LWS_MAX_CODECS; i++) {
+        const lws_sdp_fmt_t* fmt = &answer->fmts[i];
+        const lws_codec_info_t* info = fmt_codec(fmt);
+        int found = -1;
+
+        if (!info) {
+            continue;
+        }
+
+        /* 优先匹配相同PT（对称映射），否则按编码匹配（非对称映射） */
+        for (j = 0; j < table->count; j++) {
+            if (!taken[j] && table->entries[j].recv_pt == fmt->pt &&
+                answer_matches(&table->entries[j], info, fmt)) {
+                found = j;
+                break;
+            }
+        }
+        for (j = 0; found < 0 && j < table->count; j++) {
+            if (!taken[j] && answer_matches(&table->entries[j], info, fmt)) {
+                found = j;
+            }
+        }
+        if (found < 0) {
+            continue;
+        }
+
+        taken[found] = 1;
+        result.entries[result.count] = table->entries[found];
+        result.entries[result.count].send_pt = fmt->pt;
+        result.count++;
+    }
+
+    if (!lws_codec_primary(&result)) {
+        return -1;
+    }
+
+    *table = result;
+    return table->count;
+}
+
+/* ========================================
+ * Queries and SDP output
+ * ======================================== */
+
+const lws_sess_codec_t* lws_codec_primary(const lws_codec_table_t* table)
+{
+    int i;
+    for (i = 0; i < table->count; i++) {
+        const lws_codec_info_t* info = lws_codec_info(table->entries[i].codec);
+        if (info && !info->aux) {
+            return &table->entries[i];
+        }
+    }
+    return NULL;
+}
+
+const lws_sess_codec_t* lws_codec_red(const lws_codec_table_t* table,
+                                      const lws_sess_codec_t* primary)
+{
+    int i;
+    for (i = 0; i < table->count; i++) {
+        const lws_sess_codec_t* e = &table->entries[i];
+        lws_sdp_str_t fmtp = { e->fmtp, (int)strlen(e->fmtp) };
+        if (e->codec == LWS_RTP_PAYLOAD_RED && red_primary_pt(fmtp) == primary->recv_pt) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+const lws_sess_codec_t* lws_codec_find(const lws_codec_table_t* table,
+                                       lws_rtp_payload_t codec, int clock_rate)
+{
+    int i;
+    for (i = 0; i < table->count; i++) {
+        if (table->entries[i].codec == codec &&
+            (clock_rate == 0 || table->entries[i].clock_rate == clock_rate)) {
+            return &table->entries[i];
+        }
+    }
+    return NULL;
+}
+
+int lws_codec_write_sdp(const lws_codec_table_t* table, const char* media,
+                        uint16_t port, const char* proto, char* buf, int size)
+{
+    int len = 0;
+    int n;
+    int i;
+
+    n = snprintf(buf, size, "m=%s %u %s", media, (unsigned)port, proto);
+    if (n < 0 || n >= size) return -1;
+    len += n;
+
+    for (i = 0; i < table->count; i++) {
+        n = snprintf(buf + len, size - len, " %d", table->entries[i].recv_pt);
+        if (n < 0 || n >= size - len) return -1;
+        len += n;
+    }
+    n = snprintf(buf + len, size - len, "\r\n");
+    if (n < 0 || n >= size - len) return -1;
+    len += n;
+
+    for (i = 0; i < table->count; i++) {
+        const lws_sess_codec_t* e = &table->entries[i];
+
+        if (e->channels > 1) {
+            n = snprintf(buf + len, size - len, "a=rtpmap:%d %s/%d/%d\r\n",
+                         e->recv_pt, e->name, e->clock_rate, e->channels);
+        } else {
+            n = snprintf(buf + len, size - len, "a=rtpmap:%d %s/%d\r\n",
+                         e->recv_pt, e->name, e->clock_rate);
+        }
+        if (n < 0 || n >= size - len) return -1;
+        len += n;
+
+        if (e->fmtp[0]) {
+            n = snprintf(buf + len, size - len, "a=fmtp:%d %s\r\n", e->recv_pt, e->fmtp);
+            if (n < 0 || n >= size - len) return -1;
+            len += n;
+        }
+    }
+
+    return len;
+}
+
+/* ========================================
+ * Packetization time
+ * ======================================== */
+
+/* 采样型编码的帧可直接拼接成一个包 (RFC 3551 §4.2) */
+static int codec_frames_concatenate(lws_rtp_payload_t codec)
+{
+    switch (codec) {
+    case LWS_RTP_PAYLOAD_PCMU:
+    case LWS_RTP_PAYLOAD_PCMA:
+    case LWS_RTP_PAYLOAD_G722:
+    case LWS_RTP_PAYLOAD_L16_1:
+    case LWS_RTP_PAYLOAD_L16_2:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int lws_codec_ptime(lws_rtp_payload_t codec, const lws_codec_ptime_policy_t* policy,
+                    int remote_ptime, int remote_maxptime)
+{
+    int frame = policy->frame_ms;
+    int limit, want;
+
+    if (frame <= 0 || policy->frame_bytes <= 0 || !codec_frames_concatenate(codec)) {
+        return frame;
+    }
+
+    /* 上限：载荷大小，对端a=maxptime（缺省时以a=ptime为限） */
+    limit = policy->max_payload / policy->frame_bytes * frame;
+    if (remote_maxptime > 0) {
+        limit = LWS_MIN(limit, remote_maxptime);
+    } else if (remote_ptime > 0) {
+        limit = LWS_MIN(limit, remote_ptime);
+    }
+
+    if (policy->preferred > 0) {
+        want = policy->preferred;
+    } else if (remote_ptime > 0) {
+        want = remote_ptime;
+    } else if (remote_maxptime > 0) {
+        /* 自动：时延上限内，头部占比不超过overhead_pct的最短ptime */
+        for (want = frame; want + frame <= policy->max_ptime; want += frame) {
+            int payload = want / frame * policy->frame_bytes;
+            if (policy->header_bytes * 100 <=
+                policy->overhead_pct * (policy->header_bytes + payload)) {
+                break;
+            }
+        }
+    } else {
+        want = frame;
+    }
+
+    want = LWS_MIN(want, limit) / frame * frame;
+    return LWS_MAX(want, frame);
+}
+
+/* ========================================
+ * Opus packet duration
+ * ======================================== */
+
+int lws_codec_opus_samples(const uint8_t* data, int bytes)
+{
+    /* 每帧时长（48kHz采样）：SILK 10/20/40/60ms，Hybrid 10/20ms，CELT 2.5/5/10/20ms */
+    static const int silk[4] = { 480, 960, 1920, 2880 };
+    static const int celt[4] = { 120, 240, 480, 960 };
+    int config;
+    int frame;
+    int count;
+
+    if (!data || bytes < 1) {
+        return 0;
+    }
+
+    config = data[0] >> 3;
+    if (config < 12) {
+        frame = silk[config & 3];
+    } else if (config < 16) {
+        frame = (config & 1) ? 960 : 480;
+    } else {
+        frame = celt[config & 3];
+    }
+
+    switch (data[0] & 3) {
+    case 0:
+        count = 1;
+        break;
+    case 1:
+    case 2:
+        count = 2;
+        break;
+    default:
+        /* code 3：第二字节低6位为帧数 */
+        if (bytes < 2) {
+            return 0;
+        }
+        count = data[1] & 0x3f;
+        break;
+    }
+
+    /* RFC 6716 §3.2.5：一个包不超过120ms */
+    if (count == 0 || frame * count > 5760) {
+        return 0;
+    }
+    return frame * count;
+}
@@ -0,0 +1,210 @@
+/**
+ * @file lws_codec.h
+ * @brief RTP codec registry and SDP offer/answer negotiation (RFC 3264)
+ *
+ * A negotiated codec table lists, in preference order, the formats agreed
+ * for one m= section. Each entry carries the payload type we send with
+ * (the peer's receive PT) and the one we receive on (the PT we advertise),
+ * so asymmetric dynamic payload type mapping is handled transparently.
+ */
+
+#ifndef __LWS_CODEC_H__
+#define __LWS_CODEC_H__
+
+#include "lws_sess.h"
+#include "lws_sdp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Codec registry
+ * ======================================== */
+
+/**
+ * @brief Static description of a codec known to lwsip
+ */
+typedef struct {
+    lws_rtp_payload_t codec;    /**< Codec identifier */
+    const char* name;           /**< a=rtpmap encoding name */
+    int clock_rate;             /**< RTP clock rate */
+    int channels;               /**< Channels (a=rtpmap third field) */
+    int static_pt;              /**< RFC 3551 static payload type, -1 = dynamic */
+    const char* fmtp;           /**< Parameters we advertise (NULL = none) */
+    int video;                  /**< m=video codec */
+    int aux;                    /**< Auxiliary format (telephone-event, CN), never primary */
+} lws_codec_info_t;
+
+/**
+ * @brief Look up a codec by identifier
+ * @return Codec description, NULL if unknown
+ */
+const lws_codec_info_t* lws_codec_info(lws_rtp_payload_t codec);
+
+/* ========================================
+ * Negotiated codec table
+ * ======================================== */
+
+/* Auxiliary formats added next to the audio codecs */
+#define LWS_CODEC_AUX_TE    0x01    /**< RFC 4733 telephone-event */
+#define LWS_CODEC_AUX_CN    0x02    /**< RFC 3389 comfort noise */
+#define LWS_CODEC_AUX_RTX   0x04    /**< RFC 4588 retransmission, one per video codec */
+#define LWS_CODEC_AUX_RED   0x08    /**< RFC 2198 redundant audio, one per audio codec */
+
+/**
+ * @brief Codec table of one m= section
+ */
+typedef struct {
+    lws_sess_codec_t entries[LWS_MAX_CODECS];
+    int count;
+} lws_codec_table_t;
+
+/**
+ * @brief Build the table for a local offer
+ *
+ * Static codecs use their RFC 3551 payload type. Dynamic codecs keep their
+ * lws_rtp_payload_t value when it is free, otherwise take the lowest free
+ * PT in 96-127. Each requested auxiliary format is added once per distinct
+ * audio clock rate (RFC 4733 §7.1.1, RFC 3389 §5); CN at 8000 Hz uses the
+ * static PT 13. An RTX format is added for each video codec, its apt
+ * naming the codec's PT, and a RED format for each audio codec, its fmtp
+ * naming the codec's PT; RED comes last so that it is the first dropped
+ * when the table is full. Unknown and duplicate codecs are skipped.
+ *
+ * @param table Output table (send_pt == recv_pt until an answer arrives)
+ * @param prefs Codecs in local preference order
+ * @param count Number of codecs in prefs
+ * @param aux Auxiliary formats to offer (LWS_CODEC_AUX_*)
+ * @return Number of entries, -1 if no usable codec
+ */
+int lws_codec_offer(lws_codec_table_t* table, const lws_rtp_payload_t* prefs,
+                    int count, int aux);
+
+/**
+ * @brief Answer a remote offer
+ *
+ * Selects the first codec of prefs that the offer carries, keeping the
+ * offer's payload type in both directions (RFC 3264 §6.1) and echoing its
+ * compatible parameters (H.264 packetization-mode, level capped to ours).
+ * Auxiliary formats are accepted only at the selected codec's clock rate,
+ * RTX and RED only when their fmtp names the selected codec.
+ *
+ * @param table Output table
+ * @param prefs Codecs in local preference order
+ * @param count Number of codecs in prefs
+ * @param aux Auxiliary formats to accept (LWS_CODEC_AUX_*)
+ * @param offer Remote m= section
+ * @return Number of entries, -1 if no common codec
+ */
+int lws_codec_answer(lws_codec_table_t* table, const lws_rtp_payload_t* prefs,
+                     int count, int aux, const lws_sdp_media_t* offer);
+
+/**
+ * @brief Apply the remote answer to our offer
+ *
+ * Entries the answer accepted are reordered to the answer's order and get
+ * the answer's payload type as send_pt; the receive PT stays the one we
+ * offered. Entries not in the answer are dropped. On failure the table is
+ * left untouched.
+ *
+ * @param table Table built by lws_codec_offer (or a previous negotiation)
+ * @param answer Remote m= section
+ * @return Number of entries, -1 if the answer accepted no primary codec
+ */
+int lws_codec_apply_answer(lws_codec_table_t* table, const lws_sdp_media_t* answer);
+
+/**
+ * @brief First non-auxiliary entry (the codec media is sent with)
+ * @return Entry, NULL if none
+ */
+const lws_sess_codec_t* lws_codec_primary(const lws_codec_table_t* table);
+
+/**
+ * @brief RED entry carrying a codec (its fmtp names the codec's receive PT)
+ * @return Entry, NULL if RED was not negotiated for the codec
+ */
+const lws_sess_codec_t* lws_codec_red(const lws_codec_table_t* table,
+                                      const lws_sess_codec_t* primary);
+
+/**
+ * @brief Entry for a codec at a clock rate (0 = any)
+ * @return Entry, NULL if not negotiated
+ */
+const lws_sess_codec_t* lws_codec_find(const lws_codec_table_t* table,
+                                       lws_rtp_payload_t codec, int clock_rate);
+
+/**
+ * @brief Write the m= line and a=rtpmap/a=fmtp lines for a table
+ * @param table Codec table (receive PTs are advertised)
+ * @param media "audio" / "video"
+ * @param port Media port
+ * @param proto Transport protocol ("RTP/AVP", "RTP/SAVP", ...)
+ * @param buf Output buffer
+ * @param size Buffer size
+ * @return Bytes written, -1 if the buffer is too small
+ */
+int lws_codec_write_sdp(const lws_codec_table_t* table, const char* media,
+                        uint16_t port, const char* proto, char* buf, int size);
+
+/* ========================================
+ * Packetization time
+ * ======================================== */
+
+/**
+ * @brief Inputs of the ptime choice for one audio codec
+ */
+typedef struct {
+    int frame_ms;               /**< Codec frame duration */
+    int frame_bytes;            /**< Payload bytes of one frame */
+    int header_bytes;           /**< Per-packet IP/UDP/RTP overhead */
+    int max_payload;            /**< Largest RTP payload to build */
+    int overhead_pct;           /**< Automatic choice: largest acceptable header share */
+    int max_ptime;              /**< Automatic choice: latency bound (ms) */
+    int preferred;              /**< Configured ptime, 0 = automatic */
+} lws_codec_ptime_policy_t;
+
+/**
+ * @brief Choose the ptime to send with
+ *
+ * Only sample-based encodings (G.711, G.722, L16) pack several frames per
+ * packet by concatenation (RFC 3551 §4.2); other codecs keep one frame.
+ * The configured ptime wins, then the peer's a=ptime. Otherwise, when the
+ * peer announced how long a packet it accepts, the shortest ptime within
+ * max_ptime whose header share is at most overhead_pct is used, so that
+ * small frames are packed and large ones are not delayed. A peer that
+ * announced neither gets one frame per packet. The result never exceeds
+ * the peer's a=maxptime (or, without it, its a=ptime) nor max_payload,
+ * and is a multiple of frame_ms.
+ *
+ * @param codec Codec sent with
+ * @param policy Frame size and policy bounds
+ * @param remote_ptime Peer's a=ptime, 0 if absent
+ * @param remote_maxptime Peer's a=maxptime, 0 if absent
+ * @return ptime in ms
+ */
+int lws_codec_ptime(lws_rtp_payload_t codec, const lws_codec_ptime_policy_t* policy,
+                    int remote_ptime, int remote_maxptime);
+
+/**
+ * @brief Find a parameter in an a=fmtp value ("a=1;b=2")
+ * @param fmtp Parameter list
+ * @param name Parameter name (case-insensitive)
+ * @param value Output value slice
+ * @return 1 if found, 0 otherwise
+ */
+int lws_codec_fmtp_param(lws_sdp_str_t fmtp, const char* name, lws_sdp_str_t* value);
+
+/**
+ * @brief Duration of an Opus packet from its TOC byte (RFC 6716 §3.1)
+ * @param data Opus packet (RTP payload)
+ * @param bytes Packet length
+ * @return Samples at 48 kHz, 0 if the packet is malformed
+ */
+int lws_codec_opus_samples(const uint8_t* data, int bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_CODEC_H__ */
@@ -331,6 +331,47 @@ int lws_dev_write_audio(lws_dev_t* dev, const void* data, int samples) {
     return dev->ops->write_audio(dev, data, samples);
 }
 
+int lws_dev_audio_packet_supported(lws_dev_t* dev, lws_audio_format_t format) {
+    if (!dev || !dev->ops || !dev->ops->write_audio_packet) {
+        return 0;
+    }
+
+    return dev->config.audio.format == format;
+}
+
+int lws_dev_write_audio_packet(lws_dev_t* dev, const void* data, int bytes,
+                               int64_t pts, int samples) {
+    if (!dev || !data || bytes <= 0 || pts < 0 || samples <= 0) {
+        return -1;
+    }
+
+    if (dev->state != LWS_DEV_STATE_STARTED) {
+        return -1;
+    }
+
+    if (!dev->ops || !dev->ops->write_audio_packet) {
+        return -1;
+    }
+
+    return dev->ops->write_audio_packet(dev, data, bytes, pts, samples);
+}
+
+int lws_dev_next_audio_segment(lws_dev_t* dev, lws_audio_format_t format, int sample_rate) {
+    if (!dev || sample_rate <= 0) {
+        return -1;
+    }
+
+    if (dev->state != LWS_DEV_STATE_STARTED) {
+        return -1;
+    }
+
+    if (!dev->ops || !dev->ops->next_audio_segment) {
+        return -1;
+    }
+
+    return dev->ops->next_audio_segment(dev, format, sample_rate);
+}
+
 int lws_dev_get_audio_avail(lws_dev_t* dev) {
     if (!dev) {
         return -1;
@@ -391,6 +432,18 @@ int lws_dev_write_video(lws_dev_t* dev, const void* data, int size) {
     return dev->ops->write_video(dev, data, size);
 }
 
+int lws_dev_request_keyframe(lws_dev_t* dev) {
+    if (!dev || dev->state != LWS_DEV_STATE_STARTED) {
+        return -1;
+    }
+
+    if (!dev->ops || !dev->ops->request_keyframe) {
+        return -1;
+    }
+
+    return dev->ops->request_keyframe(dev);
+}
+
 /* ========================================
  * 时间戳API实现
  * ======================================== */
@@ -1,10 +1,11 @@
 /**
  * @file lws_dev_file.c
- * @brief lwsip file device backend implementation (MP4 via libmov)
+ * @brief lwsip file device backend implementation (MP4 via libmov, WAV)
  */
 
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <assert.h>
 
@@ -12,6 +13,7 @@
 #include "lws_err.h"
 #include "lws_log.h"
 #include "lws_dev_intl.h"
+#include "lws_h264.h"
 
 /* libmov headers */
 #include "mov-buffer.h"
@@ -31,6 +33,11 @@ typedef struct {
     FILE* fp;
     int is_writing;  /* 0=reading, 1=writing */
 
+    /* WAV writer（文件名以.wav结尾时代替MP4，仅音频） */
+    int wav;
+    uint32_t wav_bytes;             /* data块已写入的字节数 */
+    int segment;                    /* 当前分段序号，0为原文件 */
+
     /* MP4 writer */
     struct mp4_writer_t* writer;
     int audio_track_id;
@@ -55,6 +62,18 @@ typedef struct {
     uint8_t* read_buffer;
     size_t read_buffer_size;
     size_t read_buffer_used;
+
+    /* 视频（H.264）：设备侧为Annex-B，MP4中为AVCC */
+    uint8_t video_object;
+    int video_length_size;          /* AVCC长度字段字节数 */
+    lws_h264_params_t video_params; /* avcC或码流中的SPS/PPS */
+    int video_mode;                 /* 已按视频读取，音频样本不再缓存 */
+    uint8_t* video_buffer;          /* 读取：MP4样本；写入：AVCC转换结果 */
+    uint8_t* video_out;             /* file_read_video的输出缓冲 */
+    int video_out_size;
+    int video_out_len;              /* -1 = 尚未读到视频帧 */
+    int64_t video_last_pts;
+    uint32_t video_frames;
 } lws_dev_file_data_t;
 
 /* ========================================
@@ -133,9 +152,15 @@ static void on_video_track(void* param, uint32_t track, uint8_t object,
                  track, object, width, height);
 
     data->video_track = track;
-
-    (void)extra;
-    (void)bytes;
+    data->video_object = object;
+
+    /* avcC中的SPS/PPS在关键帧前以带内方式输出 */
+    if (object == MOV_OBJECT_H264 &&
+        lws_h264_avcc_read(&data->video_params, (const uint8_t*)extra, (int)bytes,
+                           &data->video_length_size) != 0) {
+        lws_log_warn(0, "[DEV_FILE] Malformed avcC in video track %u\n", track);
+        data->video_length_size = 4;
+    }
 }
 
 static void on_subtitle_track(void* param, uint32_t track, uint8_t object,
@@ -161,6 +186,8 @@ static uint8_t audio_format_to_mov_object(lws_audio_format_t format) {
             return MOV_OBJECT_G711a;
         case LWS_AUDIO_FMT_PCMU:
             return MOV_OBJECT_G711u;
+        case LWS_AUDIO_FMT_OPUS:
+            return MOV_OBJECT_OPUS;
         case LWS_AUDIO_FMT_PCM_S16LE:
         case LWS_AUDIO_FMT_PCM_S16BE:
             /* libmov doesn't directly support PCM16, use G.711 as fallback */
@@ -194,10 +221,187 @@ static int get_audio_frame_size(lws_audio_format_t format, int channels, int sam
     return bytes_per_sample * channels * samples;
 }
 
+/**
+ * @brief 路径是否以.wav结尾（不区分大小写）
+ */
+static int path_is_wav(const char* path) {
+    size_t len = strlen(path);
+    return len > 4 && strcasecmp(path + len - 4, ".wav") == 0;
+}
+
+static void put_le16(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t* p, uint32_t v) {
+    put_le16(p, v);
+    put_le16(p + 2, v >> 16);
+}
+
+/**
+ * @brief 在文件开头写入44字节的WAV头
+ *
+ * 打开时以data_bytes=0占位，关闭时回写实际长度。
+ *
+ * @return 0成功，-1格式不支持或写入失败
+ */
+static int wav_write_header(FILE* fp, const lws_audio_config_t* audio, uint32_t data_bytes) {
+    uint8_t hdr[44];
+    uint32_t tag;
+    uint32_t bits;
+
+    switch (audio->format) {
+        case LWS_AUDIO_FMT_PCM_S16LE:
+            tag = 1;                /* WAVE_FORMAT_PCM */
+            bits = 16;
+            break;
+        case LWS_AUDIO_FMT_PCMA:
+            tag = 6;                /* WAVE_FORMAT_ALAW */
+            bits = 8;
+            break;
+        case LWS_AUDIO_FMT_PCMU:
+            tag = 7;                /* WAVE_FORMAT_MULAW */
+            bits = 8;
+            break;
+        default:
+            lws_log_error(0, "[DEV_FILE] Unsupported WAV format: %d\n", audio->format);
+            return -1;
+    }
+
+    memcpy(hdr, "RIFF", 4);
+    put_le32(hdr + 4, 36 + data_bytes);
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    put_le32(hdr + 16, 16);
+    put_le16(hdr + 20, tag);
+    put_le16(hdr + 22, (uint32_t)audio->channels);
+    put_le32(hdr + 24, (uint32_t)audio->sample_rate);
+    put_le32(hdr + 28, (uint32_t)(audio->sample_rate * audio->channels) * bits / 8);
+    put_le16(hdr + 32, (uint32_t)audio->channels * bits / 8);
+    put_le16(hdr + 34, bits);
+    memcpy(hdr + 36, "data", 4);
+    put_le32(hdr + 40, data_bytes);
+
+    if (fseek(fp, 0, SEEK_SET) != 0 || fwrite(hdr, 1, sizeof(hdr), fp) != sizeof(hdr)) {
+        return -1;
+    }
+    return 0;
+}
+
 /* ========================================
  * 文件后端操作函数实现
  * ======================================== */
 
+/**
+ * @brief 创建写入文件：WAV头或MP4音频轨道（按dev->config.audio）
+ * @return 0成功，-1失败（文件已关闭）
+ */
+static int writer_open(lws_dev_t* dev, lws_dev_file_data_t* data) {
+    data->fp = fopen(data->filepath, "wb");
+    if (!data->fp) {
+        lws_log_error(0, "[DEV_FILE] Failed to open file: %s\n", data->filepath);
+        return -1;
+    }
+
+    lws_log_info("[DEV_FILE] Opened file: %s (mode=wb)\n", data->filepath);
+
+    /* WAV */
+    if (path_is_wav(data->filepath)) {
+        if (wav_write_header(data->fp, &dev->config.audio, 0) != 0) {
+            fclose(data->fp);
+            data->fp = NULL;
+            return -1;
+        }
+        data->wav = 1;
+        data->wav_bytes = 0;
+        lws_log_info("[DEV_FILE] Writing WAV (rate=%d, channels=%d)\n",
+                     dev->config.audio.sample_rate, dev->config.audio.channels);
+        return 0;
+    }
+
+    /* MP4 writer */
+    data->writer = mp4_writer_create(0, &s_file_buffer, data->fp, MOV_FLAG_FASTSTART);
+    if (!data->writer) {
+        lws_log_error(0, "[DEV_FILE] Failed to create MP4 writer\n");
+        fclose(data->fp);
+        data->fp = NULL;
+        return -1;
+    }
+
+    /* 添加音频轨道 */
+    uint8_t object = audio_format_to_mov_object(dev->config.audio.format);
+    if (object == MOV_OBJECT_NONE) {
+        goto fail;
+    }
+
+    /* Opus轨道的dOps由OpusHead生成（RFC 7845 §5.1），pre-skip未知填0 */
+    uint8_t opus_head[19];
+    const void* extra = NULL;
+    int extra_size = 0;
+    if (dev->config.audio.format == LWS_AUDIO_FMT_OPUS) {
+        memcpy(opus_head, "OpusHead", 8);
+        opus_head[8] = 1;
+        opus_head[9] = (uint8_t)dev->config.audio.channels;
+        put_le16(opus_head + 10, 0);
+        put_le32(opus_head + 12, (uint32_t)dev->config.audio.sample_rate);
+        put_le16(opus_head + 16, 0);
+        opus_head[18] = 0;
+        extra = opus_head;
+        extra_size = (int)sizeof(opus_head);
+    }
+
+    int track_id = mp4_writer_add_audio(
+        data->writer,
+        object,
+        dev->config.audio.channels,
+        dev->config.audio.format == LWS_AUDIO_FMT_PCMA ||
+        dev->config.audio.format == LWS_AUDIO_FMT_PCMU ? 8 : 16,
+        dev->config.audio.sample_rate,
+        extra,
+        extra_size
+    );
+
+    if (track_id < 0) {
+        lws_log_error(0, "[DEV_FILE] Failed to add audio track\n");
+        goto fail;
+    }
+
+    data->audio_track_id = track_id;
+    data->video_track_id = -1;  /* 收到第一个关键帧时添加 */
+    lws_log_info("[DEV_FILE] Added audio track %d (object=0x%02x, rate=%d, channels=%d)\n",
+                 track_id, object, dev->config.audio.sample_rate, dev->config.audio.channels);
+    return 0;
+
+fail:
+    mp4_writer_destroy(data->writer);
+    data->writer = NULL;
+    fclose(data->fp);
+    data->fp = NULL;
+    return -1;
+}
+
+/**
+ * @brief 结束写入文件：回写WAV头中的长度，写出MP4索引
+ */
+static void writer_close(lws_dev_t* dev, lws_dev_file_data_t* data) {
+    if (data->wav && data->fp &&
+        wav_write_header(data->fp, &dev->config.audio, data->wav_bytes) != 0) {
+        lws_log_error(0, "[DEV_FILE] Failed to finalize WAV header: %s\n", data->filepath);
+    }
+    data->wav = 0;
+    data->wav_bytes = 0;
+
+    if (data->writer) {
+        mp4_writer_destroy(data->writer);
+        data->writer = NULL;
+    }
+
+    if (data->fp) {
+        fclose(data->fp);
+        data->fp = NULL;
+    }
+}
+
 static int file_open(lws_dev_t* dev) {
     if (!dev) {
         return -1;
@@ -242,61 +446,23 @@ static int file_open(lws_dev_t* dev) {
     /* 确定读写模式 */
     data->is_writing = (dev->type == LWS_DEV_FILE_WRITER) ? 1 : 0;
 
-    /* 打开文件 */
-    const char* mode = data->is_writing ? "wb" : "rb";
-    data->fp = fopen(data->filepath, mode);
-    if (!data->fp) {
-        lws_log_error(0, "[DEV_FILE] Failed to open file: %s\n", data->filepath);
-        free(data);
-        return -1;
-    }
-
-    lws_log_info("[DEV_FILE] Opened file: %s (mode=%s)\n", data->filepath, mode);
-
-    /* 写入模式：创建MP4 writer */
+    /* 写入模式：WAV或MP4 writer */
     if (data->is_writing) {
-        data->writer = mp4_writer_create(0, &s_file_buffer, data->fp, MOV_FLAG_FASTSTART);
-        if (!data->writer) {
-            lws_log_error(0, "[DEV_FILE] Failed to create MP4 writer\n");
-            fclose(data->fp);
-            free(data);
-            return -1;
-        }
-
-        /* 添加音频轨道 */
-        uint8_t object = audio_format_to_mov_object(dev->config.audio.format);
-        if (object == MOV_OBJECT_NONE) {
-            mp4_writer_destroy(data->writer);
-            fclose(data->fp);
+        if (writer_open(dev, data) != 0) {
             free(data);
             return -1;
         }
-
-        int track_id = mp4_writer_add_audio(
-            data->writer,
-            object,
-            dev->config.audio.channels,
-            dev->config.audio.format == LWS_AUDIO_FMT_PCMA ||
-            dev->config.audio.format == LWS_AUDIO_FMT_PCMU ? 8 : 16,
-            dev->config.audio.sample_rate,
-            NULL,  /* extra_data */
-            0      /* extra_data_size */
-        );
-
-        if (track_id < 0) {
-            lws_log_error(0, "[DEV_FILE] Failed to add audio track\n");
-            mp4_writer_destroy(data->writer);
-            fclose(data->fp);
+    }
+    /* 读取模式：创建MP4 reader */
+    else {
+        data->fp = fopen(data->filepath, "rb");
+        if (!data->fp) {
+            lws_log_error(0, "[DEV_FILE] Failed to open file: %s\n", data->filepath);
             free(data);
             return -1;
         }
+        lws_log_info("[DEV_FILE] Opened file: %s (mode=rb)\n", data->filepath);
 
-        data->audio_track_id = track_id;
-        lws_log_info("[DEV_FILE] Added audio track %d (object=0x%02x, rate=%d, channels=%d)\n",
-                     track_id, object, dev->config.audio.sample_rate, dev->config.audio.channels);
-    }
-    /* 读取模式：创建MP4 reader */
-    else {
         data->reader = mov_reader_create(&s_file_buffer, data->fp);
         if (!data->reader) {
             lws_log_error(0, "[DEV_FILE] Failed to create MP4 reader\n");
@@ -350,11 +516,8 @@ static void file_close(lws_dev_t* dev) {
 
     lws_log_info("[DEV_FILE] Closing file: %s\n", data->filepath);
 
-    /* 关闭writer */
-    if (data->writer) {
-        mp4_writer_destroy(data->writer);
-        data->writer = NULL;
-    }
+    /* 关闭writer（回写WAV头） */
+    writer_close(dev, data);
 
     /* 关闭reader */
     if (data->reader) {
@@ -373,6 +536,10 @@ static void file_close(lws_dev_t* dev) {
         free(data->read_buffer);
         data->read_buffer = NULL;
     }
+    if (data->video_buffer) {
+        free(data->video_buffer);
+        data->video_buffer = NULL;
+    }
 
     free(data);
     dev->platform_data = NULL;
@@ -403,8 +570,52 @@ static void file_stop(lws_dev_t* dev) {
 
     lws_dev_file_data_t* data = (lws_dev_file_data_t*)dev->platform_data;
 
-    lws_log_info("[DEV_FILE] Stopped file device: %s (samples_written=%u, samples_read=%u)\n",
-                 data->filepath, data->samples_written, data->samples_read);
+    lws_log_info("[DEV_FILE] Stopped file device: %s (samples_written=%u, samples_read=%u, "
+                 "video_frames=%u)\n",
+                 data->filepath, data->samples_written, data->samples_read, data->video_frames);
+}
+
+/**
+ * @brief 视频样本(AVCC)转为Annex-B写入file_read_video的输出缓冲
+ *
+ * MP4样本通常不带参数集，关键帧前插入avcC中的SPS/PPS。
+ */
+static void on_read_video(lws_dev_file_data_t* data, const void* buffer,
+                          size_t bytes, int64_t pts, int flags) {
+    uint8_t* out = data->video_out;
+    int size = data->video_out_size;
+    int len = 0;
+    int n;
+
+    if (!out || data->video_object != MOV_OBJECT_H264) {
+        return;
+    }
+
+    if ((flags & MOV_AV_FLAG_KEYFREAME) &&
+        data->video_params.sps_len > 0 && data->video_params.pps_len > 0) {
+        if (8 + data->video_params.sps_len + data->video_params.pps_len > size) {
+            data->video_out_len = 0;
+            return;
+        }
+        memcpy(out + len, "\0\0\0\1", 4);
+        memcpy(out + len + 4, data->video_params.sps, data->video_params.sps_len);
+        len += 4 + data->video_params.sps_len;
+        memcpy(out + len, "\0\0\0\1", 4);
+        memcpy(out + len + 4, data->video_params.pps, data->video_params.pps_len);
+        len += 4 + data->video_params.pps_len;
+    }
+
+    n = lws_h264_avcc_to_annexb((const uint8_t*)buffer, (int)bytes,
+                                data->video_length_size, out + len, size - len);
+    if (n < 0) {
+        lws_log_warn(0, "[DEV_FILE] Video frame too large or malformed, dropping\n");
+        data->video_out_len = 0;
+        return;
+    }
+
+    data->video_out_len = len + n;
+    data->current_pts_ms = pts;
+    data->video_frames++;
 }
 
 /* MP4 reader回调：存储读取的数据 */
@@ -412,6 +623,14 @@ static void on_read_frame(void* param, uint32_t track, const void* buffer,
                           size_t bytes, int64_t pts, int64_t dts, int flags) {
     lws_dev_file_data_t* data = (lws_dev_file_data_t*)param;
 
+    if (data->video_mode) {
+        /* 视频读取：音频样本丢弃 */
+        if (track == data->video_track) {
+            on_read_video(data, buffer, bytes, pts, flags);
+        }
+        return;
+    }
+
     /* 只处理音频轨道 */
     if (track != data->audio_track) {
         return;
@@ -484,6 +703,45 @@ static int file_read_audio(lws_dev_t* dev, void* buf, int samples) {
     return samples;
 }
 
+/**
+ * @brief 写入一个音频样本（WAV追加数据，MP4按已写入的时长计算PTS）
+ * @return 0成功，-1失败
+ */
+static int file_write_sample(lws_dev_t* dev, lws_dev_file_data_t* data,
+                             const void* buf, int bytes, int samples) {
+    if (data->wav) {
+        if (fwrite(buf, 1, (size_t)bytes, data->fp) != (size_t)bytes) {
+            lws_log_error(0, "[DEV_FILE] Failed to write audio to WAV\n");
+            return -1;
+        }
+        data->wav_bytes += (uint32_t)bytes;
+        data->samples_written += samples;
+        return 0;
+    }
+
+    /* 计算PTS（毫秒） */
+    int64_t pts = (data->samples_written * 1000LL) / dev->config.audio.sample_rate;
+    int64_t dts = pts;
+
+    /* 写入MP4文件 */
+    int ret = mp4_writer_write(data->writer,
+                               data->audio_track_id,
+                               buf,
+                               bytes,
+                               pts,
+                               dts,
+                               MOV_AV_FLAG_KEYFREAME);  /* Audio frames are always keyframes */
+
+    if (ret < 0) {
+        lws_log_error(0, "[DEV_FILE] Failed to write audio frame to MP4\n");
+        return -1;
+    }
+
+    data->samples_written += samples;
+    data->current_pts_ms = pts;
+    return 0;
+}
+
 static int file_write_audio(lws_dev_t* dev, const void* pcm_data, int samples) {
     if (!dev || !dev->platform_data || !pcm_data || samples <= 0) {
         return -1;
@@ -491,7 +749,7 @@ static int file_write_audio(lws_dev_t* dev, const void* pcm_data, int samples) {
 
     lws_dev_file_data_t* data = (lws_dev_file_data_t*)dev->platform_data;
 
-    if (!data->writer) {
+    if (!data->writer && !data->wav) {
         return -1;
     }
 
@@ -503,28 +761,98 @@ static int file_write_audio(lws_dev_t* dev, const void* pcm_data, int samples) {
         return -1;
     }
 
-    /* 计算PTS（毫秒） */
-    int64_t pts = (data->samples_written * 1000LL) / dev->config.audio.sample_rate;
-    int64_t dts = pts;
+    return file_write_sample(dev, data, pcm_data, frame_size, samples) == 0 ? samples : -1;
+}
 
-    /* 写入MP4文件 */
-    int ret = mp4_writer_write(data->writer,
-                               data->audio_track_id,
-                               pcm_data,
-                               frame_size,
-                               pts,
-                               dts,
-                               MOV_AV_FLAG_KEYFREAME);  /* Audio frames are always keyframes */
+/**
+ * @brief 直通录音：写入编码后的包，补齐与上一包之间的空隙
+ */
+static int file_write_audio_packet(lws_dev_t* dev, const void* packet, int bytes,
+                                   int64_t pts, int samples) {
+    if (!dev || !dev->platform_data) {
+        return -1;
+    }
 
-    if (ret < 0) {
-        lws_log_error(0, "[DEV_FILE] Failed to write audio frame to MP4\n");
+    lws_dev_file_data_t* data = (lws_dev_file_data_t*)dev->platform_data;
+    lws_audio_format_t format = dev->config.audio.format;
+
+    if (!data->writer && !data->wav) {
         return -1;
     }
 
-    data->samples_written += samples;
-    data->current_pts_ms = pts;
+    /* 重复或过晚的包 */
+    if (pts < (int64_t)data->samples_written) {
+        return 0;
+    }
 
-    return samples;
+    if (pts > (int64_t)data->samples_written) {
+        if (format == LWS_AUDIO_FMT_PCMU || format == LWS_AUDIO_FMT_PCMA) {
+            /* G.711每字节一个采样：按20ms写入静音 */
+            uint8_t silence[160];
+            int channels = dev->config.audio.channels > 0 ? dev->config.audio.channels : 1;
+            memset(silence, format == LWS_AUDIO_FMT_PCMU ? 0xff : 0xd5, sizeof(silence));
+            while (pts > (int64_t)data->samples_written) {
+                int n = (int)LWS_MIN(pts - (int64_t)data->samples_written,
+                                     (int64_t)(sizeof(silence) / channels));
+                if (file_write_sample(dev, data, silence, n * channels, n) != 0) {
+                    return -1;
+                }
+            }
+        } else {
+            /* 其他编码不能拼接静音，在时间戳中留出空隙 */
+            data->samples_written = (uint32_t)pts;
+        }
+    }
+
+    return file_write_sample(dev, data, packet, bytes, samples) == 0 ? samples : -1;
+}
+
+/**
+ * @brief 结束当前文件，按新的音频格式写入下一段（<名称>.<序号><扩展名>）
+ */
+static int file_next_audio_segment(lws_dev_t* dev, lws_audio_format_t format, int sample_rate) {
+    if (!dev || !dev->platform_data) {
+        return -1;
+    }
+
+    lws_dev_file_data_t* data = (lws_dev_file_data_t*)dev->platform_data;
+    const char* base = dev->device_name;
+    const char* name;
+    const char* ext;
+    char path[sizeof(data->filepath)];
+    int n;
+
+    if (!data->is_writing) {
+        return -1;
+    }
+
+    /* 序号插在扩展名之前，保持.wav/.mp4的写入方式不变 */
+    name = strrchr(base, '/');
+    ext = strrchr(name ? name : base, '.');
+    if (!ext) {
+        ext = base + strlen(base);
+    }
+    n = snprintf(path, sizeof(path), "%.*s.%d%s", (int)(ext - base), base, data->segment + 1, ext);
+    if (n < 0 || n >= (int)sizeof(path)) {
+        return -1;
+    }
+
+    writer_close(dev, data);
+    dev->config.audio.format = format;
+    dev->config.audio.sample_rate = sample_rate;
+    data->segment++;
+    memcpy(data->filepath, path, (size_t)n + 1);
+    data->samples_written = 0;
+    data->current_pts_ms = 0;
+
+    if (writer_open(dev, data) != 0) {
+        lws_log_error(0, "[DEV_FILE] Failed to start segment %d: %s\n", data->segment, path);
+        return -1;
+    }
+
+    lws_log_info("[DEV_FILE] Started segment %d: %s (format=%d, rate=%d)\n",
+                 data->segment, path, format, sample_rate);
+    return 0;
 }
 
 static int file_get_audio_avail(lws_dev_t* dev) {
@@ -546,20 +874,129 @@ static int file_flush_audio(lws_dev_t* dev) {
     return 0;
 }
 
+/**
+ * @brief 读取一帧H.264（Annex-B，关键帧带SPS/PPS）
+ * @return 帧字节数，0表示文件结束，-1失败
+ */
 static int file_read_video(lws_dev_t* dev, void* buf, int size) {
-    /* TODO: 视频读取支持 */
-    (void)dev;
-    (void)buf;
-    (void)size;
-    return -1;
+    if (!dev || !dev->platform_data || !buf || size <= 0) {
+        return -1;
+    }
+
+    lws_dev_file_data_t* data = (lws_dev_file_data_t*)dev->platform_data;
+
+    if (!data->reader || data->video_object != MOV_OBJECT_H264) {
+        return -1;
+    }
+
+    /* MP4样本缓冲，设备打开期间复用 */
+    if (!data->video_buffer) {
+        data->video_buffer = (uint8_t*)malloc(LWS_MAX_VIDEO_FRAME_SIZE);
+        if (!data->video_buffer) {
+            lws_log_error(0, "[DEV_FILE] Failed to allocate video buffer\n");
+            return -1;
+        }
+    }
+    data->video_mode = 1;
+    data->video_out = (uint8_t*)buf;
+    data->video_out_size = size;
+    data->video_out_len = -1;
+
+    /* 跳过音频样本，直到读到一帧视频 */
+    while (data->video_out_len < 0) {
+        int ret = mov_reader_read(data->reader, data->video_buffer,
+                                  LWS_MAX_VIDEO_FRAME_SIZE, on_read_frame, data);
+        if (ret == 0) {
+            lws_log_info("[DEV_FILE] Reached end of file\n");
+            data->video_out = NULL;
+            return 0;
+        } else if (ret < 0) {
+            lws_log_error(0, "[DEV_FILE] Failed to read from MP4 file\n");
+            data->video_out = NULL;
+            return -1;
+        }
+    }
+
+    data->video_out = NULL;
+    return data->video_out_len;
 }
 
-static int file_write_video(lws_dev_t* dev, const void* data, int size) {
-    /* TODO: 视频写入支持 */
-    (void)dev;
-    (void)data;
-    (void)size;
-    return -1;
+/**
+ * @brief 写入一帧H.264（Annex-B）
+ *
+ * 视频轨道在第一个带SPS/PPS的关键帧到达时添加（avcC和画面尺寸取自SPS），
+ * 之前的帧丢弃。PTS取设备打开以来的时间，与音频轨道对齐。
+ *
+ * @return 写入的字节数，0表示帧被丢弃，-1失败
+ */
+static int file_write_video(lws_dev_t* dev, const void* frame, int size) {
+    if (!dev || !dev->platform_data || !frame || size <= 0) {
+        return -1;
+    }
+
+    lws_dev_file_data_t* data = (lws_dev_file_data_t*)dev->platform_data;
+
+    if (!data->writer) {
+        return -1;
+    }
+
+    int flags = lws_h264_scan(&data->video_params, (const uint8_t*)frame, size);
+
+    if (data->video_track_id < 0) {
+        uint8_t avcc[2 * LWS_H264_MAX_PARAM + 16];
+        int width, height;
+        int avcc_len;
+
+        if (!(flags & LWS_H264_HAS_IDR) ||
+            lws_h264_sps_size(&data->video_params, &width, &height) != 0 ||
+            (avcc_len = lws_h264_avcc_write(&data->video_params, avcc, sizeof(avcc))) < 0) {
+            return 0;
+        }
+
+        data->video_buffer = (uint8_t*)malloc(LWS_MAX_VIDEO_FRAME_SIZE);
+        if (!data->video_buffer) {
+            lws_log_error(0, "[DEV_FILE] Failed to allocate video buffer\n");
+            return -1;
+        }
+
+        data->video_track_id = mp4_writer_add_video(data->writer, MOV_OBJECT_H264,
+                                                    width, height, avcc, avcc_len);
+        if (data->video_track_id < 0) {
+            lws_log_error(0, "[DEV_FILE] Failed to add video track\n");
+            free(data->video_buffer);
+            data->video_buffer = NULL;
+            return -1;
+        }
+        data->video_last_pts = -1;
+        lws_log_info("[DEV_FILE] Added video track %d (H.264 %dx%d)\n",
+                     data->video_track_id, width, height);
+    }
+
+    int len = lws_h264_annexb_to_avcc((const uint8_t*)frame, size,
+                                      data->video_buffer, LWS_MAX_VIDEO_FRAME_SIZE);
+    if (len <= 0) {
+        lws_log_warn(0, "[DEV_FILE] Video frame too large, dropping\n");
+        return 0;
+    }
+
+    /* PTS单调递增（毫秒） */
+    int64_t pts = (int64_t)(lws_dev_get_timestamp(dev) / 1000);
+    if (pts <= data->video_last_pts) {
+        pts = data->video_last_pts + 1;
+    }
+
+    int ret = mp4_writer_write(data->writer, data->video_track_id,
+                               data->video_buffer, len, pts, pts,
+                               (flags & LWS_H264_HAS_IDR) ? MOV_AV_FLAG_KEYFREAME : 0);
+    if (ret < 0) {
+        lws_log_error(0, "[DEV_FILE] Failed to write video frame to MP4\n");
+        return -1;
+    }
+
+    data->video_last_pts = pts;
+    data->video_frames++;
+
+    return size;
 }
 
 /* ========================================
@@ -573,6 +1010,8 @@ const lws_dev_ops_t lws_dev_file_ops = {
     .stop = file_stop,
     .read_audio = file_read_audio,
     .write_audio = file_write_audio,
+    .write_audio_packet = file_write_audio_packet,
+    .next_audio_segment = file_next_audio_segment,
     .get_audio_avail = file_get_audio_avail,
     .flush_audio = file_flush_audio,
     .read_video = file_read_video,
@@ -589,6 +1028,8 @@ const lws_dev_ops_t lws_dev_file_ops = {
     .stop = NULL,
     .read_audio = NULL,
     .write_audio = NULL,
+    .write_audio_packet = NULL,
+    .next_audio_segment = NULL,
     .get_audio_avail = NULL,
     .flush_audio = NULL,
     .read_video = NULL,
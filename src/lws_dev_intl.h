@@ -28,12 +28,17 @@ typedef struct lws_dev_ops_t {
     /* 音频操作 */
     int (*read_audio)(lws_dev_t* dev, void* buf, int samples);
     int (*write_audio)(lws_dev_t* dev, const void* data, int samples);
+    int (*write_audio_packet)(lws_dev_t* dev, const void* data, int bytes,
+                              int64_t pts, int samples);    /* 可为NULL（不支持直通录音） */
+    int (*next_audio_segment)(lws_dev_t* dev, lws_audio_format_t format,
+                              int sample_rate);             /* 可为NULL（不支持分段） */
     int (*get_audio_avail)(lws_dev_t* dev);
     int (*flush_audio)(lws_dev_t* dev);
 
     /* 视频操作 */
     int (*read_video)(lws_dev_t* dev, void* buf, int size);
     int (*write_video)(lws_dev_t* dev, const void* data, int size);
+    int (*request_keyframe)(lws_dev_t* dev);    /* 可为NULL（不支持） */
 } lws_dev_ops_t;
 
 /* ========================================
@@ -0,0 +1,679 @@
+/**
+ * @file lws_dtls.c
+ * @brief DTLS-SRTP implementation on mbedTLS 4 (SSL/X.509 over PSA Crypto)
+ *
+ * - 自签名证书（ECDSA P-256）进程内缓存，引用计数；握手配置（client/server
+ *   两份mbedtls_ssl_config）随证书一起缓存，创建关联只需mbedtls_ssl_setup
+ * - 证书不经CA验证（VERIFY_OPTIONAL），握手完成后按SDP中的a=fingerprint
+ *   校验对端证书 (RFC 8122 §5)
+ * - 重传定时器由lws_dtls_poll()按截止时间驱动，与会话循环在同一线程
+ * - SRTP密钥由"EXTRACTOR-dtls_srtp"导出 (RFC 5764 §4.2)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <psa/crypto.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/pk.h>
+
+#include "lws_dtls.h"
+#include "lws_mem.h"
+#include "lws_log.h"
+#include "lws_mutex.h"
+
+#if !defined(MBEDTLS_SSL_DTLS_SRTP) || !defined(MBEDTLS_SSL_KEYING_MATERIAL_EXPORT)
+#error "DTLS-SRTP needs MBEDTLS_SSL_DTLS_SRTP and MBEDTLS_SSL_KEYING_MATERIAL_EXPORT in the mbedTLS config"
+#endif
+
+#define CERT_DER_SIZE       1024
+#define MAX_HASH_SIZE       64
+#define SRTP_KEY_SIZE       16          /* AES-128 master key (both DTLS-SRTP profiles) */
+#define SRTP_SALT_SIZE      14
+#define EXPORTER_LABEL      "EXTRACTOR-dtls_srtp"
+
+/* ========================================
+ * Types
+ * ======================================== */
+
+struct lws_dtls_cert_t {
+    int refs;                   /* Guarded by s_cert_mutex */
+    time_t created;
+    mbedtls_x509_crt crt;
+    mbedtls_pk_context pk;
+    mbedtls_ssl_config conf[2]; /* Indexed by lws_dtls_role_t */
+    char fingerprint[LWS_DTLS_FINGERPRINT_SIZE];
+};
+
+struct lws_dtls_t {
+    lws_dtls_cert_t* cert;
+    lws_dtls_role_t role;
+    lws_dtls_state_t state;
+    mbedtls_ssl_context ssl;
+    int started;
+
+    /* Peer fingerprint from SDP */
+    psa_algorithm_t fp_alg;
+    uint8_t fp[MAX_HASH_SIZE];
+    int fp_len;
+
+    /* Transport */
+    lws_dtls_send_f send;
+    void* param;
+    const uint8_t* in;          /* Datagram handed to mbedTLS by recv_cb */
+    int in_len;
+
+    /* Retransmission timer (mbedtls_ssl_set_timer_cb) */
+    uint64_t now_us;
+    uint64_t int_us;            /* Intermediate deadline */
+    uint64_t fin_us;            /* Final deadline, 0 = cancelled */
+
+    /* Exported SRTP keys */
+    lws_srtp_suite_t suite;
+    uint8_t local_master[SRTP_KEY_SIZE + SRTP_SALT_SIZE];
+    uint8_t remote_master[SRTP_KEY_SIZE + SRTP_SALT_SIZE];
+};
+
+/* Profiles offered/accepted, in preference order (mbedTLS has no GCM profiles) */
+static const mbedtls_ssl_srtp_profile s_profiles[] = {
+    MBEDTLS_TLS_SRTP_AES128_CM_HMAC_SHA1_80,
+    MBEDTLS_TLS_SRTP_AES128_CM_HMAC_SHA1_32,
+    MBEDTLS_TLS_SRTP_UNSET
+};
+
+static const struct {
+    const char* name;
+    psa_algorithm_t alg;
+    int len;
+} s_hashes[] = {
+    { "sha-256", PSA_ALG_SHA_256, 32 },
+    { "sha-1",   PSA_ALG_SHA_1,   20 },
+    { "sha-384", PSA_ALG_SHA_384, 48 },
+    { "sha-512", PSA_ALG_SHA_512, 64 },
+    { "sha-224", PSA_ALG_SHA_224, 28 },
+};
+
+static lws_mutex_t s_cert_mutex = PTHREAD_MUTEX_INITIALIZER;
+static lws_dtls_cert_t* s_cert;     /* Cached certificate, holds one reference */
+
+/* ========================================
+ * Helpers
+ * ======================================== */
+
+static int lower(int c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static int hex_value(int c)
+{
+    c = lower(c);
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ * @brief Split "<hash> <AB:CD:...>" into the PSA hash and the raw digest
+ * @return Digest length, -1 if malformed or the hash is not supported
+ */
+static int parse_fingerprint(const char* text, int len, psa_algorithm_t* alg, uint8_t* out)
+{
+    const char* end = text + len;
+    const char* sp = memchr(text, ' ', len);
+    size_t i;
+    int n = 0;
+    int want = -1;
+
+    if (!sp) {
+        return -1;
+    }
+    for (i = 0; i < sizeof(s_hashes) / sizeof(s_hashes[0]); i++) {
+        const char* name = s_hashes[i].name;
+        int k = 0;
+        while (text + k < sp && name[k] && lower(text[k]) == name[k]) {
+            k++;
+        }
+        if (text + k == sp && name[k] == '\0') {
+            *alg = s_hashes[i].alg;
+            want = s_hashes[i].len;
+            break;
+        }
+    }
+    if (want < 0) {
+        return -1;
+    }
+
+    while (end > sp && (end[-1] == ' ' || end[-1] == '\r' || end[-1] == '\n')) {
+        end--;
+    }
+    for (text = sp + 1; text < end && *text == ' '; text++) {
+    }
+    while (text + 2 <= end && n < want) {
+        int hi = hex_value(text[0]);
+        int lo = hex_value(text[1]);
+        if (hi < 0 || lo < 0) {
+            return -1;
+        }
+        out[n++] = (uint8_t)(hi << 4 | lo);
+        text += 2;
+        if (text < end && *text == ':') {
+            text++;
+        }
+    }
+    return (n == want && text == end) ? n : -1;
+}
+
+static void format_fingerprint(const uint8_t* digest, int len, char* buf)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char* p = buf + sprintf(buf, "sha-256 ");
+    int i;
+
+    for (i = 0; i < len; i++) {
+        *p++ = hex[digest[i] >> 4];
+        *p++ = hex[digest[i] & 0x0f];
+        *p++ = (i + 1 < len) ? ':' : '\0';
+    }
+}
+
+/* ========================================
+ * Certificate
+ * ======================================== */
+
+static void cert_free(lws_dtls_cert_t* cert)
+{
+    mbedtls_ssl_config_free(&cert->conf[LWS_DTLS_CLIENT]);
+    mbedtls_ssl_config_free(&cert->conf[LWS_DTLS_SERVER]);
+    mbedtls_x509_crt_free(&cert->crt);
+    mbedtls_pk_free(&cert->pk);
+    lws_free(cert);
+}
+
+/**
+ * @brief Generate an ECDSA P-256 key pair
+ */
+static int cert_gen_key(mbedtls_pk_context* pk)
+{
+    psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+    mbedtls_svc_key_id_t key = MBEDTLS_SVC_KEY_ID_INIT;
+    int ret;
+
+    psa_set_key_type(&attr, PSA_KEY_TYPE_ECC_KEY_PAIR(PSA_ECC_FAMILY_SECP_R1));
+    psa_set_key_bits(&attr, 256);
+    psa_set_key_usage_flags(&attr, PSA_KEY_USAGE_SIGN_HASH | PSA_KEY_USAGE_SIGN_MESSAGE |
+                                   PSA_KEY_USAGE_EXPORT);
+    psa_set_key_algorithm(&attr, PSA_ALG_ECDSA(PSA_ALG_ANY_HASH));
+
+    if (psa_generate_key(&attr, &key) != PSA_SUCCESS) {
+        return -1;
+    }
+    ret = mbedtls_pk_copy_from_psa(key, pk);
+    psa_destroy_key(key);
+    return ret == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Self-signed X.509 v3 certificate, DER written at the end of buf
+ * @return DER length, -1 on failure
+ */
+static int cert_write(mbedtls_pk_context* pk, uint8_t* buf, int size)
+{
+    mbedtls_x509write_cert w;
+    uint8_t serial[8];
+    char not_before[16];
+    char not_after[16];
+    time_t now = time(NULL);
+    time_t later = now + LWS_DTLS_CERT_VALID_SEC;
+    struct tm tm;
+    int ret = -1;
+
+    /* 有效期从一天前开始，容忍对端时钟偏差 */
+    now -= 86400;
+    gmtime_r(&now, &tm);
+    strftime(not_before, sizeof(not_before), "%Y%m%d%H%M%S", &tm);
+    gmtime_r(&later, &tm);
+    strftime(not_after, sizeof(not_after), "%Y%m%d%H%M%S", &tm);
+
+    if (psa_generate_random(serial, sizeof(serial)) != PSA_SUCCESS) {
+        return -1;
+    }
+    serial[0] &= 0x7f;              /* Positive INTEGER */
+    serial[0] |= 0x01;              /* No leading zero byte */
+
+    mbedtls_x509write_crt_init(&w);
+    mbedtls_x509write_crt_set_version(&w, MBEDTLS_X509_CRT_VERSION_3);
+    mbedtls_x509write_crt_set_md_alg(&w, MBEDTLS_MD_SHA256);
+    mbedtls_x509write_crt_set_subject_key(&w, pk);
+    mbedtls_x509write_crt_set_issuer_key(&w, pk);
+
+    if (mbedtls_x509write_crt_set_subject_name(&w, "CN=lwsip") == 0 &&
+        mbedtls_x509write_crt_set_issuer_name(&w, "CN=lwsip") == 0 &&
+        mbedtls_x509write_crt_set_serial_raw(&w, serial, sizeof(serial)) == 0 &&
+        mbedtls_x509write_crt_set_validity(&w, not_before, not_after) == 0) {
+        ret = mbedtls_x509write_crt_der(&w, buf, (size_t)size);
+        if (ret <= 0) {
+            ret = -1;
+        }
+    }
+
+    mbedtls_x509write_crt_free(&w);
+    return ret;
+}
+
+static int cert_conf(lws_dtls_cert_t* cert, mbedtls_ssl_config* conf, int endpoint)
+{
+    if (mbedtls_ssl_config_defaults(conf, endpoint, MBEDTLS_SSL_TRANSPORT_DATAGRAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+        return -1;
+    }
+
+    /* DTLS 1.2 (RFC 5764)；对端证书按fingerprint校验，不要求CA */
+    mbedtls_ssl_conf_max_tls_version(conf, MBEDTLS_SSL_VERSION_TLS1_2);
+    mbedtls_ssl_conf_authmode(conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
+    mbedtls_ssl_conf_handshake_timeout(conf, LWS_DTLS_TIMEOUT_MIN_MS, LWS_DTLS_TIMEOUT_MAX_MS);
+
+    /* ICE连通性检查已验证对端地址，不需要HelloVerifyRequest往返 */
+    if (endpoint == MBEDTLS_SSL_IS_SERVER) {
+        mbedtls_ssl_conf_dtls_cookies(conf, NULL, NULL, NULL);
+    }
+
+    if (mbedtls_ssl_conf_own_cert(conf, &cert->crt, &cert->pk) != 0 ||
+        mbedtls_ssl_conf_dtls_srtp_protection_profiles(conf, s_profiles) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static lws_dtls_cert_t* cert_create(void)
+{
+    lws_dtls_cert_t* cert;
+    uint8_t der[CERT_DER_SIZE];
+    uint8_t digest[32];
+    size_t digest_len = 0;
+    int len;
+
+    if (psa_crypto_init() != PSA_SUCCESS) {
+        return NULL;
+    }
+
+    cert = (lws_dtls_cert_t*)lws_calloc(1, sizeof(lws_dtls_cert_t));
+    if (!cert) {
+        return NULL;
+    }
+    mbedtls_pk_init(&cert->pk);
+    mbedtls_x509_crt_init(&cert->crt);
+    mbedtls_ssl_config_init(&cert->conf[LWS_DTLS_CLIENT]);
+    mbedtls_ssl_config_init(&cert->conf[LWS_DTLS_SERVER]);
+
+    if (cert_gen_key(&cert->pk) != 0 ||
+        (len = cert_write(&cert->pk, der, sizeof(der))) < 0 ||
+        mbedtls_x509_crt_parse_der(&cert->crt, der + sizeof(der) - len, (size_t)len) != 0 ||
+        psa_hash_compute(PSA_ALG_SHA_256, der + sizeof(der) - len, (size_t)len,
+                         digest, sizeof(digest), &digest_len) != PSA_SUCCESS ||
+        cert_conf(cert, &cert->conf[LWS_DTLS_CLIENT], MBEDTLS_SSL_IS_CLIENT) != 0 ||
+        cert_conf(cert, &cert->conf[LWS_DTLS_SERVER], MBEDTLS_SSL_IS_SERVER) != 0) {
+        lws_log_error(0, "[DTLS] Failed to create certificate\n");
+        cert_free(cert);
+        return NULL;
+    }
+
+    format_fingerprint(digest, (int)digest_len, cert->fingerprint);
+    cert->created = time(NULL);
+    cert->refs = 1;
+    lws_log_info("[DTLS] Certificate generated, fingerprint %s", cert->fingerprint);
+    return cert;
+}
+
+/* Caller holds s_cert_mutex */
+static void cert_unref(lws_dtls_cert_t* cert)
+{
+    if (cert && --cert->refs == 0) {
+        cert_free(cert);
+    }
+}
+
+lws_dtls_cert_t* lws_dtls_cert_acquire(void)
+{
+    lws_dtls_cert_t* cert;
+
+    lws_mutex_lock(&s_cert_mutex);
+    if (!s_cert || time(NULL) - s_cert->created >= LWS_DTLS_CERT_REUSE_SEC) {
+        cert = cert_create();
+        if (cert) {
+            cert_unref(s_cert);
+            s_cert = cert;
+        }
+    }
+    cert = s_cert;
+    if (cert) {
+        cert->refs++;
+    }
+    lws_mutex_unlock(&s_cert_mutex);
+
+    return cert;
+}
+
+void lws_dtls_cert_release(lws_dtls_cert_t* cert)
+{
+    lws_mutex_lock(&s_cert_mutex);
+    cert_unref(cert);
+    lws_mutex_unlock(&s_cert_mutex);
+}
+
+const char* lws_dtls_cert_fingerprint(const lws_dtls_cert_t* cert)
+{
+    return cert ? cert->fingerprint : "";
+}
+
+void lws_dtls_cleanup(void)
+{
+    lws_mutex_lock(&s_cert_mutex);
+    cert_unref(s_cert);
+    s_cert = NULL;
+    lws_mutex_unlock(&s_cert_mutex);
+}
+
+int lws_dtls_fingerprint_eq(const char* a, int alen, const char* b, int blen)
+{
+    psa_algorithm_t alg_a = 0;
+    psa_algorithm_t alg_b = 0;
+    uint8_t da[MAX_HASH_SIZE];
+    uint8_t db[MAX_HASH_SIZE];
+    int na;
+
+    if (!a || !b) {
+        return 0;
+    }
+    na = parse_fingerprint(a, alen < 0 ? (int)strlen(a) : alen, &alg_a, da);
+    return na > 0 && parse_fingerprint(b, blen < 0 ? (int)strlen(b) : blen, &alg_b, db) == na &&
+           alg_a == alg_b && memcmp(da, db, na) == 0;
+}
+
+/* ========================================
+ * mbedTLS callbacks
+ * ======================================== */
+
+static int send_cb(void* ctx, const unsigned char* buf, size_t len)
+{
+    lws_dtls_t* dtls = (lws_dtls_t*)ctx;
+
+    /* 发送失败按丢包处理，由重传定时器恢复 */
+    if (dtls->send(dtls->param, buf, (int)len) != 0) {
+        lws_log_debug("[DTLS] Send of %d bytes failed", (int)len);
+    }
+    return (int)len;
+}
+
+static int recv_cb(void* ctx, unsigned char* buf, size_t len)
+{
+    lws_dtls_t* dtls = (lws_dtls_t*)ctx;
+    int n = dtls->in_len;
+
+    if (n == 0) {
+        return MBEDTLS_ERR_SSL_WANT_READ;
+    }
+    dtls->in_len = 0;
+    if ((size_t)n > len) {
+        return MBEDTLS_ERR_SSL_WANT_READ;     /* Oversized datagram, dropped */
+    }
+    memcpy(buf, dtls->in, n);
+    return n;
+}
+
+static void timer_set(void* ctx, uint32_t int_ms, uint32_t fin_ms)
+{
+    lws_dtls_t* dtls = (lws_dtls_t*)ctx;
+
+    dtls->int_us = dtls->now_us + (uint64_t)int_ms * 1000;
+    dtls->fin_us = fin_ms ? dtls->now_us + (uint64_t)fin_ms * 1000 : 0;
+}
+
+static int timer_get(void* ctx)
+{
+    const lws_dtls_t* dtls = (const lws_dtls_t*)ctx;
+
+    if (dtls->fin_us == 0) return -1;
+    if (dtls->now_us >= dtls->fin_us) return 2;
+    if (dtls->now_us >= dtls->int_us) return 1;
+    return 0;
+}
+
+/* ========================================
+ * Handshake
+ * ======================================== */
+
+/**
+ * @brief Check the peer certificate against the SDP fingerprint
+ */
+static int verify_peer(lws_dtls_t* dtls)
+{
+    const mbedtls_x509_crt* peer = mbedtls_ssl_get_peer_cert(&dtls->ssl);
+    uint8_t digest[MAX_HASH_SIZE];
+    size_t len = 0;
+
+    if (!peer) {
+        lws_log_warn(0, "[DTLS] Peer sent no certificate\n");
+        return -1;
+    }
+    if (psa_hash_compute(dtls->fp_alg, peer->raw.p, peer->raw.len,
+                         digest, sizeof(digest), &len) != PSA_SUCCESS ||
+        (int)len != dtls->fp_len || memcmp(digest, dtls->fp, len) != 0) {
+        lws_log_warn(0, "[DTLS] Peer certificate does not match a=fingerprint\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Export client/server SRTP keys (RFC 5764 §4.2)
+ */
+static int export_keys(lws_dtls_t* dtls)
+{
+    mbedtls_dtls_srtp_info info;
+    uint8_t km[2 * (SRTP_KEY_SIZE + SRTP_SALT_SIZE)];
+    const uint8_t* client_key = km;
+    const uint8_t* server_key = km + SRTP_KEY_SIZE;
+    const uint8_t* client_salt = km + 2 * SRTP_KEY_SIZE;
+    const uint8_t* server_salt = client_salt + SRTP_SALT_SIZE;
+    int local_client = dtls->role == LWS_DTLS_CLIENT;
+
+    mbedtls_ssl_get_dtls_srtp_negotiation_result(&dtls->ssl, &info);
+    switch (info.MBEDTLS_PRIVATE(chosen_dtls_srtp_profile)) {
+        case MBEDTLS_TLS_SRTP_AES128_CM_HMAC_SHA1_80:
+            dtls->suite = LWS_SRTP_AES_CM_128_HMAC_SHA1_80;
+            break;
+        case MBEDTLS_TLS_SRTP_AES128_CM_HMAC_SHA1_32:
+            dtls->suite = LWS_SRTP_AES_CM_128_HMAC_SHA1_32;
+            break;
+        default:
+            lws_log_warn(0, "[DTLS] No common SRTP protection profile\n");
+            return -1;
+    }
+
+    if (mbedtls_ssl_export_keying_material(&dtls->ssl, km, sizeof(km),
+                                           EXPORTER_LABEL, sizeof(EXPORTER_LABEL) - 1,
+                                           NULL, 0, 0) != 0) {
+        return -1;
+    }
+
+    memcpy(dtls->local_master, local_client ? client_key : server_key, SRTP_KEY_SIZE);
+    memcpy(dtls->local_master + SRTP_KEY_SIZE, local_client ? client_salt : server_salt,
+           SRTP_SALT_SIZE);
+    memcpy(dtls->remote_master, local_client ? server_key : client_key, SRTP_KEY_SIZE);
+    memcpy(dtls->remote_master + SRTP_KEY_SIZE, local_client ? server_salt : client_salt,
+           SRTP_SALT_SIZE);
+    memset(km, 0, sizeof(km));
+    return 0;
+}
+
+/**
+ * @brief Run mbedTLS until it needs more input
+ */
+static void step(lws_dtls_t* dtls)
+{
+    uint8_t buf[LWS_DTLS_MTU];
+    int ret;
+
+    if (dtls->state == LWS_DTLS_HANDSHAKE) {
+        ret = mbedtls_ssl_handshake(&dtls->ssl);
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return;
+        }
+        if (ret != 0) {
+            lws_log_warn(0, "[DTLS] Handshake failed: -0x%04x\n", (unsigned)-ret);
+            dtls->state = LWS_DTLS_FAILED;
+            return;
+        }
+        if (verify_peer(dtls) != 0 || export_keys(dtls) != 0) {
+            mbedtls_ssl_send_alert_message(&dtls->ssl, MBEDTLS_SSL_ALERT_LEVEL_FATAL,
+                                           MBEDTLS_SSL_ALERT_MSG_BAD_CERT);
+            dtls->state = LWS_DTLS_FAILED;
+            return;
+        }
+        dtls->state = LWS_DTLS_CONNECTED;
+        lws_log_info("[DTLS] Connected as %s, %s", dtls->role == LWS_DTLS_CLIENT ? "client" : "server",
+                     lws_srtp_suite_name(dtls->suite));
+        return;
+    }
+
+    /* 握手后只处理告警和重传的Finished；应用数据忽略 */
+    if (dtls->state == LWS_DTLS_CONNECTED) {
+        do {
+            ret = mbedtls_ssl_read(&dtls->ssl, buf, sizeof(buf));
+        } while (ret > 0);
+        if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+            lws_log_info("[DTLS] Peer closed the association");
+            dtls->state = LWS_DTLS_CLOSED;
+        }
+    }
+}
+
+/* ========================================
+ * Association
+ * ======================================== */
+
+lws_dtls_t* lws_dtls_create(lws_dtls_cert_t* cert, lws_dtls_role_t role,
+                            const char* remote_fp, int len,
+                            lws_dtls_send_f send, void* param)
+{
+    lws_dtls_t* dtls;
+
+    if (!cert || !remote_fp || !send) {
+        return NULL;
+    }
+
+    dtls = (lws_dtls_t*)lws_calloc(1, sizeof(lws_dtls_t));
+    if (!dtls) {
+        return NULL;
+    }
+    dtls->fp_len = parse_fingerprint(remote_fp, len < 0 ? (int)strlen(remote_fp) : len,
+                                     &dtls->fp_alg, dtls->fp);
+    if (dtls->fp_len < 0) {
+        lws_log_warn(0, "[DTLS] Unsupported a=fingerprint\n");
+        lws_free(dtls);
+        return NULL;
+    }
+
+    mbedtls_ssl_init(&dtls->ssl);
+    if (mbedtls_ssl_setup(&dtls->ssl, &cert->conf[role]) != 0) {
+        mbedtls_ssl_free(&dtls->ssl);
+        lws_free(dtls);
+        return NULL;
+    }
+    mbedtls_ssl_set_bio(&dtls->ssl, dtls, send_cb, recv_cb, NULL);
+    mbedtls_ssl_set_timer_cb(&dtls->ssl, dtls, timer_set, timer_get);
+    mbedtls_ssl_set_mtu(&dtls->ssl, LWS_DTLS_MTU);
+    if (role == LWS_DTLS_CLIENT) {
+        mbedtls_ssl_set_hostname(&dtls->ssl, NULL);     /* No name check, fingerprint only */
+    }
+
+    lws_mutex_lock(&s_cert_mutex);
+    cert->refs++;
+    lws_mutex_unlock(&s_cert_mutex);
+
+    dtls->cert = cert;
+    dtls->role = role;
+    dtls->state = LWS_DTLS_HANDSHAKE;
+    dtls->send = send;
+    dtls->param = param;
+    return dtls;
+}
+
+void lws_dtls_destroy(lws_dtls_t* dtls)
+{
+    if (!dtls) {
+        return;
+    }
+    if (dtls->state == LWS_DTLS_CONNECTED) {
+        mbedtls_ssl_close_notify(&dtls->ssl);
+    }
+    mbedtls_ssl_free(&dtls->ssl);
+    lws_dtls_cert_release(dtls->cert);
+    memset(dtls, 0, sizeof(*dtls));
+    lws_free(dtls);
+}
+
+lws_dtls_state_t lws_dtls_input(lws_dtls_t* dtls, const uint8_t* data, int bytes,
+                                uint64_t now_us)
+{
+    if (!dtls || !data || bytes <= 0) {
+        return dtls ? dtls->state : LWS_DTLS_FAILED;
+    }
+
+    dtls->now_us = now_us;
+    dtls->in = data;
+    dtls->in_len = bytes;
+    dtls->started = 1;              /* Server: first ClientHello */
+    step(dtls);
+    dtls->in_len = 0;
+    return dtls->state;
+}
+
+lws_dtls_state_t lws_dtls_poll(lws_dtls_t* dtls, uint64_t now_us)
+{
+    if (!dtls) {
+        return LWS_DTLS_FAILED;
+    }
+
+    dtls->now_us = now_us;
+    if (dtls->state != LWS_DTLS_HANDSHAKE) {
+        return dtls->state;
+    }
+
+    /* 客户端首次调用发出ClientHello；之后只在最终超时到期时重传 */
+    if (!dtls->started) {
+        if (dtls->role == LWS_DTLS_CLIENT) {
+            dtls->started = 1;
+            step(dtls);
+        }
+    } else if (dtls->fin_us != 0 && now_us >= dtls->fin_us) {
+        step(dtls);
+    }
+    return dtls->state;
+}
+
+lws_dtls_state_t lws_dtls_state(const lws_dtls_t* dtls)
+{
+    return dtls ? dtls->state : LWS_DTLS_FAILED;
+}
+
+lws_dtls_role_t lws_dtls_role(const lws_dtls_t* dtls)
+{
+    return dtls ? dtls->role : LWS_DTLS_CLIENT;
+}
+
+int lws_dtls_srtp_keys(const lws_dtls_t* dtls, lws_srtp_suite_t* suite,
+                       uint8_t* local, uint8_t* remote)
+{
+    if (!dtls || dtls->state != LWS_DTLS_CONNECTED) {
+        return -1;
+    }
+    *suite = dtls->suite;
+    memcpy(local, dtls->local_master, sizeof(dtls->local_master));
+    memcpy(remote, dtls->remote_master, sizeof(dtls->remote_master));
+    return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file lws_dtls.h
+ * @brief DTLS-SRTP keying (RFC 5763, RFC 5764) on mbedTLS
+ *
+ * One association per media socket. The session feeds received DTLS
+ * records (demultiplexed from STUN and RTP by the first byte, RFC 7983) to
+ * lws_dtls_input() and calls lws_dtls_poll() from its loop, which drives
+ * the handshake retransmission timer. Records go out through the send
+ * callback, so the association works over a plain socket or ICE alike.
+ *
+ * The self-signed certificate is generated once and shared by every
+ * association until it is LWS_DTLS_CERT_REUSE_SEC old, so a call pays
+ * only for the handshake, not for key generation.
+ */
+
+#ifndef __LWS_DTLS_H__
+#define __LWS_DTLS_H__
+
+#include <stdint.h>
+
+#include "lws_srtp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Constants
+ * ======================================== */
+
+#define LWS_DTLS_FINGERPRINT_SIZE   112     /**< "sha-512 " + 64 hex pairs, NUL */
+#define LWS_DTLS_MTU                1200    /**< Largest record datagram sent */
+#define LWS_DTLS_TIMEOUT_MIN_MS     250     /**< First retransmission timeout */
+#define LWS_DTLS_TIMEOUT_MAX_MS     8000    /**< Handshake fails after this timeout */
+#define LWS_DTLS_CERT_REUSE_SEC     86400   /**< Cached certificate regenerated after a day */
+#define LWS_DTLS_CERT_VALID_SEC     (30 * 86400) /**< Certificate validity period */
+
+/** First byte of a DTLS record (RFC 7983 §7: 20-63) */
+#define LWS_DTLS_IS_RECORD(b)       ((b) >= 20 && (b) <= 63)
+
+typedef enum {
+    LWS_DTLS_CLIENT,                /**< a=setup:active */
+    LWS_DTLS_SERVER                 /**< a=setup:passive */
+} lws_dtls_role_t;
+
+typedef enum {
+    LWS_DTLS_HANDSHAKE,             /**< Handshake in progress */
+    LWS_DTLS_CONNECTED,             /**< SRTP keys available */
+    LWS_DTLS_FAILED,                /**< Handshake failed or fingerprint mismatch */
+    LWS_DTLS_CLOSED                 /**< Peer sent close_notify */
+} lws_dtls_state_t;
+
+/**
+ * @brief Send one DTLS datagram
+ * @return 0 on success, -1 on failure (treated as loss, the timer retransmits)
+ */
+typedef int (*lws_dtls_send_f)(void* param, const uint8_t* data, int bytes);
+
+typedef struct lws_dtls_cert_t lws_dtls_cert_t;
+typedef struct lws_dtls_t lws_dtls_t;
+
+/* ========================================
+ * Certificate
+ * ======================================== */
+
+/**
+ * @brief Get the cached certificate, generating it if missing or expired
+ *
+ * Thread-safe. Each call takes a reference, released by lws_dtls_cert_release().
+ *
+ * @return Certificate, NULL on failure
+ */
+lws_dtls_cert_t* lws_dtls_cert_acquire(void);
+
+/**
+ * @brief Release a reference taken by lws_dtls_cert_acquire()
+ */
+void lws_dtls_cert_release(lws_dtls_cert_t* cert);
+
+/**
+ * @brief a=fingerprint value of a certificate ("sha-256 AB:CD:...")
+ */
+const char* lws_dtls_cert_fingerprint(const lws_dtls_cert_t* cert);
+
+/**
+ * @brief Drop the cached certificate (associations keep their reference)
+ */
+void lws_dtls_cleanup(void);
+
+/* ========================================
+ * Association
+ * ======================================== */
+
+/**
+ * @brief Create an association
+ * @param cert Local certificate (the association takes its own reference)
+ * @param remote_fp Peer's a=fingerprint value ("<hash> <hex>")
+ * @param len remote_fp length (-1 = NUL-terminated)
+ * @return Association, NULL on failure or unsupported fingerprint hash
+ */
+lws_dtls_t* lws_dtls_create(lws_dtls_cert_t* cert, lws_dtls_role_t role,
+                            const char* remote_fp, int len,
+                            lws_dtls_send_f send, void* param);
+
+/**
+ * @brief Destroy an association (sends close_notify once connected)
+ */
+void lws_dtls_destroy(lws_dtls_t* dtls);
+
+/**
+ * @brief Process one received DTLS datagram
+ * @param now_us Current time (microseconds)
+ */
+lws_dtls_state_t lws_dtls_input(lws_dtls_t* dtls, const uint8_t* data, int bytes,
+                                uint64_t now_us);
+
+/**
+ * @brief Start the handshake (client) and retransmit when the timer expires
+ */
+lws_dtls_state_t lws_dtls_poll(lws_dtls_t* dtls, uint64_t now_us);
+
+lws_dtls_state_t lws_dtls_state(const lws_dtls_t* dtls);
+lws_dtls_role_t lws_dtls_role(const lws_dtls_t* dtls);
+
+/**
+ * @brief Negotiated SRTP keys (RFC 5764 §4.2), valid once connected
+ * @param local Our master key + salt (protects what we send)
+ * @param remote Peer's master key + salt
+ * @return 0 on success, -1 if not connected
+ */
+int lws_dtls_srtp_keys(const lws_dtls_t* dtls, lws_srtp_suite_t* suite,
+                       uint8_t* local, uint8_t* remote);
+
+/**
+ * @brief Compare two a=fingerprint values (hash name and hex case-insensitive)
+ * @return 1 if equal
+ */
+int lws_dtls_fingerprint_eq(const char* a, int alen, const char* b, int blen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_DTLS_H__ */
@@ -0,0 +1,337 @@
+/**
+ * @file lws_graph.c
+ * @brief Media processing graph implementation
+ *
+ * 帧的头部与数据一次分配；扇出时同一帧依次交给各下游，只在还有后续
+ * 下游时临时加一个引用，使前面的下游看到的帧不可写，最后一个下游在
+ * 上游未保留时可以原地修改。
+ *
+ * CPU时间：每次投递记录process的耗时，并减去其中嵌套投递给下游的
+ * 时间，得到节点自身的耗时。
+ */
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "lws_graph.h"
+#include "lws_mem.h"
+
+struct lws_graph_node {
+    const lws_node_ops_t* ops;
+    void* ctx;
+    lws_graph_t* graph;
+    lws_graph_node_t* outputs[LWS_GRAPH_MAX_OUTPUTS];
+    int output_count;
+    lws_node_stats_t stats;
+    lws_graph_node_t* next;         /* 图中的节点链表 */
+};
+
+struct lws_graph {
+    lws_graph_node_t* nodes;
+    lws_graph_node_t* tail;
+    uint64_t child_us;              /* 当前投递中下游已用的时间 */
+    int depth;                      /* 当前投递深度 */
+};
+
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+}
+
+/* ========================================
+ * Frames
+ * ======================================== */
+
+lws_frame_t* lws_frame_alloc(int capacity)
+{
+    lws_frame_t* frame;
+
+    if (capacity < 0) {
+        return NULL;
+    }
+
+    frame = (lws_frame_t*)lws_malloc(sizeof(lws_frame_t) + (size_t)capacity);
+    if (!frame) {
+        return NULL;
+    }
+    memset(frame, 0, sizeof(*frame));
+    frame->data = (uint8_t*)(frame + 1);
+    frame->capacity = capacity;
+    frame->refcount = 1;
+    return frame;
+}
+
+lws_frame_t* lws_frame_ref(lws_frame_t* frame)
+{
+    __atomic_add_fetch(&frame->refcount, 1, __ATOMIC_RELAXED);
+    return frame;
+}
+
+void lws_frame_unref(lws_frame_t* frame)
+{
+    if (frame && __atomic_sub_fetch(&frame->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        lws_free(frame);
+    }
+}
+
+int lws_frame_writable(const lws_frame_t* frame)
+{
+    return __atomic_load_n(&frame->refcount, __ATOMIC_ACQUIRE) == 1;
+}
+
+lws_frame_t* lws_frame_copy(const lws_frame_t* frame)
+{
+    lws_frame_t* copy = lws_frame_alloc(frame->capacity);
+
+    if (!copy) {
+        return NULL;
+    }
+    copy->kind = frame->kind;
+    copy->size = frame->size;
+    copy->samples = frame->samples;
+    copy->sample_rate = frame->sample_rate;
+    copy->channels = frame->channels;
+    copy->timestamp = frame->timestamp;
+    copy->time_us = frame->time_us;
+    memcpy(copy->data, frame->data, frame->size);
+    return copy;
+}
+
+/* ========================================
+ * Graph
+ * ======================================== */
+
+lws_graph_t* lws_graph_create(void)
+{
+    return (lws_graph_t*)lws_calloc(1, sizeof(lws_graph_t));
+}
+
+void lws_graph_destroy(lws_graph_t* graph)
+{
+    lws_graph_node_t* node;
+
+    if (!graph) {
+        return;
+    }
+
+    node = graph->nodes;
+    while (node) {
+        lws_graph_node_t* next = node->next;
+        if (node->ops->destroy) {
+            node->ops->destroy(node->ctx);
+        }
+        lws_free(node);
+        node = next;
+    }
+    lws_free(graph);
+}
+
+lws_graph_node_t* lws_graph_add(lws_graph_t* graph, const lws_node_ops_t* ops, void* ctx)
+{
+    lws_graph_node_t* node;
+
+    if (!graph || !ops || (ops->type != LWS_NODE_SOURCE && !ops->process)) {
+        return NULL;
+    }
+
+    node = (lws_graph_node_t*)lws_calloc(1, sizeof(lws_graph_node_t));
+    if (!node) {
+        return NULL;
+    }
+    node->ops = ops;
+    node->ctx = ctx;
+    node->graph = graph;
+
+    if (graph->tail) {
+        graph->tail->next = node;
+    } else {
+        graph->nodes = node;
+    }
+    graph->tail = node;
+    return node;
+}
+
+/* 从from出发能否到达target（连接to→from前检查环） */
+static int graph_reaches(const lws_graph_node_t* from, const lws_graph_node_t* target, int depth)
+{
+    int i;
+
+    if (from == target) {
+        return 1;
+    }
+    if (depth >= LWS_GRAPH_MAX_DEPTH) {
+        return 1;                   /* 过深的链路按环处理 */
+    }
+    for (i = 0; i < from->output_count; i++) {
+        if (graph_reaches(from->outputs[i], target, depth + 1)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int lws_graph_link(lws_graph_node_t* from, lws_graph_node_t* to)
+{
+    int i;
+
+    if (!from || !to || from->graph != to->graph ||
+        from->ops->type == LWS_NODE_SINK || to->ops->type == LWS_NODE_SOURCE ||
+        from->output_count >= LWS_GRAPH_MAX_OUTPUTS || graph_reaches(to, from, 0)) {
+        return -1;
+    }
+    for (i = 0; i < from->output_count; i++) {
+        if (from->outputs[i] == to) {
+            return -1;
+        }
+    }
+
+    from->outputs[from->output_count++] = to;
+    return 0;
+}
+
+int lws_graph_unlink(lws_graph_node_t* from, lws_graph_node_t* to)
+{
+    int i;
+
+    if (!from) {
+        return -1;
+    }
+    for (i = 0; i < from->output_count; i++) {
+        if (from->outputs[i] == to) {
+            memmove(&from->outputs[i], &from->outputs[i + 1],
+                    (size_t)(from->output_count - i - 1) * sizeof(from->outputs[0]));
+            from->output_count--;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+lws_graph_node_t* lws_graph_find(lws_graph_t* graph, const char* name)
+{
+    lws_graph_node_t* node;
+
+    if (!graph || !name) {
+        return NULL;
+    }
+    for (node = graph->nodes; node; node = node->next) {
+        if (node->ops->name && strcmp(node->ops->name, name) == 0) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Run one node on a frame and account its own CPU time
+ */
+static void graph_deliver(lws_graph_t* graph, lws_graph_node_t* node, lws_frame_t* frame)
+{
+    uint64_t saved = graph->child_us;
+    uint64_t start, elapsed, self;
+
+    graph->child_us = 0;
+    graph->depth++;
+    start = now_us();
+    if (node->ops->process(node->ctx, node, frame) != 0) {
+        node->stats.errors++;
+    }
+    elapsed = now_us() - start;
+    graph->depth--;
+
+    /* 减去嵌套投递给下游的时间 */
+    self = elapsed > graph->child_us ? elapsed - graph->child_us : 0;
+    node->stats.frames++;
+    node->stats.total_us += self;
+    if (self > node->stats.max_us) {
+        node->stats.max_us = (uint32_t)self;
+    }
+    graph->child_us = saved + elapsed;
+}
+
+int lws_graph_emit(lws_graph_node_t* node, lws_frame_t* frame)
+{
+    lws_graph_node_t* outputs[LWS_GRAPH_MAX_OUTPUTS];
+    lws_graph_t* graph;
+    int count;
+    int i;
+
+    if (!node || !frame) {
+        return -1;
+    }
+
+    graph = node->graph;
+    if (node->ops->type == LWS_NODE_SOURCE) {
+        node->stats.frames++;
+    }
+    if (graph->depth >= LWS_GRAPH_MAX_DEPTH) {
+        return 0;
+    }
+
+    /* 下游可能在process中断开连接，按进入时的列表投递 */
+    count = node->output_count;
+    memcpy(outputs, node->outputs, (size_t)count * sizeof(outputs[0]));
+
+    for (i = 0; i < count; i++) {
+        if (i + 1 < count) {
+            /* 后面还有下游：保持共享，不允许原地修改 */
+            lws_frame_ref(frame);
+            graph_deliver(graph, outputs[i], frame);
+            lws_frame_unref(frame);
+        } else {
+            graph_deliver(graph, outputs[i], frame);
+        }
+    }
+    return count;
+}
+
+lws_graph_node_t* lws_graph_build(lws_graph_t* graph, lws_graph_node_t* from,
+                                  const lws_node_def_t* defs, int count)
+{
+    lws_graph_node_t* tail = from;
+    lws_graph_node_t* node;
+    int i;
+
+    if (!graph || !from || (count > 0 && !defs)) {
+        return NULL;
+    }
+
+    /* 先串联filter，再把sink接到链路末端 */
+    for (i = 0; i < count; i++) {
+        if (!defs[i].ops || defs[i].ops->type != LWS_NODE_FILTER) {
+            continue;
+        }
+        node = lws_graph_add(graph, defs[i].ops, defs[i].ctx);
+        if (!node || lws_graph_link(tail, node) != 0) {
+            return NULL;
+        }
+        tail = node;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!defs[i].ops || defs[i].ops->type != LWS_NODE_SINK) {
+            continue;
+        }
+        node = lws_graph_add(graph, defs[i].ops, defs[i].ctx);
+        if (!node || lws_graph_link(tail, node) != 0) {
+            return NULL;
+        }
+    }
+    return tail;
+}
+
+const char* lws_graph_node_name(const lws_graph_node_t* node)
+{
+    return node && node->ops->name ? node->ops->name : "";
+}
+
+int lws_graph_node_stats(const lws_graph_node_t* node, lws_node_stats_t* stats)
+{
+    if (!node || !stats) {
+        return -1;
+    }
+    *stats = node->stats;
+    return 0;
+}
@@ -0,0 +1,898 @@
+/**
+ * @file lws_h264.c
+ * @brief H.264 bitstream helpers and RTP payload format implementation
+ *
+ * 打包（RFC 6184 §5.6-5.8，packetization-mode=1）：
+ * - 相邻的小NAL（SPS/PPS/SEI等）合并为STAP-A
+ * - 超过MTU的NAL拆分为FU-A分片
+ * - 其余NAL单独成包；接入单元最后一个包置M位
+ *
+ * 解包：STAP-A展开、FU-A拼接，按Annex-B格式写入预分配的帧缓冲。
+ * 序号不连续时丢弃当前帧，直到下一个IDR才恢复输出。帧缓冲前预留
+ * 参数集空间，IDR缺少带内SPS/PPS时直接前插，无需再拷贝整帧。
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lws_h264.h"
+#include "lws_defs.h"
+#include "lws_mem.h"
+
+/* IDR前插SPS/PPS的预留空间 */
+#define DEPACK_HEADROOM     (2 * (4 + LWS_H264_MAX_PARAM))
+
+#define RTP_HEADER_SIZE     12
+
+typedef struct {
+    const uint8_t* p;
+    int n;
+} nal_t;
+
+/* ========================================
+ * Annex-B / AVCC
+ * ======================================== */
+
+/**
+ * @brief Position after the next 00 00 01 start code at or after pos
+ * @return Offset, -1 if none
+ */
+static int find_start_code(const uint8_t* data, int bytes, int pos)
+{
+    for (; pos + 2 < bytes; pos++) {
+        if (data[pos + 2] > 1) {
+            /* pos..pos+2都不可能是起始码的开头 */
+            pos += 2;
+            continue;
+        }
+        if (data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1) {
+            return pos + 3;
+        }
+    }
+    return -1;
+}
+
+const uint8_t* lws_h264_next_nal(const uint8_t* data, int bytes, int* offset, int* nal_bytes)
+{
+    int start, end;
+
+    while ((start = find_start_code(data, bytes, *offset)) >= 0) {
+        end = find_start_code(data, bytes, start);
+        end = end < 0 ? bytes : end - 3;
+        *offset = end;
+
+        /* 去掉4字节起始码的前导0（trailing_zero_8bits） */
+        while (end > start && data[end - 1] == 0) {
+            end--;
+        }
+        if (end > start) {
+            *nal_bytes = end - start;
+            return data + start;
+        }
+    }
+
+    *offset = bytes;
+    return NULL;
+}
+
+int lws_h264_annexb_to_avcc(const uint8_t* src, int bytes, uint8_t* dst, int size)
+{
+    const uint8_t* nal;
+    int offset = 0;
+    int nal_bytes;
+    int len = 0;
+
+    while ((nal = lws_h264_next_nal(src, bytes, &offset, &nal_bytes)) != NULL) {
+        if (len + 4 + nal_bytes > size) {
+            return -1;
+        }
+        dst[len++] = (uint8_t)(nal_bytes >> 24);
+        dst[len++] = (uint8_t)(nal_bytes >> 16);
+        dst[len++] = (uint8_t)(nal_bytes >> 8);
+        dst[len++] = (uint8_t)nal_bytes;
+        memcpy(dst + len, nal, nal_bytes);
+        len += nal_bytes;
+    }
+
+    return len;
+}
+
+int lws_h264_avcc_to_annexb(const uint8_t* src, int bytes, int length_size,
+                            uint8_t* dst, int size)
+{
+    int pos = 0;
+    int len = 0;
+
+    if (length_size != 1 && length_size != 2 && length_size != 4) {
+        return -1;
+    }
+
+    while (pos + length_size <= bytes) {
+        uint32_t nal_bytes = 0;
+        int i;
+        for (i = 0; i < length_size; i++) {
+            nal_bytes = (nal_bytes << 8) | src[pos++];
+        }
+        if (nal_bytes > (uint32_t)(bytes - pos) || len + 4 + (int)nal_bytes > size) {
+            return -1;
+        }
+        dst[len++] = 0;
+        dst[len++] = 0;
+        dst[len++] = 0;
+        dst[len++] = 1;
+        memcpy(dst + len, src + pos, nal_bytes);
+        len += (int)nal_bytes;
+        pos += (int)nal_bytes;
+    }
+
+    return pos == bytes ? len : -1;
+}
+
+/* ========================================
+ * Parameter sets
+ * ======================================== */
+
+int lws_h264_scan(lws_h264_params_t* params, const uint8_t* data, int bytes)
+{
+    const uint8_t* nal;
+    int offset = 0;
+    int nal_bytes;
+    int has_sps = 0, has_pps = 0, flags = 0;
+
+    while ((nal = lws_h264_next_nal(data, bytes, &offset, &nal_bytes)) != NULL) {
+        switch (nal[0] & 0x1f) {
+        case LWS_H264_NAL_IDR:
+            flags |= LWS_H264_HAS_IDR;
+            break;
+        case LWS_H264_NAL_SPS:
+            has_sps = 1;
+            if (nal_bytes <= LWS_H264_MAX_PARAM) {
+                memcpy(params->sps, nal, nal_bytes);
+                params->sps_len = nal_bytes;
+            }
+            break;
+        case LWS_H264_NAL_PPS:
+            has_pps = 1;
+            if (nal_bytes <= LWS_H264_MAX_PARAM) {
+                memcpy(params->pps, nal, nal_bytes);
+                params->pps_len = nal_bytes;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (has_sps && has_pps) {
+        flags |= LWS_H264_HAS_PARAMS;
+    }
+    return flags;
+}
+
+/* Exp-Golomb位读取（H.264 §9.1） */
+typedef struct {
+    const uint8_t* p;
+    int bits;
+    int pos;
+    int err;
+} bitreader_t;
+
+static uint32_t br_bits(bitreader_t* br, int n)
+{
+    uint32_t v = 0;
+    while (n-- > 0) {
+        if (br->pos >= br->bits) {
+            br->err = 1;
+            return 0;
+        }
+        v = (v << 1) | ((br->p[br->pos >> 3] >> (7 - (br->pos & 7))) & 1);
+        br->pos++;
+    }
+    return v;
+}
+
+static uint32_t br_ue(bitreader_t* br)
+{
+    int zeros = 0;
+    while (br_bits(br, 1) == 0 && !br->err) {
+        if (++zeros > 31) {
+            br->err = 1;
+            return 0;
+        }
+    }
+    return ((1u << zeros) - 1) + br_bits(br, zeros);
+}
+
+static int32_t br_se(bitreader_t* br)
+{
+    uint32_t v = br_ue(br);
+    return (v & 1) ? (int32_t)((v + 1) / 2) : -(int32_t)(v / 2);
+}
+
+static void skip_scaling_list(bitreader_t* br, int count)
+{
+    int last = 8, next = 8;
+    int i;
+    for (i = 0; i < count && !br->err; i++) {
+        if (next != 0) {
+            next = (last + br_se(br) + 256) % 256;
+        }
+        last = next == 0 ? last : next;
+    }
+}
+
+int lws_h264_sps_size(const lws_h264_params_t* params, int* width, int* height)
+{
+    uint8_t rbsp[LWS_H264_MAX_PARAM];
+    bitreader_t br;
+    int n = 0, zeros = 0;
+    int profile, chroma = 1, frame_mbs_only;
+    uint32_t mb_w, mb_h, poc_type;
+    uint32_t crop_l = 0, crop_r = 0, crop_t = 0, crop_b = 0;
+    int crop_x, crop_y;
+    int i;
+
+    if (params->sps_len < 4) {
+        return -1;
+    }
+
+    /* 去掉防竞争字节 00 00 03 */
+    for (i = 1; i < params->sps_len; i++) {
+        if (zeros >= 2 && params->sps[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = params->sps[i] == 0 ? zeros + 1 : 0;
+        rbsp[n++] = params->sps[i];
+    }
+
+    br.p = rbsp;
+    br.bits = n * 8;
+    br.pos = 0;
+    br.err = 0;
+
+    profile = (int)br_bits(&br, 8);
+    br_bits(&br, 16);               /* constraint flags, level_idc */
+    br_ue(&br);                     /* seq_parameter_set_id */
+
+    if (profile == 100 || profile == 110 || profile == 122 || profile == 244 ||
+        profile == 44 || profile == 83 || profile == 86 || profile == 118 ||
+        profile == 128 || profile == 138 || profile == 139 || profile == 134 ||
+        profile == 135) {
+        int separate_planes = 0;
+        chroma = (int)br_ue(&br);
+        if (chroma == 3) {
+            separate_planes = (int)br_bits(&br, 1);
+        }
+        br_ue(&br);                 /* bit_depth_luma_minus8 */
+        br_ue(&br);                 /* bit_depth_chroma_minus8 */
+        br_bits(&br, 1);            /* qpprime_y_zero_transform_bypass_flag */
+        if (br_bits(&br, 1)) {      /* seq_scaling_matrix_present_flag */
+            for (i = 0; i < (chroma != 3 ? 8 : 12); i++) {
+                if (br_bits(&br, 1)) {
+                    skip_scaling_list(&br, i < 6 ? 16 : 64);
+                }
+            }
+        }
+        if (separate_planes) {
+            chroma = 0;             /* 各平面独立编码，裁剪按单色计算 */
+        }
+    }
+
+    br_ue(&br);                     /* log2_max_frame_num_minus4 */
+    poc_type = br_ue(&br);
+    if (poc_type == 0) {
+        br_ue(&br);                 /* log2_max_pic_order_cnt_lsb_minus4 */
+    } else if (poc_type == 1) {
+        uint32_t cycle;
+        br_bits(&br, 1);
+        br_se(&br);
+        br_se(&br);
+        cycle = br_ue(&br);
+        for (i = 0; i < (int)cycle && !br.err; i++) {
+            br_se(&br);
+        }
+    }
+    br_ue(&br);                     /* max_num_ref_frames */
+    br_bits(&br, 1);                /* gaps_in_frame_num_value_allowed_flag */
+    mb_w = br_ue(&br) + 1;
+    mb_h = br_ue(&br) + 1;
+    frame_mbs_only = (int)br_bits(&br, 1);
+    if (!frame_mbs_only) {
+        br_bits(&br, 1);            /* mb_adaptive_frame_field_flag */
+    }
+    br_bits(&br, 1);                /* direct_8x8_inference_flag */
+    if (br_bits(&br, 1)) {          /* frame_cropping_flag */
+        crop_l = br_ue(&br);
+        crop_r = br_ue(&br);
+        crop_t = br_ue(&br);
+        crop_b = br_ue(&br);
+    }
+
+    if (br.err || mb_w > 1024 || mb_h > 1024) {
+        return -1;
+    }
+
+    /* 裁剪单位 (H.264 表6-1, 式7-19~7-22) */
+    crop_x = (chroma == 1 || chroma == 2) ? 2 : 1;
+    crop_y = (chroma == 1 ? 2 : 1) * (2 - frame_mbs_only);
+
+    *width = (int)(mb_w * 16 - crop_x * (crop_l + crop_r));
+    *height = (int)((2 - frame_mbs_only) * mb_h * 16 - crop_y * (crop_t + crop_b));
+    return (*width > 0 && *height > 0) ? 0 : -1;
+}
+
+int lws_h264_avcc_write(const lws_h264_params_t* params, uint8_t* buf, int size)
+{
+    int profile;
+    int len = 0;
+
+    if (params->sps_len < 4 || params->pps_len < 1) {
+        return -1;
+    }
+    profile = params->sps[1];
+    if (11 + params->sps_len + params->pps_len + 4 > size) {
+        return -1;
+    }
+
+    buf[len++] = 1;                 /* configurationVersion */
+    buf[len++] = params->sps[1];    /* AVCProfileIndication */
+    buf[len++] = params->sps[2];    /* profile_compatibility */
+    buf[len++] = params->sps[3];    /* AVCLevelIndication */
+    buf[len++] = 0xff;              /* lengthSizeMinusOne = 3 */
+    buf[len++] = 0xe1;              /* numOfSequenceParameterSets = 1 */
+    buf[len++] = (uint8_t)(params->sps_len >> 8);
+    buf[len++] = (uint8_t)params->sps_len;
+    memcpy(buf + len, params->sps, params->sps_len);
+    len += params->sps_len;
+    buf[len++] = 1;                 /* numOfPictureParameterSets */
+    buf[len++] = (uint8_t)(params->pps_len >> 8);
+    buf[len++] = (uint8_t)params->pps_len;
+    memcpy(buf + len, params->pps, params->pps_len);
+    len += params->pps_len;
+
+    /* High profile扩展字段，按4:2:0、8位填写 */
+    if (profile == 100 || profile == 110 || profile == 122 || profile == 144) {
+        buf[len++] = 0xfd;          /* chroma_format = 1 */
+        buf[len++] = 0xf8;          /* bit_depth_luma_minus8 = 0 */
+        buf[len++] = 0xf8;          /* bit_depth_chroma_minus8 = 0 */
+        buf[len++] = 0;             /* numOfSequenceParameterSetExt */
+    }
+
+    return len;
+}
+
+int lws_h264_avcc_read(lws_h264_params_t* params, const uint8_t* data, int bytes,
+                       int* length_size)
+{
+    int pos = 6;
+    int count, n, i;
+
+    if (bytes < 7 || data[0] != 1) {
+        return -1;
+    }
+    *length_size = (data[4] & 0x03) + 1;
+
+    count = data[5] & 0x1f;
+    for (i = 0; i < count; i++) {
+        if (pos + 2 > bytes || pos + 2 + (n = (data[pos] << 8) | data[pos + 1]) > bytes) {
+            return -1;
+        }
+        if (i == 0 && n <= LWS_H264_MAX_PARAM) {
+            memcpy(params->sps, data + pos + 2, n);
+            params->sps_len = n;
+        }
+        pos += 2 + n;
+    }
+
+    if (pos >= bytes) {
+        return -1;
+    }
+    count = data[pos++];
+    for (i = 0; i < count; i++) {
+        if (pos + 2 > bytes || pos + 2 + (n = (data[pos] << 8) | data[pos + 1]) > bytes) {
+            return -1;
+        }
+        if (i == 0 && n <= LWS_H264_MAX_PARAM) {
+            memcpy(params->pps, data + pos + 2, n);
+            params->pps_len = n;
+        }
+        pos += 2 + n;
+    }
+
+    return (params->sps_len > 0 && params->pps_len > 0) ? 0 : -1;
+}
+
+/* ========================================
+ * sprop-parameter-sets (RFC 6184 §8.1)
+ * ======================================== */
+
+static const char s_base64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int base64_encode(const uint8_t* data, int bytes, char* out, int size)
+{
+    int len = 0;
+    int i;
+
+    if ((bytes + 2) / 3 * 4 >= size) {
+        return -1;
+    }
+    for (i = 0; i < bytes; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < bytes) v |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < bytes) v |= data[i + 2];
+        out[len++] = s_base64[(v >> 18) & 0x3f];
+        out[len++] = s_base64[(v >> 12) & 0x3f];
+        out[len++] = i + 1 < bytes ? s_base64[(v >> 6) & 0x3f] : '=';
+        out[len++] = i + 2 < bytes ? s_base64[v & 0x3f] : '=';
+    }
+    out[len] = '\0';
+    return len;
+}
+
+static int base64_decode(const char* in, int len, uint8_t* out, int size)
+{
+    uint32_t v = 0;
+    int bits = 0;
+    int n = 0;
+    int i;
+
+    for (i = 0; i < len && in[i] != '='; i++) {
+        const char* c = strchr(s_base64, in[i]);
+        if (!c || in[i] == '\0') {
+            return -1;
+        }
+        v = (v << 6) | (uint32_t)(c - s_base64);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n >= size) {
+                return -1;
+            }
+            out[n++] = (uint8_t)(v >> bits);
+        }
+    }
+    return n;
+}
+
+int lws_h264_fmtp_write(const lws_h264_params_t* params, char* fmtp, int size)
+{
+    char out[512];
+    const char* p = fmtp;
+    int len = 0;
+    int n;
+
+    if (params->sps_len < 4 || params->pps_len < 1) {
+        return 0;
+    }
+
+    /* 保留原有参数，替换已有的sprop-parameter-sets */
+    while (*p) {
+        const char* end = strchr(p, ';');
+        int plen = end ? (int)(end - p) : (int)strlen(p);
+        while (plen > 0 && *p == ' ') {
+            p++;
+            plen--;
+        }
+        if (plen > 0 && strncmp(p, "sprop-parameter-sets=", 21) != 0) {
+            if (len + plen + 1 >= (int)sizeof(out)) {
+                return -1;
+            }
+            if (len > 0) {
+                out[len++] = ';';
+            }
+            memcpy(out + len, p, plen);
+            len += plen;
+        }
+        p += plen;
+        if (*p == ';') {
+            p++;
+        }
+    }
+
+    n = snprintf(out + len, sizeof(out) - len, "%ssprop-parameter-sets=", len > 0 ? ";" : "");
+    if (n < 0 || n >= (int)sizeof(out) - len) {
+        return -1;
+    }
+    len += n;
+    n = base64_encode(params->sps, params->sps_len, out + len, (int)sizeof(out) - len);
+    if (n < 0 || len + n + 1 >= (int)sizeof(out)) {
+        return -1;
+    }
+    len += n;
+    out[len++] = ',';
+    n = base64_encode(params->pps, params->pps_len, out + len, (int)sizeof(out) - len);
+    if (n < 0) {
+        return -1;
+    }
+    len += n;
+
+    if (len >= size) {
+        return -1;
+    }
+    memcpy(fmtp, out, len + 1);
+    return 0;
+}
+
+int lws_h264_sprop_read(lws_h264_params_t* params, const char* value, int len)
+{
+    uint8_t nal[LWS_H264_MAX_PARAM];
+    int has_sps = 0, has_pps = 0;
+    int pos = 0;
+
+    while (pos < len) {
+        int end = pos;
+        int n;
+        while (end < len && value[end] != ',') {
+            end++;
+        }
+        n = base64_decode(value + pos, end - pos, nal, sizeof(nal));
+        if (n > 0 && (nal[0] & 0x1f) == LWS_H264_NAL_SPS) {
+            memcpy(params->sps, nal, n);
+            params->sps_len = n;
+            has_sps = 1;
+        } else if (n > 0 && (nal[0] & 0x1f) == LWS_H264_NAL_PPS) {
+            memcpy(params->pps, nal, n);
+            params->pps_len = n;
+            has_pps = 1;
+        }
+        pos = end + 1;
+    }
+
+    return (has_sps && has_pps) ? 0 : -1;
+}
+
+/* ========================================
+ * Packetizer
+ * ======================================== */
+
+void lws_h264_packer_init(lws_h264_packer_t* packer, int pt, int mode, uint32_t ssrc,
+                          uint16_t seq, int mtu, lws_h264_send_f send, void* param)
+{
+    memset(packer, 0, sizeof(*packer));
+    packer->pt = pt;
+    packer->mode = mode;
+    packer->ssrc = ssrc;
+    packer->seq = seq;
+    packer->mtu = (mtu <= RTP_HEADER_SIZE + 3 || mtu > LWS_H264_MAX_MTU) ? LWS_H264_MAX_MTU : mtu;
+    packer->send = send;
+    packer->param = param;
+}
+
+/**
+ * @brief Fill the RTP header and send the packet
+ */
+static int packer_send(lws_h264_packer_t* packer, int payload_bytes,
+                       uint32_t timestamp, int marker)
+{
+    uint8_t* p = packer->packet;
+
+    p[0] = 0x80;
+    p[1] = (uint8_t)((marker ? 0x80 : 0) | (packer->pt & 0x7f));
+    p[2] = (uint8_t)(packer->seq >> 8);
+    p[3] = (uint8_t)packer->seq;
+    p[4] = (uint8_t)(timestamp >> 24);
+    p[5] = (uint8_t)(timestamp >> 16);
+    p[6] = (uint8_t)(timestamp >> 8);
+    p[7] = (uint8_t)timestamp;
+    p[8] = (uint8_t)(packer->ssrc >> 24);
+    p[9] = (uint8_t)(packer->ssrc >> 16);
+    p[10] = (uint8_t)(packer->ssrc >> 8);
+    p[11] = (uint8_t)packer->ssrc;
+    packer->seq++;
+
+    return packer->send(packer->param, p, RTP_HEADER_SIZE + payload_bytes);
+}
+
+int lws_h264_pack(lws_h264_packer_t* packer, const uint8_t* data, int bytes,
+                  uint32_t timestamp)
+{
+    nal_t nals[LWS_H264_MAX_NALS + 2];
+    uint8_t* payload = packer->packet + RTP_HEADER_SIZE;
+    int max = packer->mtu - RTP_HEADER_SIZE;
+    const uint8_t* nal;
+    int offset = 0;
+    int nal_bytes;
+    int count = 0;
+    int packets = 0;
+    int failed = 0;
+    int flags;
+    int i;
+
+    flags = lws_h264_scan(&packer->params, data, bytes);
+
+    /* IDR缺少带内参数集时补发最近一次的SPS/PPS */
+    if ((flags & LWS_H264_HAS_IDR) && !(flags & LWS_H264_HAS_PARAMS) &&
+        packer->params.sps_len > 0 && packer->params.pps_len > 0) {
+        nals[count].p = packer->params.sps;
+        nals[count++].n = packer->params.sps_len;
+        nals[count].p = packer->params.pps;
+        nals[count++].n = packer->params.pps_len;
+    }
+
+    while ((nal = lws_h264_next_nal(data, bytes, &offset, &nal_bytes)) != NULL &&
+           count < (int)(sizeof(nals) / sizeof(nals[0]))) {
+        if ((nal[0] & 0x1f) == LWS_H264_NAL_AUD) {
+            continue;
+        }
+        nals[count].p = nal;
+        nals[count++].n = nal_bytes;
+    }
+
+    for (i = 0; i < count; i++) {
+        const nal_t* cur = &nals[i];
+
+        /* STAP-A：至少两个NAL放得下时合并 */
+        if (packer->mode == 1 && i + 1 < count &&
+            1 + 2 + cur->n + 2 + nals[i + 1].n <= max) {
+            int len = 1;
+            uint8_t hdr = 0;
+            while (i < count && len + 2 + nals[i].n <= max) {
+                uint8_t nri = nals[i].p[0] & 0x60;
+                hdr |= nals[i].p[0] & 0x80;
+                if (nri > (hdr & 0x60)) {
+                    hdr = (uint8_t)((hdr & 0x80) | nri);
+                }
+                payload[len++] = (uint8_t)(nals[i].n >> 8);
+                payload[len++] = (uint8_t)nals[i].n;
+                memcpy(payload + len, nals[i].p, nals[i].n);
+                len += nals[i].n;
+                i++;
+            }
+            i--;
+            payload[0] = (uint8_t)(hdr | LWS_H264_NAL_STAP_A);
+            if (packer_send(packer, len, timestamp, i == count - 1) != 0) {
+                return -1;
+            }
+            packets++;
+            continue;
+        }
+
+        /* Single NAL unit */
+        if (cur->n <= max) {
+            memcpy(payload, cur->p, cur->n);
+            if (packer_send(packer, cur->n, timestamp, i == count - 1) != 0) {
+                return -1;
+            }
+            packets++;
+            continue;
+        }
+
+        if (packer->mode != 1) {
+            /* packetization-mode=0不允许分片 */
+            failed = 1;
+            continue;
+        }
+
+        /* FU-A：NAL头拆为FU indicator + FU header，负载跳过原NAL头 */
+        {
+            const uint8_t* p = cur->p + 1;
+            int remain = cur->n - 1;
+            int first = 1;
+            while (remain > 0) {
+                int chunk = LWS_MIN(remain, max - 2);
+                int last = chunk == remain;
+                payload[0] = (uint8_t)((cur->p[0] & 0xe0) | LWS_H264_NAL_FU_A);
+                payload[1] = (uint8_t)((first ? 0x80 : 0) | (last ? 0x40 : 0) |
+                                       (cur->p[0] & 0x1f));
+                memcpy(payload + 2, p, chunk);
+                if (packer_send(packer, chunk + 2, timestamp, last && i == count - 1) != 0) {
+                    return -1;
+                }
+                packets++;
+                p += chunk;
+                remain -= chunk;
+                first = 0;
+            }
+        }
+    }
+
+    return failed ? -1 : packets;
+}
+
+/* ========================================
+ * Depacketizer
+ * ======================================== */
+
+int lws_h264_depacker_init(lws_h264_depacker_t* depacker, int max_frame,
+                           lws_h264_frame_f on_frame, void* param)
+{
+    memset(depacker, 0, sizeof(*depacker));
+    depacker->buf = (uint8_t*)lws_malloc(DEPACK_HEADROOM + max_frame);
+    if (!depacker->buf) {
+        return -1;
+    }
+    depacker->size = max_frame;
+    depacker->on_frame = on_frame;
+    depacker->param = param;
+    depacker->wait_idr = 1;         /* 从关键帧开始输出 */
+    return 0;
+}
+
+void lws_h264_depacker_free(lws_h264_depacker_t* depacker)
+{
+    if (depacker->buf) {
+        lws_free(depacker->buf);
+        depacker->buf = NULL;
+    }
+}
+
+/**
+ * @brief Append bytes to the frame, optionally preceded by a start code
+ */
+static void depacker_append(lws_h264_depacker_t* d, int start_code,
+                            const uint8_t* data, int bytes)
+{
+    uint8_t* frame = d->buf + DEPACK_HEADROOM;
+
+    if (d->len + (start_code ? 4 : 0) + bytes > d->size) {
+        d->corrupt = 1;
+        return;
+    }
+    if (start_code) {
+        frame[d->len++] = 0;
+        frame[d->len++] = 0;
+        frame[d->len++] = 0;
+        frame[d->len++] = 1;
+    }
+    memcpy(frame + d->len, data, bytes);
+    d->len += bytes;
+}
+
+/**
+ * @brief Deliver the frame in progress (or drop it)
+ */
+static void depacker_emit(lws_h264_depacker_t* d)
+{
+    uint8_t* frame = d->buf + DEPACK_HEADROOM;
+    int len = d->len;
+    int flags;
+
+    d->started = 0;
+
+    if (d->corrupt || d->fu_active || len == 0) {
+        d->dropped++;
+        d->wait_idr = 1;
+        return;
+    }
+
+    flags = lws_h264_scan(&d->params, frame, len);
+    if (d->wait_idr) {
+        if (!(flags & LWS_H264_HAS_IDR)) {
+            d->dropped++;
+            return;
+        }
+        d->wait_idr = 0;
+    }
+
+    /* IDR前插SPS/PPS（来自此前的带内参数集或sprop-parameter-sets） */
+    if ((flags & LWS_H264_HAS_IDR) && !(flags & LWS_H264_HAS_PARAMS) &&
+        d->params.sps_len > 0 && d->params.pps_len > 0) {
+        frame -= 4 + d->params.pps_len;
+        memcpy(frame, "\0\0\0\1", 4);
+        memcpy(frame + 4, d->params.pps, d->params.pps_len);
+        frame -= 4 + d->params.sps_len;
+        memcpy(frame, "\0\0\0\1", 4);
+        memcpy(frame + 4, d->params.sps, d->params.sps_len);
+        len += 8 + d->params.sps_len + d->params.pps_len;
+    }
+
+    d->frames++;
+    d->on_frame(d->param, frame, len, d->timestamp, (flags & LWS_H264_HAS_IDR) != 0);
+}
+
+int lws_h264_depack(lws_h264_depacker_t* d, const uint8_t* packet, int bytes)
+{
+    const uint8_t* payload;
+    uint16_t seq;
+    uint32_t timestamp;
+    int marker;
+    int gap = 0;
+    int offset;
+    int len;
+
+    if (bytes < RTP_HEADER_SIZE || (packet[0] & 0xc0) != 0x80) {
+        return -1;
+    }
+
+    /* 跳过CSRC、扩展头和填充 */
+    offset = RTP_HEADER_SIZE + (packet[0] & 0x0f) * 4;
+    if ((packet[0] & 0x10) && offset + 4 <= bytes) {
+        offset += 4 + ((packet[offset + 2] << 8) | packet[offset + 3]) * 4;
+    }
+    len = bytes - offset;
+    if ((packet[0] & 0x20) && len > 0) {
+        len -= packet[bytes - 1];
+    }
+    if (len < 1) {
+        return -1;
+    }
+    payload = packet + offset;
+
+    marker = (packet[1] & 0x80) != 0;
+    seq = (uint16_t)((packet[2] << 8) | packet[3]);
+    timestamp = ((uint32_t)packet[4] << 24) | ((uint32_t)packet[5] << 16) |
+                ((uint32_t)packet[6] << 8) | packet[7];
+
+    /*
+     * 丢包：无法判断丢的是上一帧的尾部还是本帧的开头，两帧都作废，
+     * 之后等待IDR；迟到/重复的包丢弃
+     */
+    if (d->seq_valid) {
+        int16_t diff = (int16_t)(seq - (uint16_t)(d->seq + 1));
+        if (diff < 0) {
+            return 0;
+        }
+        if (diff > 0) {
+            gap = 1;
+            d->corrupt = 1;
+        }
+    }
+    d->seq = seq;
+    d->seq_valid = 1;
+
+    /* M位丢失时，新的timestamp表示上一帧结束 */
+    if (d->started && timestamp != d->timestamp) {
+        depacker_emit(d);
+    }
+    if (!d->started) {
+        d->started = 1;
+        d->len = 0;
+        d->fu_active = 0;
+        d->corrupt = gap;
+        d->timestamp = timestamp;
+    }
+
+    switch (payload[0] & 0x1f) {
+    case LWS_H264_NAL_STAP_A: {
+        int pos = 1;
+        while (pos + 2 <= len) {
+            int n = (payload[pos] << 8) | payload[pos + 1];
+            pos += 2;
+            if (n == 0 || pos + n > len) {
+                d->corrupt = 1;
+                break;
+            }
+            depacker_append(d, 1, payload + pos, n);
+            pos += n;
+        }
+        break;
+    }
+
+    case LWS_H264_NAL_FU_A:
+        if (len < 2) {
+            d->corrupt = 1;
+            break;
+        }
+        if (payload[1] & 0x80) {
+            uint8_t hdr = (uint8_t)((payload[0] & 0xe0) | (payload[1] & 0x1f));
+            depacker_append(d, 1, &hdr, 1);
+            d->fu_active = 1;
+        } else if (!d->fu_active) {
+            /* 起始分片丢失 */
+            d->corrupt = 1;
+            break;
+        }
+        depacker_append(d, 0, payload + 2, len - 2);
+        if (payload[1] & 0x40) {
+            d->fu_active = 0;
+        }
+        break;
+
+    default:
+        if ((payload[0] & 0x1f) == 0 || (payload[0] & 0x1f) > 23) {
+            /* STAP-B/MTAP/FU-B仅用于interleaved模式，不支持 */
+            d->corrupt = 1;
+            break;
+        }
+        depacker_append(d, 1, payload, len);
+        break;
+    }
+
+    if (marker) {
+        depacker_emit(d);
+    }
+
+    return 0;
+}
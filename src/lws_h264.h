@@ -0,0 +1,237 @@
+/**
+ * @file lws_h264.h
+ * @brief H.264 bitstream helpers and RTP payload format (RFC 6184)
+ *
+ * Access units are exchanged with devices as Annex-B byte streams (start
+ * code before each NAL unit); MP4 files store them as AVCC (4-byte length
+ * before each NAL unit) with the parameter sets in the avcC box.
+ *
+ * The packetizer sends an access unit in non-interleaved mode: NAL units
+ * small enough to share a packet are aggregated into STAP-A, NAL units
+ * larger than the MTU are split into FU-A fragments, everything else goes
+ * as a single NAL unit packet. Packets are built in one buffer owned by the
+ * packetizer, nothing is allocated per frame.
+ *
+ * The depacketizer reassembles access units into one preallocated frame
+ * buffer. After a sequence gap the frame is dropped and output resumes at
+ * the next IDR, so the reassembled stream always decodes.
+ */
+
+#ifndef __LWS_H264_H__
+#define __LWS_H264_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Constants
+ * ======================================== */
+
+/* NAL unit types (H.264 Table 7-1, RFC 6184 §5.2) */
+#define LWS_H264_NAL_SLICE      1
+#define LWS_H264_NAL_IDR        5
+#define LWS_H264_NAL_SEI        6
+#define LWS_H264_NAL_SPS        7
+#define LWS_H264_NAL_PPS        8
+#define LWS_H264_NAL_AUD        9
+#define LWS_H264_NAL_STAP_A     24
+#define LWS_H264_NAL_FU_A       28
+
+#define LWS_H264_MAX_PARAM      128     /**< Largest SPS/PPS kept */
+#define LWS_H264_MAX_NALS       64      /**< NAL units per access unit */
+#define LWS_H264_MAX_MTU        1500    /**< Largest RTP packet built */
+
+/* lws_h264_scan() result flags */
+#define LWS_H264_HAS_IDR        0x01    /**< Access unit contains an IDR slice */
+#define LWS_H264_HAS_PARAMS     0x02    /**< Access unit carries both SPS and PPS */
+
+/**
+ * @brief Sequence and picture parameter sets of a stream
+ */
+typedef struct {
+    uint8_t sps[LWS_H264_MAX_PARAM];
+    int sps_len;                    /**< 0 = not known */
+    uint8_t pps[LWS_H264_MAX_PARAM];
+    int pps_len;                    /**< 0 = not known */
+} lws_h264_params_t;
+
+/* ========================================
+ * Byte stream formats
+ * ======================================== */
+
+/**
+ * @brief Next NAL unit of an Annex-B byte stream
+ * @param data Byte stream
+ * @param bytes Stream length
+ * @param offset In: search position, out: position after the NAL unit
+ * @param nal_bytes Output NAL unit length (without start code)
+ * @return NAL unit, NULL when the stream is exhausted
+ */
+const uint8_t* lws_h264_next_nal(const uint8_t* data, int bytes, int* offset, int* nal_bytes);
+
+/**
+ * @brief Convert an Annex-B access unit to AVCC (4-byte lengths)
+ * @return Output length, -1 if the buffer is too small
+ */
+int lws_h264_annexb_to_avcc(const uint8_t* src, int bytes, uint8_t* dst, int size);
+
+/**
+ * @brief Convert an AVCC access unit to Annex-B
+ * @param length_size NAL length field size (1, 2 or 4, from avcC)
+ * @return Output length, -1 if the buffer is too small or the input is truncated
+ */
+int lws_h264_avcc_to_annexb(const uint8_t* src, int bytes, int length_size,
+                            uint8_t* dst, int size);
+
+/* ========================================
+ * Parameter sets
+ * ======================================== */
+
+/**
+ * @brief Scan an Annex-B access unit, remembering its SPS/PPS
+ * @return LWS_H264_HAS_* flags
+ */
+int lws_h264_scan(lws_h264_params_t* params, const uint8_t* data, int bytes);
+
+/**
+ * @brief Picture size from the SPS (cropping applied)
+ * @return 0 on success, -1 if the SPS is missing or malformed
+ */
+int lws_h264_sps_size(const lws_h264_params_t* params, int* width, int* height);
+
+/**
+ * @brief Build an AVCDecoderConfigurationRecord (avcC, ISO 14496-15 §5.2.4.1)
+ * @return Record length, -1 if parameter sets are missing or the buffer is too small
+ */
+int lws_h264_avcc_write(const lws_h264_params_t* params, uint8_t* buf, int size);
+
+/**
+ * @brief Read the first SPS/PPS of an avcC record
+ * @param length_size Output NAL length field size
+ * @return 0 on success, -1 on malformed record
+ */
+int lws_h264_avcc_read(lws_h264_params_t* params, const uint8_t* data, int bytes,
+                       int* length_size);
+
+/**
+ * @brief Add sprop-parameter-sets to an a=fmtp value
+ *
+ * An existing sprop-parameter-sets is replaced, other parameters are kept.
+ *
+ * @param params Known parameter sets (fmtp is left as is without an SPS and PPS)
+ * @param fmtp Parameter list, updated in place
+ * @param size Buffer size
+ * @return 0 on success, -1 if the buffer is too small (fmtp unchanged)
+ */
+int lws_h264_fmtp_write(const lws_h264_params_t* params, char* fmtp, int size);
+
+/**
+ * @brief Take the parameter sets from a sprop-parameter-sets value
+ * @param value Base64 list ("Z0LgH...,aM4..."), not NUL-terminated
+ * @param len Value length
+ * @return 0 if an SPS and a PPS were found, -1 otherwise
+ */
+int lws_h264_sprop_read(lws_h264_params_t* params, const char* value, int len);
+
+/* ========================================
+ * Packetizer
+ * ======================================== */
+
+/**
+ * @brief Packet ready to send
+ * @return 0 on success
+ */
+typedef int (*lws_h264_send_f)(void* param, const uint8_t* packet, int bytes);
+
+/**
+ * @brief Packetizer state
+ */
+typedef struct {
+    int pt;
+    int mode;                       /**< packetization-mode (0 = single NAL only) */
+    int mtu;
+    uint32_t ssrc;
+    uint16_t seq;
+    lws_h264_params_t params;       /**< Re-sent before IDRs that lack them */
+    lws_h264_send_f send;
+    void* param;
+    uint8_t packet[LWS_H264_MAX_MTU];
+} lws_h264_packer_t;
+
+/**
+ * @brief Initialize a packetizer
+ * @param mtu Largest RTP packet (header included), capped to LWS_H264_MAX_MTU
+ */
+void lws_h264_packer_init(lws_h264_packer_t* packer, int pt, int mode, uint32_t ssrc,
+                          uint16_t seq, int mtu, lws_h264_send_f send, void* param);
+
+/**
+ * @brief Packetize and send one Annex-B access unit
+ *
+ * An IDR without in-band SPS/PPS is preceded by the last ones seen. The
+ * marker bit is set on the last packet. AUD NAL units are not sent.
+ *
+ * @return Packets sent, -1 if a NAL unit could not be sent (too large for
+ *         packetization-mode 0, or the send callback failed)
+ */
+int lws_h264_pack(lws_h264_packer_t* packer, const uint8_t* data, int bytes,
+                  uint32_t timestamp);
+
+/* ========================================
+ * Depacketizer
+ * ======================================== */
+
+/**
+ * @brief Reassembled access unit (Annex-B)
+ */
+typedef void (*lws_h264_frame_f)(void* param, const uint8_t* data, int bytes,
+                                 uint32_t timestamp, int keyframe);
+
+/**
+ * @brief Depacketizer state
+ */
+typedef struct {
+    uint8_t* buf;                   /**< Parameter set headroom + frame */
+    int size;                       /**< Frame capacity */
+    int len;                        /**< Frame bytes (after the headroom) */
+    uint32_t timestamp;
+    int started;                    /**< Frame in progress */
+    int corrupt;                    /**< Packet of the frame lost */
+    int fu_active;                  /**< FU-A fragments being joined */
+    int wait_idr;                   /**< Drop frames until the next IDR */
+    int seq_valid;
+    uint16_t seq;
+    lws_h264_params_t params;       /**< Inserted before IDRs that lack them */
+    lws_h264_frame_f on_frame;
+    void* param;
+    uint64_t frames;                /**< Access units delivered */
+    uint64_t dropped;               /**< Access units dropped (loss, overflow) */
+} lws_h264_depacker_t;
+
+/**
+ * @brief Initialize a depacketizer
+ * @param max_frame Largest access unit
+ * @return 0 on success, -1 on allocation failure
+ */
+int lws_h264_depacker_init(lws_h264_depacker_t* depacker, int max_frame,
+                           lws_h264_frame_f on_frame, void* param);
+
+/**
+ * @brief Release the frame buffer
+ */
+void lws_h264_depacker_free(lws_h264_depacker_t* depacker);
+
+/**
+ * @brief Feed a received RTP packet
+ * @return 0 on success, -1 on malformed packet
+ */
+int lws_h264_depack(lws_h264_depacker_t* depacker, const uint8_t* packet, int bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_H264_H__ */
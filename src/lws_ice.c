@@ -0,0 +1,1380 @@
+/**
+ * @file lws_ice.c
+ * @brief ICE agent (RFC 8445): candidate gathering and connectivity checks
+ *
+ * 媒体socket绑定在通配地址，发往STUN服务器的请求由内核按默认路由选择出口，
+ * 因此每个STUN服务器只发一个事务，server-reflexive候选的基址取第一个host
+ * 候选（调用方先添加默认路由接口）。多个服务器并行查询，先到的响应即产生
+ * 候选，映射地址相同的后续响应作为冗余丢弃 (RFC 8445 §5.1.3)。
+ *
+ * 连通性检查只用host基址配对（srflx/prflx本地候选按RFC 8445 §6.1.2.4
+ * 剪枝到其基址），收到对端检查时的源地址若未知则学习为prflx远端候选，
+ * 配对到第一个host候选（同一通配socket，出口由内核选择）。
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "lws_ice.h"
+#include "lws_stun.h"
+#include "lws_err.h"
+#include "lws_mem.h"
+#include "lws_log.h"
+
+/* ========================================
+ * Types
+ * ======================================== */
+
+typedef enum {
+    TXN_PENDING,                    /* Not sent yet (waiting for a pacing slot) */
+    TXN_SENT,                       /* Awaiting a response */
+    TXN_DONE                        /* Answered, failed or given up */
+} txn_state_t;
+
+/**
+ * @brief One Binding transaction towards a STUN server
+ */
+typedef struct {
+    struct sockaddr_in server;
+    uint8_t tid[LWS_STUN_TID_SIZE];
+    txn_state_t state;
+    int rto_ms;
+    uint64_t retransmit_us;
+} gather_txn_t;
+
+typedef enum {
+    PAIR_FROZEN,
+    PAIR_WAITING,
+    PAIR_IN_PROGRESS,
+    PAIR_SUCCEEDED,
+    PAIR_FAILED
+} pair_state_t;
+
+/**
+ * @brief One candidate pair of the check list
+ */
+typedef struct {
+    int local;                      /* Index into local[] (host base) */
+    int remote;                     /* Index into remote[] */
+    uint64_t priority;
+    pair_state_t state;
+    uint8_t tid[LWS_STUN_TID_SIZE]; /* Current check transaction */
+    int rto_ms;
+    int tx;                         /* Transmissions of the current check */
+    uint64_t retransmit_us;
+    int use_candidate;              /* Controlling: the check carries USE-CANDIDATE */
+    int nominate;                   /* Controlled: the peer sent USE-CANDIDATE on it */
+    int nominated;
+    int triggered;                  /* Queued in the triggered-check FIFO */
+} ice_pair_t;
+
+struct lws_ice_t {
+    lws_ice_config_t config;
+    lws_ice_handler_t handler;
+
+    lws_ice_cand_t local[LWS_ICE_MAX_LOCAL];
+    int local_count;
+    int host_count;
+    int relay_local;                /* Index of the relayed candidate, -1 if none */
+    int relay_done;                 /* Relayed candidate set or failed */
+
+    /* Gathering */
+    gather_txn_t txns[LWS_ICE_MAX_SERVERS];
+    int txn_count;
+    int gathering;                  /* lws_ice_gather() called */
+    int gathering_done;
+    uint64_t gather_deadline_us;
+    uint64_t next_send_us;          /* Next pacing slot (shared with checks) */
+
+    /* Connectivity checks */
+    char local_ufrag[LWS_ICE_CRED_SIZE];
+    char local_pwd[LWS_ICE_CRED_SIZE];
+    char remote_ufrag[LWS_ICE_CRED_SIZE];
+    char remote_pwd[LWS_ICE_CRED_SIZE];
+    int controlling;
+    uint64_t tie_breaker;
+
+    lws_ice_cand_t remote[LWS_ICE_MAX_REMOTE];
+    int remote_count;
+    int remote_done;                /* End of remote candidates */
+
+    ice_pair_t pairs[LWS_ICE_MAX_PAIRS];
+    int pair_count;
+    int triggered[LWS_ICE_MAX_PAIRS];   /* FIFO of pair indices */
+    int triggered_count;
+
+    /* ICE-lite: latched destination of the nominated pair */
+    struct sockaddr_in lite_remote;
+    uint32_t lite_priority;
+
+    lws_ice_state_t state;
+    uint64_t start_us;
+    uint64_t first_valid_us;        /* First pair succeeded (regular nomination) */
+    int nominating;                 /* Regular nomination check queued or in flight */
+    int selected;                   /* Selected pair, -1 if none */
+
+    /* Consent freshness (RFC 7675) */
+    uint8_t consent_tid[LWS_STUN_TID_SIZE];
+    uint64_t consent_next_us;
+    uint64_t consent_expire_us;
+
+    lws_ice_stats_t stats;
+};
+
+/* ========================================
+ * Candidates
+ * ======================================== */
+
+uint32_t lws_ice_priority(int type_pref, int local_pref, int component)
+{
+    return ((uint32_t)type_pref << 24) + ((uint32_t)local_pref << 8) + (uint32_t)(256 - component);
+}
+
+static const char* cand_type_name(lws_ice_cand_type_t type)
+{
+    switch (type) {
+    case LWS_ICE_CAND_HOST:  return "host";
+    case LWS_ICE_CAND_SRFLX: return "srflx";
+    case LWS_ICE_CAND_PRFLX: return "prflx";
+    case LWS_ICE_CAND_RELAY: return "relay";
+    }
+    return "host";
+}
+
+/**
+ * @brief Foundation: same type, base IP and server share one (RFC 8445 §5.1.1.3)
+ */
+static void cand_foundation(lws_ice_cand_t* cand, uint32_t server_ip)
+{
+    uint32_t h = 2166136261u;       /* FNV-1a */
+    uint32_t v[3];
+    const uint8_t* p = (const uint8_t*)v;
+    size_t i;
+
+    v[0] = (uint32_t)cand->type;
+    v[1] = cand->base.sin_addr.s_addr;
+    v[2] = server_ip;
+    for (i = 0; i < sizeof(v); i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    snprintf(cand->foundation, sizeof(cand->foundation), "%u", h % 1000000000u);
+}
+
+int lws_ice_cand_write(const lws_ice_cand_t* cand, char* buf, int size)
+{
+    char ip[INET_ADDRSTRLEN];
+    char rip[INET_ADDRSTRLEN];
+    int n;
+
+    inet_ntop(AF_INET, &cand->addr.sin_addr, ip, sizeof(ip));
+    n = snprintf(buf, size, "candidate:%s %u udp %u %s %u typ %s",
+                 cand->foundation, (unsigned)cand->component, cand->priority, ip,
+                 (unsigned)ntohs(cand->addr.sin_port), cand_type_name(cand->type));
+    if (n >= 0 && n < size && cand->type != LWS_ICE_CAND_HOST) {
+        inet_ntop(AF_INET, &cand->base.sin_addr, rip, sizeof(rip));
+        n += snprintf(buf + n, size - n, " raddr %s rport %u",
+                      rip, (unsigned)ntohs(cand->base.sin_port));
+    }
+    return (n < 0 || n >= size) ? -1 : n;
+}
+
+static int same_addr(const struct sockaddr_in* a, const struct sockaddr_in* b)
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+/**
+ * @brief Add a local candidate unless its address is already known
+ */
+static int add_local(lws_ice_t* ice, const lws_ice_cand_t* cand)
+{
+    int i;
+
+    for (i = 0; i < ice->local_count; i++) {
+        if (ice->local[i].component == cand->component &&
+            same_addr(&ice->local[i].addr, &cand->addr)) {
+            return -1;
+        }
+    }
+    if (ice->local_count >= LWS_ICE_MAX_LOCAL) {
+        return -1;
+    }
+    ice->local[ice->local_count++] = *cand;
+
+    if (ice->handler.on_candidate) {
+        ice->handler.on_candidate(ice->handler.param, cand);
+    }
+    return 0;
+}
+
+/* ========================================
+ * Check list
+ * ======================================== */
+
+/**
+ * @brief Pair priority (RFC 8445 §6.1.2.3), G = controlling side's candidate
+ */
+static uint64_t pair_priority(const lws_ice_t* ice, const ice_pair_t* pair)
+{
+    uint64_t l = ice->local[pair->local].priority;
+    uint64_t r = ice->remote[pair->remote].priority;
+    uint64_t g = ice->controlling ? l : r;
+    uint64_t d = ice->controlling ? r : l;
+
+    return ((g < d ? g : d) << 32) + 2 * (g > d ? g : d) + (g > d ? 1 : 0);
+}
+
+static int same_foundation(const lws_ice_t* ice, const ice_pair_t* a, const ice_pair_t* b)
+{
+    return strcmp(ice->local[a->local].foundation, ice->local[b->local].foundation) == 0 &&
+           strcmp(ice->remote[a->remote].foundation, ice->remote[b->remote].foundation) == 0;
+}
+
+/**
+ * @brief Unfreeze the best frozen pair of every foundation that has no
+ * pair waiting or in progress (RFC 8445 §6.1.2.6, §6.1.4.2)
+ */
+static void pairs_unfreeze(lws_ice_t* ice)
+{
+    for (;;) {
+        int best = -1;
+        int i, j;
+
+        for (i = 0; i < ice->pair_count; i++) {
+            ice_pair_t* p = &ice->pairs[i];
+            int busy = 0;
+
+            if (p->state != PAIR_FROZEN ||
+                (best >= 0 && ice->pairs[best].priority >= p->priority)) {
+                continue;
+            }
+            for (j = 0; j < ice->pair_count && !busy; j++) {
+                busy = (ice->pairs[j].state == PAIR_WAITING ||
+                        ice->pairs[j].state == PAIR_IN_PROGRESS) &&
+                       same_foundation(ice, p, &ice->pairs[j]);
+            }
+            if (!busy) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            return;
+        }
+        ice->pairs[best].state = PAIR_WAITING;
+    }
+}
+
+static void pair_add(lws_ice_t* ice, int local, int remote)
+{
+    ice_pair_t* pair;
+    int i;
+
+    /* 只用host基址和relay配对，srflx/prflx本地候选剪枝 (RFC 8445 §6.1.2.4) */
+    if ((ice->local[local].type != LWS_ICE_CAND_HOST &&
+         ice->local[local].type != LWS_ICE_CAND_RELAY) ||
+        ice->local[local].component != ice->remote[remote].component) {
+        return;
+    }
+    for (i = 0; i < ice->pair_count; i++) {
+        if (ice->pairs[i].local == local && ice->pairs[i].remote == remote) {
+            return;
+        }
+    }
+    if (ice->pair_count >= LWS_ICE_MAX_PAIRS) {
+        lws_log_warn(LWS_ERR_MEDIA_ICE, "[ICE] Check list full, pair dropped\n");
+        return;
+    }
+
+    pair = &ice->pairs[ice->pair_count++];
+    memset(pair, 0, sizeof(*pair));
+    pair->local = local;
+    pair->remote = remote;
+    pair->state = PAIR_FROZEN;
+    pair->priority = pair_priority(ice, pair);
+
+    /* 检查已开始时新配对按冻结规则直接解冻 (RFC 8838 §10) */
+    if (ice->state != LWS_ICE_NEW) {
+        pairs_unfreeze(ice);
+    }
+}
+
+static void pair_trigger(lws_ice_t* ice, int index)
+{
+    ice_pair_t* pair = &ice->pairs[index];
+
+    pair->state = PAIR_WAITING;
+    if (!pair->triggered && ice->triggered_count < LWS_ICE_MAX_PAIRS) {
+        pair->triggered = 1;
+        ice->triggered[ice->triggered_count++] = index;
+    }
+}
+
+static void set_state(lws_ice_t* ice, lws_ice_state_t state)
+{
+    if (ice->state == state) {
+        return;
+    }
+    ice->state = state;
+    if (ice->handler.on_state) {
+        ice->handler.on_state(ice->handler.param, state);
+    }
+}
+
+/**
+ * @brief Select the best nominated valid pair; the first one connects
+ */
+static void update_selected(lws_ice_t* ice, uint64_t now_us)
+{
+    int best = -1;
+    int i;
+
+    for (i = 0; i < ice->pair_count; i++) {
+        const ice_pair_t* p = &ice->pairs[i];
+        if (p->nominated && p->state == PAIR_SUCCEEDED &&
+            (best < 0 || p->priority > ice->pairs[best].priority)) {
+            best = i;
+        }
+    }
+    if (best < 0 || best == ice->selected || ice->state == LWS_ICE_FAILED) {
+        return;
+    }
+
+    ice->selected = best;
+    lws_log_info("[ICE] Selected pair %d (remote %s, %s)\n", best,
+                 cand_type_name(ice->remote[ice->pairs[best].remote].type),
+                 ice->controlling ? "controlling" : "controlled");
+
+    if (ice->state != LWS_ICE_CONNECTED) {
+        ice->stats.connect_ms = (int)((now_us - ice->start_us) / 1000);
+        ice->consent_next_us = now_us + (uint64_t)ice->config.consent_interval_ms * 1000;
+        ice->consent_expire_us = now_us + (uint64_t)ice->config.consent_timeout_ms * 1000;
+        set_state(ice, LWS_ICE_CONNECTED);
+    }
+}
+
+/**
+ * @brief Switch role and recompute pair priorities (role conflict, §7.3.1.1)
+ */
+static void set_role(lws_ice_t* ice, int controlling)
+{
+    int i;
+
+    ice->controlling = controlling ? 1 : 0;
+    for (i = 0; i < ice->pair_count; i++) {
+        ice->pairs[i].priority = pair_priority(ice, &ice->pairs[i]);
+    }
+}
+
+/* ========================================
+ * Agent
+ * ======================================== */
+
+lws_ice_t* lws_ice_create(const lws_ice_config_t* config, const lws_ice_handler_t* handler)
+{
+    uint8_t tid[LWS_STUN_TID_SIZE];
+    lws_ice_t* ice;
+
+    if (!config || !handler || !handler->send ||
+        config->stun_count < 0 || config->stun_count > LWS_ICE_MAX_SERVERS) {
+        return NULL;
+    }
+
+    ice = (lws_ice_t*)lws_malloc(sizeof(*ice));
+    if (!ice) {
+        return NULL;
+    }
+    memset(ice, 0, sizeof(*ice));
+    ice->config = *config;
+    ice->handler = *handler;
+    if (ice->config.ta_ms <= 0) {
+        ice->config.ta_ms = LWS_ICE_TA_MS;
+    }
+    if (ice->config.gather_timeout_ms <= 0) {
+        ice->config.gather_timeout_ms = LWS_ICE_GATHER_TIMEOUT_MS;
+    }
+    if (ice->config.check_timeout_ms <= 0) {
+        ice->config.check_timeout_ms = LWS_ICE_CHECK_TIMEOUT_MS;
+    }
+    if (ice->config.consent_interval_ms <= 0) {
+        ice->config.consent_interval_ms = LWS_ICE_CONSENT_INTERVAL_MS;
+    }
+    if (ice->config.consent_timeout_ms <= 0) {
+        ice->config.consent_timeout_ms = LWS_ICE_CONSENT_TIMEOUT_MS;
+    }
+
+    /* lite agent不收集srflx候选 */
+    if (ice->config.lite) {
+        ice->config.stun_count = 0;
+    }
+
+    /* tie-breaker取随机64位 (RFC 8445 §7.1.1) */
+    if (lws_stun_tid(tid) != 0) {
+        lws_free(ice);
+        return NULL;
+    }
+    memcpy(&ice->tie_breaker, tid, sizeof(ice->tie_breaker));
+
+    ice->state = LWS_ICE_NEW;
+    ice->selected = -1;
+    ice->relay_local = -1;
+    ice->stats.connect_ms = -1;
+    return ice;
+}
+
+void lws_ice_destroy(lws_ice_t* ice)
+{
+    lws_free(ice);
+}
+
+int lws_ice_add_host(lws_ice_t* ice, const struct sockaddr_in* addr)
+{
+    lws_ice_cand_t cand;
+    int i;
+
+    if (!ice || !addr || ice->host_count >= LWS_ICE_MAX_HOSTS) {
+        return -1;
+    }
+
+    memset(&cand, 0, sizeof(cand));
+    cand.type = LWS_ICE_CAND_HOST;
+    cand.component = 1;
+    cand.addr = *addr;
+    cand.base = *addr;
+    /* 多宿主：按添加顺序递减local preference (RFC 8445 §5.1.2.1) */
+    cand.priority = lws_ice_priority(LWS_ICE_PREF_HOST, 65535 - ice->host_count, 1);
+    cand_foundation(&cand, 0);
+
+    if (add_local(ice, &cand) != 0) {
+        return -1;
+    }
+    ice->host_count++;
+
+    for (i = 0; i < ice->remote_count; i++) {
+        pair_add(ice, ice->local_count - 1, i);
+    }
+    return 0;
+}
+
+/**
+ * @brief Finish gathering once (all transactions done or deadline)
+ */
+static void gather_finish(lws_ice_t* ice)
+{
+    int srflx = 0;
+    int i;
+
+    if (ice->gathering_done) {
+        return;
+    }
+    ice->gathering_done = 1;
+
+    for (i = 0; i < ice->local_count; i++) {
+        srflx += ice->local[i].type == LWS_ICE_CAND_SRFLX;
+    }
+    lws_log_info("[ICE] Gathering done: %d candidates (%d host, %d srflx, %d relay)\n",
+                 ice->local_count, ice->host_count, srflx, ice->relay_local >= 0);
+
+    if (ice->handler.on_gathering_done) {
+        ice->handler.on_gathering_done(ice->handler.param);
+    }
+}
+
+int lws_ice_gather(lws_ice_t* ice, uint64_t now_us)
+{
+    int i;
+
+    if (!ice || ice->gathering) {
+        return -1;
+    }
+    ice->gathering = 1;
+    ice->gather_deadline_us = now_us + (uint64_t)ice->config.gather_timeout_ms * 1000;
+    ice->next_send_us = now_us;
+
+    /* 没有host候选时srflx没有基址，跳过 */
+    for (i = 0; ice->host_count > 0 && i < ice->config.stun_count; i++) {
+        gather_txn_t* txn = &ice->txns[ice->txn_count];
+        if (lws_stun_tid(txn->tid) != 0) {
+            continue;
+        }
+        txn->server = ice->config.stun_servers[i];
+        txn->state = TXN_PENDING;
+        txn->rto_ms = LWS_ICE_RTO_MS;
+        ice->txn_count++;
+    }
+
+    if (ice->txn_count == 0 && (!ice->config.relay || ice->relay_done)) {
+        gather_finish(ice);
+    } else {
+        lws_ice_poll(ice, now_us);
+    }
+    return 0;
+}
+
+static int txn_send(lws_ice_t* ice, gather_txn_t* txn)
+{
+    uint8_t msg[LWS_STUN_HEADER_SIZE + 8];
+    int n = lws_stun_init(msg, sizeof(msg), LWS_STUN_BINDING_REQUEST, txn->tid);
+
+    n = lws_stun_add_fingerprint(msg, sizeof(msg), n);
+    if (n < 0) {
+        return -1;
+    }
+    return ice->handler.send(ice->handler.param, &txn->server, msg, n);
+}
+
+/**
+ * @brief Result of a gathering transaction
+ */
+static void gather_response(lws_ice_t* ice, gather_txn_t* txn, const uint8_t* msg, int bytes)
+{
+    lws_ice_cand_t cand;
+    char ip[INET_ADDRSTRLEN];
+
+    txn->state = TXN_DONE;
+
+    if (!LWS_STUN_IS_SUCCESS(lws_stun_type(msg))) {
+        lws_log_warn(LWS_ERR_MEDIA_ICE, "[ICE] STUN server %s:%u error %d\n",
+                     inet_ntop(AF_INET, &txn->server.sin_addr, ip, sizeof(ip)),
+                     (unsigned)ntohs(txn->server.sin_port), lws_stun_error_code(msg, bytes));
+        return;
+    }
+
+    memset(&cand, 0, sizeof(cand));
+    if (lws_stun_mapped_addr(msg, bytes, &cand.addr) != 0) {
+        return;
+    }
+    cand.type = LWS_ICE_CAND_SRFLX;
+    cand.component = 1;
+    cand.base = ice->local[0].addr;
+    cand.priority = lws_ice_priority(LWS_ICE_PREF_SRFLX, 65535, 1);
+    cand_foundation(&cand, txn->server.sin_addr.s_addr);
+
+    /* 与host地址相同（公网主机）或与已有srflx相同时冗余，不上报 */
+    if (add_local(ice, &cand) == 0) {
+        lws_log_info("[ICE] Server-reflexive candidate %s:%u\n",
+                     inet_ntop(AF_INET, &cand.addr.sin_addr, ip, sizeof(ip)),
+                     (unsigned)ntohs(cand.addr.sin_port));
+    }
+}
+
+/* ========================================
+ * Checks
+ * ======================================== */
+
+/**
+ * @brief Send from a local candidate: relayed candidates through TURN
+ */
+static int local_send(lws_ice_t* ice, int local, const struct sockaddr_in* to,
+                      const uint8_t* data, int bytes)
+{
+    if (ice->local[local].type == LWS_ICE_CAND_RELAY) {
+        return ice->handler.relay_send ?
+               ice->handler.relay_send(ice->handler.param, to, data, bytes) : -1;
+    }
+    return ice->handler.send(ice->handler.param, to, data, bytes);
+}
+
+static int is_relay(const lws_ice_t* ice, int local)
+{
+    return ice->local[local].type == LWS_ICE_CAND_RELAY;
+}
+
+/**
+ * @brief Build and send a Binding request on a pair (check or consent)
+ */
+static int check_send(lws_ice_t* ice, const ice_pair_t* pair, const uint8_t* tid, int use_candidate)
+{
+    uint8_t msg[LWS_STUN_MAX_MESSAGE];
+    char username[LWS_ICE_CRED_SIZE * 2];
+    const lws_ice_cand_t* local = &ice->local[pair->local];
+    int n;
+
+    snprintf(username, sizeof(username), "%s:%s", ice->remote_ufrag, ice->local_ufrag);
+
+    n = lws_stun_init(msg, sizeof(msg), LWS_STUN_BINDING_REQUEST, tid);
+    n = lws_stun_add(msg, sizeof(msg), n, LWS_STUN_ATTR_USERNAME, username, (int)strlen(username));
+    /* PRIORITY为对端学到的prflx候选优先级 (RFC 8445 §7.1.1) */
+    n = lws_stun_add_u32(msg, sizeof(msg), n, LWS_STUN_ATTR_PRIORITY,
+                         lws_ice_priority(LWS_ICE_PREF_PRFLX, (local->priority >> 8) & 0xffff,
+                                          local->component));
+    n = lws_stun_add_u64(msg, sizeof(msg), n,
+                         ice->controlling ? LWS_STUN_ATTR_ICE_CONTROLLING : LWS_STUN_ATTR_ICE_CONTROLLED,
+                         ice->tie_breaker);
+    if (use_candidate) {
+        n = lws_stun_add(msg, sizeof(msg), n, LWS_STUN_ATTR_USE_CANDIDATE, NULL, 0);
+    }
+    n = lws_stun_add_integrity(msg, sizeof(msg), n, (const uint8_t*)ice->remote_pwd,
+                               (int)strlen(ice->remote_pwd));
+    n = lws_stun_add_fingerprint(msg, sizeof(msg), n);
+    if (n < 0) {
+        return -1;
+    }
+
+    ice->stats.checks_sent++;
+    return local_send(ice, pair->local, &ice->remote[pair->remote].addr, msg, n);
+}
+
+/**
+ * @brief First transmission of a check (new transaction)
+ */
+static void check_start(lws_ice_t* ice, ice_pair_t* pair, uint64_t now_us)
+{
+    if (lws_stun_tid(pair->tid) != 0) {
+        return;
+    }
+    if (ice->controlling && ice->config.aggressive) {
+        pair->use_candidate = 1;
+    }
+    pair->state = PAIR_IN_PROGRESS;
+    pair->rto_ms = LWS_ICE_RTO_MS;
+    pair->tx = 1;
+    pair->retransmit_us = now_us + (uint64_t)pair->rto_ms * 1000;
+    check_send(ice, pair, pair->tid, pair->use_candidate);
+}
+
+static void pair_fail(lws_ice_t* ice, ice_pair_t* pair)
+{
+    pair->state = PAIR_FAILED;
+    if (pair->use_candidate && !ice->config.aggressive) {
+        pair->use_candidate = 0;
+        ice->nominating = 0;
+    }
+    pairs_unfreeze(ice);
+}
+
+/**
+ * @brief Answer a request: success with XOR-MAPPED-ADDRESS, or an error
+ */
+static void send_response(lws_ice_t* ice, const struct sockaddr_in* from, int relayed,
+                          const uint8_t* req, int code, int integrity)
+{
+    uint8_t msg[LWS_STUN_MAX_MESSAGE];
+    int n;
+
+    if (code == 0) {
+        n = lws_stun_init(msg, sizeof(msg), LWS_STUN_BINDING_SUCCESS, lws_stun_msg_tid(req));
+        n = lws_stun_add_xor_addr(msg, sizeof(msg), n, LWS_STUN_ATTR_XOR_MAPPED_ADDRESS, from);
+    } else {
+        n = lws_stun_init(msg, sizeof(msg), LWS_STUN_BINDING_ERROR, lws_stun_msg_tid(req));
+        n = lws_stun_add_error(msg, sizeof(msg), n, code,
+                               code == 487 ? "Role Conflict" :
+                               code == 401 ? "Unauthenticated" : "Bad Request");
+    }
+    if (integrity) {
+        n = lws_stun_add_integrity(msg, sizeof(msg), n, (const uint8_t*)ice->local_pwd,
+                                   (int)strlen(ice->local_pwd));
+    }
+    n = lws_stun_add_fingerprint(msg, sizeof(msg), n);
+    if (n > 0 && relayed) {
+        local_send(ice, ice->relay_local, from, msg, n);
+    } else if (n > 0) {
+        ice->handler.send(ice->handler.param, from, msg, n);
+    }
+}
+
+static int find_remote(const lws_ice_t* ice, const struct sockaddr_in* addr)
+{
+    int i;
+
+    for (i = 0; i < ice->remote_count; i++) {
+        if (same_addr(&ice->remote[i].addr, addr)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Lite agent: answer and latch the highest-priority nominated source
+ *
+ * 无检查表：每个请求无状态地应答，带USE-CANDIDATE时其源地址即选中对
+ * 的远端；多个提名取PRIORITY最高者 (RFC 8445 §7.3.1.5, §8.2)。
+ */
+static void lite_request(lws_ice_t* ice, const struct sockaddr_in* from, int relayed,
+                         const uint8_t* msg, int bytes, uint32_t priority, uint64_t now_us)
+{
+    send_response(ice, from, relayed, msg, 0, 1);
+
+    if (!lws_stun_find(msg, bytes, LWS_STUN_ATTR_USE_CANDIDATE, NULL) ||
+        ice->state == LWS_ICE_FAILED) {
+        return;
+    }
+    if (ice->selected >= 0 && !same_addr(from, &ice->lite_remote) &&
+        priority <= ice->lite_priority) {
+        return;
+    }
+    if (ice->selected < 0 || !same_addr(from, &ice->lite_remote)) {
+        lws_log_info("[ICE] Lite: nominated pair latched (priority %u)\n", priority);
+    }
+    ice->lite_remote = *from;
+    ice->lite_priority = priority;
+    ice->selected = 0;
+
+    if (ice->state != LWS_ICE_CONNECTED) {
+        ice->stats.connect_ms = ice->start_us ? (int)((now_us - ice->start_us) / 1000) : 0;
+        set_state(ice, LWS_ICE_CONNECTED);
+    }
+}
+
+/**
+ * @brief Binding request from the peer (RFC 8445 §7.3)
+ */
+static void handle_request(lws_ice_t* ice, const struct sockaddr_in* from, int relayed,
+                           const uint8_t* msg, int bytes, uint64_t now_us)
+{
+    const uint8_t* user;
+    size_t ulen = strlen(ice->local_ufrag);
+    uint64_t tie_breaker;
+    uint32_t priority;
+    int vlen = 0;
+    int use_candidate;
+    int remote;
+    int index = -1;
+    int i;
+
+    if (lws_stun_find(msg, bytes, LWS_STUN_ATTR_FINGERPRINT, NULL) &&
+        lws_stun_check_fingerprint(msg, bytes) != 0) {
+        return;
+    }
+    if (ulen == 0) {
+        return;                     /* 本地凭据未设置，无法认证 */
+    }
+
+    user = lws_stun_find(msg, bytes, LWS_STUN_ATTR_USERNAME, &vlen);
+    if (!user || !lws_stun_find(msg, bytes, LWS_STUN_ATTR_MESSAGE_INTEGRITY, NULL) ||
+        lws_stun_get_u32(msg, bytes, LWS_STUN_ATTR_PRIORITY, &priority) != 0) {
+        send_response(ice, from, relayed, msg, 400, 0);
+        return;
+    }
+    /* USERNAME = "本地ufrag:对端ufrag" */
+    if ((size_t)vlen <= ulen || memcmp(user, ice->local_ufrag, ulen) != 0 || user[ulen] != ':' ||
+        lws_stun_check_integrity(msg, bytes, (const uint8_t*)ice->local_pwd,
+                                 (int)strlen(ice->local_pwd)) != 0) {
+        send_response(ice, from, relayed, msg, 401, 0);
+        return;
+    }
+    ice->stats.checks_received++;
+
+    if (ice->config.lite) {
+        lite_request(ice, from, relayed, msg, bytes, priority, now_us);
+        return;
+    }
+
+    /* 角色冲突 (RFC 8445 §7.3.1.1) */
+    if (ice->controlling &&
+        lws_stun_get_u64(msg, bytes, LWS_STUN_ATTR_ICE_CONTROLLING, &tie_breaker) == 0) {
+        if (ice->tie_breaker >= tie_breaker) {
+            send_response(ice, from, relayed, msg, 487, 1);
+            return;
+        }
+        lws_log_info("[ICE] Role conflict, switching to controlled\n");
+        set_role(ice, 0);
+    } else if (!ice->controlling &&
+               lws_stun_get_u64(msg, bytes, LWS_STUN_ATTR_ICE_CONTROLLED, &tie_breaker) == 0) {
+        if (ice->tie_breaker < tie_breaker) {
+            send_response(ice, from, relayed, msg, 487, 1);
+            return;
+        }
+        lws_log_info("[ICE] Role conflict, switching to controlling\n");
+        set_role(ice, 1);
+    }
+
+    send_response(ice, from, relayed, msg, 0, 1);
+
+    /* 未知源地址：学习peer-reflexive远端候选 (RFC 8445 §7.3.1.3) */
+    remote = find_remote(ice, from);
+    if (remote < 0) {
+        lws_ice_cand_t cand;
+
+        if (ice->remote_count >= LWS_ICE_MAX_REMOTE || ice->host_count == 0 ||
+            (relayed && ice->relay_local < 0)) {
+            return;
+        }
+        memset(&cand, 0, sizeof(cand));
+        cand.type = LWS_ICE_CAND_PRFLX;
+        cand.component = 1;
+        cand.priority = priority;
+        cand.addr = *from;
+        cand.base = *from;
+        cand_foundation(&cand, 0);
+        remote = ice->remote_count;
+        ice->remote[ice->remote_count++] = cand;
+        pair_add(ice, relayed ? ice->relay_local : 0, remote);
+    }
+
+    /* 经relay收到的请求属于relay配对，否则优先取第一个host基址上的配对 */
+    for (i = 0; i < ice->pair_count; i++) {
+        if (ice->pairs[i].remote == remote && is_relay(ice, ice->pairs[i].local) == relayed &&
+            (index < 0 || ice->pairs[i].local == 0)) {
+            index = i;
+        }
+    }
+    if (index < 0) {
+        return;
+    }
+
+    use_candidate = lws_stun_find(msg, bytes, LWS_STUN_ATTR_USE_CANDIDATE, NULL) != NULL;
+    if (use_candidate && !ice->controlling) {
+        ice->pairs[index].nominate = 1;
+    }
+
+    switch (ice->pairs[index].state) {
+    case PAIR_SUCCEEDED:
+        if (ice->pairs[index].nominate && !ice->controlling) {
+            ice->pairs[index].nominated = 1;
+            update_selected(ice, now_us);
+        }
+        break;
+    case PAIR_IN_PROGRESS:
+        break;                      /* 进行中的检查结果即可确认 */
+    default:
+        pair_trigger(ice, index);  /* 触发检查 (§7.3.1.4) */
+        break;
+    }
+}
+
+/**
+ * @brief Response to a check or consent request (RFC 8445 §7.2.5)
+ */
+static void handle_response(lws_ice_t* ice, const struct sockaddr_in* from, int relayed,
+                            const uint8_t* msg, int bytes, uint64_t now_us)
+{
+    const uint8_t* tid = lws_stun_msg_tid(msg);
+    int success = LWS_STUN_IS_SUCCESS(lws_stun_type(msg));
+    ice_pair_t* pair = NULL;
+    int i;
+
+    if (lws_stun_check_integrity(msg, bytes, (const uint8_t*)ice->remote_pwd,
+                                 (int)strlen(ice->remote_pwd)) != 0) {
+        return;
+    }
+
+    /* 同意新鲜度 (RFC 7675 §5.1) */
+    if (ice->state == LWS_ICE_CONNECTED && ice->selected >= 0 &&
+        memcmp(tid, ice->consent_tid, LWS_STUN_TID_SIZE) == 0) {
+        if (success && same_addr(from, &ice->remote[ice->pairs[ice->selected].remote].addr)) {
+            ice->consent_expire_us = now_us + (uint64_t)ice->config.consent_timeout_ms * 1000;
+        }
+        return;
+    }
+
+    for (i = 0; i < ice->pair_count; i++) {
+        if (ice->pairs[i].state == PAIR_IN_PROGRESS &&
+            memcmp(tid, ice->pairs[i].tid, LWS_STUN_TID_SIZE) == 0) {
+            pair = &ice->pairs[i];
+            break;
+        }
+    }
+    if (!pair) {
+        return;
+    }
+
+    if (!success) {
+        if (lws_stun_error_code(msg, bytes) == 487) {
+            /* 对端判定角色冲突：切换角色后重试 (§7.2.5.1) */
+            lws_log_info("[ICE] 487 Role Conflict, switching to %s\n",
+                         ice->controlling ? "controlled" : "controlling");
+            set_role(ice, !ice->controlling);
+            if (pair->use_candidate && !ice->config.aggressive) {
+                ice->nominating = 0;
+            }
+            pair->use_candidate = 0;
+            pair_trigger(ice, i);
+        } else {
+            pair_fail(ice, pair);
+        }
+        return;
+    }
+
+    /* 非对称路径视为失败 (§7.2.5.2.1) */
+    if (!same_addr(from, &ice->remote[pair->remote].addr) || is_relay(ice, pair->local) != relayed) {
+        pair_fail(ice, pair);
+        return;
+    }
+    /* XOR-MAPPED-ADDRESS不同于基址时是本地prflx候选；媒体仍从基址发出，不单独记录 */
+
+    pair->state = PAIR_SUCCEEDED;
+    if (ice->first_valid_us == 0) {
+        ice->first_valid_us = now_us;
+    }
+    /* 同foundation的冻结配对解冻 (§7.2.5.3.3) */
+    for (i = 0; i < ice->pair_count; i++) {
+        if (ice->pairs[i].state == PAIR_FROZEN && same_foundation(ice, pair, &ice->pairs[i])) {
+            ice->pairs[i].state = PAIR_WAITING;
+        }
+    }
+
+    if ((ice->controlling && pair->use_candidate) || (!ice->controlling && pair->nominate)) {
+        pair->nominated = 1;
+        update_selected(ice, now_us);
+    }
+}
+
+static int ice_input(lws_ice_t* ice, const struct sockaddr_in* from, int relayed,
+                     const uint8_t* data, int bytes, uint64_t now_us)
+{
+    uint16_t type;
+    int i;
+
+    if (!ice || !data || !lws_stun_is_message(data, bytes)) {
+        return 0;
+    }
+
+    type = lws_stun_type(data);
+    if (type == LWS_STUN_BINDING_REQUEST) {
+        handle_request(ice, from, relayed, data, bytes, now_us);
+    } else if (LWS_STUN_IS_SUCCESS(type) || LWS_STUN_IS_ERROR(type)) {
+        for (i = 0; !relayed && i < ice->txn_count; i++) {
+            gather_txn_t* txn = &ice->txns[i];
+            if (txn->state == TXN_SENT && same_addr(from, &txn->server) &&
+                memcmp(lws_stun_msg_tid(data), txn->tid, LWS_STUN_TID_SIZE) == 0) {
+                gather_response(ice, txn, data, bytes);
+                break;
+            }
+        }
+        if ((relayed || i == ice->txn_count) && ice->remote_pwd[0] && !ice->config.lite) {
+            handle_response(ice, from, relayed, data, bytes, now_us);
+        }
+    }
+
+    lws_ice_poll(ice, now_us);
+    return 1;
+}
+
+int lws_ice_input(lws_ice_t* ice, const struct sockaddr_in* from,
+                  const uint8_t* data, int bytes, uint64_t now_us)
+{
+    return ice_input(ice, from, 0, data, bytes, now_us);
+}
+
+int lws_ice_relay_input(lws_ice_t* ice, const struct sockaddr_in* peer,
+                        const uint8_t* data, int bytes, uint64_t now_us)
+{
+    return ice_input(ice, peer, 1, data, bytes, now_us);
+}
+
+/* ========================================
+ * Poll
+ * ======================================== */
+
+static void gather_poll(lws_ice_t* ice, uint64_t now_us)
+{
+    int pending = 0;
+    int i;
+
+    if (!ice->gathering || ice->gathering_done) {
+        return;
+    }
+
+    if (now_us >= ice->gather_deadline_us) {
+        for (i = 0; i < ice->txn_count; i++) {
+            ice->txns[i].state = TXN_DONE;
+        }
+        ice->relay_done = 1;
+        gather_finish(ice);
+        return;
+    }
+
+    /* TURN分配由会话驱动，完成前收集不结束 */
+    if (ice->config.relay && !ice->relay_done) {
+        pending++;
+    }
+
+    for (i = 0; i < ice->txn_count; i++) {
+        gather_txn_t* txn = &ice->txns[i];
+
+        if (txn->state == TXN_DONE) {
+            continue;
+        }
+        pending++;
+
+        /* 每个Ta最多发出一个请求（首发与重传共用节拍） */
+        if (now_us < ice->next_send_us) {
+            continue;
+        }
+        if (txn->state == TXN_SENT && now_us < txn->retransmit_us) {
+            continue;
+        }
+        txn->state = TXN_SENT;
+        txn->retransmit_us = now_us + (uint64_t)txn->rto_ms * 1000;
+        txn->rto_ms *= 2;
+        txn_send(ice, txn);
+        ice->next_send_us = now_us + (uint64_t)ice->config.ta_ms * 1000;
+    }
+
+    if (pending == 0) {
+        gather_finish(ice);
+    }
+}
+
+/**
+ * @brief Regular nomination: once no better pair is pending (or after a
+ * grace period), re-check the best valid pair with USE-CANDIDATE (§8.1.1)
+ */
+static void nominate_poll(lws_ice_t* ice, uint64_t now_us)
+{
+    int best = -1;
+    int better = 0;
+    int i;
+
+    if (!ice->controlling || ice->config.aggressive || ice->nominating ||
+        ice->state != LWS_ICE_CHECKING || ice->first_valid_us == 0) {
+        return;
+    }
+
+    for (i = 0; i < ice->pair_count; i++) {
+        if (ice->pairs[i].state == PAIR_SUCCEEDED &&
+            (best < 0 || ice->pairs[i].priority > ice->pairs[best].priority)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return;
+    }
+    for (i = 0; i < ice->pair_count; i++) {
+        pair_state_t st = ice->pairs[i].state;
+        if ((st == PAIR_FROZEN || st == PAIR_WAITING || st == PAIR_IN_PROGRESS) &&
+            ice->pairs[i].priority > ice->pairs[best].priority) {
+            better = 1;
+        }
+    }
+    if (better && now_us < ice->first_valid_us + (uint64_t)LWS_ICE_NOMINATE_WAIT_MS * 1000) {
+        return;
+    }
+
+    ice->nominating = 1;
+    ice->pairs[best].use_candidate = 1;
+    pair_trigger(ice, best);
+}
+
+static void checks_poll(lws_ice_t* ice, uint64_t now_us)
+{
+    int failed = 0;
+    int next = -1;
+    int i;
+
+    if (!ice->remote_pwd[0]) {
+        return;                     /* 对端凭据未知，还不能发检查 */
+    }
+
+    /* 重传不占Ta节拍 */
+    for (i = 0; i < ice->pair_count; i++) {
+        ice_pair_t* pair = &ice->pairs[i];
+
+        if (pair->state != PAIR_IN_PROGRESS || now_us < pair->retransmit_us) {
+            continue;
+        }
+        if (pair->tx >= LWS_ICE_CHECK_MAX_TX) {
+            pair_fail(ice, pair);
+            continue;
+        }
+        pair->rto_ms = pair->rto_ms * 2 > LWS_ICE_RTO_MAX_MS ? LWS_ICE_RTO_MAX_MS : pair->rto_ms * 2;
+        pair->tx++;
+        pair->retransmit_us = now_us + (uint64_t)pair->rto_ms * 1000;
+        check_send(ice, pair, pair->tid, pair->use_candidate);
+    }
+
+    nominate_poll(ice, now_us);
+
+    /* 每个Ta一个新检查：触发检查优先，其次优先级最高的WAITING配对 */
+    if (now_us >= ice->next_send_us) {
+        while (next < 0 && ice->triggered_count > 0) {
+            next = ice->triggered[0];
+            ice->triggered_count--;
+            memmove(ice->triggered, ice->triggered + 1, ice->triggered_count * sizeof(int));
+            ice->pairs[next].triggered = 0;
+            if (ice->pairs[next].state != PAIR_WAITING) {
+                next = -1;
+            }
+        }
+        /* 已连通后只发触发检查 */
+        for (i = 0; next < 0 && ice->state == LWS_ICE_CHECKING && i < ice->pair_count; i++) {
+            if (ice->pairs[i].state == PAIR_WAITING) {
+                int j, best = i;
+                for (j = i + 1; j < ice->pair_count; j++) {
+                    if (ice->pairs[j].state == PAIR_WAITING &&
+                        ice->pairs[j].priority > ice->pairs[best].priority) {
+                        best = j;
+                    }
+                }
+                next = best;
+            }
+        }
+        if (next >= 0) {
+            check_start(ice, &ice->pairs[next], now_us);
+            ice->next_send_us = now_us + (uint64_t)ice->config.ta_ms * 1000;
+        }
+    }
+
+    if (ice->state != LWS_ICE_CHECKING) {
+        return;
+    }
+
+    /* 对端候选已全部给出、本地收集完成且所有配对失败，或超时 */
+    for (i = 0; i < ice->pair_count; i++) {
+        failed += ice->pairs[i].state == PAIR_FAILED;
+    }
+    if (now_us >= ice->start_us + (uint64_t)ice->config.check_timeout_ms * 1000 ||
+        (ice->remote_done && (!ice->gathering || ice->gathering_done) &&
+         failed == ice->pair_count && ice->triggered_count == 0)) {
+        lws_log_warn(LWS_ERR_MEDIA_ICE, "[ICE] Connectivity checks failed (%d/%d pairs failed)\n",
+                     failed, ice->pair_count);
+        set_state(ice, LWS_ICE_FAILED);
+    }
+}
+
+static void consent_poll(lws_ice_t* ice, uint64_t now_us)
+{
+    const ice_pair_t* pair = &ice->pairs[ice->selected];
+    uint64_t interval;
+
+    if (now_us >= ice->consent_expire_us) {
+        lws_log_warn(LWS_ERR_MEDIA_ICE, "[ICE] Consent lost on the selected pair\n");
+        ice->selected = -1;
+        set_state(ice, LWS_ICE_FAILED);
+        return;
+    }
+    if (now_us < ice->consent_next_us || lws_stun_tid(ice->consent_tid) != 0) {
+        return;
+    }
+    check_send(ice, pair, ice->consent_tid, 0);
+
+    /* 间隔随机化到0.8~1.2倍 (RFC 7675 §5.1) */
+    interval = (uint64_t)ice->config.consent_interval_ms * (80 + ice->consent_tid[0] % 41) / 100;
+    ice->consent_next_us = now_us + interval * 1000;
+}
+
+void lws_ice_poll(lws_ice_t* ice, uint64_t now_us)
+{
+    if (!ice || ice->config.lite) {
+        return;                     /* lite：无定时器 */
+    }
+
+    gather_poll(ice, now_us);
+
+    if (ice->state == LWS_ICE_CHECKING || ice->state == LWS_ICE_CONNECTED) {
+        checks_poll(ice, now_us);
+    }
+    if (ice->state == LWS_ICE_CONNECTED) {
+        consent_poll(ice, now_us);
+    }
+}
+
+int lws_ice_gathering_done(const lws_ice_t* ice)
+{
+    return ice ? ice->gathering_done : 1;
+}
+
+int lws_ice_local_candidates(const lws_ice_t* ice, const lws_ice_cand_t** cands)
+{
+    if (!ice) {
+        return 0;
+    }
+    if (cands) {
+        *cands = ice->local;
+    }
+    return ice->local_count;
+}
+
+int lws_ice_remote_candidates(const lws_ice_t* ice, const lws_ice_cand_t** cands)
+{
+    if (!ice) {
+        return 0;
+    }
+    if (cands) {
+        *cands = ice->remote;
+    }
+    return ice->remote_count;
+}
+
+int lws_ice_set_relay(lws_ice_t* ice, const struct sockaddr_in* relayed,
+                      const struct sockaddr_in* mapped, uint64_t now_us)
+{
+    lws_ice_cand_t cand;
+    int ret = 0;
+    int i;
+
+    if (!ice || ice->relay_done || ice->config.lite) {
+        return -1;
+    }
+    ice->relay_done = 1;
+
+    if (relayed) {
+        memset(&cand, 0, sizeof(cand));
+        cand.type = LWS_ICE_CAND_RELAY;
+        cand.component = 1;
+        cand.addr = *relayed;
+        cand.base = mapped ? *mapped : *relayed;    /* SDP的raddr/rport */
+        cand.priority = lws_ice_priority(LWS_ICE_PREF_RELAY, 65535, 1);
+        cand_foundation(&cand, relayed->sin_addr.s_addr);
+
+        ret = add_local(ice, &cand);
+        if (ret == 0) {
+            ice->relay_local = ice->local_count - 1;
+            for (i = 0; i < ice->remote_count; i++) {
+                pair_add(ice, ice->relay_local, i);
+            }
+        }
+    }
+
+    if (ice->gathering && !ice->gathering_done) {
+        gather_poll(ice, now_us);
+    }
+    return ret;
+}
+
+/* ========================================
+ * Connectivity checks
+ * ======================================== */
+
+static int copy_cred(char* dst, const char* src)
+{
+    if (!src || strlen(src) >= LWS_ICE_CRED_SIZE) {
+        return -1;
+    }
+    strcpy(dst, src);
+    return 0;
+}
+
+int lws_ice_set_local_auth(lws_ice_t* ice, const char* ufrag, const char* pwd)
+{
+    if (!ice || copy_cred(ice->local_ufrag, ufrag) != 0 || copy_cred(ice->local_pwd, pwd) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int lws_ice_set_remote_auth(lws_ice_t* ice, const char* ufrag, const char* pwd)
+{
+    if (!ice || copy_cred(ice->remote_ufrag, ufrag) != 0 || copy_cred(ice->remote_pwd, pwd) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void lws_ice_set_controlling(lws_ice_t* ice, int controlling)
+{
+    if (ice && !ice->config.lite) {
+        set_role(ice, controlling);
+    }
+}
+
+int lws_ice_add_remote(lws_ice_t* ice, const lws_ice_cand_t* cand)
+{
+    int index;
+    int i;
+
+    if (!ice || !cand || cand->component != 1 || cand->addr.sin_port == 0) {
+        return -1;
+    }
+    if (ice->config.lite) {
+        return 0;                   /* lite：不配对，等待对端提名 */
+    }
+
+    index = find_remote(ice, &cand->addr);
+    if (index >= 0) {
+        /* 信令给出的候选替换已学到的同地址prflx候选 */
+        if (ice->remote[index].type != LWS_ICE_CAND_PRFLX || cand->type == LWS_ICE_CAND_PRFLX) {
+            return -1;
+        }
+        ice->remote[index] = *cand;
+        for (i = 0; i < ice->pair_count; i++) {
+            if (ice->pairs[i].remote == index) {
+                ice->pairs[i].priority = pair_priority(ice, &ice->pairs[i]);
+            }
+        }
+        return 0;
+    }
+    if (ice->remote_count >= LWS_ICE_MAX_REMOTE) {
+        return -1;
+    }
+
+    index = ice->remote_count++;
+    ice->remote[index] = *cand;
+    for (i = 0; i < ice->local_count; i++) {
+        pair_add(ice, i, index);
+    }
+    return 0;
+}
+
+void lws_ice_end_of_candidates(lws_ice_t* ice)
+{
+    if (ice) {
+        ice->remote_done = 1;
+    }
+}
+
+int lws_ice_start(lws_ice_t* ice, uint64_t now_us)
+{
+    if (!ice || ice->state != LWS_ICE_NEW) {
+        return -1;
+    }
+    ice->state = LWS_ICE_CHECKING;
+    ice->start_us = now_us;
+    if (ice->next_send_us < now_us) {
+        ice->next_send_us = now_us;
+    }
+    if (ice->config.lite) {
+        lws_log_info("[ICE] Lite: waiting for nomination\n");
+        return 0;
+    }
+    lws_log_info("[ICE] Checks started: %d pairs, %s\n", ice->pair_count,
+                 ice->controlling ? "controlling" : "controlled");
+
+    pairs_unfreeze(ice);
+    lws_ice_poll(ice, now_us);
+    return 0;
+}
+
+lws_ice_state_t lws_ice_state(const lws_ice_t* ice)
+{
+    return ice ? ice->state : LWS_ICE_FAILED;
+}
+
+int lws_ice_selected(const lws_ice_t* ice, lws_ice_cand_t* local, struct sockaddr_in* remote)
+{
+    const ice_pair_t* pair;
+
+    if (!ice || ice->selected < 0) {
+        return -1;
+    }
+    if (ice->config.lite) {
+        if (local) {
+            *local = ice->local[0];
+        }
+        if (remote) {
+            *remote = ice->lite_remote;
+        }
+        return 0;
+    }
+    pair = &ice->pairs[ice->selected];
+    if (local) {
+        *local = ice->local[pair->local];
+    }
+    if (remote) {
+        *remote = ice->remote[pair->remote].addr;
+    }
+    return 0;
+}
+
+int lws_ice_send(lws_ice_t* ice, const uint8_t* data, int bytes)
+{
+    if (!ice || ice->state != LWS_ICE_CONNECTED || ice->selected < 0) {
+        return -1;
+    }
+    if (ice->config.lite) {
+        return ice->handler.send(ice->handler.param, &ice->lite_remote, data, bytes);
+    }
+    return local_send(ice, ice->pairs[ice->selected].local,
+                      &ice->remote[ice->pairs[ice->selected].remote].addr, data, bytes);
+}
+
+void lws_ice_get_stats(const lws_ice_t* ice, lws_ice_stats_t* stats)
+{
+    if (!ice || !stats) {
+        return;
+    }
+    *stats = ice->stats;
+    stats->pairs = ice->pair_count;
+}
@@ -0,0 +1,271 @@
+/**
+ * @file lws_ice.h
+ * @brief ICE agent (RFC 8445): candidate gathering and connectivity checks
+ *
+ * The agent owns no socket and no timer. The session passes every STUN
+ * message received on the media socket to lws_ice_input() and calls
+ * lws_ice_poll() from its loop; datagrams go out through the send callback.
+ *
+ * Gathering: host candidates are added by the caller (one per interface),
+ * then lws_ice_gather() queries every configured STUN server in parallel
+ * for the server-reflexive address. Transactions are paced at Ta and
+ * retransmitted with exponential backoff until the gathering deadline;
+ * each new candidate is reported as soon as it is known (trickle ICE).
+ * With a TURN server (config.relay) gathering also waits for the relayed
+ * candidate, which the session obtains and hands over with
+ * lws_ice_set_relay().
+ *
+ * Checks: remote candidates may be added at any time (RFC 8838), before or
+ * after lws_ice_start(). Pairs are formed against the host bases (reflexive
+ * local candidates are pruned to their base), unfrozen per foundation and
+ * checked one per Ta, triggered checks first. Checks and media on pairs of
+ * the relayed candidate go through the relay_send callback, and datagrams
+ * relayed back by the TURN server enter through lws_ice_relay_input().
+ * The controlling agent nominates either on every check (aggressive) or
+ * with a second check on the best valid pair (regular). Once connected, consent is refreshed
+ * with a Binding request every few seconds (RFC 7675); without a response
+ * for the consent timeout the agent fails and stops sending.
+ *
+ * ICE-lite (RFC 8445 §2.5): the agent has host candidates only, is always
+ * controlled and keeps no check list. Binding requests are answered
+ * statelessly and the source of the highest-priority nominating request
+ * becomes the media destination. No gathering, checks or consent timers.
+ *
+ * Only component 1 is used: RTCP is multiplexed with RTP (RFC 5761).
+ */
+
+#ifndef __LWS_ICE_H__
+#define __LWS_ICE_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include "lws_sess.h"               /* lws_ice_t handle (lws_sess_get_ice) */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Constants
+ * ======================================== */
+
+#define LWS_ICE_MAX_SERVERS         4       /**< STUN servers queried in parallel */
+#define LWS_ICE_MAX_HOSTS           4       /**< Host candidates (interfaces) */
+#define LWS_ICE_MAX_LOCAL           8       /**< Local candidates of all types */
+#define LWS_ICE_TA_MS               50      /**< Default pacing interval (RFC 8445 §14.2) */
+#define LWS_ICE_RTO_MS              500     /**< Initial STUN retransmission timeout */
+#define LWS_ICE_GATHER_TIMEOUT_MS   3000    /**< Default gathering deadline */
+#define LWS_ICE_CAND_SIZE           160     /**< Buffer for one "candidate:" line */
+#define LWS_ICE_MAX_REMOTE          16      /**< Remote candidates */
+#define LWS_ICE_MAX_PAIRS           32      /**< Candidate pairs in the check list */
+#define LWS_ICE_RTO_MAX_MS          1600    /**< Check retransmission timeout cap */
+#define LWS_ICE_CHECK_MAX_TX        7       /**< Transmissions per check (Rc, RFC 8489 §6.2.1) */
+#define LWS_ICE_CHECK_TIMEOUT_MS    15000   /**< Fail if not connected by then (trickle peers) */
+#define LWS_ICE_NOMINATE_WAIT_MS    500     /**< Regular nomination: wait for better pairs */
+#define LWS_ICE_CONSENT_INTERVAL_MS 5000    /**< Consent check interval, ±20% (RFC 7675 §5.1) */
+#define LWS_ICE_CONSENT_TIMEOUT_MS  30000   /**< Consent lost without a response */
+#define LWS_ICE_CRED_SIZE           64      /**< ufrag/pwd buffer */
+
+/* Type preferences (RFC 8445 §5.1.2.2) */
+#define LWS_ICE_PREF_HOST           126
+#define LWS_ICE_PREF_PRFLX          110
+#define LWS_ICE_PREF_SRFLX          100
+#define LWS_ICE_PREF_RELAY          0
+
+typedef enum {
+    LWS_ICE_CAND_HOST,
+    LWS_ICE_CAND_SRFLX,
+    LWS_ICE_CAND_PRFLX,
+    LWS_ICE_CAND_RELAY
+} lws_ice_cand_type_t;
+
+/**
+ * @brief One candidate (IPv4/UDP)
+ */
+typedef struct {
+    lws_ice_cand_type_t type;
+    uint8_t component;              /**< 1 = RTP, 2 = RTCP */
+    uint32_t priority;
+    char foundation[12];
+    struct sockaddr_in addr;        /**< Transport address */
+    struct sockaddr_in base;        /**< Base / related address (equals addr for host) */
+} lws_ice_cand_t;
+
+typedef enum {
+    LWS_ICE_NEW,                    /**< Checks not started */
+    LWS_ICE_CHECKING,
+    LWS_ICE_CONNECTED,              /**< A nominated pair is selected */
+    LWS_ICE_FAILED                  /**< All pairs failed, timed out or consent lost */
+} lws_ice_state_t;
+
+typedef struct {
+    struct sockaddr_in stun_servers[LWS_ICE_MAX_SERVERS];
+    int stun_count;
+    int ta_ms;                      /**< Pacing interval, 0 = LWS_ICE_TA_MS */
+    int gather_timeout_ms;          /**< Gathering deadline, 0 = LWS_ICE_GATHER_TIMEOUT_MS */
+    int aggressive;                 /**< Controlling: USE-CANDIDATE on every check */
+    int check_timeout_ms;           /**< 0 = LWS_ICE_CHECK_TIMEOUT_MS */
+    int consent_interval_ms;        /**< 0 = LWS_ICE_CONSENT_INTERVAL_MS */
+    int consent_timeout_ms;         /**< 0 = LWS_ICE_CONSENT_TIMEOUT_MS */
+    int lite;                       /**< ICE-lite: answer checks, latch the nominated pair */
+    int relay;                      /**< A relayed candidate will be set (TURN allocation) */
+} lws_ice_config_t;
+
+typedef struct {
+    /** Send one datagram from the media socket, 0 on success */
+    int (*send)(void* param, const struct sockaddr_in* to, const uint8_t* data, int bytes);
+    /** Send one datagram through the TURN relay (pairs of the relayed candidate) */
+    int (*relay_send)(void* param, const struct sockaddr_in* to, const uint8_t* data, int bytes);
+    /** New local candidate (host candidates on add, server-reflexive as they arrive) */
+    void (*on_candidate)(void* param, const lws_ice_cand_t* cand);
+    /** All gathering transactions finished or the deadline passed */
+    void (*on_gathering_done)(void* param);
+    /** Check list state changed (CONNECTED, FAILED) */
+    void (*on_state)(void* param, lws_ice_state_t state);
+    void* param;
+} lws_ice_handler_t;
+
+typedef struct {
+    int pairs;                      /**< Pairs in the check list */
+    uint32_t checks_sent;           /**< Connectivity checks, retransmissions included */
+    uint32_t checks_received;       /**< Valid Binding requests from the peer */
+    int connect_ms;                 /**< lws_ice_start() to first selected pair, -1 if not yet */
+} lws_ice_stats_t;
+
+/* ========================================
+ * Agent
+ * ======================================== */
+
+lws_ice_t* lws_ice_create(const lws_ice_config_t* config, const lws_ice_handler_t* handler);
+void lws_ice_destroy(lws_ice_t* ice);
+
+/**
+ * @brief Add a host candidate; earlier hosts get the higher local preference
+ * @return 0 on success, -1 if full or a duplicate
+ */
+int lws_ice_add_host(lws_ice_t* ice, const struct sockaddr_in* addr);
+
+/**
+ * @brief Start server-reflexive gathering (completes at once without servers)
+ */
+int lws_ice_gather(lws_ice_t* ice, uint64_t now_us);
+
+/**
+ * @brief Process a datagram received on the media socket
+ *
+ * Handles gathering responses, Binding requests from the peer (answered,
+ * triggering a check) and responses to checks and consent requests.
+ *
+ * @return 1 if it was a STUN message (consumed), 0 otherwise
+ */
+int lws_ice_input(lws_ice_t* ice, const struct sockaddr_in* from,
+                  const uint8_t* data, int bytes, uint64_t now_us);
+
+/**
+ * @brief Process a datagram the TURN server relayed from a peer
+ * @return 1 if it was a STUN message (consumed), 0 otherwise
+ */
+int lws_ice_relay_input(lws_ice_t* ice, const struct sockaddr_in* peer,
+                        const uint8_t* data, int bytes, uint64_t now_us);
+
+/**
+ * @brief Relayed candidate allocated (related address = mapped), or NULL if
+ * the allocation failed; either way gathering no longer waits for it
+ * @return 0 on success, -1 if the candidate could not be added
+ */
+int lws_ice_set_relay(lws_ice_t* ice, const struct sockaddr_in* relayed,
+                      const struct sockaddr_in* mapped, uint64_t now_us);
+
+/**
+ * @brief Send paced and retransmitted transactions, checks and consent
+ * requests; enforce the gathering, check and consent deadlines
+ */
+void lws_ice_poll(lws_ice_t* ice, uint64_t now_us);
+
+int lws_ice_gathering_done(const lws_ice_t* ice);
+
+/**
+ * @brief Local candidates gathered so far
+ * @return Count
+ */
+int lws_ice_local_candidates(const lws_ice_t* ice, const lws_ice_cand_t** cands);
+
+/**
+ * @brief Remote candidates (signalled and learned) so far
+ * @return Count
+ */
+int lws_ice_remote_candidates(const lws_ice_t* ice, const lws_ice_cand_t** cands);
+
+/* ========================================
+ * Connectivity checks
+ * ======================================== */
+
+/**
+ * @brief Local ufrag/pwd (checks received are validated against them)
+ */
+int lws_ice_set_local_auth(lws_ice_t* ice, const char* ufrag, const char* pwd);
+
+/**
+ * @brief Remote ufrag/pwd (required before checks are sent)
+ */
+int lws_ice_set_remote_auth(lws_ice_t* ice, const char* ufrag, const char* pwd);
+
+/**
+ * @brief Role (the offerer controls); a role conflict may switch it later.
+ * Ignored by a lite agent, which is always controlled.
+ */
+void lws_ice_set_controlling(lws_ice_t* ice, int controlling);
+
+/**
+ * @brief Add a remote candidate and pair it (also while checks run);
+ * a lite agent keeps no pairs and ignores it
+ * @return 0 on success, -1 if full, a duplicate or not component 1
+ */
+int lws_ice_add_remote(lws_ice_t* ice, const lws_ice_cand_t* cand);
+
+/**
+ * @brief The peer sent all its candidates (a=end-of-candidates or a non-trickle SDP)
+ */
+void lws_ice_end_of_candidates(lws_ice_t* ice);
+
+/**
+ * @brief Start connectivity checks
+ */
+int lws_ice_start(lws_ice_t* ice, uint64_t now_us);
+
+lws_ice_state_t lws_ice_state(const lws_ice_t* ice);
+
+/**
+ * @brief Selected pair: local base and remote address
+ * @return 0 if a pair is selected, -1 otherwise
+ */
+int lws_ice_selected(const lws_ice_t* ice, lws_ice_cand_t* local, struct sockaddr_in* remote);
+
+/**
+ * @brief Send media on the selected pair
+ * @return 0 on success, -1 without a selected pair or consent
+ */
+int lws_ice_send(lws_ice_t* ice, const uint8_t* data, int bytes);
+
+void lws_ice_get_stats(const lws_ice_t* ice, lws_ice_stats_t* stats);
+
+/* ========================================
+ * Candidates
+ * ======================================== */
+
+/**
+ * @brief Candidate priority (RFC 8445 §5.1.2.1)
+ */
+uint32_t lws_ice_priority(int type_pref, int local_pref, int component);
+
+/**
+ * @brief Format a candidate as an SDP attribute value ("candidate:...", no "a=")
+ * @return Length, -1 if the buffer is too small
+ */
+int lws_ice_cand_write(const lws_ice_cand_t* cand, char* buf, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_ICE_H__ */
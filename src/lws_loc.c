@@ -0,0 +1,570 @@
+/**
+ * @file lws_loc.c
+ * @brief lwsip location service implementation
+ *
+ * 数据结构：
+ * - 哈希表：开放寻址 + 线性探测，槽位只保存(hash, aor指针)，容量为2的幂
+ * - AOR记录：单次分配，key内联在记录尾部，挂一个绑定单链表
+ * - 绑定：单次分配，Contact内联在记录尾部，记录自己在过期堆中的下标
+ * - 过期索引：所有绑定共享一个二叉最小堆（按expires_at排序），
+ *   刷新/删除时O(log n)调整，过期处理只检查堆顶
+ */
+
+#include "lws_loc.h"
+#include "lws_defs.h"
+#include "lws_err.h"
+#include "lws_mem.h"
+#include "lws_log.h"
+
+#include <string.h>
+
+/* ========================================
+ * Internal structures
+ * ======================================== */
+
+typedef struct loc_aor_t loc_aor_t;
+
+/**
+ * @brief 单个Contact绑定
+ */
+typedef struct loc_binding_t {
+    loc_aor_t* owner;               /**< 所属AOR */
+    struct loc_binding_t* next;     /**< AOR内的下一个绑定 */
+    uint64_t expires_at;            /**< 过期时间（毫秒） */
+    uint32_t heap_index;            /**< 在过期堆中的下标 */
+    uint16_t size;                  /**< 分配大小 */
+    char contact[];                 /**< Contact URI */
+} loc_binding_t;
+
+/**
+ * @brief AOR记录
+ */
+struct loc_aor_t {
+    uint32_t hash;
+    uint16_t binding_count;
+    uint16_t size;                  /**< 分配大小 */
+    loc_binding_t* bindings;        /**< 绑定链表 */
+    char aor[];                     /**< AOR key */
+};
+
+/**
+ * @brief 哈希表槽位
+ */
+typedef struct {
+    uint32_t hash;
+    loc_aor_t* aor;                 /**< NULL=空，LOC_TOMBSTONE=已删除 */
+} loc_slot_t;
+
+struct lws_loc_t {
+    /* 哈希表 */
+    loc_slot_t* slots;
+    uint32_t slot_mask;             /**< 容量-1 */
+    uint32_t aor_count;
+    uint32_t tombstones;
+
+    /* 过期索引（最小堆） */
+    loc_binding_t** heap;
+    uint32_t heap_size;
+    uint32_t heap_capacity;
+
+    /* 统计 */
+    uint64_t record_bytes;          /**< AOR记录和绑定占用的字节数 */
+    uint64_t expired_total;
+};
+
+static loc_aor_t g_tombstone;
+#define LOC_TOMBSTONE (&g_tombstone)
+
+/* 负载因子上限 7/10 */
+#define LOC_MAX_LOAD_NUM 7
+#define LOC_MAX_LOAD_DEN 10
+
+/* ========================================
+ * Hash table
+ * ======================================== */
+
+/* FNV-1a */
+static uint32_t loc_hash(const char* s)
+{
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t loc_round_pow2(uint32_t n)
+{
+    uint32_t cap = 16;
+    while (cap < n && cap < 0x80000000u) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+/**
+ * @brief 查找AOR所在槽位
+ * @param insert_pos 未找到时返回可插入的槽位（优先复用tombstone）
+ * @return 找到返回槽位下标，未找到返回-1
+ */
+static int64_t loc_find_slot(lws_loc_t* loc, const char* aor, uint32_t hash,
+                             uint32_t* insert_pos)
+{
+    uint32_t i = hash & loc->slot_mask;
+    int64_t first_tomb = -1;
+
+    for (;;) {
+        loc_slot_t* slot = &loc->slots[i];
+        if (!slot->aor) {
+            if (insert_pos) {
+                *insert_pos = (first_tomb >= 0) ? (uint32_t)first_tomb : i;
+            }
+            return -1;
+        }
+
+        if (slot->aor == LOC_TOMBSTONE) {
+            if (first_tomb < 0) {
+                first_tomb = i;
+            }
+        } else if (slot->hash == hash && strcmp(slot->aor->aor, aor) == 0) {
+            return i;
+        }
+
+        i = (i + 1) & loc->slot_mask;
+    }
+}
+
+static int loc_resize(lws_loc_t* loc, uint32_t new_capacity)
+{
+    loc_slot_t* old_slots = loc->slots;
+    uint32_t old_capacity = loc->slot_mask + 1;
+    uint32_t i;
+
+    loc_slot_t* slots = (loc_slot_t*)lws_calloc(new_capacity, sizeof(loc_slot_t));
+    if (!slots) {
+        return LWS_ENOMEM;
+    }
+
+    loc->slots = slots;
+    loc->slot_mask = new_capacity - 1;
+    loc->tombstones = 0;
+
+    for (i = 0; i < old_capacity; i++) {
+        loc_aor_t* rec = old_slots[i].aor;
+        if (rec && rec != LOC_TOMBSTONE) {
+            uint32_t j = rec->hash & loc->slot_mask;
+            while (slots[j].aor) {
+                j = (j + 1) & loc->slot_mask;
+            }
+            slots[j].hash = rec->hash;
+            slots[j].aor = rec;
+        }
+    }
+
+    lws_free(old_slots);
+    return LWS_OK;
+}
+
+static void loc_remove_aor(lws_loc_t* loc, loc_aor_t* rec)
+{
+    int64_t idx = loc_find_slot(loc, rec->aor, rec->hash, NULL);
+    if (idx >= 0) {
+        loc->slots[idx].aor = LOC_TOMBSTONE;
+        loc->aor_count--;
+        loc->tombstones++;
+    }
+
+    loc->record_bytes -= rec->size;
+    lws_free(rec);
+}
+
+/* ========================================
+ * Expiry heap
+ * ======================================== */
+
+static void heap_swap(lws_loc_t* loc, uint32_t a, uint32_t b)
+{
+    loc_binding_t* tmp = loc->heap[a];
+    loc->heap[a] = loc->heap[b];
+    loc->heap[b] = tmp;
+    loc->heap[a]->heap_index = a;
+    loc->heap[b]->heap_index = b;
+}
+
+static void heap_sift_up(lws_loc_t* loc, uint32_t i)
+{
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (loc->heap[parent]->expires_at <= loc->heap[i]->expires_at) {
+            break;
+        }
+        heap_swap(loc, i, parent);
+        i = parent;
+    }
+}
+
+static void heap_sift_down(lws_loc_t* loc, uint32_t i)
+{
+    for (;;) {
+        uint32_t l = 2 * i + 1;
+        uint32_t r = l + 1;
+        uint32_t smallest = i;
+
+        if (l < loc->heap_size &&
+            loc->heap[l]->expires_at < loc->heap[smallest]->expires_at) {
+            smallest = l;
+        }
+        if (r < loc->heap_size &&
+            loc->heap[r]->expires_at < loc->heap[smallest]->expires_at) {
+            smallest = r;
+        }
+        if (smallest == i) {
+            break;
+        }
+        heap_swap(loc, i, smallest);
+        i = smallest;
+    }
+}
+
+static int heap_push(lws_loc_t* loc, loc_binding_t* b)
+{
+    if (loc->heap_size == loc->heap_capacity) {
+        uint32_t cap = loc->heap_capacity ? loc->heap_capacity * 2 : 64;
+        loc_binding_t** heap = (loc_binding_t**)lws_realloc(loc->heap,
+                                                             cap * sizeof(loc_binding_t*));
+        if (!heap) {
+            return LWS_ENOMEM;
+        }
+        loc->heap = heap;
+        loc->heap_capacity = cap;
+    }
+
+    b->heap_index = loc->heap_size;
+    loc->heap[loc->heap_size++] = b;
+    heap_sift_up(loc, b->heap_index);
+    return LWS_OK;
+}
+
+static void heap_remove(lws_loc_t* loc, loc_binding_t* b)
+{
+    uint32_t i = b->heap_index;
+    uint32_t last = --loc->heap_size;
+
+    if (i != last) {
+        heap_swap(loc, i, last);
+        heap_sift_down(loc, i);
+        heap_sift_up(loc, i);
+    }
+}
+
+static void heap_update(lws_loc_t* loc, loc_binding_t* b)
+{
+    heap_sift_down(loc, b->heap_index);
+    heap_sift_up(loc, b->heap_index);
+}
+
+/* ========================================
+ * Binding helpers
+ * ======================================== */
+
+/**
+ * @brief 从AOR中摘除并释放绑定（不处理AOR本身）
+ */
+static void loc_free_binding(lws_loc_t* loc, loc_aor_t* rec, loc_binding_t* b)
+{
+    loc_binding_t** pp = &rec->bindings;
+    while (*pp && *pp != b) {
+        pp = &(*pp)->next;
+    }
+    if (*pp) {
+        *pp = b->next;
+        rec->binding_count--;
+    }
+
+    heap_remove(loc, b);
+    loc->record_bytes -= b->size;
+    lws_free(b);
+}
+
+/* ========================================
+ * Public API implementation
+ * ======================================== */
+
+lws_loc_t* lws_loc_create(uint32_t capacity)
+{
+    lws_loc_t* loc = (lws_loc_t*)lws_calloc(1, sizeof(lws_loc_t));
+    if (!loc) {
+        lws_log_error(LWS_ENOMEM, "[LOC] Failed to allocate location service\n");
+        return NULL;
+    }
+
+    if (capacity == 0) {
+        capacity = LWS_LOC_DEFAULT_CAPACITY;
+    }
+
+    /* 按负载因子预留槽位，避免批量注册时反复rehash */
+    uint32_t slots = loc_round_pow2(capacity / LOC_MAX_LOAD_NUM * LOC_MAX_LOAD_DEN + 1);
+    loc->slots = (loc_slot_t*)lws_calloc(slots, sizeof(loc_slot_t));
+    if (!loc->slots) {
+        lws_log_error(LWS_ENOMEM, "[LOC] Failed to allocate hash table\n");
+        lws_free(loc);
+        return NULL;
+    }
+    loc->slot_mask = slots - 1;
+
+    return loc;
+}
+
+void lws_loc_destroy(lws_loc_t* loc)
+{
+    uint32_t i;
+
+    if (!loc) {
+        return;
+    }
+
+    for (i = 0; i <= loc->slot_mask; i++) {
+        loc_aor_t* rec = loc->slots[i].aor;
+        if (rec && rec != LOC_TOMBSTONE) {
+            loc_binding_t* b = rec->bindings;
+            while (b) {
+                loc_binding_t* next = b->next;
+                lws_free(b);
+                b = next;
+            }
+            lws_free(rec);
+        }
+    }
+
+    lws_free(loc->slots);
+    lws_free(loc->heap);
+    lws_free(loc);
+}
+
+int lws_loc_bind(lws_loc_t* loc, const char* aor, const char* contact,
+                 int expires, uint64_t now_ms)
+{
+    if (!loc || !aor || !contact || !aor[0] || !contact[0] || expires < 0) {
+        return LWS_EINVAL;
+    }
+
+    size_t aor_len = strlen(aor);
+    size_t contact_len = strlen(contact);
+    if (aor_len >= LWS_MAX_URI_LEN || contact_len >= LWS_MAX_URI_LEN) {
+        return LWS_EINVAL;
+    }
+
+    uint32_t hash = loc_hash(aor);
+    uint32_t insert_pos = 0;
+    int64_t idx = loc_find_slot(loc, aor, hash, &insert_pos);
+    loc_aor_t* rec = (idx >= 0) ? loc->slots[idx].aor : NULL;
+
+    /* 查找已有绑定 */
+    loc_binding_t* b = NULL;
+    if (rec) {
+        for (b = rec->bindings; b; b = b->next) {
+            if (strcmp(b->contact, contact) == 0) {
+                break;
+            }
+        }
+    }
+
+    if (expires == 0) {
+        /* 注销单个Contact */
+        if (b) {
+            loc_free_binding(loc, rec, b);
+            if (rec->binding_count == 0) {
+                loc_remove_aor(loc, rec);
+            }
+        }
+        return LWS_OK;
+    }
+
+    uint64_t expires_at = now_ms + (uint64_t)expires * 1000;
+
+    if (b) {
+        /* 刷新 */
+        b->expires_at = expires_at;
+        heap_update(loc, b);
+        return LWS_OK;
+    }
+
+    if (!rec) {
+        /* 新AOR：必要时先扩容，扩容后重新定位插入点 */
+        if ((uint64_t)(loc->aor_count + loc->tombstones + 1) * LOC_MAX_LOAD_DEN >
+            (uint64_t)(loc->slot_mask + 1) * LOC_MAX_LOAD_NUM) {
+            uint32_t cap = loc->slot_mask + 1;
+            if ((uint64_t)(loc->aor_count + 1) * LOC_MAX_LOAD_DEN * 2 >
+                (uint64_t)cap * LOC_MAX_LOAD_NUM) {
+                cap *= 2;  /* 真正变满才翻倍，否则仅清理tombstone */
+            }
+            if (loc_resize(loc, cap) != LWS_OK) {
+                return LWS_ENOMEM;
+            }
+            loc_find_slot(loc, aor, hash, &insert_pos);
+        }
+
+        size_t size = sizeof(loc_aor_t) + aor_len + 1;
+        rec = (loc_aor_t*)lws_malloc(size);
+        if (!rec) {
+            return LWS_ENOMEM;
+        }
+        rec->hash = hash;
+        rec->binding_count = 0;
+        rec->size = (uint16_t)size;
+        rec->bindings = NULL;
+        memcpy(rec->aor, aor, aor_len + 1);
+
+        if (loc->slots[insert_pos].aor == LOC_TOMBSTONE) {
+            loc->tombstones--;
+        }
+        loc->slots[insert_pos].hash = hash;
+        loc->slots[insert_pos].aor = rec;
+        loc->aor_count++;
+        loc->record_bytes += size;
+    } else if (rec->binding_count >= LWS_LOC_MAX_CONTACTS) {
+        /* 达到上限：替换最早过期的绑定 */
+        loc_binding_t* oldest = rec->bindings;
+        for (b = rec->bindings; b; b = b->next) {
+            if (b->expires_at < oldest->expires_at) {
+                oldest = b;
+            }
+        }
+        lws_log_warn(LWS_EBUSY, "[LOC] %s: contact limit reached, replacing %s\n",
+                     aor, oldest->contact);
+        loc_free_binding(loc, rec, oldest);
+    }
+
+    size_t size = sizeof(loc_binding_t) + contact_len + 1;
+    b = (loc_binding_t*)lws_malloc(size);
+    if (!b) {
+        if (rec->binding_count == 0) {
+            loc_remove_aor(loc, rec);
+        }
+        return LWS_ENOMEM;
+    }
+    b->owner = rec;
+    b->expires_at = expires_at;
+    b->size = (uint16_t)size;
+    memcpy(b->contact, contact, contact_len + 1);
+
+    if (heap_push(loc, b) != LWS_OK) {
+        lws_free(b);
+        if (rec->binding_count == 0) {
+            loc_remove_aor(loc, rec);
+        }
+        return LWS_ENOMEM;
+    }
+
+    b->next = rec->bindings;
+    rec->bindings = b;
+    rec->binding_count++;
+    loc->record_bytes += size;
+
+    return LWS_OK;
+}
+
+int lws_loc_unbind_all(lws_loc_t* loc, const char* aor)
+{
+    if (!loc || !aor) {
+        return 0;
+    }
+
+    int64_t idx = loc_find_slot(loc, aor, loc_hash(aor), NULL);
+    if (idx < 0) {
+        return 0;
+    }
+
+    loc_aor_t* rec = loc->slots[idx].aor;
+    int count = 0;
+    while (rec->bindings) {
+        loc_free_binding(loc, rec, rec->bindings);
+        count++;
+    }
+    loc_remove_aor(loc, rec);
+
+    return count;
+}
+
+int lws_loc_lookup(lws_loc_t* loc, const char* aor, lws_loc_contact_t* contacts,
+                   int max_count, uint64_t now_ms)
+{
+    if (!loc || !aor || !contacts || max_count <= 0) {
+        return 0;
+    }
+
+    int64_t idx = loc_find_slot(loc, aor, loc_hash(aor), NULL);
+    if (idx < 0) {
+        return 0;
+    }
+
+    int count = 0;
+    loc_binding_t* b;
+    for (b = loc->slots[idx].aor->bindings; b && count < max_count; b = b->next) {
+        /* 已过期但尚未被lws_loc_expire清理的绑定不返回 */
+        if (b->expires_at <= now_ms) {
+            continue;
+        }
+        contacts[count].contact = b->contact;
+        contacts[count].expires = (int)((b->expires_at - now_ms + 999) / 1000);
+        count++;
+    }
+
+    return count;
+}
+
+int lws_loc_expire(lws_loc_t* loc, uint64_t now_ms,
+                   lws_loc_on_expired_f on_expired, void* userdata)
+{
+    int count = 0;
+
+    if (!loc) {
+        return 0;
+    }
+
+    while (loc->heap_size > 0 && loc->heap[0]->expires_at <= now_ms) {
+        loc_binding_t* b = loc->heap[0];
+        loc_aor_t* rec = b->owner;
+
+        if (on_expired) {
+            on_expired(rec->aor, b->contact, userdata);
+        }
+
+        loc_free_binding(loc, rec, b);
+        if (rec->binding_count == 0) {
+            loc_remove_aor(loc, rec);
+        }
+        count++;
+    }
+
+    loc->expired_total += count;
+    return count;
+}
+
+uint64_t lws_loc_next_expiry(lws_loc_t* loc)
+{
+    if (!loc || loc->heap_size == 0) {
+        return 0;
+    }
+    return loc->heap[0]->expires_at;
+}
+
+void lws_loc_get_stats(lws_loc_t* loc, lws_loc_stats_t* stats)
+{
+    if (!loc || !stats) {
+        return;
+    }
+
+    memset(stats, 0, sizeof(lws_loc_stats_t));
+    stats->aor_count = loc->aor_count;
+    stats->binding_count = loc->heap_size;
+    stats->slot_count = loc->slot_mask + 1;
+    stats->memory_bytes = sizeof(lws_loc_t)
+                        + (uint64_t)stats->slot_count * sizeof(loc_slot_t)
+                        + (uint64_t)loc->heap_capacity * sizeof(loc_binding_t*)
+                        + loc->record_bytes;
+    stats->bytes_per_binding = loc->heap_size ?
+        (uint32_t)(stats->memory_bytes / loc->heap_size) : 0;
+    stats->expired_total = loc->expired_total;
+}
@@ -0,0 +1,564 @@
+/**
+ * @file lws_rec.c
+ * @brief Asynchronous recording writer implementation
+ *
+ * 环形队列：生产者（媒体线程）只写head，消费者（写线程或close）只写
+ * tail，槽位数为2的幂，head与tail自由增长按掩码取槽。head以release写入、
+ * acquire读取，保证消费者看到槽中的帧指针；tail同理，保证生产者复用槽
+ * 时消费者已取走旧帧。
+ *
+ * 写线程全局唯一：第一个录音器打开时启动，最后一个关闭时停止。录音器
+ * 链表与消费端都由s_rec_mutex保护，close先摘链再在调用线程写完剩余帧，
+ * 因此同一时刻只有一个消费者。
+ *
+ * 双路录音：两路共用一个环形队列（同一生产线程），槽位另记所属的路。
+ * 消费者把帧放入交错双声道的对齐窗口mix，窗口初始为静音，未覆盖的位置
+ * 即为补齐的静音；写出后窗口前移。
+ *
+ * 编码包录音：不解码，沿用单路的定位方法算出每个包的位置，逐包交给
+ * 回调，由后端补齐空洞。
+ */
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "lws_rec.h"
+#include "lws_defs.h"
+#include "lws_mem.h"
+#include "lws_mutex.h"
+#include "lws_thread.h"
+
+#define REC_FRAME_MS            20          /* 估算队列容量用的帧长 */
+#define REC_POLL_MS             10          /* 写线程检查停止标志的间隔 */
+
+typedef enum {
+    REC_MONO = 0,
+    REC_STEREO,
+    REC_PACKETS
+} rec_mode_t;
+
+typedef struct {
+    int started;
+    int64_t end;                    /* 已放置到的位置（采样，自录音开始） */
+    uint32_t next_ts;               /* 连续时下一帧的时间戳 */
+} rec_leg_t;
+
+struct lws_rec {
+    lws_frame_t** slots;
+    uint8_t* legs;                  /* 双路：各槽位帧所属的路 */
+    uint32_t mask;
+    uint32_t head;                  /* 生产者写 */
+    uint32_t tail;                  /* 消费者写 */
+
+    int sample_rate;
+    int channels;
+    rec_mode_t mode;
+    lws_rec_write_f write;
+    lws_rec_packet_f packet;
+    void* param;
+
+    int16_t* batch;                 /* 合并写的缓冲（消费者使用） */
+    int batch_samples;              /* 单次写入上限（每声道采样数） */
+
+    /* 双路对齐与编码包定位（消费者使用） */
+    rec_leg_t leg[2];
+    int based;
+    uint64_t base_us;               /* 第一帧的time_us，时间线的零点 */
+    int16_t* mix;                   /* 交错双声道窗口 */
+    int mix_len;                    /* 窗口长度（每声道采样数） */
+    int64_t mix_pos;                /* mix[0]在时间线上的位置 */
+
+    /* 生产者更新 */
+    uint64_t dropped;
+    uint32_t max_queued;
+
+    /* 消费者更新，生产者以原子读取 */
+    uint64_t frames;
+    uint64_t writes;
+    uint64_t late;
+    uint32_t max_write_us;
+
+    lws_rec_t* next;
+};
+
+typedef struct {
+    lws_thread_t* thread;
+    int stop;
+} rec_writer_t;
+
+static lws_mutex_t s_rec_mutex = PTHREAD_MUTEX_INITIALIZER;
+static lws_rec_t* s_recs;           /* Guarded by s_rec_mutex */
+static rec_writer_t* s_writer;      /* Guarded by s_rec_mutex */
+
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+}
+
+/* ========================================
+ * Consumer
+ * ======================================== */
+
+static void rec_write(lws_rec_t* rec, const int16_t* pcm, int samples)
+{
+    uint64_t start = now_us();
+    uint64_t elapsed;
+
+    rec->write(rec->param, pcm, samples);
+
+    elapsed = now_us() - start;
+    __atomic_store_n(&rec->writes, rec->writes + 1, __ATOMIC_RELAXED);
+    if (elapsed > rec->max_write_us) {
+        __atomic_store_n(&rec->max_write_us, (uint32_t)elapsed, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Write the stereo window up to position upto (silence where no leg was placed)
+ */
+static void rec_mix_write(lws_rec_t* rec, int64_t upto)
+{
+    while (upto > rec->mix_pos) {
+        int n = (int)LWS_MIN(upto - rec->mix_pos, (int64_t)rec->mix_len);
+        int done = 0;
+
+        while (done < n) {
+            int chunk = LWS_MIN(n - done, rec->batch_samples);
+            rec_write(rec, rec->mix + done * 2, chunk);
+            done += chunk;
+        }
+
+        /* 窗口前移，空出的部分置为静音 */
+        memmove(rec->mix, rec->mix + n * 2, (size_t)(rec->mix_len - n) * 2 * sizeof(int16_t));
+        memset(rec->mix + (rec->mix_len - n) * 2, 0, (size_t)n * 2 * sizeof(int16_t));
+        rec->mix_pos += n;
+    }
+}
+
+/**
+ * @brief Position of a frame of one leg on the timeline, advancing the leg past it
+ */
+static int64_t rec_position(lws_rec_t* rec, rec_leg_t* l, const lws_frame_t* frame)
+{
+    int64_t resync = (int64_t)rec->sample_rate * LWS_REC_RESYNC_MS / 1000;
+    int64_t wall = 0;
+    int64_t pos;
+    int n = frame->samples;
+
+    if (!rec->based) {
+        rec->base_us = frame->time_us;
+        rec->based = 1;
+    }
+    if (frame->time_us > rec->base_us) {
+        /* 取最近的帧边界，到达时间的几毫秒抖动不会错开两路 */
+        wall = (int64_t)((frame->time_us - rec->base_us) * (uint64_t)rec->sample_rate / 1000000);
+        wall = (wall + n / 2) / n * n;
+    }
+
+    pos = wall;
+    if (l->started) {
+        /* 时间戳连续时紧接上一帧，跳变（丢包、DTX）处留出静音 */
+        int32_t gap = (int32_t)(frame->timestamp - l->next_ts);
+        pos = l->end + (gap > 0 ? gap : 0);
+
+        /* 时间戳重置、长时间无帧等：按墙上时钟重新定位 */
+        if (pos - wall > resync || wall - pos > resync) {
+            pos = wall;
+        }
+    }
+    l->started = 1;
+    l->next_ts = frame->timestamp + (uint32_t)n;
+    l->end = pos + n;
+    return pos;
+}
+
+/**
+ * @brief Place a mono frame of one leg on the stereo timeline
+ */
+static void rec_place(lws_rec_t* rec, int leg, const lws_frame_t* frame)
+{
+    const int16_t* pcm = (const int16_t*)frame->data;
+    int64_t pos = rec_position(rec, &rec->leg[leg], frame);
+    int n = frame->samples;
+    int i;
+
+    /* 已写出的部分不能再改 */
+    if (pos < rec->mix_pos) {
+        int skip = (int)LWS_MIN(rec->mix_pos - pos, (int64_t)n);
+        if (skip == n) {
+            __atomic_store_n(&rec->late, rec->late + 1, __ATOMIC_RELAXED);
+            return;
+        }
+        pcm += skip;
+        n -= skip;
+        pos = rec->mix_pos;
+    }
+
+    /* 超出窗口：先写出最早的部分，另一路来不及的位置为静音 */
+    if (pos + n > rec->mix_pos + rec->mix_len) {
+        rec_mix_write(rec, pos + n - rec->mix_len);
+    }
+    for (i = 0; i < n; i++) {
+        rec->mix[(pos - rec->mix_pos + i) * 2 + leg] = pcm[i];
+    }
+}
+
+/**
+ * @brief Write the stereo audio both legs have covered, or that one leg passed LWS_REC_ALIGN_MS ago
+ * @param final Write everything placed (close)
+ */
+static void rec_mix_flush(lws_rec_t* rec, int final)
+{
+    int64_t lo = LWS_MIN(rec->leg[0].end, rec->leg[1].end);
+    int64_t hi = LWS_MAX(rec->leg[0].end, rec->leg[1].end);
+    int64_t wait = (int64_t)rec->sample_rate * LWS_REC_ALIGN_MS / 1000;
+
+    if (final) {
+        rec_mix_write(rec, hi);
+    } else {
+        rec_mix_write(rec, LWS_MAX(lo, hi - wait));
+    }
+}
+
+/**
+ * @brief Hand an encoded packet to the callback at its position
+ */
+static void rec_packet(lws_rec_t* rec, const lws_frame_t* frame)
+{
+    rec_leg_t* l = &rec->leg[0];
+    int64_t resync = (int64_t)rec->sample_rate * LWS_REC_RESYNC_MS / 1000;
+    uint64_t start, elapsed;
+    int64_t pos;
+
+    /* 落在上一个包之前：重复或乱序的包，已写出的部分不能再改 */
+    if (l->started) {
+        int32_t gap = (int32_t)(frame->timestamp - l->next_ts);
+        if (gap < 0 && -gap <= resync) {
+            __atomic_store_n(&rec->late, rec->late + 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    pos = rec_position(rec, l, frame);
+
+    start = now_us();
+    rec->packet(rec->param, frame->data, frame->size, pos, frame->samples);
+    elapsed = now_us() - start;
+    __atomic_store_n(&rec->writes, rec->writes + 1, __ATOMIC_RELAXED);
+    if (elapsed > rec->max_write_us) {
+        __atomic_store_n(&rec->max_write_us, (uint32_t)elapsed, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Append a frame to the batch, writing the batch first when it would overflow
+ */
+static void rec_batch(lws_rec_t* rec, const lws_frame_t* frame, int* fill)
+{
+    int samples = frame->samples;
+
+    if (*fill > 0 && *fill + samples > rec->batch_samples) {
+        rec_write(rec, rec->batch, *fill);
+        *fill = 0;
+    }
+    if (samples > rec->batch_samples) {
+        /* 超过一批的帧直接写 */
+        rec_write(rec, (const int16_t*)frame->data, samples);
+    } else {
+        memcpy(rec->batch + *fill * rec->channels, frame->data,
+               (size_t)samples * rec->channels * sizeof(int16_t));
+        *fill += samples;
+    }
+}
+
+/**
+ * @brief Write every queued frame, merging consecutive frames into batches
+ * @return Frames written
+ */
+static int rec_drain(lws_rec_t* rec)
+{
+    uint32_t tail = rec->tail;
+    uint32_t head = __atomic_load_n(&rec->head, __ATOMIC_ACQUIRE);
+    int fill = 0;
+    int count = 0;
+
+    while (tail != head) {
+        lws_frame_t* frame = rec->slots[tail & rec->mask];
+
+        if (rec->mode == REC_STEREO) {
+            rec_place(rec, rec->legs[tail & rec->mask], frame);
+        } else if (rec->mode == REC_PACKETS) {
+            rec_packet(rec, frame);
+        } else {
+            rec_batch(rec, frame, &fill);
+        }
+        lws_frame_unref(frame);
+
+        /* 帧已复制或写出，槽位交还生产者 */
+        tail++;
+        __atomic_store_n(&rec->tail, tail, __ATOMIC_RELEASE);
+        count++;
+    }
+
+    if (fill > 0) {
+        rec_write(rec, rec->batch, fill);
+    }
+    if (rec->mode == REC_STEREO) {
+        rec_mix_flush(rec, 0);
+    }
+    if (count > 0) {
+        __atomic_store_n(&rec->frames, rec->frames + (uint64_t)count, __ATOMIC_RELAXED);
+    }
+    return count;
+}
+
+static void* rec_writer_loop(void* arg)
+{
+    rec_writer_t* writer = (rec_writer_t*)arg;
+    lws_rec_t* rec;
+    int waited;
+
+    while (!__atomic_load_n(&writer->stop, __ATOMIC_ACQUIRE)) {
+        lws_mutex_lock(&s_rec_mutex);
+        for (rec = s_recs; rec; rec = rec->next) {
+            rec_drain(rec);
+        }
+        lws_mutex_unlock(&s_rec_mutex);
+
+        /* 攒够一个间隔再写，使每次写合并多帧 */
+        for (waited = 0; waited < LWS_REC_INTERVAL_MS &&
+             !__atomic_load_n(&writer->stop, __ATOMIC_ACQUIRE); waited += REC_POLL_MS) {
+            lws_thread_sleep(REC_POLL_MS);
+        }
+    }
+    return NULL;
+}
+
+/* ========================================
+ * Producer / setup
+ * ======================================== */
+
+/**
+ * @brief Allocate a recorder and attach it to the writer thread (started on first use)
+ */
+static lws_rec_t* rec_open(int sample_rate, int channels, rec_mode_t mode, int queue_ms,
+                           lws_rec_write_f write, lws_rec_packet_f packet, void* param)
+{
+    lws_rec_t* rec;
+    uint32_t slots = 2;
+
+    if (sample_rate <= 0 || channels <= 0 || (mode == REC_PACKETS ? !packet : !write)) {
+        return NULL;
+    }
+    if (queue_ms < LWS_REC_MIN_QUEUE_MS) {
+        queue_ms = LWS_REC_MIN_QUEUE_MS;
+    }
+    if (mode == REC_STEREO) {
+        queue_ms *= 2;              /* 两路共用队列 */
+    }
+    while (slots * REC_FRAME_MS < (uint32_t)queue_ms) {
+        slots <<= 1;
+    }
+
+    rec = (lws_rec_t*)lws_calloc(1, sizeof(lws_rec_t));
+    if (!rec) {
+        return NULL;
+    }
+    rec->mask = slots - 1;
+    rec->sample_rate = sample_rate;
+    rec->channels = channels;
+    rec->mode = mode;
+    rec->write = write;
+    rec->packet = packet;
+    rec->param = param;
+    rec->batch_samples = sample_rate * LWS_REC_BATCH_MS / 1000;
+    rec->slots = (lws_frame_t**)lws_calloc(slots, sizeof(lws_frame_t*));
+    if (mode == REC_STEREO) {
+        rec->legs = (uint8_t*)lws_calloc(slots, 1);
+        rec->mix_len = sample_rate * LWS_REC_WINDOW_MS / 1000;
+        rec->mix = (int16_t*)lws_calloc((size_t)rec->mix_len * 2, sizeof(int16_t));
+        if (!rec->legs || !rec->mix) {
+            goto fail;
+        }
+    } else if (mode == REC_MONO) {
+        rec->batch = (int16_t*)lws_malloc((size_t)rec->batch_samples * channels * sizeof(int16_t));
+        if (!rec->batch) {
+            goto fail;
+        }
+    }
+    if (!rec->slots) {
+        goto fail;
+    }
+
+    lws_mutex_lock(&s_rec_mutex);
+    if (!s_writer) {
+        s_writer = (rec_writer_t*)lws_calloc(1, sizeof(rec_writer_t));
+        if (s_writer) {
+            s_writer->thread = lws_thread_create(rec_writer_loop, s_writer);
+            if (!s_writer->thread) {
+                lws_free(s_writer);
+                s_writer = NULL;
+            }
+        }
+        if (!s_writer) {
+            lws_mutex_unlock(&s_rec_mutex);
+            goto fail;
+        }
+    }
+    rec->next = s_recs;
+    s_recs = rec;
+    lws_mutex_unlock(&s_rec_mutex);
+    return rec;
+
+fail:
+    lws_free(rec->slots);
+    lws_free(rec->legs);
+    lws_free(rec->mix);
+    lws_free(rec->batch);
+    lws_free(rec);
+    return NULL;
+}
+
+/**
+ * @brief Producer side of the ring
+ */
+static int rec_enqueue(lws_rec_t* rec, int leg, lws_frame_t* frame)
+{
+    int channels = rec->mode == REC_STEREO ? 1 : rec->channels;
+    uint32_t head;
+    uint32_t queued;
+
+    if (!frame || frame->samples <= 0) {
+        return -1;
+    }
+    if (rec->mode == REC_PACKETS) {
+        if (frame->kind != LWS_FRAME_AUDIO_CODED || frame->size <= 0) {
+            return -1;
+        }
+    } else if (frame->kind != LWS_FRAME_AUDIO ||
+               frame->size < frame->samples * channels * (int)sizeof(int16_t)) {
+        return -1;
+    }
+
+    head = rec->head;
+    queued = head - __atomic_load_n(&rec->tail, __ATOMIC_ACQUIRE);
+    if (queued > rec->mask) {
+        rec->dropped++;
+        return -1;
+    }
+
+    rec->slots[head & rec->mask] = lws_frame_ref(frame);
+    if (rec->mode == REC_STEREO) {
+        rec->legs[head & rec->mask] = (uint8_t)leg;
+    }
+    __atomic_store_n(&rec->head, head + 1, __ATOMIC_RELEASE);
+
+    if (queued + 1 > rec->max_queued) {
+        rec->max_queued = queued + 1;
+    }
+    return 0;
+}
+
+/* ========================================
+ * API
+ * ======================================== */
+
+lws_rec_t* lws_rec_open(int sample_rate, int channels, int queue_ms,
+                        lws_rec_write_f write, void* param)
+{
+    return rec_open(sample_rate, channels, REC_MONO, queue_ms, write, NULL, param);
+}
+
+lws_rec_t* lws_rec_open_stereo(int sample_rate, int queue_ms,
+                               lws_rec_write_f write, void* param)
+{
+    return rec_open(sample_rate, 2, REC_STEREO, queue_ms, write, NULL, param);
+}
+
+lws_rec_t* lws_rec_open_packets(int clock_rate, int queue_ms,
+                                lws_rec_packet_f write, void* param)
+{
+    return rec_open(clock_rate, 1, REC_PACKETS, queue_ms, NULL, write, param);
+}
+
+int lws_rec_push(lws_rec_t* rec, lws_frame_t* frame)
+{
+    if (!rec || rec->mode != REC_MONO) {
+        return -1;
+    }
+    return rec_enqueue(rec, 0, frame);
+}
+
+int lws_rec_push_leg(lws_rec_t* rec, lws_rec_leg_t leg, lws_frame_t* frame)
+{
+    if (!rec || rec->mode != REC_STEREO || (leg != LWS_REC_LOCAL && leg != LWS_REC_REMOTE)) {
+        return -1;
+    }
+    return rec_enqueue(rec, (int)leg, frame);
+}
+
+int lws_rec_push_packet(lws_rec_t* rec, lws_frame_t* frame)
+{
+    if (!rec || rec->mode != REC_PACKETS) {
+        return -1;
+    }
+    return rec_enqueue(rec, 0, frame);
+}
+
+void lws_rec_close(lws_rec_t* rec, lws_rec_stats_t* stats)
+{
+    rec_writer_t* writer = NULL;
+    lws_rec_t** pp;
+
+    if (!rec) {
+        return;
+    }
+
+    lws_mutex_lock(&s_rec_mutex);
+    for (pp = &s_recs; *pp; pp = &(*pp)->next) {
+        if (*pp == rec) {
+            *pp = rec->next;
+            break;
+        }
+    }
+    if (!s_recs) {
+        /* 最后一个录音器：停止写线程 */
+        writer = s_writer;
+        s_writer = NULL;
+    }
+    lws_mutex_unlock(&s_rec_mutex);
+
+    if (writer) {
+        __atomic_store_n(&writer->stop, 1, __ATOMIC_RELEASE);
+        lws_thread_join(writer->thread, NULL);
+        lws_thread_destroy(writer->thread);
+        lws_free(writer);
+    }
+
+    /* 已摘链，写线程不再访问：在调用线程写完剩余帧 */
+    rec_drain(rec);
+    if (rec->mode == REC_STEREO) {
+        rec_mix_flush(rec, 1);
+    }
+    lws_rec_get_stats(rec, stats);
+
+    lws_free(rec->slots);
+    lws_free(rec->legs);
+    lws_free(rec->mix);
+    lws_free(rec->batch);
+    lws_free(rec);
+}
+
+void lws_rec_get_stats(lws_rec_t* rec, lws_rec_stats_t* stats)
+{
+    if (!rec || !stats) {
+        return;
+    }
+    stats->frames = __atomic_load_n(&rec->frames, __ATOMIC_RELAXED);
+    stats->writes = __atomic_load_n(&rec->writes, __ATOMIC_RELAXED);
+    stats->late = __atomic_load_n(&rec->late, __ATOMIC_RELAXED);
+    stats->max_write_us = __atomic_load_n(&rec->max_write_us, __ATOMIC_RELAXED);
+    stats->dropped = rec->dropped;
+    stats->max_queued = rec->max_queued;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file lws_rec.h
+ * @brief Asynchronous recording writer
+ *
+ * Recording must not block the media thread: a file backend may stall for
+ * tens of milliseconds in a muxer write or fsync. The media thread pushes
+ * audio frames by reference into a per-recorder single-producer /
+ * single-consumer ring, and one writer thread shared by every recorder of
+ * the process drains the rings, merging consecutive frames into a single
+ * write call of up to LWS_REC_BATCH_MS.
+ *
+ * The ring is bounded by queue_ms; when the writer falls behind, new
+ * frames are dropped and counted instead of growing memory or blocking the
+ * producer. lws_rec_close() writes whatever is still queued before it
+ * returns (flush on hangup).
+ *
+ * A stereo recorder takes two mono legs, local (left) and remote (right),
+ * and the writer thread aligns them. Each leg is placed on a common
+ * timeline anchored to the wall clock (lws_frame_t.time_us) of the first
+ * frame recorded, rounded to the frame grid. Consecutive frames of a leg follow each other, and
+ * timestamp jumps (lost packets, DTX) leave silence. A leg whose position
+ * drifts from the wall clock by more than LWS_REC_RESYNC_MS is re-anchored.
+ * Audio is written once both legs have covered it, or LWS_REC_ALIGN_MS
+ * after the other leg, so a silent leg (muted capture, no packets) is
+ * written as silence.
+ *
+ * A packet recorder takes encoded audio (RTP payloads) and hands each
+ * packet to its callback unchanged, with a presentation time in clock-rate
+ * units derived the same way from the RTP timestamps: a forward jump is a
+ * gap the backend fills, a packet behind the previous one (duplicate or
+ * reordered) is discarded, and a jump beyond LWS_REC_RESYNC_MS from the
+ * wall clock is re-anchored.
+ */
+
+#ifndef __LWS_REC_H__
+#define __LWS_REC_H__
+
+#include <stdint.h>
+
+#include "lws_graph.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Constants
+ * ======================================== */
+
+#define LWS_REC_INTERVAL_MS     100         /**< Writer thread pass interval */
+#define LWS_REC_BATCH_MS        200         /**< Longest audio handed to one write call */
+#define LWS_REC_MIN_QUEUE_MS    (2 * LWS_REC_INTERVAL_MS) /**< Smallest ring (must outlast a pass) */
+#define LWS_REC_ALIGN_MS        200         /**< Stereo: longest wait for the other leg */
+#define LWS_REC_RESYNC_MS       500         /**< Stereo/packets: timestamp/wall-clock drift before re-anchoring */
+#define LWS_REC_WINDOW_MS       1000        /**< Stereo: alignment window */
+
+/**
+ * @brief Legs of a stereo recording
+ */
+typedef enum {
+    LWS_REC_LOCAL = 0,              /**< Local capture (left channel) */
+    LWS_REC_REMOTE = 1              /**< Received audio (right channel) */
+} lws_rec_leg_t;
+
+/**
+ * @brief Write callback, called on the writer thread
+ * @param param Callback parameter from lws_rec_open()
+ * @param pcm Interleaved 16-bit PCM
+ * @param samples Samples per channel
+ * @return Ignored (errors are the backend's business)
+ */
+typedef int (*lws_rec_write_f)(void* param, const int16_t* pcm, int samples);
+
+/**
+ * @brief Packet write callback, called on the writer thread
+ * @param param Callback parameter from lws_rec_open_packets()
+ * @param data Encoded packet
+ * @param bytes Packet length
+ * @param pts Position of the packet in clock-rate units (0 = first packet)
+ * @param samples Packet duration in clock-rate units
+ * @return Ignored (errors are the backend's business)
+ */
+typedef int (*lws_rec_packet_f)(void* param, const uint8_t* data, int bytes,
+                                int64_t pts, int samples);
+
+/**
+ * @brief Recorder statistics
+ */
+typedef struct {
+    uint64_t frames;                /**< Frames written */
+    uint64_t dropped;               /**< Frames dropped because the ring was full */
+    uint64_t writes;                /**< Write calls (batches) */
+    uint64_t late;                  /**< Stereo/packets: frames behind the written audio (discarded) */
+    uint32_t max_queued;            /**< Highest ring occupancy seen (frames) */
+    uint32_t max_write_us;          /**< Slowest write call (microseconds) */
+} lws_rec_stats_t;
+
+typedef struct lws_rec lws_rec_t;
+
+/* ========================================
+ * API
+ * ======================================== */
+
+/**
+ * @brief Open a recorder and attach it to the shared writer thread
+ *
+ * The ring holds queue_ms of 20 ms frames (at least LWS_REC_MIN_QUEUE_MS).
+ * The writer thread starts with the first recorder and stops with the last.
+ *
+ * @param sample_rate Sample rate of the pushed frames
+ * @param channels Channels of the pushed frames
+ * @param queue_ms Queued audio before frames are dropped
+ * @param write Write callback
+ * @param param Callback parameter
+ * @return Recorder, NULL on invalid arguments or failure
+ */
+lws_rec_t* lws_rec_open(int sample_rate, int channels, int queue_ms,
+                        lws_rec_write_f write, void* param);
+
+/**
+ * @brief Open a two-leg recorder writing interleaved stereo
+ *
+ * Both legs are pushed from the same producer thread; queue_ms applies to
+ * each leg.
+ *
+ * @param sample_rate Sample rate of both legs
+ * @param queue_ms Queued audio per leg before frames are dropped
+ * @param write Write callback, receives stereo samples
+ * @param param Callback parameter
+ * @return Recorder, NULL on invalid arguments or failure
+ */
+lws_rec_t* lws_rec_open_stereo(int sample_rate, int queue_ms,
+                               lws_rec_write_f write, void* param);
+
+/**
+ * @brief Open a recorder of encoded audio packets
+ *
+ * @param clock_rate RTP clock rate of the packets
+ * @param queue_ms Queued audio before packets are dropped
+ * @param write Packet callback
+ * @param param Callback parameter
+ * @return Recorder, NULL on invalid arguments or failure
+ */
+lws_rec_t* lws_rec_open_packets(int clock_rate, int queue_ms,
+                                lws_rec_packet_f write, void* param);
+
+/**
+ * @brief Queue an audio frame (producer thread only)
+ *
+ * Takes a reference; the frame must not be modified afterwards.
+ *
+ * @return 0 queued, -1 ring full (frame dropped) or invalid frame
+ */
+int lws_rec_push(lws_rec_t* rec, lws_frame_t* frame);
+
+/**
+ * @brief Queue a mono frame of one leg of a stereo recorder (producer thread only)
+ *
+ * time_us and timestamp (in samples) of the frame place it on the timeline.
+ *
+ * @return 0 queued, -1 ring full (frame dropped), not a stereo recorder or invalid frame
+ */
+int lws_rec_push_leg(lws_rec_t* rec, lws_rec_leg_t leg, lws_frame_t* frame);
+
+/**
+ * @brief Queue an encoded packet of a packet recorder (producer thread only)
+ *
+ * The frame is of kind LWS_FRAME_AUDIO_CODED; timestamp is the RTP
+ * timestamp, samples the packet duration and time_us the arrival time.
+ *
+ * @return 0 queued, -1 ring full (packet dropped), not a packet recorder or invalid frame
+ */
+int lws_rec_push_packet(lws_rec_t* rec, lws_frame_t* frame);
+
+/**
+ * @brief Detach from the writer thread, write the remaining frames and free
+ *
+ * Runs the final writes on the calling thread.
+ *
+ * @param rec Recorder (may be NULL)
+ * @param stats Final statistics, including the flushed frames (may be NULL)
+ */
+void lws_rec_close(lws_rec_t* rec, lws_rec_stats_t* stats);
+
+/**
+ * @brief Statistics (callable from the producer thread while recording)
+ */
+void lws_rec_get_stats(lws_rec_t* rec, lws_rec_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_REC_H__ */
@@ -0,0 +1,385 @@
+/**
+ * @file lws_red.c
+ * @brief Redundant audio data (RFC 2198) implementation
+ *
+ * RED包格式 (RFC 2198 §3)：
+ *   RTP头（PT为RED） | 冗余块头 x n（F=1，PT，14位时间戳偏移，10位长度）
+ *   | 主块头（F=0，PT） | 冗余块数据（最旧在前） | 主块数据
+ *
+ * 冗余级别按RTCP接收报告的丢包率调整：丢包增加时立即升到目标级别，
+ * 减少时每个报告只降一级，避免在突发丢包间隙过早撤掉冗余。
+ */
+
+#include <string.h>
+
+#include "lws_red.h"
+
+#define RTP_HEADER_SIZE     12
+
+#define RTCP_SR             200
+#define RTCP_RR             201
+#define RTCP_REPORT_BLOCK   24
+
+/* 接收时解析的最大冗余块数（对端的级别可能高于本端） */
+#define RED_MAX_BLOCKS      16
+
+/* ========================================
+ * Helpers
+ * ======================================== */
+
+static uint16_t get_u16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get_u32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_u16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+/**
+ * @brief Offset of the RTP payload (after CSRCs and header extension)
+ * @return Offset, -1 on malformed header
+ */
+static int payload_offset(const uint8_t* packet, int bytes)
+{
+    int offset;
+
+    if (bytes < RTP_HEADER_SIZE || (packet[0] & 0xc0) != 0x80) {
+        return -1;
+    }
+    offset = RTP_HEADER_SIZE + (packet[0] & 0x0f) * 4;
+    if ((packet[0] & 0x10) && offset + 4 <= bytes) {
+        offset += 4 + get_u16(packet + offset + 2) * 4;
+    }
+    return offset <= bytes ? offset : -1;
+}
+
+/* ========================================
+ * Sender
+ * ======================================== */
+
+void lws_red_sender_init(lws_red_sender_t* sender, int pt, int max_level)
+{
+    memset(sender, 0, sizeof(*sender));
+    sender->pt = pt;
+    sender->max_level = max_level < 0 ? 0 :
+                        max_level > LWS_RED_MAX_LEVEL ? LWS_RED_MAX_LEVEL : max_level;
+    /* 收到第一个接收报告前先带一帧冗余 */
+    sender->level = sender->max_level > 0 ? 1 : 0;
+    sender->head = LWS_RED_MAX_LEVEL - 1;
+}
+
+void lws_red_sender_reset(lws_red_sender_t* sender)
+{
+    sender->count = 0;
+}
+
+static void history_store(lws_red_sender_t* sender, int pt, uint16_t seq,
+                          uint32_t timestamp, const uint8_t* data, int len)
+{
+    lws_red_block_t* b;
+
+    if (len > LWS_RED_MAX_BLOCK) {
+        /* 无法重复的帧打断序号连续性 */
+        sender->count = 0;
+        return;
+    }
+    sender->head = (sender->head + 1) % LWS_RED_MAX_LEVEL;
+    b = &sender->history[sender->head];
+    b->len = len;
+    b->pt = pt;
+    b->seq = seq;
+    b->timestamp = timestamp;
+    memcpy(b->data, data, len);
+    if (sender->count < LWS_RED_MAX_LEVEL) {
+        sender->count++;
+    }
+}
+
+int lws_red_encode(lws_red_sender_t* sender, const uint8_t* packet, int bytes,
+                   uint8_t* out, int size)
+{
+    const lws_red_block_t* blocks[LWS_RED_MAX_LEVEL];
+    int offset = payload_offset(packet, bytes);
+    uint16_t seq;
+    uint32_t timestamp;
+    int len, total, pos, n, i;
+
+    if (offset < 0 || (packet[0] & 0x20)) {
+        sender->count = 0;
+        return 0;
+    }
+    seq = get_u16(packet + 2);
+    timestamp = get_u32(packet + 4);
+    len = bytes - offset;
+
+    /* 紧邻的历史帧（最新在前）：序号连续且时间戳偏移可用14位表示 */
+    n = 0;
+    for (i = 0; sender->pt >= 0 && i < sender->count && n < sender->level; i++) {
+        const lws_red_block_t* b =
+            &sender->history[(sender->head - i + LWS_RED_MAX_LEVEL) % LWS_RED_MAX_LEVEL];
+        uint32_t ts_offset = timestamp - b->timestamp;
+        if (b->seq != (uint16_t)(seq - 1 - i) || ts_offset == 0 ||
+            ts_offset > LWS_RED_MAX_TS_OFFSET) {
+            break;
+        }
+        blocks[n++] = b;
+    }
+
+    /* 放不下时先舍弃最旧的冗余块 */
+    for (;;) {
+        total = offset + n * 4 + 1 + len;
+        for (i = 0; i < n; i++) {
+            total += blocks[i]->len;
+        }
+        if (n == 0 || total <= size) {
+            break;
+        }
+        n--;
+    }
+
+    pos = 0;
+    if (n > 0) {
+        memcpy(out, packet, offset);
+        out[1] = (uint8_t)((packet[1] & 0x80) | (sender->pt & 0x7f));
+        pos = offset;
+        for (i = n - 1; i >= 0; i--) {
+            uint32_t ts_offset = timestamp - blocks[i]->timestamp;
+            out[pos] = (uint8_t)(0x80 | blocks[i]->pt);
+            out[pos + 1] = (uint8_t)(ts_offset >> 6);
+            out[pos + 2] = (uint8_t)(((ts_offset & 0x3f) << 2) | (blocks[i]->len >> 8));
+            out[pos + 3] = (uint8_t)blocks[i]->len;
+            pos += 4;
+        }
+        out[pos++] = packet[1] & 0x7f;
+        for (i = n - 1; i >= 0; i--) {
+            memcpy(out + pos, blocks[i]->data, blocks[i]->len);
+            pos += blocks[i]->len;
+            sender->redundant_bytes += blocks[i]->len;
+        }
+        memcpy(out + pos, packet + offset, len);
+        pos += len;
+        sender->packets++;
+    }
+
+    /* 最后入历史：blocks指向环中的槽 */
+    history_store(sender, packet[1] & 0x7f, seq, timestamp, packet + offset, len);
+    return pos;
+}
+
+void lws_red_adapt(lws_red_sender_t* sender, int fraction_lost)
+{
+    int target;
+
+    if (fraction_lost >= 26) {              /* >= 10% */
+        target = 3;
+    } else if (fraction_lost >= 8) {        /* >= 3% */
+        target = 2;
+    } else if (fraction_lost >= 3) {        /* >= 1% */
+        target = 1;
+    } else {
+        target = 0;
+    }
+    if (target > sender->max_level) {
+        target = sender->max_level;
+    }
+
+    if (target > sender->level) {
+        sender->level = target;
+    } else if (target < sender->level) {
+        sender->level--;
+    }
+}
+
+int lws_red_rtcp_loss(const uint8_t* rtcp, int bytes, uint32_t ssrc)
+{
+    while (bytes >= 8) {
+        int count = rtcp[0] & 0x1f;
+        int pt = rtcp[1];
+        int len = (get_u16(rtcp + 2) + 1) * 4;
+        int pos;
+        int i;
+
+        if ((rtcp[0] & 0xc0) != 0x80 || len > bytes) {
+            break;
+        }
+
+        pos = pt == RTCP_SR ? 28 : pt == RTCP_RR ? 8 : len;
+        for (i = 0; i < count && pos + RTCP_REPORT_BLOCK <= len; i++) {
+            if (get_u32(rtcp + pos) == ssrc) {
+                return rtcp[pos + 4];
+            }
+            pos += RTCP_REPORT_BLOCK;
+        }
+
+        rtcp += len;
+        bytes -= len;
+    }
+    return -1;
+}
+
+/* ========================================
+ * Receiver
+ * ======================================== */
+
+void lws_red_receiver_init(lws_red_receiver_t* receiver, int pt,
+                           lws_red_deliver_f deliver, void* param)
+{
+    memset(receiver, 0, sizeof(*receiver));
+    receiver->pt = pt;
+    receiver->deliver = deliver;
+    receiver->param = param;
+}
+
+void lws_red_receiver_reset(lws_red_receiver_t* receiver)
+{
+    receiver->started = 0;
+    receiver->seen = 0;
+}
+
+/**
+ * @brief Whether a sequence number was already delivered
+ */
+static int seq_seen(const lws_red_receiver_t* receiver, uint16_t seq)
+{
+    int16_t d = (int16_t)(seq - receiver->max_seq);
+
+    if (!receiver->started || d > 0 || d <= -64) {
+        return 0;
+    }
+    return (receiver->seen >> -d) & 1;
+}
+
+static void seq_mark(lws_red_receiver_t* receiver, uint16_t seq)
+{
+    int16_t d = (int16_t)(seq - receiver->max_seq);
+
+    if (!receiver->started || d <= -64) {
+        /* 首个包或序号大跳变（对端重启了流） */
+        receiver->started = 1;
+        receiver->max_seq = seq;
+        receiver->seen = 1;
+    } else if (d > 0) {
+        receiver->seen = d >= 64 ? 0 : receiver->seen << d;
+        receiver->seen |= 1;
+        receiver->max_seq = seq;
+    } else {
+        receiver->seen |= (uint64_t)1 << -d;
+    }
+}
+
+/**
+ * @brief Rebuild a plain RTP packet from one block and deliver it
+ */
+static void deliver_block(lws_red_receiver_t* receiver, const uint8_t* packet, int header,
+                          int marker, int pt, uint16_t seq, uint32_t timestamp,
+                          const uint8_t* data, int len)
+{
+    uint8_t buf[LWS_RED_MAX_PACKET];
+
+    if (header + len > (int)sizeof(buf)) {
+        return;
+    }
+    memcpy(buf, packet, header);
+    buf[0] &= ~0x30;                        /* 不带填充与头扩展 */
+    buf[1] = (uint8_t)((marker ? 0x80 : 0x00) | pt);
+    put_u16(buf + 2, seq);
+    put_u32(buf + 4, timestamp);
+    memcpy(buf + header, data, len);
+
+    seq_mark(receiver, seq);
+    receiver->deliver(receiver->param, buf, header + len);
+}
+
+int lws_red_receive(lws_red_receiver_t* receiver, const uint8_t* packet, int bytes)
+{
+    int offset = payload_offset(packet, bytes);
+    int header;
+    int pts[RED_MAX_BLOCKS];
+    int lens[RED_MAX_BLOCKS];
+    uint32_t ts_offsets[RED_MAX_BLOCKS];
+    uint16_t seq;
+    uint32_t timestamp;
+    int end, pos, data, n, primary_pt, i;
+
+    if (offset < 0) {
+        return -1;
+    }
+    header = RTP_HEADER_SIZE + (packet[0] & 0x0f) * 4;
+    seq = get_u16(packet + 2);
+
+    if (receiver->pt < 0 || (packet[1] & 0x7f) != receiver->pt) {
+        if (!seq_seen(receiver, seq)) {
+            seq_mark(receiver, seq);
+            receiver->deliver(receiver->param, packet, bytes);
+        }
+        return 0;
+    }
+
+    end = bytes;
+    if (packet[0] & 0x20) {
+        end -= packet[bytes - 1];
+    }
+
+    /* 块头 */
+    n = 0;
+    pos = offset;
+    while (pos < end && (packet[pos] & 0x80)) {
+        if (n == RED_MAX_BLOCKS || pos + 4 > end) {
+            return -1;
+        }
+        pts[n] = packet[pos] & 0x7f;
+        ts_offsets[n] = ((uint32_t)packet[pos + 1] << 6) | (packet[pos + 2] >> 2);
+        lens[n] = ((packet[pos + 2] & 0x03) << 8) | packet[pos + 3];
+        n++;
+        pos += 4;
+    }
+    if (pos >= end) {
+        return -1;                          /* 缺少主块头（含填充长度错误） */
+    }
+    primary_pt = packet[pos++] & 0x7f;
+
+    data = pos;
+    for (i = 0; i < n; i++) {
+        data += lens[i];
+    }
+    if (data > end) {
+        return -1;
+    }
+    receiver->packets++;
+    timestamp = get_u32(packet + 4);
+
+    /* 冗余块：第i块（共n块，最旧在前）的序号为seq - (n - i) */
+    data = pos;
+    for (i = 0; i < n; i++) {
+        uint16_t block_seq = (uint16_t)(seq - (n - i));
+        if (receiver->started && lens[i] > 0 &&
+            (int16_t)(block_seq - receiver->max_seq) > 0) {
+            deliver_block(receiver, packet, header, 0, pts[i], block_seq,
+                          timestamp - ts_offsets[i], packet + data, lens[i]);
+            receiver->recovered++;
+        }
+        data += lens[i];
+    }
+
+    if (!seq_seen(receiver, seq)) {
+        deliver_block(receiver, packet, header, packet[1] & 0x80, primary_pt, seq,
+                      timestamp, packet + data, end - data);
+    }
+    return 0;
+}
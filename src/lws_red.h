@@ -0,0 +1,161 @@
+/**
+ * @file lws_red.h
+ * @brief Redundant audio data (RFC 2198) with loss-driven redundancy level
+ *
+ * The sender keeps the last LWS_RED_MAX_LEVEL encoded frames and wraps each
+ * new frame in a RED packet that repeats the frames before it, so a burst
+ * of up to `level` lost packets is rebuilt from the next one that arrives.
+ * The level follows the fraction lost the peer reports in RTCP receiver
+ * reports: it rises at once when loss grows and falls one step per report.
+ * At level 0 frames go out unwrapped, with the primary payload type.
+ *
+ * Redundant blocks carry no sequence number. The sender only repeats the
+ * packets immediately before the current one (any other packet in the
+ * sequence space, such as telephone-event or CN, restarts the history), so
+ * the receiver numbers the i-th of n blocks seq - (n - i). Missing packets
+ * are rebuilt as plain RTP packets and delivered, oldest first, ahead of
+ * the primary frame; duplicates are dropped.
+ */
+
+#ifndef __LWS_RED_H__
+#define __LWS_RED_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Constants
+ * ======================================== */
+
+#define LWS_RED_MAX_LEVEL       3           /**< Redundant blocks per packet */
+#define LWS_RED_MAX_BLOCK       512         /**< Largest frame kept for redundancy */
+#define LWS_RED_MAX_PACKET      1500        /**< Largest RED packet built or parsed */
+#define LWS_RED_MAX_TS_OFFSET   0x3fff      /**< 14-bit timestamp offset (RFC 2198 §3) */
+
+/**
+ * @brief Encoded frame kept for redundancy
+ */
+typedef struct {
+    int len;                        /**< Payload bytes, 0 = empty */
+    int pt;                         /**< Payload type of the frame */
+    uint16_t seq;
+    uint32_t timestamp;
+    uint8_t data[LWS_RED_MAX_BLOCK];
+} lws_red_block_t;
+
+/* ========================================
+ * Sender
+ * ======================================== */
+
+/**
+ * @brief Sender state
+ */
+typedef struct {
+    int pt;                         /**< RED payload type, -1 = not negotiated */
+    int max_level;                  /**< Configured upper bound (<= LWS_RED_MAX_LEVEL) */
+    int level;                      /**< Redundant blocks currently sent */
+    lws_red_block_t history[LWS_RED_MAX_LEVEL]; /**< Ring of previous frames */
+    int head;                       /**< Slot of the newest frame */
+    int count;                      /**< Frames in the ring */
+
+    /* Counters */
+    uint64_t packets;               /**< RED packets built */
+    uint64_t redundant_bytes;       /**< Bytes of redundant blocks sent */
+} lws_red_sender_t;
+
+/**
+ * @brief Initialize a sender
+ * @param pt RED payload type, -1 to send every frame unwrapped
+ * @param max_level Largest redundancy level the loss may select
+ */
+void lws_red_sender_init(lws_red_sender_t* sender, int pt, int max_level);
+
+/**
+ * @brief Forget the previous frames (sequence space used by another format)
+ */
+void lws_red_sender_reset(lws_red_sender_t* sender);
+
+/**
+ * @brief Store a frame and wrap it with the previous ones
+ *
+ * @param packet RTP packet carrying the primary frame
+ * @param out Output RED packet (same SSRC, sequence number and timestamp)
+ * @param size Output buffer size
+ * @return RED packet bytes, 0 to send the packet unwrapped (level 0, no
+ * previous frame, or a malformed packet)
+ */
+int lws_red_encode(lws_red_sender_t* sender, const uint8_t* packet, int bytes,
+                   uint8_t* out, int size);
+
+/**
+ * @brief Pick the redundancy level for a reported fraction lost
+ * @param fraction_lost RTCP report block fraction lost (x/256)
+ */
+void lws_red_adapt(lws_red_sender_t* sender, int fraction_lost);
+
+/**
+ * @brief Fraction lost the peer reports for one of our SSRCs
+ *
+ * Looks for a report block about ssrc in the SR/RR packets of a compound
+ * RTCP packet.
+ *
+ * @return Fraction lost (0-255), -1 if no report block names ssrc
+ */
+int lws_red_rtcp_loss(const uint8_t* rtcp, int bytes, uint32_t ssrc);
+
+/* ========================================
+ * Receiver
+ * ======================================== */
+
+/**
+ * @brief Plain RTP packet for the depacketizer
+ */
+typedef void (*lws_red_deliver_f)(void* param, const uint8_t* packet, int bytes);
+
+/**
+ * @brief Receiver state
+ */
+typedef struct {
+    int pt;                         /**< RED payload type, -1 = not negotiated */
+    int started;                    /**< max_seq is valid */
+    uint16_t max_seq;               /**< Highest sequence number delivered */
+    uint64_t seen;                  /**< Bit i: max_seq - i was delivered */
+
+    lws_red_deliver_f deliver;
+    void* param;
+
+    /* Counters */
+    uint64_t packets;               /**< RED packets received */
+    uint64_t recovered;             /**< Missing packets rebuilt from redundant blocks */
+} lws_red_receiver_t;
+
+/**
+ * @brief Initialize a receiver
+ * @param pt RED payload type, -1 to pass every packet through
+ */
+void lws_red_receiver_init(lws_red_receiver_t* receiver, int pt,
+                           lws_red_deliver_f deliver, void* param);
+
+/**
+ * @brief Restart sequence tracking (new remote SSRC)
+ */
+void lws_red_receiver_reset(lws_red_receiver_t* receiver);
+
+/**
+ * @brief Feed a received audio RTP packet (RED or primary format)
+ *
+ * RED packets are split into plain RTP packets; frames already delivered
+ * are dropped.
+ *
+ * @return 0 on success, -1 on malformed RED packet
+ */
+int lws_red_receive(lws_red_receiver_t* receiver, const uint8_t* packet, int bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_RED_H__ */
@@ -0,0 +1,594 @@
+/**
+ * @file lws_rtx.c
+ * @brief Video loss recovery and send pacing implementation
+ *
+ * 发送端：
+ * - 历史环按序号索引（seq & (count-1)），同时作为发送平滑(pacing)队列：
+ *   [send_seq, next_seq) 为尚未发出的包，无需额外拷贝
+ * - 漏桶：每帧入队后按 队列字节数/排空时间 设定速率，预算上限为
+ *   LWS_RTX_BURST_US的数据量，重传包立即发送但同样消耗预算
+ * - NACK按历史环应答；协商了RTX时以独立SSRC/PT发送 (RFC 4588 §4)
+ *
+ * 接收端：
+ * - 重排序环：缺失的序号立即NACK，LWS_RTX_NACK_RETRY_US后重发请求，
+ *   超过wait_us仍未到达则放弃，之后的包按序交付
+ */
+
+#include <string.h>
+
+#include "lws_rtx.h"
+#include "lws_mem.h"
+
+#define RTP_HEADER_SIZE     12
+
+#define RTCP_RR             201
+#define RTCP_RTPFB          205     /* Transport layer feedback (RFC 4585 §6.2) */
+#define RTCP_PSFB           206     /* Payload-specific feedback (RFC 4585 §6.3) */
+#define RTCP_FMT_NACK       1
+#define RTCP_FMT_PLI        1
+#define RTCP_FMT_FIR        4
+
+/* ========================================
+ * Helpers
+ * ======================================== */
+
+static uint16_t get_u16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get_u32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_u16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put_u32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+/**
+ * @brief Offset of the RTP payload (after CSRCs and header extension)
+ * @return Offset, -1 on malformed header
+ */
+static int payload_offset(const uint8_t* packet, int bytes)
+{
+    int offset;
+
+    if (bytes < RTP_HEADER_SIZE || (packet[0] & 0xc0) != 0x80) {
+        return -1;
+    }
+    offset = RTP_HEADER_SIZE + (packet[0] & 0x0f) * 4;
+    if ((packet[0] & 0x10) && offset + 4 <= bytes) {
+        offset += 4 + get_u16(packet + offset + 2) * 4;
+    }
+    return offset <= bytes ? offset : -1;
+}
+
+static int ring_size(int count)
+{
+    int n = 1;
+    while (n < count) {
+        n <<= 1;
+    }
+    return n;
+}
+
+static lws_rtx_slot_t* ring_alloc(int count)
+{
+    lws_rtx_slot_t* slots = (lws_rtx_slot_t*)lws_malloc(sizeof(lws_rtx_slot_t) * count);
+    if (slots) {
+        memset(slots, 0, sizeof(lws_rtx_slot_t) * count);
+    }
+    return slots;
+}
+
+/**
+ * @brief Empty receiver report opening a compound packet (RFC 3550 §6.1)
+ */
+static int rr_write(uint32_t ssrc, uint8_t* rtcp, int size)
+{
+    if (size < 8) {
+        return -1;
+    }
+    rtcp[0] = 0x80;
+    rtcp[1] = RTCP_RR;
+    put_u16(rtcp + 2, 1);
+    put_u32(rtcp + 4, ssrc);
+    return 8;
+}
+
+/* ========================================
+ * Sender
+ * ======================================== */
+
+int lws_rtx_sender_init(lws_rtx_sender_t* sender, int count, uint32_t ssrc,
+                        lws_rtx_send_f send, void* param)
+{
+    memset(sender, 0, sizeof(*sender));
+    sender->count = ring_size(count);
+    sender->slots = ring_alloc(sender->count);
+    if (!sender->slots) {
+        return -1;
+    }
+    sender->ssrc = ssrc;
+    sender->rtx_pt = -1;
+    sender->fir_seq = -1;
+    sender->send = send;
+    sender->param = param;
+    return 0;
+}
+
+void lws_rtx_sender_free(lws_rtx_sender_t* sender)
+{
+    if (sender->slots) {
+        lws_free(sender->slots);
+        sender->slots = NULL;
+    }
+}
+
+void lws_rtx_sender_set_rtx(lws_rtx_sender_t* sender, int pt, uint32_t ssrc, uint16_t seq)
+{
+    sender->rtx_pt = pt;
+    sender->rtx_ssrc = ssrc;
+    sender->rtx_seq = seq;
+}
+
+/**
+ * @brief Send the head of the pacer queue
+ */
+static void pacer_send_one(lws_rtx_sender_t* s, uint64_t now)
+{
+    lws_rtx_slot_t* slot = &s->slots[s->send_seq & (s->count - 1)];
+    uint32_t delay = (uint32_t)(now - slot->since_us);
+
+    s->send(s->param, slot->data, slot->len);
+    s->send_seq++;
+    s->queued_bytes -= slot->len;
+    s->budget -= slot->len;
+
+    s->paced++;
+    s->delay_total_us += delay;
+    if (delay > s->delay_max_us) {
+        s->delay_max_us = delay;
+    }
+}
+
+int lws_rtx_enqueue(lws_rtx_sender_t* sender, const uint8_t* packet, int bytes,
+                    uint64_t now)
+{
+    lws_rtx_slot_t* slot;
+    uint16_t seq;
+
+    if (bytes > LWS_RTX_MAX_PACKET || payload_offset(packet, bytes) < 0) {
+        return -1;
+    }
+    seq = get_u16(packet + 2);
+
+    /* 序号不连续（打包器重建等）：先发完旧队列再重新开始 */
+    if (sender->started && seq != sender->next_seq) {
+        while (sender->send_seq != sender->next_seq) {
+            pacer_send_one(sender, now);
+        }
+        sender->started = 0;
+    }
+    if (!sender->started) {
+        sender->started = 1;
+        sender->next_seq = seq;
+        sender->send_seq = seq;
+    }
+
+    /* 队列已满：最早的包立即发出，腾出槽位 */
+    if ((uint16_t)(sender->next_seq - sender->send_seq) >= (uint16_t)sender->count) {
+        pacer_send_one(sender, now);
+    }
+
+    slot = &sender->slots[seq & (sender->count - 1)];
+    memcpy(slot->data, packet, bytes);
+    slot->len = bytes;
+    slot->seq = seq;
+    slot->count = 0;
+    slot->since_us = now;
+    slot->last_us = 0;
+
+    sender->next_seq++;
+    sender->queued_bytes += bytes;
+    return 0;
+}
+
+void lws_rtx_pace_frame(lws_rtx_sender_t* sender, uint64_t drain_us)
+{
+    /* 上一帧的欠账不带入新帧 */
+    if (sender->budget < 0) {
+        sender->budget = 0;
+    }
+    if (drain_us == 0 || sender->queued_bytes == 0) {
+        sender->rate = 0;
+        return;
+    }
+    sender->rate = (int)((uint64_t)sender->queued_bytes * 1000000ULL / drain_us);
+    if (sender->rate < 1) {
+        sender->rate = 1;
+    }
+}
+
+int lws_rtx_pace(lws_rtx_sender_t* sender, uint64_t now)
+{
+    int sent = 0;
+
+    if (sender->last_us == 0 || now < sender->last_us || sender->rate == 0) {
+        sender->last_us = now;
+    } else {
+        /* 按整字节累加预算，时间只推进已折算的部分，慢速率下不丢余数 */
+        int64_t cap = (int64_t)sender->rate * LWS_RTX_BURST_US / 1000000;
+        uint64_t add = (now - sender->last_us) * (uint64_t)sender->rate / 1000000;
+
+        if (cap < LWS_RTX_MAX_PACKET) {
+            cap = LWS_RTX_MAX_PACKET;
+        }
+        sender->budget += (int64_t)add;
+        sender->last_us += add * 1000000 / (uint64_t)sender->rate;
+        if (sender->budget > cap) {
+            sender->budget = cap;
+            sender->last_us = now;
+        }
+    }
+
+    /* 预算非负即可发送一个包，发送后预算可为负（漏桶） */
+    while (sender->send_seq != sender->next_seq &&
+           (sender->rate == 0 || sender->budget >= 0)) {
+        pacer_send_one(sender, now);
+        sent++;
+    }
+    if (sender->rate == 0) {
+        sender->budget = 0;
+    }
+    return sent;
+}
+
+/**
+ * @brief Retransmit one packet of the history
+ */
+static void retransmit(lws_rtx_sender_t* s, uint16_t seq, uint64_t now)
+{
+    lws_rtx_slot_t* slot = &s->slots[seq & (s->count - 1)];
+    int offset;
+
+    s->nacks++;
+
+    /* 已被覆盖、尚在队列中未发出、或刚重传过 */
+    if (slot->len == 0 || slot->seq != seq ||
+        (uint16_t)(seq - s->send_seq) < 0x8000 ||
+        (slot->last_us != 0 && now - slot->last_us < LWS_RTX_MIN_INTERVAL_US)) {
+        return;
+    }
+    slot->last_us = now;
+    slot->count++;
+
+    if (s->rtx_pt < 0) {
+        s->send(s->param, slot->data, slot->len);
+    } else {
+        /* RTX: 原RTP头（换PT/序号/SSRC）+ 2字节原序号(OSN) + 原载荷 */
+        offset = payload_offset(slot->data, slot->len);
+        memcpy(s->packet, slot->data, offset);
+        s->packet[1] = (uint8_t)((slot->data[1] & 0x80) | s->rtx_pt);
+        put_u16(s->packet + 2, s->rtx_seq++);
+        put_u32(s->packet + 8, s->rtx_ssrc);
+        put_u16(s->packet + offset, seq);
+        memcpy(s->packet + offset + 2, slot->data + offset, slot->len - offset);
+        s->send(s->param, s->packet, slot->len + 2);
+    }
+
+    s->retransmits++;
+    s->budget -= slot->len;
+}
+
+int lws_rtx_feedback(lws_rtx_sender_t* sender, const uint8_t* rtcp, int bytes,
+                     uint64_t now)
+{
+    int result = 0;
+
+    while (bytes >= 4) {
+        int fmt = rtcp[0] & 0x1f;
+        int pt = rtcp[1];
+        int len = (get_u16(rtcp + 2) + 1) * 4;
+        int i;
+
+        if ((rtcp[0] & 0xc0) != 0x80 || len > bytes) {
+            break;
+        }
+
+        if (pt == RTCP_RTPFB && fmt == RTCP_FMT_NACK && len >= 12 &&
+            get_u32(rtcp + 8) == sender->ssrc) {
+            /* FCI: PID + BLP（PID之后16个包的位图） */
+            for (i = 12; i + 4 <= len; i += 4) {
+                uint16_t pid = get_u16(rtcp + i);
+                uint16_t blp = get_u16(rtcp + i + 2);
+                int bit;
+                retransmit(sender, pid, now);
+                for (bit = 0; bit < 16; bit++) {
+                    if (blp & (1 << bit)) {
+                        retransmit(sender, (uint16_t)(pid + bit + 1), now);
+                    }
+                }
+            }
+        } else if (pt == RTCP_PSFB && fmt == RTCP_FMT_PLI && len >= 12 &&
+                   get_u32(rtcp + 8) == sender->ssrc) {
+            result |= LWS_RTX_KEYFRAME;
+        } else if (pt == RTCP_PSFB && fmt == RTCP_FMT_FIR) {
+            /* FCI: SSRC + 命令序号；相同序号为重发的请求，不再响应 */
+            for (i = 12; i + 8 <= len; i += 8) {
+                if (get_u32(rtcp + i) == sender->ssrc && rtcp[i + 4] != sender->fir_seq) {
+                    sender->fir_seq = rtcp[i + 4];
+                    result |= LWS_RTX_KEYFRAME;
+                }
+            }
+        }
+
+        rtcp += len;
+        bytes -= len;
+    }
+
+    if (result & LWS_RTX_KEYFRAME) {
+        sender->keyframe_requests++;
+    }
+    return result;
+}
+
+/* ========================================
+ * Receiver
+ * ======================================== */
+
+int lws_rtx_receiver_init(lws_rtx_receiver_t* receiver, int count, uint32_t ssrc,
+                          lws_rtx_deliver_f deliver, void* param)
+{
+    memset(receiver, 0, sizeof(*receiver));
+    receiver->count = ring_size(count);
+    receiver->slots = ring_alloc(receiver->count);
+    if (!receiver->slots) {
+        return -1;
+    }
+    receiver->ssrc = ssrc;
+    receiver->rtx_pt = -1;
+    receiver->wait_us = LWS_RTX_REORDER_US;
+    receiver->deliver = deliver;
+    receiver->param = param;
+    return 0;
+}
+
+void lws_rtx_receiver_free(lws_rtx_receiver_t* receiver)
+{
+    if (receiver->slots) {
+        lws_free(receiver->slots);
+        receiver->slots = NULL;
+    }
+}
+
+/**
+ * @brief Release packets in order from next_seq
+ * @param skip Give up on a missing head packet (once)
+ */
+static void receiver_release(lws_rtx_receiver_t* r, int skip)
+{
+    while (r->next_seq != r->end_seq) {
+        lws_rtx_slot_t* slot = &r->slots[r->next_seq & (r->count - 1)];
+
+        if (slot->len == 0) {
+            if (!skip) {
+                break;
+            }
+            r->lost++;
+        } else {
+            r->deliver(r->param, slot->data, slot->len);
+            slot->len = 0;
+            skip = 0;
+        }
+        r->next_seq++;
+    }
+}
+
+/**
+ * @brief Turn an RTX packet back into the original packet (RFC 4588 §4)
+ * @return New length, -1 on malformed packet
+ */
+static int rtx_unwrap(lws_rtx_receiver_t* r, uint8_t* packet, int bytes)
+{
+    int offset = payload_offset(packet, bytes);
+
+    if (offset < 0 || bytes - offset < 2) {
+        return -1;
+    }
+    packet[1] = (uint8_t)((packet[1] & 0x80) | r->apt);
+    memcpy(packet + 2, packet + offset, 2);
+    put_u32(packet + 8, r->media_ssrc);
+    memmove(packet + offset, packet + offset + 2, bytes - offset - 2);
+    return bytes - 2;
+}
+
+int lws_rtx_receive(lws_rtx_receiver_t* receiver, uint8_t* packet, int bytes,
+                    uint64_t now)
+{
+    lws_rtx_receiver_t* r = receiver;
+    lws_rtx_slot_t* slot;
+    uint16_t seq;
+    uint32_t ssrc;
+
+    if (bytes > LWS_RTX_MAX_PACKET || payload_offset(packet, bytes) < 0) {
+        return -1;
+    }
+
+    if (r->rtx_pt >= 0 && (packet[1] & 0x7f) == r->rtx_pt) {
+        /* 尚未收到媒体流时无法还原SSRC，丢弃；空RTX包为带宽探测填充 */
+        if (!r->started) {
+            return 0;
+        }
+        bytes = rtx_unwrap(r, packet, bytes);
+        if (bytes < 0) {
+            return -1;
+        }
+    } else {
+        ssrc = get_u32(packet + 8);
+        if (ssrc != r->media_ssrc) {
+            /* 新的媒体流：按序交付已收到的包，重新开始 */
+            if (r->started) {
+                while (r->next_seq != r->end_seq) {
+                    receiver_release(r, 1);
+                }
+            }
+            r->media_ssrc = ssrc;
+            r->started = 0;
+        }
+    }
+
+    seq = get_u16(packet + 2);
+    if (!r->started) {
+        r->started = 1;
+        r->next_seq = seq;
+        r->end_seq = seq;
+    }
+
+    /* 早于交付位置：迟到或重复 */
+    if ((uint16_t)(seq - r->next_seq) >= 0x8000) {
+        return 0;
+    }
+
+    /* 超出窗口：放弃最早的缺口，直到新包能放入 */
+    while ((uint16_t)(seq - r->next_seq) >= (uint16_t)r->count) {
+        receiver_release(r, 1);
+        if (r->next_seq == r->end_seq) {
+            r->next_seq = seq;
+            r->end_seq = seq;
+        }
+    }
+
+    /* 新的最高序号：中间的序号记为缺失，待NACK */
+    if ((uint16_t)(seq - r->end_seq) < 0x8000) {
+        while (r->end_seq != seq) {
+            slot = &r->slots[r->end_seq & (r->count - 1)];
+            slot->len = 0;
+            slot->seq = r->end_seq;
+            slot->count = 0;
+            slot->since_us = now;
+            slot->last_us = 0;
+            r->end_seq++;
+        }
+        r->end_seq++;
+    } else {
+        slot = &r->slots[seq & (r->count - 1)];
+        if (slot->len > 0) {
+            return 0;                   /* Duplicate */
+        }
+        r->recovered++;
+    }
+
+    slot = &r->slots[seq & (r->count - 1)];
+    memcpy(slot->data, packet, bytes);
+    slot->len = bytes;
+    slot->seq = seq;
+
+    receiver_release(r, 0);
+    return 0;
+}
+
+int lws_rtx_receiver_poll(lws_rtx_receiver_t* receiver, uint64_t now,
+                          uint8_t* rtcp, int size)
+{
+    lws_rtx_receiver_t* r = receiver;
+    uint16_t seq;
+    int len, fb = 0;
+    int pid = -1;
+    uint16_t blp = 0;
+
+    if (!r->started) {
+        return 0;
+    }
+
+    /* 缺口等待超时：放弃，按序交付之后的包 */
+    while (r->next_seq != r->end_seq) {
+        lws_rtx_slot_t* slot = &r->slots[r->next_seq & (r->count - 1)];
+        if (slot->len > 0 || now - slot->since_us < r->wait_us) {
+            break;
+        }
+        receiver_release(r, 1);
+    }
+
+    if (!r->nack || r->next_seq == r->end_seq) {
+        return 0;
+    }
+
+    len = rr_write(r->ssrc, rtcp, size);
+    if (len < 0 || size < len + 12 + 4) {
+        return 0;
+    }
+    fb = len;
+    len += 12;
+
+    /* 缺失序号编码为PID+BLP，每项覆盖17个序号 */
+    for (seq = r->next_seq; seq != r->end_seq; seq++) {
+        lws_rtx_slot_t* slot = &r->slots[seq & (r->count - 1)];
+
+        if (slot->len > 0 || slot->count >= LWS_RTX_NACK_TRIES ||
+            (slot->last_us != 0 && now - slot->last_us < LWS_RTX_NACK_RETRY_US)) {
+            continue;
+        }
+
+        if (pid >= 0 && (uint16_t)(seq - pid) <= 16) {
+            blp |= (uint16_t)(1 << ((uint16_t)(seq - pid) - 1));
+        } else {
+            if (pid >= 0) {
+                put_u16(rtcp + len, (uint16_t)pid);
+                put_u16(rtcp + len + 2, blp);
+                len += 4;
+            }
+            if (len + 4 > size) {
+                pid = -1;
+                break;
+            }
+            pid = seq;
+            blp = 0;
+        }
+        slot->count++;
+        slot->last_us = now;
+        r->nacks++;
+    }
+    if (pid >= 0) {
+        put_u16(rtcp + len, (uint16_t)pid);
+        put_u16(rtcp + len + 2, blp);
+        len += 4;
+    }
+
+    if (len == fb + 12) {
+        return 0;
+    }
+
+    rtcp[fb] = 0x80 | RTCP_FMT_NACK;
+    rtcp[fb + 1] = RTCP_RTPFB;
+    put_u16(rtcp + fb + 2, (uint16_t)((len - fb) / 4 - 1));
+    put_u32(rtcp + fb + 4, r->ssrc);
+    put_u32(rtcp + fb + 8, r->media_ssrc);
+    return len;
+}
+
+int lws_rtx_pli_write(uint32_t ssrc, uint32_t media_ssrc, uint8_t* rtcp, int size)
+{
+    int len = rr_write(ssrc, rtcp, size);
+
+    if (len < 0 || size < len + 12) {
+        return -1;
+    }
+    rtcp[len] = 0x80 | RTCP_FMT_PLI;
+    rtcp[len + 1] = RTCP_PSFB;
+    put_u16(rtcp + len + 2, 2);
+    put_u32(rtcp + len + 4, ssrc);
+    put_u32(rtcp + len + 8, media_ssrc);
+    return len + 12;
+}
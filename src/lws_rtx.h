@@ -0,0 +1,231 @@
+/**
+ * @file lws_rtx.h
+ * @brief Video loss recovery: NACK/RTX (RFC 4585, RFC 4588), keyframe requests, send pacing
+ *
+ * The sender keeps every packet it sends in a history ring indexed by
+ * sequence number. The ring is also the pacer queue: the packetizer stores
+ * packets as it builds them and a leaky bucket releases them, so a frame is
+ * spread over a share of the frame interval instead of leaving in one
+ * burst. A generic NACK is answered from the ring, as an RTX packet when an
+ * RTX payload type was negotiated and as the original packet otherwise.
+ *
+ * The receiver puts incoming packets back in sequence order. A missing
+ * packet is NACKed at once and re-requested until it arrives or its wait
+ * expires; packets are released in order, so the depacketizer only sees a
+ * gap for a packet that is really lost.
+ */
+
+#ifndef __LWS_RTX_H__
+#define __LWS_RTX_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Constants
+ * ======================================== */
+
+#define LWS_RTX_MAX_PACKET      1500        /**< Largest RTP packet kept */
+#define LWS_RTX_MIN_INTERVAL_US 20000       /**< Retransmit one packet at most this often */
+#define LWS_RTX_BURST_US        5000        /**< Pacer budget cap, in time at the current rate */
+#define LWS_RTX_NACK_RETRY_US   50000       /**< Re-request a missing packet after this */
+#define LWS_RTX_NACK_TRIES      3           /**< NACKs sent per missing packet */
+#define LWS_RTX_WAIT_US         200000      /**< Hold packets behind a gap this long (NACK on) */
+#define LWS_RTX_REORDER_US      20000       /**< Hold packets behind a gap this long (NACK off) */
+
+/* lws_rtx_feedback() result */
+#define LWS_RTX_KEYFRAME        0x01        /**< PLI or new FIR received */
+
+/**
+ * @brief Packet slot of the history / reorder ring
+ */
+typedef struct {
+    int len;                        /**< Packet bytes, 0 = no packet */
+    uint16_t seq;                   /**< Sequence number held (or awaited) */
+    int count;                      /**< Sender: retransmissions, receiver: NACKs sent */
+    uint64_t since_us;              /**< Sender: queued at, receiver: found missing at */
+    uint64_t last_us;               /**< Last retransmission / NACK */
+    uint8_t data[LWS_RTX_MAX_PACKET];
+} lws_rtx_slot_t;
+
+/**
+ * @brief Packet ready to go on the wire
+ * @return 0 on success
+ */
+typedef int (*lws_rtx_send_f)(void* param, const uint8_t* packet, int bytes);
+
+/* ========================================
+ * Sender: packet history, pacer, feedback
+ * ======================================== */
+
+/**
+ * @brief Sender state
+ */
+typedef struct {
+    lws_rtx_slot_t* slots;
+    int count;                      /**< Ring size (power of two) */
+    int started;                    /**< next_seq/send_seq are valid */
+    uint16_t next_seq;              /**< Sequence number of the next packet stored */
+    uint16_t send_seq;              /**< Next packet the pacer sends */
+    int queued_bytes;
+
+    /* Pacer (leaky bucket) */
+    int rate;                       /**< Bytes per second, 0 = send at once */
+    int64_t budget;                 /**< Bytes that may leave now (negative = wait) */
+    uint64_t last_us;
+
+    /* Retransmission */
+    uint32_t ssrc;                  /**< Media SSRC feedback must name */
+    int rtx_pt;                     /**< RTX payload type, -1 = resend the original packet */
+    uint32_t rtx_ssrc;
+    uint16_t rtx_seq;
+    int fir_seq;                    /**< Last FIR command sequence number, -1 = none */
+    uint8_t packet[LWS_RTX_MAX_PACKET + 2];
+
+    lws_rtx_send_f send;
+    void* param;
+
+    /* Counters */
+    uint64_t nacks;                 /**< Sequence numbers NACKed by the peer */
+    uint64_t retransmits;           /**< Packets retransmitted */
+    uint64_t keyframe_requests;     /**< PLI / new FIR received */
+    uint64_t paced;                 /**< Packets sent by the pacer */
+    uint64_t delay_total_us;        /**< Sum of pacing delays */
+    uint32_t delay_max_us;
+} lws_rtx_sender_t;
+
+/**
+ * @brief Initialize a sender
+ * @param count History size in packets (rounded up to a power of two)
+ * @param ssrc Media SSRC
+ * @return 0 on success, -1 on allocation failure
+ */
+int lws_rtx_sender_init(lws_rtx_sender_t* sender, int count, uint32_t ssrc,
+                        lws_rtx_send_f send, void* param);
+
+/**
+ * @brief Release the history
+ */
+void lws_rtx_sender_free(lws_rtx_sender_t* sender);
+
+/**
+ * @brief Use an RTX stream (RFC 4588 §4) for retransmissions
+ * @param pt RTX payload type, -1 to resend original packets
+ */
+void lws_rtx_sender_set_rtx(lws_rtx_sender_t* sender, int pt, uint32_t ssrc, uint16_t seq);
+
+/**
+ * @brief Store a packet in the history and queue it for the pacer
+ *
+ * Packets are expected in sequence order; a jump flushes the queue.
+ *
+ * @return 0 on success, -1 if the packet is malformed or too large
+ */
+int lws_rtx_enqueue(lws_rtx_sender_t* sender, const uint8_t* packet, int bytes,
+                    uint64_t now);
+
+/**
+ * @brief Set the pacing rate after a frame was queued
+ *
+ * The queue is drained within drain_us (0 = no pacing).
+ */
+void lws_rtx_pace_frame(lws_rtx_sender_t* sender, uint64_t drain_us);
+
+/**
+ * @brief Send the queued packets the budget allows
+ * @return Packets sent
+ */
+int lws_rtx_pace(lws_rtx_sender_t* sender, uint64_t now);
+
+/**
+ * @brief Handle a received RTCP compound packet (NACK, PLI, FIR)
+ *
+ * NACKed packets still in the history are retransmitted at once.
+ *
+ * @return LWS_RTX_KEYFRAME if the peer asked for a keyframe, 0 otherwise
+ */
+int lws_rtx_feedback(lws_rtx_sender_t* sender, const uint8_t* rtcp, int bytes,
+                     uint64_t now);
+
+/* ========================================
+ * Receiver: reordering and NACK generation
+ * ======================================== */
+
+/**
+ * @brief In-order packet for the depacketizer
+ */
+typedef void (*lws_rtx_deliver_f)(void* param, const uint8_t* packet, int bytes);
+
+/**
+ * @brief Receiver state
+ */
+typedef struct {
+    lws_rtx_slot_t* slots;
+    int count;                      /**< Ring size (power of two) */
+    int started;
+    uint16_t next_seq;              /**< Next packet to release */
+    uint16_t end_seq;               /**< One past the highest packet received */
+
+    uint32_t ssrc;                  /**< Our SSRC (feedback sender) */
+    uint32_t media_ssrc;            /**< Peer media SSRC, 0 = not seen */
+    int rtx_pt;                     /**< RTX payload type, -1 = none */
+    int apt;                        /**< Payload type RTX packets restore */
+    int nack;                       /**< Peer accepts NACK */
+    uint64_t wait_us;               /**< Hold time behind a gap */
+
+    lws_rtx_deliver_f deliver;
+    void* param;
+
+    /* Counters */
+    uint64_t nacks;                 /**< Sequence numbers NACKed */
+    uint64_t recovered;             /**< Missing packets that arrived later */
+    uint64_t lost;                  /**< Packets given up on */
+} lws_rtx_receiver_t;
+
+/**
+ * @brief Initialize a receiver
+ * @param count Reorder window in packets (rounded up to a power of two)
+ * @param ssrc Our SSRC, used as feedback sender
+ * @return 0 on success, -1 on allocation failure
+ */
+int lws_rtx_receiver_init(lws_rtx_receiver_t* receiver, int count, uint32_t ssrc,
+                          lws_rtx_deliver_f deliver, void* param);
+
+/**
+ * @brief Release the reorder ring
+ */
+void lws_rtx_receiver_free(lws_rtx_receiver_t* receiver);
+
+/**
+ * @brief Feed a received RTP packet (media or RTX)
+ *
+ * RTX packets are turned back into the original packet in place.
+ *
+ * @return 0 on success, -1 on malformed packet
+ */
+int lws_rtx_receive(lws_rtx_receiver_t* receiver, uint8_t* packet, int bytes,
+                    uint64_t now);
+
+/**
+ * @brief Give up on expired gaps and build the NACKs that are due
+ * @param rtcp Output compound RTCP packet (empty RR + generic NACK)
+ * @param size Buffer size
+ * @return RTCP bytes to send, 0 if nothing is due
+ */
+int lws_rtx_receiver_poll(lws_rtx_receiver_t* receiver, uint64_t now,
+                          uint8_t* rtcp, int size);
+
+/**
+ * @brief Build a compound RTCP packet requesting a keyframe (empty RR + PLI)
+ * @return Bytes written, -1 if the buffer is too small
+ */
+int lws_rtx_pli_write(uint32_t ssrc, uint32_t media_ssrc, uint8_t* rtcp, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_RTX_H__ */
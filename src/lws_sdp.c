@@ -0,0 +1,627 @@
+/**
+ * @file lws_sdp.c
+ * @brief Single-pass SDP parser implementation
+ *
+ * 逐行扫描一次SDP，按当前所在的section（会话级或某个m=）分发到对应字段。
+ * 所有字符串字段均指向原文，不做内存分配和拷贝。
+ */
+
+#include <string.h>
+
+#include "lws_sdp.h"
+
+/* ========================================
+ * Tokenizer helpers
+ * ======================================== */
+
+/**
+ * @brief Take the next space-separated token from [*p, end)
+ */
+static lws_sdp_str_t next_token(const char** p, const char* end)
+{
+    lws_sdp_str_t tok;
+    const char* s = *p;
+
+    while (s < end && *s == ' ') {
+        s++;
+    }
+    tok.p = s;
+    while (s < end && *s != ' ') {
+        s++;
+    }
+    tok.n = (int)(s - tok.p);
+    *p = s;
+
+    return tok;
+}
+
+/**
+ * @brief Parse a decimal prefix of a slice
+ * @return Number of digits consumed (0 = not a number)
+ */
+static int parse_u64(const char* s, const char* end, uint64_t* value)
+{
+    const char* start = s;
+    uint64_t v = 0;
+
+    while (s < end && *s >= '0' && *s <= '9') {
+        v = v * 10 + (uint64_t)(*s - '0');
+        s++;
+    }
+    *value = v;
+
+    return (int)(s - start);
+}
+
+static int token_to_int(lws_sdp_str_t tok, int* value)
+{
+    uint64_t v;
+    if (tok.n == 0 || parse_u64(tok.p, tok.p + tok.n, &v) != tok.n) {
+        return -1;
+    }
+    *value = (int)v;
+    return 0;
+}
+
+static int str_eq(const char* p, int n, const char* str)
+{
+    return (int)strlen(str) == n && memcmp(p, str, n) == 0;
+}
+
+/**
+ * @brief Whether a space-separated list contains a token
+ */
+static int has_token(const char* p, const char* end, const char* str)
+{
+    for (;;) {
+        lws_sdp_str_t tok = next_token(&p, end);
+        if (tok.n == 0) {
+            return 0;
+        }
+        if (str_eq(tok.p, tok.n, str)) {
+            return 1;
+        }
+    }
+}
+
+/* ========================================
+ * Line handlers
+ * ======================================== */
+
+/* o=<username> <sess-id> <sess-version> <nettype> <addrtype> <unicast-address> */
+static void parse_origin(lws_sdp_t* sdp, const char* p, const char* end)
+{
+    lws_sdp_str_t tok;
+
+    sdp->origin_user = next_token(&p, end);
+    tok = next_token(&p, end);
+    parse_u64(tok.p, tok.p + tok.n, &sdp->sess_id);
+    tok = next_token(&p, end);
+    parse_u64(tok.p, tok.p + tok.n, &sdp->sess_version);
+    next_token(&p, end);                    /* nettype */
+    next_token(&p, end);                    /* addrtype */
+    sdp->origin_addr = next_token(&p, end);
+}
+
+/* c=<nettype> <addrtype> <connection-address>[/<ttl>][/<count>] */
+static void parse_connection(lws_sdp_conn_t* conn, const char* p, const char* end)
+{
+    next_token(&p, end);                    /* nettype */
+    conn->addrtype = next_token(&p, end);
+    conn->addr = next_token(&p, end);
+
+    const char* slash = memchr(conn->addr.p, '/', conn->addr.n);
+    if (slash) {
+        conn->addr.n = (int)(slash - conn->addr.p);
+    }
+}
+
+/* m=<media> <port>[/<count>] <proto> <fmt> ... */
+static lws_sdp_media_t* parse_media(lws_sdp_t* sdp, const char* p, const char* end)
+{
+    if (sdp->media_count >= LWS_SDP_MAX_MEDIA) {
+        return NULL;
+    }
+
+    lws_sdp_media_t* m = &sdp->media[sdp->media_count++];
+    lws_sdp_str_t tok;
+    uint64_t v;
+    int n;
+
+    memset(m, 0, offsetof(lws_sdp_media_t, fmts));
+    m->dir = LWS_MEDIA_DIR_SENDRECV;
+    m->port_count = 1;
+
+    m->type = next_token(&p, end);
+
+    tok = next_token(&p, end);
+    n = parse_u64(tok.p, tok.p + tok.n, &v);
+    m->port = (uint16_t)v;
+    if (n < tok.n && tok.p[n] == '/') {
+        parse_u64(tok.p + n + 1, tok.p + tok.n, &v);
+        m->port_count = (int)v;
+    }
+
+    m->proto = next_token(&p, end);
+
+    while (m->fmt_count < LWS_SDP_MAX_FMTS) {
+        tok = next_token(&p, end);
+        if (tok.n == 0) {
+            break;
+        }
+        lws_sdp_fmt_t* fmt = &m->fmts[m->fmt_count];
+        int pt;
+        if (token_to_int(tok, &pt) != 0) {
+            continue;                       /* Non-RTP fmt (e.g. "webrtc-datachannel") */
+        }
+        memset(fmt, 0, sizeof(*fmt));
+        fmt->pt = pt;
+        fmt->channels = 1;
+        m->fmt_count++;
+    }
+
+    return m;
+}
+
+static lws_sdp_fmt_t* find_fmt(lws_sdp_media_t* m, int pt)
+{
+    int i;
+    for (i = 0; i < m->fmt_count; i++) {
+        if (m->fmts[i].pt == pt) {
+            return &m->fmts[i];
+        }
+    }
+    return NULL;
+}
+
+/* a=rtpmap:<pt> <encoding>/<clock rate>[/<channels>] */
+static void parse_rtpmap(lws_sdp_media_t* m, const char* p, const char* end)
+{
+    lws_sdp_str_t tok = next_token(&p, end);
+    int pt;
+    uint64_t v;
+
+    if (token_to_int(tok, &pt) != 0) {
+        return;
+    }
+    lws_sdp_fmt_t* fmt = find_fmt(m, pt);
+    if (!fmt) {
+        return;
+    }
+
+    tok = next_token(&p, end);
+    const char* slash = memchr(tok.p, '/', tok.n);
+    if (!slash) {
+        return;
+    }
+    fmt->encoding.p = tok.p;
+    fmt->encoding.n = (int)(slash - tok.p);
+
+    const char* s = slash + 1;
+    const char* tend = tok.p + tok.n;
+    s += parse_u64(s, tend, &v);
+    fmt->clock_rate = (int)v;
+    if (s < tend && *s == '/') {
+        parse_u64(s + 1, tend, &v);
+        fmt->channels = (int)v;
+    }
+}
+
+/* a=fmtp:<pt> <format specific parameters> */
+static void parse_fmtp(lws_sdp_media_t* m, const char* p, const char* end)
+{
+    lws_sdp_str_t tok = next_token(&p, end);
+    int pt;
+
+    if (token_to_int(tok, &pt) != 0) {
+        return;
+    }
+    lws_sdp_fmt_t* fmt = find_fmt(m, pt);
+    if (!fmt) {
+        return;
+    }
+
+    while (p < end && *p == ' ') {
+        p++;
+    }
+    fmt->fmtp.p = p;
+    fmt->fmtp.n = (int)(end - p);
+}
+
+/* a=rtcp-fb:<pt|*> <type> [<subtype>] */
+static void parse_rtcp_fb(lws_sdp_media_t* m, const char* p, const char* end)
+{
+    lws_sdp_str_t tok = next_token(&p, end);
+    lws_sdp_str_t type = next_token(&p, end);
+    lws_sdp_str_t subtype = next_token(&p, end);
+    int flag = 0;
+    int pt;
+    int i;
+
+    if (str_eq(type.p, type.n, "nack")) {
+        if (subtype.n == 0) {
+            flag = LWS_SDP_FB_NACK;
+        } else if (str_eq(subtype.p, subtype.n, "pli")) {
+            flag = LWS_SDP_FB_PLI;
+        }
+    } else if (str_eq(type.p, type.n, "ccm") && str_eq(subtype.p, subtype.n, "fir")) {
+        flag = LWS_SDP_FB_FIR;
+    }
+    if (!flag) {
+        return;
+    }
+
+    if (str_eq(tok.p, tok.n, "*")) {
+        for (i = 0; i < m->fmt_count; i++) {
+            m->fmts[i].rtcp_fb |= flag;
+        }
+    } else if (token_to_int(tok, &pt) == 0) {
+        lws_sdp_fmt_t* fmt = find_fmt(m, pt);
+        if (fmt) {
+            fmt->rtcp_fb |= flag;
+        }
+    }
+}
+
+/* a=crypto:<tag> <crypto-suite> <key-params> [<session-params>] */
+static void parse_crypto(lws_sdp_media_t* m, const char* p, const char* end)
+{
+    lws_sdp_crypto_t* c;
+    lws_sdp_str_t tok;
+    int tag;
+
+    if (m->crypto_count >= LWS_SDP_MAX_CRYPTO) {
+        return;
+    }
+    c = &m->cryptos[m->crypto_count];
+
+    tok = next_token(&p, end);
+    if (token_to_int(tok, &tag) != 0) {
+        return;
+    }
+    c->tag = tag;
+    c->suite = next_token(&p, end);
+    c->key = next_token(&p, end);
+    if (c->suite.n > 0 && c->key.n > 0) {
+        m->crypto_count++;
+    }
+}
+
+int lws_sdp_parse_candidate(lws_sdp_cand_t* cand, const char* value, int len)
+{
+    const char* p = value;
+    const char* end;
+    lws_sdp_str_t tok;
+    uint64_t v;
+
+    if (!cand || !value) {
+        return -1;
+    }
+    end = value + (len < 0 ? (int)strlen(value) : len);
+
+    /* 容忍 "a=candidate:" / "candidate:" 前缀（trickle ICE） */
+    if (end - p >= 2 && p[0] == 'a' && p[1] == '=') {
+        p += 2;
+    }
+    if (end - p >= 10 && memcmp(p, "candidate:", 10) == 0) {
+        p += 10;
+    }
+    while (end > p && (end[-1] == '\r' || end[-1] == '\n')) {
+        end--;
+    }
+
+    memset(cand, 0, sizeof(*cand));
+
+    /* <foundation> <component-id> <transport> <priority> <address> <port> typ <type> */
+    cand->foundation = next_token(&p, end);
+    if (token_to_int(next_token(&p, end), &cand->component) != 0) {
+        return -1;
+    }
+    cand->transport = next_token(&p, end);
+    tok = next_token(&p, end);
+    if (tok.n == 0 || parse_u64(tok.p, tok.p + tok.n, &v) != tok.n) {
+        return -1;
+    }
+    cand->priority = (uint32_t)v;
+    cand->addr = next_token(&p, end);
+    tok = next_token(&p, end);
+    if (tok.n == 0 || parse_u64(tok.p, tok.p + tok.n, &v) != tok.n) {
+        return -1;
+    }
+    cand->port = (uint16_t)v;
+
+    tok = next_token(&p, end);
+    if (!str_eq(tok.p, tok.n, "typ")) {
+        return -1;
+    }
+    cand->type = next_token(&p, end);
+    if (cand->foundation.n == 0 || cand->addr.n == 0 || cand->type.n == 0) {
+        return -1;
+    }
+
+    /* 可选扩展：raddr/rport，其余忽略 */
+    for (;;) {
+        lws_sdp_str_t name = next_token(&p, end);
+        lws_sdp_str_t val = next_token(&p, end);
+        if (name.n == 0 || val.n == 0) {
+            break;
+        }
+        if (str_eq(name.p, name.n, "raddr")) {
+            cand->raddr = val;
+        } else if (str_eq(name.p, name.n, "rport")) {
+            parse_u64(val.p, val.p + val.n, &v);
+            cand->rport = (uint16_t)v;
+        }
+    }
+
+    return 0;
+}
+
+static int parse_direction(const char* name, int n, lws_media_dir_t* dir)
+{
+    if (str_eq(name, n, "sendrecv")) *dir = LWS_MEDIA_DIR_SENDRECV;
+    else if (str_eq(name, n, "sendonly")) *dir = LWS_MEDIA_DIR_SENDONLY;
+    else if (str_eq(name, n, "recvonly")) *dir = LWS_MEDIA_DIR_RECVONLY;
+    else if (str_eq(name, n, "inactive")) *dir = LWS_MEDIA_DIR_INACTIVE;
+    else return -1;
+    return 0;
+}
+
+/* a=<attribute>[:<value>] */
+static void parse_attribute(lws_sdp_t* sdp, lws_sdp_media_t* m,
+                            const char* p, const char* end)
+{
+    const char* colon = memchr(p, ':', end - p);
+    const char* name = p;
+    int name_len = (int)((colon ? colon : end) - p);
+    const char* value = colon ? colon + 1 : end;
+    lws_sdp_str_t vstr;
+    uint64_t v;
+
+    vstr.p = value;
+    vstr.n = (int)(end - value);
+
+    /* 会话级和媒体级都可出现的属性 */
+    if (parse_direction(name, name_len, m ? &m->dir : &sdp->dir) == 0) {
+        if (m) {
+            m->dir_set = 1;
+        }
+        return;
+    }
+    if (str_eq(name, name_len, "ice-ufrag")) {
+        *(m ? &m->ice_ufrag : &sdp->ice_ufrag) = vstr;
+        return;
+    }
+    if (str_eq(name, name_len, "ice-pwd")) {
+        *(m ? &m->ice_pwd : &sdp->ice_pwd) = vstr;
+        return;
+    }
+    if (str_eq(name, name_len, "fingerprint")) {
+        *(m ? &m->fingerprint : &sdp->fingerprint) = vstr;
+        return;
+    }
+    if (str_eq(name, name_len, "setup")) {
+        *(m ? &m->setup : &sdp->setup) = vstr;
+        return;
+    }
+    if (str_eq(name, name_len, "ice-options")) {
+        if (has_token(value, end, "trickle")) {
+            *(m ? &m->ice_trickle : &sdp->ice_trickle) = 1;
+        }
+        return;
+    }
+    if (str_eq(name, name_len, "end-of-candidates")) {
+        *(m ? &m->end_of_candidates : &sdp->end_of_candidates) = 1;
+        return;
+    }
+
+    if (!m) {
+        if (str_eq(name, name_len, "ice-lite")) {
+            sdp->ice_lite = 1;
+        } else if (str_eq(name, name_len, "group") && sdp->bundle.n == 0 &&
+                   end - value > 7 && memcmp(value, "BUNDLE ", 7) == 0) {
+            /* a=group:BUNDLE <mid> ... (RFC 5888 §5)，只取第一个BUNDLE组 */
+            sdp->bundle.p = value + 7;
+            sdp->bundle.n = (int)(end - value - 7);
+        }
+        return;
+    }
+
+    /* 媒体级属性，按出现频率排序 */
+    if (str_eq(name, name_len, "rtpmap")) {
+        parse_rtpmap(m, value, end);
+    } else if (str_eq(name, name_len, "candidate")) {
+        if (m->cand_count < LWS_SDP_MAX_CANDIDATES &&
+            lws_sdp_parse_candidate(&m->cands[m->cand_count], value, (int)(end - value)) == 0) {
+            m->cand_count++;
+        }
+    } else if (str_eq(name, name_len, "fmtp")) {
+        parse_fmtp(m, value, end);
+    } else if (str_eq(name, name_len, "rtcp-fb")) {
+        parse_rtcp_fb(m, value, end);
+    } else if (str_eq(name, name_len, "ssrc")) {
+        if (m->ssrc == 0 && parse_u64(value, end, &v) > 0) {
+            m->ssrc = (uint32_t)v;
+        }
+    } else if (str_eq(name, name_len, "ptime")) {
+        parse_u64(value, end, &v);
+        m->ptime = (int)v;
+    } else if (str_eq(name, name_len, "maxptime")) {
+        parse_u64(value, end, &v);
+        m->maxptime = (int)v;
+    } else if (str_eq(name, name_len, "rtcp")) {
+        /* a=rtcp:<port> [<nettype> <addrtype> <connection-address>] (RFC 3605) */
+        int n = parse_u64(value, end, &v);
+        m->rtcp_port = (uint16_t)v;
+        if (value + n < end) {
+            parse_connection(&m->rtcp_conn, value + n, end);
+        }
+    } else if (str_eq(name, name_len, "rtcp-mux")) {
+        m->rtcp_mux = 1;
+    } else if (str_eq(name, name_len, "mid")) {
+        m->mid = vstr;
+    } else if (str_eq(name, name_len, "extmap")) {
+        /* a=extmap:<id>[/<direction>] <URI> (RFC 8285 §8) */
+        const char* q = value + parse_u64(value, end, &v);
+        while (q < end && *q != ' ') {
+            q++;
+        }
+        lws_sdp_str_t uri = next_token(&q, end);
+        if (v > 0 && v < 256 && str_eq(uri.p, uri.n, LWS_SDP_EXT_MID)) {
+            m->mid_ext = (int)v;
+        }
+    } else if (str_eq(name, name_len, "crypto")) {
+        parse_crypto(m, value, end);
+    }
+}
+
+/* ========================================
+ * Public API
+ * ======================================== */
+
+int lws_sdp_parse(lws_sdp_t* sdp, const char* text, int len)
+{
+    const char* p;
+    const char* end;
+    lws_sdp_media_t* m = NULL;
+    int skip_media = 0;             /* Inside an m= section beyond the limit */
+    int has_version = 0;
+    int has_origin = 0;
+
+    if (!sdp || !text) {
+        return -1;
+    }
+
+    memset(sdp, 0, offsetof(lws_sdp_t, media));
+    sdp->media_count = 0;
+    sdp->dir = LWS_MEDIA_DIR_SENDRECV;
+
+    p = text;
+    end = text + (len < 0 ? (int)strlen(text) : len);
+
+    while (p < end) {
+        const char* eol = memchr(p, '\n', end - p);
+        const char* le = eol ? eol : end;
+        if (le > p && le[-1] == '\r') {
+            le--;
+        }
+
+        if (le - p >= 2 && p[1] == '=') {
+            const char* value = p + 2;
+
+            switch (p[0]) {
+            case 'v':
+                has_version = 1;
+                break;
+            case 'o':
+                parse_origin(sdp, value, le);
+                has_origin = 1;
+                break;
+            case 'c':
+                if (skip_media) break;
+                parse_connection(m ? &m->conn : &sdp->conn, value, le);
+                break;
+            case 'm':
+                m = parse_media(sdp, value, le);
+                skip_media = (m == NULL);
+                break;
+            case 'a':
+                if (skip_media) break;
+                parse_attribute(sdp, m, value, le);
+                break;
+            default:
+                break;
+            }
+        }
+
+        p = eol ? eol + 1 : end;
+    }
+
+    return (has_version && has_origin) ? 0 : -1;
+}
+
+const lws_sdp_media_t* lws_sdp_find_media(const lws_sdp_t* sdp, const char* type)
+{
+    int i;
+
+    if (!sdp || !type) {
+        return NULL;
+    }
+
+    for (i = 0; i < sdp->media_count; i++) {
+        if (lws_sdp_str_eq(sdp->media[i].type, type)) {
+            return &sdp->media[i];
+        }
+    }
+
+    return NULL;
+}
+
+const lws_sdp_fmt_t* lws_sdp_find_fmt(const lws_sdp_media_t* media, int pt)
+{
+    return media ? find_fmt((lws_sdp_media_t*)media, pt) : NULL;
+}
+
+const lws_sdp_conn_t* lws_sdp_media_conn(const lws_sdp_t* sdp, const lws_sdp_media_t* media)
+{
+    return (media && media->conn.addr.n > 0) ? &media->conn : &sdp->conn;
+}
+
+lws_media_dir_t lws_sdp_media_dir(const lws_sdp_t* sdp, const lws_sdp_media_t* media)
+{
+    return (media && media->dir_set) ? media->dir : sdp->dir;
+}
+
+int lws_sdp_media_ice(const lws_sdp_t* sdp, const lws_sdp_media_t* media,
+                      lws_sdp_str_t* ufrag, lws_sdp_str_t* pwd)
+{
+    *ufrag = (media && media->ice_ufrag.n > 0) ? media->ice_ufrag : sdp->ice_ufrag;
+    *pwd = (media && media->ice_pwd.n > 0) ? media->ice_pwd : sdp->ice_pwd;
+
+    return ufrag->n > 0 && pwd->n > 0;
+}
+
+int lws_sdp_media_dtls(const lws_sdp_t* sdp, const lws_sdp_media_t* media,
+                       lws_sdp_str_t* fingerprint, lws_sdp_str_t* setup)
+{
+    *fingerprint = (media && media->fingerprint.n > 0) ? media->fingerprint : sdp->fingerprint;
+    *setup = (media && media->setup.n > 0) ? media->setup : sdp->setup;
+
+    return fingerprint->n > 0;
+}
+
+int lws_sdp_bundled(const lws_sdp_t* sdp, const lws_sdp_media_t* media)
+{
+    char mid[64];
+
+    if (!sdp || !media || media->mid.n == 0 || media->mid.n >= (int)sizeof(mid)) {
+        return 0;
+    }
+    lws_sdp_str_copy(mid, sizeof(mid), media->mid);
+    return has_token(sdp->bundle.p, sdp->bundle.p + sdp->bundle.n, mid);
+}
+
+int lws_sdp_str_eq(lws_sdp_str_t s, const char* str)
+{
+    return s.p && str_eq(s.p, s.n, str);
+}
+
+int lws_sdp_str_copy(char* buf, size_t size, lws_sdp_str_t s)
+{
+    size_t n;
+
+    if (!buf || size == 0) {
+        return 0;
+    }
+
+    n = (s.p && s.n > 0) ? (size_t)s.n : 0;
+    if (n >= size) {
+        n = size - 1;
+    }
+    if (n > 0) {
+        memcpy(buf, s.p, n);
+    }
+    buf[n] = '\0';
+
+    return (int)n;
+}
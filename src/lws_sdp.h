@@ -0,0 +1,244 @@
+/**
+ * @file lws_sdp.h
+ * @brief Single-pass SDP parser (RFC 4566, RFC 8839 ICE attributes, RFC 8843 BUNDLE)
+ *
+ * The parser walks the SDP text once and fills a fixed-size description.
+ * String fields are slices into the original text, so nothing is allocated
+ * or copied; the text must outlive the description.
+ */
+
+#ifndef __LWS_SDP_H__
+#define __LWS_SDP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lws_sess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Limits
+ * ======================================== */
+
+#define LWS_SDP_MAX_MEDIA       4       /**< m= sections kept */
+#define LWS_SDP_MAX_FMTS        16      /**< Payload types kept per m= */
+#define LWS_SDP_MAX_CANDIDATES  16      /**< a=candidate kept per m= */
+#define LWS_SDP_MAX_CRYPTO      8       /**< a=crypto kept per m= */
+
+/* a=rtcp-fb feedback types (lws_sdp_fmt_t.rtcp_fb) */
+#define LWS_SDP_FB_NACK         0x01    /**< "nack": generic NACK (RFC 4585 §4.2) */
+#define LWS_SDP_FB_PLI          0x02    /**< "nack pli" */
+#define LWS_SDP_FB_FIR          0x04    /**< "ccm fir" (RFC 5104 §7.1) */
+
+/** RTP header extension carrying the m= line's MID (RFC 8843 §15.1) */
+#define LWS_SDP_EXT_MID         "urn:ietf:params:rtp-hdrext:sdes:mid"
+
+/* ========================================
+ * Data structures
+ * ======================================== */
+
+/**
+ * @brief Slice of the SDP text (not NUL-terminated)
+ */
+typedef struct {
+    const char* p;
+    int n;
+} lws_sdp_str_t;
+
+/**
+ * @brief c= line
+ */
+typedef struct {
+    lws_sdp_str_t addrtype;     /**< "IP4" / "IP6" */
+    lws_sdp_str_t addr;         /**< Connection address (TTL/count stripped) */
+} lws_sdp_conn_t;
+
+/**
+ * @brief Payload type of an m= line with its rtpmap/fmtp
+ */
+typedef struct {
+    int pt;                     /**< Payload type from the m= fmt list */
+    lws_sdp_str_t encoding;     /**< a=rtpmap encoding name (empty if absent) */
+    int clock_rate;             /**< a=rtpmap clock rate (0 if absent) */
+    int channels;               /**< a=rtpmap channels (1 if not given) */
+    lws_sdp_str_t fmtp;         /**< a=fmtp parameters (empty if absent) */
+    int rtcp_fb;                /**< a=rtcp-fb types (LWS_SDP_FB_*), "*" included */
+} lws_sdp_fmt_t;
+
+/**
+ * @brief a=candidate (RFC 8839 §5.1)
+ */
+typedef struct {
+    lws_sdp_str_t foundation;
+    int component;
+    lws_sdp_str_t transport;    /**< "UDP" / "TCP" */
+    uint32_t priority;
+    lws_sdp_str_t addr;
+    uint16_t port;
+    lws_sdp_str_t type;         /**< "host" / "srflx" / "prflx" / "relay" */
+    lws_sdp_str_t raddr;        /**< Related address (empty if absent) */
+    uint16_t rport;
+} lws_sdp_cand_t;
+
+/**
+ * @brief a=crypto (RFC 4568 §9.1)
+ */
+typedef struct {
+    int tag;
+    lws_sdp_str_t suite;        /**< "AES_CM_128_HMAC_SHA1_80" / ... */
+    lws_sdp_str_t key;          /**< Key parameters ("inline:..."), session parameters excluded */
+} lws_sdp_crypto_t;
+
+/**
+ * @brief m= section
+ */
+typedef struct {
+    lws_sdp_str_t type;         /**< "audio" / "video" / ... */
+    uint16_t port;              /**< 0 = stream rejected */
+    int port_count;             /**< m=<media> <port>/<count> (1 if not given) */
+    lws_sdp_str_t proto;        /**< "RTP/AVP" / "UDP/TLS/RTP/SAVPF" / ... */
+
+    lws_sdp_conn_t conn;        /**< Media-level c= (addr.n == 0 if absent) */
+    lws_media_dir_t dir;        /**< Media-level direction */
+    int dir_set;                /**< dir was given at media level */
+    int ptime;                  /**< a=ptime (0 if absent) */
+    int maxptime;               /**< a=maxptime (0 if absent) */
+    uint32_t ssrc;              /**< First a=ssrc (0 if absent) */
+    uint16_t rtcp_port;         /**< a=rtcp port (0 if absent) */
+    lws_sdp_conn_t rtcp_conn;   /**< a=rtcp address (addr.n == 0 if absent: same as RTP) */
+    int rtcp_mux;               /**< a=rtcp-mux present */
+    lws_sdp_str_t mid;          /**< a=mid identification tag (RFC 5888, empty if absent) */
+    int mid_ext;                /**< a=extmap ID of LWS_SDP_EXT_MID (0 if absent) */
+    int ice_trickle;            /**< Media-level a=ice-options lists "trickle" */
+    int end_of_candidates;      /**< Media-level a=end-of-candidates (RFC 8840) */
+
+    lws_sdp_str_t ice_ufrag;    /**< Media-level a=ice-ufrag */
+    lws_sdp_str_t ice_pwd;      /**< Media-level a=ice-pwd */
+    lws_sdp_str_t fingerprint;  /**< Media-level a=fingerprint ("sha-256 AB:CD:...") */
+    lws_sdp_str_t setup;        /**< Media-level a=setup ("actpass" / "active" / "passive") */
+
+    /* Arrays last: parsing clears only the fields above, entries are written whole */
+    int fmt_count;
+    int cand_count;
+    int crypto_count;
+    lws_sdp_fmt_t fmts[LWS_SDP_MAX_FMTS];
+    lws_sdp_cand_t cands[LWS_SDP_MAX_CANDIDATES];
+    lws_sdp_crypto_t cryptos[LWS_SDP_MAX_CRYPTO];
+} lws_sdp_media_t;
+
+/**
+ * @brief Parsed session description
+ */
+typedef struct {
+    lws_sdp_str_t origin_user;  /**< o= username */
+    uint64_t sess_id;           /**< o= sess-id */
+    uint64_t sess_version;      /**< o= sess-version */
+    lws_sdp_str_t origin_addr;  /**< o= unicast-address */
+
+    lws_sdp_conn_t conn;        /**< Session-level c= (addr.n == 0 if absent) */
+    lws_media_dir_t dir;        /**< Session-level direction (default sendrecv) */
+    lws_sdp_str_t ice_ufrag;    /**< Session-level a=ice-ufrag */
+    lws_sdp_str_t ice_pwd;      /**< Session-level a=ice-pwd */
+    lws_sdp_str_t fingerprint;  /**< Session-level a=fingerprint */
+    lws_sdp_str_t setup;        /**< Session-level a=setup */
+    int ice_lite;               /**< a=ice-lite present */
+    int ice_trickle;            /**< Session-level a=ice-options lists "trickle" */
+    int end_of_candidates;      /**< Session-level a=end-of-candidates */
+    lws_sdp_str_t bundle;       /**< Tags of the first a=group:BUNDLE (RFC 8843, empty if absent) */
+
+    lws_sdp_media_t media[LWS_SDP_MAX_MEDIA];
+    int media_count;
+} lws_sdp_t;
+
+/* ========================================
+ * Parsing
+ * ======================================== */
+
+/**
+ * @brief Parse an SDP in one pass
+ *
+ * Unknown lines and attributes are skipped. Entries beyond the LWS_SDP_MAX_*
+ * limits are dropped.
+ *
+ * @param sdp Output description
+ * @param text SDP text (CRLF or LF line endings)
+ * @param len Text length (-1 = NUL-terminated)
+ * @return 0 on success, -1 if the text has no v= or o= line
+ */
+int lws_sdp_parse(lws_sdp_t* sdp, const char* text, int len);
+
+/**
+ * @brief Parse the value of an a=candidate attribute
+ * @param cand Output candidate
+ * @param value Text after "a=candidate:" (or "candidate:")
+ * @param len Value length (-1 = NUL-terminated)
+ * @return 0 on success, -1 on malformed candidate
+ */
+int lws_sdp_parse_candidate(lws_sdp_cand_t* cand, const char* value, int len);
+
+/* ========================================
+ * Queries
+ * ======================================== */
+
+/**
+ * @brief First m= section of the given type ("audio", "video")
+ * @return Media section, NULL if not present
+ */
+const lws_sdp_media_t* lws_sdp_find_media(const lws_sdp_t* sdp, const char* type);
+
+/**
+ * @brief Format entry for a payload type of an m= section
+ * @return Format, NULL if pt is not offered
+ */
+const lws_sdp_fmt_t* lws_sdp_find_fmt(const lws_sdp_media_t* media, int pt);
+
+/**
+ * @brief Effective connection of an m= section (media c= overrides session c=)
+ */
+const lws_sdp_conn_t* lws_sdp_media_conn(const lws_sdp_t* sdp, const lws_sdp_media_t* media);
+
+/**
+ * @brief Effective direction of an m= section (media overrides session)
+ */
+lws_media_dir_t lws_sdp_media_dir(const lws_sdp_t* sdp, const lws_sdp_media_t* media);
+
+/**
+ * @brief Effective ICE credentials of an m= section (media overrides session)
+ * @return 1 if both ufrag and pwd are present, 0 otherwise
+ */
+int lws_sdp_media_ice(const lws_sdp_t* sdp, const lws_sdp_media_t* media,
+                      lws_sdp_str_t* ufrag, lws_sdp_str_t* pwd);
+
+/**
+ * @brief Effective DTLS parameters of an m= section (media overrides session, RFC 8122 §5)
+ * @param setup a=setup value (n == 0 if absent)
+ * @return 1 if a fingerprint is present, 0 otherwise
+ */
+int lws_sdp_media_dtls(const lws_sdp_t* sdp, const lws_sdp_media_t* media,
+                       lws_sdp_str_t* fingerprint, lws_sdp_str_t* setup);
+
+/**
+ * @brief Whether an m= section is in the BUNDLE group (its a=mid is listed)
+ * @return 1 if bundled, 0 otherwise
+ */
+int lws_sdp_bundled(const lws_sdp_t* sdp, const lws_sdp_media_t* media);
+
+/**
+ * @brief Compare a slice with a C string (case-sensitive)
+ */
+int lws_sdp_str_eq(lws_sdp_str_t s, const char* str);
+
+/**
+ * @brief Copy a slice into a NUL-terminated buffer (truncates)
+ * @return Number of characters copied
+ */
+int lws_sdp_str_copy(char* buf, size_t size, lws_sdp_str_t s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_SDP_H__ */
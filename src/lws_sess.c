@@ -2,8 +2,8 @@
  * @file lws_sess.c
  * @brief lwsip media session coordination layer implementation
  *
- * 媒体会话协调层实现，直接使用 librtp 和 libice 库：
- * - ICE流程协调（candidate收集 → 连接性检查 → 选择最优路径）
+ * 媒体会话协调层实现，使用 librtp 库和内置ICE agent (lws_ice)：
+ * - ICE流程协调（candidate收集 → 连接性检查 → 选择最优路径 → consent）
  * - RTP会话管理（RTP打包/解包、RTCP定时发送）
  * - 设备协调（从Dev层采集数据 → 发送；接收数据 → 送Dev播放）
  * - 会话状态管理（IDLE → GATHERING → CONNECTING → CONNECTED）
@@ -23,6 +23,8 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <ifaddrs.h>
+#include <net/if.h>
+#include <netdb.h>
 #include <unistd.h>
 
 /* lwsip headers */
@@ -30,18 +32,25 @@
 #include "lws_err.h"
 #include "lws_mem.h"
 #include "lws_log.h"
+#include "lws_mutex.h"
+#include "lws_sdp.h"
+#include "lws_codec.h"
+#include "lws_vad.h"
+#include "lws_apm.h"
+#include "lws_h264.h"
+#include "lws_rtx.h"
+#include "lws_red.h"
+#include "lws_rec.h"
+#include "lws_srtp.h"
+#include "lws_dtls.h"
+#include "lws_ice.h"
+#include "lws_turn.h"
 
 /* librtp headers */
 #include "rtp.h"
 #include "rtp-payload.h"
 #include "rtp-profile.h"
 
-/* libice headers */
-#include "ice-agent.h"
-#include "ice-candidate.h"
-#include "stun-agent.h"
-#include "stun-proto.h"
-
 /* ========================================
  * Constants
  * ======================================== */
@@ -50,11 +59,64 @@
 #define LWS_SESS_MAX_SDP_SIZE       4096
 #define LWS_SESS_RTCP_INTERVAL_MS   5000    /* 5 seconds */
 #define LWS_SESS_RTP_MTU            1200    /* RTP packet MTU */
+#define LWS_SESS_LOCAL_IP_TTL_US    30000000ULL /* Local IP cache lifetime (30s) */
+#define LWS_SESS_DTMF_QUEUE         32      /* Pending digits for lws_sess_send_dtmf */
+#define LWS_SESS_DTMF_DEFAULT_MS    100     /* Default digit duration */
+#define LWS_SESS_DTMF_MIN_MS        40      /* Shortest digit we send */
+#define LWS_SESS_DTMF_GAP_MS        50      /* Pause between digits */
+#define LWS_SESS_DTMF_END_PACKETS   3       /* End packet redundancy (RFC 4733 §2.5.1.4) */
+#define LWS_SESS_DTMF_VOLUME        10      /* -10 dBm0 */
+#define LWS_SESS_DTMF_RX_TIMEOUT_US 500000ULL /* Report an event whose end packets were lost */
+#define LWS_SESS_VAD_HANGOVER_MS    200     /* Keep sending after the last speech frame */
+#define LWS_SESS_CN_REFRESH_US      500000ULL /* SID refresh interval during silence */
+#define LWS_SESS_CN_LEVEL_DELTA     3       /* Send a SID early on a noise level change (dB) */
+#define LWS_SESS_CN_MAX_LAG_US      100000ULL /* Comfort noise playout resync threshold */
+#define LWS_SESS_PROC_BUDGET_PCT    25      /* Default voice processing budget (% of a frame) */
+#define LWS_SESS_DEFAULT_MAXPTIME   60      /* a=maxptime we announce when not configured */
+#define LWS_SESS_PTIME_HEADER       40      /* IPv4/UDP/RTP bytes per audio packet */
+#define LWS_SESS_PTIME_OVERHEAD_PCT 10      /* Automatic ptime: largest header share of a packet */
+#define LWS_SESS_PACK_MAX_SAMPLES   ((LWS_SESS_RTP_MTU - 12) / 2) /* Multi-frame packet (16-bit PCM) */
+#define LWS_SESS_VIDEO_CLOCK        90000   /* Video RTP clock (RFC 6184 §8.2.1) */
+#define LWS_SESS_VIDEO_HISTORY      256     /* Sent video packets kept for NACK and pacing */
+#define LWS_SESS_VIDEO_REORDER      128     /* Video receive reorder window (packets) */
+#define LWS_SESS_VIDEO_PACE_PCT     50      /* Send a frame within this share of the frame interval */
+#define LWS_SESS_PLI_INTERVAL_US    500000ULL /* Minimum spacing of our keyframe requests */
+#define LWS_SESS_RELATCH_PACKETS    3       /* Packets from a new source before symmetric RTP moves */
+#define LWS_SESS_MID_EXT_ID         1       /* a=extmap ID we offer for the MID header extension */
+#define LWS_SESS_MID_SIZE           16      /* Longest a=mid tag kept (+1) */
 
 /* ========================================
  * Internal Data Structures
  * ======================================== */
 
+/**
+ * @brief Queued DTMF digit
+ */
+typedef struct {
+    uint8_t event;                  /* RFC 4733 event code */
+    uint16_t duration_ms;
+} lws_sess_dtmf_t;
+
+/**
+ * @brief SRTP state of one m= line (SDES, RFC 4568, or DTLS-SRTP, RFC 5764)
+ */
+typedef struct {
+    uint8_t key[LWS_SRTP_MAX_MASTER];        /* Our master key + salt (sent in a=crypto) */
+    uint8_t remote_key[LWS_SRTP_MAX_MASTER]; /* Peer's master key + salt */
+    int suite;                      /* Negotiated lws_srtp_suite_t, -1 = plain RTP */
+    int tag;                        /* a=crypto tag of the negotiated line */
+    char proto[24];                 /* m= line protocol (RTP/AVP, RTP/SAVP, UDP/TLS/RTP/SAVP) */
+    lws_srtp_t* tx;                 /* Protects with our key */
+    lws_srtp_t* rx;                 /* Unprotects with the peer's key */
+
+    /* DTLS-SRTP */
+    int use_dtls;                   /* Keyed by DTLS (offer: config, answer: remote offer) */
+    lws_dtls_role_t dtls_role;      /* Our a=setup role once negotiated */
+    lws_dtls_t* dtls;               /* Association, NULL until negotiated */
+    lws_dtls_state_t dtls_state;    /* Last state acted upon */
+    char remote_fp[LWS_DTLS_FINGERPRINT_SIZE]; /* Peer's a=fingerprint */
+} lws_sess_srtp_t;
+
 /**
  * @brief Media session internal structure
  */
@@ -74,10 +136,13 @@ struct lws_sess_t {
     int media_socket;               /* UDP socket for RTP/STUN */
     uint16_t local_port;            /* Local port for media */
 
-    /* ICE layer (from libice) */
-    struct ice_agent_t* ice_agent;
+    /* ICE layer */
+    lws_ice_t* ice;                 /* Gathering and checks, NULL until ICE is used */
+    int ice_gathering;              /* lws_ice_gather() started */
     int ice_gathering_done;
     int ice_connected;
+    lws_turn_t* turn;               /* TURN client for the relayed candidate, NULL without turn_server */
+    struct sockaddr_in turn_addr;   /* Resolved turn_server (port 0 = none) */
 
     /* RTP layer (from librtp) */
     void* rtp;                      /* RTP session for RTCP */
@@ -86,9 +151,59 @@ struct lws_sess_t {
     uint32_t audio_ssrc;            /* Local audio SSRC */
     uint32_t audio_timestamp;       /* Current audio RTP timestamp */
     uint16_t audio_sequence;        /* Current audio RTP sequence */
+    lws_codec_table_t audio_codecs; /* Offered, then negotiated audio codecs */
+    lws_sess_codec_t audio_codec;   /* Codec the encoder/decoder are set up for */
+    int audio_encoder_paused;       /* Session sends its own packets (DTMF/CN) on audio_sequence */
+    lws_red_sender_t red_tx;        /* RFC 2198, pt -1 until negotiated */
+    lws_red_receiver_t red_rx;
+    uint8_t red_buf[LWS_RED_MAX_PACKET + LWS_SRTP_MAX_TRAILER];
+    int audio_talkspurt;            /* Mark the next audio packet (RFC 3551 §4.1) */
+    lws_graph_t* graph;             /* Audio processing graph (capture→encoder, rtp→playback) */
+    lws_graph_node_t* capture_node; /* Source of captured frames, NULL without a capture device */
+    lws_graph_node_t* rx_node;      /* Source of received (and comfort noise) frames */
+    uint32_t rx_play_timestamp;     /* Timestamp of the next frame played out */
+    lws_frame_t* capture_frame;     /* Frame buffers reused while no node keeps a reference */
+    lws_frame_t* rx_frame;
+    lws_rec_t* rec;                 /* Asynchronous recorder, NULL for synchronous writes or after hangup */
+    lws_rec_stats_t rec_stats;      /* Recorder statistics kept after it is closed */
+    lws_rec_stats_t rec_stats_prev; /* Recorders of the earlier segments (codec changes) */
+    int rec_deferred;               /* Recorder chosen once the audio codec is negotiated */
+    int rec_passthrough;            /* rec records received payloads of rec_format as they are */
+    lws_audio_format_t rec_format;
+    int audio_ptime;                /* Packetization time we send with (ms) */
+    int audio_pack_frames;          /* Frames per audio packet (audio_ptime / frame) */
+    int audio_pack_count;           /* Frames waiting in audio_pack_buf */
+    int audio_pack_samples;
+    uint32_t audio_pack_timestamp;  /* Timestamp of the first waiting frame */
+    int16_t audio_pack_buf[LWS_SESS_PACK_MAX_SAMPLES];
+
+    /* Remote media (from remote SDP, updated incrementally on re-INVITE/UPDATE) */
+    struct sockaddr_in remote_rtp_addr; /* Remote RTP address (c= / m=, or the latched source) */
+    int remote_rtp_valid;           /* remote_rtp_addr is usable */
+    struct sockaddr_in remote_sdp_addr; /* RTP address as signalled (c= / m=) */
+    struct sockaddr_in remote_rtcp_addr; /* a=rtcp, RTP port + 1, or the RTP address (rtcp-mux) */
+    int remote_rtcp_mux;            /* Remote sends/receives RTCP on the RTP port */
+    int remote_mux_attr;            /* Remote m=audio carried a=rtcp-mux (answer may too) */
+
+    /* Symmetric RTP (RTP direct mode) */
+    int rtp_latched;                /* remote_rtp_addr is a verified media source */
+    int rtcp_latched;               /* remote_rtcp_addr is a verified RTCP source */
+    struct sockaddr_in relatch_addr; /* New source seen after latching */
+    int relatch_count;              /* Consecutive packets from relatch_addr */
+    uint32_t rtp_latches;
+    uint64_t rtp_source_dropped;
+    uint32_t remote_ssrc;           /* Remote SSRC (a=ssrc or first packet) */
+    lws_media_dir_t remote_dir;     /* Direction declared by remote */
+    lws_media_dir_t active_dir;     /* Negotiated local direction */
+    uint64_t remote_sdp_version;    /* o= version of last applied remote SDP */
+    int remote_sdp_applied;         /* A remote SDP has been applied */
+    int local_offer_pending;        /* Local SDP is an offer awaiting an answer */
 
     /* SDP */
     char local_sdp[LWS_SESS_MAX_SDP_SIZE];
+    size_t local_sdp_body;          /* Offset of the part after o= line */
+    uint64_t sdp_session_id;        /* o= sess-id */
+    uint64_t sdp_version;           /* o= sess-version (RFC 3264 §8) */
     char local_ice_ufrag[64];
     char local_ice_pwd[64];
     char remote_ice_ufrag[64];
@@ -98,10 +213,108 @@ struct lws_sess_t {
     uint64_t last_rtcp_time;        /* Last RTCP send time (microseconds) */
     uint64_t session_start_time;    /* Session start time (microseconds) */
 
+    /* DTMF send (RFC 4733) */
+    lws_sess_dtmf_t dtmf_queue[LWS_SESS_DTMF_QUEUE];
+    int dtmf_queue_len;
+    int dtmf_tx_active;             /* Event being sent */
+    uint8_t dtmf_tx_event;
+    int dtmf_tx_pt;                 /* Negotiated telephone-event send PT */
+    int dtmf_tx_clock;              /* telephone-event clock rate */
+    uint32_t dtmf_tx_timestamp;     /* RTP timestamp of the event start */
+    uint32_t dtmf_tx_total;         /* Event duration (timestamp units) */
+    uint32_t dtmf_tx_duration;      /* Duration sent so far */
+    int dtmf_tx_end_sent;           /* End packets sent */
+    uint64_t dtmf_tx_next_us;       /* Next packet (or next digit) due */
+
+    /* DTMF receive */
+    int dtmf_rx_active;             /* Event in progress, not reported yet */
+    uint8_t dtmf_rx_event;
+    uint32_t dtmf_rx_timestamp;
+    uint32_t dtmf_rx_duration;
+    int dtmf_rx_clock;
+    uint64_t dtmf_rx_last_us;       /* Last packet of the event received */
+    uint32_t dtmf_rx_done_timestamp; /* Last reported event (drops end retransmits) */
+    int dtmf_rx_done_valid;
+
+    /* VAD/DTX (send) and comfort noise (RFC 3389) */
+    lws_vad_t vad;
+    int dtx_active;                 /* Silence: audio packets suppressed */
+    int cn_tx_level;                /* Noise level of the last SID sent */
+    uint64_t cn_tx_next_us;         /* Next SID refresh due */
+    lws_cn_gen_t cn_gen;            /* Comfort noise generator (receive) */
+    int cn_rx_active;               /* Peer in DTX, playing comfort noise */
+    uint64_t cn_rx_next_us;         /* Next comfort noise frame due */
+
+    /* Voice processing (capture -> encoder) */
+    lws_apm_t* apm;                 /* Built-in AEC/NS/AGC */
+    void* proc_ctx;                 /* config.audio_proc instance */
+    uint64_t proc_frames;
+    uint64_t proc_total_us;
+    uint32_t proc_max_us;
+    uint64_t proc_overruns;
+    int proc_budget_us;
+
+    /* Video (H.264, own socket; sent to the m=video address) */
+    int video_socket;               /* UDP socket for video RTP (-1 if disabled) */
+    uint16_t video_port;
+    lws_codec_table_t video_codecs; /* Offered, then negotiated video codecs */
+    lws_sess_codec_t video_codec;   /* Codec the packetizer is set up for */
+    int video_active;               /* Video stream accepted (port 0 in our SDP otherwise) */
+    uint32_t video_ssrc;
+    uint32_t video_timestamp;       /* 90 kHz RTP timestamp of the next frame */
+    uint64_t video_next_us;         /* Next capture frame due (video_fps pacing) */
+    uint8_t* video_frame;           /* Capture frame buffer, reused for every frame */
+    int video_frame_len;            /* Frame read ahead for sprop-parameter-sets (0 = none) */
+    lws_h264_packer_t video_packer;
+    lws_h264_depacker_t video_depacker;
+    lws_rtx_sender_t video_tx;      /* Send history + pacer (answers NACKs) */
+    lws_rtx_receiver_t video_rx;    /* Receive reordering, sends NACKs */
+    uint32_t video_rtx_ssrc;        /* RFC 4588 retransmission stream */
+    int video_fb;                   /* a=rtcp-fb types both sides use (LWS_SDP_FB_*) */
+    uint64_t video_pli_us;          /* Last PLI sent */
+    struct sockaddr_in remote_video_addr;
+    struct sockaddr_in remote_video_rtcp_addr; /* Same as RTP with rtcp-mux */
+    int remote_video_valid;
+    lws_rtp_stats_t video_stats;
+    uint8_t video_srtp_buf[LWS_RTX_MAX_PACKET + 2 + LWS_SRTP_MAX_TRAILER]; /* History stays plaintext */
+
+    /* BUNDLE (RFC 8843): video on the audio transport */
+    int bundle_active;              /* Video shares media_socket / the ICE pair, no video socket */
+    char audio_mid[LWS_SESS_MID_SIZE]; /* a=mid tags (answerer: the offerer's) */
+    char video_mid[LWS_SESS_MID_SIZE];
+    int mid_ext_id;                 /* a=extmap ID of the MID header extension, 0 = not used */
+    uint32_t remote_video_ssrc;     /* Peer's video SSRC (a=ssrc or learned from the MID) */
+
+    /* SRTP (config.srtp_mode) */
+    lws_sess_srtp_t audio_srtp;
+    lws_sess_srtp_t video_srtp;
+    uint64_t srtp_dropped;          /* Packets failing unprotect */
+    lws_dtls_cert_t* dtls_cert;     /* Shared DTLS certificate, NULL until DTLS is used */
+
+    /* Receive sequence/jitter tracking (RFC 3550 A.1, A.8) */
+    int rx_seq_valid;
+    uint16_t rx_max_seq;            /* Highest sequence number seen */
+    uint32_t rx_cycles;             /* Sequence number wrap-arounds << 16 */
+    uint32_t rx_base_seq;           /* First sequence number */
+    uint32_t rx_received;           /* Packets received since rx_base_seq */
+    uint32_t rx_recovered;          /* Packets rebuilt from RED since rx_base_seq */
+    uint32_t rx_transit;            /* Previous relative transit time */
+    uint32_t rx_jitter;             /* Interarrival jitter << 4 */
+
     /* Statistics */
     lws_rtp_stats_t audio_stats;
 };
 
+/**
+ * @brief Pre-bound media socket pool
+ */
+struct lws_sess_sock_pool_t {
+    int capacity;                   /* Target number of idle sockets */
+    int count;                      /* Idle sockets available */
+    int* fds;                       /* Idle sockets (bound, non-blocking) */
+    uint16_t* ports;                /* Local port of each idle socket */
+};
+
 /* ========================================
  * Forward Declarations
  * ======================================== */
@@ -110,6 +323,14 @@ static void change_state(lws_sess_t* sess, lws_sess_state_t new_state);
 static int generate_ice_credentials(lws_sess_t* sess);
 static int generate_local_sdp(lws_sess_t* sess);
 static int get_local_ipv4(struct sockaddr_in* addr);
+static void media_rtp_input(lws_sess_t* sess, const uint8_t* data, int bytes);
+static void video_input(lws_sess_t* sess, uint8_t* data, int bytes, int rtcp, uint64_t now);
+static void red_deliver(void* param, const uint8_t* packet, int bytes);
+static void record_packet(lws_sess_t* sess, const uint8_t* payload, int bytes,
+                          uint32_t timestamp);
+static void record_codec_changed(lws_sess_t* sess);
+static int dtx_process(lws_sess_t* sess, const int16_t* pcm, int samples);
+static int acquire_media_socket(lws_sess_sock_pool_t* pool, uint16_t* port);
 
 /* ========================================
  * Helper Functions
@@ -125,6 +346,77 @@ static uint64_t get_current_time_us(void)
     return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
 }
 
+/**
+ * @brief Offset of the RTP payload (after CSRCs and header extension)
+ * @return Offset, -1 if the packet is truncated
+ */
+static int rtp_payload_offset(const uint8_t* data, int bytes)
+{
+    int offset = 12 + (data[0] & 0x0f) * 4;
+
+    if (data[0] & 0x10) {
+        if (bytes < offset + 4) {
+            return -1;
+        }
+        offset += 4 + (((int)data[offset + 2] << 8) | data[offset + 3]) * 4;
+    }
+    return bytes >= offset ? offset : -1;
+}
+
+/**
+ * @brief Find an RTP header extension element (RFC 8285 one- and two-byte forms)
+ * @param value Output element data
+ * @return Element length, -1 if absent
+ */
+static int rtp_header_ext(const uint8_t* data, int bytes, int id, const uint8_t** value)
+{
+    int offset = 12 + (data[0] & 0x0f) * 4;
+    int profile;
+    int end;
+
+    if (!(data[0] & 0x10) || bytes < offset + 4) {
+        return -1;
+    }
+    profile = ((int)data[offset] << 8) | data[offset + 1];
+    end = offset + 4 + (((int)data[offset + 2] << 8) | data[offset + 3]) * 4;
+    if (end > bytes || (profile != 0xBEDE && (profile & 0xFFF0) != 0x1000)) {
+        return -1;
+    }
+
+    for (offset += 4; offset < end; ) {
+        int eid, len;
+
+        if (data[offset] == 0) {            /* 填充字节 */
+            offset++;
+            continue;
+        }
+        if (profile == 0xBEDE) {
+            eid = data[offset] >> 4;
+            len = (data[offset] & 0x0f) + 1;
+            offset += 1;
+            if (eid == 15) {
+                break;
+            }
+        } else {
+            if (offset + 2 > end) {
+                break;
+            }
+            eid = data[offset];
+            len = data[offset + 1];
+            offset += 2;
+        }
+        if (offset + len > end) {
+            break;
+        }
+        if (eid == id) {
+            *value = data + offset;
+            return len;
+        }
+        offset += len;
+    }
+    return -1;
+}
+
 /**
  * @brief Change session state and trigger callback
  */
@@ -147,35 +439,6 @@ static void change_state(lws_sess_t* sess, lws_sess_state_t new_state)
     }
 }
 
-/**
- * @brief 检测 SDP 中是否包含 ICE 属性
- * @param sdp SDP 字符串
- * @return 1 表示包含 ICE 属性，0 表示不包含
- */
-static int sdp_has_ice_attributes(const char* sdp)
-{
-    if (!sdp) {
-        return 0;
-    }
-
-    /* 检查是否有 ice-ufrag 属性 */
-    if (strstr(sdp, "a=ice-ufrag:") != NULL) {
-        return 1;
-    }
-
-    /* 检查是否有 ice-pwd 属性 */
-    if (strstr(sdp, "a=ice-pwd:") != NULL) {
-        return 1;
-    }
-
-    /* 检查是否有 candidate 属性 */
-    if (strstr(sdp, "a=candidate:") != NULL) {
-        return 1;
-    }
-
-    return 0;
-}
-
 /**
  * @brief Generate random ICE credentials (ufrag and pwd)
  */
@@ -206,856 +469,4370 @@ static int generate_ice_credentials(lws_sess_t* sess)
 }
 
 /**
- * @brief Convert payload type to RTP profile name
+ * @brief Local audio codec preference list
+ *
+ * 未配置列表时以audio_codec优先，其后为原先即可协商的G.711/G.722。
  */
-static const char* payload_to_name(lws_rtp_payload_t payload)
+static int audio_codec_prefs(const lws_sess_t* sess, lws_rtp_payload_t* prefs)
 {
-    switch (payload) {
-        case LWS_RTP_PAYLOAD_PCMU: return "PCMU";
-        case LWS_RTP_PAYLOAD_PCMA: return "PCMA";
-        case LWS_RTP_PAYLOAD_G722: return "G722";
-        default: return "unknown";
+    static const lws_rtp_payload_t defaults[] = {
+        LWS_RTP_PAYLOAD_PCMU, LWS_RTP_PAYLOAD_PCMA, LWS_RTP_PAYLOAD_G722
+    };
+    int count = 0;
+    int i;
+
+    if (sess->config.audio_codec_count > 0) {
+        count = LWS_MIN(sess->config.audio_codec_count, LWS_MAX_CODECS);
+        memcpy(prefs, sess->config.audio_codecs, count * sizeof(*prefs));
+        return count;
     }
+
+    prefs[count++] = sess->config.audio_codec;
+    for (i = 0; i < (int)(sizeof(defaults) / sizeof(defaults[0])); i++) {
+        if (defaults[i] != sess->config.audio_codec) {
+            prefs[count++] = defaults[i];
+        }
+    }
+    return count;
 }
 
 /**
- * @brief Get payload clock rate
+ * @brief Auxiliary formats to negotiate (LWS_CODEC_AUX_*)
  */
-static int payload_clock_rate(lws_rtp_payload_t payload)
+static int audio_aux_formats(const lws_sess_t* sess)
 {
-    switch (payload) {
-        case LWS_RTP_PAYLOAD_PCMU:
-        case LWS_RTP_PAYLOAD_PCMA:
-            return 8000;
-        case LWS_RTP_PAYLOAD_G722:
-            return 8000; /* G.722 uses 8000 for RTP, but 16000 for sampling */
-        default:
-            return 8000;
-    }
+    return (sess->config.telephone_event ? LWS_CODEC_AUX_TE : 0) |
+           (sess->config.comfort_noise ? LWS_CODEC_AUX_CN : 0) |
+           (sess->config.audio_red > 0 ? LWS_CODEC_AUX_RED : 0);
 }
 
-/* ========================================
- * ICE Callbacks
- * ======================================== */
-
 /**
- * @brief ICE send callback - called when ICE needs to send data
+ * @brief Media direction to SDP attribute name
  */
-static int on_ice_send(void* param, int protocol, const struct sockaddr* local,
-                       const struct sockaddr* remote, const void* data, int bytes)
+static const char* media_dir_name(lws_media_dir_t dir)
 {
-    lws_sess_t* sess = (lws_sess_t*)param;
-    LWS_UNUSED(protocol);
-    LWS_UNUSED(local);
-
-    if (!sess || sess->media_socket < 0 || !remote || !data || bytes <= 0) {
-        return -1;
-    }
-
-    /* Send via UDP socket */
-    ssize_t sent = sendto(sess->media_socket, data, bytes, 0, remote,
-                          remote->sa_family == AF_INET ? sizeof(struct sockaddr_in) :
-                                                          sizeof(struct sockaddr_in6));
-
-    if (sent < 0) {
-        lws_log_error(0, "[SESS] ICE send failed: %s\n", strerror(errno));
-        return -1;
-    }
-
-    if (sent != bytes) {
-        lws_log_warn(0, "[SESS] ICE partial send: %zd/%d bytes\n", sent, bytes);
+    switch (dir) {
+        case LWS_MEDIA_DIR_SENDRECV: return "sendrecv";
+        case LWS_MEDIA_DIR_SENDONLY: return "sendonly";
+        case LWS_MEDIA_DIR_RECVONLY: return "recvonly";
+        default:                     return "inactive";
     }
+}
 
-    lws_log_debug("[SESS] ICE sent %zd bytes to %s:%d", sent,
-                  inet_ntoa(((struct sockaddr_in*)remote)->sin_addr),
-                  ntohs(((struct sockaddr_in*)remote)->sin_port));
+static int media_dir_can_send(lws_media_dir_t dir)
+{
+    return dir == LWS_MEDIA_DIR_SENDRECV || dir == LWS_MEDIA_DIR_SENDONLY;
+}
 
-    return 0;
+static int media_dir_can_recv(lws_media_dir_t dir)
+{
+    return dir == LWS_MEDIA_DIR_SENDRECV || dir == LWS_MEDIA_DIR_RECVONLY;
 }
 
 /**
- * @brief ICE data callback - called when data is received through ICE
+ * @brief Negotiate local direction against the remote one (RFC 3264 §6.1)
+ *
+ * 本端只在对端愿意接收时发送，只在对端愿意发送时接收。
  */
-static void on_ice_data(void* param, uint8_t stream, uint16_t component,
-                        const void* data, int bytes)
+static lws_media_dir_t media_dir_negotiate(lws_media_dir_t local, lws_media_dir_t remote)
 {
-    lws_sess_t* sess = (lws_sess_t*)param;
-    (void)stream;
+    int send = media_dir_can_send(local) && media_dir_can_recv(remote);
+    int recv = media_dir_can_recv(local) && media_dir_can_send(remote);
 
-    if (component == 1) {
-        /* RTP data */
-        if (sess->audio_decoder) {
-            rtp_payload_decode_input(sess->audio_decoder, data, bytes);
-        }
-    } else if (component == 2) {
-        /* RTCP data */
-        if (sess->rtp) {
-            rtp_onreceived_rtcp(sess->rtp, data, bytes);
-        }
-    }
+    if (send && recv) return LWS_MEDIA_DIR_SENDRECV;
+    if (send) return LWS_MEDIA_DIR_SENDONLY;
+    if (recv) return LWS_MEDIA_DIR_RECVONLY;
+    return LWS_MEDIA_DIR_INACTIVE;
 }
 
+/* ========================================
+ * SRTP (SDES, RFC 4568 / DTLS-SRTP, RFC 5764)
+ * ======================================== */
+
 /**
- * @brief ICE gathering done callback
+ * @brief Generate the master key of one m= line
+ *
+ * 密钥在会话内固定：re-INVITE重复同一a=crypto时上下文（ROC、重放窗口）保持不变。
  */
-static void on_ice_gather(void* param, int code)
+static int srtp_init(lws_sess_t* sess, lws_sess_srtp_t* srtp)
 {
-    lws_sess_t* sess = (lws_sess_t*)param;
-    LWS_UNUSED(code);
-
-    lws_log_info("[SESS] ICE gathering done");
-
-    sess->ice_gathering_done = 1;
-    change_state(sess, LWS_SESS_STATE_GATHERED);
-
-    /* Generate SDP */
-    if (generate_local_sdp(sess) == 0) {
-        /* Trigger SDP ready callback */
-        if (sess->handler.on_sdp_ready) {
-            sess->handler.on_sdp_ready(sess, sess->local_sdp,
-                                      sess->handler.userdata);
-        }
+    memset(srtp, 0, sizeof(*srtp));
+    srtp->suite = -1;
+    srtp->use_dtls = sess->config.srtp_mode != LWS_SRTP_MODE_OFF &&
+                     sess->config.srtp_keying == LWS_SRTP_KEYING_DTLS;
+    strcpy(srtp->proto, srtp->use_dtls ? "UDP/TLS/RTP/SAVP" :
+           sess->config.srtp_mode == LWS_SRTP_MODE_REQUIRED ? "RTP/SAVP" : "RTP/AVP");
+
+    if (sess->config.srtp_mode == LWS_SRTP_MODE_OFF) {
+        return 0;
     }
+    return lws_srtp_random(srtp->key, sizeof(srtp->key));
 }
 
 /**
- * @brief ICE connected callback
+ * @brief Drop the contexts (back to plain RTP), keep the keys
  */
-static void on_ice_connected(void* param, uint64_t flags, uint64_t mask)
+static void srtp_reset(lws_sess_srtp_t* srtp)
 {
-    lws_sess_t* sess = (lws_sess_t*)param;
-    (void)mask;
-
-    if (flags & 0x01) {
-        lws_log_info("[SESS] ICE connected!");
-        sess->ice_connected = 1;
-        change_state(sess, LWS_SESS_STATE_CONNECTED);
-
-        /* Trigger connected callback */
-        if (sess->handler.on_connected) {
-            sess->handler.on_connected(sess, sess->handler.userdata);
-        }
-    }
+    lws_srtp_destroy(srtp->tx);
+    lws_srtp_destroy(srtp->rx);
+    srtp->tx = NULL;
+    srtp->rx = NULL;
+    srtp->suite = -1;
 }
 
-/* ========================================
- * RTP Callbacks
- * ======================================== */
-
 /**
- * @brief RTCP message callback
+ * @brief Drop the DTLS association and the contexts keyed by it
  */
-static void on_rtcp_message(void* param, const struct rtcp_msg_t* msg)
+static void srtp_dtls_close(lws_sess_srtp_t* srtp)
 {
-    LWS_UNUSED(param);
-    LWS_UNUSED(msg);
+    if (srtp->dtls) {
+        lws_dtls_destroy(srtp->dtls);
+        srtp->dtls = NULL;
+        srtp_reset(srtp);
+    }
+    srtp->remote_fp[0] = '\0';
+}
 
-    lws_log_debug("[SESS] RTCP message received");
+static void srtp_destroy(lws_sess_srtp_t* srtp)
+{
+    srtp_dtls_close(srtp);
+    srtp_reset(srtp);
+    memset(srtp->key, 0, sizeof(srtp->key));
+    memset(srtp->remote_key, 0, sizeof(srtp->remote_key));
 }
 
 /**
- * @brief RTP payload allocator
+ * @brief Audio media goes over the ICE selected pair (remote SDP had ICE)
  */
-static void* rtp_alloc(void* param, int bytes)
+static int ice_active(const lws_sess_t* sess)
 {
-    (void)param;
-    return lws_malloc(bytes);
+    return sess->ice && sess->active_transport_mode == LWS_TRANSPORT_MODE_ICE;
 }
 
 /**
- * @brief RTP payload free
+ * @brief DTLS records of the audio m= line: ICE selected pair or the RTP address
  */
-static void rtp_free(void* param, void *packet)
+static int audio_dtls_send(void* param, const uint8_t* data, int bytes)
 {
-    (void)param;
-    lws_free(packet);
+    lws_sess_t* sess = (lws_sess_t*)param;
+
+    if (ice_active(sess)) {
+        return lws_ice_send(sess->ice, data, bytes);
+    }
+    if (!sess->remote_rtp_valid || sess->media_socket < 0) {
+        return -1;
+    }
+    if (sendto(sess->media_socket, data, bytes, 0, (struct sockaddr*)&sess->remote_rtp_addr,
+               sizeof(sess->remote_rtp_addr)) < 0) {
+        lws_log_warn(0, "[SESS] DTLS send failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
 }
 
 /**
- * @brief RTP packet callback - called when a decoded packet is ready
+ * @brief DTLS records of the video m= line (rtcp-mux socket)
  */
-static int rtp_packet(void* param, const void *packet, int bytes,
-                      uint32_t timestamp, int flags)
+static int video_dtls_send(void* param, const uint8_t* data, int bytes)
 {
     lws_sess_t* sess = (lws_sess_t*)param;
-    LWS_UNUSED(flags);
 
-    lws_log_debug("[SESS] RTP packet decoded: %d bytes, ts=%u",
-                  bytes, timestamp);
+    if (!sess->remote_video_valid || sess->video_socket < 0) {
+        return -1;
+    }
+    if (sendto(sess->video_socket, data, bytes, 0, (struct sockaddr*)&sess->remote_video_addr,
+               sizeof(sess->remote_video_addr)) < 0) {
+        lws_log_warn(0, "[SESS] Video DTLS send failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
 
-    int samples = bytes / 2; /* Assuming 16-bit PCM */
+/**
+ * @brief Act on a DTLS state change: install the SRTP keys or report the failure
+ *
+ * 握手失败或对端关闭后上下文保持为空，srtp_output/srtp_input继续丢弃媒体，不回落到明文。
+ */
+static void srtp_dtls_update(lws_sess_t* sess, lws_sess_srtp_t* srtp,
+                             lws_dtls_state_t state, const char* kind)
+{
+    uint8_t local[LWS_SRTP_MAX_MASTER];
+    uint8_t remote[LWS_SRTP_MAX_MASTER];
+    lws_srtp_suite_t suite;
 
-    /* Write to playback device */
-    if (sess->config.audio_playback_dev) {
-        lws_dev_write_audio(sess->config.audio_playback_dev, packet, samples);
+    if (state == srtp->dtls_state) {
+        return;
     }
-
-    /* Write to recording device (if configured) */
-    if (sess->config.audio_record_dev) {
-        lws_dev_write_audio(sess->config.audio_record_dev, packet, samples);
+    srtp->dtls_state = state;
+    srtp_reset(srtp);
+
+    if (state == LWS_DTLS_CONNECTED) {
+        if (lws_dtls_srtp_keys(srtp->dtls, &suite, local, remote) == 0) {
+            srtp->tx = lws_srtp_create(suite, local);
+            srtp->rx = lws_srtp_create(suite, remote);
+            srtp->suite = suite;
+        }
+        memset(local, 0, sizeof(local));
+        memset(remote, 0, sizeof(remote));
+        if (srtp->tx && srtp->rx) {
+            lws_log_info("[SESS] %s DTLS-SRTP: %s (%s)", kind,
+                         lws_srtp_suite_name(suite),
+                         srtp->dtls_role == LWS_DTLS_CLIENT ? "client" : "server");
+            return;
+        }
+        srtp_reset(srtp);
+        srtp->dtls_state = LWS_DTLS_FAILED;
     }
 
-    /* Update statistics */
-    sess->audio_stats.recv_packets++;
-    sess->audio_stats.recv_bytes += bytes;
-    sess->audio_stats.recv_timestamp = timestamp;
-
-    return 0;
+    lws_log_error(LWS_ERR_MEDIA_DTLS, "[SESS] %s DTLS-SRTP %s\n", kind,
+                  state == LWS_DTLS_CLOSED ? "closed by peer" : "handshake failed");
+    if (sess->handler.on_error) {
+        sess->handler.on_error(sess, LWS_ERR_MEDIA_DTLS, lws_err_string(LWS_ERR_MEDIA_DTLS),
+                               sess->handler.userdata);
+    }
 }
 
-/* ========================================
- * SDP Generation
- * ======================================== */
+/**
+ * @brief Feed a received DTLS record (first byte 20-63, RFC 7983) to the association
+ */
+static void srtp_dtls_input(lws_sess_t* sess, lws_sess_srtp_t* srtp,
+                            const uint8_t* data, int bytes, const char* kind)
+{
+    if (srtp->dtls) {
+        srtp_dtls_update(sess, srtp,
+                         lws_dtls_input(srtp->dtls, data, bytes, get_current_time_us()), kind);
+    }
+}
 
 /**
- * @brief Generate local SDP with ICE candidates
+ * @brief Write the SRTP attributes of one m= line
+ *
+ * SDES: offer列出全部套件（tag = 套件序号+1），协商后只保留选中的一行。
+ * DTLS: a=fingerprint + a=setup，offer为actpass，之后为协商出的角色。
  */
-static int generate_local_sdp(lws_sess_t* sess)
+static int srtp_write_sdp(const lws_sess_t* sess, const lws_sess_srtp_t* srtp,
+                          char* buf, int size)
 {
-    char* p = sess->local_sdp;
-    int remain = sizeof(sess->local_sdp);
+    int total = 0;
     int n;
+    int i;
 
-    uint64_t session_id = (uint64_t)time(NULL);
+    if (sess->config.srtp_mode == LWS_SRTP_MODE_OFF) {
+        return 0;
+    }
 
-    /* Get local IP address for SDP */
-    struct sockaddr_in local_addr;
-    char local_ip[INET_ADDRSTRLEN];
-    if (get_local_ipv4(&local_addr) == 0) {
-        inet_ntop(AF_INET, &local_addr.sin_addr, local_ip, sizeof(local_ip));
-    } else {
-        /* Fallback to 0.0.0.0 if we can't get local IP */
-        strcpy(local_ip, "0.0.0.0");
-        lws_log_warn(0, "[SESS] Failed to get local IP for SDP, using 0.0.0.0\n");
+    if (srtp->use_dtls) {
+        if (!sess->dtls_cert) {
+            return -1;
+        }
+        n = snprintf(buf, size, "a=fingerprint:%s\r\na=setup:%s\r\n",
+                     lws_dtls_cert_fingerprint(sess->dtls_cert),
+                     !srtp->dtls ? "actpass" :
+                     srtp->dtls_role == LWS_DTLS_CLIENT ? "active" : "passive");
+        return (n < 0 || n >= size) ? -1 : n;
     }
 
-    /* SDP header with real local IP */
-    n = snprintf(p, remain,
-        "v=0\r\n"
-        "o=lwsip %llu %llu IN IP4 %s\r\n"
-        "s=lwsip media session\r\n"
-        "c=IN IP4 %s\r\n"
-        "t=0 0\r\n",
-        (unsigned long long)session_id,
-        (unsigned long long)session_id,
-        local_ip,
-        local_ip);
+    if (srtp->suite >= 0) {
+        return lws_srtp_sdes_write(srtp->tag, (lws_srtp_suite_t)srtp->suite, srtp->key,
+                                   buf, size);
+    }
+    if (sess->remote_sdp_applied) {
+        return 0;
+    }
 
-    if (n < 0 || n >= remain) return -1;
-    p += n; remain -= n;
+    for (i = 0; i < LWS_SRTP_SUITE_COUNT; i++) {
+        n = lws_srtp_sdes_write(i + 1, (lws_srtp_suite_t)i, srtp->key,
+                                buf + total, size - total);
+        if (n < 0) {
+            return -1;
+        }
+        total += n;
+    }
+    return total;
+}
 
-    /* Audio media line - use real socket port instead of dummy port 9 */
-    if (sess->config.enable_audio) {
-        /* Basic media line and RTP attributes */
-        n = snprintf(p, remain,
-            "m=audio %d RTP/AVP %d\r\n"
-            "a=rtpmap:%d %s/%d\r\n"
-            "a=%s\r\n",
-            sess->local_port,  /* Use real socket port */
-            (int)sess->config.audio_codec,
-            (int)sess->config.audio_codec,
-            payload_to_name(sess->config.audio_codec),
-            payload_clock_rate(sess->config.audio_codec),
-            sess->config.media_dir == LWS_MEDIA_DIR_SENDRECV ? "sendrecv" :
-            sess->config.media_dir == LWS_MEDIA_DIR_SENDONLY ? "sendonly" :
-            sess->config.media_dir == LWS_MEDIA_DIR_RECVONLY ? "recvonly" : "inactive");
+/**
+ * @brief Negotiate DTLS-SRTP from a=fingerprint / a=setup of a remote m= line
+ *
+ * 角色 (RFC 5763 §5)：本端offer actpass，对端answer为passive时本端是client；
+ * 作为answerer，对端actpass/passive时本端是client，active（或缺省）时是server。
+ * fingerprint不变时保留现有关联，re-INVITE不重新握手。
+ */
+static int srtp_apply_dtls(lws_sess_t* sess, lws_sess_srtp_t* srtp, const lws_sdp_t* sdp,
+                           const lws_sdp_media_t* media, const char* kind)
+{
+    lws_sdp_str_t fp;
+    lws_sdp_str_t setup;
+    lws_dtls_role_t role;
+
+    if (!lws_sdp_media_dtls(sdp, media, &fp, &setup)) {
+        if (sess->config.srtp_mode == LWS_SRTP_MODE_REQUIRED || !sess->local_offer_pending) {
+            lws_log_warn(LWS_ERR_MEDIA_SDP, "[SESS] No a=fingerprint for %s, DTLS-SRTP required\n",
+                         kind);
+            return -1;
+        }
+        if (srtp->dtls) {
+            lws_log_info("[SESS] %s DTLS-SRTP disabled by remote SDP", kind);
+        }
+        srtp_dtls_close(srtp);
+        return 0;
+    }
 
-        if (n < 0 || n >= remain) return -1;
-        p += n; remain -= n;
+    if (sess->local_offer_pending) {
+        role = lws_sdp_str_eq(setup, "passive") ? LWS_DTLS_CLIENT : LWS_DTLS_SERVER;
+    } else {
+        role = (setup.n == 0 || lws_sdp_str_eq(setup, "active")) ? LWS_DTLS_SERVER
+                                                                 : LWS_DTLS_CLIENT;
+    }
 
-        /*
-         * 默认不添加 ICE 属性，适用于服务器中转模式
-         * 如果需要 ICE 模式，会在检测到远程 SDP 包含 ICE 后动态启用
-         */
+    if (srtp->dtls && lws_dtls_fingerprint_eq(fp.p, fp.n, srtp->remote_fp, -1)) {
+        return 0;
     }
 
-    lws_log_info("[SESS] Generated local SDP (%d bytes)",
-                 (int)(p - sess->local_sdp));
-    lws_log_info("[SESS] Local SDP:\n%s", sess->local_sdp);
+    if (!sess->dtls_cert) {
+        sess->dtls_cert = lws_dtls_cert_acquire();
+        if (!sess->dtls_cert) {
+            lws_log_error(LWS_ERR_MEDIA_DTLS, "[SESS] No DTLS certificate\n");
+            return -1;
+        }
+    }
 
+    srtp_dtls_close(srtp);
+    srtp->dtls = lws_dtls_create(sess->dtls_cert, role, fp.p, fp.n,
+                                 srtp == &sess->audio_srtp ? audio_dtls_send : video_dtls_send,
+                                 sess);
+    if (!srtp->dtls) {
+        lws_log_warn(LWS_ERR_MEDIA_DTLS, "[SESS] Unsupported %s a=fingerprint\n", kind);
+        return -1;
+    }
+    lws_sdp_str_copy(srtp->remote_fp, sizeof(srtp->remote_fp), fp);
+    srtp->dtls_role = role;
+    srtp->dtls_state = LWS_DTLS_HANDSHAKE;
+    lws_log_info("[SESS] %s DTLS-SRTP: %s, handshake pending", kind,
+                 role == LWS_DTLS_CLIENT ? "client" : "server");
     return 0;
 }
 
-/* ========================================
- * Core API Implementation
- * ======================================== */
-
 /**
- * @brief Create media session instance
+ * @brief Negotiate SRTP from the a=crypto (or a=fingerprint) lines of a remote m= line
+ *
+ * 作为answerer选择对端第一个支持的套件；作为offerer只接受本端offer中的tag。
+ * 套件或对端密钥不变时保留现有上下文。密钥交换方式由offer决定：
+ * answerer跟随对端offer的m=行协议（UDP/TLS/...即DTLS-SRTP）。
+ *
+ * @return 0 (SRTP or plain RTP), -1 if SRTP is required and cannot be used
  */
-lws_sess_t* lws_sess_create(const lws_sess_config_t* config,
-                             const lws_sess_handler_t* handler)
+static int srtp_apply(lws_sess_t* sess, lws_sess_srtp_t* srtp, const lws_sdp_t* sdp,
+                      const lws_sdp_media_t* media, const char* kind)
 {
-    if (!config || !handler) {
-        lws_log_error(0, "[SESS] Invalid parameters\n");
-        return NULL;
+    uint8_t remote_key[LWS_SRTP_MAX_MASTER];
+    char proto[32];
+    int suite = -1;
+    int tag = 0;
+    int i;
+
+    if (sess->config.srtp_mode == LWS_SRTP_MODE_OFF) {
+        return 0;
     }
 
-    lws_log_info("[SESS] Creating media session");
+    /* answer的m=行协议与offer一致 (RFC 3264 §6) */
+    if (!sess->local_offer_pending) {
+        lws_sdp_str_copy(proto, sizeof(proto), media->proto);
+        if (strlen(proto) < sizeof(srtp->proto) && strstr(proto, "RTP/")) {
+            strcpy(srtp->proto, proto);
+        }
+        srtp->use_dtls = strstr(proto, "TLS") != NULL;
+    }
 
-    /* Allocate session structure */
-    lws_sess_t* sess = (lws_sess_t*)lws_calloc(1, sizeof(lws_sess_t));
-    if (!sess) {
+    if (srtp->use_dtls) {
+        return srtp_apply_dtls(sess, srtp, sdp, media, kind);
+    }
+    srtp_dtls_close(srtp);
+
+    for (i = 0; i < media->crypto_count; i++) {
+        const lws_sdp_crypto_t* c = &media->cryptos[i];
+        int s = lws_srtp_suite_parse(c->suite.p, c->suite.n);
+
+        if (s < 0) {
+            continue;
+        }
+        if (sess->local_offer_pending &&
+            (srtp->suite >= 0 ? (c->tag != srtp->tag || s != srtp->suite) : c->tag != s + 1)) {
+            continue;
+        }
+        if (lws_srtp_sdes_key((lws_srtp_suite_t)s, c->key.p, c->key.n, remote_key) != 0) {
+            continue;
+        }
+        suite = s;
+        tag = c->tag;
+        break;
+    }
+
+    if (suite < 0) {
+        if (sess->config.srtp_mode == LWS_SRTP_MODE_REQUIRED) {
+            lws_log_warn(LWS_ERR_MEDIA_SDP, "[SESS] No usable a=crypto for %s, SRTP required\n", kind);
+            return -1;
+        }
+        if (srtp->suite >= 0) {
+            lws_log_info("[SESS] %s SRTP disabled by remote SDP", kind);
+        }
+        srtp_reset(srtp);
+        return 0;
+    }
+
+    if (suite != srtp->suite || !srtp->tx ||
+        memcmp(remote_key, srtp->remote_key, lws_srtp_master_len((lws_srtp_suite_t)suite)) != 0) {
+        srtp_reset(srtp);
+        srtp->tx = lws_srtp_create((lws_srtp_suite_t)suite, srtp->key);
+        srtp->rx = lws_srtp_create((lws_srtp_suite_t)suite, remote_key);
+        if (!srtp->tx || !srtp->rx) {
+            lws_log_error(LWS_ERR_MEDIA, "[SESS] Failed to create %s SRTP context\n", kind);
+            srtp_reset(srtp);
+            memset(remote_key, 0, sizeof(remote_key));
+            return -1;
+        }
+        memcpy(srtp->remote_key, remote_key, sizeof(remote_key));
+        srtp->suite = suite;
+        lws_log_info("[SESS] %s SRTP: %s (tag %d)", kind,
+                     lws_srtp_suite_name((lws_srtp_suite_t)suite), tag);
+    }
+    srtp->tag = tag;
+    memset(remote_key, 0, sizeof(remote_key));
+    return 0;
+}
+
+/**
+ * @brief Protect an outgoing RTP/RTCP packet in place (no-op for plain RTP)
+ * @param size Buffer size, at least bytes + LWS_SRTP_MAX_TRAILER
+ * @return Bytes to send, negative on error or while the DTLS handshake is pending
+ */
+static int srtp_output(lws_sess_srtp_t* srtp, uint8_t* packet, int bytes, int size, int rtcp)
+{
+    if (!srtp->tx) {
+        return srtp->dtls ? -1 : bytes;
+    }
+    return rtcp ? lws_srtp_protect_rtcp(srtp->tx, packet, bytes, size)
+                : lws_srtp_protect(srtp->tx, packet, bytes, size);
+}
+
+/**
+ * @brief Verify and decrypt an incoming packet in place (no-op for plain RTP)
+ * @return Plain packet bytes, negative if the packet must be dropped
+ */
+static int srtp_input(lws_sess_t* sess, lws_sess_srtp_t* srtp, uint8_t* packet, int bytes,
+                      int rtcp)
+{
+    int n;
+
+    if (!srtp->rx) {
+        return srtp->dtls ? -1 : bytes;
+    }
+
+    n = rtcp ? lws_srtp_unprotect_rtcp(srtp->rx, packet, bytes)
+             : lws_srtp_unprotect(srtp->rx, packet, bytes);
+    if (n < 0) {
+        sess->srtp_dropped++;
+        lws_log_debug("[SESS] SRTP%s packet dropped (%d)", rtcp ? "C" : "", n);
+    }
+    return n;
+}
+
+/* ========================================
+ * BUNDLE (RFC 8843)
+ * ======================================== */
+
+static int codec_table_has_pt(const lws_codec_table_t* table, int pt)
+{
+    int i;
+
+    for (i = 0; i < table->count; i++) {
+        if (table->entries[i].recv_pt == pt) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Whether a packet on the audio transport belongs to the bundled video stream
+ *
+ * RTP按已知SSRC、MID头扩展、仅视频使用的PT的顺序分流 (RFC 8843 §9.2)，
+ * 带视频MID的主格式包记下其SSRC。RTCP按发送者SSRC，或报告块/反馈针对的
+ * 本端视频SSRC。包已解密：BUNDLE只与明文RTP或共用一个关联的DTLS-SRTP组合。
+ */
+static int bundle_is_video(lws_sess_t* sess, const uint8_t* data, int bytes, int rtcp)
+{
+    uint32_t ssrc = ((uint32_t)data[rtcp ? 4 : 8] << 24) | ((uint32_t)data[rtcp ? 5 : 9] << 16) |
+                    ((uint32_t)data[rtcp ? 6 : 10] << 8) | (uint32_t)data[rtcp ? 7 : 11];
+    const uint8_t* mid;
+    int pt = data[1] & 0x7f;
+    int n;
+
+    if (rtcp) {
+        if (ssrc != 0 && ssrc == sess->remote_video_ssrc) {
+            return 1;
+        }
+        /* RR的首个报告块、RTPFB/PSFB的media source */
+        if (bytes >= 12 && (data[1] == 201 || data[1] == 205 || data[1] == 206)) {
+            ssrc = ((uint32_t)data[8] << 24) | ((uint32_t)data[9] << 16) |
+                   ((uint32_t)data[10] << 8) | (uint32_t)data[11];
+            return ssrc == sess->video_ssrc || ssrc == sess->video_rtx_ssrc;
+        }
+        return 0;
+    }
+
+    if (ssrc != 0 && ssrc == sess->remote_ssrc) {
+        return 0;
+    }
+    if (ssrc != 0 && ssrc == sess->remote_video_ssrc) {
+        return 1;
+    }
+
+    if (sess->mid_ext_id && (n = rtp_header_ext(data, bytes, sess->mid_ext_id, &mid)) > 0) {
+        if (n != (int)strlen(sess->video_mid) || memcmp(mid, sess->video_mid, n) != 0) {
+            return 0;
+        }
+        if (pt == sess->video_codec.recv_pt && ssrc != sess->remote_video_ssrc) {
+            lws_log_info("[SESS] Remote video SSRC now 0x%08x (MID)", ssrc);
+            sess->remote_video_ssrc = ssrc;
+        }
+        return 1;
+    }
+
+    return codec_table_has_pt(&sess->video_codecs, pt) &&
+           !codec_table_has_pt(&sess->audio_codecs, pt);
+}
+
+/**
+ * @brief Whether the remote description bundles video with audio
+ *
+ * 两个m=行须在同一BUNDLE组且都带rtcp-mux；作为offerer，answer须保留本端的
+ * 标识 (RFC 8843 §7.3)。SDES按m=行各有密钥，而SRTCP中分流所需的字段被加密，
+ * 因此对端用SDES时不BUNDLE。
+ */
+static int bundle_negotiate(lws_sess_t* sess, const lws_sdp_t* sdp, const lws_sdp_media_t* video)
+{
+    const lws_sdp_media_t* audio = lws_sdp_find_media(sdp, "audio");
+    lws_sdp_str_t fp;
+    lws_sdp_str_t setup;
+
+    if (!sess->config.bundle || !sess->config.enable_audio || !audio || audio->port == 0 ||
+        !audio->rtcp_mux || !video->rtcp_mux ||
+        !lws_sdp_bundled(sdp, audio) || !lws_sdp_bundled(sdp, video)) {
+        return 0;
+    }
+    if (sess->config.srtp_mode != LWS_SRTP_MODE_OFF && audio->crypto_count > 0 &&
+        !lws_sdp_media_dtls(sdp, audio, &fp, &setup)) {
+        return 0;
+    }
+
+    if (sess->local_offer_pending) {
+        if (!lws_sdp_str_eq(audio->mid, sess->audio_mid) ||
+            !lws_sdp_str_eq(video->mid, sess->video_mid)) {
+            return 0;
+        }
+    } else {
+        if (audio->mid.n >= LWS_SESS_MID_SIZE || video->mid.n >= LWS_SESS_MID_SIZE) {
+            return 0;
+        }
+        lws_sdp_str_copy(sess->audio_mid, sizeof(sess->audio_mid), audio->mid);
+        lws_sdp_str_copy(sess->video_mid, sizeof(sess->video_mid), video->mid);
+    }
+
+    /* 头扩展ID以offer为准，answer原样返回 (RFC 8285 §6) */
+    sess->mid_ext_id = (audio->mid_ext && audio->mid_ext == video->mid_ext) ? audio->mid_ext : 0;
+    return 1;
+}
+
+/**
+ * @brief Whether our SDP groups audio and video (offer: config, answer: negotiated)
+ */
+static int bundle_in_sdp(const lws_sess_t* sess)
+{
+    if (sess->remote_sdp_applied) {
+        return sess->bundle_active;
+    }
+    return sess->config.bundle && sess->config.enable_audio && sess->video_active &&
+           (sess->config.srtp_mode == LWS_SRTP_MODE_OFF ||
+            sess->config.srtp_keying == LWS_SRTP_KEYING_DTLS);
+}
+
+/* ========================================
+ * RTP Direct
+ * ======================================== */
+
+static int addr_equal(const struct sockaddr_in* a, const struct sockaddr_in* b)
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+/**
+ * @brief Send media to a verified source from now on
+ */
+static void direct_latch(lws_sess_t* sess, const struct sockaddr_in* from)
+{
+    sess->remote_rtp_addr = *from;
+    sess->rtp_latched = 1;
+    sess->relatch_count = 0;
+    sess->rtp_latches++;
+
+    /* RTCP未复用时沿用信令中的端口，收到RTCP后再单独锁定 */
+    if (!sess->rtcp_latched) {
+        if (sess->remote_rtcp_mux) {
+            sess->remote_rtcp_addr = *from;
+        } else {
+            sess->remote_rtcp_addr.sin_addr = from->sin_addr;
+        }
+    }
+
+    lws_log_info("[SESS] Symmetric RTP: media now sent to %s:%u",
+                 inet_ntoa(from->sin_addr), (unsigned)ntohs(from->sin_port));
+}
+
+/**
+ * @brief Check the source of an RTP/RTCP packet, latching to it when valid
+ *
+ * 对称RTP (RFC 4961)：NAT后的对端在SDP中只能给出私网地址，媒体改发往
+ * 实际收到RTP的源地址。首个RTP包（SSRC与a=ssrc一致时）即锁定；锁定后
+ * 其他源地址须用当前远端SSRC连续发来LWS_SESS_RELATCH_PACKETS个包
+ * （NAT重新映射）才切换，其间的包丢弃。RTCP源按发送者SSRC单独锁定。
+ *
+ * @return 1 to accept the packet, 0 to drop it
+ */
+static int direct_source_check(lws_sess_t* sess, const struct sockaddr_in* from,
+                               uint32_t ssrc, int rtcp)
+{
+    if (!sess->config.symmetric_rtp || !sess->remote_rtp_valid) {
+        return 1;
+    }
+
+    if (rtcp) {
+        if (addr_equal(from, &sess->remote_rtcp_addr) || addr_equal(from, &sess->remote_rtp_addr)) {
+            return 1;
+        }
+        if (sess->remote_ssrc == 0 || ssrc != sess->remote_ssrc) {
+            return 0;
+        }
+        sess->remote_rtcp_addr = *from;
+        sess->rtcp_latched = 1;
+        return 1;
+    }
+
+    if (addr_equal(from, &sess->remote_rtp_addr)) {
+        sess->rtp_latched = 1;
+        sess->relatch_count = 0;
+        return 1;
+    }
+
+    if (!sess->rtp_latched) {
+        if (sess->remote_ssrc != 0 && ssrc != sess->remote_ssrc) {
+            return 0;
+        }
+        direct_latch(sess, from);
+        return 1;
+    }
+
+    if (ssrc != sess->remote_ssrc) {
+        return 0;
+    }
+    if (!addr_equal(from, &sess->relatch_addr)) {
+        sess->relatch_addr = *from;
+        sess->relatch_count = 0;
+    }
+    if (++sess->relatch_count < LWS_SESS_RELATCH_PACKETS) {
+        return 0;
+    }
+    direct_latch(sess, from);
+    return 1;
+}
+
+/**
+ * @brief Received audio RTCP: RTCP session, then the RED level from the
+ * fraction lost the peer reports for our audio SSRC
+ */
+static void audio_rtcp_input(lws_sess_t* sess, const uint8_t* data, int bytes)
+{
+    sess->audio_stats.rtcp_recv++;
+    if (sess->rtp) {
+        rtp_onreceived_rtcp(sess->rtp, data, bytes);
+    }
+
+    if (sess->red_tx.pt >= 0) {
+        int fraction_lost = lws_red_rtcp_loss(data, bytes, sess->audio_ssrc);
+        int level = sess->red_tx.level;
+
+        if (fraction_lost >= 0) {
+            lws_red_adapt(&sess->red_tx, fraction_lost);
+            if (sess->red_tx.level != level) {
+                lws_log_info("[SESS] RED level %d -> %d (fraction lost %d/256)\n",
+                             level, sess->red_tx.level, fraction_lost);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Datagram on the media socket in RTP direct mode
+ *
+ * RTP与RTCP共用媒体socket（本端SDP以a=rtcp声明同一端口）：DTLS按首字节
+ * 区分 (RFC 7983)，RTCP按第二字节的包类型192-223区分 (RFC 5761 §4)。
+ */
+static void direct_media_input(lws_sess_t* sess, const struct sockaddr_in* from,
+                               uint8_t* data, int bytes)
+{
+    uint32_t ssrc;
+    int rtcp;
+
+    if (bytes > 0 && LWS_DTLS_IS_RECORD(data[0])) {
+        srtp_dtls_input(sess, &sess->audio_srtp, data, bytes, "Audio");
+        return;
+    }
+    if (bytes < 12 || (data[0] & 0xc0) != 0x80) {
+        return;
+    }
+    rtcp = data[1] >= 192 && data[1] <= 223;
+    if (!rtcp && !media_dir_can_recv(sess->active_dir)) {
+        return;
+    }
+
+    /* SRTP认证先于源地址检查：伪造的包不会引起锁定 */
+    bytes = srtp_input(sess, &sess->audio_srtp, data, bytes, rtcp);
+    if (bytes < (rtcp ? 8 : 12)) {
+        return;
+    }
+
+    /* BUNDLE的视频只接受音频锁定的源地址 */
+    if (sess->bundle_active && bundle_is_video(sess, data, bytes, rtcp)) {
+        if (sess->config.symmetric_rtp && sess->remote_rtp_valid &&
+            !addr_equal(from, &sess->remote_rtp_addr)) {
+            sess->rtp_source_dropped++;
+            return;
+        }
+        video_input(sess, data, bytes, rtcp, get_current_time_us());
+        return;
+    }
+
+    ssrc = ((uint32_t)data[rtcp ? 4 : 8] << 24) | ((uint32_t)data[rtcp ? 5 : 9] << 16) |
+           ((uint32_t)data[rtcp ? 6 : 10] << 8) | (uint32_t)data[rtcp ? 7 : 11];
+    if (!direct_source_check(sess, from, ssrc, rtcp)) {
+        sess->rtp_source_dropped++;
+        return;
+    }
+
+    if (rtcp) {
+        audio_rtcp_input(sess, data, bytes);
+        return;
+    }
+
+    /* 跟踪远端SSRC（对端re-INVITE后可能更换SSRC） */
+    if (ssrc != sess->remote_ssrc) {
+        lws_log_info("[SESS] Remote SSRC now 0x%08x", ssrc);
+        sess->remote_ssrc = ssrc;
+        sess->rx_seq_valid = 0;
+    }
+
+    media_rtp_input(sess, data, bytes);
+}
+
+/* ========================================
+ * ICE Callbacks
+ * ======================================== */
+
+/**
+ * @brief Datagram received on the ICE selected pair (not STUN)
+ *
+ * RTP、RTCP与DTLS复用component 1：DTLS按首字节区分 (RFC 7983)，
+ * RTCP按第二字节的包类型192-223区分 (RFC 5761 §4)。
+ */
+static void ice_media_input(lws_sess_t* sess, uint8_t* data, int bytes)
+{
+    int rtcp;
+
+    if (bytes > 0 && LWS_DTLS_IS_RECORD(data[0])) {
+        srtp_dtls_input(sess, &sess->audio_srtp, data, bytes, "Audio");
+        return;
+    }
+    if (bytes < 12 || (data[0] & 0xc0) != 0x80) {
+        return;
+    }
+    rtcp = data[1] >= 192 && data[1] <= 223;
+
+    bytes = srtp_input(sess, &sess->audio_srtp, data, bytes, rtcp);
+    if (bytes < (rtcp ? 8 : 12)) {
+        return;
+    }
+
+    if (sess->bundle_active && bundle_is_video(sess, data, bytes, rtcp)) {
+        video_input(sess, data, bytes, rtcp, get_current_time_us());
+    } else if (rtcp) {
+        audio_rtcp_input(sess, data, bytes);
+    } else if (media_dir_can_recv(sess->active_dir)) {
+        /* RTP data (dropped while the negotiated direction excludes receiving) */
+        media_rtp_input(sess, data, bytes);
+    }
+}
+
+/**
+ * @brief Datagram relayed by the TURN server from a peer
+ *
+ * STUN交给ICE agent（中继候选对的检查），其余仅在选中中继候选对且
+ * 来自选中的远端地址时作为媒体处理。
+ */
+static void ice_relay_input(lws_sess_t* sess, const struct sockaddr_in* peer,
+                            uint8_t* data, int bytes)
+{
+    lws_ice_cand_t local;
+    struct sockaddr_in selected;
+
+    if (!sess->ice ||
+        lws_ice_relay_input(sess->ice, peer, data, bytes, get_current_time_us())) {
+        return;
+    }
+    if (ice_active(sess) && lws_ice_selected(sess->ice, &local, &selected) == 0 &&
+        local.type == LWS_ICE_CAND_RELAY &&
+        selected.sin_addr.s_addr == peer->sin_addr.s_addr &&
+        selected.sin_port == peer->sin_port) {
+        ice_media_input(sess, data, bytes);
+    }
+}
+
+/**
+ * @brief Datagram from the ICE agent (STUN, media on the selected pair)
+ */
+static int on_ice_send(void* param, const struct sockaddr_in* to,
+                       const uint8_t* data, int bytes)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    ssize_t sent = sendto(sess->media_socket, data, bytes, 0,
+                          (const struct sockaddr*)to, sizeof(*to));
+
+    if (sent != bytes) {
+        lws_log_warn(LWS_ERR_MEDIA_ICE, "[SESS] ICE send failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Check or media on a pair of the relayed candidate
+ */
+static int on_ice_relay_send(void* param, const struct sockaddr_in* to,
+                             const uint8_t* data, int bytes)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    return lws_turn_send(sess->turn, to, data, bytes);
+}
+
+/**
+ * @brief TURN allocation done: hand the relayed candidate to the agent and
+ * open permissions/channels towards the remote candidates known so far
+ */
+static void on_turn_allocated(void* param, const struct sockaddr_in* relayed,
+                              const struct sockaddr_in* mapped)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    const lws_ice_cand_t* cands;
+    int i, n;
+
+    lws_ice_set_relay(sess->ice, relayed, mapped, get_current_time_us());
+
+    n = lws_ice_remote_candidates(sess->ice, &cands);
+    for (i = 0; i < n; i++) {
+        lws_turn_permit(sess->turn, &cands[i].addr);
+    }
+}
+
+static void on_turn_failed(void* param, int code)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+
+    lws_log_warn(LWS_ERR_MEDIA_ICE, "[SESS] TURN allocation failed (%d)\n", code);
+    if (!lws_ice_gathering_done(sess->ice)) {
+        lws_ice_set_relay(sess->ice, NULL, NULL, get_current_time_us());
+    }
+}
+
+/**
+ * @brief New local candidate: report it at once (trickle ICE)
+ */
+static void on_ice_candidate(void* param, const lws_ice_cand_t* cand)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    char line[LWS_ICE_CAND_SIZE];
+
+    if (lws_ice_cand_write(cand, line, sizeof(line)) < 0) {
+        return;
+    }
+    lws_log_info("[SESS] Local candidate: %s", line);
+
+    if (sess->handler.on_candidate) {
+        sess->handler.on_candidate(sess, line, sess->handler.userdata);
+    }
+}
+
+/**
+ * @brief ICE gathering done callback
+ */
+static void on_ice_gathering_done(void* param)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+
+    lws_log_info("[SESS] ICE gathering done");
+
+    sess->ice_gathering_done = 1;
+    if (generate_local_sdp(sess) != 0) {
+        return;
+    }
+    change_state(sess, LWS_SESS_STATE_GATHERED);
+
+    if (sess->handler.on_gathering_done) {
+        sess->handler.on_gathering_done(sess, sess->handler.userdata);
+    }
+
+    /* trickle时SDP已在收集开始时发出 */
+    if (!sess->config.trickle_ice && sess->handler.on_sdp_ready) {
+        sess->handler.on_sdp_ready(sess, sess->local_sdp, sess->handler.userdata);
+    }
+}
+
+/**
+ * @brief Check list state: connected, failed or consent lost
+ */
+static void on_ice_state(void* param, lws_ice_state_t state)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    lws_ice_stats_t stats;
+
+    if (state == LWS_ICE_CONNECTED) {
+        lws_ice_get_stats(sess->ice, &stats);
+        lws_log_info("[SESS] ICE connected in %d ms (%u checks)\n",
+                     stats.connect_ms, stats.checks_sent);
+        sess->ice_connected = 1;
+        change_state(sess, LWS_SESS_STATE_CONNECTED);
+
+        /* Trigger connected callback */
+        if (sess->handler.on_connected) {
+            sess->handler.on_connected(sess, sess->handler.userdata);
+        }
+    } else if (state == LWS_ICE_FAILED) {
+        if (sess->ice_connected) {
+            /* 连通后consent丢失 (RFC 7675 §5.1)：停止发送 */
+            sess->ice_connected = 0;
+            change_state(sess, LWS_SESS_STATE_DISCONNECTED);
+            if (sess->handler.on_disconnected) {
+                sess->handler.on_disconnected(sess, "ICE consent lost", sess->handler.userdata);
+            }
+        } else if (sess->handler.on_error) {
+            sess->handler.on_error(sess, LWS_ERR_MEDIA_ICE, "ICE connectivity checks failed",
+                                   sess->handler.userdata);
+        }
+    }
+}
+
+/* ========================================
+ * Voice Processing
+ * ======================================== */
+
+/**
+ * @brief Create the voice processing stage (custom or built-in)
+ */
+static void audio_proc_create(lws_sess_t* sess)
+{
+    const lws_audio_proc_t* proc = sess->config.audio_proc;
+    int frame_samples = sess->config.audio_sample_rate * LWS_DEFAULT_FRAME_DURATION / 1000;
+    int flags = 0;
+
+    sess->proc_budget_us = sess->config.audio_proc_budget_us > 0 ?
+        sess->config.audio_proc_budget_us :
+        LWS_DEFAULT_FRAME_DURATION * 1000 * LWS_SESS_PROC_BUDGET_PCT / 100;
+
+    if (proc) {
+        sess->proc_ctx = proc->create ? proc->create(sess->config.audio_sample_rate,
+                                                     frame_samples, proc->param) : NULL;
+        if (!sess->proc_ctx) {
+            lws_log_warn(0, "[SESS] Custom audio processing failed to start\n");
+        }
+        return;
+    }
+
+    if (sess->config.enable_aec) flags |= LWS_APM_AEC;
+    if (sess->config.enable_ns) flags |= LWS_APM_NS;
+    if (sess->config.enable_agc) flags |= LWS_APM_AGC;
+    if (!flags) {
+        return;
+    }
+
+    sess->apm = lws_apm_create(sess->config.audio_sample_rate, frame_samples, flags);
+    if (!sess->apm) {
+        lws_log_warn(0, "[SESS] Voice processing disabled (create failed)\n");
+        return;
+    }
+    if ((flags & LWS_APM_AEC) && !(lws_apm_flags(sess->apm) & LWS_APM_AEC)) {
+        lws_log_warn(0, "[SESS] AEC not supported at %d Hz\n", sess->config.audio_sample_rate);
+    }
+}
+
+static void audio_proc_destroy(lws_sess_t* sess)
+{
+    if (sess->proc_ctx && sess->config.audio_proc->destroy) {
+        sess->config.audio_proc->destroy(sess->proc_ctx);
+    }
+    sess->proc_ctx = NULL;
+    lws_apm_destroy(sess->apm);
+    sess->apm = NULL;
+}
+
+/**
+ * @brief Process a captured frame and account its CPU time
+ */
+static void audio_proc_capture(lws_sess_t* sess, int16_t* pcm, int samples)
+{
+    uint64_t start, elapsed;
+
+    if (!sess->apm && !sess->proc_ctx) {
+        return;
+    }
+
+    start = get_current_time_us();
+    if (sess->proc_ctx) {
+        sess->config.audio_proc->capture(sess->proc_ctx, pcm, samples);
+    } else {
+        lws_apm_capture(sess->apm, pcm, samples);
+    }
+    elapsed = get_current_time_us() - start;
+
+    sess->proc_frames++;
+    sess->proc_total_us += elapsed;
+    if (elapsed > sess->proc_max_us) {
+        sess->proc_max_us = (uint32_t)elapsed;
+    }
+    if (elapsed > (uint64_t)sess->proc_budget_us) {
+        /* 首次超预算时告警，之后仅计数 */
+        if (sess->proc_overruns++ == 0) {
+            lws_log_warn(0, "[SESS] Voice processing over budget: %llu us > %d us\n",
+                         (unsigned long long)elapsed, sess->proc_budget_us);
+        }
+    }
+}
+
+/* ========================================
+ * Audio graph
+ * ======================================== */
+
+/**
+ * @brief Sink: playback device, and the far-end reference for echo cancellation
+ */
+static int node_playback_process(void* ctx, lws_graph_node_t* node, lws_frame_t* frame)
+{
+    lws_sess_t* sess = (lws_sess_t*)ctx;
+    const int16_t* pcm = (const int16_t*)frame->data;
+    LWS_UNUSED(node);
+
+    lws_dev_write_audio(sess->config.audio_playback_dev, pcm, frame->samples);
+
+    if (sess->proc_ctx && sess->config.audio_proc->render) {
+        sess->config.audio_proc->render(sess->proc_ctx, pcm, frame->samples);
+    } else if (sess->apm) {
+        lws_apm_render(sess->apm, pcm, frame->samples);
+    }
+    return 0;
+}
+
+/**
+ * @brief Sink: recording device
+ */
+static int node_record_process(void* ctx, lws_graph_node_t* node, lws_frame_t* frame)
+{
+    lws_sess_t* sess = (lws_sess_t*)ctx;
+    LWS_UNUSED(node);
+
+    /* 直通录音写入收到的负载，不录解码输出；编码协商前不录音 */
+    if (sess->rec_passthrough || sess->rec_deferred) {
+        return 0;
+    }
+    if (sess->config.record_queue_ms < 0) {
+        lws_dev_write_audio(sess->config.audio_record_dev, frame->data, frame->samples);
+        return 0;
+    }
+    /* 录音线程写入；挂断后录音已结束，丢弃 */
+    if (!sess->rec) {
+        return 0;
+    }
+    return sess->config.record_stereo ? lws_rec_push_leg(sess->rec, LWS_REC_REMOTE, frame)
+                                      : lws_rec_push(sess->rec, frame);
+}
+
+/**
+ * @brief Sink: local leg of a stereo recording (encoder input)
+ */
+static int node_record_local_process(void* ctx, lws_graph_node_t* node, lws_frame_t* frame)
+{
+    lws_sess_t* sess = (lws_sess_t*)ctx;
+    LWS_UNUSED(node);
+
+    return sess->rec ? lws_rec_push_leg(sess->rec, LWS_REC_LOCAL, frame) : 0;
+}
+
+static const lws_node_ops_t s_rx_node = { "rtp", LWS_NODE_SOURCE, NULL, NULL };
+static const lws_node_ops_t s_playback_node = { "playback", LWS_NODE_SINK, node_playback_process, NULL };
+static const lws_node_ops_t s_record_node = { "record", LWS_NODE_SINK, node_record_process, NULL };
+static const lws_node_ops_t s_record_local_node = { "record-local", LWS_NODE_SINK, node_record_local_process, NULL };
+
+/**
+ * @brief Cached frame buffer of at least bytes, reallocated only when a node kept the last one
+ */
+static lws_frame_t* audio_frame_get(lws_frame_t** cache, int bytes)
+{
+    if (*cache && (!lws_frame_writable(*cache) || (*cache)->capacity < bytes)) {
+        lws_frame_unref(*cache);
+        *cache = NULL;
+    }
+    if (!*cache) {
+        *cache = lws_frame_alloc(bytes);
+    }
+    return *cache;
+}
+
+/**
+ * @brief Feed a received (or comfort noise) frame to the receive chain
+ *
+ * 解码输出只复制一次到帧中，播放、录音与tap共享同一帧；没有节点
+ * 保留引用时下一帧复用同一缓冲区。
+ */
+static void audio_playout(lws_sess_t* sess, const int16_t* pcm, int samples,
+                          uint32_t timestamp)
+{
+    lws_frame_t* frame;
+
+    if (!sess->rx_node) {
+        return;
+    }
+
+    frame = audio_frame_get(&sess->rx_frame, samples * (int)sizeof(int16_t));
+    if (!frame) {
+        return;
+    }
+    frame->kind = LWS_FRAME_AUDIO;
+    frame->size = samples * (int)sizeof(int16_t);
+    frame->samples = samples;
+    frame->sample_rate = sess->config.audio_sample_rate;
+    frame->channels = 1;
+    frame->timestamp = timestamp;
+    frame->time_us = get_current_time_us();
+    memcpy(frame->data, pcm, frame->size);
+
+    lws_graph_emit(sess->rx_node, frame);
+    sess->rx_play_timestamp = timestamp + (uint32_t)samples;
+}
+
+/* ========================================
+ * Video (H.264, RFC 6184)
+ * ======================================== */
+
+/**
+ * @brief SRTP state protecting the video stream
+ *
+ * BUNDLE下只有音频m=行的DTLS关联，视频共用其上下文（按SSRC分别维护ROC与重放窗口）。
+ */
+static lws_sess_srtp_t* video_srtp_ctx(lws_sess_t* sess)
+{
+    return (sess->bundle_active && sess->audio_srtp.use_dtls) ? &sess->audio_srtp
+                                                              : &sess->video_srtp;
+}
+
+/**
+ * @brief Send a video datagram: own socket, or the audio transport under BUNDLE
+ * @return 0 on success, -1 on failure
+ */
+static int video_sendto(lws_sess_t* sess, const uint8_t* data, int bytes, int rtcp)
+{
+    const struct sockaddr_in* to = rtcp ? &sess->remote_video_rtcp_addr : &sess->remote_video_addr;
+    int fd = sess->video_socket;
+
+    if (sess->bundle_active) {
+        if (ice_active(sess)) {
+            return lws_ice_send(sess->ice, data, bytes);
+        }
+        if (!sess->remote_rtp_valid) {
+            return -1;
+        }
+        fd = sess->media_socket;
+        to = &sess->remote_rtp_addr;      /* rtcp-mux，含对称RTP锁定的地址 */
+    }
+    if (fd < 0) {
+        return -1;
+    }
+    return sendto(fd, data, bytes, 0, (const struct sockaddr*)to, sizeof(*to)) < 0 ? -1 : 0;
+}
+
+/**
+ * @brief Put a video RTP packet on the wire (pacer output and retransmissions)
+ */
+static int video_transmit(void* param, const uint8_t* packet, int bytes)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    lws_sess_srtp_t* srtp = video_srtp_ctx(sess);
+
+    int n = bytes;
+
+    if (!sess->remote_video_valid) {
+        return 0;
+    }
+
+    /* 发送历史保持明文（NACK重传需要），加密在副本上进行 */
+    if (srtp->tx || srtp->dtls) {
+        if (bytes > LWS_RTX_MAX_PACKET + 2) {
+            return 0;
+        }
+        memcpy(sess->video_srtp_buf, packet, bytes);
+        n = srtp_output(srtp, sess->video_srtp_buf, bytes, sizeof(sess->video_srtp_buf), 0);
+        if (n < 0) {
+            return 0;
+        }
+        packet = sess->video_srtp_buf;
+    }
+
+    if (video_sendto(sess, packet, n, 0) < 0) {
+        lws_log_warn(0, "[SESS] Video RTP send failed: %s\n", strerror(errno));
+        return 0;
+    }
+
+    sess->video_stats.sent_packets++;
+    sess->video_stats.sent_bytes += bytes;
+    sess->video_stats.sent_timestamp = sess->video_timestamp;
+    return 0;
+}
+
+/**
+ * @brief Packet built by the H.264 packetizer: keep for NACK, queue for the pacer
+ */
+static int video_send_packet(void* param, const uint8_t* packet, int bytes)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    return lws_rtx_enqueue(&sess->video_tx, packet, bytes, get_current_time_us());
+}
+
+/**
+ * @brief Send video RTCP feedback (rtcp-mux: to the RTP address)
+ */
+static void video_send_rtcp(lws_sess_t* sess, uint8_t* rtcp, int bytes, int size)
+{
+    if (!sess->remote_video_valid || bytes <= 0) {
+        return;
+    }
+
+    bytes = srtp_output(video_srtp_ctx(sess), rtcp, bytes, size, 1);
+    if (bytes < 0) {
+        return;
+    }
+
+    if (video_sendto(sess, rtcp, bytes, 1) < 0) {
+        lws_log_warn(0, "[SESS] Video RTCP send failed: %s\n", strerror(errno));
+        return;
+    }
+    sess->video_stats.rtcp_sent++;
+}
+
+/**
+ * @brief In-order packet from the reorder buffer: feed the depacketizer
+ */
+static void video_deliver(void* param, const uint8_t* packet, int bytes)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    lws_h264_depack(&sess->video_depacker, packet, bytes);
+}
+
+/**
+ * @brief Reassembled access unit: write to the display device
+ */
+static void video_frame_out(void* param, const uint8_t* data, int bytes,
+                            uint32_t timestamp, int keyframe)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    LWS_UNUSED(keyframe);
+
+    sess->video_stats.recv_timestamp = timestamp;
+    lws_dev_write_video(sess->config.video_display_dev, data, bytes);
+}
+
+/**
+ * @brief packetization-mode of a negotiated H.264 entry
+ */
+static int video_packetization_mode(const lws_sess_codec_t* codec)
+{
+    lws_sdp_str_t fmtp = { codec->fmtp, (int)strlen(codec->fmtp) };
+    lws_sdp_str_t v;
+    return (lws_codec_fmtp_param(fmtp, "packetization-mode", &v) && v.n == 1 &&
+            v.p[0] == '1') ? 1 : 0;
+}
+
+/**
+ * @brief Set up the video stream: offer, packetizer and depacketizer
+ *
+ * 采集设备先预读一帧，以便SDP中携带sprop-parameter-sets；
+ * 该帧在连接后作为第一帧发送。socket在生成SDP时按需打开（BUNDLE时不需要）。
+ */
+static int video_create(lws_sess_t* sess)
+{
+    lws_rtp_payload_t codec = LWS_RTP_PAYLOAD_H264;
+
+    sess->video_socket = -1;
+    if (sess->config.video_codec != LWS_RTP_PAYLOAD_H264) {
+        lws_log_error(LWS_ERR_MEDIA_SDP, "[SESS] Unsupported video codec %d (H.264 only)\n",
+                      (int)sess->config.video_codec);
+        return -1;
+    }
+
+    if (lws_codec_offer(&sess->video_codecs, &codec, 1,
+                        sess->config.video_nack ? LWS_CODEC_AUX_RTX : 0) < 0) {
+        return -1;
+    }
+    sess->video_codec = *lws_codec_primary(&sess->video_codecs);
+    sess->video_active = 1;
+
+    sess->video_ssrc = (uint32_t)rand();
+    sess->video_rtx_ssrc = (uint32_t)rand();
+    sess->video_timestamp = (uint32_t)rand();
+
+    if (sess->config.video_capture_dev) {
+        sess->video_frame = (uint8_t*)lws_malloc(LWS_MAX_VIDEO_FRAME_SIZE);
+        if (!sess->video_frame) {
+            return -1;
+        }
+        lws_h264_packer_init(&sess->video_packer, sess->video_codec.send_pt,
+                             video_packetization_mode(&sess->video_codec),
+                             sess->video_ssrc, (uint16_t)rand(), LWS_SESS_RTP_MTU,
+                             video_send_packet, sess);
+        if (lws_rtx_sender_init(&sess->video_tx, LWS_SESS_VIDEO_HISTORY, sess->video_ssrc,
+                                video_transmit, sess) != 0) {
+            return -1;
+        }
+        lws_rtx_sender_set_rtx(&sess->video_tx, -1, sess->video_rtx_ssrc, (uint16_t)rand());
+
+        int n = lws_dev_read_video(sess->config.video_capture_dev, sess->video_frame,
+                                   LWS_MAX_VIDEO_FRAME_SIZE);
+        if (n > 0) {
+            sess->video_frame_len = n;
+            lws_h264_scan(&sess->video_packer.params, sess->video_frame, n);
+        }
+    }
+
+    if (sess->config.video_display_dev) {
+        if (lws_h264_depacker_init(&sess->video_depacker, LWS_MAX_VIDEO_FRAME_SIZE,
+                                   video_frame_out, sess) != 0 ||
+            lws_rtx_receiver_init(&sess->video_rx, LWS_SESS_VIDEO_REORDER, sess->video_ssrc,
+                                  video_deliver, sess) != 0) {
+            return -1;
+        }
+    }
+
+    lws_log_info("[SESS] Video stream created (H.264)");
+    return 0;
+}
+
+/**
+ * @brief Open the video socket (offer, or answer without BUNDLE)
+ */
+static int video_open_socket(lws_sess_t* sess)
+{
+    sess->video_socket = acquire_media_socket(sess->config.sock_pool, &sess->video_port);
+    if (sess->video_socket < 0) {
+        lws_log_warn(0, "[SESS] No video socket, video stream rejected\n");
+        return -1;
+    }
+    lws_log_info("[SESS] Video stream on port %d", sess->video_port);
+    return 0;
+}
+
+static void video_destroy(lws_sess_t* sess)
+{
+    if (sess->video_frame) {
+        lws_free(sess->video_frame);
+        sess->video_frame = NULL;
+    }
+    lws_h264_depacker_free(&sess->video_depacker);
+    lws_rtx_sender_free(&sess->video_tx);
+    lws_rtx_receiver_free(&sess->video_rx);
+    if (sess->video_socket >= 0) {
+        close(sess->video_socket);
+        sess->video_socket = -1;
+    }
+}
+
+/**
+ * @brief Advertise the capture stream's SPS/PPS as sprop-parameter-sets
+ */
+static void video_update_sprop(lws_sess_t* sess)
+{
+    int i;
+
+    for (i = 0; i < sess->video_codecs.count; i++) {
+        lws_sess_codec_t* e = &sess->video_codecs.entries[i];
+        if (e->codec == LWS_RTP_PAYLOAD_H264 &&
+            lws_h264_fmtp_write(&sess->video_packer.params, e->fmtp, sizeof(e->fmtp)) != 0) {
+            lws_log_warn(0, "[SESS] sprop-parameter-sets too long, sending in-band only\n");
+        }
+    }
+}
+
+/**
+ * @brief Apply a remote m=video section (NULL = no video offered/answered)
+ *
+ * 协商失败或对端不支持视频时，本端SDP以端口0拒绝该流。
+ * BUNDLE被接受时视频改走音频的传输，视频socket随即释放；对端不支持时
+ * 回落到独立端口。
+ */
+static void apply_remote_video(lws_sess_t* sess, const lws_sdp_t* sdp,
+                               const lws_sdp_media_t* video)
+{
+    lws_codec_table_t codecs;
+    const lws_sess_codec_t* primary;
+    const lws_sess_codec_t* rtx;
+    const lws_sdp_fmt_t* fmt;
+    const lws_sdp_conn_t* conn;
+    char conn_ip[LWS_MAX_IP_LEN];
+    lws_sdp_str_t sprop;
+    lws_sdp_str_t fp;
+    lws_sdp_str_t setup;
+    int bundled = 0;
+    int ret = -1;
+
+    if (video && video->port != 0) {
+        if (sess->local_offer_pending) {
+            codecs = sess->video_codecs;
+            ret = lws_codec_apply_answer(&codecs, video);
+        } else {
+            lws_rtp_payload_t codec = LWS_RTP_PAYLOAD_H264;
+            ret = lws_codec_answer(&codecs, &codec, 1,
+                                   sess->config.video_nack ? LWS_CODEC_AUX_RTX : 0, video);
+        }
+        bundled = ret >= 0 && bundle_negotiate(sess, sdp, video);
+        if (ret >= 0 && bundled && sess->config.srtp_mode != LWS_SRTP_MODE_OFF &&
+            lws_sdp_media_dtls(sdp, video, &fp, &setup)) {
+            /* 视频由音频m=行的DTLS关联加密 (RFC 8843 §12)，不单独握手 */
+            srtp_dtls_close(&sess->video_srtp);
+            sess->video_srtp.use_dtls = 1;
+            if (!sess->local_offer_pending) {
+                lws_sdp_str_copy(sess->video_srtp.proto, sizeof(sess->video_srtp.proto),
+                                 video->proto);
+            }
+        } else if (ret >= 0) {
+            ret = srtp_apply(sess, &sess->video_srtp, sdp, video, "Video");
+        }
+    }
+    if (ret < 0) {
+        if (sess->video_active) {
+            lws_log_info("[SESS] Video stream rejected");
+        }
+        sess->video_active = 0;
+        sess->remote_video_valid = 0;
+        sess->bundle_active = 0;
+        return;
+    }
+
+    if (bundled != sess->bundle_active) {
+        lws_log_info("[SESS] BUNDLE %s", bundled ? "accepted: video on the audio transport"
+                                                 : "not used: video on its own port");
+        sess->bundle_active = bundled;
+    }
+    if (video->ssrc != 0) {
+        sess->remote_video_ssrc = video->ssrc;
+    }
+
+    primary = lws_codec_primary(&codecs);
+    sess->video_codecs = codecs;
+    sess->video_codec = *primary;
+    sess->video_active = 1;
+
+    /* 打包器继承SSRC/序号，只更新PT和打包模式 */
+    sess->video_packer.pt = primary->send_pt;
+    sess->video_packer.mode = video_packetization_mode(primary);
+
+    /* 对端在SDP中声明的参数集，用于补全缺少带内SPS/PPS的IDR */
+    fmt = lws_sdp_find_fmt(video, primary->send_pt);
+    if (fmt && sess->video_depacker.buf &&
+        lws_codec_fmtp_param(fmt->fmtp, "sprop-parameter-sets", &sprop)) {
+        lws_h264_sprop_read(&sess->video_depacker.params, sprop.p, sprop.n);
+    }
+
+    /* 双方都声明的反馈类型 (RFC 4585 §4.2)；RTX以独立SSRC/PT重传 */
+    sess->video_fb = (fmt && sess->config.video_nack) ? fmt->rtcp_fb : 0;
+    rtx = sess->config.video_nack ? lws_codec_find(&codecs, LWS_RTP_PAYLOAD_RTX, 0) : NULL;
+    if (sess->video_tx.slots) {
+        lws_rtx_sender_set_rtx(&sess->video_tx, rtx ? rtx->send_pt : -1,
+                               sess->video_rtx_ssrc, sess->video_tx.rtx_seq);
+    }
+    if (sess->video_rx.slots) {
+        sess->video_rx.rtx_pt = rtx ? rtx->recv_pt : -1;
+        sess->video_rx.apt = primary->recv_pt;
+        sess->video_rx.nack = (sess->video_fb & LWS_SDP_FB_NACK) != 0;
+        sess->video_rx.wait_us = sess->video_rx.nack ? LWS_RTX_WAIT_US : LWS_RTX_REORDER_US;
+    }
+
+    if (bundled) {
+        /* 对端不再向视频端口发送，释放socket（answerer不会打开它） */
+        if (sess->video_socket >= 0) {
+            close(sess->video_socket);
+            sess->video_socket = -1;
+        }
+        sess->remote_video_valid = 1;
+        lws_log_info("[SESS] Remote video: bundled (mid %s, MID extension %d), PT %d, "
+                     "packetization-mode=%d, RTX PT %d, fb 0x%x",
+                     sess->video_mid, sess->mid_ext_id, primary->send_pt,
+                     sess->video_packer.mode, rtx ? rtx->send_pt : -1, sess->video_fb);
+        return;
+    }
+
+    conn = lws_sdp_media_conn(sdp, video);
+    lws_sdp_str_copy(conn_ip, sizeof(conn_ip), conn->addr);
+    memset(&sess->remote_video_addr, 0, sizeof(sess->remote_video_addr));
+    sess->remote_video_addr.sin_family = AF_INET;
+    sess->remote_video_addr.sin_port = htons(video->port);
+    sess->remote_video_valid =
+        lws_sdp_str_eq(conn->addrtype, "IP4") &&
+        inet_pton(AF_INET, conn_ip, &sess->remote_video_addr.sin_addr) == 1 &&
+        sess->remote_video_addr.sin_addr.s_addr != INADDR_ANY;
+
+    /* 未声明rtcp-mux的对端：RTCP发往a=rtcp端口或RTP端口+1 */
+    sess->remote_video_rtcp_addr = sess->remote_video_addr;
+    if (!video->rtcp_mux) {
+        sess->remote_video_rtcp_addr.sin_port =
+            htons(video->rtcp_port ? video->rtcp_port : (uint16_t)(video->port + 1));
+    }
+
+    lws_log_info("[SESS] Remote video: %s:%u, PT %d, packetization-mode=%d, RTX PT %d, fb 0x%x",
+                 conn_ip, (unsigned)video->port, primary->send_pt, sess->video_packer.mode,
+                 rtx ? rtx->send_pt : -1, sess->video_fb);
+}
+
+/**
+ * @brief Peer asked for a keyframe (PLI/FIR)
+ */
+static void video_keyframe_request(lws_sess_t* sess)
+{
+    if (lws_dev_request_keyframe(sess->config.video_capture_dev) != 0) {
+        lws_log_debug("[SESS] Keyframe requested, capture device cannot force one");
+    }
+}
+
+/**
+ * @brief Whether a video RTP packet is wanted (receiving, known PT)
+ */
+static int video_rtp_wanted(const lws_sess_t* sess, const uint8_t* data)
+{
+    return media_dir_can_recv(sess->active_dir) && sess->video_rx.slots &&
+           ((data[1] & 0x7f) == sess->video_codec.recv_pt ||
+            (data[1] & 0x7f) == sess->video_rx.rtx_pt);
+}
+
+/**
+ * @brief Unprotected video RTP/RTCP, from the video socket or demultiplexed by BUNDLE
+ */
+static void video_input(lws_sess_t* sess, uint8_t* data, int bytes, int rtcp, uint64_t now)
+{
+    if (rtcp) {
+        sess->video_stats.rtcp_recv++;
+        if (sess->video_tx.slots &&
+            lws_rtx_feedback(&sess->video_tx, data, bytes, now) & LWS_RTX_KEYFRAME) {
+            video_keyframe_request(sess);
+        }
+        return;
+    }
+
+    if (!video_rtp_wanted(sess, data)) {
+        return;
+    }
+    sess->video_stats.recv_packets++;
+    sess->video_stats.recv_bytes += bytes;
+    lws_rtx_receive(&sess->video_rx, data, bytes, now);
+}
+
+/**
+ * @brief Read received video packets (RTP and muxed RTCP) and send feedback
+ *
+ * RTP经重排序缓冲交给解包器；缺包由lws_rtx_receiver_poll发NACK，
+ * 解包器等待IDR期间定期发PLI。BUNDLE时包由媒体socket分流进来，这里只发反馈。
+ */
+static void video_receive(lws_sess_t* sess)
+{
+    uint8_t buffer[2048];
+    uint8_t rtcp[256];
+    uint64_t now = get_current_time_us();
+    int n;
+
+    while (sess->video_socket >= 0) {
+        ssize_t bytes = recv(sess->video_socket, buffer, sizeof(buffer), 0);
+        int is_rtcp;
+
+        if (bytes <= 0) {
+            break;
+        }
+        if (LWS_DTLS_IS_RECORD(buffer[0])) {
+            srtp_dtls_input(sess, &sess->video_srtp, buffer, (int)bytes, "Video");
+            continue;
+        }
+        if (bytes < 12) {
+            continue;
+        }
+
+        /* RTCP与RTP复用同一端口 (RFC 5761 §4)：PT 192-223为RTCP */
+        is_rtcp = buffer[1] >= 192 && buffer[1] <= 223;
+        if (!is_rtcp && !video_rtp_wanted(sess, buffer)) {
+            continue;
+        }
+
+        bytes = srtp_input(sess, &sess->video_srtp, buffer, (int)bytes, is_rtcp);
+        if (bytes < 0) {
+            continue;
+        }
+        video_input(sess, buffer, (int)bytes, is_rtcp, now);
+    }
+
+    if (!sess->video_rx.slots) {
+        return;
+    }
+
+    n = lws_rtx_receiver_poll(&sess->video_rx, now, rtcp, sizeof(rtcp) - LWS_SRTP_MAX_TRAILER);
+    video_send_rtcp(sess, rtcp, n, sizeof(rtcp));
+
+    /* 丢包后等待关键帧：按间隔请求 */
+    if (sess->video_depacker.wait_idr && sess->video_rx.started &&
+        (sess->video_fb & LWS_SDP_FB_PLI) &&
+        now - sess->video_pli_us >= LWS_SESS_PLI_INTERVAL_US) {
+        n = lws_rtx_pli_write(sess->video_ssrc, sess->video_rx.media_ssrc, rtcp,
+                              sizeof(rtcp) - LWS_SRTP_MAX_TRAILER);
+        video_send_rtcp(sess, rtcp, n, sizeof(rtcp));
+        sess->video_pli_us = now;
+    }
+}
+
+/**
+ * @brief Capture the next frame when it is due (video_fps, 90 kHz clock) and pace packets out
+ *
+ * 一帧的包先进入发送队列，在LWS_SESS_VIDEO_PACE_PCT的帧间隔内匀速发出，
+ * 避免关键帧突发溢出交换机缓冲。
+ */
+static void video_send(lws_sess_t* sess, uint64_t now)
+{
+    int fps = sess->config.video_fps > 0 ? sess->config.video_fps : LWS_DEFAULT_VIDEO_FPS;
+    uint64_t interval = 1000000ULL / fps;
+    int n;
+
+    if (sess->video_next_us == 0) {
+        sess->video_next_us = now;
+    }
+
+    if (now >= sess->video_next_us) {
+        /* 落后超过一帧时重新对齐，不补发 */
+        sess->video_next_us = now - sess->video_next_us > interval ?
+                              now + interval : sess->video_next_us + interval;
+
+        n = sess->video_frame_len;
+        if (n == 0) {
+            n = lws_dev_read_video(sess->config.video_capture_dev, sess->video_frame,
+                                   LWS_MAX_VIDEO_FRAME_SIZE);
+        }
+        sess->video_frame_len = 0;
+
+        if (n > 0 && sess->video_active && media_dir_can_send(sess->active_dir)) {
+            if (lws_h264_pack(&sess->video_packer, sess->video_frame, n,
+                              sess->video_timestamp) < 0) {
+                lws_log_warn(0, "[SESS] Video frame not fully sent (%d bytes)\n", n);
+            }
+            lws_rtx_pace_frame(&sess->video_tx, interval * LWS_SESS_VIDEO_PACE_PCT / 100);
+        }
+        sess->video_timestamp += LWS_SESS_VIDEO_CLOCK / fps;
+    }
+
+    lws_rtx_pace(&sess->video_tx, now);
+}
+
+/* ========================================
+ * RTP Callbacks
+ * ======================================== */
+
+/**
+ * @brief RTCP message callback
+ */
+static void on_rtcp_message(void* param, const struct rtcp_msg_t* msg)
+{
+    LWS_UNUSED(param);
+    LWS_UNUSED(msg);
+
+    lws_log_debug("[SESS] RTCP message received");
+}
+
+/**
+ * @brief RTP payload allocator
+ */
+static void* rtp_alloc(void* param, int bytes)
+{
+    (void)param;
+    /* 预留SRTP认证标签空间，rtp_send_packet原地加密 */
+    return lws_malloc(bytes + LWS_SRTP_MAX_TRAILER);
+}
+
+/**
+ * @brief RTP payload free
+ */
+static void rtp_free(void* param, void *packet)
+{
+    (void)param;
+    lws_free(packet);
+}
+
+/**
+ * @brief RTP packet callback - called when a decoded packet is ready
+ */
+static int rtp_packet(void* param, const void *packet, int bytes,
+                      uint32_t timestamp, int flags)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    LWS_UNUSED(flags);
+
+    lws_log_debug("[SESS] RTP packet decoded: %d bytes, ts=%u",
+                  bytes, timestamp);
+
+    const int16_t* pcm = (const int16_t*)packet;
+    int samples = bytes / 2; /* Assuming 16-bit PCM */
+    int frame_samples = sess->config.audio_sample_rate * LWS_DEFAULT_FRAME_DURATION / 1000;
+
+    if (sess->rec_passthrough) {
+        record_packet(sess, (const uint8_t*)packet, bytes, timestamp);
+    }
+
+    /*
+     * Write to playback (and echo reference) and recording devices.
+     * ptime大于帧长的包拆回20ms帧，回声参考与采集帧对齐
+     */
+    while (samples > 0) {
+        int n = frame_samples > 0 ? LWS_MIN(samples, frame_samples) : samples;
+        audio_playout(sess, pcm, n, timestamp);
+        pcm += n;
+        samples -= n;
+        timestamp += (uint32_t)n;
+    }
+
+    /* Update statistics */
+    sess->audio_stats.recv_packets++;
+    sess->audio_stats.recv_bytes += bytes;
+    sess->audio_stats.recv_timestamp = timestamp;
+
+    return 0;
+}
+
+/**
+ * @brief RTP encoder packet callback - send a packetized RTP packet
+ *
+ * packet后至少有LWS_SRTP_MAX_TRAILER字节可写（rtp_alloc / audio_send_raw）。
+ */
+static int rtp_send_packet(void* param, const void *data, int bytes,
+                           uint32_t timestamp, int flags)
+{
+    lws_sess_t* sess = (lws_sess_t*)param;
+    uint8_t* packet = (uint8_t*)data;   /* 由rtp_alloc分配，可写 */
+    int audio = bytes >= 12 && (packet[1] & 0x7f) == sess->audio_codec.send_pt;
+    int wire;
+    LWS_UNUSED(flags);
+
+    /* 静音(DTX)后的第一个音频包置M位 */
+    if (sess->audio_talkspurt && audio) {
+        packet[1] |= 0x80;
+        sess->audio_talkspurt = 0;
+    }
+
+    /* RED：音频帧附带之前的帧；telephone-event/CN占用序号，打断冗余历史 */
+    if (sess->red_tx.pt >= 0) {
+        if (audio) {
+            int n = lws_red_encode(&sess->red_tx, packet, bytes, sess->red_buf, LWS_RED_MAX_PACKET);
+            if (n > 0) {
+                packet = sess->red_buf;
+                bytes = n;
+            }
+        } else {
+            lws_red_sender_reset(&sess->red_tx);
+        }
+    }
+
+    /* 加密不改变RTP头，rtp_onsend仍按明文长度统计 */
+    wire = srtp_output(&sess->audio_srtp, packet, bytes,
+                       bytes + LWS_SRTP_MAX_TRAILER, 0);
+    if (wire < 0) {
+        return 0;
+    }
+
+    if (ice_active(sess)) {
+        if (lws_ice_send(sess->ice, packet, wire) != 0) {
+            return 0;               /* 未选定候选对或consent丢失 */
+        }
+    } else if (sess->remote_rtp_valid && sess->media_socket >= 0) {
+        ssize_t sent = sendto(sess->media_socket, packet, wire, 0,
+                              (struct sockaddr*)&sess->remote_rtp_addr,
+                              sizeof(sess->remote_rtp_addr));
+        if (sent < 0) {
+            lws_log_warn(0, "[SESS] RTP send failed: %s\n", strerror(errno));
+            return 0;
+        }
+    } else {
+        /* 远端地址未知（如c=0.0.0.0保持），丢弃 */
+        return 0;
+    }
+
+    if (sess->rtp) {
+        rtp_onsend(sess->rtp, packet, bytes);
+    }
+
+    sess->audio_stats.sent_packets++;
+    sess->audio_stats.sent_bytes += bytes;
+    sess->audio_stats.sent_timestamp = timestamp;
+
+    return 0;
+}
+
+/* ========================================
+ * Audio packetization time
+ * ======================================== */
+
+static int audio_maxptime(const lws_sess_t* sess)
+{
+    return sess->config.audio_maxptime > 0 ? sess->config.audio_maxptime
+                                           : LWS_SESS_DEFAULT_MAXPTIME;
+}
+
+/**
+ * @brief Choose the send ptime for the current codec and the peer's a=ptime/a=maxptime
+ */
+static void audio_ptime_apply(lws_sess_t* sess, int remote_ptime, int remote_maxptime)
+{
+    lws_codec_ptime_policy_t policy;
+    int ptime;
+
+    policy.frame_ms = LWS_DEFAULT_FRAME_DURATION;
+    policy.frame_bytes = sess->config.audio_sample_rate * LWS_DEFAULT_FRAME_DURATION / 1000 * 2;
+    policy.header_bytes = LWS_SESS_PTIME_HEADER;
+    policy.max_payload = LWS_SESS_PACK_MAX_SAMPLES * 2;
+    policy.overhead_pct = LWS_SESS_PTIME_OVERHEAD_PCT;
+    policy.max_ptime = audio_maxptime(sess);
+    policy.preferred = sess->config.audio_ptime;
+
+    ptime = lws_codec_ptime(sess->audio_codec.codec, &policy, remote_ptime, remote_maxptime);
+    if (ptime != sess->audio_ptime) {
+        lws_log_info("[SESS] Audio ptime %d ms (peer ptime %d, maxptime %d)\n",
+                     ptime, remote_ptime, remote_maxptime);
+        sess->audio_ptime = ptime;
+        sess->audio_pack_frames = ptime / LWS_DEFAULT_FRAME_DURATION;
+    }
+}
+
+/**
+ * @brief Send the frames waiting for a multi-frame packet
+ */
+static void audio_pack_flush(lws_sess_t* sess)
+{
+    if (sess->audio_pack_samples > 0 && sess->audio_encoder && !sess->audio_encoder_paused) {
+        rtp_payload_encode_input(sess->audio_encoder, sess->audio_pack_buf,
+                                 sess->audio_pack_samples * 2, /* bytes */
+                                 sess->audio_pack_timestamp);
+    }
+    sess->audio_pack_count = 0;
+    sess->audio_pack_samples = 0;
+}
+
+/**
+ * @brief Queue a processed frame; a packet goes out every audio_pack_frames frames
+ *
+ * 采集、语音处理与VAD仍按20ms帧进行，这里把连续的帧拼成一个RTP包，
+ * 以第一帧的timestamp发送。
+ */
+static void audio_pack_input(lws_sess_t* sess, const int16_t* pcm, int samples,
+                             uint32_t timestamp)
+{
+    if (sess->audio_pack_samples + samples > LWS_SESS_PACK_MAX_SAMPLES) {
+        audio_pack_flush(sess);
+    }
+
+    if (sess->audio_pack_frames <= 1 || samples > LWS_SESS_PACK_MAX_SAMPLES) {
+        audio_pack_flush(sess);
+        rtp_payload_encode_input(sess->audio_encoder, pcm, samples * 2, timestamp);
+        return;
+    }
+
+    if (sess->audio_pack_samples == 0) {
+        sess->audio_pack_timestamp = timestamp;
+    }
+    memcpy(sess->audio_pack_buf + sess->audio_pack_samples, pcm, samples * sizeof(int16_t));
+    sess->audio_pack_samples += samples;
+    if (++sess->audio_pack_count >= sess->audio_pack_frames) {
+        audio_pack_flush(sess);
+    }
+}
+
+/* ========================================
+ * SDP Generation
+ * ======================================== */
+
+/**
+ * @brief Default candidate for c=/m=: first server-reflexive, else first host
+ * @return 0 on success, -1 without ICE candidates
+ */
+static int ice_default_addr(lws_sess_t* sess, struct sockaddr_in* addr)
+{
+    const lws_ice_cand_t* cands;
+    int count = lws_ice_local_candidates(sess->ice, &cands);
+    int i;
+
+    if (count == 0) {
+        return -1;
+    }
+    *addr = cands[0].addr;
+    for (i = 0; i < count; i++) {
+        if (cands[i].type == LWS_ICE_CAND_SRFLX) {
+            *addr = cands[i].addr;
+            break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief a=ice-ufrag/ice-pwd and the local candidates gathered so far
+ */
+static int ice_write_sdp(lws_sess_t* sess, char* buf, int size)
+{
+    const lws_ice_cand_t* cands;
+    char line[LWS_ICE_CAND_SIZE];
+    int count;
+    int len;
+    int n;
+    int i;
+
+    if (!sess->ice) {
+        return 0;
+    }
+
+    /* ICE只用component 1，RTCP复用（a=rtcp-mux由调用者写入） */
+    len = snprintf(buf, size, "a=ice-ufrag:%s\r\na=ice-pwd:%s\r\n%s",
+                   sess->local_ice_ufrag, sess->local_ice_pwd,
+                   sess->config.trickle_ice ? "a=ice-options:trickle\r\n" : "");
+    if (len < 0 || len >= size) return -1;
+
+    count = lws_ice_local_candidates(sess->ice, &cands);
+    for (i = 0; i < count; i++) {
+        if (lws_ice_cand_write(&cands[i], line, sizeof(line)) < 0) {
+            continue;
+        }
+        n = snprintf(buf + len, size - len, "a=%s\r\n", line);
+        if (n < 0 || n >= size - len) return -1;
+        len += n;
+    }
+
+    /* RFC 8840 §4.1 */
+    if (sess->config.trickle_ice && lws_ice_gathering_done(sess->ice)) {
+        n = snprintf(buf + len, size - len, "a=end-of-candidates\r\n");
+        if (n < 0 || n >= size - len) return -1;
+        len += n;
+    }
+    return len;
+}
+
+/**
+ * @brief a=mid, the MID header extension and a=ssrc of a bundled m= line
+ */
+static int bundle_write_sdp(const lws_sess_t* sess, const char* mid, uint32_t ssrc,
+                            char* buf, int size)
+{
+    int len;
+    int n;
+
+    len = snprintf(buf, size, "a=mid:%s\r\n", mid);
+    if (len < 0 || len >= size) return -1;
+
+    if (sess->mid_ext_id) {
+        n = snprintf(buf + len, size - len, "a=extmap:%d %s\r\n", sess->mid_ext_id,
+                     LWS_SDP_EXT_MID);
+        if (n < 0 || n >= size - len) return -1;
+        len += n;
+    }
+
+    /* 本端不发送MID头扩展：对端按a=ssrc分流 (RFC 8843 §9.2) */
+    n = snprintf(buf + len, size - len, "a=ssrc:%u cname:lwsip-%llx\r\n", ssrc,
+                 (unsigned long long)sess->sdp_session_id);
+    if (n < 0 || n >= size - len) return -1;
+    return len + n;
+}
+
+/**
+ * @brief Generate local SDP with ICE candidates
+ *
+ * o=行的sess-id在会话内固定；仅当o=之后的内容变化时sess-version加一
+ * (RFC 3264 §8)，使re-INVITE/UPDATE应答中未变化的SDP保持相同版本。
+ */
+static int generate_local_sdp(lws_sess_t* sess)
+{
+    char body[LWS_SESS_MAX_SDP_SIZE];
+    char* p = body;
+    int remain = sizeof(body);
+    int n;
+
+    /* 视频独立端口只在未BUNDLE时打开：接受BUNDLE的answerer从不需要它 */
+    if (sess->video_active && !sess->bundle_active && sess->video_socket < 0 &&
+        video_open_socket(sess) != 0) {
+        sess->video_active = 0;
+        sess->remote_video_valid = 0;
+    }
+    int bundle = bundle_in_sdp(sess);
+
+    /* Get local IP address for SDP */
+    struct sockaddr_in local_addr;
+    char local_ip[INET_ADDRSTRLEN];
+    uint16_t audio_port = sess->local_port;
+    if (ice_default_addr(sess, &local_addr) == 0) {
+        /* ICE默认候选（RFC 8445 §5.1.4：优先srflx，非ICE对端也可达） */
+        inet_ntop(AF_INET, &local_addr.sin_addr, local_ip, sizeof(local_ip));
+        audio_port = ntohs(local_addr.sin_port);
+    } else if (get_local_ipv4(&local_addr) == 0) {
+        inet_ntop(AF_INET, &local_addr.sin_addr, local_ip, sizeof(local_ip));
+    } else {
+        /* Fallback to 0.0.0.0 if we can't get local IP */
+        strcpy(local_ip, "0.0.0.0");
+        lws_log_warn(0, "[SESS] Failed to get local IP for SDP, using 0.0.0.0\n");
+    }
+
+    /* Session-level lines after o= (a=ice-lite须在会话级, RFC 8839 §5.3) */
+    n = snprintf(p, remain,
+        "s=lwsip media session\r\n"
+        "c=IN IP4 %s\r\n"
+        "t=0 0\r\n"
+        "%s",
+        local_ip, sess->ice && sess->config.ice_lite ? "a=ice-lite\r\n" : "");
+
+    if (n < 0 || n >= remain) return -1;
+    p += n; remain -= n;
+
+    /* 音频m=行为BUNDLE的标记行：共用其地址、端口与ICE候选 */
+    if (bundle) {
+        n = snprintf(p, remain, "a=group:BUNDLE %s %s\r\n", sess->audio_mid, sess->video_mid);
+        if (n < 0 || n >= remain) return -1;
+        p += n; remain -= n;
+    }
+
+    /* Audio media line - use real socket port instead of dummy port 9 */
+    if (sess->config.enable_audio) {
+        /* Media line with rtpmap/fmtp of every offered or negotiated codec */
+        n = lws_codec_write_sdp(&sess->audio_codecs, "audio", audio_port,
+                                sess->audio_srtp.proto, p, remain);
+        if (n < 0) return -1;
+        p += n; remain -= n;
+
+        /* a=ptime只在配置时声明；a=maxptime为本端接收的上限（多帧包拆帧播放） */
+        if (sess->config.audio_ptime > 0) {
+            n = snprintf(p, remain, "a=ptime:%d\r\n", sess->config.audio_ptime);
+            if (n < 0 || n >= remain) return -1;
+            p += n; remain -= n;
+        }
+        n = snprintf(p, remain, "a=maxptime:%d\r\n", audio_maxptime(sess));
+        if (n < 0 || n >= remain) return -1;
+        p += n; remain -= n;
+
+        n = srtp_write_sdp(sess, &sess->audio_srtp, p, remain);
+        if (n < 0) return -1;
+        p += n; remain -= n;
+
+        n = snprintf(p, remain, "a=%s\r\n", media_dir_name(sess->active_dir));
+        if (n < 0 || n >= remain) return -1;
+        p += n; remain -= n;
+
+        /*
+         * RTCP与RTP共用媒体socket：不支持rtcp-mux的对端也发往同一端口 (RFC 3605)。
+         * a=rtcp-mux在offer中总是提供，answer中仅当对端offer提供时 (RFC 5761 §5.1.1)
+         */
+        n = snprintf(p, remain, "a=rtcp:%u\r\n%s", (unsigned)audio_port,
+                     !sess->remote_sdp_applied || sess->remote_mux_attr ? "a=rtcp-mux\r\n" : "");
+        if (n < 0 || n >= remain) return -1;
+        p += n; remain -= n;
+
+        if (bundle) {
+            n = bundle_write_sdp(sess, sess->audio_mid, sess->audio_ssrc, p, remain);
+            if (n < 0) return -1;
+            p += n; remain -= n;
+        }
+
+        /* 未启用ICE时不添加 ICE 属性，适用于服务器中转模式 */
+        n = ice_write_sdp(sess, p, remain);
+        if (n < 0) return -1;
+        p += n; remain -= n;
+    }
+
+    /* Video media line (H.264 with sprop-parameter-sets once SPS/PPS are known) */
+    if (sess->config.enable_video) {
+        video_update_sprop(sess);
+        n = lws_codec_write_sdp(&sess->video_codecs, "video",
+                                !sess->video_active ? 0 :
+                                sess->bundle_active ? audio_port : sess->video_port,
+                                sess->video_srtp.proto, p, remain);
+        if (n < 0) return -1;
+        p += n; remain -= n;
+
+        if (sess->video_active) {
+            n = srtp_write_sdp(sess, video_srtp_ctx(sess), p, remain);
+            if (n < 0) return -1;
+            p += n; remain -= n;
+        }
+
+        n = snprintf(p, remain, "a=%s\r\n", media_dir_name(sess->active_dir));
+        if (n < 0 || n >= remain) return -1;
+        p += n; remain -= n;
+
+        /* 反馈类型：offer全部列出，answer只保留对端offer中的 */
+        if (sess->config.video_nack && sess->video_active) {
+            static const struct { int flag; const char* name; } fbs[] = {
+                { LWS_SDP_FB_NACK, "nack" },
+                { LWS_SDP_FB_PLI,  "nack pli" },
+                { LWS_SDP_FB_FIR,  "ccm fir" },
+            };
+            int fb = sess->remote_sdp_applied ? sess->video_fb :
+                     LWS_SDP_FB_NACK | LWS_SDP_FB_PLI | LWS_SDP_FB_FIR;
+            size_t i;
+
+            for (i = 0; i < sizeof(fbs) / sizeof(fbs[0]); i++) {
+                if (!(fb & fbs[i].flag)) {
+                    continue;
+                }
+                n = snprintf(p, remain, "a=rtcp-fb:%d %s\r\n",
+                             sess->video_codec.recv_pt, fbs[i].name);
+                if (n < 0 || n >= remain) return -1;
+                p += n; remain -= n;
+            }
+        }
+        if (sess->video_active) {
+            n = snprintf(p, remain, "a=rtcp-mux\r\n");
+            if (n < 0 || n >= remain) return -1;
+            p += n; remain -= n;
+        }
+        if (bundle) {
+            n = bundle_write_sdp(sess, sess->video_mid, sess->video_ssrc, p, remain);
+            if (n < 0) return -1;
+            p += n; remain -= n;
+        }
+    }
+
+    /* 尚未收到远端SDP时生成的是offer，远端SDP按answer处理 */
+    if (!sess->remote_sdp_applied) {
+        sess->local_offer_pending = 1;
+    }
+
+    /* Bump sess-version only when the description actually changed */
+    if (sess->local_sdp[0] && strcmp(sess->local_sdp + sess->local_sdp_body, body) != 0) {
+        sess->sdp_version++;
+    }
+
+    /* SDP header with real local IP */
+    n = snprintf(sess->local_sdp, sizeof(sess->local_sdp),
+        "v=0\r\n"
+        "o=lwsip %llu %llu IN IP4 %s\r\n",
+        (unsigned long long)sess->sdp_session_id,
+        (unsigned long long)sess->sdp_version,
+        local_ip);
+
+    if (n < 0 || n + (int)(p - body) >= (int)sizeof(sess->local_sdp)) {
+        sess->local_sdp[0] = '\0';
+        return -1;
+    }
+    sess->local_sdp_body = (size_t)n;
+    memcpy(sess->local_sdp + n, body, (size_t)(p - body) + 1);
+
+    lws_log_info("[SESS] Generated local SDP (%d bytes)",
+                 (int)strlen(sess->local_sdp));
+    lws_log_info("[SESS] Local SDP:\n%s", sess->local_sdp);
+
+    return 0;
+}
+
+/* ========================================
+ * Media socket pool
+ * ======================================== */
+
+/**
+ * @brief Create a non-blocking UDP socket bound to an ephemeral port
+ */
+static int open_media_socket(uint16_t* port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        lws_log_error(0, "[SESS] Failed to create media socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    /* Set non-blocking */
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    /* Bind to any port (OS will assign) */
+    struct sockaddr_in local_addr;
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_addr.s_addr = INADDR_ANY;
+    local_addr.sin_port = 0;  /* Let OS assign port */
+
+    if (bind(fd, (struct sockaddr*)&local_addr, sizeof(local_addr)) < 0) {
+        lws_log_error(0, "[SESS] Failed to bind media socket: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    /* Get the assigned port */
+    socklen_t addr_len = sizeof(local_addr);
+    if (getsockname(fd, (struct sockaddr*)&local_addr, &addr_len) == 0) {
+        *port = ntohs(local_addr.sin_port);
+    } else {
+        lws_log_warn(0, "[SESS] Failed to get local port\n");
+        *port = 0;
+    }
+
+    return fd;
+}
+
+lws_sess_sock_pool_t* lws_sess_sock_pool_create(int capacity)
+{
+    if (capacity <= 0) {
+        return NULL;
+    }
+
+    lws_sess_sock_pool_t* pool = (lws_sess_sock_pool_t*)lws_calloc(1, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+
+    pool->fds = (int*)lws_calloc((size_t)capacity, sizeof(int));
+    pool->ports = (uint16_t*)lws_calloc((size_t)capacity, sizeof(uint16_t));
+    if (!pool->fds || !pool->ports) {
+        lws_free(pool->fds);
+        lws_free(pool->ports);
+        lws_free(pool);
+        return NULL;
+    }
+
+    pool->capacity = capacity;
+    lws_sess_sock_pool_fill(pool);
+    return pool;
+}
+
+void lws_sess_sock_pool_destroy(lws_sess_sock_pool_t* pool)
+{
+    if (!pool) {
+        return;
+    }
+
+    while (pool->count > 0) {
+        close(pool->fds[--pool->count]);
+    }
+
+    lws_free(pool->fds);
+    lws_free(pool->ports);
+    lws_free(pool);
+}
+
+int lws_sess_sock_pool_fill(lws_sess_sock_pool_t* pool)
+{
+    if (!pool) {
+        return 0;
+    }
+
+    while (pool->count < pool->capacity) {
+        uint16_t port;
+        int fd = open_media_socket(&port);
+        if (fd < 0) {
+            break;
+        }
+        pool->fds[pool->count] = fd;
+        pool->ports[pool->count] = port;
+        pool->count++;
+    }
+
+    return pool->count;
+}
+
+/**
+ * @brief Take a socket from the pool, or open one if the pool is empty
+ */
+static int acquire_media_socket(lws_sess_sock_pool_t* pool, uint16_t* port)
+{
+    if (pool && pool->count > 0) {
+        pool->count--;
+        *port = pool->ports[pool->count];
+        return pool->fds[pool->count];
+    }
+
+    return open_media_socket(port);
+}
+
+/* ========================================
+ * Audio graph: standard chains
+ * ======================================== */
+
+/**
+ * @brief Filter: AEC/NS/AGC or the custom stage, in place when the frame is not shared
+ *
+ * 保持期间也运行，保证回声滤波器与延迟估计连续。
+ */
+static int node_proc_process(void* ctx, lws_graph_node_t* node, lws_frame_t* frame)
+{
+    lws_sess_t* sess = (lws_sess_t*)ctx;
+    lws_frame_t* out = lws_frame_writable(frame) ? frame : lws_frame_copy(frame);
+
+    if (!out) {
+        return -1;
+    }
+    audio_proc_capture(sess, (int16_t*)out->data, out->samples);
+    lws_graph_emit(node, out);
+    if (out != frame) {
+        lws_frame_unref(out);
+    }
+    return 0;
+}
+
+/**
+ * @brief Sink: DTX/DTMF/hold gating, then multi-frame packing and the RTP packetizer
+ *
+ * 保持(hold)期间照常读取采集设备并推进timestamp，恢复时RTP时间戳与
+ * 墙钟保持一致。发送DTMF事件期间暂停音频包(RFC 4733 §2.5.1.4)，
+ * 启用DTX时静音帧不发送。
+ */
+static int node_encoder_process(void* ctx, lws_graph_node_t* node, lws_frame_t* frame)
+{
+    lws_sess_t* sess = (lws_sess_t*)ctx;
+    const int16_t* pcm = (const int16_t*)frame->data;
+    LWS_UNUSED(node);
+
+    if (media_dir_can_send(sess->active_dir) && !sess->dtmf_tx_active &&
+        !dtx_process(sess, pcm, frame->samples)) {
+        audio_pack_input(sess, pcm, frame->samples, frame->timestamp);
+    } else if (!media_dir_can_send(sess->active_dir)) {
+        /* 保持：丢弃未凑满一包的帧（DTX/DTMF在暂停打包器时已发出） */
+        sess->audio_pack_count = 0;
+        sess->audio_pack_samples = 0;
+    }
+    return 0;
+}
+
+static const lws_node_ops_t s_capture_node = { "capture", LWS_NODE_SOURCE, NULL, NULL };
+static const lws_node_ops_t s_proc_node = { "audio-proc", LWS_NODE_FILTER, node_proc_process, NULL };
+static const lws_node_ops_t s_encoder_node = { "encoder", LWS_NODE_SINK, node_encoder_process, NULL };
+
+/**
+ * @brief Recorder write callback (writer thread)
+ */
+static int record_write(void* param, const int16_t* pcm, int samples)
+{
+    return lws_dev_write_audio((lws_dev_t*)param, pcm, samples);
+}
+
+/**
+ * @brief Packet recorder write callback (writer thread)
+ */
+static int record_write_packet(void* param, const uint8_t* data, int bytes,
+                               int64_t pts, int samples)
+{
+    return lws_dev_write_audio_packet((lws_dev_t*)param, data, bytes, pts, samples);
+}
+
+/**
+ * @brief Recording format of the received payloads of a codec
+ * @return 0 if the codec can be recorded without decoding, -1 otherwise
+ */
+static int record_packet_format(const lws_sess_codec_t* codec, lws_audio_format_t* format)
+{
+    switch (codec->codec) {
+    case LWS_RTP_PAYLOAD_PCMU:
+        *format = LWS_AUDIO_FMT_PCMU;
+        return 0;
+    case LWS_RTP_PAYLOAD_PCMA:
+        *format = LWS_AUDIO_FMT_PCMA;
+        return 0;
+    case LWS_RTP_PAYLOAD_OPUS:
+        *format = LWS_AUDIO_FMT_OPUS;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/**
+ * @brief Passthrough recording: queue a received payload as it is
+ *
+ * 编码切换时record_codec_changed()已换到新的分段，这里只防御性地
+ * 丢弃与文件格式不符的负载。
+ */
+static void record_packet(lws_sess_t* sess, const uint8_t* payload, int bytes,
+                          uint32_t timestamp)
+{
+    lws_audio_format_t format;
+    lws_frame_t* frame;
+    int samples;
+
+    if (!sess->rec || bytes <= 0 || record_packet_format(&sess->audio_codec, &format) != 0 ||
+        format != sess->rec_format) {
+        return;
+    }
+
+    /* G.711每字节一个采样；Opus时长由TOC给出（48kHz，与RTP时钟相同） */
+    samples = format == LWS_AUDIO_FMT_OPUS ? lws_codec_opus_samples(payload, bytes) : bytes;
+    if (samples <= 0) {
+        return;
+    }
+
+    frame = lws_frame_alloc(bytes);
+    if (!frame) {
+        return;
+    }
+    frame->kind = LWS_FRAME_AUDIO_CODED;
+    frame->size = bytes;
+    frame->samples = samples;
+    frame->sample_rate = sess->audio_codec.clock_rate;
+    frame->channels = 1;
+    frame->timestamp = timestamp;
+    frame->time_us = get_current_time_us();
+    memcpy(frame->data, payload, bytes);
+    lws_rec_push_packet(sess->rec, frame);
+    lws_frame_unref(frame);
+}
+
+/**
+ * @brief Whether the device may take received payloads without decoding
+ *
+ * 是否直通取决于协商出的编码，在record_codec_changed()中决定。
+ */
+static int record_passthrough_possible(lws_sess_t* sess)
+{
+    lws_dev_t* dev = sess->config.audio_record_dev;
+
+    return !sess->config.record_transcode && !sess->config.record_stereo &&
+           (lws_dev_audio_packet_supported(dev, LWS_AUDIO_FMT_PCMU) ||
+            lws_dev_audio_packet_supported(dev, LWS_AUDIO_FMT_PCMA) ||
+            lws_dev_audio_packet_supported(dev, LWS_AUDIO_FMT_OPUS));
+}
+
+/**
+ * @brief Record the received payloads of the current codec without decoding
+ * @return 0 if passthrough recording is on
+ */
+static int record_open_passthrough(lws_sess_t* sess)
+{
+    lws_audio_format_t format;
+    int queue_ms = sess->config.record_queue_ms > 0 ? sess->config.record_queue_ms
+                                                    : LWS_DEFAULT_RECORD_QUEUE_MS;
+
+    if (record_packet_format(&sess->audio_codec, &format) != 0 ||
+        !lws_dev_audio_packet_supported(sess->config.audio_record_dev, format)) {
+        return -1;
+    }
+
+    /* 包的位置由录音线程按RTP时间戳计算，总是后台写入 */
+    sess->rec = lws_rec_open_packets(sess->audio_codec.clock_rate, queue_ms,
+                                     record_write_packet, sess->config.audio_record_dev);
+    if (!sess->rec) {
+        lws_log_warn(0, "[SESS] Failed to open packet recorder, recording decoded audio\n");
+        return -1;
+    }
+
+    sess->config.record_queue_ms = queue_ms;
+    sess->rec_passthrough = 1;
+    sess->rec_format = format;
+    lws_log_info("[SESS] Recording %s payloads without decoding\n", sess->audio_codec.name);
+    return 0;
+}
+
+/**
+ * @brief Record decoded audio
+ *
+ * Falls back to synchronous writes when the recorder cannot be opened. A
+ * stereo recording needs the recorder to align the legs, so it is always
+ * written in the background and disabled if the recorder cannot be opened.
+ */
+static void record_open_pcm(lws_sess_t* sess)
+{
+    if (sess->config.record_stereo) {
+        if (sess->config.record_queue_ms <= 0) {
+            sess->config.record_queue_ms = LWS_DEFAULT_RECORD_QUEUE_MS;
+        }
+        sess->rec = lws_rec_open_stereo(sess->config.audio_sample_rate, sess->config.record_queue_ms,
+                                        record_write, sess->config.audio_record_dev);
+        if (!sess->rec) {
+            lws_log_error(0, "[SESS] Failed to open stereo recorder\n");
+        }
+        return;
+    }
+
+    if (sess->config.record_queue_ms < 0) {
+        return;
+    }
+    if (sess->config.record_queue_ms == 0) {
+        sess->config.record_queue_ms = LWS_DEFAULT_RECORD_QUEUE_MS;
+    }
+
+    sess->rec = lws_rec_open(sess->config.audio_sample_rate, 1, sess->config.record_queue_ms,
+                             record_write, sess->config.audio_record_dev);
+    if (!sess->rec) {
+        lws_log_warn(0, "[SESS] Recording on the media thread\n");
+        sess->config.record_queue_ms = -1;
+    }
+}
+
+/**
+ * @brief Move recording off the media thread
+ *
+ * When the device may take coded payloads the choice waits for the
+ * negotiated codec (record_codec_changed); otherwise decoded audio is
+ * recorded from the start.
+ */
+static void record_open(lws_sess_t* sess)
+{
+    if (record_passthrough_possible(sess)) {
+        sess->rec_deferred = 1;
+        return;
+    }
+    record_open_pcm(sess);
+}
+
+/**
+ * @brief Accumulate the statistics of a closed recorder
+ */
+static void record_stats_add(lws_rec_stats_t* total, const lws_rec_stats_t* stats)
+{
+    total->frames += stats->frames;
+    total->dropped += stats->dropped;
+    total->writes += stats->writes;
+    total->late += stats->late;
+    total->max_queued = LWS_MAX(total->max_queued, stats->max_queued);
+    total->max_write_us = LWS_MAX(total->max_write_us, stats->max_write_us);
+}
+
+/**
+ * @brief Pick the recorder for the negotiated audio codec
+ *
+ * 协商出的编码与设备格式一致时直通录音，否则录解码音频。直通录音中途
+ * 切换编码时结束当前文件，在设备的下一段中按新编码建立轨道：新编码能
+ * 直通则继续直通，否则以PCM录解码音频。设备不支持分段时停止录音，
+ * 不把不同格式的音频写进同一轨道。
+ */
+static void record_codec_changed(lws_sess_t* sess)
+{
+    lws_dev_t* dev = sess->config.audio_record_dev;
+    lws_audio_format_t format;
+    lws_rec_stats_t stats;
+    int passthrough;
+
+    if (sess->rec_deferred) {
+        sess->rec_deferred = 0;
+        if (record_open_passthrough(sess) != 0) {
+            record_open_pcm(sess);
+        }
+        return;
+    }
+
+    passthrough = record_packet_format(&sess->audio_codec, &format) == 0;
+    if (!sess->rec || !sess->rec_passthrough || (passthrough && format == sess->rec_format)) {
+        return;
+    }
+
+    /* 已排队的包写入当前段 */
+    lws_rec_close(sess->rec, &stats);
+    record_stats_add(&sess->rec_stats_prev, &stats);
+    sess->rec = NULL;
+    sess->rec_passthrough = 0;
+
+    if (passthrough && lws_dev_next_audio_segment(dev, format, sess->audio_codec.clock_rate) == 0) {
+        if (record_open_passthrough(sess) != 0) {
+            lws_log_warn(0, "[SESS] Failed to reopen packet recorder, recording stopped\n");
+        }
+        return;
+    }
+
+    if (!passthrough &&
+        lws_dev_next_audio_segment(dev, LWS_AUDIO_FMT_PCM_S16LE, sess->config.audio_sample_rate) == 0) {
+        lws_log_info("[SESS] %s payloads cannot be recorded as they are, recording decoded audio\n",
+                     sess->audio_codec.name);
+        record_open_pcm(sess);
+        return;
+    }
+
+    lws_log_warn(0, "[SESS] Recording device cannot start a %s segment, recording stopped\n",
+                 sess->audio_codec.name);
+}
+
+/**
+ * @brief Write the queued recording and close the recorder (hangup)
+ */
+static void record_close(lws_sess_t* sess)
+{
+    sess->rec_deferred = 0;
+    if (!sess->rec) {
+        return;
+    }
+
+    lws_rec_close(sess->rec, &sess->rec_stats);
+    sess->rec = NULL;
+}
+
+/**
+ * @brief Build the audio graph from the configuration
+ *
+ * 发送：capture → audio-proc → [audio_tx_nodes] → encoder / record-local（双方录音）
+ * 接收：rtp → [audio_rx_nodes] → playback / record
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int audio_graph_create(lws_sess_t* sess)
+{
+    lws_graph_node_t* tail;
+    lws_graph_node_t* node;
+
+    sess->graph = lws_graph_create();
+    if (!sess->graph) {
+        return -1;
+    }
+
+    if (sess->config.audio_capture_dev) {
+        sess->capture_node = lws_graph_add(sess->graph, &s_capture_node, sess);
+        node = lws_graph_add(sess->graph, &s_proc_node, sess);
+        if (!sess->capture_node || lws_graph_link(sess->capture_node, node) != 0) {
+            return -1;
+        }
+        tail = lws_graph_build(sess->graph, node, sess->config.audio_tx_nodes,
+                               sess->config.audio_tx_node_count);
+        if (!tail || lws_graph_link(tail, lws_graph_add(sess->graph, &s_encoder_node, sess)) != 0) {
+            return -1;
+        }
+        if (sess->config.record_stereo && sess->config.audio_record_dev &&
+            lws_graph_link(tail, lws_graph_add(sess->graph, &s_record_local_node, sess)) != 0) {
+            return -1;
+        }
+    }
+
+    sess->rx_node = lws_graph_add(sess->graph, &s_rx_node, sess);
+    if (!sess->rx_node) {
+        return -1;
+    }
+    tail = lws_graph_build(sess->graph, sess->rx_node, sess->config.audio_rx_nodes,
+                           sess->config.audio_rx_node_count);
+    if (!tail) {
+        return -1;
+    }
+    if (sess->config.audio_playback_dev &&
+        lws_graph_link(tail, lws_graph_add(sess->graph, &s_playback_node, sess)) != 0) {
+        return -1;
+    }
+    if (sess->config.audio_record_dev &&
+        lws_graph_link(tail, lws_graph_add(sess->graph, &s_record_node, sess)) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* ========================================
+ * Core API Implementation
+ * ======================================== */
+
+/**
+ * @brief Create media session instance
+ */
+lws_sess_t* lws_sess_create(const lws_sess_config_t* config,
+                             const lws_sess_handler_t* handler)
+{
+    if (!config || !handler) {
+        lws_log_error(0, "[SESS] Invalid parameters\n");
+        return NULL;
+    }
+
+    lws_log_info("[SESS] Creating media session");
+
+    /* Allocate session structure */
+    lws_sess_t* sess = (lws_sess_t*)lws_calloc(1, sizeof(lws_sess_t));
+    if (!sess) {
         lws_log_error(0, "[SESS] Failed to allocate session\n");
         return NULL;
     }
 
-    /* Copy configuration and handler */
-    sess->config = *config;
-    sess->handler = *handler;
-    sess->state = LWS_SESS_STATE_IDLE;
+    /* Copy configuration and handler */
+    sess->config = *config;
+    sess->handler = *handler;
+    /* ICE-lite只有host候选：无需收集，也无需trickle */
+    if (sess->config.ice_lite) {
+        sess->config.enable_ice = 1;
+        sess->config.trickle_ice = 0;
+    }
+    sess->state = LWS_SESS_STATE_IDLE;
+
+    /* UDP socket for media (RTP/STUN): 优先使用预绑定的socket池 */
+    sess->media_socket = acquire_media_socket(config->sock_pool, &sess->local_port);
+    if (sess->media_socket < 0) {
+        lws_free(sess);
+        return NULL;
+    }
+    lws_log_info("[SESS] Media socket bound to port %d", sess->local_port);
+
+    /* Initialize random seed for credentials */
+    srand((unsigned int)time(NULL));
+
+    /*
+     * 默认不创建 ICE agent（服务器中转模式）：enable_ice时在收集候选时创建，
+     * 否则在远端offer携带ICE属性时创建
+     */
+    sess->ice = NULL;
+    sess->transport_mode_determined = 0;
+    sess->active_transport_mode = LWS_TRANSPORT_MODE_RTP_DIRECT;
+    lws_log_info("[SESS] Media session created (default: RTP direct mode)");
+
+    /* Generate random SSRC */
+    sess->audio_ssrc = (uint32_t)rand();
+    sess->audio_timestamp = 0;
+    sess->audio_sequence = (uint16_t)rand();
+
+    /* SRTP主密钥（每个m=行各一个） */
+    if (srtp_init(sess, &sess->audio_srtp) != 0 || srtp_init(sess, &sess->video_srtp) != 0) {
+        lws_log_error(LWS_ERR_MEDIA, "[SESS] Failed to generate SRTP keys\n");
+        goto fail;
+    }
+
+    /* DTLS证书（进程内缓存，offer的a=fingerprint需要） */
+    if (sess->audio_srtp.use_dtls) {
+        sess->dtls_cert = lws_dtls_cert_acquire();
+        if (!sess->dtls_cert) {
+            lws_log_error(LWS_ERR_MEDIA_DTLS, "[SESS] Failed to get DTLS certificate\n");
+            goto fail;
+        }
+    }
+
+    /* 本端offer的编解码表，收到远端SDP后替换为协商结果 */
+    if (sess->config.enable_audio) {
+        lws_rtp_payload_t prefs[LWS_MAX_CODECS];
+        int count = audio_codec_prefs(sess, prefs);
+        if (lws_codec_offer(&sess->audio_codecs, prefs, count,
+                            audio_aux_formats(sess)) < 0) {
+            lws_log_error(LWS_ERR_MEDIA_SDP, "[SESS] No usable audio codec configured\n");
+            goto fail;
+        }
+        sess->audio_codec = *lws_codec_primary(&sess->audio_codecs);
+        audio_ptime_apply(sess, 0, 0);
+    }
+    lws_vad_init(&sess->vad, LWS_SESS_VAD_HANGOVER_MS, LWS_DEFAULT_FRAME_DURATION);
+    lws_red_sender_init(&sess->red_tx, -1, 0);
+    lws_red_receiver_init(&sess->red_rx, -1, red_deliver, sess);
+    lws_cn_gen_init(&sess->cn_gen, (uint32_t)rand());
+
+    /* 协商前按本端配置的方向生成offer */
+    sess->active_dir = sess->config.media_dir;
+    sess->remote_dir = LWS_MEDIA_DIR_SENDRECV;
+
+    sess->sdp_session_id = (uint64_t)time(NULL);
+    sess->sdp_version = sess->sdp_session_id;
+
+    /* Create RTP session for RTCP */
+    if (sess->config.enable_audio && sess->config.enable_rtcp) {
+        struct rtp_event_t rtp_event = {
+            .on_rtcp = on_rtcp_message
+        };
+
+        sess->rtp = rtp_create(&rtp_event, sess, sess->audio_ssrc,
+                               sess->audio_timestamp,
+                               sess->config.audio_sample_rate,
+                               0, /* bandwidth */
+                               1  /* sender */);
+
+        if (!sess->rtp) {
+            lws_log_error(0, "[SESS] Failed to create RTP session\n");
+            goto fail;
+        }
+    }
+
+    /* Create RTP payload encoder */
+    if (sess->config.enable_audio && sess->config.audio_capture_dev) {
+        struct rtp_payload_t payload_handler = {
+            .alloc = rtp_alloc,
+            .free = rtp_free,
+            .packet = rtp_send_packet
+        };
+
+        sess->audio_encoder = rtp_payload_encode_create(
+            sess->audio_codec.send_pt,
+            sess->audio_codec.name,
+            sess->audio_sequence,
+            sess->audio_ssrc,
+            &payload_handler,
+            sess);
+
+        if (!sess->audio_encoder) {
+            lws_log_error(0, "[SESS] Failed to create RTP encoder\n");
+            goto fail;
+        }
+    }
+
+    /* Create RTP payload decoder */
+    /* Decoder needed if we have playback device OR recording device */
+    if (sess->config.enable_audio && (sess->config.audio_playback_dev || sess->config.audio_record_dev)) {
+        struct rtp_payload_t payload_handler = {
+            .alloc = rtp_alloc,
+            .free = rtp_free,
+            .packet = rtp_packet
+        };
+
+        sess->audio_decoder = rtp_payload_decode_create(
+            sess->audio_codec.recv_pt,
+            sess->audio_codec.name,
+            &payload_handler,
+            sess);
+
+        if (!sess->audio_decoder) {
+            lws_log_error(0, "[SESS] Failed to create RTP decoder\n");
+            goto fail;
+        }
+        lws_log_info("[SESS] Created RTP payload decoder\n");
+    }
+
+    /* Voice processing between capture and the encoder (AEC/NS/AGC) */
+    if (sess->config.enable_audio && sess->config.audio_capture_dev) {
+        audio_proc_create(sess);
+    }
+
+    if (sess->config.enable_audio && audio_graph_create(sess) != 0) {
+        lws_log_error(0, "[SESS] Failed to build audio graph\n");
+        goto fail;
+    }
+    if (sess->config.enable_audio && sess->config.audio_record_dev) {
+        record_open(sess);
+    }
+
+    /* BUNDLE标识，接受对端的BUNDLE offer时换成其中的值 */
+    strcpy(sess->audio_mid, "0");
+    strcpy(sess->video_mid, "1");
+    sess->mid_ext_id = LWS_SESS_MID_EXT_ID;
+
+    /* Video: 失败时仅关闭视频，音频会话照常建立 */
+    sess->video_socket = -1;
+    if (sess->config.enable_video && video_create(sess) != 0) {
+        lws_log_warn(0, "[SESS] Video disabled\n");
+        video_destroy(sess);
+        sess->config.enable_video = 0;
+    }
+
+    sess->session_start_time = get_current_time_us();
+
+    lws_log_info("[SESS] Media session created successfully");
+    return sess;
+
+fail:
+    /* 各资源均可能尚未创建：calloc保证未创建的指针为NULL */
+    lws_graph_destroy(sess->graph);
+    audio_proc_destroy(sess);
+    if (sess->audio_encoder) rtp_payload_encode_destroy(sess->audio_encoder);
+    if (sess->audio_decoder) rtp_payload_decode_destroy(sess->audio_decoder);
+    if (sess->rtp) rtp_destroy(sess->rtp);
+    srtp_destroy(&sess->audio_srtp);
+    srtp_destroy(&sess->video_srtp);
+    if (sess->dtls_cert) {
+        lws_dtls_cert_release(sess->dtls_cert);
+    }
+    close(sess->media_socket);
+    lws_free(sess);
+    return NULL;
+}
+
+/**
+ * @brief Destroy media session instance
+ */
+void lws_sess_destroy(lws_sess_t* sess)
+{
+    if (!sess) {
+        return;
+    }
+
+    lws_log_info("[SESS] Destroying media session");
+
+    /* Change state */
+    change_state(sess, LWS_SESS_STATE_CLOSED);
+
+    /* DTLS close_notify须在ICE与socket关闭前发出 */
+    srtp_destroy(&sess->audio_srtp);
+    srtp_destroy(&sess->video_srtp);
+    lws_dtls_cert_release(sess->dtls_cert);
+
+    record_close(sess);
+    lws_graph_destroy(sess->graph);
+    lws_frame_unref(sess->capture_frame);
+    lws_frame_unref(sess->rx_frame);
+    audio_proc_destroy(sess);
+    video_destroy(sess);
+
+    /* Destroy RTP payload encoder/decoder */
+    if (sess->audio_encoder) {
+        rtp_payload_encode_destroy(sess->audio_encoder);
+    }
+
+    if (sess->audio_decoder) {
+        rtp_payload_decode_destroy(sess->audio_decoder);
+    }
+
+    /* Destroy RTP session */
+    if (sess->rtp) {
+        rtp_destroy(sess->rtp);
+    }
+
+    /* Release the TURN allocation (needs the socket), then the ICE agent */
+    lws_turn_destroy(sess->turn);
+    lws_ice_destroy(sess->ice);
+
+    /* Close media socket */
+    if (sess->media_socket >= 0) {
+        close(sess->media_socket);
+        sess->media_socket = -1;
+    }
+
+    /* Free session structure */
+    lws_free(sess);
+
+    lws_log_info("[SESS] Media session destroyed");
+}
+
+/**
+ * @brief Start gathering ICE candidates
+ */
+/**
+ * @brief Get local IP address from network interfaces
+ * Returns the first non-loopback IPv4 address found
+ */
+static int probe_local_ipv4(struct sockaddr_in* addr)
+{
+#ifdef __APPLE__
+    /* For macOS, use getifaddrs */
+    struct ifaddrs* ifaddr = NULL;
+    struct ifaddrs* ifa = NULL;
+    int found = 0;
+
+    if (getifaddrs(&ifaddr) == -1) {
+        return -1;
+    }
+
+    /* Iterate through network interfaces */
+    for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == NULL) {
+            continue;
+        }
+
+        /* Look for IPv4 non-loopback address */
+        if (ifa->ifa_addr->sa_family == AF_INET) {
+            struct sockaddr_in* sin = (struct sockaddr_in*)ifa->ifa_addr;
+
+            /* Skip loopback (127.x.x.x) */
+            if ((ntohl(sin->sin_addr.s_addr) & 0xFF000000) == 0x7F000000) {
+                continue;
+            }
+
+            /* Found a valid address */
+            memcpy(addr, sin, sizeof(*addr));
+            found = 1;
+            break;
+        }
+    }
+
+    freeifaddrs(ifaddr);
+    return found ? 0 : -1;
+#else
+    /* For Linux/other platforms */
+    /* Simplified version: just use any non-loopback interface */
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+    /* Connect to a remote address to determine local IP */
+    struct sockaddr_in remote;
+    memset(&remote, 0, sizeof(remote));
+    remote.sin_family = AF_INET;
+    remote.sin_port = htons(53); /* DNS port */
+    inet_pton(AF_INET, "8.8.8.8", &remote.sin_addr);
+
+    if (connect(sock, (struct sockaddr*)&remote, sizeof(remote)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    socklen_t len = sizeof(*addr);
+    if (getsockname(sock, (struct sockaddr*)addr, &len) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    close(sock);
+    return 0;
+#endif
+}
+
+/**
+ * @brief Local IPv4 address, cached for LWS_SESS_LOCAL_IP_TTL_US
+ *
+ * 探测本地地址需要getifaddrs或一次connect系统调用，每路呼叫和每次
+ * 生成SDP都执行会拖慢INVITE突发处理，这里缓存结果并定期刷新。
+ */
+static int get_local_ipv4(struct sockaddr_in* addr)
+{
+    static lws_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+    static struct sockaddr_in cached_addr;
+    static uint64_t cached_at = 0;
+    uint64_t now = get_current_time_us();
+    int ret = 0;
+
+    lws_mutex_lock(&cache_mutex);
+    if (cached_at == 0 || now - cached_at >= LWS_SESS_LOCAL_IP_TTL_US) {
+        ret = probe_local_ipv4(&cached_addr);
+        cached_at = (ret == 0) ? now : 0;
+    }
+    if (ret == 0) {
+        *addr = cached_addr;
+    }
+    lws_mutex_unlock(&cache_mutex);
+
+    return ret;
+}
+
+/**
+ * @brief Resolve "host[:port]" to an IPv4 STUN server address
+ */
+static int resolve_stun_server(const char* server, uint16_t default_port,
+                               struct sockaddr_in* addr)
+{
+    char host[LWS_MAX_HOSTNAME_LEN];
+    const char* colon = strrchr(server, ':');
+    struct addrinfo hints;
+    struct addrinfo* res = NULL;
+    size_t len = colon ? (size_t)(colon - server) : strlen(server);
+
+    if (len == 0 || len >= sizeof(host)) {
+        return -1;
+    }
+    memcpy(host, server, len);
+    host[len] = '\0';
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(colon ? (uint16_t)atoi(colon + 1) :
+                           (default_port ? default_port : LWS_DEFAULT_STUN_PORT));
+    if (inet_pton(AF_INET, host, &addr->sin_addr) == 1) {
+        return 0;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0 || !res) {
+        return -1;
+    }
+    addr->sin_addr = ((struct sockaddr_in*)res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+    return 0;
+}
+
+/**
+ * @brief Host candidates: every usable IPv4 interface, default route first
+ *
+ * 媒体socket绑定在通配地址，每个接口地址加本地端口即一个host候选。
+ * 跳过回环和链路本地(169.254/16)地址。
+ */
+static void add_host_candidates(lws_sess_t* sess)
+{
+    struct ifaddrs* ifaddr = NULL;
+    struct ifaddrs* ifa;
+    struct sockaddr_in addr;
+
+    if (get_local_ipv4(&addr) == 0) {
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(sess->local_port);
+        lws_ice_add_host(sess->ice, &addr);
+    }
+
+    if (getifaddrs(&ifaddr) != 0) {
+        return;
+    }
+    for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+        uint32_t ip;
+
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET ||
+            !(ifa->ifa_flags & IFF_UP) || (ifa->ifa_flags & IFF_LOOPBACK)) {
+            continue;
+        }
+        ip = ntohl(((struct sockaddr_in*)ifa->ifa_addr)->sin_addr.s_addr);
+        if ((ip & 0xFF000000) == 0x7F000000 || (ip & 0xFFFF0000) == 0xA9FE0000) {
+            continue;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(ip);
+        addr.sin_port = htons(sess->local_port);
+        lws_ice_add_host(sess->ice, &addr);     /* 重复（默认接口）或已满时忽略 */
+    }
+    freeifaddrs(ifaddr);
+}
+
+/**
+ * @brief Create the ICE agent with our credentials (no gathering yet)
+ */
+static int ice_create(lws_sess_t* sess)
+{
+    lws_ice_config_t config;
+    lws_ice_handler_t handler;
+    int i;
+
+    memset(&config, 0, sizeof(config));
+    config.lite = sess->config.ice_lite;
+    config.aggressive = sess->config.ice_aggressive;
+    config.gather_timeout_ms = sess->config.ice_gather_timeout_ms > 0 ?
+                               sess->config.ice_gather_timeout_ms :
+                               LWS_DEFAULT_ICE_GATHER_TIMEOUT_MS;
+
+    /* stun_server与stun_servers并行查询（lite不查询） */
+    for (i = -1; !config.lite && i < LWS_MAX_STUN_SERVERS && config.stun_count < LWS_ICE_MAX_SERVERS; i++) {
+        const char* server = i < 0 ? sess->config.stun_server : sess->config.stun_servers[i];
+
+        if (!server || !server[0]) {
+            continue;
+        }
+        if (resolve_stun_server(server, sess->config.stun_port,
+                                &config.stun_servers[config.stun_count]) != 0) {
+            lws_log_warn(LWS_ERR_MEDIA_ICE, "[SESS] Cannot resolve STUN server %s\n", server);
+            continue;
+        }
+        config.stun_count++;
+    }
+
+    /* TURN：收集时分配中继地址，中继候选对的检查与媒体经TURN客户端发送 */
+    memset(&sess->turn_addr, 0, sizeof(sess->turn_addr));
+    if (!config.lite && sess->config.turn_server && sess->config.turn_server[0]) {
+        if (resolve_stun_server(sess->config.turn_server,
+                                sess->config.turn_port ? sess->config.turn_port : LWS_DEFAULT_TURN_PORT,
+                                &sess->turn_addr) == 0) {
+            config.relay = 1;
+        } else {
+            memset(&sess->turn_addr, 0, sizeof(sess->turn_addr));
+            lws_log_warn(LWS_ERR_MEDIA_ICE, "[SESS] Cannot resolve TURN server %s\n",
+                         sess->config.turn_server);
+        }
+    }
+
+    memset(&handler, 0, sizeof(handler));
+    handler.send = on_ice_send;
+    handler.relay_send = on_ice_relay_send;
+    handler.on_candidate = on_ice_candidate;
+    handler.on_gathering_done = on_ice_gathering_done;
+    handler.on_state = on_ice_state;
+    handler.param = sess;
+
+    sess->ice = lws_ice_create(&config, &handler);
+    if (!sess->ice) {
+        return -1;
+    }
+    if (!sess->local_ice_ufrag[0]) {
+        generate_ice_credentials(sess);
+    }
+    lws_ice_set_local_auth(sess->ice, sess->local_ice_ufrag, sess->local_ice_pwd);
+
+    lws_log_info("[SESS] ICE agent created (%s, %d STUN servers%s, deadline %d ms)",
+                 config.lite ? "lite" : "full", config.stun_count,
+                 config.relay ? ", TURN" : "", config.gather_timeout_ms);
+    return 0;
+}
+
+/**
+ * @brief Create the TURN client and send the first Allocate
+ *
+ * 分配结果经on_turn_allocated/on_turn_failed交给ICE agent，
+ * 收集在中继候选到达（或分配失败、收集截止）后结束。
+ */
+static int ice_turn_start(lws_sess_t* sess)
+{
+    lws_turn_config_t config;
+    lws_turn_handler_t handler;
+
+    memset(&config, 0, sizeof(config));
+    config.server = sess->turn_addr;
+    if (sess->config.turn_username) {
+        snprintf(config.username, sizeof(config.username), "%s", sess->config.turn_username);
+    }
+    if (sess->config.turn_password) {
+        snprintf(config.password, sizeof(config.password), "%s", sess->config.turn_password);
+    }
+
+    memset(&handler, 0, sizeof(handler));
+    handler.send = on_ice_send;
+    handler.on_allocated = on_turn_allocated;
+    handler.on_failed = on_turn_failed;
+    handler.param = sess;
+
+    lws_turn_destroy(sess->turn);
+    sess->turn = lws_turn_create(&config, &handler);
+    if (!sess->turn) {
+        return -1;
+    }
+    return lws_turn_allocate(sess->turn, get_current_time_us());
+}
+
+/**
+ * @brief Start host + server-reflexive + relayed gathering (creating the agent if needed)
+ */
+static int ice_gather_start(lws_sess_t* sess)
+{
+    if (!sess->ice && ice_create(sess) != 0) {
+        return -1;
+    }
+    sess->ice_gathering = 1;
+
+    add_host_candidates(sess);
+
+    /* Half trickle：host候选即刻可用，先发出SDP，其余候选经on_candidate补充 */
+    if (sess->config.trickle_ice && generate_local_sdp(sess) == 0 &&
+        sess->handler.on_sdp_ready) {
+        sess->handler.on_sdp_ready(sess, sess->local_sdp, sess->handler.userdata);
+    }
+
+    if (sess->turn_addr.sin_port && ice_turn_start(sess) != 0) {
+        lws_ice_set_relay(sess->ice, NULL, NULL, get_current_time_us());
+    }
+
+    return lws_ice_gather(sess->ice, get_current_time_us());
+}
+
+int lws_sess_gather_candidates(lws_sess_t* sess)
+{
+    if (!sess) {
+        return -1;
+    }
+
+    /* 已启动收集：完成后由on_ice_gathering_done生成SDP */
+    if (sess->ice_gathering && !sess->ice_gathering_done) {
+        return 0;
+    }
+
+    change_state(sess, LWS_SESS_STATE_GATHERING);
+
+    /* offer启用ICE，或应答携带ICE属性的offer（agent已在设置远端SDP时创建） */
+    if (!sess->ice_gathering && (sess->config.enable_ice || sess->ice)) {
+        if (ice_gather_start(sess) == 0) {
+            return 0;
+        }
+        lws_log_warn(LWS_ERR_MEDIA_ICE, "[SESS] ICE gathering failed, offering host address only\n");
+        lws_turn_destroy(sess->turn);
+        sess->turn = NULL;
+        lws_ice_destroy(sess->ice);
+        sess->ice = NULL;
+        sess->ice_gathering = 0;
+        sess->active_transport_mode = LWS_TRANSPORT_MODE_RTP_DIRECT;
+    }
+
+    /*
+     * 不进行 ICE 候选收集时直接生成 SDP
+     * 这适用于服务器中转模式（最常见的场景）
+     */
+    lws_log_info("[SESS] Generating local SDP (without ICE gathering)");
+
+    /* Generate SDP immediately */
+    if (generate_local_sdp(sess) == 0) {
+        change_state(sess, LWS_SESS_STATE_GATHERED);
+
+        /* Notify SDP ready */
+        if (sess->handler.on_sdp_ready) {
+            sess->handler.on_sdp_ready(sess, sess->local_sdp, sess->handler.userdata);
+        }
+    }
+
+    return 0;
+}
+
+/* ========================================
+ * Remote media description
+ * ======================================== */
+
+/**
+ * @brief Recreate the audio packetizer, continuing at sess->audio_sequence
+ *
+ * librtp的打包器不支持修改PT和序号，切换编码或插入DTMF包后
+ * 以新的起始序号重建，SSRC保持不变。
+ */
+static int restart_audio_encoder(lws_sess_t* sess, const lws_sess_codec_t* codec)
+{
+    struct rtp_payload_t handler = {
+        .alloc = rtp_alloc,
+        .free = rtp_free,
+        .packet = rtp_send_packet
+    };
+    void* encoder = rtp_payload_encode_create(codec->send_pt, codec->name,
+                                              sess->audio_sequence, sess->audio_ssrc,
+                                              &handler, sess);
+    if (!encoder) {
+        lws_log_error(LWS_ERR_MEDIA, "[SESS] Failed to create RTP encoder for PT %d\n",
+                      codec->send_pt);
+        return -1;
+    }
+
+    if (sess->audio_encoder) {
+        rtp_payload_encode_destroy(sess->audio_encoder);
+    }
+    sess->audio_encoder = encoder;
+    return 0;
+}
+
+/**
+ * @brief Take over the audio sequence space from the packetizer
+ *
+ * 会话自行构造的包（telephone-event、CN）接续打包器的序号发送，
+ * 之后由audio_resume_encoder()以新的起始序号交还打包器。
+ */
+static void audio_pause_encoder(lws_sess_t* sess)
+{
+    uint32_t timestamp;
+
+    if (sess->audio_encoder && !sess->audio_encoder_paused) {
+        audio_pack_flush(sess);     /* 已缓存的帧先于会话自己的包 */
+        rtp_payload_encode_getinfo(sess->audio_encoder, &sess->audio_sequence, &timestamp);
+    }
+    sess->audio_encoder_paused = 1;
+}
+
+static void audio_resume_encoder(lws_sess_t* sess)
+{
+    if (sess->audio_encoder_paused) {
+        sess->audio_encoder_paused = 0;
+        if (sess->audio_encoder) {
+            restart_audio_encoder(sess, &sess->audio_codec);
+        }
+    }
+}
+
+/**
+ * @brief Send a packet built by the session on the audio SSRC/sequence
+ *
+ * 调用前须audio_pause_encoder()。
+ */
+static void audio_send_raw(lws_sess_t* sess, int pt, int marker, uint32_t timestamp,
+                           const uint8_t* payload, int len)
+{
+    uint8_t pkt[12 + 32 + LWS_SRTP_MAX_TRAILER];
+
+    if (len > (int)sizeof(pkt) - 12 - LWS_SRTP_MAX_TRAILER) {
+        return;
+    }
+
+    pkt[0] = 0x80;                                  /* V=2 */
+    pkt[1] = (uint8_t)((marker ? 0x80 : 0x00) | (pt & 0x7f));
+    pkt[2] = (uint8_t)(sess->audio_sequence >> 8);
+    pkt[3] = (uint8_t)(sess->audio_sequence);
+    pkt[4] = (uint8_t)(timestamp >> 24);
+    pkt[5] = (uint8_t)(timestamp >> 16);
+    pkt[6] = (uint8_t)(timestamp >> 8);
+    pkt[7] = (uint8_t)(timestamp);
+    pkt[8] = (uint8_t)(sess->audio_ssrc >> 24);
+    pkt[9] = (uint8_t)(sess->audio_ssrc >> 16);
+    pkt[10] = (uint8_t)(sess->audio_ssrc >> 8);
+    pkt[11] = (uint8_t)(sess->audio_ssrc);
+    memcpy(pkt + 12, payload, len);
+
+    sess->audio_sequence++;
+    rtp_send_packet(sess, pkt, 12 + len, timestamp, 0);
+}
+
+/**
+ * @brief Replace the audio packetizer/depacketizer for a new codec or PT mapping
+ *
+ * librtp的payload编码器不支持修改PT，这里只替换打包器对象，
+ * SSRC/sequence由旧编码器继承，timestamp由会话维护，因此接收端
+ * 看到的RTP流是连续的。socket、ICE和RTCP会话保持不变。
+ */
+static int switch_audio_codec(lws_sess_t* sess, const lws_sess_codec_t* codec)
+{
+    if (sess->audio_encoder) {
+        uint32_t timestamp = 0;
+
+        /* 缓存的帧以旧编码发出 */
+        audio_pack_flush(sess);
+
+        /* 暂停期间序号由会话维护 */
+        if (!sess->audio_encoder_paused) {
+            rtp_payload_encode_getinfo(sess->audio_encoder, &sess->audio_sequence, &timestamp);
+        }
+        if (restart_audio_encoder(sess, codec) != 0) {
+            return -1;
+        }
+        sess->audio_encoder_paused = 0;
+    }
+
+    if (sess->audio_decoder) {
+        struct rtp_payload_t handler = {
+            .alloc = rtp_alloc,
+            .free = rtp_free,
+            .packet = rtp_packet
+        };
+        void* decoder = rtp_payload_decode_create(codec->recv_pt, codec->name,
+                                                  &handler, sess);
+        if (!decoder) {
+            lws_log_error(LWS_ERR_MEDIA, "[SESS] Failed to create RTP decoder for PT %d\n",
+                          codec->recv_pt);
+            return -1;
+        }
+
+        rtp_payload_decode_destroy(sess->audio_decoder);
+        sess->audio_decoder = decoder;
+    }
+
+    lws_log_info("[SESS] Audio codec switched: %s/%d (PT %d/%d) -> %s/%d (PT %d/%d)",
+                 sess->audio_codec.name, sess->audio_codec.clock_rate,
+                 sess->audio_codec.send_pt, sess->audio_codec.recv_pt,
+                 codec->name, codec->clock_rate, codec->send_pt, codec->recv_pt);
+    sess->audio_codec = *codec;
+    return 0;
+}
+
+/**
+ * @brief Set up RED for the negotiated codec table
+ *
+ * 发送以对端的RED PT，接收按本端声明的PT；PT不变时保留冗余历史与级别。
+ */
+static void audio_red_apply(lws_sess_t* sess)
+{
+    const lws_sess_codec_t* red = NULL;
+    int send_pt, recv_pt;
+
+    if (sess->config.audio_red > 0) {
+        red = lws_codec_red(&sess->audio_codecs, &sess->audio_codec);
+    }
+    send_pt = red ? red->send_pt : -1;
+    recv_pt = red ? red->recv_pt : -1;
+
+    if (send_pt != sess->red_tx.pt) {
+        lws_red_sender_init(&sess->red_tx, send_pt, sess->config.audio_red);
+    }
+    if (recv_pt != sess->red_rx.pt) {
+        lws_red_receiver_init(&sess->red_rx, recv_pt, red_deliver, sess);
+    }
+    if (red) {
+        lws_log_info("[SESS] RED: PT %d/%d, level %d (max %d)\n",
+                     send_pt, recv_pt, sess->red_tx.level, sess->red_tx.max_level);
+    }
+}
+
+/**
+ * @brief Diff a remote m=audio section against the live session and apply it
+ * @return LWS_SESS_CHANGE_* mask, -1 if no common codec
+ */
+static int apply_remote_audio(lws_sess_t* sess, const lws_sdp_t* sdp,
+                              const lws_sdp_media_t* audio)
+{
+    lws_codec_table_t codecs;
+    const lws_sess_codec_t* primary;
+    int changes = 0;
+    int ret;
+
+    /* Codec: 远端SDP是对本端offer的answer，或是新的offer */
+    if (sess->local_offer_pending) {
+        codecs = sess->audio_codecs;
+        ret = lws_codec_apply_answer(&codecs, audio);
+    } else {
+        lws_rtp_payload_t prefs[LWS_MAX_CODECS + 1];
+        int count = audio_codec_prefs(sess, prefs + 1);
+
+        /* 保持当前编码，除非对端不再提供（避免无谓的切换） */
+        prefs[0] = sess->audio_codec.codec;
+        ret = lws_codec_answer(&codecs, prefs, count + 1, audio_aux_formats(sess), audio);
+    }
+    if (ret < 0) {
+        lws_log_warn(LWS_ERR_MEDIA_SDP, "[SESS] No supported audio codec in remote SDP\n");
+        return -1;
+    }
+
+    /* SRTP: offerer只接受本端offer中的tag，须在清除local_offer_pending前协商 */
+    if (srtp_apply(sess, &sess->audio_srtp, sdp, audio, "Audio") != 0) {
+        return -1;
+    }
+
+    primary = lws_codec_primary(&codecs);
+    if (primary->codec != sess->audio_codec.codec ||
+        primary->send_pt != sess->audio_codec.send_pt ||
+        primary->recv_pt != sess->audio_codec.recv_pt) {
+        if (switch_audio_codec(sess, primary) != 0) {
+            return -1;
+        }
+        changes |= LWS_SESS_CHANGE_CODEC;
+    }
+    sess->audio_codecs = codecs;
+    record_codec_changed(sess);
+    audio_red_apply(sess);
+    audio_ptime_apply(sess, audio->ptime, audio->maxptime);
+
+    sess->local_offer_pending = 0;
+
+    /* Address: c=0.0.0.0 (RFC 2543 hold) 或 port 0 表示对端不接收 */
+    char conn_ip[LWS_MAX_IP_LEN];
+    const lws_sdp_conn_t* conn = lws_sdp_media_conn(sdp, audio);
+    struct sockaddr_in addr;
+    int valid = 0;
+    lws_sdp_str_copy(conn_ip, sizeof(conn_ip), conn->addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(audio->port);
+    if (audio->port != 0 && lws_sdp_str_eq(conn->addrtype, "IP4") &&
+        inet_pton(AF_INET, conn_ip, &addr.sin_addr) == 1 &&
+        addr.sin_addr.s_addr != INADDR_ANY) {
+        valid = 1;
+    }
+
+    /* RTCP: rtcp-mux同RTP地址；否则a=rtcp端口（可带地址）或RTP端口+1 (RFC 3605) */
+    struct sockaddr_in rtcp_addr = addr;
+    sess->remote_mux_attr = audio->rtcp_mux;
+    sess->remote_rtcp_mux = audio->rtcp_mux || (audio->rtcp_port == audio->port &&
+                                                audio->rtcp_conn.addr.n == 0);
+    if (!sess->remote_rtcp_mux) {
+        char rtcp_ip[LWS_MAX_IP_LEN];
+        struct in_addr ip;
+
+        rtcp_addr.sin_port = htons(audio->rtcp_port ? audio->rtcp_port : (uint16_t)(audio->port + 1));
+        lws_sdp_str_copy(rtcp_ip, sizeof(rtcp_ip), audio->rtcp_conn.addr);
+        if (lws_sdp_str_eq(audio->rtcp_conn.addrtype, "IP4") &&
+            inet_pton(AF_INET, rtcp_ip, &ip) == 1 && ip.s_addr != INADDR_ANY) {
+            rtcp_addr.sin_addr = ip;
+        }
+    }
+
+    /* 与上次SDP中的地址比较（remote_rtp_addr可能已锁定到实际源地址） */
+    if (valid != sess->remote_rtp_valid ||
+        (valid && (addr.sin_addr.s_addr != sess->remote_sdp_addr.sin_addr.s_addr ||
+                   addr.sin_port != sess->remote_sdp_addr.sin_port))) {
+        sess->remote_sdp_addr = addr;
+        sess->remote_rtp_addr = addr;
+        sess->remote_rtcp_addr = rtcp_addr;
+        sess->remote_rtp_valid = valid;
+        sess->rtp_latched = 0;
+        sess->rtcp_latched = 0;
+        sess->relatch_count = 0;
+        changes |= LWS_SESS_CHANGE_ADDR;
+        lws_log_info("[SESS] Remote RTP address: %s:%u%s, RTCP port %u", conn_ip,
+                     (unsigned)audio->port, valid ? "" : " (not receiving)",
+                     (unsigned)ntohs(rtcp_addr.sin_port));
+    } else if (!sess->rtp_latched && !sess->rtcp_latched) {
+        sess->remote_rtcp_addr = rtcp_addr;     /* 仅a=rtcp变化 */
+    }
 
-    /* Create UDP socket for media (RTP/STUN) */
-    sess->media_socket = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sess->media_socket < 0) {
-        lws_log_error(0, "[SESS] Failed to create media socket: %s\n", strerror(errno));
-        lws_free(sess);
-        return NULL;
+    /* Direction */
+    lws_media_dir_t remote_dir = lws_sdp_media_dir(sdp, audio);
+    if (audio->port == 0) {
+        remote_dir = LWS_MEDIA_DIR_INACTIVE;
+    } else if (!valid) {
+        remote_dir = media_dir_can_send(remote_dir) ? LWS_MEDIA_DIR_SENDONLY
+                                                    : LWS_MEDIA_DIR_INACTIVE;
+    }
+    sess->remote_dir = remote_dir;
+
+    lws_media_dir_t active_dir = media_dir_negotiate(sess->config.media_dir, remote_dir);
+    if (active_dir != sess->active_dir) {
+        lws_log_info("[SESS] Media direction: %s -> %s",
+                     media_dir_name(sess->active_dir), media_dir_name(active_dir));
+        sess->active_dir = active_dir;
+        changes |= LWS_SESS_CHANGE_DIR;
     }
 
-    /* Set non-blocking */
-    int flags = fcntl(sess->media_socket, F_GETFL, 0);
-    fcntl(sess->media_socket, F_SETFL, flags | O_NONBLOCK);
+    /* SSRC: 未声明时沿用收包时学习到的值 */
+    if (audio->ssrc != 0 && audio->ssrc != sess->remote_ssrc) {
+        lws_log_info("[SESS] Remote SSRC: 0x%08x -> 0x%08x", sess->remote_ssrc, audio->ssrc);
+        sess->remote_ssrc = audio->ssrc;
+        sess->rx_seq_valid = 0;
+        changes |= LWS_SESS_CHANGE_SSRC;
+    }
 
-    /* Bind to any port (OS will assign) */
-    struct sockaddr_in local_addr;
-    memset(&local_addr, 0, sizeof(local_addr));
-    local_addr.sin_family = AF_INET;
-    local_addr.sin_addr.s_addr = INADDR_ANY;
-    local_addr.sin_port = 0;  /* Let OS assign port */
+    sess->remote_sdp_version = sdp->sess_version;
+    sess->remote_sdp_applied = 1;
 
-    if (bind(sess->media_socket, (struct sockaddr*)&local_addr, sizeof(local_addr)) < 0) {
-        lws_log_error(0, "[SESS] Failed to bind media socket: %s\n", strerror(errno));
-        close(sess->media_socket);
-        lws_free(sess);
-        return NULL;
+    return changes;
+}
+
+/**
+ * @brief Convert a parsed a=candidate into an agent candidate
+ * @return 0 on success, -1 on unsupported transport/type/address
+ */
+static int sdp_cand_to_ice(const lws_sdp_cand_t* c, lws_ice_cand_t* cand)
+{
+    char ip[LWS_MAX_IP_LEN];
+
+    memset(cand, 0, sizeof(*cand));
+    if (!lws_sdp_str_eq(c->transport, "udp") && !lws_sdp_str_eq(c->transport, "UDP")) {
+        return -1;                  /* ICE-TCP不支持 */
     }
 
-    /* Get the assigned port */
-    socklen_t addr_len = sizeof(local_addr);
-    if (getsockname(sess->media_socket, (struct sockaddr*)&local_addr, &addr_len) == 0) {
-        sess->local_port = ntohs(local_addr.sin_port);
-        lws_log_info("[SESS] Media socket bound to port %d", sess->local_port);
+    if (lws_sdp_str_eq(c->type, "host")) {
+        cand->type = LWS_ICE_CAND_HOST;
+    } else if (lws_sdp_str_eq(c->type, "srflx")) {
+        cand->type = LWS_ICE_CAND_SRFLX;
+    } else if (lws_sdp_str_eq(c->type, "prflx")) {
+        cand->type = LWS_ICE_CAND_PRFLX;
+    } else if (lws_sdp_str_eq(c->type, "relay")) {
+        cand->type = LWS_ICE_CAND_RELAY;
     } else {
-        lws_log_warn(0, "[SESS] Failed to get local port\n");
-        sess->local_port = 0;
+        lws_log_warn(0, "[SESS] Unknown candidate type: %.*s\n", c->type.n, c->type.p);
+        return -1;
+    }
+    cand->component = (uint8_t)c->component;
+    cand->priority = c->priority;
+    lws_sdp_str_copy(cand->foundation, sizeof(cand->foundation), c->foundation);
+
+    lws_sdp_str_copy(ip, sizeof(ip), c->addr);
+    cand->addr.sin_family = AF_INET;
+    cand->addr.sin_port = htons(c->port);
+    if (inet_pton(AF_INET, ip, &cand->addr.sin_addr) != 1) {
+        lws_log_debug("[SESS] Skipping non-IPv4 candidate %s", ip);
+        return -1;
     }
 
-    /* Initialize random seed for credentials */
-    srand((unsigned int)time(NULL));
+    /* 基址取raddr/rport，host候选与地址相同 */
+    cand->base = cand->addr;
+    if (c->raddr.n > 0) {
+        lws_sdp_str_copy(ip, sizeof(ip), c->raddr);
+        if (inet_pton(AF_INET, ip, &cand->base.sin_addr) == 1) {
+            cand->base.sin_port = htons(c->rport);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Set remote SDP
+ */
+int lws_sess_set_remote_sdp(lws_sess_t* sess, const char* sdp)
+{
+    lws_sdp_t desc;
+    int i;
+
+    if (!sess || !sdp) {
+        return -1;
+    }
+
+    lws_log_info("[SESS] Setting remote SDP (%zu bytes)", strlen(sdp));
+    lws_log_debug("[SESS] Remote SDP:\n%s", sdp);
+
+    if (lws_sdp_parse(&desc, sdp, -1) != 0) {
+        lws_log_error(LWS_ERR_MEDIA_SDP, "[SESS] Malformed remote SDP\n");
+        return -1;
+    }
+
+    const lws_sdp_media_t* audio = lws_sdp_find_media(&desc, "audio");
+    lws_sdp_str_t ice_ufrag, ice_pwd;
+    int has_ice = lws_sdp_media_ice(&desc, audio, &ice_ufrag, &ice_pwd);
+    int offerer = sess->local_offer_pending;    /* 应用音频后被清除 */
 
     /*
-     * 默认不创建 ICE agent（服务器中转模式）
-     * 如果后续检测到远程 SDP 包含 ICE 属性，可以动态创建 ICE agent
-     * TODO: 实现动态ICE切换功能
+     * 根据远程 SDP 内容确定传输模式（offer未带ICE时不接受answer中的ICE）。
+     * 双方都是lite时没有一方发起检查，按c=/m=地址直连。
      */
-    sess->ice_agent = NULL;
-    sess->transport_mode_determined = 0;
-    sess->active_transport_mode = LWS_TRANSPORT_MODE_RTP_DIRECT;
-    lws_log_info("[SESS] Media session created (default: RTP direct mode)");
+    if (!sess->transport_mode_determined) {
+        if ((ice_ufrag.n > 0 || ice_pwd.n > 0 || (audio && audio->cand_count > 0)) &&
+            (sess->ice || !offerer) && !(sess->config.ice_lite && desc.ice_lite)) {
+            sess->active_transport_mode = LWS_TRANSPORT_MODE_ICE;
+            sess->transport_mode_determined = 1;
+            lws_log_info("[SESS] Detected ICE attributes in remote SDP - using ICE mode");
+        } else {
+            sess->active_transport_mode = LWS_TRANSPORT_MODE_RTP_DIRECT;
+            sess->transport_mode_determined = 1;
+            lws_log_info("[SESS] No ICE attributes in remote SDP - using RTP direct mode");
+        }
+    }
 
-    /* Generate random SSRC */
-    sess->audio_ssrc = (uint32_t)rand();
-    sess->audio_timestamp = 0;
-    sess->audio_sequence = (uint16_t)rand();
+    /* 视频先于音频处理：音频协商完成后local_offer_pending被清除 */
+    if (sess->config.enable_video) {
+        apply_remote_video(sess, &desc, lws_sdp_find_media(&desc, "video"));
+    }
 
-    /* Create RTP session for RTCP */
-    if (sess->config.enable_audio && sess->config.enable_rtcp) {
-        struct rtp_event_t rtp_event = {
-            .on_rtcp = on_rtcp_message
-        };
+    /* 记录远端媒体基线（编码/地址/方向/SSRC），后续re-INVITE/UPDATE据此增量更新 */
+    if (sess->config.enable_audio && audio) {
+        if (apply_remote_audio(sess, &desc, audio) < 0) {
+            return -1;
+        }
+    }
 
-        sess->rtp = rtp_create(&rtp_event, sess, sess->audio_ssrc,
-                               sess->audio_timestamp,
-                               sess->config.audio_sample_rate,
-                               0, /* bandwidth */
-                               1  /* sender */);
+    /* 如果是 RTP 直连模式，跳过 ICE 处理 */
+    if (sess->active_transport_mode == LWS_TRANSPORT_MODE_RTP_DIRECT) {
+        lws_log_info("[SESS] RTP direct mode - skipping ICE processing");
+        return 0;
+    }
 
-        if (!sess->rtp) {
-            lws_log_error(0, "[SESS] Failed to create RTP session\n");
-            ice_agent_destroy(sess->ice_agent);
-            lws_free(sess);
-            return NULL;
+    /* 应答方：先创建agent，候选收集在lws_sess_gather_candidates中开始 */
+    if (!sess->ice && ice_create(sess) != 0) {
+        lws_log_error(LWS_ERR_MEDIA_ICE, "[SESS] Failed to create ICE agent\n");
+        return -1;
+    }
+
+    /* ICE 模式：设置 ICE 凭证和候选者 */
+    if (has_ice) {
+        lws_sdp_str_copy(sess->remote_ice_ufrag, sizeof(sess->remote_ice_ufrag), ice_ufrag);
+        lws_sdp_str_copy(sess->remote_ice_pwd, sizeof(sess->remote_ice_pwd), ice_pwd);
+        if (lws_ice_set_remote_auth(sess->ice, sess->remote_ice_ufrag, sess->remote_ice_pwd) != 0) {
+            lws_log_error(LWS_ERR_MEDIA_ICE, "[SESS] Invalid remote ICE credentials\n");
+            return -1;
         }
+        lws_log_info("[SESS] Remote ICE credentials: ufrag=%s", sess->remote_ice_ufrag);
+    } else {
+        lws_log_warn(LWS_ERR_MEDIA_ICE, "[SESS] Failed to parse ICE credentials from SDP\n");
     }
 
-    /* Create RTP payload encoder */
-    if (sess->config.enable_audio && sess->config.audio_capture_dev) {
-        struct rtp_payload_t payload_handler = {
-            .alloc = rtp_alloc,
-            .free = rtp_free,
-            .packet = NULL /* Encoder doesn't need packet callback */
-        };
+    /* offerer为controlling；对端ice-lite时本端总是controlling，本端lite时忽略 (RFC 8445 §6.1.1) */
+    lws_ice_set_controlling(sess->ice, offerer || desc.ice_lite);
 
-        sess->audio_encoder = rtp_payload_encode_create(
-            sess->config.audio_codec,
-            payload_to_name(sess->config.audio_codec),
-            sess->audio_sequence,
-            sess->audio_ssrc,
-            &payload_handler,
-            sess);
+    /* Remote ICE candidates */
+    int cand_count = 0;
+    for (i = 0; audio && i < audio->cand_count; i++) {
+        const lws_sdp_cand_t* c = &audio->cands[i];
+        lws_ice_cand_t cand;
 
-        if (!sess->audio_encoder) {
-            lws_log_error(0, "[SESS] Failed to create RTP encoder\n");
-            if (sess->rtp) rtp_destroy(sess->rtp);
-            ice_agent_destroy(sess->ice_agent);
-            lws_free(sess);
-            return NULL;
+        if (sdp_cand_to_ice(c, &cand) != 0 || lws_ice_add_remote(sess->ice, &cand) != 0) {
+            continue;               /* RTCP(component 2)、TCP、IPv6或重复 */
         }
+        if (sess->turn) {
+            lws_turn_permit(sess->turn, &cand.addr);    /* 未分配时由on_turn_allocated补上 */
+        }
+        cand_count++;
+        lws_log_info("[SESS] Added remote %.*s candidate: %.*s:%d (priority=%u)",
+                     c->type.n, c->type.p, c->addr.n, c->addr.p, c->port, c->priority);
     }
+    lws_log_info("[SESS] Parsed %d remote ICE candidates", cand_count);
 
-    /* Create RTP payload decoder */
-    /* Decoder needed if we have playback device OR recording device */
-    if (sess->config.enable_audio && (sess->config.audio_playback_dev || sess->config.audio_record_dev)) {
-        struct rtp_payload_t payload_handler = {
-            .alloc = rtp_alloc,
-            .free = rtp_free,
-            .packet = rtp_packet
-        };
+    /* 非trickle对端或已给出a=end-of-candidates：候选已完整 (RFC 8838 §9) */
+    if ((!desc.ice_trickle && !(audio && audio->ice_trickle)) ||
+        desc.end_of_candidates || (audio && audio->end_of_candidates)) {
+        lws_ice_end_of_candidates(sess->ice);
+    }
 
-        sess->audio_decoder = rtp_payload_decode_create(
-            sess->config.audio_codec,
-            payload_to_name(sess->config.audio_codec),
-            &payload_handler,
-            sess);
+    return 0;
+}
 
-        if (!sess->audio_decoder) {
-            lws_log_error(0, "[SESS] Failed to create RTP decoder\n");
-            if (sess->audio_encoder) rtp_payload_encode_destroy(sess->audio_encoder);
-            if (sess->rtp) rtp_destroy(sess->rtp);
-            ice_agent_destroy(sess->ice_agent);
-            lws_free(sess);
-            return NULL;
-        }
-        lws_log_info("[SESS] Created RTP payload decoder\n");
+/**
+ * @brief Add remote ICE candidate (trickle ICE)
+ */
+int lws_sess_add_remote_candidate(lws_sess_t* sess, const char* candidate)
+{
+    lws_sdp_cand_t c;
+    lws_ice_cand_t cand;
+
+    if (!sess || !candidate || !sess->ice) {
+        return -1;
     }
 
-    sess->session_start_time = get_current_time_us();
+    lws_log_debug("[SESS] Adding remote candidate: %s", candidate);
 
-    lws_log_info("[SESS] Media session created successfully");
-    return sess;
+    if (strncmp(candidate, "a=", 2) == 0) {
+        candidate += 2;
+    }
+    if (lws_sdp_parse_candidate(&c, candidate, -1) != 0 || sdp_cand_to_ice(&c, &cand) != 0) {
+        lws_log_warn(LWS_ERR_MEDIA_ICE, "[SESS] Malformed remote candidate\n");
+        return -1;
+    }
+
+    if (lws_ice_add_remote(sess->ice, &cand) != 0) {
+        return -1;
+    }
+    if (sess->turn) {
+        lws_turn_permit(sess->turn, &cand.addr);
+    }
+    return 0;
+}
+
+int lws_sess_end_of_candidates(lws_sess_t* sess)
+{
+    if (!sess || !sess->ice) {
+        return -1;
+    }
+    lws_ice_end_of_candidates(sess->ice);
+    return 0;
 }
 
 /**
- * @brief Destroy media session instance
+ * @brief Apply a new remote offer/answer to the live session (re-INVITE/UPDATE)
  */
-void lws_sess_destroy(lws_sess_t* sess)
+int lws_sess_update_remote_sdp(lws_sess_t* sess, const char* sdp)
+{
+    lws_sdp_t desc;
+    const lws_sdp_media_t* audio;
+    int changes;
+
+    if (!sess || !sdp) {
+        return -1;
+    }
+
+    if (!sess->remote_sdp_applied) {
+        /* 首次SDP交换，按初始协商处理 */
+        return lws_sess_set_remote_sdp(sess, sdp) == 0 ? 0 : -1;
+    }
+
+    if (lws_sdp_parse(&desc, sdp, -1) != 0 ||
+        (audio = lws_sdp_find_media(&desc, "audio")) == NULL) {
+        lws_log_warn(LWS_ERR_MEDIA_SDP, "[SESS] Remote SDP has no audio stream\n");
+        return -1;
+    }
+
+    /* 版本未变化表示SDP内容未变化（如session refresh），无需比较；answer同样结束本端offer */
+    if (desc.sess_version == sess->remote_sdp_version) {
+        lws_log_debug("[SESS] Remote SDP unchanged (version %llu)",
+                      (unsigned long long)desc.sess_version);
+        sess->local_offer_pending = 0;
+        return 0;
+    }
+
+    if (sess->config.enable_video) {
+        apply_remote_video(sess, &desc, lws_sdp_find_media(&desc, "video"));
+    }
+
+    changes = apply_remote_audio(sess, &desc, audio);
+    if (changes < 0) {
+        return -1;
+    }
+
+    /* 重新生成应答（内容变化时sess-version递增） */
+    if (sess->state >= LWS_SESS_STATE_GATHERED) {
+        generate_local_sdp(sess);
+    }
+
+    lws_log_info("[SESS] Remote SDP updated (changes=0x%x)", changes);
+    return changes;
+}
+
+/**
+ * @brief Change the local media direction (hold/resume)
+ */
+int lws_sess_set_media_dir(lws_sess_t* sess, lws_media_dir_t dir)
 {
     if (!sess) {
-        return;
+        return -1;
     }
 
-    lws_log_info("[SESS] Destroying media session");
+    sess->config.media_dir = dir;
 
-    /* Change state */
-    change_state(sess, LWS_SESS_STATE_CLOSED);
+    /* 新offer声明本端期望的方向，而非与上次应答协商的结果 */
+    sess->active_dir = dir;
+    if (sess->state >= LWS_SESS_STATE_GATHERED) {
+        generate_local_sdp(sess);
+    }
 
-    /* Destroy RTP payload encoder/decoder */
-    if (sess->audio_encoder) {
-        rtp_payload_encode_destroy(sess->audio_encoder);
+    /* 在应答到达（lws_sess_update_remote_sdp）之前，按上次的远端方向收发 */
+    if (sess->remote_sdp_applied) {
+        sess->active_dir = media_dir_negotiate(dir, sess->remote_dir);
     }
 
-    if (sess->audio_decoder) {
-        rtp_payload_decode_destroy(sess->audio_decoder);
+    lws_log_info("[SESS] Local media direction set to %s", media_dir_name(dir));
+    return 0;
+}
+
+/**
+ * @brief Mark the local SDP as an offer sent to / settled with the peer
+ */
+int lws_sess_set_offer_pending(lws_sess_t* sess, int pending)
+{
+    if (!sess) {
+        return -1;
     }
 
-    /* Destroy RTP session */
-    if (sess->rtp) {
-        rtp_destroy(sess->rtp);
+    sess->local_offer_pending = pending ? 1 : 0;
+    return 0;
+}
+
+/**
+ * @brief Start ICE connectivity checks
+ */
+int lws_sess_start_ice(lws_sess_t* sess)
+{
+    if (!sess) {
+        return -1;
     }
 
-    /* Destroy ICE agent */
-    if (sess->ice_agent) {
-        ice_agent_destroy(sess->ice_agent);
+    /* In RTP direct mode, skip ICE and go directly to connected state */
+    if (!sess->transport_mode_determined ||
+        sess->active_transport_mode == LWS_TRANSPORT_MODE_RTP_DIRECT) {
+        lws_log_info("[SESS] RTP direct mode - skipping ICE, going to CONNECTED");
+        change_state(sess, LWS_SESS_STATE_CONNECTED);
+
+        /* Notify connected callback */
+        if (sess->handler.on_connected) {
+            sess->handler.on_connected(sess, sess->handler.userdata);
+        }
+
+        return 0;
     }
 
-    /* Close media socket */
-    if (sess->media_socket >= 0) {
-        close(sess->media_socket);
-        sess->media_socket = -1;
+    /* ICE mode - start ICE connectivity checks */
+    lws_log_info("[SESS] Starting ICE connectivity checks");
+
+    if (!sess->ice) {
+        return -1;
     }
+    change_state(sess, LWS_SESS_STATE_CONNECTING);
 
-    /* Free session structure */
-    lws_free(sess);
+    return lws_ice_start(sess->ice, get_current_time_us());
+}
 
-    lws_log_info("[SESS] Media session destroyed");
+/* ========================================
+ * DTMF (RFC 4733)
+ * ======================================== */
+
+static int dtmf_digit_to_event(char digit)
+{
+    if (digit >= '0' && digit <= '9') return digit - '0';
+    if (digit == '*') return 10;
+    if (digit == '#') return 11;
+    if (digit >= 'A' && digit <= 'D') return 12 + (digit - 'A');
+    if (digit >= 'a' && digit <= 'd') return 12 + (digit - 'a');
+    return -1;
+}
+
+static char dtmf_event_to_digit(int event)
+{
+    static const char digits[] = "0123456789*#ABCD";
+    return (event >= 0 && event < 16) ? digits[event] : '\0';
 }
 
 /**
- * @brief Start gathering ICE candidates
+ * @brief Send one telephone-event packet of the current event
  */
+static void dtmf_send_packet(lws_sess_t* sess, int marker, int end)
+{
+    uint8_t payload[4];
+
+    /* event | E R volume | duration */
+    payload[0] = sess->dtmf_tx_event;
+    payload[1] = (uint8_t)((end ? 0x80 : 0x00) | LWS_SESS_DTMF_VOLUME);
+    payload[2] = (uint8_t)(sess->dtmf_tx_duration >> 8);
+    payload[3] = (uint8_t)(sess->dtmf_tx_duration);
+
+    audio_send_raw(sess, sess->dtmf_tx_pt, marker, sess->dtmf_tx_timestamp,
+                   payload, sizeof(payload));
+}
+
 /**
- * @brief Get local IP address from network interfaces
- * Returns the first non-loopback IPv4 address found
+ * @brief Start the next queued digit
+ * @return 0 if an event was started
  */
-static int get_local_ipv4(struct sockaddr_in* addr)
+static int dtmf_start_event(lws_sess_t* sess, uint64_t now)
 {
-#ifdef __APPLE__
-    /* For macOS, use getifaddrs */
-    struct ifaddrs* ifaddr = NULL;
-    struct ifaddrs* ifa = NULL;
-    int found = 0;
-
-    if (getifaddrs(&ifaddr) == -1) {
+    const lws_sess_codec_t* te = lws_codec_find(&sess->audio_codecs,
+                                                LWS_RTP_PAYLOAD_TELEPHONE_EVENT,
+                                                sess->audio_codec.clock_rate);
+    lws_sess_dtmf_t digit = sess->dtmf_queue[0];
+    uint32_t total;
+
+    sess->dtmf_queue_len--;
+    memmove(&sess->dtmf_queue[0], &sess->dtmf_queue[1],
+            sess->dtmf_queue_len * sizeof(sess->dtmf_queue[0]));
+
+    if (!te) {
+        /* 重新协商后对端不再支持telephone-event */
+        sess->dtmf_queue_len = 0;
         return -1;
     }
 
-    /* Iterate through network interfaces */
-    for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
-        if (ifa->ifa_addr == NULL) {
-            continue;
-        }
-
-        /* Look for IPv4 non-loopback address */
-        if (ifa->ifa_addr->sa_family == AF_INET) {
-            struct sockaddr_in* sin = (struct sockaddr_in*)ifa->ifa_addr;
+    /* DTMF包接续音频打包器的序号 */
+    audio_pause_encoder(sess);
+
+    /* 时长字段为16位，超出时截断（长按键的分段发送不需要） */
+    total = (uint32_t)digit.duration_ms * (uint32_t)te->clock_rate / 1000;
+    sess->dtmf_tx_active = 1;
+    sess->dtmf_tx_event = digit.event;
+    sess->dtmf_tx_pt = te->send_pt;
+    sess->dtmf_tx_clock = te->clock_rate;
+    sess->dtmf_tx_timestamp = sess->audio_timestamp;
+    sess->dtmf_tx_total = LWS_MIN(total, 0xffffu);
+    sess->dtmf_tx_duration = 0;
+    sess->dtmf_tx_end_sent = 0;
+    sess->dtmf_tx_next_us = now;
+
+    lws_log_info("[SESS] Sending DTMF '%c' (%d ms, PT %d)",
+                 dtmf_event_to_digit(digit.event), digit.duration_ms, te->send_pt);
+    return 0;
+}
 
-            /* Skip loopback (127.x.x.x) */
-            if ((ntohl(sin->sin_addr.s_addr) & 0xFF000000) == 0x7F000000) {
-                continue;
-            }
+/**
+ * @brief Drive DTMF sending: one packet per frame interval
+ */
+static void dtmf_send_process(lws_sess_t* sess, uint64_t now)
+{
+    uint32_t step;
 
-            /* Found a valid address */
-            memcpy(addr, sin, sizeof(*addr));
-            found = 1;
-            break;
+    if (!sess->dtmf_tx_active) {
+        if (sess->dtmf_queue_len == 0 || now < sess->dtmf_tx_next_us ||
+            dtmf_start_event(sess, now) != 0) {
+            return;
         }
     }
 
-    freeifaddrs(ifaddr);
-    return found ? 0 : -1;
-#else
-    /* For Linux/other platforms */
-    /* Simplified version: just use any non-loopback interface */
-    int sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock < 0) {
-        return -1;
+    if (now < sess->dtmf_tx_next_us) {
+        return;
     }
+    sess->dtmf_tx_next_us += LWS_DEFAULT_FRAME_DURATION * 1000;
 
-    /* Connect to a remote address to determine local IP */
-    struct sockaddr_in remote;
-    memset(&remote, 0, sizeof(remote));
-    remote.sin_family = AF_INET;
-    remote.sin_port = htons(53); /* DNS port */
-    inet_pton(AF_INET, "8.8.8.8", &remote.sin_addr);
+    if (sess->dtmf_tx_duration < sess->dtmf_tx_total) {
+        step = (uint32_t)sess->dtmf_tx_clock * LWS_DEFAULT_FRAME_DURATION / 1000;
+        int marker = (sess->dtmf_tx_duration == 0);
+        sess->dtmf_tx_duration = LWS_MIN(sess->dtmf_tx_duration + step, sess->dtmf_tx_total);
+        dtmf_send_packet(sess, marker, 0);
+        return;
+    }
 
-    if (connect(sock, (struct sockaddr*)&remote, sizeof(remote)) < 0) {
-        close(sock);
-        return -1;
+    /* 结束包：相同timestamp和duration，新序号 */
+    dtmf_send_packet(sess, 0, 1);
+    if (++sess->dtmf_tx_end_sent < LWS_SESS_DTMF_END_PACKETS) {
+        return;
     }
 
-    socklen_t len = sizeof(*addr);
-    if (getsockname(sock, (struct sockaddr*)addr, &len) < 0) {
-        close(sock);
-        return -1;
+    sess->dtmf_tx_active = 0;
+    sess->dtmf_tx_next_us = now + LWS_SESS_DTMF_GAP_MS * 1000;
+
+    /* 无采集设备时timestamp不随音频推进，保证下一个事件的timestamp不同 */
+    uint32_t end = sess->dtmf_tx_timestamp + sess->dtmf_tx_total;
+    if ((int32_t)(sess->audio_timestamp - end) < 0) {
+        sess->audio_timestamp = end;
     }
 
-    close(sock);
-    return 0;
-#endif
+    /* 音频从DTMF之后的序号继续（静音期间由DTX继续持有） */
+    if (!sess->dtx_active) {
+        audio_resume_encoder(sess);
+    }
 }
 
 /**
- * @brief Add a local host candidate to ICE agent
+ * @brief Report the received event to the application (once)
  */
-static int add_local_host_candidate(lws_sess_t* sess, uint8_t stream,
-                                    uint16_t component, const struct sockaddr* addr)
+static void dtmf_rx_report(lws_sess_t* sess)
 {
-    struct ice_candidate_t cand;
-
-    memset(&cand, 0, sizeof(cand));
-    cand.stream = stream;
-    cand.component = component;
-    cand.type = ICE_CANDIDATE_HOST;
-    cand.protocol = STUN_PROTOCOL_UDP;
+    char digit = dtmf_event_to_digit(sess->dtmf_rx_event);
+    int duration_ms = sess->dtmf_rx_clock > 0 ?
+        (int)((uint64_t)sess->dtmf_rx_duration * 1000 / (uint32_t)sess->dtmf_rx_clock) : 0;
 
-    /* For host candidates, both addr and host are the same */
-    memcpy(&cand.host, addr, sizeof(struct sockaddr_in));
-    memcpy(&cand.addr, addr, sizeof(struct sockaddr_in));
+    sess->dtmf_rx_active = 0;
+    sess->dtmf_rx_done_timestamp = sess->dtmf_rx_timestamp;
+    sess->dtmf_rx_done_valid = 1;
 
-    /* Calculate priority */
-    ice_candidate_priority(&cand);
-
-    /* Set foundation */
-    snprintf(cand.foundation, sizeof(cand.foundation), "%d", component);
-
-    int ret = ice_agent_add_local_candidate(sess->ice_agent, &cand);
-    if (ret == 0) {
-        char addr_str[INET_ADDRSTRLEN];
-        struct sockaddr_in* sin = (struct sockaddr_in*)addr;
-        inet_ntop(AF_INET, &sin->sin_addr, addr_str, sizeof(addr_str));
-        lws_log_info("[SESS] Added local host candidate: %s:%d (stream=%d, component=%d, priority=%u)\n",
-                    addr_str, ntohs(sin->sin_port), stream, component, cand.priority);
+    if (!digit) {
+        return;  /* Flash及其它非按键事件 */
     }
 
-    return ret;
+    lws_log_info("[SESS] Received DTMF '%c' (%d ms)", digit, duration_ms);
+    if (sess->handler.on_dtmf) {
+        sess->handler.on_dtmf(sess, digit, duration_ms, sess->handler.userdata);
+    }
 }
 
-int lws_sess_gather_candidates(lws_sess_t* sess)
+/**
+ * @brief Handle a received telephone-event packet
+ */
+static void dtmf_input(lws_sess_t* sess, const lws_sess_codec_t* te,
+                       const uint8_t* data, int bytes)
 {
-    if (!sess) {
-        return -1;
-    }
+    int offset = rtp_payload_offset(data, bytes);
+    uint32_t timestamp;
 
-    /*
-     * 默认直接生成 SDP，不进行 ICE 候选收集
-     * 这适用于服务器中转模式（最常见的场景）
-     * 如果后续检测到远程 SDP 包含 ICE，会动态切换到 ICE 模式
-     */
-    lws_log_info("[SESS] Generating local SDP (without ICE gathering)");
+    if (offset < 0 || bytes < offset + 4) {
+        return;
+    }
 
-    change_state(sess, LWS_SESS_STATE_GATHERING);
+    timestamp = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) |
+                ((uint32_t)data[6] << 8) | (uint32_t)data[7];
 
-    /* Generate SDP immediately */
-    if (generate_local_sdp(sess) == 0) {
-        change_state(sess, LWS_SESS_STATE_GATHERED);
+    /* 上一个事件的结束包全部丢失 */
+    if (sess->dtmf_rx_active && timestamp != sess->dtmf_rx_timestamp) {
+        dtmf_rx_report(sess);
+    }
 
-        /* Notify SDP ready */
-        if (sess->handler.on_sdp_ready) {
-            sess->handler.on_sdp_ready(sess, sess->local_sdp, sess->handler.userdata);
+    if (!sess->dtmf_rx_active) {
+        /* 已上报事件的冗余结束包 */
+        if (sess->dtmf_rx_done_valid && timestamp == sess->dtmf_rx_done_timestamp) {
+            return;
         }
+        sess->dtmf_rx_active = 1;
+        sess->dtmf_rx_timestamp = timestamp;
+        sess->dtmf_rx_event = data[offset];
+        sess->dtmf_rx_duration = 0;
+        sess->dtmf_rx_clock = te->clock_rate;
     }
 
-    return 0;
+    uint32_t duration = ((uint32_t)data[offset + 2] << 8) | data[offset + 3];
+    if (duration > sess->dtmf_rx_duration) {
+        sess->dtmf_rx_duration = duration;
+    }
+    sess->dtmf_rx_last_us = get_current_time_us();
+
+    if (data[offset + 1] & 0x80) {
+        dtmf_rx_report(sess);
+    }
 }
 
 /**
- * @brief Parse SDP attribute value
- * @param sdp SDP string
- * @param attr Attribute name (e.g., "ice-ufrag")
- * @param value Output buffer for value
- * @param value_size Size of output buffer
- * @return 0 on success, -1 on failure
+ * @brief Queue DTMF digits for RFC 4733 sending
  */
-static int parse_sdp_attribute(const char* sdp, const char* attr, char* value, size_t value_size)
+int lws_sess_send_dtmf(lws_sess_t* sess, const char* digits, int duration_ms)
 {
-    char search_str[128];
-    const char* line;
-    const char* end;
-    size_t attr_len;
+    int count;
+    int i;
 
-    snprintf(search_str, sizeof(search_str), "a=%s:", attr);
-    line = strstr(sdp, search_str);
-
-    if (!line) {
+    if (!sess || !digits || !digits[0]) {
         return -1;
     }
 
-    /* Move past "a=attr:" */
-    line += strlen(search_str);
+    if (!lws_codec_find(&sess->audio_codecs, LWS_RTP_PAYLOAD_TELEPHONE_EVENT,
+                        sess->audio_codec.clock_rate)) {
+        lws_log_warn(LWS_ERR_MEDIA_SDP, "[SESS] telephone-event not negotiated\n");
+        return -1;
+    }
 
-    /* Find end of line */
-    end = strchr(line, '\r');
-    if (!end) {
-        end = strchr(line, '\n');
+    count = (int)strlen(digits);
+    if (sess->dtmf_queue_len + count > LWS_SESS_DTMF_QUEUE) {
+        lws_log_warn(0, "[SESS] DTMF queue full\n");
+        return -1;
     }
-    if (!end) {
-        end = line + strlen(line);
+    for (i = 0; i < count; i++) {
+        if (dtmf_digit_to_event(digits[i]) < 0) {
+            lws_log_warn(0, "[SESS] Invalid DTMF digit '%c'\n", digits[i]);
+            return -1;
+        }
     }
 
-    /* Copy value */
-    attr_len = end - line;
-    if (attr_len >= value_size) {
-        attr_len = value_size - 1;
+    if (duration_ms <= 0) {
+        duration_ms = LWS_SESS_DTMF_DEFAULT_MS;
     }
+    duration_ms = LWS_MAX(duration_ms, LWS_SESS_DTMF_MIN_MS);
+    duration_ms = LWS_MIN(duration_ms, 0xffff);
 
-    memcpy(value, line, attr_len);
-    value[attr_len] = '\0';
+    for (i = 0; i < count; i++) {
+        lws_sess_dtmf_t* d = &sess->dtmf_queue[sess->dtmf_queue_len++];
+        d->event = (uint8_t)dtmf_digit_to_event(digits[i]);
+        d->duration_ms = (uint16_t)duration_ms;
+    }
 
     return 0;
 }
 
+/* ========================================
+ * VAD/DTX and comfort noise (RFC 3389)
+ * ======================================== */
+
 /**
- * @brief Set remote SDP
+ * @brief Run the VAD on a captured frame and drive DTX
+ *
+ * 静音期间不发送音频，进入静音时及之后每LWS_SESS_CN_REFRESH_US（或噪声
+ * 电平变化超过LWS_SESS_CN_LEVEL_DELTA时）发送一个CN(SID)包。
+ * timestamp照常推进，序号保持连续，接收端不会把静音间隔计为丢包。
+ *
+ * @return 1 if the frame must not be sent, 0 otherwise
  */
-int lws_sess_set_remote_sdp(lws_sess_t* sess, const char* sdp)
+static int dtx_process(lws_sess_t* sess, const int16_t* pcm, int samples)
 {
-    char ufrag[LWS_MAX_UFRAG_LEN];
-    char pwd[LWS_MAX_PWD_LEN];
-    int ret;
+    const lws_sess_codec_t* cn;
+    const lws_cn_params_t* noise;
+    uint8_t payload[1 + LWS_CN_MAX_ORDER];
+    uint64_t now;
+    int len;
 
-    if (!sess || !sdp) {
-        return -1;
+    if (!sess->config.dtx) {
+        return 0;
     }
 
-    lws_log_info("[SESS] Setting remote SDP (%zu bytes)", strlen(sdp));
-    lws_log_debug("[SESS] Remote SDP:\n%s", sdp);
-
-    /* 根据远程 SDP 内容确定传输模式 */
-    if (!sess->transport_mode_determined) {
-        if (sdp_has_ice_attributes(sdp)) {
-            sess->active_transport_mode = LWS_TRANSPORT_MODE_ICE;
-            sess->transport_mode_determined = 1;
-            lws_log_info("[SESS] Detected ICE attributes in remote SDP - using ICE mode");
-        } else {
-            sess->active_transport_mode = LWS_TRANSPORT_MODE_RTP_DIRECT;
-            sess->transport_mode_determined = 1;
-            lws_log_info("[SESS] No ICE attributes in remote SDP - using RTP direct mode");
+    /* 对端未接受CN时不做DTX */
+    cn = lws_codec_find(&sess->audio_codecs, LWS_RTP_PAYLOAD_CN, sess->audio_codec.clock_rate);
+    if (!cn || lws_vad_process(&sess->vad, pcm, samples)) {
+        if (sess->dtx_active) {
+            lws_log_debug("[SESS] DTX: speech resumed");
+            sess->dtx_active = 0;
+            sess->audio_talkspurt = 1;
+            audio_resume_encoder(sess);
         }
-    }
-
-    /* 如果是 RTP 直连模式，跳过 ICE 处理 */
-    if (sess->active_transport_mode == LWS_TRANSPORT_MODE_RTP_DIRECT) {
-        lws_log_info("[SESS] RTP direct mode - skipping ICE processing");
-        /* TODO: 解析 c= 行获取远程 IP 和 m= 行获取远程端口 */
         return 0;
     }
 
-    /* ICE 模式：解析 ICE 凭证和候选者 */
-    /* Parse ICE credentials */
-    if (parse_sdp_attribute(sdp, "ice-ufrag", ufrag, sizeof(ufrag)) == 0 &&
-        parse_sdp_attribute(sdp, "ice-pwd", pwd, sizeof(pwd)) == 0) {
+    noise = lws_vad_noise(&sess->vad);
+    now = get_current_time_us();
+    if (!sess->dtx_active || now >= sess->cn_tx_next_us ||
+        noise->level - sess->cn_tx_level >= LWS_SESS_CN_LEVEL_DELTA ||
+        sess->cn_tx_level - noise->level >= LWS_SESS_CN_LEVEL_DELTA) {
+        if (!sess->dtx_active) {
+            lws_log_debug("[SESS] DTX: silence, noise level -%d dBov", noise->level);
+        }
+        audio_pause_encoder(sess);
+        len = lws_cn_encode(noise, payload, sizeof(payload));
+        audio_send_raw(sess, cn->send_pt, 0, sess->audio_timestamp, payload, len);
+        sess->cn_tx_level = noise->level;
+        sess->cn_tx_next_us = now + LWS_SESS_CN_REFRESH_US;
+    }
 
-        lws_log_info("[SESS] Extracted remote ICE credentials: ufrag=%s, pwd=%s", ufrag, pwd);
+    sess->dtx_active = 1;
+    return 1;
+}
 
-        /* Set remote auth for stream 0 */
-        ret = ice_agent_set_remote_auth(sess->ice_agent, 0, ufrag, pwd);
-        if (ret != 0) {
-            lws_log_error(0, "[SESS] Failed to set remote ICE auth (ret=%d)\n", ret);
-            return -1;
-        }
+/**
+ * @brief Handle a received CN packet: start/update comfort noise playout
+ */
+static void cn_input(lws_sess_t* sess, const uint8_t* data, int bytes)
+{
+    lws_cn_params_t params;
+    int offset = rtp_payload_offset(data, bytes);
 
-        lws_log_info("[SESS] Remote ICE auth set successfully");
-    } else {
-        lws_log_warn(0, "[SESS] Failed to parse ICE credentials from SDP\n");
+    if (offset < 0 || lws_cn_decode(&params, data + offset, bytes - offset) != 0) {
+        return;
     }
 
-    /* Parse remote ICE candidates */
-    const char* line = sdp;
-    const char* cand_prefix = "a=candidate:";
-    int cand_count = 0;
+    lws_cn_gen_update(&sess->cn_gen, &params);
+    if (!sess->cn_rx_active) {
+        lws_log_debug("[SESS] Peer in DTX, comfort noise at -%d dBov", params.level);
+        sess->cn_rx_active = 1;
+        sess->cn_rx_next_us = get_current_time_us();
+    }
+}
 
-    while ((line = strstr(line, cand_prefix)) != NULL) {
-        const char* cand_line = line;
-        const char* end;
+/**
+ * @brief Play comfort noise frames while the peer is silent
+ */
+static void cn_playout(lws_sess_t* sess, uint64_t now)
+{
+    int16_t pcm[LWS_MAX_AUDIO_SAMPLES_20MS];
+    int samples = sess->config.audio_sample_rate * LWS_DEFAULT_FRAME_DURATION / 1000;
 
-        /* Find end of candidate line */
-        end = strchr(cand_line, '\r');
-        if (!end) {
-            end = strchr(cand_line, '\n');
-        }
-        if (!end) {
-            end = cand_line + strlen(cand_line);
-        }
+    if (samples <= 0 || samples > LWS_MAX_AUDIO_SAMPLES_20MS) {
+        return;
+    }
 
-        /* Parse candidate fields */
-        struct ice_candidate_t cand;
-        char foundation[33];
-        char transport[10];
-        char ip[64];
-        char cand_type[16];
-        uint16_t component;
-        uint32_t priority;
-        uint16_t port;
+    /* 长时间未调用lws_sess_loop时不补发积压的帧 */
+    if (now > sess->cn_rx_next_us + LWS_SESS_CN_MAX_LAG_US) {
+        sess->cn_rx_next_us = now;
+    }
 
-        memset(&cand, 0, sizeof(cand));
-
-        /* Parse: a=candidate:foundation component transport priority ip port typ type */
-        int fields = sscanf(cand_line, "a=candidate:%32s %hu %9s %u %63s %hu typ %15s",
-                           foundation, &component, transport, &priority, ip, &port, cand_type);
-
-        if (fields == 7) {
-            /* Set candidate fields */
-            snprintf(cand.foundation, sizeof(cand.foundation), "%s", foundation);
-            cand.stream = 0;
-            cand.component = component;
-            cand.protocol = STUN_PROTOCOL_UDP;  /* Assume UDP for now */
-            cand.priority = priority;
-
-            /* Parse candidate type */
-            if (strcmp(cand_type, "host") == 0) {
-                cand.type = ICE_CANDIDATE_HOST;
-            } else if (strcmp(cand_type, "srflx") == 0) {
-                cand.type = ICE_CANDIDATE_SERVER_REFLEXIVE;
-            } else if (strcmp(cand_type, "relay") == 0) {
-                cand.type = ICE_CANDIDATE_RELAYED;
-            } else {
-                lws_log_warn(0, "[SESS] Unknown candidate type: %s\n", cand_type);
-                line = end;
-                continue;
-            }
+    while (now >= sess->cn_rx_next_us) {
+        lws_cn_generate(&sess->cn_gen, pcm, samples);
+        audio_playout(sess, pcm, samples, sess->rx_play_timestamp);
+        sess->cn_rx_next_us += LWS_DEFAULT_FRAME_DURATION * 1000;
+    }
+}
 
-            /* Parse IP address and port */
-            struct sockaddr_in* sin = (struct sockaddr_in*)&cand.addr;
-            sin->sin_family = AF_INET;
-            sin->sin_port = htons(port);
-            if (inet_pton(AF_INET, ip, &sin->sin_addr) != 1) {
-                lws_log_warn(0, "[SESS] Failed to parse candidate IP: %s\n", ip);
-                line = end;
-                continue;
-            }
+/* ========================================
+ * RTP receive
+ * ======================================== */
 
-            /* For host candidates, addr and host are the same */
-            memcpy(&cand.host, &cand.addr, sizeof(cand.host));
-
-            /* Add candidate to ICE agent */
-            ret = ice_agent_add_remote_candidate(sess->ice_agent, &cand);
-            if (ret == 0) {
-                cand_count++;
-                lws_log_info("[SESS] Added remote %s candidate: %s:%d (component=%d, priority=%u)",
-                            cand_type, ip, port, component, priority);
-            } else {
-                lws_log_warn(0, "[SESS] Failed to add remote candidate (ret=%d)\n", ret);
+/**
+ * @brief Update loss and jitter statistics from a received packet
+ *
+ * 丢包按序号计算 (RFC 3550 A.1)：DTX静音期间不发包但序号连续，
+ * 因此静音间隔不会被计为丢包；timestamp随墙钟推进，也不影响抖动。
+ */
+static void rtp_rx_stats(lws_sess_t* sess, const uint8_t* data)
+{
+    uint16_t seq = (uint16_t)(((uint16_t)data[2] << 8) | data[3]);
+    uint32_t timestamp = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) |
+                         ((uint32_t)data[6] << 8) | (uint32_t)data[7];
+    uint32_t arrival, transit, expected;
+    int clock_rate = sess->audio_codec.clock_rate > 0 ? sess->audio_codec.clock_rate : 8000;
+
+    if (!sess->rx_seq_valid) {
+        sess->rx_seq_valid = 1;
+        sess->rx_base_seq = seq;
+        sess->rx_max_seq = seq;
+        sess->rx_cycles = 0;
+        sess->rx_received = 0;
+        sess->rx_recovered = 0;
+        sess->rx_jitter = 0;
+        sess->rx_transit = 0;
+        lws_red_receiver_reset(&sess->red_rx);
+    } else {
+        uint16_t delta = (uint16_t)(seq - sess->rx_max_seq);
+        if (delta < 3000) {
+            if (seq < sess->rx_max_seq) {
+                sess->rx_cycles += 65536;
             }
+            sess->rx_max_seq = seq;
+        } else if (delta <= 65536 - 100) {
+            /* 序号大跳变：对端重启了流，重新开始统计 */
+            sess->rx_base_seq = seq;
+            sess->rx_max_seq = seq;
+            sess->rx_cycles = 0;
+            sess->rx_received = 0;
+            sess->rx_recovered = 0;
+            lws_red_receiver_reset(&sess->red_rx);
         }
-
-        line = end;
+        /* 否则为乱序或重复包 */
     }
-
-    if (cand_count > 0) {
-        lws_log_info("[SESS] Parsed %d remote ICE candidates", cand_count);
-    } else {
-        lws_log_warn(0, "[SESS] No remote ICE candidates found in SDP\n");
+    sess->rx_received++;
+
+    expected = sess->rx_cycles + sess->rx_max_seq - sess->rx_base_seq + 1;
+    sess->audio_stats.lost_packets = expected > sess->rx_received ?
+                                     expected - sess->rx_received : 0;
+    sess->audio_stats.loss_rate = (double)sess->audio_stats.lost_packets / expected;
+
+    /* Interarrival jitter (RFC 3550 A.8) */
+    arrival = (uint32_t)(get_current_time_us() * (uint64_t)clock_rate / 1000000);
+    transit = arrival - timestamp;
+    if (sess->rx_received > 1) {
+        int32_t d = (int32_t)(transit - sess->rx_transit);
+        if (d < 0) {
+            d = -d;
+        }
+        sess->rx_jitter += (uint32_t)d - ((sess->rx_jitter + 8) >> 4);
     }
-
-    return 0;
+    sess->rx_transit = transit;
+    sess->audio_stats.jitter = sess->rx_jitter >> 4;
 }
 
 /**
- * @brief Add remote ICE candidate (trickle ICE)
+ * @brief Plain audio RTP packet from the RED receiver (received or rebuilt)
  */
-int lws_sess_add_remote_candidate(lws_sess_t* sess, const char* candidate)
+static void red_deliver(void* param, const uint8_t* packet, int bytes)
 {
-    if (!sess || !candidate) {
-        return -1;
-    }
-
-    lws_log_debug("[SESS] Adding remote candidate: %s", candidate);
-
-    /* TODO: Parse candidate string and add to ICE agent */
+    lws_sess_t* sess = (lws_sess_t*)param;
 
-    return 0;
+    if (sess->audio_decoder) {
+        rtp_payload_decode_input(sess->audio_decoder, packet, bytes);
+    }
 }
 
 /**
- * @brief Start ICE connectivity checks
+ * @brief Dispatch a received RTP packet: telephone-event, CN or audio decoder
+ *
+ * 协商了RED时音频包经RED接收端：丢失的包由后续包的冗余块重建，
+ * 按序号先于当前帧交给解码器。
  */
-int lws_sess_start_ice(lws_sess_t* sess)
+static void media_rtp_input(lws_sess_t* sess, const uint8_t* data, int bytes)
 {
-    if (!sess) {
-        return -1;
+    int pt;
+    int i;
+
+    if (bytes < 12 || (data[0] & 0xc0) != 0x80) {
+        return;
     }
 
-    /* In RTP direct mode, skip ICE and go directly to connected state */
-    if (!sess->transport_mode_determined ||
-        sess->active_transport_mode == LWS_TRANSPORT_MODE_RTP_DIRECT) {
-        lws_log_info("[SESS] RTP direct mode - skipping ICE, going to CONNECTED");
-        change_state(sess, LWS_SESS_STATE_CONNECTED);
+    rtp_rx_stats(sess, data);
 
-        /* Notify connected callback */
-        if (sess->handler.on_connected) {
-            sess->handler.on_connected(sess, sess->handler.userdata);
+    pt = data[1] & 0x7f;
+    for (i = 0; i < sess->audio_codecs.count; i++) {
+        const lws_sess_codec_t* e = &sess->audio_codecs.entries[i];
+        if (e->recv_pt != pt) {
+            continue;
         }
-
-        return 0;
+        if (e->codec == LWS_RTP_PAYLOAD_TELEPHONE_EVENT) {
+            dtmf_input(sess, e, data, bytes);
+            return;
+        }
+        if (e->codec == LWS_RTP_PAYLOAD_CN) {
+            cn_input(sess, data, bytes);
+            return;
+        }
+        break;
     }
 
-    /* ICE mode - start ICE connectivity checks */
-    lws_log_info("[SESS] Starting ICE connectivity checks");
-
-    change_state(sess, LWS_SESS_STATE_CONNECTING);
+    /* 对端恢复发送语音 */
+    sess->cn_rx_active = 0;
 
-    return ice_agent_start(sess->ice_agent);
+    if (sess->red_rx.pt >= 0) {
+        uint64_t recovered = sess->red_rx.recovered;
+        lws_red_receive(&sess->red_rx, data, bytes);
+        sess->rx_recovered += (uint32_t)(sess->red_rx.recovered - recovered);
+    } else if (sess->audio_decoder) {
+        rtp_payload_decode_input(sess->audio_decoder, data, bytes);
+    }
 }
 
 /**
@@ -1072,14 +4849,9 @@ int lws_sess_loop(lws_sess_t* sess, int timeout_ms)
     /* Process incoming packets (STUN/RTP) from socket */
     if (sess->media_socket >= 0) {
         uint8_t buffer[2048];
-        struct sockaddr_in local_addr;
         struct sockaddr_in remote_addr;
         socklen_t addr_len;
 
-        /* Get local address for this socket */
-        addr_len = sizeof(local_addr);
-        getsockname(sess->media_socket, (struct sockaddr*)&local_addr, &addr_len);
-
         /* Read all available packets (non-blocking) */
         while (1) {
             addr_len = sizeof(remote_addr);
@@ -1098,64 +4870,117 @@ int lws_sess_loop(lws_sess_t* sess, int timeout_ms)
                 break;
             }
 
+            /* TURN服务器的响应、Data indication与ChannelData */
+            if (sess->turn) {
+                struct sockaddr_in peer;
+                int offset, len;
+                int ret = lws_turn_input(sess->turn, &remote_addr, buffer, (int)bytes,
+                                         get_current_time_us(), &peer, &offset, &len);
+                if (ret == 2) {
+                    ice_relay_input(sess, &peer, buffer + offset, len);
+                }
+                if (ret != 0) {
+                    continue;
+                }
+            }
+
+            /* STUN (首字节0-3, RFC 7983)：收集事务的响应、连通性检查与consent */
+            if (sess->ice && lws_ice_input(sess->ice, &remote_addr, buffer, (int)bytes,
+                                           get_current_time_us())) {
+                continue;
+            }
+
             /* Process received data */
-            if (sess->ice_agent) {
-                /* ICE mode: Feed data to ICE agent for processing */
-                ice_agent_input(sess->ice_agent, 0,
-                               (struct sockaddr*)&local_addr,
-                               (struct sockaddr*)&remote_addr,
-                               buffer, (int)bytes);
-            } else if (sess->active_transport_mode == LWS_TRANSPORT_MODE_RTP_DIRECT) {
-                /* RTP direct mode: Process RTP data directly */
-                if (sess->audio_decoder && bytes > 12) {
-                    /* Simple RTP packet validation (minimum RTP header is 12 bytes) */
-                    static int rtp_count = 0;
-                    if ((rtp_count++ % 50) == 0) {
-                        lws_log_info("[SESS] RTP direct mode: received packet %d bytes (log every 50)\n", (int)bytes);
-                    }
-                    rtp_payload_decode_input(sess->audio_decoder, buffer, (int)bytes);
+            if (ice_active(sess)) {
+                /* ICE mode: media only from the selected pair's remote address */
+                struct sockaddr_in selected;
+                if (lws_ice_selected(sess->ice, NULL, &selected) == 0 &&
+                    selected.sin_addr.s_addr == remote_addr.sin_addr.s_addr &&
+                    selected.sin_port == remote_addr.sin_port) {
+                    ice_media_input(sess, buffer, (int)bytes);
                 }
+            } else if (sess->active_transport_mode == LWS_TRANSPORT_MODE_RTP_DIRECT) {
+                direct_media_input(sess, &remote_addr, buffer, (int)bytes);
             }
         }
     }
 
+    /* Video RTP (BUNDLE时已在上面随媒体socket分流) */
+    if (sess->video_socket >= 0 || sess->bundle_active) {
+        video_receive(sess);
+    }
+
+    /* ICE：按Ta节拍发送收集事务与连通性检查、重传，consent检查和各截止时间 */
+    if (sess->ice) {
+        lws_ice_poll(sess->ice, get_current_time_us());
+    }
+
+    /* TURN：请求重传，分配、权限与通道在过期前刷新 */
+    if (sess->turn) {
+        lws_turn_poll(sess->turn, get_current_time_us());
+    }
+
+    /* DTLS-SRTP握手：client发起，超时重传（lws_timer回调在其他线程，由loop驱动） */
+    if (sess->audio_srtp.dtls) {
+        srtp_dtls_update(sess, &sess->audio_srtp,
+                         lws_dtls_poll(sess->audio_srtp.dtls, get_current_time_us()), "Audio");
+    }
+    if (sess->video_srtp.dtls) {
+        srtp_dtls_update(sess, &sess->video_srtp,
+                         lws_dtls_poll(sess->video_srtp.dtls, get_current_time_us()), "Video");
+    }
+
+    /* 结束包全部丢失的事件，超时后上报 */
+    if (sess->dtmf_rx_active &&
+        get_current_time_us() - sess->dtmf_rx_last_us > LWS_SESS_DTMF_RX_TIMEOUT_US) {
+        dtmf_rx_report(sess);
+    }
+
+    /* 对端静音期间播放舒适噪声 */
+    if (sess->cn_rx_active && media_dir_can_recv(sess->active_dir)) {
+        cn_playout(sess, get_current_time_us());
+    }
+
     /* Only send media when connected */
     if (sess->state != LWS_SESS_STATE_CONNECTED) {
         return 0;
     }
 
-    /* Send audio if enabled */
-    if (sess->config.enable_audio && sess->config.audio_capture_dev &&
-        sess->audio_encoder) {
+    /* Send queued DTMF events */
+    if (media_dir_can_send(sess->active_dir)) {
+        dtmf_send_process(sess, get_current_time_us());
+    }
 
-        /* Read audio from capture device */
+    /* Send audio if enabled: capture node → audio-proc → … → encoder */
+    if (sess->config.enable_audio && sess->capture_node && sess->audio_encoder) {
         int frame_samples = sess->config.audio_sample_rate * LWS_DEFAULT_FRAME_DURATION / 1000;
-        int16_t audio_buf[LWS_MAX_AUDIO_SAMPLES_20MS];
+        lws_frame_t* frame = audio_frame_get(&sess->capture_frame,
+                                             frame_samples * (int)sizeof(int16_t));
 
-        int samples = lws_dev_read_audio(sess->config.audio_capture_dev,
-                                         audio_buf, frame_samples);
+        /* Read audio from capture device directly into the frame */
+        int samples = frame ? lws_dev_read_audio(sess->config.audio_capture_dev,
+                                                 frame->data, frame_samples) : 0;
 
         if (samples > 0) {
-            /* Encode and send RTP */
-            rtp_payload_encode_input(sess->audio_encoder, audio_buf,
-                                    samples * 2, /* bytes */
-                                    sess->audio_timestamp);
-
-            /* Get encoded RTP packets and send through ICE */
-            uint8_t rtp_packet[LWS_SESS_RTP_MTU];
-            LWS_UNUSED(rtp_packet);
-            /* TODO: Get packets from encoder queue */
+            frame->kind = LWS_FRAME_AUDIO;
+            frame->size = samples * (int)sizeof(int16_t);
+            frame->samples = samples;
+            frame->sample_rate = sess->config.audio_sample_rate;
+            frame->channels = 1;
+            frame->timestamp = sess->audio_timestamp;
+            frame->time_us = get_current_time_us();
+            lws_graph_emit(sess->capture_node, frame);
 
             /* Update timestamp */
             sess->audio_timestamp += samples;
-
-            /* Update statistics */
-            sess->audio_stats.sent_packets++;
-            sess->audio_stats.sent_bytes += samples * 2;
-            sess->audio_stats.sent_timestamp = sess->audio_timestamp;
         }
     }
 
+    /* Send video at the configured frame rate */
+    if (sess->config.enable_video && sess->video_frame) {
+        video_send(sess, get_current_time_us());
+    }
+
     /* Check RTCP interval */
     if (sess->rtp && sess->config.enable_rtcp) {
         uint64_t now = get_current_time_us();
@@ -1166,10 +4991,24 @@ int lws_sess_loop(lws_sess_t* sess, int timeout_ms)
 
             /* Generate and send RTCP report */
             uint8_t rtcp_buf[512];
-            int rtcp_len = rtp_rtcp_report(sess->rtp, rtcp_buf, sizeof(rtcp_buf));
+            int rtcp_len = rtp_rtcp_report(sess->rtp, rtcp_buf,
+                                           sizeof(rtcp_buf) - LWS_SRTP_MAX_TRAILER);
 
             if (rtcp_len > 0) {
-                ice_agent_send(sess->ice_agent, 0, 2, rtcp_buf, rtcp_len);
+                rtcp_len = srtp_output(&sess->audio_srtp, rtcp_buf, rtcp_len,
+                                       sizeof(rtcp_buf), 1);
+            }
+            if (rtcp_len > 0) {
+                if (ice_active(sess)) {
+                    /* RTCP与RTP复用选定候选对 (RFC 5761) */
+                    lws_ice_send(sess->ice, rtcp_buf, rtcp_len);
+                } else if (sess->remote_rtp_valid && sess->media_socket >= 0) {
+                    /* RTP直连：a=rtcp地址、RTP端口+1，或锁定的RTCP源地址 */
+                    sendto(sess->media_socket, rtcp_buf, rtcp_len, 0,
+                           (struct sockaddr*)&sess->remote_rtcp_addr,
+                           sizeof(sess->remote_rtcp_addr));
+                }
+                sess->audio_stats.rtcp_sent++;
                 sess->last_rtcp_time = now;
             }
         }
@@ -1199,10 +5038,8 @@ void lws_sess_stop(lws_sess_t* sess)
         }
     }
 
-    /* Stop ICE */
-    if (sess->ice_agent) {
-        ice_agent_stop(sess->ice_agent);
-    }
+    /* 挂断：写完排队的录音 */
+    record_close(sess);
 }
 
 /* ========================================
@@ -1223,6 +5060,19 @@ const char* lws_sess_get_local_sdp(lws_sess_t* sess)
     return sess->local_sdp;
 }
 
+int lws_sess_get_codecs(lws_sess_t* sess, lws_sess_codec_t* codecs, int max)
+{
+    int count;
+
+    if (!sess || !codecs || max < 0) {
+        return -1;
+    }
+
+    count = LWS_MIN(sess->audio_codecs.count, max);
+    memcpy(codecs, sess->audio_codecs.entries, count * sizeof(*codecs));
+    return count;
+}
+
 int lws_sess_get_stats(lws_sess_t* sess, lws_sess_stats_t* stats)
 {
     if (!sess || !stats) {
@@ -1232,9 +5082,57 @@ int lws_sess_get_stats(lws_sess_t* sess, lws_sess_stats_t* stats)
     memset(stats, 0, sizeof(*stats));
     stats->state = sess->state;
     stats->audio_stats = sess->audio_stats;
+    stats->video_stats = sess->video_stats;
     stats->start_time = sess->session_start_time;
     stats->duration = get_current_time_us() - sess->session_start_time;
 
+    if (sess->proc_frames > 0) {
+        stats->audio_proc_avg_us = (uint32_t)(sess->proc_total_us / sess->proc_frames);
+    }
+    stats->audio_proc_max_us = sess->proc_max_us;
+    stats->audio_proc_overruns = sess->proc_overruns;
+    stats->echo_delay_ms = lws_apm_delay_ms(sess->apm);
+
+    stats->video_nacks_recv = sess->video_tx.nacks;
+    stats->video_nacks_sent = sess->video_rx.nacks;
+    stats->video_retransmits = sess->video_tx.retransmits;
+    stats->video_recovered = sess->video_rx.recovered;
+    stats->video_keyframe_requests = sess->video_tx.keyframe_requests;
+    if (sess->video_tx.paced > 0) {
+        stats->video_pacing_avg_us = (uint32_t)(sess->video_tx.delay_total_us / sess->video_tx.paced);
+    }
+    stats->video_pacing_max_us = sess->video_tx.delay_max_us;
+    stats->srtp_dropped = sess->srtp_dropped;
+    stats->rtp_latches = sess->rtp_latches;
+    stats->rtp_source_dropped = sess->rtp_source_dropped;
+
+    stats->audio_ptime = sess->audio_ptime;
+    if (sess->rec) {
+        lws_rec_get_stats(sess->rec, &sess->rec_stats);
+    }
+    stats->record_frames = sess->rec_stats_prev.frames + sess->rec_stats.frames;
+    stats->record_dropped = sess->rec_stats_prev.dropped + sess->rec_stats.dropped;
+    stats->record_max_write_us = LWS_MAX(sess->rec_stats_prev.max_write_us,
+                                         sess->rec_stats.max_write_us);
+    stats->audio_red_level = sess->red_tx.pt >= 0 ? sess->red_tx.level : 0;
+    stats->audio_red_recovered = sess->red_rx.recovered;
+    stats->audio_effective_loss = sess->audio_stats.loss_rate;
+    if (sess->rx_seq_valid && sess->audio_stats.lost_packets > 0) {
+        uint32_t expected = sess->rx_cycles + sess->rx_max_seq - sess->rx_base_seq + 1;
+        uint64_t lost = sess->audio_stats.lost_packets;
+        lost = lost > sess->rx_recovered ? lost - sess->rx_recovered : 0;
+        stats->audio_effective_loss = (double)lost / expected;
+    }
+
+    stats->ice_connect_ms = -1;
+    if (sess->ice) {
+        lws_ice_stats_t ice;
+        lws_ice_get_stats(sess->ice, &ice);
+        stats->ice_connect_ms = ice.connect_ms;
+        stats->ice_checks_sent = ice.checks_sent;
+    }
+    stats->video_stats.lost_packets = sess->video_rx.lost;
+
     return 0;
 }
 
@@ -1253,9 +5151,12 @@ lws_rtp_t* lws_sess_get_video_rtp(lws_sess_t* sess)
 
 lws_ice_t* lws_sess_get_ice(lws_sess_t* sess)
 {
-    /* lws_ice_t is our wrapper, but we're using libice directly */
-    (void)sess;
-    return NULL;
+    return sess ? sess->ice : NULL;
+}
+
+lws_graph_t* lws_sess_get_graph(lws_sess_t* sess)
+{
+    return sess ? sess->graph : NULL;
 }
 
 /* ========================================
@@ -1276,10 +5177,12 @@ void lws_sess_init_audio_config(lws_sess_config_t* config,
     config->stun_port = LWS_DEFAULT_STUN_PORT;
     config->enable_audio = 1;
     config->audio_codec = codec;
+    config->telephone_event = 1;
     config->audio_sample_rate = LWS_DEFAULT_SAMPLE_RATE;
     config->audio_channels = LWS_DEFAULT_CHANNELS;
     config->media_dir = LWS_MEDIA_DIR_SENDRECV;
     config->enable_rtcp = 1;
+    config->symmetric_rtp = 1;
     config->jitter_buffer_ms = LWS_DEFAULT_JITTER_BUFFER_MS;
 }
 
@@ -1300,8 +5203,11 @@ void lws_sess_init_video_config(lws_sess_config_t* config,
     config->video_width = LWS_DEFAULT_VIDEO_WIDTH;
     config->video_height = LWS_DEFAULT_VIDEO_HEIGHT;
     config->video_fps = LWS_DEFAULT_VIDEO_FPS;
+    config->video_nack = 1;
     config->media_dir = LWS_MEDIA_DIR_SENDRECV;
     config->enable_rtcp = 1;
+    config->symmetric_rtp = 1;
+    config->bundle = 1;
 }
 
 void lws_sess_init_av_config(lws_sess_config_t* config,
@@ -1319,6 +5225,7 @@ void lws_sess_init_av_config(lws_sess_config_t* config,
     config->stun_port = LWS_DEFAULT_STUN_PORT;
     config->enable_audio = 1;
     config->audio_codec = audio_codec;
+    config->telephone_event = 1;
     config->audio_sample_rate = LWS_DEFAULT_SAMPLE_RATE;
     config->audio_channels = LWS_DEFAULT_CHANNELS;
     config->enable_video = 1;
@@ -1326,8 +5233,11 @@ void lws_sess_init_av_config(lws_sess_config_t* config,
     config->video_width = LWS_DEFAULT_VIDEO_WIDTH;
     config->video_height = LWS_DEFAULT_VIDEO_HEIGHT;
     config->video_fps = LWS_DEFAULT_VIDEO_FPS;
+    config->video_nack = 1;
     config->media_dir = LWS_MEDIA_DIR_SENDRECV;
     config->enable_rtcp = 1;
+    config->symmetric_rtp = 1;
+    config->bundle = 1;
     config->jitter_buffer_ms = LWS_DEFAULT_JITTER_BUFFER_MS;
 }
 
@@ -0,0 +1,792 @@
+/**
+ * @file lws_srtp.c
+ * @brief SRTP/SRTCP implementation on the PSA Crypto API (mbedTLS)
+ *
+ * - 会话密钥按RFC 3711 §4.3.1派生（kdr=0），GCM的12字节salt右补零
+ * - AES-CM：在包缓冲区上原地做CTR加解密；HMAC-SHA1的输入为
+ *   包||ROC，ROC临时写在认证标签的位置，避免拷贝包
+ * - AES-GCM (RFC 7714)：RTP头为AAD，标签追加在密文后
+ * - 每个SSRC独立维护ROC与64包重放位图；接收端只有认证通过的包
+ *   才会创建或更新流状态，伪造包无法挤掉合法流
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <psa/crypto.h>
+
+#include "lws_srtp.h"
+#include "lws_mem.h"
+
+#define RTP_HEADER_SIZE     12
+#define RTCP_HEADER_SIZE    8
+#define SRTCP_INDEX_SIZE    4
+#define SRTCP_E_FLAG        0x80000000u
+#define SRTCP_INDEX_MASK    0x7fffffffu
+#define HMAC_SHA1_SIZE      20
+#define SALT_SIZE           14          /* Session salt buffer (AES-CM size) */
+#define AES_IV_SIZE         16
+#define GCM_IV_SIZE         12
+
+/* KDF labels (RFC 3711 §4.3.1); RTCP labels are the RTP ones + 3 */
+#define LABEL_RTP           0x00
+#define LABEL_RTCP          0x03
+#define LABEL_ENC           0
+#define LABEL_AUTH          1
+#define LABEL_SALT          2
+
+/* ========================================
+ * Types
+ * ======================================== */
+
+typedef struct {
+    const char* name;
+    int key_len;                /* Master and session key bytes */
+    int salt_len;               /* Master and session salt bytes */
+    int rtp_tag;                /* SRTP authentication tag bytes */
+    int rtcp_tag;               /* SRTCP authentication tag bytes */
+    int gcm;
+} suite_info_t;
+
+static const suite_info_t s_suites[LWS_SRTP_SUITE_COUNT] = {
+    { "AES_CM_128_HMAC_SHA1_80", 16, 14, 10, 10, 0 },
+    { "AES_CM_128_HMAC_SHA1_32", 16, 14, 4,  10, 0 },
+    { "AEAD_AES_128_GCM",        16, 12, 16, 16, 1 },
+    { "AEAD_AES_256_GCM",        32, 12, 16, 16, 1 },
+};
+
+typedef struct {
+    psa_key_id_t enc;           /* AES-CTR or AES-GCM session key */
+    psa_key_id_t auth;          /* HMAC-SHA1 session key (AES-CM suites) */
+    uint8_t salt[SALT_SIZE];
+} session_keys_t;
+
+typedef struct {
+    int used;
+    uint32_t ssrc;
+
+    /* RTP: highest index (ROC << 16 | SEQ) and replay bitmap (bit n = index - n) */
+    int started;
+    uint64_t index;
+    uint64_t window;
+
+    /* RTCP: sender = next SRTCP index, receiver = highest index + bitmap */
+    int rtcp_started;
+    uint64_t rtcp_index;
+    uint64_t rtcp_window;
+} stream_t;
+
+struct lws_srtp_t {
+    const suite_info_t* suite;
+    session_keys_t rtp;
+    session_keys_t rtcp;
+    stream_t streams[LWS_SRTP_MAX_STREAMS];
+    int next_stream;            /* Replaced when every slot is in use */
+};
+
+/* ========================================
+ * Helpers
+ * ======================================== */
+
+static uint32_t rd32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void wr32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static int tag_equal(const uint8_t* a, const uint8_t* b, int n)
+{
+    uint8_t diff = 0;
+    int i;
+    for (i = 0; i < n; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+static int import_key(psa_key_type_t type, psa_algorithm_t alg, psa_key_usage_t usage,
+                      const uint8_t* data, int len, psa_key_id_t* id)
+{
+    psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+    psa_status_t status;
+
+    psa_set_key_type(&attr, type);
+    psa_set_key_bits(&attr, (size_t)len * 8);
+    psa_set_key_usage_flags(&attr, usage);
+    psa_set_key_algorithm(&attr, alg);
+    status = psa_import_key(&attr, data, (size_t)len, id);
+    psa_reset_key_attributes(&attr);
+    return status == PSA_SUCCESS ? 0 : -1;
+}
+
+/* AES-CTR in place; the 16-byte IV is the initial counter block */
+static int aes_ctr(psa_key_id_t key, const uint8_t* iv, uint8_t* data, int len)
+{
+    psa_cipher_operation_t op = PSA_CIPHER_OPERATION_INIT;
+    size_t out = 0;
+    size_t fin = 0;
+
+    if (psa_cipher_encrypt_setup(&op, key, PSA_ALG_CTR) != PSA_SUCCESS ||
+        psa_cipher_set_iv(&op, iv, AES_IV_SIZE) != PSA_SUCCESS ||
+        psa_cipher_update(&op, data, (size_t)len, data, (size_t)len, &out) != PSA_SUCCESS ||
+        psa_cipher_finish(&op, data + out, (size_t)len - out, &fin) != PSA_SUCCESS) {
+        psa_cipher_abort(&op);
+        return -1;
+    }
+    return 0;
+}
+
+static int hmac_sha1(psa_key_id_t key, const uint8_t* data, int len, uint8_t* mac)
+{
+    size_t n = 0;
+    return psa_mac_compute(key, PSA_ALG_HMAC(PSA_ALG_SHA_1), data, (size_t)len,
+                           mac, HMAC_SHA1_SIZE, &n) == PSA_SUCCESS ? 0 : -1;
+}
+
+/* IV = (salt * 2^16) XOR (SSRC * 2^64) XOR (index * 2^16)  (RFC 3711 §4.1.1) */
+static void cm_iv(const uint8_t* salt, uint32_t ssrc, uint64_t index, uint8_t* iv)
+{
+    int i;
+    memcpy(iv, salt, SALT_SIZE);
+    iv[14] = 0;
+    iv[15] = 0;
+    for (i = 0; i < 4; i++) {
+        iv[4 + i] ^= (uint8_t)(ssrc >> (24 - 8 * i));
+    }
+    for (i = 0; i < 6; i++) {
+        iv[8 + i] ^= (uint8_t)(index >> (40 - 8 * i));
+    }
+}
+
+/* IV = (00 00 || SSRC || ROC || SEQ) XOR salt; SRTCP: index in the last 4 bytes (RFC 7714 §8.1, §9.1) */
+static void gcm_iv(const uint8_t* salt, uint32_t ssrc, uint64_t index, uint8_t* iv)
+{
+    int i;
+    memcpy(iv, salt, GCM_IV_SIZE);
+    for (i = 0; i < 4; i++) {
+        iv[2 + i] ^= (uint8_t)(ssrc >> (24 - 8 * i));
+    }
+    for (i = 0; i < 6; i++) {
+        iv[6 + i] ^= (uint8_t)(index >> (40 - 8 * i));
+    }
+}
+
+/* Key derivation (RFC 3711 §4.3.1, kdr = 0): AES-CM keystream at (salt XOR label) * 2^16 */
+static int kdf(psa_key_id_t master, const uint8_t* salt, uint8_t label, uint8_t* out, int len)
+{
+    uint8_t iv[AES_IV_SIZE];
+
+    memcpy(iv, salt, SALT_SIZE);
+    iv[7] ^= label;
+    iv[14] = 0;
+    iv[15] = 0;
+    memset(out, 0, len);
+    return aes_ctr(master, iv, out, len);
+}
+
+static int derive_keys(const suite_info_t* info, psa_key_id_t master, const uint8_t* salt,
+                       uint8_t label, session_keys_t* keys)
+{
+    uint8_t buf[32];
+    int ret = -1;
+
+    if (kdf(master, salt, label + LABEL_ENC, buf, info->key_len) != 0) {
+        goto out;
+    }
+    if (info->gcm) {
+        ret = import_key(PSA_KEY_TYPE_AES, PSA_ALG_GCM,
+                         PSA_KEY_USAGE_ENCRYPT | PSA_KEY_USAGE_DECRYPT,
+                         buf, info->key_len, &keys->enc);
+    } else {
+        ret = import_key(PSA_KEY_TYPE_AES, PSA_ALG_CTR, PSA_KEY_USAGE_ENCRYPT,
+                         buf, info->key_len, &keys->enc);
+    }
+    if (ret != 0) {
+        goto out;
+    }
+
+    if (!info->gcm) {
+        ret = -1;
+        if (kdf(master, salt, label + LABEL_AUTH, buf, HMAC_SHA1_SIZE) != 0 ||
+            import_key(PSA_KEY_TYPE_HMAC, PSA_ALG_HMAC(PSA_ALG_SHA_1),
+                       PSA_KEY_USAGE_SIGN_MESSAGE, buf, HMAC_SHA1_SIZE, &keys->auth) != 0) {
+            goto out;
+        }
+    }
+
+    memset(keys->salt, 0, sizeof(keys->salt));
+    ret = kdf(master, salt, label + LABEL_SALT, keys->salt, info->salt_len);
+
+out:
+    memset(buf, 0, sizeof(buf));
+    return ret;
+}
+
+/* ========================================
+ * Streams, index estimation and replay window
+ * ======================================== */
+
+static stream_t* find_stream(lws_srtp_t* srtp, uint32_t ssrc)
+{
+    int i;
+    for (i = 0; i < LWS_SRTP_MAX_STREAMS; i++) {
+        if (srtp->streams[i].used && srtp->streams[i].ssrc == ssrc) {
+            return &srtp->streams[i];
+        }
+    }
+    return NULL;
+}
+
+static stream_t* add_stream(lws_srtp_t* srtp, uint32_t ssrc)
+{
+    stream_t* st = NULL;
+    int i;
+
+    for (i = 0; i < LWS_SRTP_MAX_STREAMS; i++) {
+        if (!srtp->streams[i].used) {
+            st = &srtp->streams[i];
+            break;
+        }
+    }
+    if (!st) {
+        st = &srtp->streams[srtp->next_stream];
+        srtp->next_stream = (srtp->next_stream + 1) % LWS_SRTP_MAX_STREAMS;
+    }
+
+    memset(st, 0, sizeof(*st));
+    st->used = 1;
+    st->ssrc = ssrc;
+    return st;
+}
+
+/* Packet index from SEQ and the highest index seen (RFC 3711 §3.3.1) */
+static uint64_t rtp_index(const stream_t* st, uint16_t seq)
+{
+    uint32_t roc;
+    int s_l;
+
+    if (!st || !st->started) {
+        return seq;
+    }
+
+    roc = (uint32_t)(st->index >> 16);
+    s_l = (int)(st->index & 0xffff);
+    if (s_l < 32768) {
+        if (seq - s_l > 32768 && roc > 0) {
+            roc--;
+        }
+    } else if (s_l - 32768 > seq) {
+        roc++;
+    }
+    return ((uint64_t)roc << 16) | seq;
+}
+
+static int replay_check(int started, uint64_t max, uint64_t window, uint64_t index)
+{
+    if (!started || index > max) {
+        return 0;
+    }
+    if (max - index >= LWS_SRTP_REPLAY_WINDOW ||
+        (window & (1ULL << (max - index)))) {
+        return LWS_SRTP_ERR_REPLAY;
+    }
+    return 0;
+}
+
+static void replay_add(int* started, uint64_t* max, uint64_t* window, uint64_t index)
+{
+    if (!*started) {
+        *started = 1;
+        *max = index;
+        *window = 1;
+    } else if (index > *max) {
+        uint64_t shift = index - *max;
+        *window = shift >= LWS_SRTP_REPLAY_WINDOW ? 0 : *window << shift;
+        *window |= 1;
+        *max = index;
+    } else {
+        *window |= 1ULL << (*max - index);
+    }
+}
+
+/* Header bytes including CSRCs and extension, -1 if malformed */
+static int rtp_header_len(const uint8_t* p, int bytes)
+{
+    int len;
+
+    if (bytes < RTP_HEADER_SIZE || (p[0] & 0xc0) != 0x80) {
+        return -1;
+    }
+    len = RTP_HEADER_SIZE + (p[0] & 0x0f) * 4;
+    if (p[0] & 0x10) {
+        if (bytes < len + 4) {
+            return -1;
+        }
+        len += 4 + (((int)p[len + 2] << 8) | p[len + 3]) * 4;
+    }
+    return len <= bytes ? len : -1;
+}
+
+/* ========================================
+ * Suites
+ * ======================================== */
+
+const char* lws_srtp_suite_name(lws_srtp_suite_t suite)
+{
+    if ((unsigned)suite >= LWS_SRTP_SUITE_COUNT) {
+        return "";
+    }
+    return s_suites[suite].name;
+}
+
+int lws_srtp_suite_parse(const char* name, int len)
+{
+    int i;
+
+    if (!name) {
+        return -1;
+    }
+    if (len < 0) {
+        len = (int)strlen(name);
+    }
+    for (i = 0; i < LWS_SRTP_SUITE_COUNT; i++) {
+        if ((int)strlen(s_suites[i].name) == len && memcmp(s_suites[i].name, name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int lws_srtp_master_len(lws_srtp_suite_t suite)
+{
+    if ((unsigned)suite >= LWS_SRTP_SUITE_COUNT) {
+        return 0;
+    }
+    return s_suites[suite].key_len + s_suites[suite].salt_len;
+}
+
+/* ========================================
+ * Contexts
+ * ======================================== */
+
+lws_srtp_t* lws_srtp_create(lws_srtp_suite_t suite, const uint8_t* master)
+{
+    const suite_info_t* info;
+    uint8_t salt[SALT_SIZE];
+    psa_key_id_t master_key = PSA_KEY_ID_NULL;
+    lws_srtp_t* srtp;
+    int ret;
+
+    if ((unsigned)suite >= LWS_SRTP_SUITE_COUNT || !master ||
+        psa_crypto_init() != PSA_SUCCESS) {
+        return NULL;
+    }
+    info = &s_suites[suite];
+
+    srtp = (lws_srtp_t*)lws_malloc(sizeof(lws_srtp_t));
+    if (!srtp) {
+        return NULL;
+    }
+    memset(srtp, 0, sizeof(*srtp));
+    srtp->suite = info;
+
+    /* GCM的96位master salt右补零参与派生 (RFC 7714 §11) */
+    memset(salt, 0, sizeof(salt));
+    memcpy(salt, master + info->key_len, info->salt_len);
+
+    ret = import_key(PSA_KEY_TYPE_AES, PSA_ALG_CTR, PSA_KEY_USAGE_ENCRYPT,
+                     master, info->key_len, &master_key);
+    if (ret == 0) {
+        ret = derive_keys(info, master_key, salt, LABEL_RTP, &srtp->rtp);
+    }
+    if (ret == 0) {
+        ret = derive_keys(info, master_key, salt, LABEL_RTCP, &srtp->rtcp);
+    }
+    psa_destroy_key(master_key);
+    memset(salt, 0, sizeof(salt));
+
+    if (ret != 0) {
+        lws_srtp_destroy(srtp);
+        return NULL;
+    }
+    return srtp;
+}
+
+void lws_srtp_destroy(lws_srtp_t* srtp)
+{
+    if (!srtp) {
+        return;
+    }
+    psa_destroy_key(srtp->rtp.enc);
+    psa_destroy_key(srtp->rtp.auth);
+    psa_destroy_key(srtp->rtcp.enc);
+    psa_destroy_key(srtp->rtcp.auth);
+    memset(srtp, 0, sizeof(*srtp));
+    lws_free(srtp);
+}
+
+/* ========================================
+ * SRTP
+ * ======================================== */
+
+int lws_srtp_protect(lws_srtp_t* srtp, uint8_t* packet, int bytes, int size)
+{
+    const suite_info_t* info;
+    uint8_t iv[AES_IV_SIZE];
+    uint8_t mac[HMAC_SHA1_SIZE];
+    stream_t* st;
+    uint32_t ssrc;
+    uint64_t index;
+    int hdr;
+
+    if (!srtp || !packet) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+    info = srtp->suite;
+    hdr = rtp_header_len(packet, bytes);
+    if (hdr < 0 || bytes + info->rtp_tag > size) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+
+    ssrc = rd32(packet + 8);
+    st = find_stream(srtp, ssrc);
+    if (!st) {
+        st = add_stream(srtp, ssrc);
+    }
+
+    /* 发送端同样按最高序号推算ROC，重传旧序号时使用原来的index */
+    index = rtp_index(st, (uint16_t)(((uint16_t)packet[2] << 8) | packet[3]));
+    replay_add(&st->started, &st->index, &st->window, index);
+
+    if (info->gcm) {
+        size_t out = 0;
+        gcm_iv(srtp->rtp.salt, ssrc, index, iv);
+        if (psa_aead_encrypt(srtp->rtp.enc, PSA_ALG_GCM, iv, GCM_IV_SIZE,
+                             packet, (size_t)hdr, packet + hdr, (size_t)(bytes - hdr),
+                             packet + hdr, (size_t)(size - hdr), &out) != PSA_SUCCESS) {
+            return LWS_SRTP_ERR_FORMAT;
+        }
+        return hdr + (int)out;
+    }
+
+    cm_iv(srtp->rtp.salt, ssrc, index, iv);
+    if (aes_ctr(srtp->rtp.enc, iv, packet + hdr, bytes - hdr) != 0) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+
+    /* 认证输入为 包||ROC：ROC暂存在标签位置（标签至少4字节） */
+    wr32(packet + bytes, (uint32_t)(index >> 16));
+    if (hmac_sha1(srtp->rtp.auth, packet, bytes + 4, mac) != 0) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+    memcpy(packet + bytes, mac, info->rtp_tag);
+    return bytes + info->rtp_tag;
+}
+
+int lws_srtp_unprotect(lws_srtp_t* srtp, uint8_t* packet, int bytes)
+{
+    const suite_info_t* info;
+    uint8_t iv[AES_IV_SIZE];
+    uint8_t mac[HMAC_SHA1_SIZE];
+    uint8_t tag[HMAC_SHA1_SIZE];
+    stream_t* st;
+    uint32_t ssrc;
+    uint64_t index;
+    int len;
+    int hdr;
+
+    if (!srtp || !packet) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+    info = srtp->suite;
+    len = bytes - info->rtp_tag;
+    hdr = rtp_header_len(packet, len);
+    if (hdr < 0) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+
+    ssrc = rd32(packet + 8);
+    st = find_stream(srtp, ssrc);
+    index = rtp_index(st, (uint16_t)(((uint16_t)packet[2] << 8) | packet[3]));
+    if (st && replay_check(st->started, st->index, st->window, index) != 0) {
+        return LWS_SRTP_ERR_REPLAY;
+    }
+
+    if (info->gcm) {
+        size_t out = 0;
+        gcm_iv(srtp->rtp.salt, ssrc, index, iv);
+        if (psa_aead_decrypt(srtp->rtp.enc, PSA_ALG_GCM, iv, GCM_IV_SIZE,
+                             packet, (size_t)hdr, packet + hdr, (size_t)(bytes - hdr),
+                             packet + hdr, (size_t)(bytes - hdr), &out) != PSA_SUCCESS) {
+            return LWS_SRTP_ERR_AUTH;
+        }
+    } else {
+        memcpy(tag, packet + len, info->rtp_tag);
+        wr32(packet + len, (uint32_t)(index >> 16));
+        if (hmac_sha1(srtp->rtp.auth, packet, len + 4, mac) != 0 ||
+            !tag_equal(mac, tag, info->rtp_tag)) {
+            return LWS_SRTP_ERR_AUTH;
+        }
+        cm_iv(srtp->rtp.salt, ssrc, index, iv);
+        if (aes_ctr(srtp->rtp.enc, iv, packet + hdr, len - hdr) != 0) {
+            return LWS_SRTP_ERR_FORMAT;
+        }
+    }
+
+    if (!st) {
+        st = add_stream(srtp, ssrc);
+    }
+    replay_add(&st->started, &st->index, &st->window, index);
+    return len;
+}
+
+/* ========================================
+ * SRTCP
+ * ======================================== */
+
+int lws_srtp_protect_rtcp(lws_srtp_t* srtp, uint8_t* packet, int bytes, int size)
+{
+    const suite_info_t* info;
+    uint8_t iv[AES_IV_SIZE];
+    uint8_t mac[HMAC_SHA1_SIZE];
+    stream_t* st;
+    uint32_t ssrc;
+    uint32_t index;
+
+    if (!srtp || !packet) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+    info = srtp->suite;
+    if (bytes < RTCP_HEADER_SIZE || (packet[0] & 0xc0) != 0x80 ||
+        bytes + SRTCP_INDEX_SIZE + info->rtcp_tag > size) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+
+    ssrc = rd32(packet + 4);
+    st = find_stream(srtp, ssrc);
+    if (!st) {
+        st = add_stream(srtp, ssrc);
+    }
+    index = (uint32_t)(st->rtcp_index++ & SRTCP_INDEX_MASK);
+
+    if (info->gcm) {
+        /* AAD = 头8字节 || E|index (RFC 7714 §9.1)，输出 头||密文||标签||E|index */
+        uint8_t aad[RTCP_HEADER_SIZE + SRTCP_INDEX_SIZE];
+        size_t out = 0;
+
+        memcpy(aad, packet, RTCP_HEADER_SIZE);
+        wr32(aad + RTCP_HEADER_SIZE, SRTCP_E_FLAG | index);
+        gcm_iv(srtp->rtcp.salt, ssrc, index, iv);
+        if (psa_aead_encrypt(srtp->rtcp.enc, PSA_ALG_GCM, iv, GCM_IV_SIZE,
+                             aad, sizeof(aad), packet + RTCP_HEADER_SIZE,
+                             (size_t)(bytes - RTCP_HEADER_SIZE), packet + RTCP_HEADER_SIZE,
+                             (size_t)(size - RTCP_HEADER_SIZE), &out) != PSA_SUCCESS) {
+            return LWS_SRTP_ERR_FORMAT;
+        }
+        bytes = RTCP_HEADER_SIZE + (int)out;
+        wr32(packet + bytes, SRTCP_E_FLAG | index);
+        return bytes + SRTCP_INDEX_SIZE;
+    }
+
+    cm_iv(srtp->rtcp.salt, ssrc, index, iv);
+    if (aes_ctr(srtp->rtcp.enc, iv, packet + RTCP_HEADER_SIZE, bytes - RTCP_HEADER_SIZE) != 0) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+    wr32(packet + bytes, SRTCP_E_FLAG | index);
+    bytes += SRTCP_INDEX_SIZE;
+    if (hmac_sha1(srtp->rtcp.auth, packet, bytes, mac) != 0) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+    memcpy(packet + bytes, mac, info->rtcp_tag);
+    return bytes + info->rtcp_tag;
+}
+
+int lws_srtp_unprotect_rtcp(lws_srtp_t* srtp, uint8_t* packet, int bytes)
+{
+    const suite_info_t* info;
+    uint8_t iv[AES_IV_SIZE];
+    uint8_t mac[HMAC_SHA1_SIZE];
+    stream_t* st;
+    uint32_t ssrc;
+    uint32_t e_index;
+    uint32_t index;
+    int len;
+
+    if (!srtp || !packet) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+    info = srtp->suite;
+    if (bytes < RTCP_HEADER_SIZE + SRTCP_INDEX_SIZE + info->rtcp_tag ||
+        (packet[0] & 0xc0) != 0x80) {
+        return LWS_SRTP_ERR_FORMAT;
+    }
+
+    /* GCM: E|index在最后；AES-CM: E|index在标签之前 */
+    len = info->gcm ? bytes - SRTCP_INDEX_SIZE : bytes - info->rtcp_tag;
+    e_index = rd32(packet + (info->gcm ? len : len - SRTCP_INDEX_SIZE));
+    index = e_index & SRTCP_INDEX_MASK;
+
+    ssrc = rd32(packet + 4);
+    st = find_stream(srtp, ssrc);
+    if (st && replay_check(st->rtcp_started, st->rtcp_index, st->rtcp_window, index) != 0) {
+        return LWS_SRTP_ERR_REPLAY;
+    }
+
+    if (info->gcm) {
+        uint8_t aad[RTCP_HEADER_SIZE + SRTCP_INDEX_SIZE];
+        size_t out = 0;
+
+        /* 不加密的SRTCP (E=0) 不使用 */
+        if (!(e_index & SRTCP_E_FLAG)) {
+            return LWS_SRTP_ERR_FORMAT;
+        }
+        memcpy(aad, packet, RTCP_HEADER_SIZE);
+        wr32(aad + RTCP_HEADER_SIZE, e_index);
+        gcm_iv(srtp->rtcp.salt, ssrc, index, iv);
+        if (psa_aead_decrypt(srtp->rtcp.enc, PSA_ALG_GCM, iv, GCM_IV_SIZE,
+                             aad, sizeof(aad), packet + RTCP_HEADER_SIZE,
+                             (size_t)(len - RTCP_HEADER_SIZE), packet + RTCP_HEADER_SIZE,
+                             (size_t)(len - RTCP_HEADER_SIZE), &out) != PSA_SUCCESS) {
+            return LWS_SRTP_ERR_AUTH;
+        }
+        len = RTCP_HEADER_SIZE + (int)out;
+    } else {
+        if (hmac_sha1(srtp->rtcp.auth, packet, len, mac) != 0 ||
+            !tag_equal(mac, packet + len, info->rtcp_tag)) {
+            return LWS_SRTP_ERR_AUTH;
+        }
+        len -= SRTCP_INDEX_SIZE;
+        if (e_index & SRTCP_E_FLAG) {
+            cm_iv(srtp->rtcp.salt, ssrc, index, iv);
+            if (aes_ctr(srtp->rtcp.enc, iv, packet + RTCP_HEADER_SIZE,
+                        len - RTCP_HEADER_SIZE) != 0) {
+                return LWS_SRTP_ERR_FORMAT;
+            }
+        }
+    }
+
+    if (!st) {
+        st = add_stream(srtp, ssrc);
+    }
+    replay_add(&st->rtcp_started, &st->rtcp_index, &st->rtcp_window, index);
+    return len;
+}
+
+/* ========================================
+ * SDES (RFC 4568)
+ * ======================================== */
+
+static const char s_base64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int base64_encode(const uint8_t* data, int bytes, char* out, int size)
+{
+    int len = 0;
+    int i;
+
+    if ((bytes + 2) / 3 * 4 >= size) {
+        return -1;
+    }
+    for (i = 0; i < bytes; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < bytes) v |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < bytes) v |= data[i + 2];
+        out[len++] = s_base64[(v >> 18) & 0x3f];
+        out[len++] = s_base64[(v >> 12) & 0x3f];
+        out[len++] = i + 1 < bytes ? s_base64[(v >> 6) & 0x3f] : '=';
+        out[len++] = i + 2 < bytes ? s_base64[v & 0x3f] : '=';
+    }
+    out[len] = '\0';
+    return len;
+}
+
+static int base64_decode(const char* in, int len, uint8_t* out, int size)
+{
+    uint32_t v = 0;
+    int bits = 0;
+    int n = 0;
+    int i;
+
+    for (i = 0; i < len && in[i] != '='; i++) {
+        const char* c = strchr(s_base64, in[i]);
+        if (!c || in[i] == '\0') {
+            return -1;
+        }
+        v = (v << 6) | (uint32_t)(c - s_base64);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n >= size) {
+                return -1;
+            }
+            out[n++] = (uint8_t)(v >> bits);
+        }
+    }
+    return n;
+}
+
+int lws_srtp_random(uint8_t* buf, int bytes)
+{
+    if (psa_crypto_init() != PSA_SUCCESS ||
+        psa_generate_random(buf, (size_t)bytes) != PSA_SUCCESS) {
+        return -1;
+    }
+    return 0;
+}
+
+int lws_srtp_sdes_write(int tag, lws_srtp_suite_t suite, const uint8_t* master,
+                        char* buf, int size)
+{
+    char key[(LWS_SRTP_MAX_MASTER + 2) / 3 * 4 + 1];
+    int n;
+
+    if ((unsigned)suite >= LWS_SRTP_SUITE_COUNT ||
+        base64_encode(master, lws_srtp_master_len(suite), key, sizeof(key)) < 0) {
+        return -1;
+    }
+    n = snprintf(buf, size, "a=crypto:%d %s inline:%s\r\n", tag, s_suites[suite].name, key);
+    memset(key, 0, sizeof(key));
+    return n < 0 || n >= size ? -1 : n;
+}
+
+int lws_srtp_sdes_key(lws_srtp_suite_t suite, const char* key, int len, uint8_t* master)
+{
+    uint8_t buf[LWS_SRTP_MAX_MASTER + 3];
+    const char* end;
+    const char* p;
+    int n;
+
+    if ((unsigned)suite >= LWS_SRTP_SUITE_COUNT || !key || len < 7 ||
+        memcmp(key, "inline:", 7) != 0) {
+        return -1;
+    }
+    key += 7;
+    len -= 7;
+
+    /* 多个key-param以';'分隔，只用第一个 */
+    end = memchr(key, ';', len);
+    if (end) {
+        len = (int)(end - key);
+    }
+
+    /* inline:<key||salt>["|" lifetime]["|" MKI:length] */
+    p = memchr(key, '|', len);
+    n = base64_decode(key, p ? (int)(p - key) : len, buf, sizeof(buf));
+    if (p && memchr(p, ':', len - (p - key))) {
+        n = -1;                                 /* MKI */
+    }
+    if (n != lws_srtp_master_len(suite)) {
+        memset(buf, 0, sizeof(buf));
+        return -1;
+    }
+    memcpy(master, buf, n);
+    memset(buf, 0, sizeof(buf));
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file lws_srtp.h
+ * @brief SRTP/SRTCP (RFC 3711, RFC 7714) with SDES keying (RFC 4568)
+ *
+ * One context protects or unprotects one direction of one m= line: RTP and
+ * RTCP share the master key, each SSRC seen gets its own rollover counter
+ * and replay window. Packets are transformed in place; the caller's buffer
+ * must have LWS_SRTP_MAX_TRAILER spare bytes after the packet for protect.
+ *
+ * Cryptography goes through the PSA Crypto API of the bundled mbedTLS,
+ * which uses AES-NI / ARMv8 Crypto Extensions when they are available.
+ */
+
+#ifndef __LWS_SRTP_H__
+#define __LWS_SRTP_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Constants
+ * ======================================== */
+
+#define LWS_SRTP_MAX_MASTER     46      /**< Largest master key + salt (AES-256, 14-byte salt) */
+#define LWS_SRTP_MAX_TRAILER    20      /**< Most bytes protect appends (SRTCP GCM: tag + index) */
+#define LWS_SRTP_MAX_STREAMS    4       /**< SSRCs tracked per context */
+#define LWS_SRTP_REPLAY_WINDOW  64      /**< Replay window in packets */
+
+/* Error codes (negative return values) */
+#define LWS_SRTP_ERR_FORMAT     -1      /**< Malformed packet or buffer too small */
+#define LWS_SRTP_ERR_AUTH       -2      /**< Authentication failed */
+#define LWS_SRTP_ERR_REPLAY     -3      /**< Replayed or too old */
+
+/**
+ * @brief Crypto suites, in our offer preference order
+ */
+typedef enum {
+    LWS_SRTP_AES_CM_128_HMAC_SHA1_80,   /**< RFC 4568 */
+    LWS_SRTP_AES_CM_128_HMAC_SHA1_32,   /**< RFC 4568 (SRTCP keeps the 80-bit tag) */
+    LWS_SRTP_AEAD_AES_128_GCM,          /**< RFC 7714 */
+    LWS_SRTP_AEAD_AES_256_GCM,          /**< RFC 7714 */
+    LWS_SRTP_SUITE_COUNT
+} lws_srtp_suite_t;
+
+typedef struct lws_srtp_t lws_srtp_t;
+
+/* ========================================
+ * Suites
+ * ======================================== */
+
+/**
+ * @brief SDES name of a suite ("AES_CM_128_HMAC_SHA1_80", ...)
+ */
+const char* lws_srtp_suite_name(lws_srtp_suite_t suite);
+
+/**
+ * @brief Suite for an SDES name
+ * @param len Name length (-1 = NUL-terminated)
+ * @return Suite, -1 if not supported
+ */
+int lws_srtp_suite_parse(const char* name, int len);
+
+/**
+ * @brief Master key + master salt bytes of a suite
+ */
+int lws_srtp_master_len(lws_srtp_suite_t suite);
+
+/* ========================================
+ * Contexts
+ * ======================================== */
+
+/**
+ * @brief Create a context and derive the session keys (RFC 3711 §4.3)
+ * @param master Master key followed by master salt (lws_srtp_master_len bytes)
+ * @return Context, NULL on failure
+ */
+lws_srtp_t* lws_srtp_create(lws_srtp_suite_t suite, const uint8_t* master);
+
+/**
+ * @brief Destroy a context (keys are wiped)
+ */
+void lws_srtp_destroy(lws_srtp_t* srtp);
+
+/**
+ * @brief Protect an RTP packet in place
+ * @param size Buffer size (bytes + LWS_SRTP_MAX_TRAILER is always enough)
+ * @return SRTP packet bytes, LWS_SRTP_ERR_FORMAT on error
+ */
+int lws_srtp_protect(lws_srtp_t* srtp, uint8_t* packet, int bytes, int size);
+
+/**
+ * @brief Verify and decrypt an SRTP packet in place
+ * @return RTP packet bytes, negative LWS_SRTP_ERR_* on failure
+ */
+int lws_srtp_unprotect(lws_srtp_t* srtp, uint8_t* packet, int bytes);
+
+/**
+ * @brief Protect a compound RTCP packet in place
+ * @return SRTCP packet bytes, LWS_SRTP_ERR_FORMAT on error
+ */
+int lws_srtp_protect_rtcp(lws_srtp_t* srtp, uint8_t* packet, int bytes, int size);
+
+/**
+ * @brief Verify and decrypt an SRTCP packet in place
+ * @return RTCP packet bytes, negative LWS_SRTP_ERR_* on failure
+ */
+int lws_srtp_unprotect_rtcp(lws_srtp_t* srtp, uint8_t* packet, int bytes);
+
+/* ========================================
+ * SDES (RFC 4568)
+ * ======================================== */
+
+/**
+ * @brief Fill a buffer from the crypto random generator
+ * @return 0 on success, -1 on failure
+ */
+int lws_srtp_random(uint8_t* buf, int bytes);
+
+/**
+ * @brief Write "a=crypto:<tag> <suite> inline:<key||salt>\r\n"
+ * @return Bytes written, -1 if the buffer is too small
+ */
+int lws_srtp_sdes_write(int tag, lws_srtp_suite_t suite, const uint8_t* master,
+                        char* buf, int size);
+
+/**
+ * @brief Decode the key parameter of an a=crypto line
+ *
+ * Accepts "inline:<base64>[|lifetime]". Keys with an MKI ("|n:len") are
+ * rejected, since MKI is not supported.
+ *
+ * @param key Key parameter text
+ * @param len Text length
+ * @param master Output master key + salt (lws_srtp_master_len bytes)
+ * @return 0 on success, -1 if malformed, of the wrong length or with MKI
+ */
+int lws_srtp_sdes_key(lws_srtp_suite_t suite, const char* key, int len, uint8_t* master);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_SRTP_H__ */
@@ -0,0 +1,384 @@
+/**
+ * @file lws_stun.c
+ * @brief STUN message encoding and parsing (RFC 8489)
+ *
+ * 只实现ICE与TURN用到的部分：Binding、地址类属性、ERROR-CODE、
+ * MESSAGE-INTEGRITY (HMAC-SHA1) 与 FINGERPRINT (CRC-32)。
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <psa/crypto.h>
+
+#include "lws_stun.h"
+
+/* ========================================
+ * Helpers
+ * ======================================== */
+
+#define INTEGRITY_SIZE      20      /* HMAC-SHA1 */
+#define FINGERPRINT_XOR     0x5354554eu
+
+static void put16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint16_t get16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/**
+ * @brief CRC-32 (ISO 3309), nibble table
+ */
+static uint32_t crc32(const uint8_t* data, int len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+        0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    uint32_t crc = 0xffffffffu;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+    }
+    return crc ^ 0xffffffffu;
+}
+
+/**
+ * @brief HMAC-SHA1 of a message prefix whose header length is patched to total
+ *
+ * MESSAGE-INTEGRITY覆盖到自身为止，头部长度字段按包含该属性计算
+ * (RFC 8489 §14.5)，这里分段计算，不复制报文。
+ */
+static int hmac_prefix(const uint8_t* msg, int len, int total,
+                       const uint8_t* key, int keylen, uint8_t* mac)
+{
+    psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+    psa_mac_operation_t op = PSA_MAC_OPERATION_INIT;
+    psa_key_id_t id = PSA_KEY_ID_NULL;
+    uint8_t header[LWS_STUN_HEADER_SIZE];
+    size_t out = 0;
+    int ret = -1;
+
+    if (keylen <= 0 || psa_crypto_init() != PSA_SUCCESS) {
+        return -1;
+    }
+
+    psa_set_key_type(&attr, PSA_KEY_TYPE_HMAC);
+    psa_set_key_bits(&attr, (size_t)keylen * 8);
+    psa_set_key_usage_flags(&attr, PSA_KEY_USAGE_SIGN_MESSAGE);
+    psa_set_key_algorithm(&attr, PSA_ALG_HMAC(PSA_ALG_SHA_1));
+    if (psa_import_key(&attr, key, (size_t)keylen, &id) != PSA_SUCCESS) {
+        psa_reset_key_attributes(&attr);
+        return -1;
+    }
+    psa_reset_key_attributes(&attr);
+
+    memcpy(header, msg, sizeof(header));
+    put16(header + 2, (uint16_t)(total - LWS_STUN_HEADER_SIZE));
+
+    if (psa_mac_sign_setup(&op, id, PSA_ALG_HMAC(PSA_ALG_SHA_1)) == PSA_SUCCESS &&
+        psa_mac_update(&op, header, sizeof(header)) == PSA_SUCCESS &&
+        psa_mac_update(&op, msg + LWS_STUN_HEADER_SIZE,
+                       (size_t)(len - LWS_STUN_HEADER_SIZE)) == PSA_SUCCESS &&
+        psa_mac_sign_finish(&op, mac, INTEGRITY_SIZE, &out) == PSA_SUCCESS &&
+        out == INTEGRITY_SIZE) {
+        ret = 0;
+    }
+    psa_mac_abort(&op);
+    psa_destroy_key(id);
+    return ret;
+}
+
+/**
+ * @brief Offset of the first attribute of a type, -1 if absent
+ */
+static int find_offset(const uint8_t* msg, int bytes, uint16_t type)
+{
+    int off = LWS_STUN_HEADER_SIZE;
+
+    while (off + 4 <= bytes) {
+        int vlen = get16(msg + off + 2);
+        if (off + 4 + vlen > bytes) {
+            return -1;
+        }
+        if (get16(msg + off) == type) {
+            return off;
+        }
+        off += 4 + ((vlen + 3) & ~3);
+    }
+    return -1;
+}
+
+/* ========================================
+ * Building
+ * ======================================== */
+
+int lws_stun_tid(uint8_t tid[LWS_STUN_TID_SIZE])
+{
+    if (psa_crypto_init() != PSA_SUCCESS ||
+        psa_generate_random(tid, LWS_STUN_TID_SIZE) != PSA_SUCCESS) {
+        return -1;
+    }
+    return 0;
+}
+
+int lws_stun_init(uint8_t* buf, int size, uint16_t type, const uint8_t tid[LWS_STUN_TID_SIZE])
+{
+    if (!buf || size < LWS_STUN_HEADER_SIZE) {
+        return -1;
+    }
+    put16(buf, type);
+    put16(buf + 2, 0);
+    put32(buf + 4, LWS_STUN_MAGIC);
+    memcpy(buf + 8, tid, LWS_STUN_TID_SIZE);
+    return LWS_STUN_HEADER_SIZE;
+}
+
+int lws_stun_add(uint8_t* buf, int size, int len, uint16_t type, const void* value, int vlen)
+{
+    int padded = (vlen + 3) & ~3;
+
+    if (len < LWS_STUN_HEADER_SIZE || vlen < 0 || vlen > 0xffff || len + 4 + padded > size) {
+        return -1;
+    }
+    put16(buf + len, type);
+    put16(buf + len + 2, (uint16_t)vlen);
+    if (vlen > 0) {
+        memcpy(buf + len + 4, value, vlen);
+    }
+    memset(buf + len + 4 + vlen, 0, padded - vlen);
+    len += 4 + padded;
+    put16(buf + 2, (uint16_t)(len - LWS_STUN_HEADER_SIZE));
+    return len;
+}
+
+int lws_stun_add_u32(uint8_t* buf, int size, int len, uint16_t type, uint32_t value)
+{
+    uint8_t v[4];
+    put32(v, value);
+    return lws_stun_add(buf, size, len, type, v, sizeof(v));
+}
+
+int lws_stun_add_u64(uint8_t* buf, int size, int len, uint16_t type, uint64_t value)
+{
+    uint8_t v[8];
+    put32(v, (uint32_t)(value >> 32));
+    put32(v + 4, (uint32_t)value);
+    return lws_stun_add(buf, size, len, type, v, sizeof(v));
+}
+
+int lws_stun_add_xor_addr(uint8_t* buf, int size, int len, uint16_t type,
+                          const struct sockaddr_in* addr)
+{
+    uint8_t v[8];
+
+    v[0] = 0;
+    v[1] = 0x01;                    /* IPv4 */
+    put16(v + 2, (uint16_t)(ntohs(addr->sin_port) ^ (LWS_STUN_MAGIC >> 16)));
+    put32(v + 4, ntohl(addr->sin_addr.s_addr) ^ LWS_STUN_MAGIC);
+    return lws_stun_add(buf, size, len, type, v, sizeof(v));
+}
+
+int lws_stun_add_error(uint8_t* buf, int size, int len, int code, const char* reason)
+{
+    uint8_t v[4 + 128];
+    int n = reason ? (int)strlen(reason) : 0;
+
+    if (n > (int)sizeof(v) - 4) {
+        n = (int)sizeof(v) - 4;
+    }
+    v[0] = 0;
+    v[1] = 0;
+    v[2] = (uint8_t)(code / 100);
+    v[3] = (uint8_t)(code % 100);
+    memcpy(v + 4, reason, n);
+    return lws_stun_add(buf, size, len, LWS_STUN_ATTR_ERROR_CODE, v, 4 + n);
+}
+
+int lws_stun_add_integrity(uint8_t* buf, int size, int len, const uint8_t* key, int keylen)
+{
+    uint8_t mac[INTEGRITY_SIZE];
+
+    if (len < LWS_STUN_HEADER_SIZE || len + 4 + INTEGRITY_SIZE > size ||
+        hmac_prefix(buf, len, len + 4 + INTEGRITY_SIZE, key, keylen, mac) != 0) {
+        return -1;
+    }
+    return lws_stun_add(buf, size, len, LWS_STUN_ATTR_MESSAGE_INTEGRITY, mac, sizeof(mac));
+}
+
+int lws_stun_long_term_key(const char* username, const char* realm, const char* password,
+                           uint8_t key[16])
+{
+    char input[512];
+    size_t out = 0;
+    int n;
+
+    n = snprintf(input, sizeof(input), "%s:%s:%s", username, realm, password);
+    if (n < 0 || n >= (int)sizeof(input) || psa_crypto_init() != PSA_SUCCESS ||
+        psa_hash_compute(PSA_ALG_MD5, (const uint8_t*)input, (size_t)n, key, 16, &out) != PSA_SUCCESS ||
+        out != 16) {
+        return -1;
+    }
+    return 0;
+}
+
+int lws_stun_add_fingerprint(uint8_t* buf, int size, int len)
+{
+    if (len < LWS_STUN_HEADER_SIZE || len + 8 > size) {
+        return -1;
+    }
+    put16(buf + 2, (uint16_t)(len + 8 - LWS_STUN_HEADER_SIZE));
+    return lws_stun_add_u32(buf, size, len, LWS_STUN_ATTR_FINGERPRINT,
+                            crc32(buf, len) ^ FINGERPRINT_XOR);
+}
+
+/* ========================================
+ * Parsing
+ * ======================================== */
+
+int lws_stun_is_message(const uint8_t* data, int bytes)
+{
+    int length;
+
+    if (!data || bytes < LWS_STUN_HEADER_SIZE || (data[0] & 0xc0) != 0 ||
+        get32(data + 4) != LWS_STUN_MAGIC) {
+        return 0;
+    }
+    length = get16(data + 2);
+    return (length & 3) == 0 && length + LWS_STUN_HEADER_SIZE == bytes;
+}
+
+const uint8_t* lws_stun_find(const uint8_t* msg, int bytes, uint16_t type, int* vlen)
+{
+    int off = find_offset(msg, bytes, type);
+
+    if (off < 0) {
+        return NULL;
+    }
+    if (vlen) {
+        *vlen = get16(msg + off + 2);
+    }
+    return msg + off + 4;
+}
+
+int lws_stun_get_u32(const uint8_t* msg, int bytes, uint16_t type, uint32_t* value)
+{
+    int vlen = 0;
+    const uint8_t* v = lws_stun_find(msg, bytes, type, &vlen);
+
+    if (!v || vlen != 4) {
+        return -1;
+    }
+    *value = get32(v);
+    return 0;
+}
+
+int lws_stun_get_u64(const uint8_t* msg, int bytes, uint16_t type, uint64_t* value)
+{
+    int vlen = 0;
+    const uint8_t* v = lws_stun_find(msg, bytes, type, &vlen);
+
+    if (!v || vlen != 8) {
+        return -1;
+    }
+    *value = (uint64_t)get32(v) << 32 | get32(v + 4);
+    return 0;
+}
+
+int lws_stun_xor_addr(const uint8_t* msg, int bytes, uint16_t type, struct sockaddr_in* addr)
+{
+    int vlen = 0;
+    const uint8_t* v = lws_stun_find(msg, bytes, type, &vlen);
+
+    if (!v || vlen != 8 || v[1] != 0x01) {
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)(get16(v + 2) ^ (LWS_STUN_MAGIC >> 16)));
+    addr->sin_addr.s_addr = htonl(get32(v + 4) ^ LWS_STUN_MAGIC);
+    return 0;
+}
+
+int lws_stun_mapped_addr(const uint8_t* msg, int bytes, struct sockaddr_in* addr)
+{
+    int vlen = 0;
+    const uint8_t* v;
+
+    if (lws_stun_xor_addr(msg, bytes, LWS_STUN_ATTR_XOR_MAPPED_ADDRESS, addr) == 0) {
+        return 0;
+    }
+
+    /* RFC 3489服务器只返回MAPPED-ADDRESS */
+    v = lws_stun_find(msg, bytes, LWS_STUN_ATTR_MAPPED_ADDRESS, &vlen);
+    if (!v || vlen != 8 || v[1] != 0x01) {
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(get16(v + 2));
+    addr->sin_addr.s_addr = htonl(get32(v + 4));
+    return 0;
+}
+
+int lws_stun_error_code(const uint8_t* msg, int bytes)
+{
+    int vlen = 0;
+    const uint8_t* v = lws_stun_find(msg, bytes, LWS_STUN_ATTR_ERROR_CODE, &vlen);
+
+    if (!v || vlen < 4) {
+        return -1;
+    }
+    return (v[2] & 0x07) * 100 + v[3];
+}
+
+int lws_stun_check_integrity(const uint8_t* msg, int bytes, const uint8_t* key, int keylen)
+{
+    uint8_t mac[INTEGRITY_SIZE];
+    uint8_t diff = 0;
+    int off = find_offset(msg, bytes, LWS_STUN_ATTR_MESSAGE_INTEGRITY);
+    int i;
+
+    if (off < 0 || get16(msg + off + 2) != INTEGRITY_SIZE ||
+        hmac_prefix(msg, off, off + 4 + INTEGRITY_SIZE, key, keylen, mac) != 0) {
+        return -1;
+    }
+    for (i = 0; i < INTEGRITY_SIZE; i++) {
+        diff |= mac[i] ^ msg[off + 4 + i];
+    }
+    return diff == 0 ? 0 : -1;
+}
+
+int lws_stun_check_fingerprint(const uint8_t* msg, int bytes)
+{
+    /* FINGERPRINT必须是最后一个属性 */
+    if (bytes < LWS_STUN_HEADER_SIZE + 8 ||
+        get16(msg + bytes - 8) != LWS_STUN_ATTR_FINGERPRINT || get16(msg + bytes - 6) != 4) {
+        return -1;
+    }
+    return get32(msg + bytes - 4) == (crc32(msg, bytes - 8) ^ FINGERPRINT_XOR) ? 0 : -1;
+}
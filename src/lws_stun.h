@@ -0,0 +1,205 @@
+/**
+ * @file lws_stun.h
+ * @brief STUN message encoding and parsing (RFC 8489)
+ *
+ * Messages are built in place in the caller's buffer: lws_stun_init()
+ * writes the header and every lws_stun_add_*() appends one attribute and
+ * returns the new message length. MESSAGE-INTEGRITY and FINGERPRINT must be
+ * added last, in that order. Parsing works on the received datagram
+ * without copying.
+ *
+ * Only IPv4 transport addresses are handled, like the rest of the media path.
+ */
+
+#ifndef __LWS_STUN_H__
+#define __LWS_STUN_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Constants
+ * ======================================== */
+
+#define LWS_STUN_HEADER_SIZE        20
+#define LWS_STUN_MAGIC              0x2112A442u
+#define LWS_STUN_TID_SIZE           12
+#define LWS_STUN_MAX_MESSAGE        548     /**< Largest message we build (RFC 8489 §6.1) */
+
+/* Methods and classes */
+#define LWS_STUN_BINDING_REQUEST    0x0001
+#define LWS_STUN_BINDING_INDICATION 0x0011
+#define LWS_STUN_BINDING_SUCCESS    0x0101
+#define LWS_STUN_BINDING_ERROR      0x0111
+
+/* TURN methods (RFC 8656 §18) */
+#define LWS_STUN_ALLOCATE           0x0003
+#define LWS_STUN_REFRESH            0x0004
+#define LWS_STUN_SEND               0x0006
+#define LWS_STUN_DATA               0x0007
+#define LWS_STUN_CREATE_PERMISSION  0x0008
+#define LWS_STUN_CHANNEL_BIND       0x0009
+#define LWS_STUN_SEND_INDICATION    0x0016
+#define LWS_STUN_DATA_INDICATION    0x0017
+
+/* Attributes */
+#define LWS_STUN_ATTR_MAPPED_ADDRESS     0x0001
+#define LWS_STUN_ATTR_USERNAME           0x0006
+#define LWS_STUN_ATTR_MESSAGE_INTEGRITY  0x0008
+#define LWS_STUN_ATTR_ERROR_CODE         0x0009
+#define LWS_STUN_ATTR_CHANNEL_NUMBER     0x000C
+#define LWS_STUN_ATTR_LIFETIME           0x000D
+#define LWS_STUN_ATTR_XOR_PEER_ADDRESS   0x0012
+#define LWS_STUN_ATTR_DATA               0x0013
+#define LWS_STUN_ATTR_REALM              0x0014
+#define LWS_STUN_ATTR_NONCE              0x0015
+#define LWS_STUN_ATTR_XOR_RELAYED_ADDRESS 0x0016
+#define LWS_STUN_ATTR_REQUESTED_TRANSPORT 0x0019
+#define LWS_STUN_ATTR_XOR_MAPPED_ADDRESS 0x0020
+#define LWS_STUN_ATTR_PRIORITY           0x0024
+#define LWS_STUN_ATTR_USE_CANDIDATE      0x0025
+#define LWS_STUN_ATTR_SOFTWARE           0x8022
+#define LWS_STUN_ATTR_FINGERPRINT        0x8028
+#define LWS_STUN_ATTR_ICE_CONTROLLED     0x8029
+#define LWS_STUN_ATTR_ICE_CONTROLLING    0x802A
+
+/** First byte of a STUN message (RFC 7983 §7: 0-3) */
+#define LWS_STUN_IS_MESSAGE(b)      ((b) <= 3)
+
+/** Message class bits of the type */
+#define LWS_STUN_IS_REQUEST(t)      (((t) & 0x0110) == 0x0000)
+#define LWS_STUN_IS_INDICATION(t)   (((t) & 0x0110) == 0x0010)
+#define LWS_STUN_IS_SUCCESS(t)      (((t) & 0x0110) == 0x0100)
+#define LWS_STUN_IS_ERROR(t)        (((t) & 0x0110) == 0x0110)
+
+/** Method of a message type (class bits cleared) */
+#define LWS_STUN_METHOD(t)          ((t) & 0x3EEF)
+
+/* ========================================
+ * Building
+ * ======================================== */
+
+/**
+ * @brief Fill a random transaction ID
+ * @return 0 on success, -1 on failure
+ */
+int lws_stun_tid(uint8_t tid[LWS_STUN_TID_SIZE]);
+
+/**
+ * @brief Write the message header
+ * @return Message length (LWS_STUN_HEADER_SIZE), -1 if the buffer is too small
+ */
+int lws_stun_init(uint8_t* buf, int size, uint16_t type, const uint8_t tid[LWS_STUN_TID_SIZE]);
+
+/**
+ * @brief Append an attribute (padded to 4 bytes)
+ * @param len Current message length
+ * @return New message length, -1 if the buffer is too small
+ */
+int lws_stun_add(uint8_t* buf, int size, int len, uint16_t type, const void* value, int vlen);
+
+int lws_stun_add_u32(uint8_t* buf, int size, int len, uint16_t type, uint32_t value);
+int lws_stun_add_u64(uint8_t* buf, int size, int len, uint16_t type, uint64_t value);
+
+/**
+ * @brief Append an XOR-*-ADDRESS attribute
+ */
+int lws_stun_add_xor_addr(uint8_t* buf, int size, int len, uint16_t type,
+                          const struct sockaddr_in* addr);
+
+/**
+ * @brief Append ERROR-CODE (RFC 8489 §14.8)
+ */
+int lws_stun_add_error(uint8_t* buf, int size, int len, int code, const char* reason);
+
+/**
+ * @brief Append MESSAGE-INTEGRITY (HMAC-SHA1 over the message so far)
+ * @param key Short-term: the password; long-term: MD5(username:realm:password)
+ */
+int lws_stun_add_integrity(uint8_t* buf, int size, int len, const uint8_t* key, int keylen);
+
+/**
+ * @brief Long-term credential key: MD5(username ":" realm ":" password)
+ * (RFC 8489 §9.2.2)
+ * @return 0 on success, -1 on failure
+ */
+int lws_stun_long_term_key(const char* username, const char* realm, const char* password,
+                           uint8_t key[16]);
+
+/**
+ * @brief Append FINGERPRINT (CRC-32 XOR 0x5354554e)
+ */
+int lws_stun_add_fingerprint(uint8_t* buf, int size, int len);
+
+/* ========================================
+ * Parsing
+ * ======================================== */
+
+/**
+ * @brief Check that a datagram is a well-formed STUN message
+ * @return 1 if it is, 0 otherwise
+ */
+int lws_stun_is_message(const uint8_t* data, int bytes);
+
+static inline uint16_t lws_stun_type(const uint8_t* msg)
+{
+    return (uint16_t)(msg[0] << 8 | msg[1]);
+}
+
+static inline const uint8_t* lws_stun_msg_tid(const uint8_t* msg)
+{
+    return msg + 8;
+}
+
+/**
+ * @brief Find the first attribute of a type
+ * @param vlen Output value length
+ * @return Value, NULL if absent
+ */
+const uint8_t* lws_stun_find(const uint8_t* msg, int bytes, uint16_t type, int* vlen);
+
+/**
+ * @brief Read a 32/64-bit attribute (PRIORITY, ICE-CONTROLLING, ...)
+ * @return 0 on success, -1 if absent or of the wrong size
+ */
+int lws_stun_get_u32(const uint8_t* msg, int bytes, uint16_t type, uint32_t* value);
+int lws_stun_get_u64(const uint8_t* msg, int bytes, uint16_t type, uint64_t* value);
+
+/**
+ * @brief Decode XOR-MAPPED-ADDRESS, falling back to MAPPED-ADDRESS
+ * @return 0 on success, -1 if absent or not IPv4
+ */
+int lws_stun_mapped_addr(const uint8_t* msg, int bytes, struct sockaddr_in* addr);
+
+/**
+ * @brief Decode an XOR-*-ADDRESS attribute of a given type
+ */
+int lws_stun_xor_addr(const uint8_t* msg, int bytes, uint16_t type, struct sockaddr_in* addr);
+
+/**
+ * @brief ERROR-CODE of an error response
+ * @return Code (e.g. 401, 487), -1 if absent
+ */
+int lws_stun_error_code(const uint8_t* msg, int bytes);
+
+/**
+ * @brief Verify MESSAGE-INTEGRITY
+ * @return 0 if valid, -1 if absent or wrong
+ */
+int lws_stun_check_integrity(const uint8_t* msg, int bytes, const uint8_t* key, int keylen);
+
+/**
+ * @brief Verify FINGERPRINT
+ * @return 0 if valid, -1 if absent or wrong
+ */
+int lws_stun_check_fingerprint(const uint8_t* msg, int bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_STUN_H__ */
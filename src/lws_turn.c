@@ -0,0 +1,617 @@
+/**
+ * @file lws_turn.c
+ * @brief TURN client (RFC 8656): relayed transport address for ICE
+ *
+ * 请求统一放在一张小事务表中，保存已编码的报文用于重传；收到401/438后
+ * 用新的realm/nonce重新编码（新事务ID）再发。分配、许可和通道的刷新
+ * 都是截止时间，由lws_turn_poll()检查，与ICE和DTLS一样由lws_sess_loop
+ * 驱动（lws_timer回调在其他线程，不能直接访问会话）。
+ *
+ * 每个对端一个许可和一个通道。ChannelData经UDP发送时不填充到4字节
+ * (RFC 8656 §12.5)，每包开销4字节；Send indication为36字节。
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "lws_turn.h"
+#include "lws_stun.h"
+#include "lws_err.h"
+#include "lws_mem.h"
+#include "lws_log.h"
+
+/* ========================================
+ * Types
+ * ======================================== */
+
+#define TURN_MAX_TXNS               (2 + 2 * LWS_TURN_MAX_PEERS)
+#define TURN_RTO_MS                 500
+#define TURN_RTO_MAX_MS             1600
+#define TURN_MAX_TX                 7       /* Rc (RFC 8489 §6.2.1) */
+#define TURN_AUTH_RETRIES           2       /* 401 challenge + one 438 Stale Nonce */
+#define TURN_RETRY_MS               5000    /* Failed permission/channel: retry after */
+#define TURN_TRANSPORT_UDP          17
+
+/**
+ * @brief One request transaction (kept encoded for retransmission)
+ */
+typedef struct {
+    int used;
+    uint16_t method;
+    int peer;                       /* Peer index (CreatePermission/ChannelBind), -1 otherwise */
+    uint32_t lifetime;              /* Allocate/Refresh: requested LIFETIME */
+    uint8_t tid[LWS_STUN_TID_SIZE];
+    uint8_t msg[LWS_STUN_MAX_MESSAGE];
+    int len;
+    int rto_ms;
+    int tx;
+    uint64_t retransmit_us;
+    int auth_tries;                 /* Re-sent after 401/438 */
+} turn_txn_t;
+
+typedef struct {
+    struct sockaddr_in addr;
+    uint16_t channel;
+    int permitted;                  /* Permission installed */
+    int bound;                      /* Channel bound */
+    int perm_pending;               /* CreatePermission in flight */
+    int chan_pending;               /* ChannelBind in flight */
+    uint64_t perm_refresh_us;       /* Next CreatePermission (0 = now) */
+    uint64_t chan_refresh_us;       /* Next ChannelBind (0 = now) */
+} turn_peer_t;
+
+struct lws_turn_t {
+    lws_turn_config_t config;
+    lws_turn_handler_t handler;
+    lws_turn_state_t state;
+
+    /* Long-term credential (RFC 8489 §9.2) */
+    char realm[LWS_TURN_CRED_SIZE];
+    char nonce[LWS_TURN_CRED_SIZE];
+    uint8_t key[16];
+    int have_key;
+
+    struct sockaddr_in relayed;
+    struct sockaddr_in mapped;
+    uint64_t refresh_us;            /* Next allocation Refresh */
+    int refreshing;                 /* Refresh in flight */
+
+    turn_peer_t peers[LWS_TURN_MAX_PEERS];
+    int peer_count;
+
+    turn_txn_t txns[TURN_MAX_TXNS];
+    uint64_t now_us;                /* Last time seen by allocate/input/poll */
+
+    lws_turn_stats_t stats;
+};
+
+static void put16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint16_t get16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static int same_addr(const struct sockaddr_in* a, const struct sockaddr_in* b)
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+/**
+ * @brief Refresh deadline for a lifetime: the margin before expiry, or half of it
+ */
+static uint64_t refresh_at(uint64_t now_us, uint32_t lifetime_s)
+{
+    uint32_t s = lifetime_s > 2 * LWS_TURN_REFRESH_MARGIN_S ?
+                 lifetime_s - LWS_TURN_REFRESH_MARGIN_S : lifetime_s / 2;
+    return now_us + (uint64_t)s * 1000000;
+}
+
+/* ========================================
+ * Transactions
+ * ======================================== */
+
+/**
+ * @brief Encode a request with a fresh transaction ID and the current nonce
+ */
+static int txn_build(lws_turn_t* turn, turn_txn_t* txn)
+{
+    uint8_t* msg = txn->msg;
+    int size = sizeof(txn->msg);
+    int n;
+
+    if (lws_stun_tid(txn->tid) != 0) {
+        return -1;
+    }
+    n = lws_stun_init(msg, size, txn->method, txn->tid);
+
+    switch (txn->method) {
+    case LWS_STUN_ALLOCATE:
+        n = lws_stun_add_u32(msg, size, n, LWS_STUN_ATTR_REQUESTED_TRANSPORT,
+                             (uint32_t)TURN_TRANSPORT_UDP << 24);
+        n = lws_stun_add_u32(msg, size, n, LWS_STUN_ATTR_LIFETIME, txn->lifetime);
+        break;
+    case LWS_STUN_REFRESH:
+        n = lws_stun_add_u32(msg, size, n, LWS_STUN_ATTR_LIFETIME, txn->lifetime);
+        break;
+    case LWS_STUN_CHANNEL_BIND:
+        n = lws_stun_add_u32(msg, size, n, LWS_STUN_ATTR_CHANNEL_NUMBER,
+                             (uint32_t)turn->peers[txn->peer].channel << 16);
+        /* fall through */
+    case LWS_STUN_CREATE_PERMISSION:
+        n = lws_stun_add_xor_addr(msg, size, n, LWS_STUN_ATTR_XOR_PEER_ADDRESS,
+                                  &turn->peers[txn->peer].addr);
+        break;
+    }
+
+    /* 首个Allocate不带凭据，等待401给出realm/nonce */
+    if (turn->have_key) {
+        n = lws_stun_add(msg, size, n, LWS_STUN_ATTR_USERNAME,
+                         turn->config.username, (int)strlen(turn->config.username));
+        n = lws_stun_add(msg, size, n, LWS_STUN_ATTR_REALM, turn->realm, (int)strlen(turn->realm));
+        n = lws_stun_add(msg, size, n, LWS_STUN_ATTR_NONCE, turn->nonce, (int)strlen(turn->nonce));
+        n = lws_stun_add_integrity(msg, size, n, turn->key, sizeof(turn->key));
+    }
+    n = lws_stun_add_fingerprint(msg, size, n);
+    if (n < 0) {
+        return -1;
+    }
+    txn->len = n;
+    return 0;
+}
+
+static void txn_send(lws_turn_t* turn, turn_txn_t* txn, uint64_t now_us)
+{
+    txn->retransmit_us = now_us + (uint64_t)txn->rto_ms * 1000;
+    turn->stats.requests++;
+    turn->handler.send(turn->handler.param, &turn->config.server, txn->msg, txn->len);
+}
+
+static turn_txn_t* txn_start(lws_turn_t* turn, uint16_t method, int peer, uint32_t lifetime,
+                             uint64_t now_us)
+{
+    turn_txn_t* txn = NULL;
+    int i;
+
+    for (i = 0; i < TURN_MAX_TXNS; i++) {
+        if (!turn->txns[i].used) {
+            txn = &turn->txns[i];
+            break;
+        }
+    }
+    if (!txn) {
+        lws_log_warn(LWS_ERR_MEDIA_ICE, "[TURN] Transaction table full\n");
+        return NULL;
+    }
+
+    memset(txn, 0, sizeof(*txn));
+    txn->method = method;
+    txn->peer = peer;
+    txn->lifetime = lifetime;
+    if (txn_build(turn, txn) != 0) {
+        return NULL;
+    }
+    txn->used = 1;
+    txn->rto_ms = TURN_RTO_MS;
+    txn->tx = 1;
+    txn_send(turn, txn, now_us);
+    return txn;
+}
+
+static void fail(lws_turn_t* turn, int code)
+{
+    if (turn->state == LWS_TURN_FAILED) {
+        return;
+    }
+    turn->state = LWS_TURN_FAILED;
+    if (turn->handler.on_failed) {
+        turn->handler.on_failed(turn->handler.param, code);
+    }
+}
+
+/**
+ * @brief Start the permission and channel requests that are due
+ */
+static void peers_poll(lws_turn_t* turn, uint64_t now_us)
+{
+    int i;
+
+    for (i = 0; i < turn->peer_count; i++) {
+        turn_peer_t* peer = &turn->peers[i];
+
+        if (!peer->perm_pending && now_us >= peer->perm_refresh_us &&
+            txn_start(turn, LWS_STUN_CREATE_PERMISSION, i, 0, now_us)) {
+            peer->perm_pending = 1;
+        }
+        if (!peer->chan_pending && now_us >= peer->chan_refresh_us &&
+            txn_start(turn, LWS_STUN_CHANNEL_BIND, i, 0, now_us)) {
+            peer->chan_pending = 1;
+        }
+    }
+}
+
+/**
+ * @brief Transaction finished: code 0 on success, ERROR-CODE, or -1 on timeout
+ */
+static void txn_done(lws_turn_t* turn, turn_txn_t* txn, const uint8_t* msg, int bytes,
+                     int code, uint64_t now_us)
+{
+    turn_peer_t* peer = txn->peer >= 0 ? &turn->peers[txn->peer] : NULL;
+    uint32_t lifetime = txn->lifetime;
+
+    txn->used = 0;
+
+    switch (txn->method) {
+    case LWS_STUN_ALLOCATE:
+        if (code != 0 ||
+            lws_stun_xor_addr(msg, bytes, LWS_STUN_ATTR_XOR_RELAYED_ADDRESS, &turn->relayed) != 0) {
+            lws_log_warn(LWS_ERR_MEDIA_ICE, "[TURN] Allocate failed (%d)\n", code);
+            fail(turn, code);
+            return;
+        }
+        lws_stun_xor_addr(msg, bytes, LWS_STUN_ATTR_XOR_MAPPED_ADDRESS, &turn->mapped);
+        lws_stun_get_u32(msg, bytes, LWS_STUN_ATTR_LIFETIME, &lifetime);
+        turn->refresh_us = refresh_at(now_us, lifetime);
+        turn->state = LWS_TURN_READY;
+        lws_log_info("[TURN] Allocated relay port %u for %u s\n",
+                     (unsigned)ntohs(turn->relayed.sin_port), (unsigned)lifetime);
+        if (turn->handler.on_allocated) {
+            turn->handler.on_allocated(turn->handler.param, &turn->relayed, &turn->mapped);
+        }
+        peers_poll(turn, now_us);   /* 分配前登记的对端 */
+        break;
+
+    case LWS_STUN_REFRESH:
+        turn->refreshing = 0;
+        if (code != 0) {
+            lws_log_warn(LWS_ERR_MEDIA_ICE, "[TURN] Refresh failed (%d), allocation lost\n", code);
+            fail(turn, code);
+            return;
+        }
+        lws_stun_get_u32(msg, bytes, LWS_STUN_ATTR_LIFETIME, &lifetime);
+        turn->refresh_us = refresh_at(now_us, lifetime);
+        turn->stats.refreshes++;
+        break;
+
+    case LWS_STUN_CREATE_PERMISSION:
+        peer->perm_pending = 0;
+        if (code != 0) {
+            lws_log_warn(LWS_ERR_MEDIA_ICE, "[TURN] CreatePermission failed (%d)\n", code);
+            peer->perm_refresh_us = now_us + (uint64_t)TURN_RETRY_MS * 1000;
+            return;
+        }
+        turn->stats.refreshes += peer->permitted;
+        peer->permitted = 1;
+        peer->perm_refresh_us = refresh_at(now_us, LWS_TURN_PERMISSION_S);
+        break;
+
+    case LWS_STUN_CHANNEL_BIND:
+        peer->chan_pending = 0;
+        if (code != 0) {
+            lws_log_warn(LWS_ERR_MEDIA_ICE, "[TURN] ChannelBind failed (%d)\n", code);
+            peer->chan_refresh_us = now_us + (uint64_t)TURN_RETRY_MS * 1000;
+            return;
+        }
+        turn->stats.refreshes += peer->bound;
+        peer->bound = 1;
+        peer->chan_refresh_us = refresh_at(now_us, LWS_TURN_CHANNEL_S);
+        break;
+    }
+}
+
+/**
+ * @brief Response from the server (RFC 8656 §7.3, RFC 8489 §9.2.5)
+ */
+static void handle_response(lws_turn_t* turn, const uint8_t* msg, int bytes, uint64_t now_us)
+{
+    turn_txn_t* txn = NULL;
+    uint16_t type = lws_stun_type(msg);
+    int i;
+
+    for (i = 0; i < TURN_MAX_TXNS; i++) {
+        if (turn->txns[i].used &&
+            memcmp(turn->txns[i].tid, lws_stun_msg_tid(msg), LWS_STUN_TID_SIZE) == 0) {
+            txn = &turn->txns[i];
+            break;
+        }
+    }
+    if (!txn || LWS_STUN_METHOD(type) != txn->method) {
+        return;
+    }
+
+    if (LWS_STUN_IS_SUCCESS(type)) {
+        /* 伪造或损坏的响应丢弃，等待重传 */
+        if (turn->have_key &&
+            lws_stun_check_integrity(msg, bytes, turn->key, sizeof(turn->key)) != 0) {
+            return;
+        }
+        txn_done(turn, txn, msg, bytes, 0, now_us);
+        return;
+    }
+
+    int code = lws_stun_error_code(msg, bytes);
+    if ((code == 401 || code == 438) && txn->auth_tries < TURN_AUTH_RETRIES) {
+        const uint8_t* realm;
+        const uint8_t* nonce;
+        int rlen = 0;
+        int nlen = 0;
+
+        realm = lws_stun_find(msg, bytes, LWS_STUN_ATTR_REALM, &rlen);
+        nonce = lws_stun_find(msg, bytes, LWS_STUN_ATTR_NONCE, &nlen);
+        /* 已认证后的401表示凭据错误 */
+        if (nonce && nlen < LWS_TURN_CRED_SIZE && (code == 438 || !turn->have_key) &&
+            (!realm || rlen < LWS_TURN_CRED_SIZE)) {
+            if (realm) {
+                memcpy(turn->realm, realm, rlen);
+                turn->realm[rlen] = '\0';
+            }
+            memcpy(turn->nonce, nonce, nlen);
+            turn->nonce[nlen] = '\0';
+            if (lws_stun_long_term_key(turn->config.username, turn->realm,
+                                       turn->config.password, turn->key) == 0) {
+                turn->have_key = 1;
+                txn->auth_tries++;
+                if (txn_build(turn, txn) == 0) {
+                    txn->rto_ms = TURN_RTO_MS;
+                    txn->tx = 1;
+                    txn_send(turn, txn, now_us);
+                    return;
+                }
+            }
+        }
+    }
+    txn_done(turn, txn, msg, bytes, code > 0 ? code : 400, now_us);
+}
+
+/* ========================================
+ * Client
+ * ======================================== */
+
+lws_turn_t* lws_turn_create(const lws_turn_config_t* config, const lws_turn_handler_t* handler)
+{
+    lws_turn_t* turn;
+
+    if (!config || !handler || !handler->send || config->server.sin_port == 0) {
+        return NULL;
+    }
+
+    turn = (lws_turn_t*)lws_malloc(sizeof(*turn));
+    if (!turn) {
+        return NULL;
+    }
+    memset(turn, 0, sizeof(*turn));
+    turn->config = *config;
+    turn->handler = *handler;
+    if (turn->config.lifetime_s <= 0) {
+        turn->config.lifetime_s = LWS_TURN_LIFETIME_S;
+    }
+    turn->state = LWS_TURN_IDLE;
+    return turn;
+}
+
+void lws_turn_destroy(lws_turn_t* turn)
+{
+    turn_txn_t txn;
+
+    if (!turn) {
+        return;
+    }
+
+    /* 释放分配：LIFETIME 0的Refresh，不等待响应 (RFC 8656 §7) */
+    if (turn->state == LWS_TURN_READY) {
+        memset(&txn, 0, sizeof(txn));
+        txn.method = LWS_STUN_REFRESH;
+        txn.peer = -1;
+        if (txn_build(turn, &txn) == 0) {
+            turn->handler.send(turn->handler.param, &turn->config.server, txn.msg, txn.len);
+        }
+    }
+    lws_free(turn);
+}
+
+int lws_turn_allocate(lws_turn_t* turn, uint64_t now_us)
+{
+    if (!turn || turn->state != LWS_TURN_IDLE) {
+        return -1;
+    }
+    turn->now_us = now_us;
+    if (!txn_start(turn, LWS_STUN_ALLOCATE, -1, (uint32_t)turn->config.lifetime_s, now_us)) {
+        return -1;
+    }
+    turn->state = LWS_TURN_ALLOCATING;
+    return 0;
+}
+
+static int find_peer(const lws_turn_t* turn, const struct sockaddr_in* addr)
+{
+    int i;
+
+    for (i = 0; i < turn->peer_count; i++) {
+        if (same_addr(&turn->peers[i].addr, addr)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int lws_turn_permit(lws_turn_t* turn, const struct sockaddr_in* peer)
+{
+    turn_peer_t* p;
+
+    if (!turn || !peer ||
+        (turn->state != LWS_TURN_ALLOCATING && turn->state != LWS_TURN_READY)) {
+        return -1;
+    }
+    if (find_peer(turn, peer) >= 0) {
+        return 0;
+    }
+    if (turn->peer_count >= LWS_TURN_MAX_PEERS) {
+        return -1;
+    }
+
+    p = &turn->peers[turn->peer_count];
+    memset(p, 0, sizeof(*p));
+    p->addr = *peer;
+    p->channel = (uint16_t)(LWS_TURN_CHANNEL_MIN + turn->peer_count);
+    turn->peer_count++;
+
+    if (turn->state == LWS_TURN_READY) {
+        peers_poll(turn, turn->now_us);
+    }
+    return 0;
+}
+
+int lws_turn_send(lws_turn_t* turn, const struct sockaddr_in* peer, const uint8_t* data, int bytes)
+{
+    uint8_t buf[LWS_STUN_HEADER_SIZE + 12 + 4 + LWS_TURN_MAX_PAYLOAD];
+    uint8_t tid[LWS_STUN_TID_SIZE];
+    int index;
+    int n;
+
+    if (!turn || !peer || !data || turn->state != LWS_TURN_READY ||
+        bytes <= 0 || bytes > LWS_TURN_MAX_PAYLOAD) {
+        return -1;
+    }
+
+    index = find_peer(turn, peer);
+    if (index < 0) {
+        if (lws_turn_permit(turn, peer) != 0) {
+            return -1;
+        }
+        index = turn->peer_count - 1;
+    }
+
+    if (turn->peers[index].bound) {
+        put16(buf, turn->peers[index].channel);
+        put16(buf + 2, (uint16_t)bytes);
+        memcpy(buf + LWS_TURN_CHANNEL_HEADER, data, bytes);
+        n = LWS_TURN_CHANNEL_HEADER + bytes;
+        turn->stats.channel_data++;
+    } else {
+        /* 通道绑定完成前用Send indication（许可未生效时服务器丢弃） */
+        if (lws_stun_tid(tid) != 0) {
+            return -1;
+        }
+        n = lws_stun_init(buf, sizeof(buf), LWS_STUN_SEND_INDICATION, tid);
+        n = lws_stun_add_xor_addr(buf, sizeof(buf), n, LWS_STUN_ATTR_XOR_PEER_ADDRESS, peer);
+        n = lws_stun_add(buf, sizeof(buf), n, LWS_STUN_ATTR_DATA, data, bytes);
+        if (n < 0) {
+            return -1;
+        }
+        turn->stats.send_indications++;
+    }
+    return turn->handler.send(turn->handler.param, &turn->config.server, buf, n) == 0 ? 0 : -1;
+}
+
+int lws_turn_input(lws_turn_t* turn, const struct sockaddr_in* from,
+                   const uint8_t* data, int bytes, uint64_t now_us,
+                   struct sockaddr_in* peer, int* offset, int* len)
+{
+    if (!turn || !from || !data || !same_addr(from, &turn->config.server)) {
+        return 0;
+    }
+    turn->now_us = now_us;
+
+    if (bytes >= LWS_TURN_CHANNEL_HEADER && LWS_TURN_IS_CHANNEL_DATA(data[0])) {
+        uint16_t channel = get16(data);
+        int length = get16(data + 2);
+        int i;
+
+        if (LWS_TURN_CHANNEL_HEADER + length > bytes) {
+            return 1;
+        }
+        for (i = 0; i < turn->peer_count; i++) {
+            if (turn->peers[i].channel == channel) {
+                *peer = turn->peers[i].addr;
+                *offset = LWS_TURN_CHANNEL_HEADER;
+                *len = length;
+                return 2;
+            }
+        }
+        return 1;                   /* 未知通道 */
+    }
+
+    if (!lws_stun_is_message(data, bytes)) {
+        return 0;
+    }
+
+    if (lws_stun_type(data) == LWS_STUN_DATA_INDICATION) {
+        const uint8_t* value;
+        int vlen = 0;
+
+        value = lws_stun_find(data, bytes, LWS_STUN_ATTR_DATA, &vlen);
+        if (!value || lws_stun_xor_addr(data, bytes, LWS_STUN_ATTR_XOR_PEER_ADDRESS, peer) != 0) {
+            return 1;
+        }
+        *offset = (int)(value - data);
+        *len = vlen;
+        return 2;
+    }
+
+    if (LWS_STUN_IS_SUCCESS(lws_stun_type(data)) || LWS_STUN_IS_ERROR(lws_stun_type(data))) {
+        handle_response(turn, data, bytes, now_us);
+    }
+    return 1;
+}
+
+void lws_turn_poll(lws_turn_t* turn, uint64_t now_us)
+{
+    int i;
+
+    if (!turn) {
+        return;
+    }
+    turn->now_us = now_us;
+
+    for (i = 0; i < TURN_MAX_TXNS; i++) {
+        turn_txn_t* txn = &turn->txns[i];
+
+        if (!txn->used || now_us < txn->retransmit_us) {
+            continue;
+        }
+        if (txn->tx >= TURN_MAX_TX) {
+            txn_done(turn, txn, NULL, 0, -1, now_us);
+            continue;
+        }
+        txn->tx++;
+        txn->rto_ms = txn->rto_ms * 2 > TURN_RTO_MAX_MS ? TURN_RTO_MAX_MS : txn->rto_ms * 2;
+        txn_send(turn, txn, now_us);
+    }
+
+    if (turn->state != LWS_TURN_READY) {
+        return;
+    }
+    if (!turn->refreshing && now_us >= turn->refresh_us &&
+        txn_start(turn, LWS_STUN_REFRESH, -1, (uint32_t)turn->config.lifetime_s, now_us)) {
+        turn->refreshing = 1;
+    }
+    peers_poll(turn, now_us);
+}
+
+lws_turn_state_t lws_turn_state(const lws_turn_t* turn)
+{
+    return turn ? turn->state : LWS_TURN_FAILED;
+}
+
+int lws_turn_relayed(const lws_turn_t* turn, struct sockaddr_in* relayed)
+{
+    if (!turn || turn->state != LWS_TURN_READY) {
+        return -1;
+    }
+    if (relayed) {
+        *relayed = turn->relayed;
+    }
+    return 0;
+}
+
+void lws_turn_get_stats(const lws_turn_t* turn, lws_turn_stats_t* stats)
+{
+    if (turn && stats) {
+        *stats = turn->stats;
+    }
+}
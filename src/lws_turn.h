@@ -0,0 +1,146 @@
+/**
+ * @file lws_turn.h
+ * @brief TURN client (RFC 8656): relayed transport address for ICE
+ *
+ * Like the ICE agent, the client owns no socket and no timer: requests go
+ * to the server through the send callback on the media socket, every
+ * datagram received from the server is passed to lws_turn_input() and
+ * lws_turn_poll() is called from the session loop to retransmit requests
+ * and refresh the allocation, permissions and channels before they expire.
+ *
+ * The first Allocate is sent without credentials; the 401 challenge gives
+ * the realm and nonce for the long-term credential used by every later
+ * request (a 438 Stale Nonce is retried with the new nonce).
+ *
+ * Each peer gets a permission and a channel. Until the ChannelBind
+ * succeeds, data goes out in Send indications (36 bytes of overhead);
+ * afterwards in ChannelData messages with a 4-byte header.
+ */
+
+#ifndef __LWS_TURN_H__
+#define __LWS_TURN_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Constants
+ * ======================================== */
+
+#define LWS_TURN_MAX_PEERS          8       /**< Peers with a permission and channel */
+#define LWS_TURN_LIFETIME_S         600     /**< Requested allocation lifetime */
+#define LWS_TURN_PERMISSION_S       300     /**< Permission lifetime (RFC 8656 §9) */
+#define LWS_TURN_CHANNEL_S          600     /**< Channel binding lifetime (RFC 8656 §12) */
+#define LWS_TURN_REFRESH_MARGIN_S   60      /**< Refresh this long before expiry */
+#define LWS_TURN_CHANNEL_MIN        0x4000  /**< First channel number */
+#define LWS_TURN_CHANNEL_HEADER     4       /**< ChannelData header size */
+#define LWS_TURN_MAX_PAYLOAD        1500    /**< Largest relayed datagram */
+#define LWS_TURN_CRED_SIZE          128     /**< username/password/realm/nonce buffer */
+
+/** First byte of a ChannelData message (RFC 7983 §7: 64-79) */
+#define LWS_TURN_IS_CHANNEL_DATA(b) ((b) >= 64 && (b) <= 79)
+
+typedef struct lws_turn_t lws_turn_t;
+
+typedef enum {
+    LWS_TURN_IDLE,
+    LWS_TURN_ALLOCATING,
+    LWS_TURN_READY,                 /**< Relayed address allocated */
+    LWS_TURN_FAILED                 /**< Allocation or refresh failed */
+} lws_turn_state_t;
+
+typedef struct {
+    struct sockaddr_in server;
+    char username[LWS_TURN_CRED_SIZE];
+    char password[LWS_TURN_CRED_SIZE];
+    int lifetime_s;                 /**< 0 = LWS_TURN_LIFETIME_S */
+} lws_turn_config_t;
+
+typedef struct {
+    /** Send one datagram to the server from the media socket, 0 on success */
+    int (*send)(void* param, const struct sockaddr_in* to, const uint8_t* data, int bytes);
+    /** Allocation succeeded: relayed address and our server-reflexive address */
+    void (*on_allocated)(void* param, const struct sockaddr_in* relayed,
+                         const struct sockaddr_in* mapped);
+    /** Allocation failed or was lost (ERROR-CODE, or -1 on timeout) */
+    void (*on_failed)(void* param, int code);
+    void* param;
+} lws_turn_handler_t;
+
+typedef struct {
+    uint32_t channel_data;          /**< ChannelData messages sent */
+    uint32_t send_indications;      /**< Send indications sent */
+    uint32_t refreshes;             /**< Successful Refresh/CreatePermission/ChannelBind renewals */
+    uint32_t requests;              /**< Requests sent, retransmissions included */
+} lws_turn_stats_t;
+
+/* ========================================
+ * Client
+ * ======================================== */
+
+lws_turn_t* lws_turn_create(const lws_turn_config_t* config, const lws_turn_handler_t* handler);
+
+/**
+ * @brief Release the allocation (Refresh with LIFETIME 0, not retransmitted)
+ * and free the client
+ */
+void lws_turn_destroy(lws_turn_t* turn);
+
+/**
+ * @brief Send the first Allocate request
+ */
+int lws_turn_allocate(lws_turn_t* turn, uint64_t now_us);
+
+/**
+ * @brief Install a permission and bind a channel for a peer
+ *
+ * Called for every remote candidate before checks are relayed to it;
+ * lws_turn_send() does it implicitly for unknown peers.
+ *
+ * @return 0 on success, -1 if not allocated or the peer table is full
+ */
+int lws_turn_permit(lws_turn_t* turn, const struct sockaddr_in* peer);
+
+/**
+ * @brief Relay a datagram to a peer (ChannelData once the channel is bound)
+ * @return 0 on success, -1 if not allocated, too large or the send failed
+ */
+int lws_turn_send(lws_turn_t* turn, const struct sockaddr_in* peer, const uint8_t* data, int bytes);
+
+/**
+ * @brief Process a datagram received on the media socket
+ *
+ * @param peer Output: peer address of relayed data
+ * @param offset Output: relayed data starts at data + *offset
+ * @param len Output: relayed data length
+ * @return 0 if not from the server, 1 if consumed (response, unknown
+ * channel), 2 if it carried relayed data
+ */
+int lws_turn_input(lws_turn_t* turn, const struct sockaddr_in* from,
+                   const uint8_t* data, int bytes, uint64_t now_us,
+                   struct sockaddr_in* peer, int* offset, int* len);
+
+/**
+ * @brief Retransmit requests; refresh the allocation, permissions and channels
+ */
+void lws_turn_poll(lws_turn_t* turn, uint64_t now_us);
+
+lws_turn_state_t lws_turn_state(const lws_turn_t* turn);
+
+/**
+ * @brief Relayed transport address
+ * @return 0 if allocated, -1 otherwise
+ */
+int lws_turn_relayed(const lws_turn_t* turn, struct sockaddr_in* relayed);
+
+void lws_turn_get_stats(const lws_turn_t* turn, lws_turn_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_TURN_H__ */
@@ -0,0 +1,304 @@
+/**
+ * @file lws_vad.c
+ * @brief Voice activity detection and RFC 3389 comfort noise implementation
+ *
+ * 判决依据：
+ * - 帧能量与自适应噪声基底之比（SNR）
+ * - LPC预测增益：语音的频谱起伏大，预测增益高；背景噪声接近白噪声
+ *
+ * 噪声基底取最近1~2秒内帧功率的最小值（最小值统计）：语音中总有停顿，
+ * 因此即使持续判为语音，基底也能在2秒内跟上变大的背景噪声。
+ */
+
+#include <string.h>
+
+#include "lws_vad.h"
+
+/* ========================================
+ * Tuning
+ * ======================================== */
+
+#define VAD_MIN_POWER       100.0f  /* 约-70dBov，低于此值恒为静音 */
+#define VAD_SNR_SPEECH      4.0f    /* 6dB以上为语音 */
+#define VAD_SNR_SHAPED      2.0f    /* 3dB以上且频谱有起伏时为语音 */
+#define VAD_PRED_GAIN       4.0f    /* 6dB预测增益 */
+#define VAD_WINDOW_MS       1000    /* 最小值跟踪窗口 */
+#define VAD_MIN_BIAS        1.25f   /* 帧功率最小值相对噪声均值偏低，补偿约1dB */
+#define VAD_NOISE_SMOOTH    0.2f    /* 噪声频谱平滑系数 */
+
+/* dBov参考：16位满幅方波的功率 */
+#define CN_FULL_SCALE_POWER (32768.0f * 32768.0f)
+#define CN_DB_STEP          1.2589254f  /* 10^(1/10) */
+#define CN_DB_HALF_STEP     1.1220185f  /* 10^(1/20) */
+
+/* ========================================
+ * Math helpers (no libm)
+ * ======================================== */
+
+static float fsqrt(float x)
+{
+    float r;
+    int i;
+
+    if (x <= 0.0f) {
+        return 0.0f;
+    }
+    r = x > 1.0f ? x * 0.5f : 1.0f;
+    for (i = 0; i < 32; i++) {
+        r = 0.5f * (r + x / r);
+    }
+    return r;
+}
+
+static int power_to_dbov(float power)
+{
+    float ratio;
+    int level = 0;
+
+    if (power <= 0.0f) {
+        return 127;
+    }
+    ratio = CN_FULL_SCALE_POWER / power;
+    while (ratio >= CN_DB_STEP && level < 127) {
+        ratio /= CN_DB_STEP;
+        level++;
+    }
+    if (ratio >= CN_DB_HALF_STEP && level < 127) {
+        level++;
+    }
+    return level;
+}
+
+static float dbov_to_power(int level)
+{
+    float power = CN_FULL_SCALE_POWER;
+    int i;
+
+    for (i = 0; i < level; i++) {
+        power /= CN_DB_STEP;
+    }
+    return power;
+}
+
+/**
+ * @brief LPC analysis (autocorrelation + Levinson-Durbin)
+ * @param k Output reflection coefficients
+ * @param power Output mean square of the frame
+ * @return Prediction gain (r0 / residual energy)
+ */
+static float lpc_analyze(const int16_t* pcm, int samples, float* k, int order,
+                         float* power)
+{
+    float r[LWS_CN_MAX_ORDER + 1];
+    float a[LWS_CN_MAX_ORDER];
+    float tmp[LWS_CN_MAX_ORDER];
+    float err;
+    int i, j;
+
+    for (i = 0; i <= order; i++) {
+        float acc = 0.0f;
+        for (j = i; j < samples; j++) {
+            acc += (float)pcm[j] * (float)pcm[j - i];
+        }
+        r[i] = acc;
+    }
+
+    memset(k, 0, order * sizeof(float));
+    *power = samples > 0 ? r[0] / (float)samples : 0.0f;
+    if (r[0] <= 0.0f) {
+        return 1.0f;
+    }
+
+    /* 轻微白噪声修正，保证数值稳定 */
+    err = r[0] * 1.0001f;
+    for (i = 0; i < order; i++) {
+        float acc = r[i + 1];
+        float ki;
+
+        for (j = 0; j < i; j++) {
+            acc += a[j] * r[i - j];
+        }
+        ki = -acc / err;
+        if (ki > 0.99f) ki = 0.99f;
+        if (ki < -0.99f) ki = -0.99f;
+        k[i] = ki;
+
+        for (j = 0; j < i; j++) {
+            tmp[j] = a[j] + ki * a[i - 1 - j];
+        }
+        memcpy(a, tmp, i * sizeof(float));
+        a[i] = ki;
+        err *= 1.0f - ki * ki;
+    }
+
+    return err > 0.0f ? r[0] / err : 1.0f;
+}
+
+/* ========================================
+ * Comfort noise payload
+ * ======================================== */
+
+int lws_cn_encode(const lws_cn_params_t* params, uint8_t* buf, int size)
+{
+    int i;
+
+    if (size < 1 + params->order) {
+        return -1;
+    }
+
+    buf[0] = (uint8_t)(params->level & 0x7f);
+    for (i = 0; i < params->order; i++) {
+        /* 线性量化：k = (N - 127) / 128 */
+        int q = (int)(params->k[i] * 128.0f + (params->k[i] < 0 ? -0.5f : 0.5f)) + 127;
+        if (q < 0) q = 0;
+        if (q > 254) q = 254;
+        buf[1 + i] = (uint8_t)q;
+    }
+    return 1 + params->order;
+}
+
+int lws_cn_decode(lws_cn_params_t* params, const uint8_t* data, int bytes)
+{
+    int i;
+
+    if (bytes < 1) {
+        return -1;
+    }
+
+    memset(params, 0, sizeof(*params));
+    params->level = data[0] & 0x7f;
+    params->order = bytes - 1 < LWS_CN_MAX_ORDER ? bytes - 1 : LWS_CN_MAX_ORDER;
+    for (i = 0; i < params->order; i++) {
+        params->k[i] = ((float)data[1 + i] - 127.0f) / 128.0f;
+    }
+    return 0;
+}
+
+/* ========================================
+ * Voice activity detector
+ * ======================================== */
+
+void lws_vad_init(lws_vad_t* vad, int hangover_ms, int frame_ms)
+{
+    memset(vad, 0, sizeof(*vad));
+    vad->hangover_frames = frame_ms > 0 ? (hangover_ms + frame_ms - 1) / frame_ms : 0;
+    vad->window_frames = frame_ms > 0 ? VAD_WINDOW_MS / frame_ms : 50;
+    vad->noise.level = 127;
+    vad->noise.order = LWS_CN_ORDER;
+}
+
+int lws_vad_process(lws_vad_t* vad, const int16_t* pcm, int samples)
+{
+    float k[LWS_CN_ORDER];
+    float power;
+    float gain = lpc_analyze(pcm, samples, k, LWS_CN_ORDER, &power);
+    int speech = 0;
+    int i;
+
+    if (vad->frames++ == 0) {
+        vad->noise_power = power;
+        vad->window_min = power;
+        vad->prev_min = power;
+    }
+
+    if (power > VAD_MIN_POWER) {
+        if (power > vad->noise_power * VAD_SNR_SPEECH) {
+            speech = 1;
+        } else if (power > vad->noise_power * VAD_SNR_SHAPED && gain > VAD_PRED_GAIN) {
+            speech = 1;
+        }
+    }
+
+    /* 噪声基底：当前窗口与上一窗口中的最小帧功率 */
+    if (power < vad->window_min) {
+        vad->window_min = power;
+    }
+    vad->noise_power = (vad->window_min < vad->prev_min ? vad->window_min : vad->prev_min) *
+                       VAD_MIN_BIAS;
+    if (vad->noise_power < 1.0f) {
+        vad->noise_power = 1.0f;
+    }
+    if (++vad->window_pos >= vad->window_frames) {
+        vad->prev_min = vad->window_min;
+        vad->window_min = power;
+        vad->window_pos = 0;
+    }
+
+    if (!speech) {
+        /* 背景噪声描述（用于CN） */
+        for (i = 0; i < LWS_CN_ORDER; i++) {
+            vad->noise.k[i] += (k[i] - vad->noise.k[i]) * VAD_NOISE_SMOOTH;
+        }
+        vad->noise.level = power_to_dbov(vad->noise_power);
+    }
+
+    if (speech) {
+        vad->hangover = vad->hangover_frames;
+        return 1;
+    }
+    if (vad->hangover > 0) {
+        vad->hangover--;
+        return 1;
+    }
+    return 0;
+}
+
+const lws_cn_params_t* lws_vad_noise(const lws_vad_t* vad)
+{
+    return &vad->noise;
+}
+
+/* ========================================
+ * Comfort noise generator
+ * ======================================== */
+
+void lws_cn_gen_init(lws_cn_gen_t* gen, uint32_t seed)
+{
+    memset(gen, 0, sizeof(*gen));
+    gen->params.level = 127;
+    gen->seed = seed ? seed : 1;
+}
+
+void lws_cn_gen_update(lws_cn_gen_t* gen, const lws_cn_params_t* params)
+{
+    float prod = 1.0f;
+    int i;
+
+    gen->params = *params;
+
+    /*
+     * 全极点合成滤波器把白噪声功率放大1/prod(1-k^2)倍，激励按此缩小；
+     * [-1,1)均匀分布的方差为1/3。
+     */
+    for (i = 0; i < params->order; i++) {
+        prod *= 1.0f - params->k[i] * params->k[i];
+    }
+    gen->gain = params->level >= 127 ? 0.0f :
+                fsqrt(3.0f * dbov_to_power(params->level) * prod);
+}
+
+void lws_cn_generate(lws_cn_gen_t* gen, int16_t* pcm, int samples)
+{
+    const float* k = gen->params.k;
+    float* b = gen->state;
+    int order = gen->params.order;
+    int n, i;
+
+    for (n = 0; n < samples; n++) {
+        float f;
+
+        gen->seed = gen->seed * 1664525u + 1013904223u;
+        f = gen->gain * ((float)(int32_t)gen->seed / 2147483648.0f);
+
+        /* 格型合成滤波器 */
+        for (i = order - 1; i >= 0; i--) {
+            f -= k[i] * b[i];
+            b[i + 1] = b[i] + k[i] * f;
+        }
+        b[0] = f;
+
+        if (f > 32767.0f) f = 32767.0f;
+        if (f < -32768.0f) f = -32768.0f;
+        pcm[n] = (int16_t)f;
+    }
+}
@@ -0,0 +1,133 @@
+/**
+ * @file lws_vad.h
+ * @brief Voice activity detection and RFC 3389 comfort noise
+ *
+ * The detector classifies 16-bit PCM frames from the frame energy against
+ * a noise floor (minimum statistics over the last one to two seconds) and
+ * the LPC prediction gain: speech is strongly shaped by the vocal tract,
+ * background noise is close to flat. The same LPC analysis yields the
+ * reflection coefficients carried in comfort noise (CN) payloads, so the
+ * receiver can regenerate noise with a similar level and spectrum while the
+ * sender is silent.
+ *
+ * Floating point is used without libm.
+ */
+
+#ifndef __LWS_VAD_H__
+#define __LWS_VAD_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ========================================
+ * Comfort noise parameters (RFC 3389 §3)
+ * ======================================== */
+
+#define LWS_CN_MAX_ORDER    10      /**< Reflection coefficients kept from a CN payload */
+#define LWS_CN_ORDER        4       /**< Spectral model order we send */
+
+/**
+ * @brief Noise description carried in a CN payload
+ */
+typedef struct {
+    int level;                      /**< Noise level in -dBov (0-127) */
+    int order;                      /**< Number of reflection coefficients (0 = white) */
+    float k[LWS_CN_MAX_ORDER];      /**< Reflection coefficients (-1, 1) */
+} lws_cn_params_t;
+
+/**
+ * @brief Encode a CN payload
+ * @param params Noise description
+ * @param buf Output buffer
+ * @param size Buffer size
+ * @return Payload length, -1 if the buffer is too small
+ */
+int lws_cn_encode(const lws_cn_params_t* params, uint8_t* buf, int size);
+
+/**
+ * @brief Decode a CN payload
+ *
+ * Coefficients beyond LWS_CN_MAX_ORDER are ignored.
+ *
+ * @return 0 on success, -1 on an empty payload
+ */
+int lws_cn_decode(lws_cn_params_t* params, const uint8_t* data, int bytes);
+
+/* ========================================
+ * Voice activity detector
+ * ======================================== */
+
+/**
+ * @brief VAD state
+ */
+typedef struct {
+    int hangover_frames;            /**< Frames kept active after speech ends */
+    int hangover;                   /**< Hangover frames left */
+    int frames;                     /**< Frames analysed */
+    int window_frames;              /**< Minimum tracking window (frames) */
+    int window_pos;                 /**< Frames into the current window */
+    float window_min;               /**< Minimum frame power in the current window */
+    float prev_min;                 /**< Minimum frame power in the previous window */
+    float noise_power;              /**< Noise floor (mean square) */
+    lws_cn_params_t noise;          /**< Smoothed background noise description */
+} lws_vad_t;
+
+/**
+ * @brief Initialize a detector
+ * @param vad Detector
+ * @param hangover_ms Time kept active after the last speech frame
+ * @param frame_ms Frame duration passed to lws_vad_process
+ */
+void lws_vad_init(lws_vad_t* vad, int hangover_ms, int frame_ms);
+
+/**
+ * @brief Classify one frame
+ *
+ * Non-speech frames also update the background noise description.
+ *
+ * @return 1 for speech (including hangover), 0 for silence
+ */
+int lws_vad_process(lws_vad_t* vad, const int16_t* pcm, int samples);
+
+/**
+ * @brief Current background noise description (for the CN payload)
+ */
+const lws_cn_params_t* lws_vad_noise(const lws_vad_t* vad);
+
+/* ========================================
+ * Comfort noise generator
+ * ======================================== */
+
+/**
+ * @brief CN generator state
+ */
+typedef struct {
+    lws_cn_params_t params;
+    float gain;                     /**< Excitation amplitude */
+    float state[LWS_CN_MAX_ORDER + 1]; /**< Lattice filter state */
+    uint32_t seed;
+} lws_cn_gen_t;
+
+/**
+ * @brief Initialize a generator (silent until updated)
+ */
+void lws_cn_gen_init(lws_cn_gen_t* gen, uint32_t seed);
+
+/**
+ * @brief Set the noise to generate from a received CN payload
+ */
+void lws_cn_gen_update(lws_cn_gen_t* gen, const lws_cn_params_t* params);
+
+/**
+ * @brief Generate comfort noise samples
+ */
+void lws_cn_generate(lws_cn_gen_t* gen, int16_t* pcm, int samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LWS_VAD_H__ */
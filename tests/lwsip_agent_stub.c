@@ -114,46 +114,119 @@ int lws_trans_get_fd(lws_trans_t* trans) {
  * Session stub (simple + SDP ready trigger)
  * ======================================== */
 
-/* Store handler for triggering callbacks */
-static struct {
-    void* handler;
+/*
+ * 每个会话保存自己的handler，并发来电各自回调到对应的dialog。
+ * 测试通过以下变量控制创建失败、remote SDP失败，并读取已创建的会话数；
+ * 会话中的offer/answer按lws_sess_set_offer_pending登记的状态分别计数。
+ */
+#define STUB_SESS_MAX 16
+
+typedef struct {
+    int used;
+    void (*on_sdp_ready)(lws_sess_t* sess, const char* sdp, void* userdata);
+    void (*on_candidate)(lws_sess_t* sess, const char* candidate, void* userdata);
     void* userdata;
-} g_sess_handler = {0};
+} stub_sess_t;
+
+static stub_sess_t g_stub_sess[STUB_SESS_MAX];
+
+int g_stub_sess_created = 0;         /**< lws_sess_create成功的次数 */
+int g_stub_sess_create_fail = 0;     /**< 非0时lws_sess_create失败 */
+int g_stub_sess_remote_sdp_fail = 0; /**< 非0时lws_sess_set_remote_sdp失败 */
+int g_stub_sess_sample_rate = 0;     /**< 最近创建的会话配置的audio_sample_rate */
+int g_stub_sess_remote_candidates = 0; /**< lws_sess_add_remote_candidate的次数 */
+int g_stub_sess_offer_pending = 0;   /**< 最近一次lws_sess_set_offer_pending的值 */
+int g_stub_sess_remote_offers = 0;   /**< 作为offer应用的会话中SDP数 */
+int g_stub_sess_remote_answers = 0;  /**< 作为answer应用的会话中SDP数 */
+lws_media_dir_t g_stub_sess_media_dir = LWS_MEDIA_DIR_SENDRECV; /**< 当前本端方向 */
+
+void lws_sess_init_audio_config(lws_sess_config_t* config, const char* stun_server,
+                                lws_rtp_payload_t codec) {
+    memset(config, 0, sizeof(*config));
+    config->stun_server = stun_server;
+    config->stun_port = LWS_DEFAULT_STUN_PORT;
+    config->enable_audio = 1;
+    config->audio_codec = codec;
+    config->telephone_event = 1;
+    config->audio_sample_rate = LWS_DEFAULT_SAMPLE_RATE;
+    config->audio_channels = LWS_DEFAULT_CHANNELS;
+    config->media_dir = LWS_MEDIA_DIR_SENDRECV;
+    config->enable_rtcp = 1;
+    config->symmetric_rtp = 1;
+    config->jitter_buffer_ms = LWS_DEFAULT_JITTER_BUFFER_MS;
+}
 
 lws_sess_t* lws_sess_create(const lws_sess_config_t* config, const lws_sess_handler_t* handler) {
-    (void)config;
+    if (g_stub_sess_create_fail) {
+        return NULL;
+    }
 
-    /* Store handler for later callback */
-    if (handler) {
-        g_sess_handler.handler = (void*)handler->on_sdp_ready;
-        g_sess_handler.userdata = handler->userdata;
+    for (int i = 0; i < STUB_SESS_MAX; i++) {
+        if (!g_stub_sess[i].used) {
+            g_stub_sess[i].used = 1;
+            g_stub_sess[i].on_sdp_ready = handler ? handler->on_sdp_ready : NULL;
+            g_stub_sess[i].on_candidate = handler ? handler->on_candidate : NULL;
+            g_stub_sess[i].userdata = handler ? handler->userdata : NULL;
+            g_stub_sess_created++;
+            g_stub_sess_sample_rate = config ? config->audio_sample_rate : 0;
+            return (lws_sess_t*)&g_stub_sess[i];
+        }
     }
 
-    return (lws_sess_t*)0x4444;
+    return NULL;
 }
 
 void lws_sess_destroy(lws_sess_t* sess) {
-    (void)sess;
-    g_sess_handler.handler = NULL;
-    g_sess_handler.userdata = NULL;
+    if (sess) {
+        memset(sess, 0, sizeof(stub_sess_t));
+    }
 }
 
 int lws_sess_gather_candidates(lws_sess_t* sess) {
     /* Immediately trigger SDP ready callback (simulating instant ICE gathering) */
-    if (g_sess_handler.handler) {
-        typedef void (*on_sdp_ready_f)(lws_sess_t* sess, const char* sdp, void* userdata);
-        on_sdp_ready_f callback = (on_sdp_ready_f)g_sess_handler.handler;
+    stub_sess_t* s = (stub_sess_t*)sess;
 
-        const char* sdp = lws_sess_get_local_sdp(sess);
-        callback(sess, sdp, g_sess_handler.userdata);
+    if (s && s->on_sdp_ready) {
+        s->on_sdp_ready(sess, lws_sess_get_local_sdp(sess), s->userdata);
     }
 
     return 0;
 }
 
+int lws_sess_loop(lws_sess_t* sess, int timeout_ms) {
+    (void)sess;
+    (void)timeout_ms;
+    return 0;
+}
+
 int lws_sess_set_remote_sdp(lws_sess_t* sess, const char* sdp) {
     (void)sess;
     (void)sdp;
+    return g_stub_sess_remote_sdp_fail ? -1 : 0;
+}
+
+int lws_sess_update_remote_sdp(lws_sess_t* sess, const char* sdp) {
+    (void)sess;
+    (void)sdp;
+
+    if (g_stub_sess_offer_pending) {
+        g_stub_sess_remote_answers++;
+        g_stub_sess_offer_pending = 0;
+    } else {
+        g_stub_sess_remote_offers++;
+    }
+    return 0;
+}
+
+int lws_sess_set_media_dir(lws_sess_t* sess, lws_media_dir_t dir) {
+    (void)sess;
+    g_stub_sess_media_dir = dir;
+    return 0;
+}
+
+int lws_sess_set_offer_pending(lws_sess_t* sess, int pending) {
+    (void)sess;
+    g_stub_sess_offer_pending = pending ? 1 : 0;
     return 0;
 }
 
@@ -174,8 +247,21 @@ const char* lws_sess_get_local_sdp(lws_sess_t* sess) {
            "c=IN IP4 127.0.0.1\r\n"
            "t=0 0\r\n"
            "m=audio 8000 RTP/AVP 0 8\r\n"
+           "a=mid:0\r\n"
            "a=rtpmap:0 PCMU/8000\r\n"
-           "a=rtpmap:8 PCMA/8000\r\n";
+           "a=rtpmap:8 PCMA/8000\r\n"
+           "a=ice-ufrag:stublocal\r\n"
+           "a=ice-pwd:stublocalpassword012345\r\n";
+}
+
+/* 模拟ICE收集到新的本地候选（trickle ICE） */
+void stub_sess_emit_candidate(const char* candidate) {
+    for (int i = 0; i < STUB_SESS_MAX; i++) {
+        if (g_stub_sess[i].used && g_stub_sess[i].on_candidate) {
+            g_stub_sess[i].on_candidate((lws_sess_t*)&g_stub_sess[i], candidate,
+                                        g_stub_sess[i].userdata);
+        }
+    }
 }
 
 lws_sess_state_t lws_sess_get_state(lws_sess_t* sess) {
@@ -183,6 +269,50 @@ lws_sess_state_t lws_sess_get_state(lws_sess_t* sess) {
     return LWS_SESS_STATE_IDLE;
 }
 
+int lws_sess_add_remote_candidate(lws_sess_t* sess, const char* candidate) {
+    (void)sess;
+    (void)candidate;
+    g_stub_sess_remote_candidates++;
+    return 0;
+}
+
+int lws_sess_end_of_candidates(lws_sess_t* sess) {
+    (void)sess;
+    return 0;
+}
+
+int lws_sess_send_dtmf(lws_sess_t* sess, const char* digits, int duration_ms) {
+    (void)sess;
+    (void)digits;
+    (void)duration_ms;
+    return 0;
+}
+
+int lws_sess_get_codecs(lws_sess_t* sess, lws_sess_codec_t* codecs, int max) {
+    (void)sess;
+    (void)codecs;
+    (void)max;
+    return 0;
+}
+
+/* lws_dtls_cleanup()由lws_agent_destroy调用 */
+void lws_dtls_cleanup(void) {
+}
+
+lws_sess_sock_pool_t* lws_sess_sock_pool_create(int capacity) {
+    (void)capacity;
+    return NULL;
+}
+
+void lws_sess_sock_pool_destroy(lws_sess_sock_pool_t* pool) {
+    (void)pool;
+}
+
+int lws_sess_sock_pool_fill(lws_sess_sock_pool_t* pool) {
+    (void)pool;
+    return 0;
+}
+
 /* ========================================
  * HTTP parser - provided by libhttp.a (no stub needed)
  * ======================================== */
@@ -6,6 +6,9 @@
  * - Agent creation and destruction
  * - Registration workflow
  * - Call establishment (UAC/UAS)
+ * - Deferred incoming-call setup
+ * - Mid-dialog offers (re-INVITE, UPDATE, hold/resume, 491 glare)
+ * - Trickle ICE over SIP INFO
  * - State transitions
  * - Error handling
  */
@@ -14,8 +17,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #include "lws_agent.h"
+#include "lws_sess.h"
 #include "lws_err.h"
 #include "lws_mem.h"
 #include "lws_log.h"
@@ -67,12 +72,15 @@ static int g_on_incoming_call_called = 0;
 static int g_on_dialog_state_changed_called = 0;
 static int g_on_remote_sdp_called = 0;
 static int g_on_error_called = 0;
+static int g_on_message_result_called = 0;
 
 /* Callback return values */
 static lws_agent_state_t g_last_agent_state = LWS_AGENT_STATE_IDLE;
 static int g_last_register_success = 0;
 static int g_last_register_status_code = 0;
 static lws_dialog_state_t g_last_dialog_state = LWS_DIALOG_STATE_NULL;
+static uint32_t g_message_ids[8];
+static int g_message_codes[8];
 
 /* Reset mock state */
 static void reset_mocks(void) {
@@ -82,6 +90,7 @@ static void reset_mocks(void) {
     g_on_dialog_state_changed_called = 0;
     g_on_remote_sdp_called = 0;
     g_on_error_called = 0;
+    g_on_message_result_called = 0;
 
     g_last_agent_state = LWS_AGENT_STATE_IDLE;
     g_last_register_success = 0;
@@ -182,6 +191,24 @@ static void mock_on_error(
     g_on_error_called++;
 }
 
+static void mock_on_message_result(
+    lws_agent_t* agent,
+    uint32_t msg_id,
+    int status_code,
+    uint32_t latency_us,
+    void* userdata)
+{
+    (void)agent;
+    (void)latency_us;
+    (void)userdata;
+
+    if (g_on_message_result_called < 8) {
+        g_message_ids[g_on_message_result_called] = msg_id;
+        g_message_codes[g_on_message_result_called] = status_code;
+    }
+    g_on_message_result_called++;
+}
+
 /* ========================================
  * Test Cases
  * ======================================== */
@@ -635,6 +662,552 @@ TEST(bye_hangup_success) {
     lws_timer_cleanup();
 }
 
+TEST(message_pipeline) {
+    lws_timer_init();
+
+    reset_mocks();
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_MESSAGE_SUCCESS);
+    trans_stub_set_response_delay(0);
+
+    lws_agent_config_t config;
+    lws_agent_init_default_config(&config, "1001", "secret", "stub.com", NULL);
+    config.auto_register = 0;
+    config.message_window = 2;
+
+    lws_agent_handler_t handler;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_message_result = mock_on_message_result;
+
+    lws_agent_t* agent = lws_agent_create(&config, &handler);
+    ASSERT_NOT_NULL(agent);
+
+    ASSERT_EQ(lws_agent_send_message(agent, NULL, NULL, "x", 1), LWS_EINVAL);
+
+    /* 5条消息，窗口为2：2条在途，3条排队 */
+    int ids[5];
+    for (int i = 0; i < 5; i++) {
+        char body[32];
+        int len = snprintf(body, sizeof(body), "{\"seq\":%d}", i);
+        ids[i] = lws_agent_send_message(agent, "sip:1002@stub.com",
+                                        "application/json", body, len);
+        ASSERT_TRUE(ids[i] > 0);
+    }
+    ASSERT_EQ(lws_agent_get_message_pending(agent), 5);
+
+    for (int i = 0; i < 50 && g_on_message_result_called < 5; i++) {
+        lws_agent_loop(agent, 10);
+        lws_thread_sleep(5);
+    }
+
+    /* 每个ID恰好一个结果，按发送顺序完成 */
+    ASSERT_EQ(g_on_message_result_called, 5);
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ((int)g_message_ids[i], ids[i]);
+        ASSERT_EQ(g_message_codes[i], 200);
+    }
+    ASSERT_EQ(lws_agent_get_message_pending(agent), 0);
+
+    lws_agent_destroy(agent);
+    lws_timer_cleanup();
+}
+
+/* ========================================
+ * Deferred incoming-call setup tests
+ * ======================================== */
+
+/* 与lws_agent.c中的AGENT_SETUP_BATCH保持一致 */
+#define TEST_SETUP_BATCH 4
+
+extern int g_stub_sess_created;
+extern int g_stub_sess_create_fail;
+extern int g_stub_sess_remote_sdp_fail;
+extern int g_stub_sess_sample_rate;
+
+static int g_incoming_trying_before_sess = 0;
+static int g_incoming_answer_ret = -1;
+static char g_incoming_answered[LWS_MAX_CALL_ID_LEN];
+
+static int build_invite(char* buf, size_t size, const char* call_id)
+{
+    static const char* sdp =
+        "v=0\r\n"
+        "o=1002 1 1 IN IP4 127.0.0.1\r\n"
+        "s=-\r\n"
+        "c=IN IP4 127.0.0.1\r\n"
+        "t=0 0\r\n"
+        "m=audio 9000 RTP/AVP 0\r\n"
+        "a=rtpmap:0 PCMU/8000\r\n";
+
+    return snprintf(buf, size,
+        "INVITE sip:1001@127.0.0.1:5060 SIP/2.0\r\n"
+        "Via: SIP/2.0/UDP 127.0.0.1:5070;branch=z9hG4bK-%s\r\n"
+        "Max-Forwards: 70\r\n"
+        "From: <sip:1002@stub.com>;tag=tag-%s\r\n"
+        "To: <sip:1001@stub.com>\r\n"
+        "Call-ID: %s\r\n"
+        "CSeq: 1 INVITE\r\n"
+        "Contact: <sip:1002@127.0.0.1:5070>\r\n"
+        "Content-Type: application/sdp\r\n"
+        "Content-Length: %d\r\n"
+        "\r\n"
+        "%s",
+        call_id, call_id, call_id, (int)strlen(sdp), sdp);
+}
+
+static int inject_invite(const char* call_id)
+{
+    char buf[1024];
+    int len = build_invite(buf, sizeof(buf), call_id);
+    return trans_stub_inject_request(buf, len);
+}
+
+static void mock_on_incoming_call_answer(
+    lws_agent_t* agent,
+    lws_dialog_t* dialog,
+    const lws_sip_addr_t* from,
+    void* userdata)
+{
+    (void)from;
+    (void)userdata;
+
+    g_on_incoming_call_called++;
+
+    /* 100 Trying必须在媒体会话创建之前发出 */
+    if (trans_stub_count_sent(100, dialog->call_id) > 0 && g_stub_sess_created == 0) {
+        g_incoming_trying_before_sess++;
+    }
+
+    /* 第一路来电在回调中直接接听，此时dialog仍在setup队列中 */
+    if (g_incoming_answered[0] == '\0') {
+        snprintf(g_incoming_answered, sizeof(g_incoming_answered), "%s", dialog->call_id);
+        g_incoming_answer_ret = lws_agent_answer_call(agent, dialog);
+    }
+}
+
+static void reset_incoming(void)
+{
+    g_stub_sess_created = 0;
+    g_stub_sess_create_fail = 0;
+    g_stub_sess_remote_sdp_fail = 0;
+    g_stub_sess_sample_rate = 0;
+    g_incoming_trying_before_sess = 0;
+    g_incoming_answer_ret = -1;
+    g_incoming_answered[0] = '\0';
+    trans_stub_clear_sent();
+}
+
+TEST(invite_incoming_setup_queue) {
+    lws_timer_init();
+
+    reset_mocks();
+    reset_incoming();
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_NONE);
+    trans_stub_set_response_delay(0);
+
+    lws_agent_config_t config;
+    lws_agent_init_default_config(&config, "1001", "secret", "stub.com", NULL);
+    config.auto_register = 0;
+
+    lws_agent_handler_t handler;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_incoming_call = mock_on_incoming_call_answer;
+    handler.on_dialog_state_changed = mock_on_dialog_state_changed;
+
+    lws_agent_t* agent = lws_agent_create(&config, &handler);
+    ASSERT_NOT_NULL(agent);
+
+    /* 6路来电同时到达，超过一轮的setup批量 */
+    const char* call_ids[6] = {
+        "setup-q-0", "setup-q-1", "setup-q-2",
+        "setup-q-3", "setup-q-4", "setup-q-5"
+    };
+    for (int i = 0; i < 6; i++) {
+        ASSERT_EQ(inject_invite(call_ids[i]), 0);
+    }
+
+    /* 第一轮：全部回100并上报来电，但只建立一个批量的会话 */
+    lws_agent_loop(agent, 10);
+
+    ASSERT_EQ(g_on_incoming_call_called, 6);
+    ASSERT_EQ(g_incoming_trying_before_sess, 6);
+    for (int i = 0; i < 6; i++) {
+        ASSERT_TRUE(trans_stub_count_sent(100, call_ids[i]) > 0);
+    }
+    ASSERT_EQ(g_stub_sess_created, TEST_SETUP_BATCH);
+    ASSERT_EQ(g_stub_sess_sample_rate, LWS_DEFAULT_SAMPLE_RATE);
+
+    /* 排队期间接听被延后，会话建立后才发200 */
+    ASSERT_EQ(g_incoming_answer_ret, LWS_OK);
+    ASSERT_EQ(strcmp(g_incoming_answered, call_ids[0]), 0);
+    ASSERT_EQ(trans_stub_count_sent(200, call_ids[0]), 1);
+    ASSERT_EQ(g_last_dialog_state, LWS_DIALOG_STATE_CONFIRMED);
+    for (int i = 1; i < 6; i++) {
+        ASSERT_EQ(trans_stub_count_sent(200, call_ids[i]), 0);
+    }
+
+    /* 第二轮：处理剩余的dialog */
+    lws_agent_loop(agent, 10);
+    ASSERT_EQ(g_stub_sess_created, 6);
+    ASSERT_EQ(trans_stub_count_sent(200, NULL), 1);
+    ASSERT_EQ(trans_stub_count_sent(500, NULL), 0);
+    ASSERT_EQ(trans_stub_count_sent(488, NULL), 0);
+
+    lws_agent_destroy(agent);
+    lws_timer_cleanup();
+}
+
+TEST(invite_incoming_setup_failure) {
+    lws_timer_init();
+
+    reset_mocks();
+    reset_incoming();
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_NONE);
+    trans_stub_set_response_delay(0);
+
+    lws_agent_config_t config;
+    lws_agent_init_default_config(&config, "1001", "secret", "stub.com", NULL);
+    config.auto_register = 0;
+
+    lws_agent_handler_t handler;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_incoming_call = mock_on_incoming_call;
+    handler.on_dialog_state_changed = mock_on_dialog_state_changed;
+
+    lws_agent_t* agent = lws_agent_create(&config, &handler);
+    ASSERT_NOT_NULL(agent);
+
+    /* 会话创建失败 -> 500 */
+    g_stub_sess_create_fail = 1;
+    ASSERT_EQ(inject_invite("setup-fail-500"), 0);
+    lws_agent_loop(agent, 10);
+
+    ASSERT_EQ(g_on_incoming_call_called, 1);
+    ASSERT_TRUE(trans_stub_count_sent(100, "setup-fail-500") > 0);
+    ASSERT_EQ(trans_stub_count_sent(500, "setup-fail-500"), 1);
+    ASSERT_EQ(g_last_dialog_state, LWS_DIALOG_STATE_FAILED);
+    ASSERT_EQ(g_stub_sess_created, 0);
+
+    /* 远端SDP无法协商 -> 488 */
+    g_stub_sess_create_fail = 0;
+    g_stub_sess_remote_sdp_fail = 1;
+    g_last_dialog_state = LWS_DIALOG_STATE_NULL;
+    ASSERT_EQ(inject_invite("setup-fail-488"), 0);
+    lws_agent_loop(agent, 10);
+
+    ASSERT_EQ(g_on_incoming_call_called, 2);
+    ASSERT_TRUE(trans_stub_count_sent(100, "setup-fail-488") > 0);
+    ASSERT_EQ(trans_stub_count_sent(488, "setup-fail-488"), 1);
+    ASSERT_EQ(g_last_dialog_state, LWS_DIALOG_STATE_FAILED);
+
+    g_stub_sess_remote_sdp_fail = 0;
+    lws_agent_destroy(agent);
+    lws_timer_cleanup();
+}
+
+/* ========================================
+ * Mid-dialog offer tests (re-INVITE/UPDATE)
+ * ======================================== */
+
+extern int g_stub_sess_offer_pending;
+extern int g_stub_sess_remote_offers;
+extern int g_stub_sess_remote_answers;
+extern lws_media_dir_t g_stub_sess_media_dir;
+
+static const char* g_peer_offer_sdp =
+    "v=0\r\n"
+    "o=stub 0 1 IN IP4 127.0.0.1\r\n"
+    "s=lwsip stub\r\n"
+    "c=IN IP4 127.0.0.1\r\n"
+    "t=0 0\r\n"
+    "m=audio 9000 RTP/AVP 0\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n";
+
+static uint64_t test_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void run_agent(lws_agent_t* agent, int rounds)
+{
+    for (int i = 0; i < rounds; i++) {
+        lws_agent_loop(agent, 10);
+        lws_thread_sleep(5);
+    }
+}
+
+/**
+ * @brief 建立一路主叫呼叫，并清零会话中offer/answer的统计
+ */
+static lws_dialog_t* reoffer_setup_call(lws_agent_t** out_agent)
+{
+    lws_agent_config_t config;
+    lws_agent_handler_t handler;
+
+    reset_mocks();
+    reset_incoming();
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_INVITE_SUCCESS);
+    trans_stub_set_response_delay(0);
+
+    lws_agent_init_default_config(&config, "1001", "secret", "stub.com", NULL);
+    config.auto_register = 0;
+
+    memset(&handler, 0, sizeof(handler));
+    handler.on_dialog_state_changed = mock_on_dialog_state_changed;
+    handler.on_remote_sdp = mock_on_remote_sdp;
+
+    *out_agent = lws_agent_create(&config, &handler);
+    if (!*out_agent) {
+        return NULL;
+    }
+
+    lws_dialog_t* dialog = lws_agent_make_call(*out_agent, "sip:1002@stub.com");
+    if (!dialog) {
+        return NULL;
+    }
+    run_agent(*out_agent, 50);
+
+    g_stub_sess_offer_pending = 0;
+    g_stub_sess_remote_offers = 0;
+    g_stub_sess_remote_answers = 0;
+    g_stub_sess_media_dir = LWS_MEDIA_DIR_SENDRECV;
+    trans_stub_clear_sent();
+    return dialog;
+}
+
+TEST(reoffer_hold_resume) {
+    lws_timer_init();
+
+    lws_agent_t* agent = NULL;
+    lws_dialog_t* dialog = reoffer_setup_call(&agent);
+    ASSERT_NOT_NULL(agent);
+    ASSERT_NOT_NULL(dialog);
+    ASSERT_EQ(g_last_dialog_state, LWS_DIALOG_STATE_CONFIRMED);
+    ASSERT_EQ(g_stub_sess_sample_rate, LWS_DEFAULT_SAMPLE_RATE);
+
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_REOFFER_SUCCESS);
+
+    /* 保持：re-INVITE发出即登记offer，200中的SDP作为answer应用 */
+    ASSERT_EQ(lws_agent_hold(agent, dialog), LWS_OK);
+    ASSERT_EQ(trans_stub_count_requests("INVITE"), 1);
+    ASSERT_EQ(g_stub_sess_media_dir, LWS_MEDIA_DIR_SENDONLY);
+    ASSERT_EQ(g_stub_sess_offer_pending, 1);
+    ASSERT_EQ(lws_agent_resume(agent, dialog), LWS_EBUSY);
+
+    run_agent(agent, 20);
+    ASSERT_EQ(g_stub_sess_offer_pending, 0);
+    ASSERT_EQ(g_stub_sess_remote_answers, 1);
+    ASSERT_EQ(g_stub_sess_remote_offers, 0);
+    ASSERT_EQ(g_stub_sess_media_dir, LWS_MEDIA_DIR_SENDONLY);
+
+    /* 恢复 */
+    ASSERT_EQ(lws_agent_resume(agent, dialog), LWS_OK);
+    ASSERT_EQ(trans_stub_count_requests("INVITE"), 2);
+    ASSERT_EQ(g_stub_sess_media_dir, LWS_MEDIA_DIR_SENDRECV);
+
+    run_agent(agent, 20);
+    ASSERT_EQ(g_stub_sess_offer_pending, 0);
+    ASSERT_EQ(g_stub_sess_remote_answers, 2);
+
+    /* 之后对端的re-INVITE仍按offer处理 */
+    ASSERT_EQ(trans_stub_inject_peer_offer("INVITE", g_peer_offer_sdp), 0);
+    run_agent(agent, 5);
+    ASSERT_EQ(g_stub_sess_remote_offers, 1);
+    ASSERT_EQ(trans_stub_count_sent(200, dialog->call_id), 1);
+
+    lws_agent_destroy(agent);
+    lws_timer_cleanup();
+}
+
+TEST(reoffer_update_rejected) {
+    lws_timer_init();
+
+    lws_agent_t* agent = NULL;
+    lws_dialog_t* dialog = reoffer_setup_call(&agent);
+    ASSERT_NOT_NULL(agent);
+    ASSERT_NOT_NULL(dialog);
+
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_REOFFER_SUCCESS);
+
+    /* UPDATE：同样以answer结束offer */
+    ASSERT_EQ(lws_agent_reoffer(agent, dialog, 1), LWS_OK);
+    ASSERT_EQ(trans_stub_count_requests("UPDATE"), 1);
+    ASSERT_EQ(trans_stub_count_requests("INVITE"), 0);
+    ASSERT_EQ(g_stub_sess_offer_pending, 1);
+
+    run_agent(agent, 20);
+    ASSERT_EQ(g_stub_sess_offer_pending, 0);
+    ASSERT_EQ(g_stub_sess_remote_answers, 1);
+
+    /* 保持被拒绝：方向回退，offer结束 */
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_REOFFER_REJECTED);
+    ASSERT_EQ(lws_agent_hold(agent, dialog), LWS_OK);
+    ASSERT_EQ(g_stub_sess_media_dir, LWS_MEDIA_DIR_SENDONLY);
+
+    run_agent(agent, 20);
+    ASSERT_EQ(g_stub_sess_media_dir, LWS_MEDIA_DIR_SENDRECV);
+    ASSERT_EQ(g_stub_sess_offer_pending, 0);
+    ASSERT_EQ(g_stub_sess_remote_answers, 1);
+
+    /* 拒绝后对端的UPDATE是新的offer，而不是answer */
+    ASSERT_EQ(trans_stub_inject_peer_offer("UPDATE", g_peer_offer_sdp), 0);
+    run_agent(agent, 5);
+    ASSERT_EQ(g_stub_sess_remote_offers, 1);
+    ASSERT_EQ(g_stub_sess_remote_answers, 1);
+    ASSERT_EQ(trans_stub_count_sent(200, dialog->call_id), 1);
+
+    /* 不再有进行中的offer，可以再次发起 */
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_REOFFER_SUCCESS);
+    ASSERT_EQ(lws_agent_reoffer(agent, dialog, 0), LWS_OK);
+    run_agent(agent, 20);
+    ASSERT_EQ(g_stub_sess_remote_answers, 2);
+
+    lws_agent_destroy(agent);
+    lws_timer_cleanup();
+}
+
+TEST(reoffer_glare) {
+    lws_timer_init();
+
+    lws_agent_t* agent = NULL;
+    lws_dialog_t* dialog = reoffer_setup_call(&agent);
+    ASSERT_NOT_NULL(agent);
+    ASSERT_NOT_NULL(dialog);
+
+    /* 对端的re-INVITE与本端的保持同时到达：双方都回491 */
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_REOFFER_GLARE);
+    ASSERT_EQ(trans_stub_inject_peer_offer("INVITE", g_peer_offer_sdp), 0);
+    ASSERT_EQ(lws_agent_hold(agent, dialog), LWS_OK);
+    uint64_t sent_ms = test_now_ms();
+
+    run_agent(agent, 5);
+    ASSERT_EQ(trans_stub_count_sent(491, dialog->call_id), 1);
+    ASSERT_EQ(g_stub_sess_remote_offers, 0);
+    ASSERT_EQ(g_stub_sess_offer_pending, 0);
+
+    /* 等待重试期间不能发起新的offer */
+    ASSERT_EQ(lws_agent_reoffer(agent, dialog, 1), LWS_EBUSY);
+    ASSERT_EQ(trans_stub_count_requests("INVITE"), 1);
+
+    /* 主叫(Call-ID拥有者)在2.1~4秒后重发 */
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_REOFFER_SUCCESS);
+    for (int i = 0; i < 600 && trans_stub_count_requests("INVITE") < 2; i++) {
+        lws_agent_loop(agent, 10);
+        lws_thread_sleep(5);
+    }
+    uint64_t elapsed = test_now_ms() - sent_ms;
+    ASSERT_EQ(trans_stub_count_requests("INVITE"), 2);
+    ASSERT_TRUE(elapsed >= 2100);
+    ASSERT_TRUE(elapsed < 4500);
+
+    run_agent(agent, 20);
+    ASSERT_EQ(g_stub_sess_offer_pending, 0);
+    ASSERT_EQ(g_stub_sess_remote_answers, 1);
+    ASSERT_EQ(g_stub_sess_media_dir, LWS_MEDIA_DIR_SENDONLY);
+
+    lws_agent_destroy(agent);
+    lws_timer_cleanup();
+}
+
+TEST(reoffer_response_after_hangup) {
+    lws_timer_init();
+
+    lws_agent_t* agent = NULL;
+    lws_dialog_t* dialog = reoffer_setup_call(&agent);
+    ASSERT_NOT_NULL(agent);
+    ASSERT_NOT_NULL(dialog);
+
+    /* re-INVITE的响应在挂断之后才到达 */
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_REOFFER_SUCCESS);
+    trans_stub_set_response_delay(50);
+    ASSERT_EQ(lws_agent_hold(agent, dialog), LWS_OK);
+
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_BYE_SUCCESS);
+    ASSERT_EQ(lws_agent_hangup(agent, dialog), LWS_OK);
+    ASSERT_EQ(g_last_dialog_state, LWS_DIALOG_STATE_TERMINATED);
+
+    run_agent(agent, 30);
+    ASSERT_EQ(g_stub_sess_remote_answers, 0);
+
+    trans_stub_set_response_delay(0);
+    lws_agent_destroy(agent);
+    lws_timer_cleanup();
+}
+
+/* ========================================
+ * Trickle ICE tests (RFC 8840)
+ * ======================================== */
+
+extern int g_stub_sess_remote_candidates;
+void stub_sess_emit_candidate(const char* candidate);
+
+TEST(trickle_ice_info) {
+    lws_timer_init();
+
+    reset_mocks();
+    reset_incoming();
+    g_stub_sess_remote_candidates = 0;
+    trans_stub_set_scenario(TRANS_STUB_SCENARIO_INVITE_SUCCESS);
+    trans_stub_set_response_delay(0);
+
+    lws_agent_config_t config;
+    lws_agent_init_default_config(&config, "1001", "secret", "stub.com", NULL);
+    config.auto_register = 0;
+    config.trickle_ice = 1;
+
+    lws_agent_handler_t handler;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_dialog_state_changed = mock_on_dialog_state_changed;
+
+    lws_agent_t* agent = lws_agent_create(&config, &handler);
+    ASSERT_NOT_NULL(agent);
+
+    /* INVITE声明支持trickle-ice，并可接收该Info-Package */
+    lws_dialog_t* dialog = lws_agent_make_call(agent, "sip:1002@stub.com");
+    ASSERT_NOT_NULL(dialog);
+    const char* invite = trans_stub_get_last_request();
+    ASSERT_NOT_NULL(invite);
+    ASSERT_NOT_NULL(strstr(invite, "Supported: trickle-ice"));
+    ASSERT_NOT_NULL(strstr(invite, "Recv-Info: trickle-ice"));
+
+    run_agent(agent, 50);
+    ASSERT_EQ(g_last_dialog_state, LWS_DIALOG_STATE_CONFIRMED);
+
+    /* 本端候选：sdpfrag带ICE凭据、m=行和a=mid */
+    stub_sess_emit_candidate("candidate:1 1 UDP 2130706431 192.0.2.1 8000 typ host");
+    const char* info = trans_stub_get_last_request();
+    ASSERT_NOT_NULL(info);
+    ASSERT_EQ(strncmp(info, "INFO ", 5), 0);
+    ASSERT_NOT_NULL(strstr(info, "a=ice-ufrag:stublocal\r\n"));
+    ASSERT_NOT_NULL(strstr(info, "a=ice-pwd:stublocalpassword012345\r\n"));
+    ASSERT_NOT_NULL(strstr(info, "m=audio 9 RTP/AVP 0 8\r\na=mid:0\r\n"));
+    ASSERT_NOT_NULL(strstr(info, "a=candidate:1 1 UDP 2130706431 192.0.2.1 8000 typ host\r\n"));
+
+    /* 对端候选：ufrag与200 OK中的一致才使用 */
+    ASSERT_EQ(trans_stub_inject_peer_request("INFO", "application/sdpfrag",
+        "a=ice-ufrag:stubpeer\r\n"
+        "a=ice-pwd:stubpeerpassword0123456\r\n"
+        "m=audio 9 RTP/AVP 0 8\r\n"
+        "a=candidate:1 1 UDP 2130706431 192.0.2.2 9000 typ host\r\n"), 0);
+    run_agent(agent, 5);
+    ASSERT_EQ(g_stub_sess_remote_candidates, 1);
+
+    ASSERT_EQ(trans_stub_inject_peer_request("INFO", "application/sdpfrag",
+        "a=ice-ufrag:oldpeer\r\n"
+        "a=ice-pwd:oldpeerpassword012345678\r\n"
+        "m=audio 9 RTP/AVP 0 8\r\n"
+        "a=candidate:2 1 UDP 2130706431 192.0.2.3 9000 typ host\r\n"), 0);
+    ASSERT_EQ(trans_stub_inject_peer_request("INFO", "application/sdpfrag",
+        "a=candidate:3 1 UDP 2130706431 192.0.2.4 9000 typ host\r\n"), 0);
+    run_agent(agent, 5);
+    ASSERT_EQ(g_stub_sess_remote_candidates, 1);
+    ASSERT_EQ(trans_stub_count_sent(200, dialog->call_id), 3);
+
+    lws_agent_destroy(agent);
+    lws_timer_cleanup();
+}
+
 #endif /* !DEBUG_AGENT */
 
 /* ========================================
@@ -674,6 +1247,20 @@ int main(int argc, char* argv[]) {
     run_test_invite_call_busy();
     run_test_invite_call_declined();
     run_test_bye_hangup_success();
+    run_test_message_pipeline();
+
+    /* Deferred incoming-call setup */
+    run_test_invite_incoming_setup_queue();
+    run_test_invite_incoming_setup_failure();
+
+    /* Mid-dialog offers */
+    run_test_reoffer_hold_resume();
+    run_test_reoffer_update_rejected();
+    run_test_reoffer_glare();
+    run_test_reoffer_response_after_hangup();
+
+    /* Trickle ICE */
+    run_test_trickle_ice_info();
 #endif
 
     printf("\n==================================================\n");
@@ -0,0 +1,338 @@
+/**
+ * @file lwsip_apm_test.c
+ * @brief Unit tests for lws_apm.c (echo cancellation, noise suppression, AGC)
+ *
+ * Test coverage:
+ * - Echo of the render stream is cancelled, delay is estimated
+ * - Near-end speech survives double talk
+ * - Stationary noise is attenuated, a tone in noise is kept
+ * - AGC raises quiet input and never clips loud input
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lws_apm.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+
+#define RATE            8000
+#define FRAME_SAMPLES   160     /* 20ms @ 8kHz */
+#define ECHO_DELAY      320     /* 40ms */
+
+/* ========================================
+ * Signal helpers
+ * ======================================== */
+
+static uint32_t g_seed = 12345;
+
+static int noise_sample(int amplitude)
+{
+    g_seed = g_seed * 1103515245u + 12345u;
+    return (int)((g_seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+static double energy(const int16_t* pcm, int samples)
+{
+    double acc = 0.0;
+    int i;
+    for (i = 0; i < samples; i++) {
+        acc += (double)pcm[i] * pcm[i];
+    }
+    return acc;
+}
+
+/* 回声路径：40ms延迟后的三个反射 */
+static int16_t echo_sample(const int16_t* far, int n)
+{
+    int v = 0;
+    if (n >= ECHO_DELAY) v += far[n - ECHO_DELAY] / 2;
+    if (n >= ECHO_DELAY + 5) v -= far[n - ECHO_DELAY - 5] * 3 / 10;
+    if (n >= ECHO_DELAY + 12) v += far[n - ECHO_DELAY - 12] / 5;
+    return (int16_t)v;
+}
+
+/* 语音包络近似：能量起伏的噪声，让延迟估计有可对齐的包络 */
+static int16_t far_sample(int n)
+{
+    int amp = ((n / 400) % 3 == 0) ? 1000 : 8000;
+    return (int16_t)noise_sample(amp);
+}
+
+/* ========================================
+ * Echo canceller
+ * ======================================== */
+
+TEST(aec_cancels_echo)
+{
+    static int16_t far[RATE * 6];
+    int16_t mic[FRAME_SAMPLES];
+    double in = 0.0, out = 0.0;
+    lws_apm_t* apm = lws_apm_create(RATE, FRAME_SAMPLES, LWS_APM_AEC);
+    int frames = RATE * 6 / FRAME_SAMPLES;
+    int f, i;
+
+    ASSERT_TRUE(apm != NULL);
+    ASSERT_EQ(lws_apm_flags(apm), LWS_APM_AEC);
+    ASSERT_EQ(lws_apm_delay_ms(apm), -1);
+
+    for (i = 0; i < RATE * 6; i++) {
+        far[i] = far_sample(i);
+    }
+
+    for (f = 0; f < frames; f++) {
+        int16_t* ref = far + f * FRAME_SAMPLES;
+        for (i = 0; i < FRAME_SAMPLES; i++) {
+            mic[i] = echo_sample(far, f * FRAME_SAMPLES + i);
+        }
+        lws_apm_render(apm, ref, FRAME_SAMPLES);
+
+        /* 最后1秒统计回声抑制量(ERLE) */
+        if (f >= frames - RATE / FRAME_SAMPLES) {
+            in += energy(mic, FRAME_SAMPLES);
+        }
+        lws_apm_capture(apm, mic, FRAME_SAMPLES);
+        if (f >= frames - RATE / FRAME_SAMPLES) {
+            out += energy(mic, FRAME_SAMPLES);
+        }
+    }
+
+    /* 延迟估计在一块(4ms)以内 */
+    ASSERT_TRUE(lws_apm_delay_ms(apm) >= 36 && lws_apm_delay_ms(apm) <= 44);
+    /* ERLE > 20dB */
+    ASSERT_TRUE(out * 100.0 < in);
+
+    lws_apm_destroy(apm);
+}
+
+TEST(aec_double_talk)
+{
+    static int16_t far[RATE * 6];
+    int16_t mic[FRAME_SAMPLES];
+    int16_t near[FRAME_SAMPLES];
+    double near_energy = 0.0, out = 0.0;
+    lws_apm_t* apm = lws_apm_create(RATE, FRAME_SAMPLES, LWS_APM_AEC);
+    int frames = RATE * 6 / FRAME_SAMPLES;
+    int f, i;
+
+    ASSERT_TRUE(apm != NULL);
+    for (i = 0; i < RATE * 6; i++) {
+        far[i] = far_sample(i);
+    }
+
+    /* 前4秒远端单讲收敛，之后近端同时说话 */
+    for (f = 0; f < frames; f++) {
+        int talk = f >= 4 * RATE / FRAME_SAMPLES;
+        for (i = 0; i < FRAME_SAMPLES; i++) {
+            near[i] = talk ? (int16_t)noise_sample(6000) : 0;
+            mic[i] = (int16_t)(echo_sample(far, f * FRAME_SAMPLES + i) + near[i]);
+        }
+        lws_apm_render(apm, far + f * FRAME_SAMPLES, FRAME_SAMPLES);
+        lws_apm_capture(apm, mic, FRAME_SAMPLES);
+
+        if (talk) {
+            double diff = 0.0;
+            for (i = 0; i < FRAME_SAMPLES; i++) {
+                double d = (double)mic[i] - near[i];
+                diff += d * d;
+            }
+            near_energy += energy(near, FRAME_SAMPLES);
+            out += diff;
+        }
+    }
+
+    /* 输出与近端语音的差（残留回声+失真）比近端低6dB以上 */
+    ASSERT_TRUE(out * 4.0 < near_energy);
+
+    lws_apm_destroy(apm);
+}
+
+/* ========================================
+ * Noise suppressor
+ * ======================================== */
+
+TEST(ns_attenuates_noise)
+{
+    int16_t pcm[FRAME_SAMPLES];
+    double in = 0.0, out = 0.0;
+    lws_apm_t* apm = lws_apm_create(RATE, FRAME_SAMPLES, LWS_APM_NS);
+    int f, i;
+
+    ASSERT_TRUE(apm != NULL);
+    ASSERT_EQ(lws_apm_flags(apm), LWS_APM_NS);
+
+    for (f = 0; f < 150; f++) {
+        for (i = 0; i < FRAME_SAMPLES; i++) {
+            pcm[i] = (int16_t)noise_sample(1000);
+        }
+        if (f >= 100) {
+            in += energy(pcm, FRAME_SAMPLES);
+        }
+        lws_apm_capture(apm, pcm, FRAME_SAMPLES);
+        if (f >= 100) {
+            out += energy(pcm, FRAME_SAMPLES);
+        }
+    }
+
+    /* 平稳噪声衰减10dB以上 */
+    ASSERT_TRUE(out * 10.0 < in);
+
+    lws_apm_destroy(apm);
+}
+
+TEST(ns_keeps_tone)
+{
+    int16_t pcm[FRAME_SAMPLES];
+    double tone = 0.0, out = 0.0;
+    double s1 = 0.0, s2 = 0.0;
+    const double c2 = 2.0 * 0.92387953251;  /* 2*cos(2*pi*500/8000) */
+    lws_apm_t* apm = lws_apm_create(RATE, FRAME_SAMPLES, LWS_APM_NS);
+    int f, i;
+
+    ASSERT_TRUE(apm != NULL);
+
+    /* 先学习噪声，再叠加500Hz正弦 */
+    s1 = 8000.0 * 0.38268343236;            /* sin(2*pi*500/8000) */
+    for (f = 0; f < 150; f++) {
+        for (i = 0; i < FRAME_SAMPLES; i++) {
+            int v = noise_sample(500);
+            if (f >= 50) {
+                double s = c2 * s1 - s2;
+                s2 = s1;
+                s1 = s;
+                v += (int)s;
+                if (f >= 100) {
+                    tone += s * s;
+                }
+            }
+            pcm[i] = (int16_t)v;
+        }
+        lws_apm_capture(apm, pcm, FRAME_SAMPLES);
+        if (f >= 100) {
+            out += energy(pcm, FRAME_SAMPLES);
+        }
+    }
+
+    /* 正弦能量基本不变（±1.5dB） */
+    ASSERT_TRUE(out > tone * 0.7 && out < tone * 1.4);
+
+    lws_apm_destroy(apm);
+}
+
+/* ========================================
+ * AGC
+ * ======================================== */
+
+TEST(agc_levels)
+{
+    int16_t pcm[FRAME_SAMPLES];
+    double in = 0.0, out = 0.0;
+    lws_apm_t* apm = lws_apm_create(RATE, FRAME_SAMPLES, LWS_APM_AGC);
+    int peak = 0;
+    int f, i;
+
+    ASSERT_TRUE(apm != NULL);
+
+    /* 小声（约-36dBov）逐渐放大 */
+    for (f = 0; f < 250; f++) {
+        for (i = 0; i < FRAME_SAMPLES; i++) {
+            pcm[i] = (int16_t)noise_sample(900);
+        }
+        if (f >= 200) {
+            in += energy(pcm, FRAME_SAMPLES);
+        }
+        lws_apm_capture(apm, pcm, FRAME_SAMPLES);
+        if (f >= 200) {
+            out += energy(pcm, FRAME_SAMPLES);
+        }
+    }
+    /* 增益上限20dB，应已接近 */
+    ASSERT_TRUE(out > in * 50.0 && out < in * 101.0);
+
+    /* 突然的大声立即压低且不削波 */
+    for (f = 0; f < 50; f++) {
+        for (i = 0; i < FRAME_SAMPLES; i++) {
+            pcm[i] = (int16_t)noise_sample(20000);
+        }
+        lws_apm_capture(apm, pcm, FRAME_SAMPLES);
+        for (i = 0; i < FRAME_SAMPLES; i++) {
+            int a = pcm[i] < 0 ? -pcm[i] : pcm[i];
+            if (a > peak) peak = a;
+        }
+    }
+    ASSERT_TRUE(peak < 32767);
+
+    lws_apm_destroy(apm);
+}
+
+TEST(create_flags)
+{
+    lws_apm_t* apm;
+
+    /* 高采样率下不启用AEC */
+    apm = lws_apm_create(48000, 960, LWS_APM_AEC | LWS_APM_NS);
+    ASSERT_TRUE(apm != NULL);
+    ASSERT_EQ(lws_apm_flags(apm), LWS_APM_NS);
+    lws_apm_destroy(apm);
+
+    ASSERT_TRUE(lws_apm_create(0, 160, LWS_APM_NS) == NULL);
+    ASSERT_TRUE(lws_apm_create(8000, 0, LWS_APM_NS) == NULL);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_apm Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_aec_cancels_echo();
+    run_test_aec_double_talk();
+    run_test_ns_attenuates_noise();
+    run_test_ns_keeps_tone();
+    run_test_agc_levels();
+    run_test_create_flags();
+
+    printf("\n");
+    printf("==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
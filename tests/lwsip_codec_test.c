@@ -0,0 +1,577 @@
+/**
+ * @file lwsip_codec_test.c
+ * @brief Unit tests for lws_codec.c (codec offer/answer negotiation)
+ *
+ * Test coverage:
+ * - Offer generation: preference order, static/dynamic PT allocation,
+ *   telephone-event/CN per audio clock rate, SDP output
+ * - Answer selection against Asterisk/Chrome style offers
+ * - Asymmetric payload type mapping when applying an answer
+ * - H.264 packetization-mode and profile-level-id handling
+ * - RFC 2198 RED per audio codec, answered only for the selected codec
+ * - fmtp parameter lookup
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lws_codec.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+#define ASSERT_STREQ(a, b) ASSERT_TRUE(strcmp((a), (b)) == 0)
+#define ASSERT_NULL(ptr) ASSERT_TRUE((ptr) == NULL)
+#define ASSERT_NOT_NULL(ptr) ASSERT_TRUE((ptr) != NULL)
+
+/**
+ * @brief Parse an SDP and return its first m= section
+ */
+static const lws_sdp_media_t* parse_media(lws_sdp_t* sdp, const char* text)
+{
+    if (lws_sdp_parse(sdp, text, -1) != 0 || sdp->media_count == 0) {
+        return NULL;
+    }
+    return &sdp->media[0];
+}
+
+/* ========================================
+ * Remote SDPs
+ * ======================================== */
+
+/* Asterisk: G.711 + GSM + telephone-event/8000 */
+static const char* SDP_ASTERISK =
+    "v=0\r\n"
+    "o=- 1713245123 1713245124 IN IP4 203.0.113.10\r\n"
+    "s=Asterisk\r\n"
+    "c=IN IP4 203.0.113.10\r\n"
+    "t=0 0\r\n"
+    "m=audio 14568 RTP/AVP 0 8 3 101\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n"
+    "a=rtpmap:8 PCMA/8000\r\n"
+    "a=rtpmap:3 GSM/8000\r\n"
+    "a=rtpmap:101 telephone-event/8000\r\n"
+    "a=fmtp:101 0-16\r\n";
+
+/* Chrome: Opus on 111, telephone-event at both 48 kHz and 8 kHz */
+static const char* SDP_CHROME =
+    "v=0\r\n"
+    "o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+    "s=-\r\n"
+    "t=0 0\r\n"
+    "m=audio 9 UDP/TLS/RTP/SAVPF 111 63 9 0 8 13 110 126\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "a=rtpmap:111 opus/48000/2\r\n"
+    "a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+    "a=rtpmap:63 red/48000/2\r\n"
+    "a=rtpmap:9 G722/8000\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n"
+    "a=rtpmap:8 PCMA/8000\r\n"
+    "a=rtpmap:13 CN/8000\r\n"
+    "a=rtpmap:110 telephone-event/48000\r\n"
+    "a=rtpmap:126 telephone-event/8000\r\n";
+
+/* ========================================
+ * Offer
+ * ======================================== */
+
+TEST(codec_offer_default)
+{
+    lws_rtp_payload_t prefs[] = { LWS_RTP_PAYLOAD_PCMA, LWS_RTP_PAYLOAD_PCMU, LWS_RTP_PAYLOAD_G722 };
+    lws_codec_table_t t;
+    char buf[512];
+
+    ASSERT_EQ(lws_codec_offer(&t, prefs, 3, 1), 4);
+    ASSERT_EQ(t.entries[0].codec, LWS_RTP_PAYLOAD_PCMA);
+    ASSERT_EQ(t.entries[0].recv_pt, 8);
+    ASSERT_EQ(t.entries[1].recv_pt, 0);
+    ASSERT_EQ(t.entries[2].recv_pt, 9);
+    ASSERT_EQ(t.entries[3].codec, LWS_RTP_PAYLOAD_TELEPHONE_EVENT);
+    ASSERT_EQ(t.entries[3].recv_pt, 101);
+    ASSERT_EQ(t.entries[3].clock_rate, 8000);
+    ASSERT_EQ(lws_codec_primary(&t), &t.entries[0]);
+
+    ASSERT_TRUE(lws_codec_write_sdp(&t, "audio", 4000, "RTP/AVP", buf, sizeof(buf)) > 0);
+    ASSERT_STREQ(buf,
+        "m=audio 4000 RTP/AVP 8 0 9 101\r\n"
+        "a=rtpmap:8 PCMA/8000\r\n"
+        "a=rtpmap:0 PCMU/8000\r\n"
+        "a=rtpmap:9 G722/8000\r\n"
+        "a=rtpmap:101 telephone-event/8000\r\n"
+        "a=fmtp:101 0-16\r\n");
+
+    /* 缓冲区不足 */
+    ASSERT_EQ(lws_codec_write_sdp(&t, "audio", 4000, "RTP/AVP", buf, 40), -1);
+
+    /* 不发telephone-event */
+    ASSERT_EQ(lws_codec_offer(&t, prefs, 3, 0), 3);
+    ASSERT_NULL(lws_codec_find(&t, LWS_RTP_PAYLOAD_TELEPHONE_EVENT, 0));
+}
+
+TEST(codec_offer_dynamic_pt)
+{
+    lws_rtp_payload_t prefs[] = {
+        LWS_RTP_PAYLOAD_OPUS, LWS_RTP_PAYLOAD_PCMU, LWS_RTP_PAYLOAD_OPUS,
+        LWS_RTP_PAYLOAD_TELEPHONE_EVENT, (lws_rtp_payload_t)42
+    };
+    lws_codec_table_t t;
+    const lws_sess_codec_t* te48;
+    const lws_sess_codec_t* te8;
+    char buf[512];
+
+    /* 重复、未知和辅助格式被忽略；每个时钟频率一个telephone-event */
+    ASSERT_EQ(lws_codec_offer(&t, prefs, 5, 1), 4);
+    ASSERT_EQ(t.entries[0].codec, LWS_RTP_PAYLOAD_OPUS);
+    ASSERT_EQ(t.entries[0].recv_pt, 96);
+    ASSERT_EQ(t.entries[1].recv_pt, 0);
+
+    te48 = lws_codec_find(&t, LWS_RTP_PAYLOAD_TELEPHONE_EVENT, 48000);
+    te8 = lws_codec_find(&t, LWS_RTP_PAYLOAD_TELEPHONE_EVENT, 8000);
+    ASSERT_NOT_NULL(te48);
+    ASSERT_NOT_NULL(te8);
+    ASSERT_EQ(te48->recv_pt, 101);
+    ASSERT_EQ(te8->recv_pt, 97);
+
+    ASSERT_TRUE(lws_codec_write_sdp(&t, "audio", 4000, "RTP/AVP", buf, sizeof(buf)) > 0);
+    ASSERT_NOT_NULL(strstr(buf, "m=audio 4000 RTP/AVP 96 0 101 97\r\n"));
+    ASSERT_NOT_NULL(strstr(buf, "a=rtpmap:96 opus/48000/2\r\n"));
+    ASSERT_NOT_NULL(strstr(buf, "a=fmtp:96 minptime=10;useinbandfec=1\r\n"));
+    ASSERT_NOT_NULL(strstr(buf, "a=rtpmap:97 telephone-event/8000\r\n"));
+
+    /* 没有可用编码 */
+    ASSERT_EQ(lws_codec_offer(&t, prefs + 3, 2, 1), -1);
+}
+
+/* ========================================
+ * Answer
+ * ======================================== */
+
+TEST(codec_answer_preference)
+{
+    lws_rtp_payload_t prefs[] = { LWS_RTP_PAYLOAD_G722, LWS_RTP_PAYLOAD_PCMA, LWS_RTP_PAYLOAD_PCMU };
+    lws_codec_table_t t;
+    lws_sdp_t sdp;
+    const lws_sdp_media_t* m = parse_media(&sdp, SDP_ASTERISK);
+
+    ASSERT_NOT_NULL(m);
+
+    /* 本端优先级：G722未提供，选PCMA；telephone-event同为8kHz */
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 3, 1, m), 2);
+    ASSERT_EQ(t.entries[0].codec, LWS_RTP_PAYLOAD_PCMA);
+    ASSERT_EQ(t.entries[0].send_pt, 8);
+    ASSERT_EQ(t.entries[0].recv_pt, 8);
+    ASSERT_EQ(t.entries[1].codec, LWS_RTP_PAYLOAD_TELEPHONE_EVENT);
+    ASSERT_EQ(t.entries[1].recv_pt, 101);
+    ASSERT_STREQ(t.entries[1].fmtp, "0-16");
+
+    /* 未启用telephone-event */
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 3, 0, m), 1);
+
+    /* 无共同编码 */
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 1, 1, m), -1);
+}
+
+TEST(codec_answer_opus_chrome)
+{
+    lws_rtp_payload_t prefs[] = { LWS_RTP_PAYLOAD_OPUS, LWS_RTP_PAYLOAD_PCMU };
+    lws_rtp_payload_t g711[] = { LWS_RTP_PAYLOAD_PCMU };
+    lws_codec_table_t t;
+    lws_sdp_t sdp;
+    const lws_sdp_media_t* m = parse_media(&sdp, SDP_CHROME);
+    char buf[512];
+
+    ASSERT_NOT_NULL(m);
+
+    /* Opus沿用对端PT 111，telephone-event取48kHz的110 */
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 2, 1, m), 2);
+    ASSERT_EQ(t.entries[0].codec, LWS_RTP_PAYLOAD_OPUS);
+    ASSERT_EQ(t.entries[0].send_pt, 111);
+    ASSERT_EQ(t.entries[0].recv_pt, 111);
+    ASSERT_EQ(t.entries[1].recv_pt, 110);
+    ASSERT_EQ(t.entries[1].clock_rate, 48000);
+
+    ASSERT_TRUE(lws_codec_write_sdp(&t, "audio", 5000, "RTP/AVP", buf, sizeof(buf)) > 0);
+    ASSERT_STREQ(buf,
+        "m=audio 5000 RTP/AVP 111 110\r\n"
+        "a=rtpmap:111 opus/48000/2\r\n"
+        "a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+        "a=rtpmap:110 telephone-event/48000\r\n");
+
+    /* 仅G.711时选8kHz的telephone-event */
+    ASSERT_EQ(lws_codec_answer(&t, g711, 1, 1, m), 2);
+    ASSERT_EQ(t.entries[0].recv_pt, 0);
+    ASSERT_EQ(t.entries[1].recv_pt, 126);
+    ASSERT_EQ(t.entries[1].clock_rate, 8000);
+}
+
+TEST(codec_comfort_noise)
+{
+    lws_rtp_payload_t prefs[] = { LWS_RTP_PAYLOAD_OPUS, LWS_RTP_PAYLOAD_PCMU };
+    lws_rtp_payload_t g711[] = { LWS_RTP_PAYLOAD_PCMU };
+    lws_codec_table_t t;
+    lws_sdp_t sdp;
+    const lws_sdp_media_t* m;
+    char buf[512];
+
+    /* offer：8kHz使用静态PT 13，48kHz动态分配 */
+    ASSERT_EQ(lws_codec_offer(&t, prefs, 2, LWS_CODEC_AUX_TE | LWS_CODEC_AUX_CN), 6);
+    ASSERT_TRUE(lws_codec_write_sdp(&t, "audio", 4000, "RTP/AVP", buf, sizeof(buf)) > 0);
+    ASSERT_NOT_NULL(strstr(buf, "m=audio 4000 RTP/AVP 96 0 101 97 98 13\r\n"));
+    ASSERT_NOT_NULL(strstr(buf, "a=rtpmap:98 CN/48000\r\n"));
+    ASSERT_NOT_NULL(strstr(buf, "a=rtpmap:13 CN/8000\r\n"));
+    ASSERT_EQ(lws_codec_find(&t, LWS_RTP_PAYLOAD_CN, 8000)->recv_pt, 13);
+
+    /* answer：只接受与所选编码同时钟频率的CN */
+    m = parse_media(&sdp, SDP_CHROME);
+    ASSERT_NOT_NULL(m);
+    ASSERT_EQ(lws_codec_answer(&t, g711, 1, LWS_CODEC_AUX_TE | LWS_CODEC_AUX_CN, m), 3);
+    ASSERT_EQ(t.entries[2].codec, LWS_RTP_PAYLOAD_CN);
+    ASSERT_EQ(t.entries[2].recv_pt, 13);
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 2, LWS_CODEC_AUX_CN, m), 1);
+
+    /* 静态PT 13可省略rtpmap */
+    m = parse_media(&sdp,
+        "v=0\r\no=- 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 0 13\r\n");
+    ASSERT_EQ(lws_codec_answer(&t, g711, 1, LWS_CODEC_AUX_CN, m), 2);
+    ASSERT_EQ(t.entries[1].clock_rate, 8000);
+}
+
+/* ========================================
+ * Applying an answer
+ * ======================================== */
+
+TEST(codec_apply_answer_asymmetric)
+{
+    lws_rtp_payload_t prefs[] = { LWS_RTP_PAYLOAD_OPUS, LWS_RTP_PAYLOAD_PCMU };
+    lws_codec_table_t t;
+    lws_codec_table_t saved;
+    lws_sdp_t sdp;
+    const lws_sdp_media_t* m;
+
+    ASSERT_EQ(lws_codec_offer(&t, prefs, 2, 1), 4);
+
+    /* 对端以自己的动态PT应答：按111/101发送，仍按96/101接收 */
+    m = parse_media(&sdp,
+        "v=0\r\no=peer 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 111 101\r\n"
+        "a=rtpmap:111 OPUS/48000/2\r\n"
+        "a=rtpmap:101 telephone-event/48000\r\n");
+    ASSERT_NOT_NULL(m);
+    ASSERT_EQ(lws_codec_apply_answer(&t, m), 2);
+    ASSERT_EQ(t.entries[0].codec, LWS_RTP_PAYLOAD_OPUS);
+    ASSERT_EQ(t.entries[0].send_pt, 111);
+    ASSERT_EQ(t.entries[0].recv_pt, 96);
+    ASSERT_EQ(t.entries[1].codec, LWS_RTP_PAYLOAD_TELEPHONE_EVENT);
+    ASSERT_EQ(t.entries[1].clock_rate, 48000);
+    ASSERT_EQ(t.entries[1].send_pt, 101);
+    ASSERT_EQ(t.entries[1].recv_pt, 101);
+
+    /* 应答顺序决定优先级；telephone-event/8000的PT与本端不同 */
+    ASSERT_EQ(lws_codec_offer(&t, prefs, 2, 1), 4);
+    m = parse_media(&sdp,
+        "v=0\r\no=peer 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 0 96 100\r\n"
+        "a=rtpmap:96 opus/48000/2\r\n"
+        "a=rtpmap:100 telephone-event/8000\r\n");
+    ASSERT_EQ(lws_codec_apply_answer(&t, m), 3);
+    ASSERT_EQ(lws_codec_primary(&t)->codec, LWS_RTP_PAYLOAD_PCMU);
+    ASSERT_EQ(t.entries[2].send_pt, 100);
+    ASSERT_EQ(t.entries[2].recv_pt, 97);
+
+    /* 应答中没有主编码：表保持不变 */
+    saved = t;
+    m = parse_media(&sdp,
+        "v=0\r\no=peer 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 100 18\r\n"
+        "a=rtpmap:100 telephone-event/8000\r\n");
+    ASSERT_EQ(lws_codec_apply_answer(&t, m), -1);
+    ASSERT_EQ(memcmp(&t, &saved, sizeof(t)), 0);
+}
+
+/* ========================================
+ * H.264
+ * ======================================== */
+
+TEST(codec_h264_params)
+{
+    lws_rtp_payload_t prefs[] = { LWS_RTP_PAYLOAD_H264 };
+    lws_codec_table_t t;
+    lws_sdp_t sdp;
+    const lws_sdp_media_t* m;
+
+    /* High profile不支持，选择mode 1的Constrained Baseline，level取较小值 */
+    m = parse_media(&sdp,
+        "v=0\r\no=- 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=video 4002 RTP/AVP 100 102 104\r\n"
+        "a=rtpmap:100 H264/90000\r\n"
+        "a=fmtp:100 profile-level-id=640032;packetization-mode=1\r\n"
+        "a=rtpmap:102 H264/90000\r\n"
+        "a=fmtp:102 level-asymmetry-allowed=1; packetization-mode=1; profile-level-id=42e034\r\n"
+        "a=rtpmap:104 H264/90000\r\n"
+        "a=fmtp:104 profile-level-id=42e01f\r\n");
+    ASSERT_NOT_NULL(m);
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 1, 1, m), 1);
+    ASSERT_EQ(t.entries[0].recv_pt, 102);
+    ASSERT_STREQ(t.entries[0].fmtp, "profile-level-id=42e01f;packetization-mode=1");
+
+    /* Main profile + constraint_set1，level 1.3 */
+    m = parse_media(&sdp,
+        "v=0\r\no=- 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=video 4002 RTP/AVP 97\r\n"
+        "a=rtpmap:97 H264/90000\r\n"
+        "a=fmtp:97 profile-level-id=4D400D\r\n");
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 1, 1, m), 1);
+    ASSERT_STREQ(t.entries[0].fmtp, "profile-level-id=4d400d;packetization-mode=0");
+
+    /* 本端offer为mode 1，对端以mode 0应答不匹配 */
+    ASSERT_EQ(lws_codec_offer(&t, prefs, 1, 1), 1);
+    ASSERT_EQ(t.entries[0].recv_pt, 97);
+    m = parse_media(&sdp,
+        "v=0\r\no=- 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=video 4002 RTP/AVP 126\r\n"
+        "a=rtpmap:126 H264/90000\r\n"
+        "a=fmtp:126 profile-level-id=42e01f\r\n");
+    ASSERT_EQ(lws_codec_apply_answer(&t, m), -1);
+    m = parse_media(&sdp,
+        "v=0\r\no=- 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=video 4002 RTP/AVP 126\r\n"
+        "a=rtpmap:126 H264/90000\r\n"
+        "a=fmtp:126 profile-level-id=42e01f;packetization-mode=1\r\n");
+    ASSERT_EQ(lws_codec_apply_answer(&t, m), 1);
+    ASSERT_EQ(t.entries[0].send_pt, 126);
+    ASSERT_EQ(t.entries[0].recv_pt, 97);
+}
+
+TEST(codec_h264_rtx)
+{
+    lws_rtp_payload_t prefs[] = { LWS_RTP_PAYLOAD_H264 };
+    lws_codec_table_t t;
+    lws_sdp_t sdp;
+    const lws_sdp_media_t* m;
+    char buf[512];
+
+    /* offer：每个视频编码一个RTX，apt指向其PT */
+    ASSERT_EQ(lws_codec_offer(&t, prefs, 1, LWS_CODEC_AUX_RTX), 2);
+    ASSERT_EQ(lws_codec_primary(&t)->codec, LWS_RTP_PAYLOAD_H264);
+    ASSERT_EQ(t.entries[1].codec, LWS_RTP_PAYLOAD_RTX);
+    ASSERT_EQ(t.entries[1].recv_pt, 102);
+    ASSERT_STREQ(t.entries[1].fmtp, "apt=97");
+    ASSERT_TRUE(lws_codec_write_sdp(&t, "video", 5004, "RTP/AVP", buf, sizeof(buf)) > 0);
+    ASSERT_TRUE(strstr(buf, "m=video 5004 RTP/AVP 97 102\r\n") != NULL);
+    ASSERT_TRUE(strstr(buf, "a=rtpmap:102 rtx/90000\r\na=fmtp:102 apt=97\r\n") != NULL);
+
+    /* 对端以自己的PT应答：RTX按对端PT发送 */
+    m = parse_media(&sdp,
+        "v=0\r\no=- 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=video 4002 RTP/AVP 126 127\r\n"
+        "a=rtpmap:126 H264/90000\r\n"
+        "a=fmtp:126 profile-level-id=42e01f;packetization-mode=1\r\n"
+        "a=rtpmap:127 rtx/90000\r\n"
+        "a=fmtp:127 apt=126\r\n");
+    ASSERT_EQ(lws_codec_apply_answer(&t, m), 2);
+    ASSERT_EQ(lws_codec_find(&t, LWS_RTP_PAYLOAD_RTX, 0)->send_pt, 127);
+    ASSERT_EQ(lws_codec_find(&t, LWS_RTP_PAYLOAD_RTX, 0)->recv_pt, 102);
+
+    /* answer：只接受重传所选编码的RTX */
+    m = parse_media(&sdp,
+        "v=0\r\no=- 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=video 4002 RTP/AVP 96 97 102 103\r\n"
+        "a=rtpmap:96 VP8/90000\r\n"
+        "a=rtpmap:97 rtx/90000\r\n"
+        "a=fmtp:97 apt=96\r\n"
+        "a=rtpmap:102 H264/90000\r\n"
+        "a=fmtp:102 packetization-mode=1;profile-level-id=42001f\r\n"
+        "a=rtpmap:103 rtx/90000\r\n"
+        "a=fmtp:103 apt=102\r\n");
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 1, LWS_CODEC_AUX_RTX, m), 2);
+    ASSERT_EQ(t.entries[0].recv_pt, 102);
+    ASSERT_EQ(t.entries[1].recv_pt, 103);
+    ASSERT_STREQ(t.entries[1].fmtp, "apt=102");
+
+    /* 未请求RTX时不应答 */
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 1, 0, m), 1);
+}
+
+TEST(codec_red)
+{
+    lws_rtp_payload_t prefs[] = { LWS_RTP_PAYLOAD_OPUS, LWS_RTP_PAYLOAD_PCMU };
+    lws_rtp_payload_t g711[] = { LWS_RTP_PAYLOAD_PCMU };
+    lws_codec_table_t t;
+    lws_sdp_t sdp;
+    const lws_sdp_media_t* m;
+    const lws_sess_codec_t* red;
+    char buf[768];
+
+    /* offer：每个音频编码一个RED，排在telephone-event之后，fmtp指向其PT */
+    ASSERT_EQ(lws_codec_offer(&t, prefs, 2, LWS_CODEC_AUX_TE | LWS_CODEC_AUX_RED), 6);
+    ASSERT_TRUE(lws_codec_write_sdp(&t, "audio", 4000, "RTP/AVP", buf, sizeof(buf)) > 0);
+    ASSERT_NOT_NULL(strstr(buf, "m=audio 4000 RTP/AVP 96 0 101 97 103 98\r\n"));
+    ASSERT_NOT_NULL(strstr(buf, "a=rtpmap:103 red/48000/2\r\na=fmtp:103 96/96\r\n"));
+    ASSERT_NOT_NULL(strstr(buf, "a=rtpmap:98 red/8000\r\na=fmtp:98 0/0\r\n"));
+    ASSERT_EQ(lws_codec_red(&t, &t.entries[1])->recv_pt, 98);
+    ASSERT_EQ(lws_codec_primary(&t)->codec, LWS_RTP_PAYLOAD_OPUS);
+
+    /* 对端应答PCMU及其RED */
+    m = parse_media(&sdp,
+        "v=0\r\no=- 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 0 98\r\n"
+        "a=rtpmap:98 red/8000\r\n"
+        "a=fmtp:98 0/0\r\n");
+    ASSERT_EQ(lws_codec_apply_answer(&t, m), 2);
+    red = lws_codec_red(&t, lws_codec_primary(&t));
+    ASSERT_NOT_NULL(red);
+    ASSERT_EQ(red->send_pt, 98);
+
+    /* answer：只接受冗余所选编码的RED（WebRTC的red/48000/2） */
+    m = parse_media(&sdp,
+        "v=0\r\no=- 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 9 RTP/AVP 111 63 0\r\n"
+        "a=rtpmap:111 opus/48000/2\r\n"
+        "a=rtpmap:63 red/48000/2\r\n"
+        "a=fmtp:63 111/111\r\n");
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 2, LWS_CODEC_AUX_RED, m), 2);
+    red = lws_codec_red(&t, lws_codec_primary(&t));
+    ASSERT_NOT_NULL(red);
+    ASSERT_EQ(red->recv_pt, 63);
+    ASSERT_EQ(red->channels, 2);
+    ASSERT_STREQ(red->fmtp, "111/111");
+    ASSERT_EQ(lws_codec_answer(&t, g711, 1, LWS_CODEC_AUX_RED, m), 1);
+    ASSERT_NULL(lws_codec_red(&t, lws_codec_primary(&t)));
+
+    /* 未请求RED时不应答 */
+    ASSERT_EQ(lws_codec_answer(&t, prefs, 2, 0, m), 1);
+}
+
+TEST(codec_fmtp_param)
+{
+    const char* text = "minptime=10; useinbandfec = 1;stereo=0;flag";
+    lws_sdp_str_t fmtp = { text, (int)strlen(text) };
+    lws_sdp_str_t v;
+
+    ASSERT_TRUE(lws_codec_fmtp_param(fmtp, "minptime", &v));
+    ASSERT_TRUE(lws_sdp_str_eq(v, "10"));
+    ASSERT_TRUE(lws_codec_fmtp_param(fmtp, "UseInbandFec", &v));
+    ASSERT_TRUE(lws_sdp_str_eq(v, "1"));
+    ASSERT_TRUE(lws_codec_fmtp_param(fmtp, "stereo", &v));
+    ASSERT_TRUE(lws_sdp_str_eq(v, "0"));
+    ASSERT_FALSE(lws_codec_fmtp_param(fmtp, "flag", &v));
+    ASSERT_FALSE(lws_codec_fmtp_param(fmtp, "min", &v));
+}
+
+TEST(codec_ptime)
+{
+    /* 8kHz 16位PCM：每20ms帧320字节 */
+    lws_codec_ptime_policy_t policy = { 20, 320, 40, 1188, 10, 60, 0 };
+
+    /* 对端未声明：每包一帧 */
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_PCMU, &policy, 0, 0), 20);
+
+    /* 自动：头部占比不超过10%的最短ptime，不超过对端maxptime */
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_PCMU, &policy, 0, 150), 40);
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_PCMU, &policy, 0, 30), 20);
+    policy.frame_bytes = 160;
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_PCMA, &policy, 0, 150), 60);
+    policy.max_ptime = 40;
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_PCMA, &policy, 0, 150), 40);
+    policy.max_ptime = 60;
+    policy.frame_bytes = 320;
+
+    /* 对端a=ptime优先于自动选择，无maxptime时也是上限 */
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_PCMU, &policy, 60, 0), 60);
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_PCMU, &policy, 30, 0), 20);
+
+    /* 配置值优先，受对端maxptime与载荷大小限制 */
+    policy.preferred = 60;
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_PCMU, &policy, 20, 40), 40);
+    policy.preferred = 100;
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_PCMU, &policy, 0, 0), 60);
+    policy.frame_bytes = 640;
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_G722, &policy, 0, 120), 20);
+
+    /* 非采样型编码不拼帧 */
+    policy.frame_bytes = 320;
+    ASSERT_EQ(lws_codec_ptime(LWS_RTP_PAYLOAD_OPUS, &policy, 60, 120), 20);
+}
+
+TEST(codec_opus_samples)
+{
+    /* config 1 (SILK 20ms)，code 0：一帧 */
+    uint8_t silk20[] = { (1 << 3) | 0, 0x00 };
+    /* config 15 (Hybrid 20ms)，code 1：两帧 */
+    uint8_t hybrid[] = { (15 << 3) | 1, 0x00 };
+    /* config 16 (CELT 2.5ms)，code 3：6帧 */
+    uint8_t celt[] = { (16 << 3) | 3, 6 };
+    /* config 3 (SILK 60ms)，code 3：3帧 = 180ms，超过120ms */
+    uint8_t too_long[] = { (3 << 3) | 3, 3 };
+    /* code 3缺少帧数字节 */
+    uint8_t truncated[] = { (31 << 3) | 3 };
+
+    ASSERT_EQ(lws_codec_opus_samples(silk20, sizeof(silk20)), 960);
+    ASSERT_EQ(lws_codec_opus_samples(hybrid, sizeof(hybrid)), 1920);
+    ASSERT_EQ(lws_codec_opus_samples(celt, sizeof(celt)), 720);
+    ASSERT_EQ(lws_codec_opus_samples(too_long, sizeof(too_long)), 0);
+    ASSERT_EQ(lws_codec_opus_samples(truncated, sizeof(truncated)), 0);
+    ASSERT_EQ(lws_codec_opus_samples(NULL, 0), 0);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_codec Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_codec_offer_default();
+    run_test_codec_offer_dynamic_pt();
+    run_test_codec_answer_preference();
+    run_test_codec_answer_opus_chrome();
+    run_test_codec_comfort_noise();
+    run_test_codec_apply_answer_asymmetric();
+    run_test_codec_h264_params();
+    run_test_codec_h264_rtx();
+    run_test_codec_red();
+    run_test_codec_ptime();
+    run_test_codec_fmtp_param();
+    run_test_codec_opus_samples();
+
+    printf("\n==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
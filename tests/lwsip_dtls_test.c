@@ -0,0 +1,297 @@
+/**
+ * @file lwsip_dtls_test.c
+ * @brief Unit tests for lws_dtls.c (DTLS-SRTP keying)
+ *
+ * Test coverage:
+ * - Certificate cache: one key/certificate shared until cleanup
+ * - a=fingerprint comparison (hash name and hex case, malformed values)
+ * - In-memory client/server handshake with a lossy first flight
+ * - Exported SRTP keys cross-match and protect/unprotect end to end
+ * - Fingerprint mismatch fails the handshake
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lws_dtls.h"
+#include "lws_srtp.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+
+/* ========================================
+ * In-memory datagram link
+ * ======================================== */
+
+#define LINK_SLOTS      32
+#define STEP_US         10000       /* 10ms per loop iteration */
+
+typedef struct {
+    uint8_t data[LINK_SLOTS][LWS_DTLS_MTU + 64];
+    int bytes[LINK_SLOTS];
+    int count;
+    int drop;                       /* Datagrams still to drop (loss) */
+} link_t;
+
+static int link_send(void* param, const uint8_t* data, int bytes)
+{
+    link_t* link = (link_t*)param;
+
+    if (link->drop > 0) {
+        link->drop--;
+        return 0;
+    }
+    if (link->count >= LINK_SLOTS || bytes > (int)sizeof(link->data[0])) {
+        return -1;
+    }
+    memcpy(link->data[link->count], data, bytes);
+    link->bytes[link->count] = bytes;
+    link->count++;
+    return 0;
+}
+
+static void link_deliver(link_t* link, lws_dtls_t* to, uint64_t now)
+{
+    int i;
+
+    for (i = 0; i < link->count; i++) {
+        lws_dtls_input(to, link->data[i], link->bytes[i], now);
+    }
+    link->count = 0;
+}
+
+/**
+ * @brief Run both ends until neither is handshaking (or 30s simulated time)
+ */
+static void run_handshake(lws_dtls_t* client, link_t* to_server,
+                          lws_dtls_t* server, link_t* to_client)
+{
+    uint64_t now = 1000000;
+    int i;
+
+    for (i = 0; i < 3000; i++) {
+        lws_dtls_poll(client, now);
+        lws_dtls_poll(server, now);
+        link_deliver(to_server, server, now);
+        link_deliver(to_client, client, now);
+        if (lws_dtls_state(client) != LWS_DTLS_HANDSHAKE &&
+            lws_dtls_state(server) != LWS_DTLS_HANDSHAKE) {
+            break;
+        }
+        now += STEP_US;
+    }
+}
+
+/* ========================================
+ * Tests
+ * ======================================== */
+
+TEST(dtls_cert_cache) {
+    lws_dtls_cert_t* a = lws_dtls_cert_acquire();
+    lws_dtls_cert_t* b = lws_dtls_cert_acquire();
+    const char* fp;
+
+    ASSERT_TRUE(a != NULL);
+    ASSERT_TRUE(a == b);
+
+    fp = lws_dtls_cert_fingerprint(a);
+    ASSERT_EQ(strncmp(fp, "sha-256 ", 8), 0);
+    ASSERT_EQ((int)strlen(fp), 8 + 32 * 3 - 1);
+
+    lws_dtls_cert_release(b);
+    lws_dtls_cert_release(a);
+
+    /* cleanup后重新生成 */
+    lws_dtls_cleanup();
+    b = lws_dtls_cert_acquire();
+    ASSERT_TRUE(b != NULL);
+    lws_dtls_cert_release(b);
+}
+
+/**
+ * @brief Build "<hash> XX:XX:..." with count bytes of value, the last one last
+ */
+static void make_fp(char* buf, const char* hash, int count, int value, int last, int upper)
+{
+    int n = sprintf(buf, "%s ", hash);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        n += sprintf(buf + n, upper ? "%02X%s" : "%02x%s", i == count - 1 ? last : value,
+                     i == count - 1 ? "" : ":");
+    }
+}
+
+TEST(dtls_fingerprint_eq) {
+    char a[LWS_DTLS_FINGERPRINT_SIZE + 16];
+    char b[LWS_DTLS_FINGERPRINT_SIZE];
+
+    make_fp(a, "sha-256", 32, 0xab, 0xcd, 1);
+    make_fp(b, "SHA-256", 32, 0xab, 0xcd, 0);
+    ASSERT_TRUE(lws_dtls_fingerprint_eq(a, -1, b, -1));
+
+    /* SDP切片：长度之外的内容忽略 */
+    strcat(a, "\r\na=setup:actpass");
+    ASSERT_TRUE(lws_dtls_fingerprint_eq(a, (int)strlen(b), b, -1));
+    ASSERT_FALSE(lws_dtls_fingerprint_eq(a, -1, b, -1));
+
+    make_fp(a, "sha-256", 32, 0xab, 0xce, 1);
+    ASSERT_FALSE(lws_dtls_fingerprint_eq(a, -1, b, -1));
+
+    /* 哈希名不同、长度不符、缺少摘要 */
+    make_fp(a, "sha-1", 20, 0xab, 0xcd, 1);
+    ASSERT_FALSE(lws_dtls_fingerprint_eq(a, -1, b, -1));
+    make_fp(a, "sha-256", 20, 0xab, 0xcd, 1);
+    ASSERT_FALSE(lws_dtls_fingerprint_eq(a, -1, a, -1));
+    ASSERT_FALSE(lws_dtls_fingerprint_eq("sha-256", -1, "sha-256", -1));
+}
+
+TEST(dtls_handshake_srtp) {
+    lws_dtls_cert_t* cert = lws_dtls_cert_acquire();
+    static link_t to_server;
+    static link_t to_client;
+    lws_dtls_t* client;
+    lws_dtls_t* server;
+    lws_srtp_suite_t csuite;
+    lws_srtp_suite_t ssuite;
+    uint8_t clocal[LWS_SRTP_MAX_MASTER], cremote[LWS_SRTP_MAX_MASTER];
+    uint8_t slocal[LWS_SRTP_MAX_MASTER], sremote[LWS_SRTP_MAX_MASTER];
+    uint8_t pkt[12 + 160 + LWS_SRTP_MAX_TRAILER];
+    lws_srtp_t* tx;
+    lws_srtp_t* rx;
+    int n;
+
+    ASSERT_TRUE(cert != NULL);
+    memset(&to_server, 0, sizeof(to_server));
+    memset(&to_client, 0, sizeof(to_client));
+    to_server.drop = 1;             /* 首个ClientHello丢失，靠重传完成 */
+
+    /* 两端共用缓存证书，指纹即本端证书 */
+    client = lws_dtls_create(cert, LWS_DTLS_CLIENT, lws_dtls_cert_fingerprint(cert), -1,
+                             link_send, &to_server);
+    server = lws_dtls_create(cert, LWS_DTLS_SERVER, lws_dtls_cert_fingerprint(cert), -1,
+                             link_send, &to_client);
+    ASSERT_TRUE(client != NULL && server != NULL);
+    ASSERT_EQ(lws_dtls_role(server), LWS_DTLS_SERVER);
+    ASSERT_EQ(lws_dtls_srtp_keys(client, &csuite, clocal, cremote), -1);
+
+    run_handshake(client, &to_server, server, &to_client);
+    ASSERT_EQ(lws_dtls_state(client), LWS_DTLS_CONNECTED);
+    ASSERT_EQ(lws_dtls_state(server), LWS_DTLS_CONNECTED);
+
+    ASSERT_EQ(lws_dtls_srtp_keys(client, &csuite, clocal, cremote), 0);
+    ASSERT_EQ(lws_dtls_srtp_keys(server, &ssuite, slocal, sremote), 0);
+    ASSERT_EQ(csuite, ssuite);
+    n = lws_srtp_master_len(csuite);
+    ASSERT_EQ(memcmp(clocal, sremote, n), 0);
+    ASSERT_EQ(memcmp(cremote, slocal, n), 0);
+    ASSERT_TRUE(memcmp(clocal, cremote, n) != 0);
+
+    /* client加密的RTP由server解密 */
+    tx = lws_srtp_create(csuite, clocal);
+    rx = lws_srtp_create(ssuite, sremote);
+    ASSERT_TRUE(tx != NULL && rx != NULL);
+    memset(pkt, 0x5a, sizeof(pkt));
+    pkt[0] = 0x80;
+    pkt[1] = 0;
+    n = lws_srtp_protect(tx, pkt, 12 + 160, sizeof(pkt));
+    ASSERT_TRUE(n > 12 + 160);
+    ASSERT_EQ(lws_srtp_unprotect(rx, pkt, n), 12 + 160);
+    ASSERT_EQ(pkt[12], 0x5a);
+    lws_srtp_destroy(tx);
+    lws_srtp_destroy(rx);
+
+    /* close_notify */
+    lws_dtls_destroy(client);
+    link_deliver(&to_server, server, 2000000000ull);
+    ASSERT_EQ(lws_dtls_state(server), LWS_DTLS_CLOSED);
+
+    lws_dtls_destroy(server);
+    lws_dtls_cert_release(cert);
+}
+
+TEST(dtls_fingerprint_mismatch) {
+    lws_dtls_cert_t* cert = lws_dtls_cert_acquire();
+    static link_t to_server;
+    static link_t to_client;
+    char wrong[LWS_DTLS_FINGERPRINT_SIZE];
+    lws_dtls_t* client;
+    lws_dtls_t* server;
+
+    ASSERT_TRUE(cert != NULL);
+    memset(&to_server, 0, sizeof(to_server));
+    memset(&to_client, 0, sizeof(to_client));
+
+    /* 改动指纹最后一位 */
+    strcpy(wrong, lws_dtls_cert_fingerprint(cert));
+    wrong[strlen(wrong) - 1] = wrong[strlen(wrong) - 1] == '0' ? '1' : '0';
+
+    client = lws_dtls_create(cert, LWS_DTLS_CLIENT, wrong, -1, link_send, &to_server);
+    server = lws_dtls_create(cert, LWS_DTLS_SERVER, lws_dtls_cert_fingerprint(cert), -1,
+                             link_send, &to_client);
+    ASSERT_TRUE(client != NULL && server != NULL);
+
+    run_handshake(client, &to_server, server, &to_client);
+    ASSERT_EQ(lws_dtls_state(client), LWS_DTLS_FAILED);
+    ASSERT_TRUE(lws_dtls_state(server) != LWS_DTLS_CONNECTED);
+
+    lws_dtls_destroy(client);
+    lws_dtls_destroy(server);
+    lws_dtls_cert_release(cert);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_dtls Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_dtls_cert_cache();
+    run_test_dtls_fingerprint_eq();
+    run_test_dtls_handshake_srtp();
+    run_test_dtls_fingerprint_mismatch();
+
+    lws_dtls_cleanup();
+
+    printf("\n==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
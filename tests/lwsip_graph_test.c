@@ -0,0 +1,438 @@
+/**
+ * @file lwsip_graph_test.c
+ * @brief Unit tests for lws_graph.c (media processing graph)
+ *
+ * Test coverage:
+ * - Frame reference counting, writability and copies
+ * - Filters modify unshared frames in place (no copy along a chain)
+ * - Fan-out hands the same frame to every output; shared frames are copied
+ *   before modification
+ * - Link rules: cycles, sink/source direction, output limit, unlink, find
+ * - Per-node CPU time excludes the time spent downstream
+ * - lws_graph_build: filters chained in order, sinks on the last filter
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "lws_graph.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+#define ASSERT_NULL(p) ASSERT_TRUE((p) == NULL)
+#define ASSERT_NOT_NULL(p) ASSERT_TRUE((p) != NULL)
+
+#define FRAME_SAMPLES   160
+
+/* ========================================
+ * Test nodes
+ * ======================================== */
+
+/* 记录收到的帧 */
+typedef struct {
+    lws_frame_t* seen[8];
+    int16_t first[8];               /* 收到时的第一个采样 */
+    int count;
+    lws_frame_t* kept;              /* 保留引用（模拟异步录音） */
+    int keep;
+    int sleep_us;
+} sink_ctx_t;
+
+static int sink_process(void* ctx, lws_graph_node_t* node, lws_frame_t* frame)
+{
+    sink_ctx_t* sink = (sink_ctx_t*)ctx;
+    (void)node;
+
+    if (sink->count < 8) {
+        sink->seen[sink->count] = frame;
+        sink->first[sink->count] = ((int16_t*)frame->data)[0];
+    }
+    sink->count++;
+    if (sink->keep && !sink->kept) {
+        sink->kept = lws_frame_ref(frame);
+    }
+    if (sink->sleep_us > 0) {
+        usleep(sink->sleep_us);
+    }
+    return 0;
+}
+
+/* 每个采样加1，不共享时原地修改 */
+typedef struct {
+    int copies;
+    int sleep_us;
+} gain_ctx_t;
+
+static int gain_process(void* ctx, lws_graph_node_t* node, lws_frame_t* frame)
+{
+    gain_ctx_t* gain = (gain_ctx_t*)ctx;
+    lws_frame_t* out = lws_frame_writable(frame) ? frame : lws_frame_copy(frame);
+    int16_t* pcm;
+    int i;
+
+    if (!out) {
+        return -1;
+    }
+    if (out != frame) {
+        gain->copies++;
+    }
+    pcm = (int16_t*)out->data;
+    for (i = 0; i < out->samples; i++) {
+        pcm[i]++;
+    }
+    if (gain->sleep_us > 0) {
+        usleep(gain->sleep_us);
+    }
+    lws_graph_emit(node, out);
+    if (out != frame) {
+        lws_frame_unref(out);
+    }
+    return 0;
+}
+
+static int fail_process(void* ctx, lws_graph_node_t* node, lws_frame_t* frame)
+{
+    (void)ctx;
+    (void)node;
+    (void)frame;
+    return -1;
+}
+
+static const lws_node_ops_t s_source = { "src", LWS_NODE_SOURCE, NULL, NULL };
+static const lws_node_ops_t s_sink = { "sink", LWS_NODE_SINK, sink_process, NULL };
+static const lws_node_ops_t s_tap = { "tap", LWS_NODE_SINK, sink_process, NULL };
+static const lws_node_ops_t s_gain = { "gain", LWS_NODE_FILTER, gain_process, NULL };
+static const lws_node_ops_t s_fail = { "fail", LWS_NODE_FILTER, fail_process, NULL };
+
+static lws_frame_t* make_frame(int16_t value)
+{
+    lws_frame_t* frame = lws_frame_alloc(FRAME_SAMPLES * 2);
+    int i;
+
+    if (!frame) {
+        return NULL;
+    }
+    frame->kind = LWS_FRAME_AUDIO;
+    frame->size = FRAME_SAMPLES * 2;
+    frame->samples = FRAME_SAMPLES;
+    frame->sample_rate = 8000;
+    frame->channels = 1;
+    frame->timestamp = 1600;
+    for (i = 0; i < FRAME_SAMPLES; i++) {
+        ((int16_t*)frame->data)[i] = value;
+    }
+    return frame;
+}
+
+static uint64_t wall_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+}
+
+/* ========================================
+ * Tests
+ * ======================================== */
+
+TEST(frame_refcount)
+{
+    lws_frame_t* frame = make_frame(7);
+    lws_frame_t* copy;
+
+    ASSERT_NOT_NULL(frame);
+    ASSERT_EQ(frame->refcount, 1);
+    ASSERT_TRUE(lws_frame_writable(frame));
+
+    ASSERT_TRUE(lws_frame_ref(frame) == frame);
+    ASSERT_FALSE(lws_frame_writable(frame));
+
+    copy = lws_frame_copy(frame);
+    ASSERT_NOT_NULL(copy);
+    ASSERT_TRUE(copy->data != frame->data);
+    ASSERT_TRUE(lws_frame_writable(copy));
+    ASSERT_EQ(copy->samples, FRAME_SAMPLES);
+    ASSERT_EQ(copy->timestamp, 1600u);
+    ASSERT_EQ(memcmp(copy->data, frame->data, frame->size), 0);
+
+    lws_frame_unref(frame);
+    ASSERT_TRUE(lws_frame_writable(frame));
+    lws_frame_unref(frame);
+    lws_frame_unref(copy);
+    lws_frame_unref(NULL);
+}
+
+TEST(graph_chain_in_place)
+{
+    lws_graph_t* graph = lws_graph_create();
+    gain_ctx_t gain = { 0, 0 };
+    sink_ctx_t sink;
+    lws_graph_node_t *src, *g1, *g2, *out;
+    lws_frame_t* frame;
+
+    memset(&sink, 0, sizeof(sink));
+    ASSERT_NOT_NULL(graph);
+    src = lws_graph_add(graph, &s_source, NULL);
+    g1 = lws_graph_add(graph, &s_gain, &gain);
+    g2 = lws_graph_add(graph, &s_gain, &gain);
+    out = lws_graph_add(graph, &s_sink, &sink);
+    ASSERT_EQ(lws_graph_link(src, g1), 0);
+    ASSERT_EQ(lws_graph_link(g1, g2), 0);
+    ASSERT_EQ(lws_graph_link(g2, out), 0);
+
+    /* 链路上只有一个持有者：两个filter都原地修改，sink收到同一帧 */
+    frame = make_frame(10);
+    ASSERT_EQ(lws_graph_emit(src, frame), 1);
+    ASSERT_EQ(gain.copies, 0);
+    ASSERT_EQ(sink.count, 1);
+    ASSERT_TRUE(sink.seen[0] == frame);
+    ASSERT_EQ(sink.first[0], 12);
+    lws_frame_unref(frame);
+
+    lws_graph_destroy(graph);
+}
+
+TEST(graph_fanout_shares_frames)
+{
+    lws_graph_t* graph = lws_graph_create();
+    gain_ctx_t gain = { 0, 0 };
+    sink_ctx_t tap, sink;
+    lws_graph_node_t *src, *g, *t, *out;
+    lws_frame_t* frame;
+
+    memset(&tap, 0, sizeof(tap));
+    memset(&sink, 0, sizeof(sink));
+    ASSERT_NOT_NULL(graph);
+
+    /* src → gain → sink，src → tap：gain先收到，帧仍被tap共享，须复制 */
+    src = lws_graph_add(graph, &s_source, NULL);
+    g = lws_graph_add(graph, &s_gain, &gain);
+    out = lws_graph_add(graph, &s_sink, &sink);
+    t = lws_graph_add(graph, &s_tap, &tap);
+    ASSERT_EQ(lws_graph_link(src, g), 0);
+    ASSERT_EQ(lws_graph_link(g, out), 0);
+    ASSERT_EQ(lws_graph_link(src, t), 0);
+
+    frame = make_frame(10);
+    ASSERT_EQ(lws_graph_emit(src, frame), 2);
+    ASSERT_EQ(gain.copies, 1);
+    ASSERT_EQ(sink.first[0], 11);
+    ASSERT_TRUE(tap.seen[0] == frame);      /* 扇出不复制 */
+    ASSERT_EQ(tap.first[0], 10);
+    ASSERT_EQ(frame->refcount, 1);
+    lws_frame_unref(frame);
+
+    /* 顺序反过来：tap在前且保留引用，gain是最后一个下游但仍须复制 */
+    ASSERT_EQ(lws_graph_unlink(src, g), 0);
+    ASSERT_EQ(lws_graph_link(src, g), 0);
+    tap.keep = 1;
+    frame = make_frame(20);
+    ASSERT_EQ(lws_graph_emit(src, frame), 2);
+    ASSERT_EQ(gain.copies, 2);
+    ASSERT_TRUE(tap.kept == frame);
+    ASSERT_EQ(((int16_t*)tap.kept->data)[0], 20);
+    lws_frame_unref(frame);
+    ASSERT_TRUE(lws_frame_writable(tap.kept));
+    lws_frame_unref(tap.kept);
+
+    /* tap不保留：最后一个下游独占，原地修改 */
+    tap.keep = 0;
+    tap.kept = NULL;
+    frame = make_frame(30);
+    lws_graph_emit(src, frame);
+    ASSERT_EQ(gain.copies, 2);
+    ASSERT_EQ(((int16_t*)frame->data)[0], 31);
+    lws_frame_unref(frame);
+
+    lws_graph_destroy(graph);
+}
+
+TEST(graph_link_rules)
+{
+    lws_graph_t* graph = lws_graph_create();
+    lws_graph_t* other = lws_graph_create();
+    gain_ctx_t gain = { 0, 0 };
+    sink_ctx_t sink;
+    lws_graph_node_t *src, *a, *b, *out, *foreign;
+    lws_node_ops_t no_process = { "bad", LWS_NODE_FILTER, NULL, NULL };
+    int i;
+
+    memset(&sink, 0, sizeof(sink));
+    ASSERT_NOT_NULL(graph);
+    ASSERT_NOT_NULL(other);
+    src = lws_graph_add(graph, &s_source, NULL);
+    a = lws_graph_add(graph, &s_gain, &gain);
+    b = lws_graph_add(graph, &s_gain, &gain);
+    out = lws_graph_add(graph, &s_sink, &sink);
+    foreign = lws_graph_add(other, &s_sink, &sink);
+    ASSERT_NULL(lws_graph_add(graph, &no_process, NULL));
+
+    ASSERT_EQ(lws_graph_link(src, a), 0);
+    ASSERT_EQ(lws_graph_link(a, b), 0);
+    ASSERT_EQ(lws_graph_link(a, b), -1);        /* 已连接 */
+    ASSERT_EQ(lws_graph_link(b, a), -1);        /* 环 */
+    ASSERT_EQ(lws_graph_link(a, a), -1);
+    ASSERT_EQ(lws_graph_link(out, a), -1);      /* sink无输出 */
+    ASSERT_EQ(lws_graph_link(a, src), -1);      /* source无输入 */
+    ASSERT_EQ(lws_graph_link(b, foreign), -1);  /* 不同的图 */
+    ASSERT_EQ(lws_graph_link(b, out), 0);
+
+    for (i = 1; i < LWS_GRAPH_MAX_OUTPUTS; i++) {
+        ASSERT_EQ(lws_graph_link(src, lws_graph_add(graph, &s_tap, &sink)), 0);
+    }
+    ASSERT_EQ(lws_graph_link(src, lws_graph_add(graph, &s_tap, &sink)), -1);
+
+    ASSERT_EQ(lws_graph_unlink(b, out), 0);
+    ASSERT_EQ(lws_graph_unlink(b, out), -1);
+    ASSERT_TRUE(lws_graph_find(graph, "gain") == a);
+    ASSERT_NULL(lws_graph_find(graph, "none"));
+    ASSERT_EQ(strcmp(lws_graph_node_name(out), "sink"), 0);
+
+    lws_graph_destroy(graph);
+    lws_graph_destroy(other);
+}
+
+TEST(graph_cpu_accounting)
+{
+    lws_graph_t* graph = lws_graph_create();
+    gain_ctx_t gain = { 0, 2000 };
+    sink_ctx_t sink;
+    lws_graph_node_t *src, *g, *out;
+    lws_node_stats_t gs, ss, srcs;
+    uint64_t start, wall;
+    int i;
+
+    memset(&sink, 0, sizeof(sink));
+    sink.sleep_us = 1000;
+    ASSERT_NOT_NULL(graph);
+    src = lws_graph_add(graph, &s_source, NULL);
+    g = lws_graph_add(graph, &s_gain, &gain);
+    out = lws_graph_add(graph, &s_sink, &sink);
+    ASSERT_EQ(lws_graph_link(src, g), 0);
+    ASSERT_EQ(lws_graph_link(g, out), 0);
+
+    start = wall_us();
+    for (i = 0; i < 5; i++) {
+        lws_frame_t* frame = make_frame(0);
+        lws_graph_emit(src, frame);
+        lws_frame_unref(frame);
+    }
+    wall = wall_us() - start;
+
+    ASSERT_EQ(lws_graph_node_stats(src, &srcs), 0);
+    ASSERT_EQ(lws_graph_node_stats(g, &gs), 0);
+    ASSERT_EQ(lws_graph_node_stats(out, &ss), 0);
+    ASSERT_EQ(srcs.frames, 5u);
+    ASSERT_EQ(gs.frames, 5u);
+    ASSERT_EQ(ss.frames, 5u);
+    ASSERT_TRUE(gs.total_us >= 5 * 2000);
+    ASSERT_TRUE(ss.total_us >= 5 * 1000);
+    ASSERT_TRUE(gs.max_us >= 2000);
+
+    /* filter的耗时不含sink：两者之和不超过总墙钟时间 */
+    ASSERT_TRUE(gs.total_us + ss.total_us <= wall);
+    ASSERT_EQ(lws_graph_node_stats(NULL, &gs), -1);
+
+    lws_graph_destroy(graph);
+}
+
+TEST(graph_build)
+{
+    lws_graph_t* graph = lws_graph_create();
+    gain_ctx_t gain = { 0, 0 };
+    sink_ctx_t tap, sink;
+    lws_node_def_t defs[] = {
+        { &s_tap, &tap },               /* sink：接在最后一个filter上 */
+        { &s_gain, &gain },
+        { &s_source, NULL },            /* 忽略 */
+        { &s_fail, NULL },
+    };
+    lws_graph_node_t *src, *tail, *out;
+    lws_node_stats_t stats;
+    lws_frame_t* frame;
+
+    memset(&tap, 0, sizeof(tap));
+    memset(&sink, 0, sizeof(sink));
+    ASSERT_NOT_NULL(graph);
+    src = lws_graph_add(graph, &s_source, NULL);
+
+    tail = lws_graph_build(graph, src, defs, 4);
+    ASSERT_NOT_NULL(tail);
+    ASSERT_EQ(strcmp(lws_graph_node_name(tail), "fail"), 0);
+    out = lws_graph_add(graph, &s_sink, &sink);
+    ASSERT_EQ(lws_graph_link(tail, out), 0);
+
+    /* src → gain → fail(不输出)，tap接在fail上：都收不到 */
+    frame = make_frame(0);
+    ASSERT_EQ(lws_graph_emit(src, frame), 1);
+    lws_frame_unref(frame);
+    ASSERT_EQ(tap.count, 0);
+    ASSERT_EQ(sink.count, 0);
+    ASSERT_EQ(lws_graph_node_stats(tail, &stats), 0);
+    ASSERT_EQ(stats.errors, 1u);
+
+    /* 无节点定义：返回起点 */
+    ASSERT_TRUE(lws_graph_build(graph, src, NULL, 0) == src);
+    ASSERT_NULL(lws_graph_build(graph, NULL, defs, 1));
+
+    lws_graph_destroy(graph);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_graph Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_frame_refcount();
+    run_test_graph_chain_in_place();
+    run_test_graph_fanout_shares_frames();
+    run_test_graph_link_rules();
+    run_test_graph_cpu_accounting();
+    run_test_graph_build();
+
+    printf("\n");
+    printf("==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,480 @@
+/**
+ * @file lwsip_h264_test.c
+ * @brief Unit tests for lws_h264.c (H.264 bitstream helpers, RFC 6184 payload)
+ *
+ * Test coverage:
+ * - Annex-B <-> AVCC conversion
+ * - SPS picture size, avcC record, sprop-parameter-sets
+ * - STAP-A / FU-A / single NAL packetization and reassembly
+ * - Parameter sets inserted before IDRs that lack them
+ * - Loss: frames are dropped until the next IDR
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lws_h264.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+
+#define MTU             1200
+#define MAX_PACKETS     64
+
+/* ========================================
+ * Helpers
+ * ======================================== */
+
+/* 捕获打包器输出 */
+static uint8_t g_packets[MAX_PACKETS][LWS_H264_MAX_MTU];
+static int g_packet_len[MAX_PACKETS];
+static int g_packet_count = 0;
+
+static int on_packet(void* param, const uint8_t* packet, int bytes)
+{
+    (void)param;
+    if (g_packet_count >= MAX_PACKETS) {
+        return -1;
+    }
+    memcpy(g_packets[g_packet_count], packet, bytes);
+    g_packet_len[g_packet_count++] = bytes;
+    return 0;
+}
+
+/* 捕获解包器输出 */
+static uint8_t g_frame[16384];
+static int g_frame_len = 0;
+static int g_frame_count = 0;
+static int g_frame_key = 0;
+static uint32_t g_frame_ts = 0;
+
+static void on_frame(void* param, const uint8_t* data, int bytes,
+                     uint32_t timestamp, int keyframe)
+{
+    (void)param;
+    memcpy(g_frame, data, bytes);
+    g_frame_len = bytes;
+    g_frame_count++;
+    g_frame_key = keyframe;
+    g_frame_ts = timestamp;
+}
+
+/* 追加一个4字节起始码的NAL，负载按序填充 */
+static int put_nal(uint8_t* buf, int len, uint8_t header, int bytes)
+{
+    int i;
+    memcpy(buf + len, "\0\0\0\1", 4);
+    len += 4;
+    buf[len++] = header;
+    for (i = 1; i < bytes; i++) {
+        buf[len++] = (uint8_t)(i * 7 + header);
+    }
+    return len;
+}
+
+/* SPS写入：Exp-Golomb位流 */
+typedef struct {
+    uint8_t buf[64];
+    int pos;
+} bitwriter_t;
+
+static void bw_bits(bitwriter_t* bw, uint32_t v, int n)
+{
+    while (n-- > 0) {
+        if ((v >> n) & 1) {
+            bw->buf[bw->pos >> 3] |= (uint8_t)(0x80 >> (bw->pos & 7));
+        }
+        bw->pos++;
+    }
+}
+
+static void bw_ue(bitwriter_t* bw, uint32_t v)
+{
+    int len = 0;
+    while (((v + 1) >> len) > 1) {
+        len++;
+    }
+    bw_bits(bw, 0, len);
+    bw_bits(bw, v + 1, len + 1);
+}
+
+/* 1920x1080 Constrained Baseline：120x68宏块，底部裁剪8行 */
+static int make_sps(uint8_t* sps)
+{
+    bitwriter_t bw;
+    int n;
+
+    memset(&bw, 0, sizeof(bw));
+    bw_bits(&bw, 0x67, 8);
+    bw_bits(&bw, 66, 8);        /* profile_idc */
+    bw_bits(&bw, 0xc0, 8);      /* constraint_set0/1 */
+    bw_bits(&bw, 40, 8);        /* level_idc */
+    bw_ue(&bw, 0);              /* seq_parameter_set_id */
+    bw_ue(&bw, 0);              /* log2_max_frame_num_minus4 */
+    bw_ue(&bw, 2);              /* pic_order_cnt_type */
+    bw_ue(&bw, 1);              /* max_num_ref_frames */
+    bw_bits(&bw, 0, 1);
+    bw_ue(&bw, 119);            /* pic_width_in_mbs_minus1 */
+    bw_ue(&bw, 67);             /* pic_height_in_map_units_minus1 */
+    bw_bits(&bw, 1, 1);         /* frame_mbs_only_flag */
+    bw_bits(&bw, 1, 1);         /* direct_8x8_inference_flag */
+    bw_bits(&bw, 1, 1);         /* frame_cropping_flag */
+    bw_ue(&bw, 0);
+    bw_ue(&bw, 0);
+    bw_ue(&bw, 0);
+    bw_ue(&bw, 4);              /* 4 * 2 = 8行 */
+    bw_bits(&bw, 0, 1);         /* vui_parameters_present_flag */
+    bw_bits(&bw, 1, 1);         /* rbsp_stop_one_bit */
+
+    n = (bw.pos + 7) / 8;
+    memcpy(sps, bw.buf, n);
+    return n;
+}
+
+/* 参数集 + 3000字节IDR */
+static int make_idr_au(uint8_t* buf, int with_params)
+{
+    int len = 0;
+    if (with_params) {
+        len = put_nal(buf, len, 0x67, 10);
+        len = put_nal(buf, len, 0x68, 4);
+    }
+    return put_nal(buf, len, 0x65, 3000);
+}
+
+/* ========================================
+ * Byte stream formats
+ * ======================================== */
+
+TEST(annexb_avcc_roundtrip)
+{
+    /* 3字节和4字节起始码混合 */
+    static const uint8_t annexb[] = {
+        0, 0, 0, 1, 0x67, 0x42, 0xc0, 0x1f,
+        0, 0, 1, 0x68, 0xce,
+        0, 0, 0, 1, 0x65, 0x88, 0x84, 0x00, 0x01
+    };
+    uint8_t avcc[64], back[64];
+    const uint8_t* nal;
+    int offset = 0, n;
+    int len;
+
+    nal = lws_h264_next_nal(annexb, sizeof(annexb), &offset, &n);
+    ASSERT_TRUE(nal == annexb + 4 && n == 4);
+    nal = lws_h264_next_nal(annexb, sizeof(annexb), &offset, &n);
+    ASSERT_TRUE(nal == annexb + 11 && n == 2);
+    nal = lws_h264_next_nal(annexb, sizeof(annexb), &offset, &n);
+    ASSERT_TRUE(nal == annexb + 17 && n == 5);
+    ASSERT_TRUE(lws_h264_next_nal(annexb, sizeof(annexb), &offset, &n) == NULL);
+
+    len = lws_h264_annexb_to_avcc(annexb, sizeof(annexb), avcc, sizeof(avcc));
+    ASSERT_EQ(len, 4 * 3 + 4 + 2 + 5);
+    ASSERT_EQ(avcc[3], 4);
+    ASSERT_EQ(avcc[4], 0x67);
+    ASSERT_EQ(lws_h264_annexb_to_avcc(annexb, sizeof(annexb), avcc, 10), -1);
+
+    len = lws_h264_avcc_to_annexb(avcc, len, 4, back, sizeof(back));
+    ASSERT_EQ(len, 23);
+    ASSERT_EQ(memcmp(back, "\0\0\0\1\x67\x42\xc0\x1f\0\0\0\1\x68\xce", 14), 0);
+
+    /* 长度字段越界 */
+    avcc[3] = 40;
+    ASSERT_EQ(lws_h264_avcc_to_annexb(avcc, 21, 4, back, sizeof(back)), -1);
+}
+
+/* ========================================
+ * Parameter sets
+ * ======================================== */
+
+TEST(sps_avcc_sprop)
+{
+    lws_h264_params_t params, copy;
+    uint8_t avcc[300];
+    char fmtp[256] = "profile-level-id=42e01f;packetization-mode=1";
+    const char* sprop;
+    int width = 0, height = 0, length_size = 0;
+    int len;
+
+    memset(&params, 0, sizeof(params));
+    ASSERT_EQ(lws_h264_sps_size(&params, &width, &height), -1);
+    ASSERT_EQ(lws_h264_avcc_write(&params, avcc, sizeof(avcc)), -1);
+
+    params.sps_len = make_sps(params.sps);
+    params.pps[0] = 0x68;
+    params.pps[1] = 0xce;
+    params.pps[2] = 0x3c;
+    params.pps[3] = 0x80;
+    params.pps_len = 4;
+
+    ASSERT_EQ(lws_h264_sps_size(&params, &width, &height), 0);
+    ASSERT_EQ(width, 1920);
+    ASSERT_EQ(height, 1080);
+
+    /* avcC */
+    len = lws_h264_avcc_write(&params, avcc, sizeof(avcc));
+    ASSERT_EQ(len, 11 + params.sps_len + 4);
+    ASSERT_EQ(avcc[1], 66);
+    memset(&copy, 0, sizeof(copy));
+    ASSERT_EQ(lws_h264_avcc_read(&copy, avcc, len, &length_size), 0);
+    ASSERT_EQ(length_size, 4);
+    ASSERT_EQ(copy.sps_len, params.sps_len);
+    ASSERT_EQ(memcmp(copy.sps, params.sps, params.sps_len), 0);
+    ASSERT_EQ(memcmp(copy.pps, params.pps, 4), 0);
+    ASSERT_EQ(lws_h264_avcc_read(&copy, avcc, len - 3, &length_size), -1);
+
+    /* sprop-parameter-sets：追加，再次写入时替换 */
+    ASSERT_EQ(lws_h264_fmtp_write(&params, fmtp, sizeof(fmtp)), 0);
+    ASSERT_EQ(strncmp(fmtp, "profile-level-id=42e01f;packetization-mode=1;sprop-parameter-sets=", 66), 0);
+    ASSERT_EQ(lws_h264_fmtp_write(&params, fmtp, sizeof(fmtp)), 0);
+    sprop = strstr(fmtp, "sprop-parameter-sets=");
+    ASSERT_TRUE(sprop != NULL && strstr(sprop + 1, "sprop-parameter-sets=") == NULL);
+    ASSERT_TRUE(strstr(fmtp, ",aM48gA==") != NULL);
+    ASSERT_EQ(lws_h264_fmtp_write(&params, fmtp, 40), -1);
+
+    memset(&copy, 0, sizeof(copy));
+    sprop += 21;
+    ASSERT_EQ(lws_h264_sprop_read(&copy, sprop, (int)strlen(sprop)), 0);
+    ASSERT_EQ(copy.sps_len, params.sps_len);
+    ASSERT_EQ(memcmp(copy.sps, params.sps, params.sps_len), 0);
+    ASSERT_EQ(copy.pps_len, 4);
+    ASSERT_EQ(lws_h264_sprop_read(&copy, "aM48gA==", 8), -1);
+}
+
+/* ========================================
+ * Packetizer / depacketizer
+ * ======================================== */
+
+TEST(stap_a_and_fu_a)
+{
+    static uint8_t au[4096];
+    lws_h264_packer_t packer;
+    lws_h264_depacker_t depacker;
+    int len = make_idr_au(au, 1);
+    int i;
+
+    g_packet_count = 0;
+    lws_h264_packer_init(&packer, 97, 1, 0x1234, 100, MTU, on_packet, NULL);
+    ASSERT_EQ(lws_h264_pack(&packer, au, len, 90000), 4);
+
+    /* SPS+PPS合并为STAP-A，NRI取最大值 */
+    ASSERT_EQ(g_packets[0][12] & 0x1f, LWS_H264_NAL_STAP_A);
+    ASSERT_EQ(g_packets[0][12] & 0x60, 0x60);
+    ASSERT_EQ(g_packet_len[0], 12 + 1 + 2 + 10 + 2 + 4);
+
+    /* IDR拆为3个FU-A：S/E位，M位只在最后一个包 */
+    for (i = 1; i < 4; i++) {
+        ASSERT_EQ(g_packets[i][12], 0x60 | LWS_H264_NAL_FU_A);
+        ASSERT_EQ(g_packets[i][13] & 0x1f, LWS_H264_NAL_IDR);
+        ASSERT_EQ((g_packets[i][13] & 0x80) != 0, i == 1);
+        ASSERT_EQ((g_packets[i][13] & 0x40) != 0, i == 3);
+        ASSERT_EQ((g_packets[i][1] & 0x80) != 0, i == 3);
+        ASSERT_TRUE(g_packet_len[i] <= MTU);
+        ASSERT_EQ(g_packets[i][3], 100 + i);
+        ASSERT_EQ(g_packets[i][6], 0x5f);   /* 90000 = 0x15f90 */
+    }
+    ASSERT_EQ(packer.seq, 104);
+
+    /* 重组后与输入一致 */
+    g_frame_count = 0;
+    ASSERT_EQ(lws_h264_depacker_init(&depacker, 8192, on_frame, NULL), 0);
+    for (i = 0; i < g_packet_count; i++) {
+        ASSERT_EQ(lws_h264_depack(&depacker, g_packets[i], g_packet_len[i]), 0);
+    }
+    ASSERT_EQ(g_frame_count, 1);
+    ASSERT_EQ(g_frame_key, 1);
+    ASSERT_EQ(g_frame_ts, 90000);
+    ASSERT_EQ(g_frame_len, len);
+    ASSERT_EQ(memcmp(g_frame, au, len), 0);
+    lws_h264_depacker_free(&depacker);
+}
+
+TEST(params_before_idr)
+{
+    static uint8_t au[4096];
+    lws_h264_packer_t packer;
+    lws_h264_depacker_t depacker;
+    uint8_t p_frame[64];
+    int len;
+    int i;
+
+    g_packet_count = 0;
+    lws_h264_packer_init(&packer, 97, 1, 0x1234, 0, MTU, on_packet, NULL);
+
+    /* 首个IDR携带参数集，之后的IDR没有：打包器补发 */
+    len = make_idr_au(au, 1);
+    ASSERT_EQ(lws_h264_pack(&packer, au, len, 0), 4);
+    len = put_nal(p_frame, 0, 0x41, 30);
+    g_packet_count = 0;
+    ASSERT_EQ(lws_h264_pack(&packer, p_frame, len, 3000), 1);
+    ASSERT_EQ(g_packets[0][12], 0x41);
+    ASSERT_EQ(g_packets[0][1] & 0x80, 0x80);
+
+    len = make_idr_au(au, 0);
+    g_packet_count = 0;
+    ASSERT_EQ(lws_h264_pack(&packer, au, len, 6000), 4);
+    ASSERT_EQ(g_packets[0][12] & 0x1f, LWS_H264_NAL_STAP_A);
+
+    /* 接收端：参数集只在sprop-parameter-sets中，IDR前插 */
+    g_packet_count = 0;
+    lws_h264_packer_init(&packer, 97, 1, 0x1234, 0, MTU, on_packet, NULL);
+    ASSERT_EQ(lws_h264_pack(&packer, au, len, 9000), 3);
+
+    g_frame_count = 0;
+    ASSERT_EQ(lws_h264_depacker_init(&depacker, 8192, on_frame, NULL), 0);
+    depacker.params.sps_len = 10;
+    depacker.params.pps_len = 4;
+    make_idr_au(au, 1);
+    memcpy(depacker.params.sps, au + 4, 10);
+    memcpy(depacker.params.pps, au + 18, 4);
+    for (i = 0; i < g_packet_count; i++) {
+        lws_h264_depack(&depacker, g_packets[i], g_packet_len[i]);
+    }
+    ASSERT_EQ(g_frame_count, 1);
+    ASSERT_EQ(g_frame_len, make_idr_au(au, 1));
+    ASSERT_EQ(memcmp(g_frame, au, g_frame_len), 0);
+    lws_h264_depacker_free(&depacker);
+}
+
+TEST(loss_waits_for_idr)
+{
+    static uint8_t au[4096];
+    static uint8_t pkts[8][LWS_H264_MAX_MTU];
+    int plen[8];
+    lws_h264_packer_t packer;
+    lws_h264_depacker_t depacker;
+    uint8_t p_frame[64];
+    int len, n, i;
+
+    lws_h264_packer_init(&packer, 97, 1, 1, 0, MTU, on_packet, NULL);
+    g_frame_count = 0;
+    ASSERT_EQ(lws_h264_depacker_init(&depacker, 8192, on_frame, NULL), 0);
+
+    /* 未收到IDR前不输出 */
+    len = put_nal(p_frame, 0, 0x41, 30);
+    g_packet_count = 0;
+    lws_h264_pack(&packer, p_frame, len, 0);
+    lws_h264_depack(&depacker, g_packets[0], g_packet_len[0]);
+    ASSERT_EQ(g_frame_count, 0);
+    ASSERT_EQ(depacker.dropped, 1);
+
+    len = make_idr_au(au, 1);
+    g_packet_count = 0;
+    lws_h264_pack(&packer, au, len, 3000);
+    for (i = 0; i < g_packet_count; i++) {
+        lws_h264_depack(&depacker, g_packets[i], g_packet_len[i]);
+    }
+    ASSERT_EQ(g_frame_count, 1);
+
+    /* IDR的中间分片丢失：该帧和之后的P帧都丢弃 */
+    g_packet_count = 0;
+    lws_h264_pack(&packer, au, make_idr_au(au, 0), 6000);
+    n = g_packet_count;
+    memcpy(pkts, g_packets, sizeof(pkts));
+    memcpy(plen, g_packet_len, sizeof(plen));
+    for (i = 0; i < n; i++) {
+        if (i != n - 2) {
+            lws_h264_depack(&depacker, pkts[i], plen[i]);
+        }
+    }
+    len = put_nal(p_frame, 0, 0x41, 30);
+    g_packet_count = 0;
+    lws_h264_pack(&packer, p_frame, len, 9000);
+    lws_h264_depack(&depacker, g_packets[0], g_packet_len[0]);
+    ASSERT_EQ(g_frame_count, 1);
+    ASSERT_EQ(depacker.dropped, 3);
+
+    /* 重复的旧包忽略 */
+    lws_h264_depack(&depacker, g_packets[0], g_packet_len[0]);
+    ASSERT_EQ(depacker.dropped, 3);
+
+    /* 下一个IDR恢复输出 */
+    g_packet_count = 0;
+    lws_h264_pack(&packer, au, make_idr_au(au, 1), 12000);
+    for (i = 0; i < g_packet_count; i++) {
+        lws_h264_depack(&depacker, g_packets[i], g_packet_len[i]);
+    }
+    ASSERT_EQ(g_frame_count, 2);
+    ASSERT_EQ(g_frame_ts, 12000);
+    ASSERT_EQ(depacker.frames, 2);
+
+    lws_h264_depacker_free(&depacker);
+}
+
+TEST(single_nal_mode)
+{
+    static uint8_t au[4096];
+    lws_h264_packer_t packer;
+    uint8_t small[64];
+    int len;
+
+    /* packetization-mode=0：每个NAL单独成包，超过MTU的无法发送 */
+    g_packet_count = 0;
+    lws_h264_packer_init(&packer, 97, 0, 1, 0, MTU, on_packet, NULL);
+    len = put_nal(small, 0, 0x67, 10);
+    len = put_nal(small, len, 0x68, 4);
+    len = put_nal(small, len, 0x09, 2);     /* AUD不发送 */
+    ASSERT_EQ(lws_h264_pack(&packer, small, len, 0), 2);
+    ASSERT_EQ(g_packets[0][12], 0x67);
+    ASSERT_EQ(g_packets[1][12], 0x68);
+    ASSERT_EQ(g_packets[1][1] & 0x80, 0x80);
+
+    len = make_idr_au(au, 0);
+    ASSERT_EQ(lws_h264_pack(&packer, au, len, 0), -1);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_h264 Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_annexb_avcc_roundtrip();
+    run_test_sps_avcc_sprop();
+    run_test_stap_a_and_fu_a();
+    run_test_params_before_idr();
+    run_test_loss_waits_for_idr();
+    run_test_single_nal_mode();
+
+    printf("\n");
+    printf("==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
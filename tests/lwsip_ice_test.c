@@ -0,0 +1,1106 @@
+/**
+ * @file lwsip_ice_test.c
+ * @brief Unit tests for lws_stun.c and lws_ice.c
+ *
+ * Test coverage:
+ * - STUN codec against the RFC 5769 test vectors, build/parse round trip
+ * - Candidate priority and a=candidate formatting
+ * - Gathering against an in-memory STUN server stand-in:
+ *   parallel servers, redundant mappings, Ta pacing, retransmission after
+ *   loss, error responses and the gathering deadline
+ * - Connectivity checks between two agents over an in-memory network with
+ *   a port-restricted cone NAT in front of one of them: aggressive vs
+ *   regular nomination (time to connected), trickled candidates, role
+ *   conflict, unreachable peer, bad credentials and consent loss
+ * - ICE-lite peer: stateless answers, no check list, latching on nomination
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "lws_stun.h"
+#include "lws_ice.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+
+/* ========================================
+ * RFC 5769 test vectors
+ * ======================================== */
+
+static const char* k_password = "VOkJxbRl1RmTxUk/WvJxBt";
+
+/* §2.1 Sample Request */
+static const uint8_t k_request[] = {
+    0x00, 0x01, 0x00, 0x58, 0x21, 0x12, 0xa4, 0x42, 0xb7, 0xe7, 0xa7, 0x01,
+    0xbc, 0x34, 0xd6, 0x86, 0xfa, 0x87, 0xdf, 0xae, 0x80, 0x22, 0x00, 0x10,
+    0x53, 0x54, 0x55, 0x4e, 0x20, 0x74, 0x65, 0x73, 0x74, 0x20, 0x63, 0x6c,
+    0x69, 0x65, 0x6e, 0x74, 0x00, 0x24, 0x00, 0x04, 0x6e, 0x00, 0x01, 0xff,
+    0x80, 0x29, 0x00, 0x08, 0x93, 0x2f, 0xf9, 0xb1, 0x51, 0x26, 0x3b, 0x36,
+    0x00, 0x06, 0x00, 0x09, 0x65, 0x76, 0x74, 0x6a, 0x3a, 0x68, 0x36, 0x76,
+    0x59, 0x20, 0x20, 0x20, 0x00, 0x08, 0x00, 0x14, 0x9a, 0xea, 0xa7, 0x0c,
+    0xbf, 0xd8, 0xcb, 0x56, 0x78, 0x1e, 0xf2, 0xb5, 0xb2, 0xd3, 0xf2, 0x49,
+    0xc1, 0xb5, 0x71, 0xa2, 0x80, 0x28, 0x00, 0x04, 0xe5, 0x7a, 0x3b, 0xcf
+};
+
+/* §2.2 Sample IPv4 Response (192.0.2.1:32853) */
+static const uint8_t k_response[] = {
+    0x01, 0x01, 0x00, 0x3c, 0x21, 0x12, 0xa4, 0x42, 0xb7, 0xe7, 0xa7, 0x01,
+    0xbc, 0x34, 0xd6, 0x86, 0xfa, 0x87, 0xdf, 0xae, 0x80, 0x22, 0x00, 0x0b,
+    0x74, 0x65, 0x73, 0x74, 0x20, 0x76, 0x65, 0x63, 0x74, 0x6f, 0x72, 0x20,
+    0x00, 0x20, 0x00, 0x08, 0x00, 0x01, 0xa1, 0x47, 0xe1, 0x12, 0xa6, 0x43,
+    0x00, 0x08, 0x00, 0x14, 0x2b, 0x91, 0xf5, 0x99, 0xfd, 0x9e, 0x90, 0xc3,
+    0x8c, 0x74, 0x89, 0xf9, 0x2a, 0xf9, 0xba, 0x53, 0xf0, 0x6b, 0xe7, 0xd7,
+    0x80, 0x28, 0x00, 0x04, 0xc0, 0x7d, 0x4c, 0x96
+};
+
+/* ========================================
+ * In-memory STUN server stand-in
+ * ======================================== */
+
+#define MAX_SERVERS     4
+#define STEP_US         10000       /* 10ms per loop iteration */
+
+typedef struct {
+    struct sockaddr_in addr;        /* Server address */
+    struct sockaddr_in mapped;      /* Address reported in XOR-MAPPED-ADDRESS */
+    int drop;                       /* Requests still to drop (loss) */
+    int silent;                     /* Never answer */
+    int error;                      /* Answer with this error code */
+    int requests;                   /* Requests received */
+    uint64_t first_us;              /* Time of the first request */
+    uint64_t last_us;               /* Time of the last request */
+} stun_server_t;
+
+typedef struct {
+    stun_server_t servers[MAX_SERVERS];
+    int server_count;
+    uint64_t now;
+    uint64_t send_times[32];        /* Every datagram the agent sent */
+    int send_count;
+
+    /* Responses queued for the next loop iteration */
+    uint8_t pending[MAX_SERVERS][LWS_STUN_MAX_MESSAGE];
+    int pending_bytes[MAX_SERVERS];
+    struct sockaddr_in pending_from[MAX_SERVERS];
+    int pending_count;
+
+    int candidates;                 /* on_candidate calls */
+    int srflx;
+    int done;                       /* on_gathering_done calls */
+    uint64_t done_us;
+} stun_net_t;
+
+static void make_addr(struct sockaddr_in* addr, const char* ip, int port)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)port);
+    inet_pton(AF_INET, ip, &addr->sin_addr);
+}
+
+static int net_send(void* param, const struct sockaddr_in* to, const uint8_t* data, int bytes)
+{
+    stun_net_t* net = (stun_net_t*)param;
+    stun_server_t* server = NULL;
+    uint8_t* rsp;
+    int n;
+    int i;
+
+    if (net->send_count < 32) {
+        net->send_times[net->send_count++] = net->now;
+    }
+
+    for (i = 0; i < net->server_count; i++) {
+        if (net->servers[i].addr.sin_addr.s_addr == to->sin_addr.s_addr &&
+            net->servers[i].addr.sin_port == to->sin_port) {
+            server = &net->servers[i];
+        }
+    }
+    if (!server || !lws_stun_is_message(data, bytes) ||
+        lws_stun_type(data) != LWS_STUN_BINDING_REQUEST ||
+        lws_stun_check_fingerprint(data, bytes) != 0) {
+        return 0;
+    }
+
+    if (server->requests++ == 0) {
+        server->first_us = net->now;
+    }
+    server->last_us = net->now;
+    if (server->silent || server->drop > 0) {
+        server->drop -= server->drop > 0;
+        return 0;
+    }
+
+    /* Binding响应在下一次循环送达 */
+    rsp = net->pending[net->pending_count];
+    if (server->error) {
+        n = lws_stun_init(rsp, LWS_STUN_MAX_MESSAGE, LWS_STUN_BINDING_ERROR,
+                          lws_stun_msg_tid(data));
+        n = lws_stun_add_error(rsp, LWS_STUN_MAX_MESSAGE, n, server->error, "Bad Request");
+    } else {
+        n = lws_stun_init(rsp, LWS_STUN_MAX_MESSAGE, LWS_STUN_BINDING_SUCCESS,
+                          lws_stun_msg_tid(data));
+        n = lws_stun_add_xor_addr(rsp, LWS_STUN_MAX_MESSAGE, n,
+                                  LWS_STUN_ATTR_XOR_MAPPED_ADDRESS, &server->mapped);
+    }
+    n = lws_stun_add_fingerprint(rsp, LWS_STUN_MAX_MESSAGE, n);
+    if (n > 0) {
+        net->pending_bytes[net->pending_count] = n;
+        net->pending_from[net->pending_count] = server->addr;
+        net->pending_count++;
+    }
+    return 0;
+}
+
+static void net_on_candidate(void* param, const lws_ice_cand_t* cand)
+{
+    stun_net_t* net = (stun_net_t*)param;
+
+    net->candidates++;
+    net->srflx += cand->type == LWS_ICE_CAND_SRFLX;
+}
+
+static void net_on_gathering_done(void* param)
+{
+    stun_net_t* net = (stun_net_t*)param;
+
+    net->done++;
+    net->done_us = net->now;
+}
+
+static lws_ice_t* net_agent(stun_net_t* net, int timeout_ms)
+{
+    lws_ice_config_t config;
+    lws_ice_handler_t handler;
+    struct sockaddr_in host;
+    lws_ice_t* ice;
+    int i;
+
+    memset(&config, 0, sizeof(config));
+    for (i = 0; i < net->server_count; i++) {
+        config.stun_servers[i] = net->servers[i].addr;
+    }
+    config.stun_count = net->server_count;
+    config.gather_timeout_ms = timeout_ms;
+
+    memset(&handler, 0, sizeof(handler));
+    handler.send = net_send;
+    handler.on_candidate = net_on_candidate;
+    handler.on_gathering_done = net_on_gathering_done;
+    handler.param = net;
+
+    ice = lws_ice_create(&config, &handler);
+    if (ice) {
+        make_addr(&host, "192.168.1.10", 40000);
+        lws_ice_add_host(ice, &host);
+    }
+    return ice;
+}
+
+/**
+ * @brief Run the agent until gathering completes (or 10s simulated time)
+ */
+static void net_run(stun_net_t* net, lws_ice_t* ice)
+{
+    int i;
+    int j;
+
+    net->now = 1000000;
+    lws_ice_gather(ice, net->now);
+    for (i = 0; i < 1000 && !net->done; i++) {
+        int count = net->pending_count;
+
+        net->now += STEP_US;
+        net->pending_count = 0;
+        for (j = 0; j < count; j++) {
+            ASSERT_EQ(lws_ice_input(ice, &net->pending_from[j], net->pending[j],
+                                    net->pending_bytes[j], net->now), 1);
+        }
+        lws_ice_poll(ice, net->now);
+    }
+}
+
+/* ========================================
+ * In-memory network with a NAT (checks)
+ * ======================================== */
+
+#define MAX_PACKETS     256
+#define LATENCY_US      20000       /* One-way delay */
+
+/*
+ * A: 192.168.1.10:40000 behind a port-restricted cone NAT (203.0.113.1:61000)
+ * B: 198.51.100.20:50000, public
+ */
+typedef struct {
+    int to;                         /* 0 = A, 1 = B */
+    struct sockaddr_in from;
+    uint8_t data[LWS_STUN_MAX_MESSAGE];
+    int bytes;
+    uint64_t deliver_us;
+} packet_t;
+
+typedef struct ice_net ice_net_t;
+
+/** Nomination trace as seen on the wire */
+typedef struct {
+    int checks;                     /* A->B checks up to the first USE-CANDIDATE */
+    int nominate_check;             /* 1-based index of the first check with USE-CANDIDATE */
+    int responses_before;           /* Success responses A got before nominating */
+} nominate_trace_t;
+
+typedef struct {
+    ice_net_t* net;
+    int side;
+} ice_peer_t;
+
+struct ice_net {
+    lws_ice_t* ice[2];
+    ice_peer_t peer[2];
+    struct sockaddr_in a_host;
+    struct sockaddr_in a_nat;
+    struct sockaddr_in b_host;
+    struct sockaddr_in nat_permit[8];   /* Destinations A has sent to */
+    int permit_count;
+    packet_t packets[MAX_PACKETS];
+    int packet_count;
+    uint64_t now;
+    uint64_t start;
+    int blackhole;                  /* Drop everything (consent loss) */
+    lws_ice_state_t state[2];
+    uint64_t connected_us[2];
+    int media[2];                   /* Non-STUN datagrams delivered */
+    int last_error;                 /* ERROR-CODE of the last error response to A */
+    nominate_trace_t trace;
+};
+
+static int addr_eq(const struct sockaddr_in* a, const struct sockaddr_in* b)
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+static void sim_queue(ice_net_t* net, int to, const struct sockaddr_in* from,
+                      const uint8_t* data, int bytes)
+{
+    packet_t* pkt;
+
+    if (net->blackhole || net->packet_count >= MAX_PACKETS || bytes > LWS_STUN_MAX_MESSAGE) {
+        return;
+    }
+    pkt = &net->packets[net->packet_count++];
+    pkt->to = to;
+    pkt->from = *from;
+    memcpy(pkt->data, data, bytes);
+    pkt->bytes = bytes;
+    pkt->deliver_us = net->now + LATENCY_US;
+}
+
+static int sim_send(void* param, const struct sockaddr_in* to, const uint8_t* data, int bytes)
+{
+    ice_peer_t* peer = (ice_peer_t*)param;
+    ice_net_t* net = peer->net;
+    int i;
+
+    if (peer->side == 0) {
+        /* A -> 公网：NAT转换源地址并记录许可 */
+        if (!addr_eq(to, &net->b_host)) {
+            return 0;
+        }
+        for (i = 0; i < net->permit_count && !addr_eq(&net->nat_permit[i], to); i++) {
+        }
+        if (i == net->permit_count && net->permit_count < 8) {
+            net->nat_permit[net->permit_count++] = *to;
+        }
+        sim_queue(net, 1, &net->a_nat, data, bytes);
+        return 0;
+    }
+
+    /* B -> A：私网地址不可达；NAT只放行A发往过的地址和端口 */
+    if (!addr_eq(to, &net->a_nat)) {
+        return 0;
+    }
+    for (i = 0; i < net->permit_count; i++) {
+        if (addr_eq(&net->nat_permit[i], &net->b_host)) {
+            sim_queue(net, 0, &net->b_host, data, bytes);
+            break;
+        }
+    }
+    return 0;
+}
+
+static void sim_on_state(void* param, lws_ice_state_t state)
+{
+    ice_peer_t* peer = (ice_peer_t*)param;
+
+    peer->net->state[peer->side] = state;
+    if (state == LWS_ICE_CONNECTED) {
+        peer->net->connected_us[peer->side] = peer->net->now;
+    }
+}
+
+static lws_ice_t* sim_agent(ice_net_t* net, int side, const lws_ice_config_t* base)
+{
+    lws_ice_config_t config;
+    lws_ice_handler_t handler;
+    lws_ice_t* ice;
+
+    memset(&config, 0, sizeof(config));
+    if (base) {
+        config = *base;
+    }
+    memset(&handler, 0, sizeof(handler));
+    handler.send = sim_send;
+    handler.on_state = sim_on_state;
+    net->peer[side].net = net;
+    net->peer[side].side = side;
+    handler.param = &net->peer[side];
+
+    ice = lws_ice_create(&config, &handler);
+    if (!ice) {
+        return NULL;
+    }
+    lws_ice_add_host(ice, side == 0 ? &net->a_host : &net->b_host);
+    lws_ice_gather(ice, net->now);
+    if (side == 0) {
+        lws_ice_set_local_auth(ice, "AAAA", "a-password-0123456789ab");
+        lws_ice_set_remote_auth(ice, "BBBB", "b-password-0123456789ab");
+    } else {
+        lws_ice_set_local_auth(ice, "BBBB", "b-password-0123456789ab");
+        lws_ice_set_remote_auth(ice, "AAAA", "a-password-0123456789ab");
+    }
+    return ice;
+}
+
+static void sim_init(ice_net_t* net, const lws_ice_config_t* config)
+{
+    memset(net, 0, sizeof(*net));
+    make_addr(&net->a_host, "192.168.1.10", 40000);
+    make_addr(&net->a_nat, "203.0.113.1", 61000);
+    make_addr(&net->b_host, "198.51.100.20", 50000);
+    net->now = 1000000;
+    net->start = net->now;
+    net->ice[0] = sim_agent(net, 0, config);
+    net->ice[1] = sim_agent(net, 1, config);
+    lws_ice_set_controlling(net->ice[0], 1);    /* A是offerer */
+    lws_ice_set_controlling(net->ice[1], 0);
+}
+
+/**
+ * @brief Signal candidates: A gets B's host, B gets A's host and srflx
+ */
+static void sim_signal(ice_net_t* net, int end)
+{
+    lws_ice_cand_t cand;
+    const lws_ice_cand_t* locals;
+
+    lws_ice_local_candidates(net->ice[1], &locals);
+    lws_ice_add_remote(net->ice[0], &locals[0]);
+
+    lws_ice_local_candidates(net->ice[0], &locals);
+    lws_ice_add_remote(net->ice[1], &locals[0]);
+    memset(&cand, 0, sizeof(cand));
+    cand.type = LWS_ICE_CAND_SRFLX;
+    cand.component = 1;
+    cand.priority = lws_ice_priority(LWS_ICE_PREF_SRFLX, 65535, 1);
+    strcpy(cand.foundation, "7");
+    cand.addr = net->a_nat;
+    cand.base = net->a_host;
+    lws_ice_add_remote(net->ice[1], &cand);
+
+    if (end) {
+        lws_ice_end_of_candidates(net->ice[0]);
+        lws_ice_end_of_candidates(net->ice[1]);
+    }
+}
+
+static void sim_step(ice_net_t* net)
+{
+    int i = 0;
+
+    net->now += 1000;
+    while (i < net->packet_count) {
+        packet_t pkt = net->packets[i];
+
+        if (pkt.deliver_us > net->now) {
+            i++;
+            continue;
+        }
+        net->packet_count--;
+        memmove(&net->packets[i], &net->packets[i + 1], (net->packet_count - i) * sizeof(packet_t));
+
+        /* 记录提名时序：第几个检查携带USE-CANDIDATE，此前A收到几个成功响应 */
+        if (!net->trace.nominate_check && LWS_STUN_IS_MESSAGE(pkt.data[0])) {
+            uint16_t type = lws_stun_type(pkt.data);
+
+            if (pkt.to == 1 && type == LWS_STUN_BINDING_REQUEST) {
+                net->trace.checks++;
+                if (lws_stun_find(pkt.data, pkt.bytes, LWS_STUN_ATTR_USE_CANDIDATE, NULL)) {
+                    net->trace.nominate_check = net->trace.checks;
+                }
+            } else if (pkt.to == 0 && type == LWS_STUN_BINDING_SUCCESS) {
+                net->trace.responses_before++;
+            }
+        }
+
+        if (lws_ice_input(net->ice[pkt.to], &pkt.from, pkt.data, pkt.bytes, net->now)) {
+            if (pkt.to == 0 && LWS_STUN_IS_ERROR(lws_stun_type(pkt.data))) {
+                net->last_error = lws_stun_error_code(pkt.data, pkt.bytes);
+            }
+        } else {
+            net->media[pkt.to]++;
+        }
+    }
+    lws_ice_poll(net->ice[0], net->now);
+    lws_ice_poll(net->ice[1], net->now);
+}
+
+/**
+ * @brief Step until both sides leave CHECKING (or the simulated limit)
+ */
+static void sim_run(ice_net_t* net, int limit_ms)
+{
+    uint64_t end = net->now + (uint64_t)limit_ms * 1000;
+
+    while (net->now < end &&
+           (lws_ice_state(net->ice[0]) == LWS_ICE_CHECKING ||
+            lws_ice_state(net->ice[1]) == LWS_ICE_CHECKING)) {
+        sim_step(net);
+    }
+}
+
+static void sim_destroy(ice_net_t* net)
+{
+    lws_ice_destroy(net->ice[0]);
+    lws_ice_destroy(net->ice[1]);
+}
+
+/**
+ * @brief Connect through the NAT, return the time until both sides are connected
+ *
+ * The nomination trace is copied to @p trace when given.
+ */
+static int sim_connect_ms(int aggressive, nominate_trace_t* trace)
+{
+    lws_ice_config_t config;
+    lws_ice_cand_t local;
+    struct sockaddr_in remote;
+    ice_net_t net;
+    int ms;
+
+    memset(&config, 0, sizeof(config));
+    config.aggressive = aggressive;
+    sim_init(&net, &config);
+    sim_signal(&net, 1);
+    lws_ice_start(net.ice[0], net.now);
+    lws_ice_start(net.ice[1], net.now);
+    sim_run(&net, 20000);
+
+    ms = -1;
+    if (lws_ice_state(net.ice[0]) == LWS_ICE_CONNECTED &&
+        lws_ice_state(net.ice[1]) == LWS_ICE_CONNECTED &&
+        lws_ice_selected(net.ice[0], &local, &remote) == 0 && addr_eq(&remote, &net.b_host) &&
+        addr_eq(&local.addr, &net.a_host) &&
+        lws_ice_selected(net.ice[1], NULL, &remote) == 0 && addr_eq(&remote, &net.a_nat)) {
+        uint64_t last = net.connected_us[0] > net.connected_us[1] ?
+                        net.connected_us[0] : net.connected_us[1];
+        ms = (int)((last - net.start) / 1000);
+    }
+    if (trace) {
+        *trace = net.trace;
+    }
+    sim_destroy(&net);
+    return ms;
+}
+
+/* ========================================
+ * STUN Tests
+ * ======================================== */
+
+TEST(stun_rfc5769_request) {
+    const uint8_t* value;
+    int vlen;
+
+    ASSERT_TRUE(lws_stun_is_message(k_request, sizeof(k_request)));
+    ASSERT_EQ(lws_stun_type(k_request), LWS_STUN_BINDING_REQUEST);
+    ASSERT_EQ(lws_stun_check_fingerprint(k_request, sizeof(k_request)), 0);
+    ASSERT_EQ(lws_stun_check_integrity(k_request, sizeof(k_request),
+                                       (const uint8_t*)k_password, (int)strlen(k_password)), 0);
+    ASSERT_EQ(lws_stun_check_integrity(k_request, sizeof(k_request),
+                                       (const uint8_t*)"wrong", 5), -1);
+
+    value = lws_stun_find(k_request, sizeof(k_request), LWS_STUN_ATTR_USERNAME, &vlen);
+    ASSERT_TRUE(value != NULL);
+    ASSERT_EQ(vlen, 9);
+    ASSERT_EQ(memcmp(value, "evtj:h6vY", 9), 0);
+    ASSERT_TRUE(lws_stun_find(k_request, sizeof(k_request), LWS_STUN_ATTR_ICE_CONTROLLED, &vlen) != NULL);
+    ASSERT_TRUE(lws_stun_find(k_request, sizeof(k_request), LWS_STUN_ATTR_USE_CANDIDATE, &vlen) == NULL);
+}
+
+TEST(stun_rfc5769_response) {
+    struct sockaddr_in addr;
+    char ip[INET_ADDRSTRLEN];
+
+    ASSERT_TRUE(lws_stun_is_message(k_response, sizeof(k_response)));
+    ASSERT_TRUE(LWS_STUN_IS_SUCCESS(lws_stun_type(k_response)));
+    ASSERT_EQ(lws_stun_check_fingerprint(k_response, sizeof(k_response)), 0);
+    ASSERT_EQ(lws_stun_check_integrity(k_response, sizeof(k_response),
+                                       (const uint8_t*)k_password, (int)strlen(k_password)), 0);
+
+    ASSERT_EQ(lws_stun_mapped_addr(k_response, sizeof(k_response), &addr), 0);
+    inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+    ASSERT_EQ(strcmp(ip, "192.0.2.1"), 0);
+    ASSERT_EQ(ntohs(addr.sin_port), 32853);
+}
+
+TEST(stun_build_parse) {
+    uint8_t msg[LWS_STUN_MAX_MESSAGE];
+    uint8_t tid[LWS_STUN_TID_SIZE];
+    struct sockaddr_in addr;
+    struct sockaddr_in out;
+    const uint8_t* value;
+    int vlen;
+    int n;
+
+    ASSERT_EQ(lws_stun_tid(tid), 0);
+    make_addr(&addr, "203.0.113.7", 50000);
+
+    n = lws_stun_init(msg, sizeof(msg), LWS_STUN_BINDING_SUCCESS, tid);
+    n = lws_stun_add(msg, sizeof(msg), n, LWS_STUN_ATTR_USERNAME, "ab:c", 4);
+    n = lws_stun_add_u32(msg, sizeof(msg), n, LWS_STUN_ATTR_PRIORITY, 0x6e0001ff);
+    n = lws_stun_add_xor_addr(msg, sizeof(msg), n, LWS_STUN_ATTR_XOR_MAPPED_ADDRESS, &addr);
+    n = lws_stun_add_integrity(msg, sizeof(msg), n, (const uint8_t*)"pass", 4);
+    n = lws_stun_add_fingerprint(msg, sizeof(msg), n);
+    ASSERT_TRUE(n > 0);
+    ASSERT_EQ(n % 4, 0);
+
+    ASSERT_TRUE(lws_stun_is_message(msg, n));
+    ASSERT_EQ(memcmp(lws_stun_msg_tid(msg), tid, LWS_STUN_TID_SIZE), 0);
+    ASSERT_EQ(lws_stun_check_fingerprint(msg, n), 0);
+    ASSERT_EQ(lws_stun_check_integrity(msg, n, (const uint8_t*)"pass", 4), 0);
+
+    value = lws_stun_find(msg, n, LWS_STUN_ATTR_PRIORITY, &vlen);
+    ASSERT_TRUE(value != NULL && vlen == 4);
+    ASSERT_EQ(value[0], 0x6e);
+    ASSERT_EQ(lws_stun_xor_addr(msg, n, LWS_STUN_ATTR_XOR_MAPPED_ADDRESS, &out), 0);
+    ASSERT_EQ(out.sin_addr.s_addr, addr.sin_addr.s_addr);
+    ASSERT_EQ(out.sin_port, addr.sin_port);
+
+    /* 篡改任一字节：指纹与完整性都失效 */
+    msg[LWS_STUN_HEADER_SIZE + 4] ^= 0x01;
+    ASSERT_EQ(lws_stun_check_fingerprint(msg, n), -1);
+    ASSERT_EQ(lws_stun_check_integrity(msg, n, (const uint8_t*)"pass", 4), -1);
+
+    /* 错误响应 */
+    n = lws_stun_init(msg, sizeof(msg), LWS_STUN_BINDING_ERROR, tid);
+    n = lws_stun_add_error(msg, sizeof(msg), n, 487, "Role Conflict");
+    ASSERT_TRUE(LWS_STUN_IS_ERROR(lws_stun_type(msg)));
+    ASSERT_EQ(lws_stun_error_code(msg, n), 487);
+
+    /* 非STUN：RTP、长度不符、缓冲区不足 */
+    msg[0] = 0x80;
+    ASSERT_FALSE(lws_stun_is_message(msg, n));
+    ASSERT_FALSE(lws_stun_is_message(k_request, sizeof(k_request) - 4));
+    ASSERT_EQ(lws_stun_init(msg, LWS_STUN_HEADER_SIZE - 1, LWS_STUN_BINDING_REQUEST, tid), -1);
+}
+
+/* ========================================
+ * Candidate Tests
+ * ======================================== */
+
+TEST(ice_priority) {
+    /* RFC 8445 §5.1.2.1 */
+    ASSERT_EQ(lws_ice_priority(LWS_ICE_PREF_HOST, 65535, 1), 2130706431u);
+    ASSERT_EQ(lws_ice_priority(LWS_ICE_PREF_HOST, 65535, 2), 2130706430u);
+    ASSERT_EQ(lws_ice_priority(LWS_ICE_PREF_SRFLX, 65535, 1), 1694498815u);
+    ASSERT_TRUE(lws_ice_priority(LWS_ICE_PREF_HOST, 65534, 1) <
+                lws_ice_priority(LWS_ICE_PREF_HOST, 65535, 1));
+    ASSERT_TRUE(lws_ice_priority(LWS_ICE_PREF_RELAY, 65535, 1) <
+                lws_ice_priority(LWS_ICE_PREF_SRFLX, 0, 1));
+}
+
+TEST(ice_cand_write) {
+    lws_ice_cand_t cand;
+    char line[LWS_ICE_CAND_SIZE];
+
+    memset(&cand, 0, sizeof(cand));
+    cand.type = LWS_ICE_CAND_SRFLX;
+    cand.component = 1;
+    cand.priority = 1694498815u;
+    strcpy(cand.foundation, "42");
+    make_addr(&cand.addr, "203.0.113.7", 50000);
+    make_addr(&cand.base, "192.168.1.10", 40000);
+
+    ASSERT_TRUE(lws_ice_cand_write(&cand, line, sizeof(line)) > 0);
+    ASSERT_EQ(strcmp(line, "candidate:42 1 udp 1694498815 203.0.113.7 50000 typ srflx "
+                           "raddr 192.168.1.10 rport 40000"), 0);
+
+    cand.type = LWS_ICE_CAND_HOST;
+    ASSERT_TRUE(lws_ice_cand_write(&cand, line, sizeof(line)) > 0);
+    ASSERT_EQ(strcmp(line, "candidate:42 1 udp 1694498815 203.0.113.7 50000 typ host"), 0);
+    ASSERT_EQ(lws_ice_cand_write(&cand, line, 20), -1);
+}
+
+/* ========================================
+ * Gathering Tests
+ * ======================================== */
+
+TEST(ice_gather_hosts_only) {
+    stun_net_t net;
+    lws_ice_t* ice;
+    const lws_ice_cand_t* cands;
+    struct sockaddr_in host;
+
+    memset(&net, 0, sizeof(net));
+    ice = net_agent(&net, 0);
+    ASSERT_TRUE(ice != NULL);
+
+    /* 第二个接口优先级更低；重复地址被拒绝 */
+    make_addr(&host, "10.0.0.5", 40000);
+    ASSERT_EQ(lws_ice_add_host(ice, &host), 0);
+    ASSERT_EQ(lws_ice_add_host(ice, &host), -1);
+    ASSERT_EQ(net.candidates, 2);
+    ASSERT_EQ(lws_ice_local_candidates(ice, &cands), 2);
+    ASSERT_TRUE(cands[0].priority > cands[1].priority);
+    ASSERT_TRUE(strcmp(cands[0].foundation, cands[1].foundation) != 0);
+
+    /* 没有STUN服务器：立即完成 */
+    ASSERT_EQ(lws_ice_gather(ice, 1000000), 0);
+    ASSERT_EQ(net.done, 1);
+    ASSERT_TRUE(lws_ice_gathering_done(ice));
+    ASSERT_EQ(lws_ice_gather(ice, 1000000), -1);
+
+    lws_ice_destroy(ice);
+}
+
+TEST(ice_gather_parallel) {
+    stun_net_t net;
+    lws_ice_t* ice;
+    const lws_ice_cand_t* cands;
+    int count;
+    int i;
+
+    memset(&net, 0, sizeof(net));
+    net.server_count = 3;
+    for (i = 0; i < 3; i++) {
+        char ip[16];
+        snprintf(ip, sizeof(ip), "198.51.100.%d", i + 1);
+        make_addr(&net.servers[i].addr, ip, 3478);
+        make_addr(&net.servers[i].mapped, "203.0.113.7", 50000);
+    }
+    /* 第三个服务器看到不同映射（例如经另一出口） */
+    make_addr(&net.servers[2].mapped, "203.0.113.8", 50001);
+
+    ice = net_agent(&net, 0);
+    ASSERT_TRUE(ice != NULL);
+    net_run(&net, ice);
+
+    ASSERT_EQ(net.done, 1);
+    ASSERT_EQ(net.send_count, 3);
+    ASSERT_EQ(net.srflx, 2);                /* 相同映射只上报一次 */
+    ASSERT_EQ(net.candidates, 3);
+
+    /* 并行而非串行：三个请求在两个Ta内发出，按Ta节拍 */
+    for (i = 1; i < net.send_count; i++) {
+        ASSERT_TRUE(net.send_times[i] - net.send_times[i - 1] >= LWS_ICE_TA_MS * 1000);
+    }
+    ASSERT_TRUE(net.send_times[2] - net.send_times[0] <= 2 * LWS_ICE_TA_MS * 1000 + STEP_US);
+    ASSERT_TRUE(net.done_us - 1000000 < 500000);
+
+    count = lws_ice_local_candidates(ice, &cands);
+    ASSERT_EQ(count, 3);
+    ASSERT_EQ(cands[1].type, LWS_ICE_CAND_SRFLX);
+    ASSERT_EQ(cands[1].base.sin_addr.s_addr, cands[0].addr.sin_addr.s_addr);
+    ASSERT_EQ(cands[1].priority, lws_ice_priority(LWS_ICE_PREF_SRFLX, 65535, 1));
+    ASSERT_TRUE(strcmp(cands[1].foundation, cands[2].foundation) != 0);
+
+    lws_ice_destroy(ice);
+}
+
+TEST(ice_gather_retransmit) {
+    stun_net_t net;
+    lws_ice_t* ice;
+
+    memset(&net, 0, sizeof(net));
+    net.server_count = 1;
+    make_addr(&net.servers[0].addr, "198.51.100.1", 3478);
+    make_addr(&net.servers[0].mapped, "203.0.113.7", 50000);
+    net.servers[0].drop = 2;
+
+    ice = net_agent(&net, 0);
+    ASSERT_TRUE(ice != NULL);
+    net_run(&net, ice);
+
+    /* 丢失两次：RTO 500ms后重传，再1000ms后第三次成功 */
+    ASSERT_EQ(net.done, 1);
+    ASSERT_EQ(net.srflx, 1);
+    ASSERT_EQ(net.servers[0].requests, 3);
+    ASSERT_TRUE(net.send_times[1] - net.send_times[0] >= LWS_ICE_RTO_MS * 1000);
+    ASSERT_TRUE(net.send_times[2] - net.send_times[1] >= 2 * LWS_ICE_RTO_MS * 1000);
+
+    lws_ice_destroy(ice);
+}
+
+TEST(ice_gather_deadline) {
+    stun_net_t net;
+    lws_ice_t* ice;
+
+    memset(&net, 0, sizeof(net));
+    net.server_count = 2;
+    make_addr(&net.servers[0].addr, "198.51.100.1", 3478);
+    make_addr(&net.servers[0].mapped, "203.0.113.7", 50000);
+    make_addr(&net.servers[1].addr, "198.51.100.2", 3478);
+    net.servers[1].silent = 1;
+
+    ice = net_agent(&net, 800);
+    ASSERT_TRUE(ice != NULL);
+    net_run(&net, ice);
+
+    /* 无响应的服务器不拖延超过截止时间；已得到的候选保留 */
+    ASSERT_EQ(net.done, 1);
+    ASSERT_EQ(net.srflx, 1);
+    ASSERT_TRUE(net.done_us - 1000000 >= 800000);
+    ASSERT_TRUE(net.done_us - 1000000 <= 800000 + STEP_US);
+    ASSERT_TRUE(net.servers[1].requests >= 2);
+
+    /* 截止后的响应被忽略 */
+    lws_ice_poll(ice, net.now + 5000000);
+    ASSERT_EQ(net.done, 1);
+
+    lws_ice_destroy(ice);
+}
+
+TEST(ice_gather_error_response) {
+    stun_net_t net;
+    lws_ice_t* ice;
+    uint8_t msg[LWS_STUN_MAX_MESSAGE];
+    uint8_t tid[LWS_STUN_TID_SIZE];
+    struct sockaddr_in mapped;
+    int n;
+
+    memset(&net, 0, sizeof(net));
+    net.server_count = 1;
+    make_addr(&net.servers[0].addr, "198.51.100.1", 3478);
+    net.servers[0].error = 400;
+
+    ice = net_agent(&net, 0);
+    ASSERT_TRUE(ice != NULL);
+
+    /* 伪造的响应（事务ID不符）既不产生候选也不结束事务 */
+    make_addr(&mapped, "6.6.6.6", 6666);
+    lws_stun_tid(tid);
+    n = lws_stun_init(msg, sizeof(msg), LWS_STUN_BINDING_SUCCESS, tid);
+    n = lws_stun_add_xor_addr(msg, sizeof(msg), n, LWS_STUN_ATTR_XOR_MAPPED_ADDRESS, &mapped);
+    ASSERT_EQ(lws_ice_input(ice, &net.servers[0].addr, msg, n, 1000000), 1);
+    ASSERT_EQ(net.srflx, 0);
+
+    net_run(&net, ice);
+    ASSERT_EQ(net.done, 1);
+    ASSERT_EQ(net.srflx, 0);
+    ASSERT_EQ(net.servers[0].requests, 1);  /* 错误响应不重传 */
+
+    /* 非STUN数据不被消费 */
+    msg[0] = 0x80;
+    ASSERT_EQ(lws_ice_input(ice, &net.servers[0].addr, msg, n, net.now), 0);
+
+    lws_ice_destroy(ice);
+}
+
+/* ========================================
+ * Check Tests
+ * ======================================== */
+
+TEST(ice_check_nat) {
+    nominate_trace_t agg_trace, reg_trace;
+    int aggressive = sim_connect_ms(1, &agg_trace);
+    int regular = sim_connect_ms(0, &reg_trace);
+
+    /* 两种提名都经NAT连通：A用host->B，B选中A的srflx(NAT)地址 */
+    ASSERT_TRUE(aggressive > 0);
+    ASSERT_TRUE(regular > 0);
+    ASSERT_TRUE(aggressive <= regular);
+
+    /* 激进提名：第一个检查就携带USE-CANDIDATE */
+    ASSERT_EQ(agg_trace.nominate_check, 1);
+    ASSERT_EQ(agg_trace.responses_before, 0);
+
+    /* 常规提名：先无USE-CANDIDATE检查成功，再对有效配对发第二个带USE-CANDIDATE的检查 */
+    ASSERT_TRUE(reg_trace.nominate_check >= 2);
+    ASSERT_TRUE(reg_trace.responses_before >= 1);
+    printf("    time to connected: aggressive %d ms, regular %d ms (RTT %d ms)\n",
+           aggressive, regular, 2 * LATENCY_US / 1000);
+}
+
+TEST(ice_check_trickle) {
+    ice_net_t net;
+    lws_ice_stats_t stats;
+    uint8_t media[4] = { 0x80, 0, 0, 0 };
+    int i;
+
+    sim_init(&net, NULL);
+    lws_ice_start(net.ice[0], net.now);
+    lws_ice_start(net.ice[1], net.now);
+
+    /* 没有对端候选时保持CHECKING，不发送 */
+    for (i = 0; i < 200; i++) {
+        sim_step(&net);
+    }
+    ASSERT_EQ(lws_ice_state(net.ice[0]), LWS_ICE_CHECKING);
+    ASSERT_EQ(lws_ice_send(net.ice[0], media, sizeof(media)), -1);
+
+    /* 候选陆续到达后配对并连通 */
+    sim_signal(&net, 0);
+    sim_run(&net, 5000);
+    ASSERT_EQ(net.state[0], LWS_ICE_CONNECTED);
+    ASSERT_EQ(net.state[1], LWS_ICE_CONNECTED);
+
+    lws_ice_get_stats(net.ice[1], &stats);
+    ASSERT_EQ(stats.pairs, 2);
+    ASSERT_TRUE(stats.checks_received > 0);
+    ASSERT_TRUE(stats.connect_ms >= 200);
+
+    /* 选中配对上双向传媒体 */
+    ASSERT_EQ(lws_ice_send(net.ice[0], media, sizeof(media)), 0);
+    ASSERT_EQ(lws_ice_send(net.ice[1], media, sizeof(media)), 0);
+    for (i = 0; i < 50; i++) {
+        sim_step(&net);
+    }
+    ASSERT_EQ(net.media[0], 1);
+    ASSERT_EQ(net.media[1], 1);
+
+    sim_destroy(&net);
+}
+
+TEST(ice_check_role_conflict) {
+    ice_net_t net;
+
+    sim_init(&net, NULL);
+    lws_ice_set_controlling(net.ice[1], 1);     /* 双方都认为自己是controlling */
+    sim_signal(&net, 1);
+    lws_ice_start(net.ice[0], net.now);
+    lws_ice_start(net.ice[1], net.now);
+    sim_run(&net, 10000);
+
+    ASSERT_EQ(lws_ice_state(net.ice[0]), LWS_ICE_CONNECTED);
+    ASSERT_EQ(lws_ice_state(net.ice[1]), LWS_ICE_CONNECTED);
+
+    sim_destroy(&net);
+}
+
+TEST(ice_check_unreachable) {
+    ice_net_t net;
+    lws_ice_cand_t cand;
+
+    sim_init(&net, NULL);
+    memset(&cand, 0, sizeof(cand));
+    cand.type = LWS_ICE_CAND_HOST;
+    cand.component = 1;
+    cand.priority = lws_ice_priority(LWS_ICE_PREF_HOST, 65535, 1);
+    strcpy(cand.foundation, "1");
+    make_addr(&cand.addr, "10.9.9.9", 9);
+    cand.base = cand.addr;
+    ASSERT_EQ(lws_ice_add_remote(net.ice[0], &cand), 0);
+    ASSERT_EQ(lws_ice_add_remote(net.ice[0], &cand), -1);  /* 重复 */
+    cand.component = 2;
+    ASSERT_EQ(lws_ice_add_remote(net.ice[0], &cand), -1);  /* 只用component 1 */
+    lws_ice_end_of_candidates(net.ice[0]);
+
+    lws_ice_start(net.ice[0], net.now);
+    while (net.now - net.start < 20000000 && lws_ice_state(net.ice[0]) == LWS_ICE_CHECKING) {
+        sim_step(&net);
+    }
+
+    /* 重传用尽后失败，早于检查超时 */
+    ASSERT_EQ(net.state[0], LWS_ICE_FAILED);
+    ASSERT_TRUE(net.now - net.start < (uint64_t)LWS_ICE_CHECK_TIMEOUT_MS * 1000);
+
+    sim_destroy(&net);
+}
+
+TEST(ice_check_bad_auth) {
+    ice_net_t net;
+    lws_ice_stats_t stats;
+    int i;
+
+    sim_init(&net, NULL);
+    lws_ice_set_local_auth(net.ice[1], "BBBB", "wrong-password-012345");
+    sim_signal(&net, 1);
+    lws_ice_start(net.ice[0], net.now);
+    for (i = 0; i < 300; i++) {
+        sim_step(&net);
+    }
+
+    /* B以401拒绝A的检查，不学习也不触发检查 */
+    ASSERT_EQ(net.last_error, 401);
+    lws_ice_get_stats(net.ice[1], &stats);
+    ASSERT_EQ(stats.checks_received, 0u);
+    ASSERT_EQ(lws_ice_state(net.ice[1]), LWS_ICE_NEW);
+
+    sim_destroy(&net);
+}
+
+TEST(ice_check_consent) {
+    lws_ice_config_t config;
+    lws_ice_stats_t before, after;
+    ice_net_t net;
+    uint8_t media[4] = { 0x80, 0, 0, 0 };
+    uint64_t lost;
+
+    memset(&config, 0, sizeof(config));
+    config.consent_interval_ms = 500;
+    config.consent_timeout_ms = 2000;
+    sim_init(&net, &config);
+    sim_signal(&net, 1);
+    lws_ice_start(net.ice[0], net.now);
+    lws_ice_start(net.ice[1], net.now);
+    sim_run(&net, 5000);
+    ASSERT_EQ(lws_ice_state(net.ice[0]), LWS_ICE_CONNECTED);
+
+    /* 同意检查持续刷新：远超同意超时仍保持连通 */
+    lws_ice_get_stats(net.ice[0], &before);
+    while (net.now - net.start < 10000000) {
+        sim_step(&net);
+    }
+    lws_ice_get_stats(net.ice[0], &after);
+    ASSERT_EQ(lws_ice_state(net.ice[0]), LWS_ICE_CONNECTED);
+    ASSERT_TRUE(after.checks_sent - before.checks_sent >= 10);
+
+    /* 路径中断：同意超时后失败并停止发送 */
+    net.blackhole = 1;
+    lost = net.now;
+    while (net.now - lost < 5000000 && lws_ice_state(net.ice[0]) == LWS_ICE_CONNECTED) {
+        sim_step(&net);
+    }
+    ASSERT_EQ(net.state[0], LWS_ICE_FAILED);
+    ASSERT_TRUE(net.now - lost <= 2000000);
+    ASSERT_EQ(lws_ice_send(net.ice[0], media, sizeof(media)), -1);
+    ASSERT_EQ(lws_ice_selected(net.ice[0], NULL, NULL), -1);
+
+    sim_destroy(&net);
+}
+
+TEST(ice_check_lite) {
+    lws_ice_config_t config;
+    lws_ice_stats_t stats;
+    lws_ice_cand_t local;
+    struct sockaddr_in remote;
+    ice_net_t net;
+    uint8_t media[4] = { 0x80, 0, 0, 0 };
+    int i;
+
+    /* B是公网上的lite agent：无检查表，只应答并锁定A提名的地址 */
+    sim_init(&net, NULL);
+    lws_ice_destroy(net.ice[1]);
+    memset(&config, 0, sizeof(config));
+    config.lite = 1;
+    net.ice[1] = sim_agent(&net, 1, &config);
+    ASSERT_TRUE(net.ice[1] != NULL);
+    ASSERT_TRUE(lws_ice_gathering_done(net.ice[1]));
+    lws_ice_set_controlling(net.ice[1], 1);     /* lite总是controlled */
+
+    sim_signal(&net, 1);
+    lws_ice_start(net.ice[0], net.now);
+    lws_ice_start(net.ice[1], net.now);
+    ASSERT_EQ(lws_ice_send(net.ice[1], media, sizeof(media)), -1);
+    sim_run(&net, 5000);
+
+    ASSERT_EQ(net.state[0], LWS_ICE_CONNECTED);
+    ASSERT_EQ(net.state[1], LWS_ICE_CONNECTED);
+    ASSERT_EQ(lws_ice_selected(net.ice[1], &local, &remote), 0);
+    ASSERT_TRUE(addr_eq(&remote, &net.a_nat));
+    ASSERT_TRUE(addr_eq(&local.addr, &net.b_host));
+
+    lws_ice_get_stats(net.ice[1], &stats);
+    ASSERT_EQ(stats.pairs, 0);
+    ASSERT_EQ(stats.checks_sent, 0u);
+    ASSERT_TRUE(stats.checks_received > 0);
+    ASSERT_TRUE(stats.connect_ms >= 0);
+
+    ASSERT_EQ(lws_ice_send(net.ice[0], media, sizeof(media)), 0);
+    ASSERT_EQ(lws_ice_send(net.ice[1], media, sizeof(media)), 0);
+    for (i = 0; i < 50; i++) {
+        sim_step(&net);
+    }
+    ASSERT_EQ(net.media[0], 1);
+    ASSERT_EQ(net.media[1], 1);
+
+    sim_destroy(&net);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_ice Unit Tests\n");
+    printf("==================================================\n\n");
+
+    printf("STUN Tests:\n");
+    printf("--------------------------------------------------\n");
+    run_test_stun_rfc5769_request();
+    run_test_stun_rfc5769_response();
+    run_test_stun_build_parse();
+
+    printf("\nCandidate Tests:\n");
+    printf("--------------------------------------------------\n");
+    run_test_ice_priority();
+    run_test_ice_cand_write();
+
+    printf("\nGathering Tests:\n");
+    printf("--------------------------------------------------\n");
+    run_test_ice_gather_hosts_only();
+    run_test_ice_gather_parallel();
+    run_test_ice_gather_retransmit();
+    run_test_ice_gather_deadline();
+    run_test_ice_gather_error_response();
+
+    printf("\nCheck Tests:\n");
+    printf("--------------------------------------------------\n");
+    run_test_ice_check_nat();
+    run_test_ice_check_trickle();
+    run_test_ice_check_role_conflict();
+    run_test_ice_check_unreachable();
+    run_test_ice_check_bad_auth();
+    run_test_ice_check_consent();
+    run_test_ice_check_lite();
+
+    printf("\n==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,414 @@
+/**
+ * @file lwsip_loc_test.c
+ * @brief Unit tests and benchmark for lws_loc.c (embedded registrar)
+ *
+ * Test coverage:
+ * - Binding add/refresh/remove
+ * - Multiple contacts per AOR
+ * - Expiry index ordering
+ * - Hash table growth and tombstone reuse
+ * - Registrar digest challenge/verify round trip
+ * - 100k bindings benchmark (insert, lookup, refresh, expire, bytes/binding)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lws_loc.h"
+#include "lws_auth.h"
+#include "lws_err.h"
+#include "lws_mem.h"
+#include "lws_log.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+#define ASSERT_NE(a, b) ASSERT_TRUE((a) != (b))
+#define ASSERT_NULL(ptr) ASSERT_TRUE((ptr) == NULL)
+#define ASSERT_NOT_NULL(ptr) ASSERT_TRUE((ptr) != NULL)
+#define ASSERT_STREQ(a, b) ASSERT_TRUE(strcmp((a), (b)) == 0)
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* ========================================
+ * Location service tests
+ * ======================================== */
+
+TEST(loc_bind_lookup)
+{
+    lws_loc_t* loc = lws_loc_create(0);
+    lws_loc_contact_t contacts[4];
+    ASSERT_NOT_NULL(loc);
+
+    ASSERT_EQ(lws_loc_bind(loc, "sip:1001@example.com", "sip:1001@10.0.0.1:5060", 60, 0), LWS_OK);
+    ASSERT_EQ(lws_loc_lookup(loc, "sip:1001@example.com", contacts, 4, 0), 1);
+    ASSERT_STREQ(contacts[0].contact, "sip:1001@10.0.0.1:5060");
+    ASSERT_EQ(contacts[0].expires, 60);
+
+    ASSERT_EQ(lws_loc_lookup(loc, "sip:1002@example.com", contacts, 4, 0), 0);
+
+    lws_loc_destroy(loc);
+}
+
+TEST(loc_multiple_contacts)
+{
+    lws_loc_t* loc = lws_loc_create(0);
+    lws_loc_contact_t contacts[LWS_LOC_MAX_CONTACTS];
+    lws_loc_stats_t stats;
+    ASSERT_NOT_NULL(loc);
+
+    lws_loc_bind(loc, "sip:1001@example.com", "sip:1001@10.0.0.1", 60, 0);
+    lws_loc_bind(loc, "sip:1001@example.com", "sip:1001@10.0.0.2", 120, 0);
+    /* 刷新已有绑定不增加数量 */
+    lws_loc_bind(loc, "sip:1001@example.com", "sip:1001@10.0.0.1", 300, 0);
+
+    ASSERT_EQ(lws_loc_lookup(loc, "sip:1001@example.com", contacts, LWS_LOC_MAX_CONTACTS, 0), 2);
+
+    lws_loc_get_stats(loc, &stats);
+    ASSERT_EQ(stats.aor_count, 1);
+    ASSERT_EQ(stats.binding_count, 2);
+
+    /* expires=0 删除单个Contact */
+    lws_loc_bind(loc, "sip:1001@example.com", "sip:1001@10.0.0.2", 0, 0);
+    ASSERT_EQ(lws_loc_lookup(loc, "sip:1001@example.com", contacts, LWS_LOC_MAX_CONTACTS, 0), 1);
+    ASSERT_STREQ(contacts[0].contact, "sip:1001@10.0.0.1");
+
+    /* Contact: * */
+    ASSERT_EQ(lws_loc_unbind_all(loc, "sip:1001@example.com"), 1);
+    lws_loc_get_stats(loc, &stats);
+    ASSERT_EQ(stats.aor_count, 0);
+    ASSERT_EQ(stats.binding_count, 0);
+
+    lws_loc_destroy(loc);
+}
+
+TEST(loc_contact_limit)
+{
+    lws_loc_t* loc = lws_loc_create(0);
+    lws_loc_contact_t contacts[LWS_LOC_MAX_CONTACTS];
+    char contact[64];
+    int i;
+    ASSERT_NOT_NULL(loc);
+
+    for (i = 0; i <= LWS_LOC_MAX_CONTACTS; i++) {
+        snprintf(contact, sizeof(contact), "sip:1001@10.0.0.%d", i);
+        ASSERT_EQ(lws_loc_bind(loc, "sip:1001@example.com", contact, 100 + i, 0), LWS_OK);
+    }
+
+    /* 最早过期的 10.0.0.0 被替换 */
+    ASSERT_EQ(lws_loc_lookup(loc, "sip:1001@example.com", contacts,
+                             LWS_LOC_MAX_CONTACTS, 0), LWS_LOC_MAX_CONTACTS);
+    for (i = 0; i < LWS_LOC_MAX_CONTACTS; i++) {
+        ASSERT_TRUE(strcmp(contacts[i].contact, "sip:1001@10.0.0.0") != 0);
+    }
+
+    lws_loc_destroy(loc);
+}
+
+static int g_expired_count = 0;
+
+static void on_expired(const char* aor, const char* contact, void* userdata)
+{
+    (void)aor;
+    (void)contact;
+    (void)userdata;
+    g_expired_count++;
+}
+
+TEST(loc_expire_order)
+{
+    lws_loc_t* loc = lws_loc_create(0);
+    lws_loc_contact_t contacts[4];
+    ASSERT_NOT_NULL(loc);
+
+    lws_loc_bind(loc, "sip:a@example.com", "sip:a@10.0.0.1", 30, 0);
+    lws_loc_bind(loc, "sip:b@example.com", "sip:b@10.0.0.2", 10, 0);
+    lws_loc_bind(loc, "sip:c@example.com", "sip:c@10.0.0.3", 20, 0);
+    ASSERT_EQ(lws_loc_next_expiry(loc), 10000);
+
+    /* 刷新b后，最早过期的变成c */
+    lws_loc_bind(loc, "sip:b@example.com", "sip:b@10.0.0.2", 60, 0);
+    ASSERT_EQ(lws_loc_next_expiry(loc), 20000);
+
+    g_expired_count = 0;
+    ASSERT_EQ(lws_loc_expire(loc, 19999, on_expired, NULL), 0);
+    ASSERT_EQ(lws_loc_expire(loc, 30000, on_expired, NULL), 2);
+    ASSERT_EQ(g_expired_count, 2);
+
+    ASSERT_EQ(lws_loc_lookup(loc, "sip:a@example.com", contacts, 4, 30000), 0);
+    ASSERT_EQ(lws_loc_lookup(loc, "sip:b@example.com", contacts, 4, 30000), 1);
+    ASSERT_EQ(contacts[0].expires, 30);
+
+    lws_loc_destroy(loc);
+}
+
+TEST(loc_growth_and_tombstones)
+{
+    lws_loc_t* loc = lws_loc_create(4);
+    lws_loc_contact_t c;
+    lws_loc_stats_t stats;
+    char aor[64];
+    int i;
+    ASSERT_NOT_NULL(loc);
+
+    for (i = 0; i < 5000; i++) {
+        snprintf(aor, sizeof(aor), "sip:%d@example.com", i);
+        ASSERT_EQ(lws_loc_bind(loc, aor, "sip:x@10.0.0.1", 60, 0), LWS_OK);
+    }
+    /* 反复删除/插入，tombstone不应导致探测死循环 */
+    for (i = 0; i < 5000; i += 2) {
+        snprintf(aor, sizeof(aor), "sip:%d@example.com", i);
+        lws_loc_unbind_all(loc, aor);
+        snprintf(aor, sizeof(aor), "sip:new%d@example.com", i);
+        ASSERT_EQ(lws_loc_bind(loc, aor, "sip:x@10.0.0.1", 60, 0), LWS_OK);
+    }
+    for (i = 1; i < 5000; i += 2) {
+        snprintf(aor, sizeof(aor), "sip:%d@example.com", i);
+        ASSERT_EQ(lws_loc_lookup(loc, aor, &c, 1, 0), 1);
+    }
+
+    lws_loc_get_stats(loc, &stats);
+    ASSERT_EQ(stats.aor_count, 5000);
+    ASSERT_TRUE(stats.aor_count * 10 <= stats.slot_count * 7);
+
+    lws_loc_destroy(loc);
+}
+
+/* ========================================
+ * Registrar digest tests
+ * ======================================== */
+
+TEST(auth_server_round_trip)
+{
+    lws_auth_challenge_t challenge;
+    lws_auth_credentials_t cred = { "1001", "secret" };
+    lws_auth_response_t response;
+    lws_auth_authorization_t auth;
+    char nonce[LWS_AUTH_NONCE_LEN + 1];
+    char header[1024];
+    uint32_t now = 1700000000;
+
+    ASSERT_EQ(lws_auth_generate_nonce("server-secret", now, 7, nonce, sizeof(nonce)), 0);
+    ASSERT_EQ(lws_auth_build_challenge_header("example.com", nonce, 0, header, sizeof(header)), 0);
+
+    /* 客户端侧 */
+    ASSERT_EQ(lws_auth_parse_challenge(header, &challenge), 0);
+    ASSERT_EQ(lws_auth_generate_response(&challenge, &cred, "REGISTER",
+                                         "sip:example.com", &response), 0);
+    ASSERT_EQ(lws_auth_build_authorization_header(&response, "1001", header, sizeof(header)), 0);
+
+    /* 服务端侧 */
+    ASSERT_EQ(lws_auth_parse_authorization(header, &auth), 0);
+    ASSERT_STREQ(auth.username, "1001");
+    ASSERT_STREQ(auth.nonce, nonce);
+    ASSERT_STREQ(auth.nc, "00000001");
+    ASSERT_EQ(lws_auth_verify_response(&auth, "REGISTER", "secret"), 0);
+    ASSERT_EQ(lws_auth_verify_response(&auth, "REGISTER", "wrong"), -1);
+
+    /* 摘要URI须与Request-URI一致，参数不参与比较 */
+    ASSERT_STREQ(auth.uri, "sip:example.com");
+    ASSERT_EQ(lws_auth_check_uri(&auth, "sip:example.com"), 0);
+    ASSERT_EQ(lws_auth_check_uri(&auth, "SIP:Example.COM;transport=udp"), 0);
+    ASSERT_EQ(lws_auth_check_uri(&auth, "sip:other.com"), -1);
+    ASSERT_EQ(lws_auth_check_uri(&auth, "sip:example.com:5070"), -1);
+    ASSERT_EQ(lws_auth_check_uri(&auth, "sip:1001@example.com"), -1);
+    ASSERT_EQ(lws_auth_check_uri(&auth, "sips:example.com"), -1);
+
+    ASSERT_EQ(lws_auth_check_nonce("server-secret", auth.nonce, now + 10, 300), 0);
+    ASSERT_EQ(lws_auth_check_nonce("server-secret", auth.nonce, now + 301, 300), 1);
+    ASSERT_EQ(lws_auth_check_nonce("other-secret", auth.nonce, now, 300), -1);
+}
+
+TEST(auth_nonce_replay)
+{
+    static lws_auth_nonce_table_t table;
+    lws_auth_challenge_t challenge;
+    lws_auth_credentials_t cred = { "1001", "secret" };
+    lws_auth_response_t response;
+    lws_auth_authorization_t auth;
+    char nonce[LWS_AUTH_NONCE_LEN + 1];
+    char other[LWS_AUTH_NONCE_LEN + 1];
+    char header[1024];
+    uint32_t now = 1700000000;
+
+    memset(&table, 0, sizeof(table));
+
+    /* 同一秒签发的nonce互不相同 */
+    ASSERT_EQ(lws_auth_nonce_issue(&table, "server-secret", now, nonce, sizeof(nonce)), 0);
+    ASSERT_EQ(lws_auth_nonce_issue(&table, "server-secret", now, other, sizeof(other)), 0);
+    ASSERT_TRUE(strcmp(nonce, other) != 0);
+    ASSERT_EQ(lws_auth_check_nonce("server-secret", nonce, now, 300), 0);
+    ASSERT_EQ(lws_auth_check_nonce("server-secret", other, now, 300), 0);
+
+    ASSERT_EQ(lws_auth_build_challenge_header("example.com", nonce, 0, header, sizeof(header)), 0);
+    ASSERT_EQ(lws_auth_parse_challenge(header, &challenge), 0);
+    ASSERT_EQ(lws_auth_generate_response(&challenge, &cred, "REGISTER",
+                                         "sip:example.com", &response), 0);
+    ASSERT_EQ(lws_auth_build_authorization_header(&response, "1001", header, sizeof(header)), 0);
+    ASSERT_EQ(lws_auth_parse_authorization(header, &auth), 0);
+
+    /* nc=1只接受一次，重放被拒绝 */
+    ASSERT_EQ(lws_auth_nonce_use(&table, &auth), 0);
+    ASSERT_EQ(lws_auth_nonce_use(&table, &auth), -1);
+
+    /* 更大的nc可继续使用该nonce，回退的nc不行 */
+    strcpy(auth.nc, "00000003");
+    ASSERT_EQ(lws_auth_nonce_use(&table, &auth), 0);
+    strcpy(auth.nc, "00000002");
+    ASSERT_EQ(lws_auth_nonce_use(&table, &auth), -1);
+    strcpy(auth.nc, "3");
+    ASSERT_EQ(lws_auth_nonce_use(&table, &auth), -1);
+
+    /* 无qop：nonce只能用一次 */
+    memcpy(auth.nonce, other, sizeof(other));
+    auth.qop[0] = '\0';
+    ASSERT_EQ(lws_auth_nonce_use(&table, &auth), 0);
+    ASSERT_EQ(lws_auth_nonce_use(&table, &auth), -1);
+
+    /* 未签发的nonce */
+    ASSERT_EQ(lws_auth_generate_nonce("server-secret", now, 999, auth.nonce, sizeof(auth.nonce)), 0);
+    ASSERT_EQ(lws_auth_nonce_use(&table, &auth), -1);
+
+    /* 表满时淘汰最早签发的nonce */
+    for (int i = 0; i < LWS_AUTH_NONCE_SLOTS; i++) {
+        ASSERT_EQ(lws_auth_nonce_issue(&table, "server-secret", now + 1 + i,
+                                       other, sizeof(other)), 0);
+    }
+    memcpy(auth.nonce, nonce, sizeof(nonce));
+    strcpy(auth.qop, "auth");
+    strcpy(auth.nc, "00000009");
+    ASSERT_EQ(lws_auth_nonce_use(&table, &auth), -1);
+    memcpy(auth.nonce, other, sizeof(other));
+    ASSERT_EQ(lws_auth_nonce_use(&table, &auth), 0);
+}
+
+/* ========================================
+ * Benchmark
+ * ======================================== */
+
+#define BENCH_BINDINGS 100000
+
+TEST(loc_bench_100k)
+{
+    lws_loc_t* loc = lws_loc_create(BENCH_BINDINGS);
+    lws_loc_contact_t c;
+    lws_loc_stats_t stats;
+    char aor[64];
+    char contact[64];
+    double t0, t1;
+    int i;
+    ASSERT_NOT_NULL(loc);
+
+    /* 插入：有效期分散在 [60, 3660) 秒 */
+    t0 = now_sec();
+    for (i = 0; i < BENCH_BINDINGS; i++) {
+        snprintf(aor, sizeof(aor), "sip:%d@example.com", 100000 + i);
+        snprintf(contact, sizeof(contact), "sip:%d@10.%d.%d.%d:5060",
+                 100000 + i, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+        ASSERT_EQ(lws_loc_bind(loc, aor, contact, 60 + (i * 7919) % 3600, 0), LWS_OK);
+    }
+    t1 = now_sec();
+    printf("    insert:  %.0f ns/op\n", (t1 - t0) * 1e9 / BENCH_BINDINGS);
+
+    t0 = now_sec();
+    for (i = 0; i < BENCH_BINDINGS; i++) {
+        snprintf(aor, sizeof(aor), "sip:%d@example.com", 100000 + i);
+        ASSERT_EQ(lws_loc_lookup(loc, aor, &c, 1, 0), 1);
+    }
+    t1 = now_sec();
+    printf("    lookup:  %.0f ns/op\n", (t1 - t0) * 1e9 / BENCH_BINDINGS);
+
+    t0 = now_sec();
+    for (i = 0; i < BENCH_BINDINGS; i++) {
+        snprintf(aor, sizeof(aor), "sip:%d@example.com", 100000 + i);
+        snprintf(contact, sizeof(contact), "sip:%d@10.%d.%d.%d:5060",
+                 100000 + i, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+        ASSERT_EQ(lws_loc_bind(loc, aor, contact, 3600, 1000), LWS_OK);
+    }
+    t1 = now_sec();
+    printf("    refresh: %.0f ns/op\n", (t1 - t0) * 1e9 / BENCH_BINDINGS);
+
+    lws_loc_get_stats(loc, &stats);
+    printf("    bindings=%u slots=%u memory=%llu bytes (%u bytes/binding)\n",
+           stats.binding_count, stats.slot_count,
+           (unsigned long long)stats.memory_bytes, stats.bytes_per_binding);
+    ASSERT_EQ(stats.binding_count, BENCH_BINDINGS);
+
+    /* 无到期绑定时的周期清理应为O(1) */
+    t0 = now_sec();
+    for (i = 0; i < BENCH_BINDINGS; i++) {
+        lws_loc_expire(loc, 2000, NULL, NULL);
+    }
+    t1 = now_sec();
+    printf("    idle sweep: %.1f ns/op\n", (t1 - t0) * 1e9 / BENCH_BINDINGS);
+
+    t0 = now_sec();
+    ASSERT_EQ(lws_loc_expire(loc, 3601000, NULL, NULL), BENCH_BINDINGS);
+    t1 = now_sec();
+    printf("    expire all: %.0f ns/binding\n", (t1 - t0) * 1e9 / BENCH_BINDINGS);
+
+    lws_loc_destroy(loc);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_loc Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_loc_bind_lookup();
+    run_test_loc_multiple_contacts();
+    run_test_loc_contact_limit();
+    run_test_loc_expire_order();
+    run_test_loc_growth_and_tombstones();
+    run_test_auth_server_round_trip();
+    run_test_auth_nonce_replay();
+    run_test_loc_bench_100k();
+
+    printf("\n==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,751 @@
+/**
+ * @file lwsip_rec_test.c
+ * @brief Unit tests for lws_rec.c (asynchronous recording writer)
+ *
+ * Test coverage:
+ * - Frames are written in order; queued frames are merged into batches
+ * - Frames are held by reference until written, invalid frames are rejected
+ * - A stalled writer never blocks the producer: the bounded ring drops and
+ *   counts the overflow
+ * - lws_rec_close() writes everything still queued (flush on hangup)
+ * - Several recorders share one writer thread, which restarts after the
+ *   last recorder closes
+ * - Stereo: local and remote legs interleaved left/right, aligned on the
+ *   wall clock, timestamp gaps and a late-starting leg filled with silence
+ * - Stereo: a leg without audio does not hold back the other
+ * - Packets: encoded payloads passed through unchanged, positioned from the
+ *   RTP timestamps (gaps kept, duplicates discarded, timestamp resets
+ *   re-anchored on the wall clock)
+ * - Benchmark: CPU per recorded call, decoded audio vs passthrough packets
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "lws_rec.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+#define ASSERT_NULL(p) ASSERT_TRUE((p) == NULL)
+#define ASSERT_NOT_NULL(p) ASSERT_TRUE((p) != NULL)
+
+#define SAMPLE_RATE     8000
+#define FRAME_SAMPLES   160         /* 20ms */
+#define MAX_SAMPLES     (FRAME_SAMPLES * 64)
+
+/* ========================================
+ * Fake writer
+ * ======================================== */
+
+/* 记录写入的PCM；gate非0时在回调中阻塞，模拟磁盘卡顿 */
+typedef struct {
+    int16_t pcm[MAX_SAMPLES];
+    int samples;
+    int writes;
+    int max_batch;
+    int gate;
+    int entered;
+    int channels;                   /* 0按单声道 */
+} writer_ctx_t;
+
+static int fake_write(void* param, const int16_t* pcm, int samples)
+{
+    writer_ctx_t* w = (writer_ctx_t*)param;
+    int channels = w->channels > 0 ? w->channels : 1;
+
+    __atomic_store_n(&w->entered, 1, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&w->gate, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+
+    if ((w->samples + samples) * channels <= MAX_SAMPLES) {
+        memcpy(w->pcm + w->samples * channels, pcm, (size_t)samples * channels * sizeof(int16_t));
+        __atomic_store_n(&w->samples, w->samples + samples, __ATOMIC_RELEASE);
+    }
+    w->writes++;
+    if (samples > w->max_batch) {
+        w->max_batch = samples;
+    }
+    return 0;
+}
+
+/* 第n帧的采样为n*FRAME_SAMPLES起的递增值 */
+static lws_frame_t* make_frame(int n)
+{
+    lws_frame_t* frame = lws_frame_alloc(FRAME_SAMPLES * (int)sizeof(int16_t));
+    int16_t* pcm = (int16_t*)frame->data;
+    int i;
+
+    frame->kind = LWS_FRAME_AUDIO;
+    frame->size = FRAME_SAMPLES * (int)sizeof(int16_t);
+    frame->samples = FRAME_SAMPLES;
+    frame->sample_rate = SAMPLE_RATE;
+    frame->channels = 1;
+    for (i = 0; i < FRAME_SAMPLES; i++) {
+        pcm[i] = (int16_t)(n * FRAME_SAMPLES + i);
+    }
+    return frame;
+}
+
+static int push_new(lws_rec_t* rec, int n)
+{
+    lws_frame_t* frame = make_frame(n);
+    int ret = lws_rec_push(rec, frame);
+
+    lws_frame_unref(frame);
+    return ret;
+}
+
+static int pcm_sequential(const writer_ctx_t* w, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (w->pcm[i] != (int16_t)i) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* 推入第0帧，等写线程取走它并卡在写入中，之后的帧都留在队列里 */
+static int writer_stalled(lws_rec_t* rec, writer_ctx_t* w)
+{
+    int i;
+
+    if (push_new(rec, 0) != 0) {
+        return 0;
+    }
+    for (i = 0; i < 500 && !__atomic_load_n(&w->entered, __ATOMIC_ACQUIRE); i++) {
+        usleep(1000);
+    }
+    return __atomic_load_n(&w->entered, __ATOMIC_ACQUIRE);
+}
+
+/* 双路帧：第n帧（20ms）的time_us与时间戳，采样值为±(n*FRAME_SAMPLES+i) */
+static int push_leg(lws_rec_t* rec, lws_rec_leg_t leg, int n, uint64_t time_us)
+{
+    lws_frame_t* frame = make_frame(n);
+    int16_t* pcm = (int16_t*)frame->data;
+    int ret;
+    int i;
+
+    if (leg == LWS_REC_REMOTE) {
+        for (i = 0; i < FRAME_SAMPLES; i++) {
+            pcm[i] = (int16_t)-pcm[i];
+        }
+    }
+    frame->timestamp = (uint32_t)(n * FRAME_SAMPLES);
+    frame->time_us = time_us;
+    ret = lws_rec_push_leg(rec, leg, frame);
+    lws_frame_unref(frame);
+    return ret;
+}
+
+/* 编码包回调：记录每个包的位置、时长与首字节 */
+#define MAX_PACKETS     32
+
+typedef struct {
+    int count;
+    int64_t pts[MAX_PACKETS];
+    int samples[MAX_PACKETS];
+    int bytes[MAX_PACKETS];
+    uint8_t first[MAX_PACKETS];
+} packet_ctx_t;
+
+static int fake_packet(void* param, const uint8_t* data, int bytes, int64_t pts, int samples)
+{
+    packet_ctx_t* p = (packet_ctx_t*)param;
+
+    if (p->count < MAX_PACKETS) {
+        p->pts[p->count] = pts;
+        p->samples[p->count] = samples;
+        p->bytes[p->count] = bytes;
+        p->first[p->count] = data[0];
+        __atomic_store_n(&p->count, p->count + 1, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/* 编码包：载荷首字节为id，长度为160字节（20ms G.711） */
+static int push_packet(lws_rec_t* rec, uint8_t id, uint32_t timestamp, uint64_t time_us)
+{
+    lws_frame_t* frame = lws_frame_alloc(FRAME_SAMPLES);
+    int ret;
+
+    frame->kind = LWS_FRAME_AUDIO_CODED;
+    frame->size = FRAME_SAMPLES;
+    frame->samples = FRAME_SAMPLES;
+    frame->sample_rate = SAMPLE_RATE;
+    frame->channels = 1;
+    frame->timestamp = timestamp;
+    frame->time_us = time_us;
+    memset(frame->data, id, FRAME_SAMPLES);
+    ret = lws_rec_push_packet(rec, frame);
+    lws_frame_unref(frame);
+    return ret;
+}
+
+#define BASE_US         1000000ull
+#define FRAME_US        20000ull
+
+static uint64_t now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+}
+
+/* ========================================
+ * Tests
+ * ======================================== */
+
+TEST(rec_order_and_batch) {
+    static writer_ctx_t w;
+    lws_rec_stats_t stats;
+    lws_rec_t* rec;
+    int i;
+
+    memset(&w, 0, sizeof(w));
+    rec = lws_rec_open(SAMPLE_RATE, 1, 500, fake_write, &w);
+    ASSERT_NOT_NULL(rec);
+
+    for (i = 0; i < 10; i++) {
+        ASSERT_EQ(push_new(rec, i), 0);
+    }
+    lws_rec_close(rec, &stats);
+
+    /* 顺序不变，10帧合并为很少几次写入，单次不超过LWS_REC_BATCH_MS */
+    ASSERT_EQ(w.samples, 10 * FRAME_SAMPLES);
+    ASSERT_TRUE(pcm_sequential(&w, w.samples));
+    ASSERT_TRUE(w.writes >= 1 && w.writes <= 3);
+    ASSERT_TRUE(w.max_batch <= SAMPLE_RATE * LWS_REC_BATCH_MS / 1000);
+    ASSERT_EQ(stats.frames, 10u);
+    ASSERT_EQ(stats.writes, (uint64_t)w.writes);
+    ASSERT_EQ(stats.dropped, 0u);
+
+    ASSERT_NULL(lws_rec_open(0, 1, 500, fake_write, &w));
+    ASSERT_NULL(lws_rec_open(SAMPLE_RATE, 1, 500, NULL, &w));
+    lws_rec_close(NULL, NULL);
+}
+
+TEST(rec_frame_refs) {
+    static writer_ctx_t w;
+    lws_rec_t* rec;
+    lws_frame_t* frame;
+    lws_frame_t* video;
+
+    memset(&w, 0, sizeof(w));
+    w.gate = 1;
+    rec = lws_rec_open(SAMPLE_RATE, 1, 500, fake_write, &w);
+    ASSERT_NOT_NULL(rec);
+    ASSERT_TRUE(writer_stalled(rec, &w));
+
+    /* 入队持有引用，上游不能再原地修改 */
+    frame = make_frame(1);
+    ASSERT_EQ(lws_rec_push(rec, frame), 0);
+    ASSERT_EQ(frame->refcount, 2);
+    ASSERT_FALSE(lws_frame_writable(frame));
+
+    /* 非音频、空帧与数据不足的帧被拒绝 */
+    video = make_frame(2);
+    video->kind = LWS_FRAME_VIDEO;
+    ASSERT_EQ(lws_rec_push(rec, video), -1);
+    video->kind = LWS_FRAME_AUDIO;
+    video->samples = 0;
+    ASSERT_EQ(lws_rec_push(rec, video), -1);
+    video->samples = FRAME_SAMPLES;
+    video->size = 10;
+    ASSERT_EQ(lws_rec_push(rec, video), -1);
+    ASSERT_EQ(video->refcount, 1);
+    ASSERT_EQ(lws_rec_push(NULL, frame), -1);
+    lws_frame_unref(video);
+
+    __atomic_store_n(&w.gate, 0, __ATOMIC_RELEASE);
+    lws_rec_close(rec, NULL);
+
+    /* 写出后释放引用 */
+    ASSERT_EQ(frame->refcount, 1);
+    ASSERT_EQ(w.samples, 2 * FRAME_SAMPLES);
+    ASSERT_TRUE(pcm_sequential(&w, w.samples));
+    lws_frame_unref(frame);
+}
+
+TEST(rec_stalled_writer_drops) {
+    static writer_ctx_t w;
+    lws_rec_stats_t stats;
+    lws_rec_t* rec;
+    uint64_t start, elapsed;
+    int queued = 0;
+    int i;
+
+    memset(&w, 0, sizeof(w));
+    w.gate = 1;
+    rec = lws_rec_open(SAMPLE_RATE, 1, LWS_REC_MIN_QUEUE_MS, fake_write, &w);
+    ASSERT_NOT_NULL(rec);
+
+    ASSERT_TRUE(writer_stalled(rec, &w));
+
+    /* 写入卡住时push不阻塞：队列满后丢弃并计数 */
+    start = now_us();
+    for (i = 1; i < 40; i++) {
+        if (push_new(rec, i) == 0) {
+            queued++;
+        }
+    }
+    elapsed = now_us() - start;
+    ASSERT_TRUE(elapsed < 20000);
+
+    lws_rec_get_stats(rec, &stats);
+    ASSERT_TRUE(queued >= LWS_REC_MIN_QUEUE_MS / 20);
+    ASSERT_EQ(stats.dropped, (uint64_t)(39 - queued));
+    ASSERT_EQ(stats.max_queued, (uint32_t)queued);
+
+    /* 恢复后写出已排队的帧 */
+    __atomic_store_n(&w.gate, 0, __ATOMIC_RELEASE);
+    lws_rec_close(rec, &stats);
+    ASSERT_EQ(stats.frames, (uint64_t)(1 + queued));
+    ASSERT_EQ(w.samples, (1 + queued) * FRAME_SAMPLES);
+    ASSERT_TRUE(pcm_sequential(&w, w.samples));
+    ASSERT_TRUE(stats.max_write_us > 0);
+}
+
+TEST(rec_background_writes) {
+    static writer_ctx_t w;
+    lws_rec_stats_t stats;
+    lws_rec_t* rec;
+    int i;
+
+    memset(&w, 0, sizeof(w));
+    rec = lws_rec_open(SAMPLE_RATE, 1, 500, fake_write, &w);
+    ASSERT_NOT_NULL(rec);
+
+    /* 实时节奏推送：写线程在关闭前已经写出大部分 */
+    for (i = 0; i < 20; i++) {
+        ASSERT_EQ(push_new(rec, i), 0);
+        usleep(20000);
+    }
+    lws_rec_get_stats(rec, &stats);
+    ASSERT_TRUE(stats.frames >= 10);
+    ASSERT_TRUE(stats.writes < stats.frames);
+
+    lws_rec_close(rec, &stats);
+    ASSERT_EQ(stats.frames, 20u);
+    ASSERT_EQ(stats.dropped, 0u);
+    ASSERT_TRUE(pcm_sequential(&w, 20 * FRAME_SAMPLES));
+}
+
+TEST(rec_shared_writer) {
+    static writer_ctx_t w1;
+    static writer_ctx_t w2;
+    lws_rec_stats_t stats;
+    lws_rec_t* rec1;
+    lws_rec_t* rec2;
+    int i;
+
+    memset(&w1, 0, sizeof(w1));
+    memset(&w2, 0, sizeof(w2));
+    rec1 = lws_rec_open(SAMPLE_RATE, 1, 500, fake_write, &w1);
+    rec2 = lws_rec_open(SAMPLE_RATE, 1, 500, fake_write, &w2);
+    ASSERT_NOT_NULL(rec1);
+    ASSERT_NOT_NULL(rec2);
+
+    for (i = 0; i < 5; i++) {
+        ASSERT_EQ(push_new(rec1, i), 0);
+        ASSERT_EQ(push_new(rec2, i), 0);
+    }
+
+    /* 关闭一个不影响另一个 */
+    lws_rec_close(rec1, NULL);
+    ASSERT_EQ(w1.samples, 5 * FRAME_SAMPLES);
+    for (i = 5; i < 8; i++) {
+        ASSERT_EQ(push_new(rec2, i), 0);
+    }
+    usleep(3 * LWS_REC_INTERVAL_MS * 1000);
+    lws_rec_get_stats(rec2, &stats);
+    ASSERT_EQ(stats.frames, 8u);
+    lws_rec_close(rec2, NULL);
+    ASSERT_EQ(w2.samples, 8 * FRAME_SAMPLES);
+    ASSERT_TRUE(pcm_sequential(&w2, w2.samples));
+
+    /* 全部关闭后写线程已停止，重新打开时再启动 */
+    memset(&w1, 0, sizeof(w1));
+    rec1 = lws_rec_open(SAMPLE_RATE, 1, 500, fake_write, &w1);
+    ASSERT_NOT_NULL(rec1);
+    ASSERT_EQ(push_new(rec1, 0), 0);
+    usleep(3 * LWS_REC_INTERVAL_MS * 1000);
+    lws_rec_get_stats(rec1, &stats);
+    ASSERT_EQ(stats.frames, 1u);
+    lws_rec_close(rec1, NULL);
+}
+
+TEST(rec_stereo_interleave) {
+    static writer_ctx_t w;
+    lws_rec_stats_t stats;
+    lws_rec_t* rec;
+    int i;
+
+    memset(&w, 0, sizeof(w));
+    w.channels = 2;
+    rec = lws_rec_open_stereo(SAMPLE_RATE, 500, fake_write, &w);
+    ASSERT_NOT_NULL(rec);
+
+    /* 同一时刻的两路帧：左声道本端，右声道对端（到达有几毫秒抖动） */
+    for (i = 0; i < 5; i++) {
+        ASSERT_EQ(push_leg(rec, LWS_REC_LOCAL, i, BASE_US + i * FRAME_US), 0);
+        ASSERT_EQ(push_leg(rec, LWS_REC_REMOTE, i, BASE_US + i * FRAME_US + 3000), 0);
+    }
+    lws_rec_close(rec, &stats);
+
+    ASSERT_EQ(w.samples, 5 * FRAME_SAMPLES);
+    for (i = 0; i < w.samples; i++) {
+        ASSERT_EQ(w.pcm[i * 2], (int16_t)i);
+        ASSERT_EQ(w.pcm[i * 2 + 1], (int16_t)-i);
+    }
+    ASSERT_EQ(stats.frames, 10u);
+    ASSERT_EQ(stats.late, 0u);
+
+    /* 单声道与双路接口不混用 */
+    rec = lws_rec_open(SAMPLE_RATE, 1, 500, fake_write, &w);
+    ASSERT_EQ(push_leg(rec, LWS_REC_LOCAL, 0, BASE_US), -1);
+    lws_rec_close(rec, NULL);
+    rec = lws_rec_open_stereo(SAMPLE_RATE, 500, fake_write, &w);
+    ASSERT_EQ(push_new(rec, 0), -1);
+    ASSERT_EQ(push_leg(rec, (lws_rec_leg_t)2, 0, BASE_US), -1);
+    lws_rec_close(rec, NULL);
+}
+
+TEST(rec_stereo_gap_fill) {
+    static writer_ctx_t w;
+    lws_rec_t* rec;
+    int i;
+
+    memset(&w, 0, sizeof(w));
+    w.channels = 2;
+    rec = lws_rec_open_stereo(SAMPLE_RATE, 500, fake_write, &w);
+    ASSERT_NOT_NULL(rec);
+
+    /*
+     * 本端帧0-7连续；对端晚40ms开始（帧2起），帧5丢失（时间戳跳变），
+     * 对端缺失处为静音
+     */
+    for (i = 0; i < 8; i++) {
+        ASSERT_EQ(push_leg(rec, LWS_REC_LOCAL, i, BASE_US + i * FRAME_US), 0);
+        if (i >= 2 && i != 5) {
+            ASSERT_EQ(push_leg(rec, LWS_REC_REMOTE, i, BASE_US + i * FRAME_US + 5000), 0);
+        }
+    }
+    lws_rec_close(rec, NULL);
+
+    ASSERT_EQ(w.samples, 8 * FRAME_SAMPLES);
+    for (i = 0; i < w.samples; i++) {
+        int frame = i / FRAME_SAMPLES;
+        int16_t remote = (frame < 2 || frame == 5) ? 0 : (int16_t)-i;
+        ASSERT_EQ(w.pcm[i * 2], (int16_t)i);
+        ASSERT_EQ(w.pcm[i * 2 + 1], remote);
+    }
+}
+
+TEST(rec_stereo_silent_leg) {
+    static writer_ctx_t w;
+    lws_rec_stats_t stats;
+    lws_rec_t* rec;
+    int i;
+
+    memset(&w, 0, sizeof(w));
+    w.channels = 2;
+    rec = lws_rec_open_stereo(SAMPLE_RATE, 1000, fake_write, &w);
+    ASSERT_NOT_NULL(rec);
+
+    /* 只有本端（对端无包）：不等对端，落后LWS_REC_ALIGN_MS以上的部分照常写出 */
+    for (i = 0; i < 30; i++) {
+        ASSERT_EQ(push_leg(rec, LWS_REC_LOCAL, i, BASE_US + i * FRAME_US), 0);
+    }
+    usleep(3 * LWS_REC_INTERVAL_MS * 1000);
+    lws_rec_get_stats(rec, &stats);
+    ASSERT_EQ(stats.frames, 30u);
+    ASSERT_EQ(__atomic_load_n(&w.samples, __ATOMIC_ACQUIRE),
+              30 * FRAME_SAMPLES - SAMPLE_RATE * LWS_REC_ALIGN_MS / 1000);
+
+    /* 已写出位置之前的对端帧被丢弃 */
+    ASSERT_EQ(push_leg(rec, LWS_REC_REMOTE, 0, BASE_US), 0);
+    lws_rec_close(rec, &stats);
+    ASSERT_EQ(stats.late, 1u);
+    ASSERT_EQ(w.samples, 30 * FRAME_SAMPLES);
+    for (i = 0; i < w.samples; i++) {
+        ASSERT_EQ(w.pcm[i * 2], (int16_t)i);
+        ASSERT_EQ(w.pcm[i * 2 + 1], 0);
+    }
+}
+
+TEST(rec_packets) {
+    static packet_ctx_t p;
+    static writer_ctx_t w;
+    lws_rec_stats_t stats;
+    lws_rec_t* rec;
+    lws_rec_t* mono;
+    uint32_t ts0 = 0xfffffe00;      /* 时间戳回绕 */
+    uint32_t reset = 0x12345678;
+
+    memset(&p, 0, sizeof(p));
+    memset(&w, 0, sizeof(w));
+    ASSERT_NULL(lws_rec_open_packets(SAMPLE_RATE, 500, NULL, &p));
+    rec = lws_rec_open_packets(SAMPLE_RATE, 500, fake_packet, &p);
+    ASSERT_NOT_NULL(rec);
+
+    /* 类型不符的帧与录音器都被拒绝 */
+    mono = lws_rec_open(SAMPLE_RATE, 1, 500, fake_write, &w);
+    ASSERT_NOT_NULL(mono);
+    ASSERT_EQ(push_packet(mono, 0, 0, BASE_US), -1);
+    ASSERT_EQ(push_new(rec, 0), -1);
+    lws_rec_close(mono, NULL);
+
+    /* 包0、1、2，包3丢失，包4，包2重复，包5 */
+    ASSERT_EQ(push_packet(rec, 0, ts0, BASE_US), 0);
+    ASSERT_EQ(push_packet(rec, 1, ts0 + 160, BASE_US + FRAME_US), 0);
+    ASSERT_EQ(push_packet(rec, 2, ts0 + 320, BASE_US + 2 * FRAME_US), 0);
+    ASSERT_EQ(push_packet(rec, 4, ts0 + 640, BASE_US + 4 * FRAME_US), 0);
+    ASSERT_EQ(push_packet(rec, 2, ts0 + 320, BASE_US + 4 * FRAME_US + 1000), 0);
+    ASSERT_EQ(push_packet(rec, 5, ts0 + 800, BASE_US + 5 * FRAME_US), 0);
+
+    /* 时间戳重置（如对端重新协商）：按墙上时钟接续 */
+    ASSERT_EQ(push_packet(rec, 6, reset, BASE_US + 6 * FRAME_US), 0);
+    ASSERT_EQ(push_packet(rec, 7, reset + 160, BASE_US + 7 * FRAME_US), 0);
+    lws_rec_close(rec, &stats);
+
+    ASSERT_EQ(stats.frames, 8u);
+    ASSERT_EQ(stats.late, 1u);
+    ASSERT_EQ(p.count, 7);
+    ASSERT_EQ(p.first[0], 0);
+    ASSERT_EQ(p.pts[0], 0);
+    ASSERT_EQ(p.pts[1], 160);
+    ASSERT_EQ(p.pts[2], 320);
+    ASSERT_EQ(p.first[3], 4);
+    ASSERT_EQ(p.pts[3], 640);       /* 包3的位置留给后端补齐 */
+    ASSERT_EQ(p.first[4], 5);
+    ASSERT_EQ(p.pts[4], 800);
+    ASSERT_EQ(p.first[5], 6);
+    ASSERT_EQ(p.pts[5], 960);
+    ASSERT_EQ(p.pts[6], 1120);
+    ASSERT_EQ(p.samples[6], FRAME_SAMPLES);
+    ASSERT_EQ(p.bytes[6], FRAME_SAMPLES);
+}
+
+/* ========================================
+ * Benchmark
+ * ======================================== */
+
+#define BENCH_CALLS     20
+#define BENCH_PACKETS   3000        /* 60s G.711 call */
+
+/* G.711 μ-law (ITU-T G.711)：解码录音写入G.711文件时要重新编码 */
+static int16_t ulaw_decode(uint8_t u)
+{
+    int t;
+
+    u = (uint8_t)~u;
+    t = ((u & 0x0f) << 3) + 0x84;
+    t <<= (u & 0x70) >> 4;
+    return (int16_t)((u & 0x80) ? 0x84 - t : t - 0x84);
+}
+
+static uint8_t ulaw_encode(int16_t pcm)
+{
+    int mask = 0xff;
+    int seg = 0;
+    int v = pcm;
+
+    if (v < 0) {
+        v = -v;
+        mask = 0x7f;
+    }
+    v += 0x84;
+    if (v > 0x7fff) {
+        v = 0x7fff;
+    }
+    while (seg < 7 && (v >> (seg + 8)) != 0) {
+        seg++;
+    }
+    return (uint8_t)(((seg << 4) | ((v >> (seg + 3)) & 0x0f)) ^ mask);
+}
+
+/* 写线程：编码到文件格式（解码录音）或直接写入（直通），结果累加防止被优化掉 */
+static volatile unsigned s_bench_sink;
+
+static int bench_write_pcm(void* param, const int16_t* pcm, int samples)
+{
+    uint8_t out[FRAME_SAMPLES * 8];
+    unsigned sum = 0;
+    int i;
+    (void)param;
+
+    for (i = 0; i < samples; i++) {
+        out[i % sizeof(out)] = ulaw_encode(pcm[i]);
+        sum += out[i % sizeof(out)];
+    }
+    s_bench_sink += sum;
+    return 0;
+}
+
+static int bench_write_packet(void* param, const uint8_t* data, int bytes, int64_t pts, int samples)
+{
+    uint8_t out[FRAME_SAMPLES * 8];
+    (void)param;
+    (void)pts;
+    (void)samples;
+
+    if (bytes > (int)sizeof(out)) {
+        return -1;
+    }
+    memcpy(out, data, bytes);
+    s_bench_sink += out[0];
+    return 0;
+}
+
+static double cpu_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * @brief Record one call, return the process CPU time (media + writer thread)
+ *
+ * 解码在两种方式下都要做（播放），不计入；录音器持有引用时接收帧不能
+ * 复用，两种方式每包都分配一帧。
+ */
+static double bench_call(int passthrough, const uint8_t* payload, const int16_t* decoded)
+{
+    lws_rec_stats_t stats;
+    lws_rec_t* rec;
+    double t0 = cpu_us();
+    int n;
+
+    rec = passthrough ? lws_rec_open_packets(SAMPLE_RATE, BENCH_PACKETS * 20, bench_write_packet, NULL)
+                      : lws_rec_open(SAMPLE_RATE, 1, BENCH_PACKETS * 20, bench_write_pcm, NULL);
+    if (!rec) {
+        return -1;
+    }
+
+    for (n = 0; n < BENCH_PACKETS; n++) {
+        lws_frame_t* frame;
+
+        if (passthrough) {
+            frame = lws_frame_alloc(FRAME_SAMPLES);
+            frame->kind = LWS_FRAME_AUDIO_CODED;
+            frame->size = FRAME_SAMPLES;
+            memcpy(frame->data, payload, FRAME_SAMPLES);
+        } else {
+            frame = lws_frame_alloc(FRAME_SAMPLES * (int)sizeof(int16_t));
+            frame->kind = LWS_FRAME_AUDIO;
+            frame->size = FRAME_SAMPLES * (int)sizeof(int16_t);
+            memcpy(frame->data, decoded, frame->size);
+        }
+        frame->samples = FRAME_SAMPLES;
+        frame->sample_rate = SAMPLE_RATE;
+        frame->channels = 1;
+        frame->timestamp = (uint32_t)(n * FRAME_SAMPLES);
+        frame->time_us = BASE_US + (uint64_t)n * FRAME_US;
+        if (passthrough) {
+            lws_rec_push_packet(rec, frame);
+        } else {
+            lws_rec_push(rec, frame);
+        }
+        lws_frame_unref(frame);
+    }
+    lws_rec_close(rec, &stats);
+
+    if (stats.frames != BENCH_PACKETS || stats.dropped != 0) {
+        return -1;
+    }
+    return cpu_us() - t0;
+}
+
+TEST(rec_bench_call) {
+    uint8_t payload[FRAME_SAMPLES];
+    int16_t decoded[FRAME_SAMPLES];
+    double pcm = 0, packets = 0;
+    int call, i;
+
+    for (i = 0; i < FRAME_SAMPLES; i++) {
+        payload[i] = (uint8_t)(i * 37);
+        decoded[i] = ulaw_decode(payload[i]);
+    }
+
+    for (call = 0; call < BENCH_CALLS; call++) {
+        double t = bench_call(0, payload, decoded);
+        ASSERT_TRUE(t >= 0);
+        pcm += t;
+        t = bench_call(1, payload, decoded);
+        ASSERT_TRUE(t >= 0);
+        packets += t;
+    }
+
+    printf("    recording CPU per 60s G.711 call: decoded %.0f us, passthrough %.0f us (%.1fx)\n",
+           pcm / BENCH_CALLS, packets / BENCH_CALLS, packets > 0 ? pcm / packets : 0.0);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_rec Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_rec_order_and_batch();
+    run_test_rec_frame_refs();
+    run_test_rec_stalled_writer_drops();
+    run_test_rec_background_writes();
+    run_test_rec_shared_writer();
+    run_test_rec_stereo_interleave();
+    run_test_rec_stereo_gap_fill();
+    run_test_rec_stereo_silent_leg();
+    run_test_rec_packets();
+    run_test_rec_bench_call();
+
+    printf("\n");
+    printf("==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
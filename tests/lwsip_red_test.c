@@ -0,0 +1,442 @@
+/**
+ * @file lwsip_red_test.c
+ * @brief Unit tests for lws_red.c (RFC 2198 redundant audio)
+ *
+ * Test coverage:
+ * - RED packet layout: block headers, timestamp offsets, oldest block first
+ * - A burst of up to `level` lost packets is rebuilt from the next packet
+ * - Duplicates and non-contiguous history are not delivered / not repeated
+ * - Level 0 sends plain packets; the level follows RTCP fraction lost
+ * - Effective loss after recovery under a Gilbert-Elliott burst-loss model
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lws_red.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+
+#define MEDIA_SSRC      0x11223344u
+#define PEER_SSRC       0x0badf00du
+#define PCMU_PT         0
+#define RED_PT          103
+#define FRAME_SAMPLES   160
+#define FRAME_BYTES     160
+#define MAX_PACKETS     16
+
+/* ========================================
+ * Helpers
+ * ======================================== */
+
+/* 捕获交付的包 */
+static uint8_t g_packets[MAX_PACKETS][LWS_RED_MAX_PACKET];
+static int g_packet_len[MAX_PACKETS];
+static int g_packet_count = 0;
+
+static void on_deliver(void* param, const uint8_t* packet, int bytes)
+{
+    (void)param;
+    if (g_packet_count < MAX_PACKETS) {
+        memcpy(g_packets[g_packet_count], packet, bytes);
+        g_packet_len[g_packet_count] = bytes;
+    }
+    g_packet_count++;
+}
+
+static uint16_t seq_of(int i)
+{
+    return (uint16_t)((g_packets[i][2] << 8) | g_packets[i][3]);
+}
+
+static uint32_t u32_at(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* 音频帧：时间戳按帧长递增（序号回绕处连续），载荷为 FRAME_BYTES 个 (seq & 0xff) */
+static int make_frame(uint8_t* buf, uint16_t seq, int pt)
+{
+    uint32_t ts = 100000u + (uint32_t)((int16_t)seq * FRAME_SAMPLES);
+
+    memset(buf, 0, 12);
+    buf[0] = 0x80;
+    buf[1] = (uint8_t)pt;
+    buf[2] = (uint8_t)(seq >> 8);
+    buf[3] = (uint8_t)seq;
+    buf[4] = (uint8_t)(ts >> 24);
+    buf[5] = (uint8_t)(ts >> 16);
+    buf[6] = (uint8_t)(ts >> 8);
+    buf[7] = (uint8_t)ts;
+    buf[8] = (uint8_t)(MEDIA_SSRC >> 24);
+    buf[9] = (uint8_t)(MEDIA_SSRC >> 16);
+    buf[10] = (uint8_t)(MEDIA_SSRC >> 8);
+    buf[11] = (uint8_t)MEDIA_SSRC;
+    memset(buf + 12, seq & 0xff, FRAME_BYTES);
+    return 12 + FRAME_BYTES;
+}
+
+/* 编码一帧，返回线上的包（RED或原包） */
+static int send_frame(lws_red_sender_t* s, uint16_t seq, uint8_t* wire)
+{
+    uint8_t frame[12 + FRAME_BYTES];
+    int bytes = make_frame(frame, seq, PCMU_PT);
+    int n = lws_red_encode(s, frame, bytes, wire, LWS_RED_MAX_PACKET);
+    if (n == 0) {
+        memcpy(wire, frame, bytes);
+        n = bytes;
+    }
+    return n;
+}
+
+/* 接收报告：RR + 一个报告块 */
+static int make_rr(uint8_t* buf, uint32_t media_ssrc, int fraction_lost)
+{
+    memset(buf, 0, 32);
+    buf[0] = 0x81;
+    buf[1] = 201;
+    buf[3] = 7;
+    buf[4] = (uint8_t)(PEER_SSRC >> 24);
+    buf[5] = (uint8_t)(PEER_SSRC >> 16);
+    buf[6] = (uint8_t)(PEER_SSRC >> 8);
+    buf[7] = (uint8_t)PEER_SSRC;
+    buf[8] = (uint8_t)(media_ssrc >> 24);
+    buf[9] = (uint8_t)(media_ssrc >> 16);
+    buf[10] = (uint8_t)(media_ssrc >> 8);
+    buf[11] = (uint8_t)media_ssrc;
+    buf[12] = (uint8_t)fraction_lost;
+    return 32;
+}
+
+/* ========================================
+ * Packet format
+ * ======================================== */
+
+TEST(red_packet_layout)
+{
+    lws_red_sender_t s;
+    uint8_t wire[LWS_RED_MAX_PACKET];
+    int n;
+
+    lws_red_sender_init(&s, RED_PT, 2);
+    lws_red_adapt(&s, 20);                  /* ~8% -> 2 */
+    ASSERT_EQ(s.level, 2);
+
+    /* 首帧无历史：原样发送 */
+    ASSERT_EQ(send_frame(&s, 10, wire), 12 + FRAME_BYTES);
+    ASSERT_EQ(wire[1] & 0x7f, PCMU_PT);
+    ASSERT_EQ(s.packets, 0);
+
+    /* 第二帧带一个冗余块：4字节块头 + 1字节主块头 */
+    ASSERT_EQ(send_frame(&s, 11, wire), 12 + 4 + 1 + 2 * FRAME_BYTES);
+    ASSERT_EQ(wire[1] & 0x7f, RED_PT);
+
+    /* 第三帧带两个，最旧在前 */
+    n = send_frame(&s, 12, wire);
+    ASSERT_EQ(n, 12 + 2 * 4 + 1 + 3 * FRAME_BYTES);
+    ASSERT_EQ((wire[2] << 8) | wire[3], 12);
+    ASSERT_EQ(u32_at(wire + 4), 100000u + 12 * FRAME_SAMPLES);
+    /* F=1 | PT 0，偏移320，长度160 */
+    ASSERT_EQ(wire[12], 0x80 | PCMU_PT);
+    ASSERT_EQ((wire[13] << 6) | (wire[14] >> 2), 2 * FRAME_SAMPLES);
+    ASSERT_EQ(((wire[14] & 0x03) << 8) | wire[15], FRAME_BYTES);
+    ASSERT_EQ((wire[17] << 6) | (wire[18] >> 2), FRAME_SAMPLES);
+    ASSERT_EQ(wire[20], PCMU_PT);           /* 主块头 F=0 */
+    ASSERT_EQ(wire[21], 10);
+    ASSERT_EQ(wire[21 + FRAME_BYTES], 11);
+    ASSERT_EQ(wire[21 + 2 * FRAME_BYTES], 12);
+    ASSERT_EQ(s.packets, 2);
+    ASSERT_EQ(s.redundant_bytes, 3 * FRAME_BYTES);
+
+    /* 序号不连续（中间发过telephone-event等）：不重复之前的帧 */
+    ASSERT_EQ(send_frame(&s, 14, wire), 12 + FRAME_BYTES);
+
+    /* 放不下时舍弃最旧的块 */
+    send_frame(&s, 15, wire);
+    {
+        uint8_t frame[12 + FRAME_BYTES];
+        int bytes = make_frame(frame, 16, PCMU_PT);
+        n = lws_red_encode(&s, frame, bytes, wire, 12 + 4 + 1 + 2 * FRAME_BYTES);
+        ASSERT_EQ(n, 12 + 4 + 1 + 2 * FRAME_BYTES);
+        ASSERT_EQ(wire[17], 15);
+    }
+}
+
+/* ========================================
+ * Recovery
+ * ======================================== */
+
+TEST(red_recovers_burst)
+{
+    lws_red_sender_t s;
+    lws_red_receiver_t r;
+    uint8_t wire[8][LWS_RED_MAX_PACKET];
+    int len[8];
+    int i;
+
+    g_packet_count = 0;
+    lws_red_sender_init(&s, RED_PT, 2);
+    lws_red_adapt(&s, 20);
+    lws_red_receiver_init(&r, RED_PT, on_deliver, NULL);
+
+    for (i = 0; i < 8; i++) {
+        len[i] = send_frame(&s, (uint16_t)(65533 + i), wire[i]);
+    }
+
+    /* 丢失第3、4个包（65535、0），第5个包携带二者 */
+    lws_red_receive(&r, wire[0], len[0]);
+    lws_red_receive(&r, wire[1], len[1]);
+    ASSERT_EQ(lws_red_receive(&r, wire[4], len[4]), 0);
+    ASSERT_EQ(g_packet_count, 5);
+    ASSERT_EQ(r.recovered, 2);
+    ASSERT_EQ(seq_of(2), 65535);
+    ASSERT_EQ(seq_of(3), 0);
+    ASSERT_EQ(seq_of(4), 1);
+
+    /* 重建为普通RTP包：主PT、原时间戳与载荷，无M位 */
+    ASSERT_EQ(g_packet_len[2], 12 + FRAME_BYTES);
+    ASSERT_EQ(g_packets[2][1], PCMU_PT);
+    ASSERT_EQ(u32_at(g_packets[2] + 4), 100000u - FRAME_SAMPLES);
+    ASSERT_EQ(u32_at(g_packets[2] + 8), MEDIA_SSRC);
+    ASSERT_EQ(g_packets[2][12], 0xff);
+    ASSERT_EQ(g_packets[3][12], 0x00);
+    ASSERT_EQ(g_packet_len[4], 12 + FRAME_BYTES);
+    ASSERT_EQ(g_packets[4][12 + FRAME_BYTES - 1], 0x01);
+
+    /* 迟到的原包与重复包不再交付 */
+    lws_red_receive(&r, wire[3], len[3]);
+    lws_red_receive(&r, wire[4], len[4]);
+    ASSERT_EQ(g_packet_count, 5);
+
+    /* 连续丢3个（3、4、5）超出级别：由6只恢复最近的4、5 */
+    lws_red_receive(&r, wire[5], len[5]);
+    ASSERT_EQ(g_packet_count, 6);
+    g_packet_count = 0;
+    len[0] = send_frame(&s, 5, wire[0]);
+    len[1] = send_frame(&s, 6, wire[1]);
+    lws_red_receive(&r, wire[1], len[1]);
+    ASSERT_EQ(r.recovered, 4);
+    ASSERT_EQ(g_packet_count, 3);
+    ASSERT_EQ(seq_of(0), 4);
+    ASSERT_EQ(seq_of(2), 6);
+
+    /* 畸形RED包：块长度超出包 */
+    wire[1][14] |= 0x03;
+    wire[1][15] = 0xff;
+    ASSERT_EQ(lws_red_receive(&r, wire[1], len[1]), -1);
+}
+
+TEST(red_level0_passthrough)
+{
+    lws_red_sender_t s;
+    lws_red_receiver_t r;
+    uint8_t wire[LWS_RED_MAX_PACKET];
+    int n;
+
+    g_packet_count = 0;
+    lws_red_sender_init(&s, RED_PT, 0);
+    ASSERT_EQ(s.level, 0);
+    lws_red_receiver_init(&r, RED_PT, on_deliver, NULL);
+
+    /* 级别0：以主PT原样发送，对端按普通包接收 */
+    n = send_frame(&s, 1, wire);
+    ASSERT_EQ(send_frame(&s, 2, wire), 12 + FRAME_BYTES);
+    ASSERT_EQ(wire[1], PCMU_PT);
+    lws_red_adapt(&s, 255);
+    ASSERT_EQ(s.level, 0);
+
+    lws_red_receive(&r, wire, n);
+    lws_red_receive(&r, wire, n);
+    ASSERT_EQ(g_packet_count, 1);
+
+    /* 未协商RED的接收端：所有包直接交付 */
+    lws_red_receiver_init(&r, -1, on_deliver, NULL);
+    lws_red_receive(&r, wire, n);
+    ASSERT_EQ(g_packet_count, 2);
+}
+
+/* ========================================
+ * Adaptation
+ * ======================================== */
+
+TEST(red_adapts_to_rtcp_loss)
+{
+    lws_red_sender_t s;
+    uint8_t rtcp[64];
+    int n;
+
+    lws_red_sender_init(&s, RED_PT, 3);
+    ASSERT_EQ(s.level, 1);
+
+    /* RR中关于本端SSRC的报告块 */
+    n = make_rr(rtcp, MEDIA_SSRC, 64);
+    ASSERT_EQ(lws_red_rtcp_loss(rtcp, n, MEDIA_SSRC), 64);
+    ASSERT_EQ(lws_red_rtcp_loss(rtcp, n, PEER_SSRC), -1);
+
+    /* SR + SDES复合包：报告块在发送方信息之后 */
+    memset(rtcp, 0, sizeof(rtcp));
+    rtcp[0] = 0x81; rtcp[1] = 200; rtcp[3] = 12;
+    rtcp[28] = (uint8_t)(MEDIA_SSRC >> 24); rtcp[29] = (uint8_t)(MEDIA_SSRC >> 16);
+    rtcp[30] = (uint8_t)(MEDIA_SSRC >> 8); rtcp[31] = (uint8_t)MEDIA_SSRC;
+    rtcp[32] = 13;
+    rtcp[52] = 0x81; rtcp[53] = 202; rtcp[55] = 1;
+    ASSERT_EQ(lws_red_rtcp_loss(rtcp, 60, MEDIA_SSRC), 13);
+
+    /* 丢包增加立即升级，减少时每个报告降一级 */
+    lws_red_adapt(&s, 64);
+    ASSERT_EQ(s.level, 3);
+    lws_red_adapt(&s, 0);
+    ASSERT_EQ(s.level, 2);
+    lws_red_adapt(&s, 15);
+    ASSERT_EQ(s.level, 2);
+    lws_red_adapt(&s, 5);
+    ASSERT_EQ(s.level, 1);
+    lws_red_adapt(&s, 0);
+    lws_red_adapt(&s, 0);
+    ASSERT_EQ(s.level, 0);
+
+    /* 不超过配置的上限 */
+    lws_red_sender_init(&s, RED_PT, 1);
+    lws_red_adapt(&s, 200);
+    ASSERT_EQ(s.level, 1);
+}
+
+/* ========================================
+ * Impairment model
+ * ======================================== */
+
+static uint32_t g_rand = 12345;
+
+static double rand_unit(void)
+{
+    g_rand = g_rand * 1103515245u + 12345u;
+    return (double)((g_rand >> 8) & 0xffffff) / 16777216.0;
+}
+
+/* 统计交付的不同序号 */
+static uint8_t g_delivered[65536];
+
+static void on_count(void* param, const uint8_t* packet, int bytes)
+{
+    (void)param;
+    (void)bytes;
+    g_delivered[(packet[2] << 8) | packet[3]] = 1;
+}
+
+/**
+ * Gilbert-Elliott信道：好状态不丢包，坏状态全丢；
+ * P(好->坏)=3.5%，P(坏->好)=50%，稳态丢包约6.5%，平均突发长度2。
+ * 每250个包由接收端统计区间丢包率，以RR反馈给发送端调整级别。
+ */
+TEST(red_burst_loss_model)
+{
+    lws_red_sender_t s;
+    lws_red_receiver_t r;
+    uint8_t wire[LWS_RED_MAX_PACKET];
+    uint8_t rtcp[32];
+    const int total = 20000;
+    int bad = 0;
+    int lost = 0;
+    int interval_lost = 0;
+    int delivered = 0;
+    int max_level = 0;
+    double raw, effective;
+    int i;
+
+    memset(g_delivered, 0, sizeof(g_delivered));
+    lws_red_sender_init(&s, RED_PT, LWS_RED_MAX_LEVEL);
+    lws_red_receiver_init(&r, RED_PT, on_count, NULL);
+
+    for (i = 0; i < total; i++) {
+        int n = send_frame(&s, (uint16_t)i, wire);
+
+        bad = bad ? rand_unit() >= 0.5 : rand_unit() < 0.035;
+        if (bad) {
+            lost++;
+            interval_lost++;
+        } else {
+            lws_red_receive(&r, wire, n);
+        }
+
+        if (i % 250 == 249) {
+            int n2 = make_rr(rtcp, MEDIA_SSRC, interval_lost * 256 / 250);
+            lws_red_adapt(&s, lws_red_rtcp_loss(rtcp, n2, MEDIA_SSRC));
+            if (s.level > max_level) {
+                max_level = s.level;
+            }
+            interval_lost = 0;
+        }
+    }
+
+    for (i = 0; i < total; i++) {
+        delivered += g_delivered[i];
+    }
+    raw = (double)lost / total;
+    effective = (double)(total - delivered) / total;
+    printf("  burst loss: raw %.2f%%, effective %.2f%%, recovered %llu, "
+           "redundancy %.0f%% of payload\n",
+           raw * 100, effective * 100, (unsigned long long)r.recovered,
+           100.0 * s.redundant_bytes / ((double)total * FRAME_BYTES));
+
+    ASSERT_TRUE(raw > 0.05 && raw < 0.10);
+    ASSERT_TRUE(max_level >= 2);
+    ASSERT_EQ((int)r.recovered, lost - (total - delivered));
+    ASSERT_TRUE(effective < raw / 3);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_red Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_red_packet_layout();
+    run_test_red_recovers_burst();
+    run_test_red_level0_passthrough();
+    run_test_red_adapts_to_rtcp_loss();
+    run_test_red_burst_loss_model();
+
+    printf("\n");
+    printf("==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
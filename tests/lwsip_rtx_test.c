@@ -0,0 +1,414 @@
+/**
+ * @file lwsip_rtx_test.c
+ * @brief Unit tests for lws_rtx.c (NACK/RTX, PLI/FIR, send pacing, reordering)
+ *
+ * Test coverage:
+ * - NACKed packets are retransmitted from the history as RTX packets
+ * - PLI / FIR requests, repeated FIRs are ignored
+ * - The pacer spreads a frame over the drain interval
+ * - The receiver reorders, NACKs gaps and restores RTX packets
+ * - Gaps are given up after the wait, later packets still delivered
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lws_rtx.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+
+#define MEDIA_SSRC      0x11223344u
+#define RTX_SSRC        0x55667788u
+#define PEER_SSRC       0x0badf00du
+#define MEDIA_PT        97
+#define RTX_PT          98
+#define MAX_PACKETS     64
+
+/* ========================================
+ * Helpers
+ * ======================================== */
+
+/* 捕获发送/交付的包 */
+static uint8_t g_packets[MAX_PACKETS][LWS_RTX_MAX_PACKET + 2];
+static int g_packet_len[MAX_PACKETS];
+static int g_packet_count = 0;
+
+static void capture(const uint8_t* packet, int bytes)
+{
+    if (g_packet_count < MAX_PACKETS) {
+        memcpy(g_packets[g_packet_count], packet, bytes);
+        g_packet_len[g_packet_count] = bytes;
+    }
+    g_packet_count++;
+}
+
+static int on_send(void* param, const uint8_t* packet, int bytes)
+{
+    (void)param;
+    capture(packet, bytes);
+    return 0;
+}
+
+static void on_deliver(void* param, const uint8_t* packet, int bytes)
+{
+    (void)param;
+    capture(packet, bytes);
+}
+
+static uint16_t seq_of(int i)
+{
+    return (uint16_t)((g_packets[i][2] << 8) | g_packets[i][3]);
+}
+
+static uint32_t u32_at(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* RTP包：载荷为 bytes-12 个 (seq & 0xff) */
+static int make_packet(uint8_t* buf, uint16_t seq, int pt, uint32_t ssrc, int bytes)
+{
+    memset(buf, 0, 12);
+    buf[0] = 0x80;
+    buf[1] = (uint8_t)pt;
+    buf[2] = (uint8_t)(seq >> 8);
+    buf[3] = (uint8_t)seq;
+    buf[8] = (uint8_t)(ssrc >> 24);
+    buf[9] = (uint8_t)(ssrc >> 16);
+    buf[10] = (uint8_t)(ssrc >> 8);
+    buf[11] = (uint8_t)ssrc;
+    memset(buf + 12, seq & 0xff, bytes - 12);
+    return bytes;
+}
+
+/* RTPFB/PSFB头：fmt, pt, 长度(32位字-1), 发送方SSRC, 媒体SSRC */
+static int make_fb(uint8_t* buf, int fmt, int pt, int words, uint32_t media_ssrc)
+{
+    buf[0] = (uint8_t)(0x80 | fmt);
+    buf[1] = (uint8_t)pt;
+    buf[2] = 0;
+    buf[3] = (uint8_t)(words - 1);
+    buf[4] = buf[5] = buf[6] = buf[7] = 0x42;
+    buf[8] = (uint8_t)(media_ssrc >> 24);
+    buf[9] = (uint8_t)(media_ssrc >> 16);
+    buf[10] = (uint8_t)(media_ssrc >> 8);
+    buf[11] = (uint8_t)media_ssrc;
+    return words * 4;
+}
+
+/* ========================================
+ * Sender
+ * ======================================== */
+
+TEST(nack_retransmits_rtx)
+{
+    lws_rtx_sender_t s;
+    uint8_t pkt[200];
+    uint8_t fb[16];
+    int i;
+
+    g_packet_count = 0;
+    ASSERT_EQ(lws_rtx_sender_init(&s, 100, MEDIA_SSRC, on_send, NULL), 0);
+    ASSERT_EQ(s.count, 128);
+    lws_rtx_sender_set_rtx(&s, RTX_PT, RTX_SSRC, 500);
+
+    for (i = 0; i < 10; i++) {
+        ASSERT_EQ(lws_rtx_enqueue(&s, pkt, make_packet(pkt, (uint16_t)(65530 + i), MEDIA_PT,
+                                                       MEDIA_SSRC, 100), 1000), 0);
+    }
+    /* 未设置速率：立即全部发出 */
+    ASSERT_EQ(lws_rtx_pace(&s, 1000), 10);
+    ASSERT_EQ(g_packet_count, 10);
+
+    /* NACK PID=65532, BLP=0x0005 -> 65532, 65533, 65535 */
+    g_packet_count = 0;
+    make_fb(fb, 1, 205, 4, MEDIA_SSRC);
+    fb[12] = 0xff; fb[13] = 0xfc; fb[14] = 0x00; fb[15] = 0x05;
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, sizeof(fb), 2000), 0);
+    ASSERT_EQ(g_packet_count, 3);
+    ASSERT_EQ(s.nacks, 3);
+    ASSERT_EQ(s.retransmits, 3);
+
+    /* RTX包：新PT/SSRC/序号，载荷前为原序号 */
+    ASSERT_EQ(g_packet_len[0], 102);
+    ASSERT_EQ(g_packets[0][1] & 0x7f, RTX_PT);
+    ASSERT_EQ(seq_of(0), 500);
+    ASSERT_EQ(seq_of(1), 501);
+    ASSERT_EQ(u32_at(g_packets[0] + 8), RTX_SSRC);
+    ASSERT_EQ(g_packets[0][12], 0xff);
+    ASSERT_EQ(g_packets[0][13], 0xfc);
+    ASSERT_EQ(g_packets[0][14], 65532 & 0xff);
+    ASSERT_EQ(g_packets[2][13], 0xff);
+
+    /* 短时间内重复的NACK不再重传；其它SSRC的NACK忽略 */
+    g_packet_count = 0;
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, sizeof(fb), 2000 + LWS_RTX_MIN_INTERVAL_US / 2), 0);
+    ASSERT_EQ(g_packet_count, 0);
+    make_fb(fb, 1, 205, 4, PEER_SSRC);
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, sizeof(fb), 100000), 0);
+    ASSERT_EQ(g_packet_count, 0);
+
+    /* 不使用RTX时重发原包 */
+    lws_rtx_sender_set_rtx(&s, -1, 0, 0);
+    make_fb(fb, 1, 205, 4, MEDIA_SSRC);
+    fb[12] = 0x00; fb[13] = 0x03; fb[14] = 0x00; fb[15] = 0x00;
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, sizeof(fb), 100000), 0);
+    ASSERT_EQ(g_packet_count, 1);
+    ASSERT_EQ(g_packet_len[0], 100);
+    ASSERT_EQ(seq_of(0), 3);
+    ASSERT_EQ(u32_at(g_packets[0] + 8), MEDIA_SSRC);
+
+    /* 已被覆盖的序号无法重传 */
+    g_packet_count = 0;
+    fb[12] = 0x10; fb[13] = 0x00;
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, sizeof(fb), 200000), 0);
+    ASSERT_EQ(g_packet_count, 0);
+
+    lws_rtx_sender_free(&s);
+}
+
+TEST(pli_and_fir)
+{
+    lws_rtx_sender_t s;
+    uint8_t fb[64];
+    int len;
+
+    ASSERT_EQ(lws_rtx_sender_init(&s, 16, MEDIA_SSRC, on_send, NULL), 0);
+
+    /* RR + PLI复合包 */
+    len = lws_rtx_pli_write(PEER_SSRC, MEDIA_SSRC, fb, sizeof(fb));
+    ASSERT_EQ(len, 20);
+    ASSERT_EQ(fb[1], 201);
+    ASSERT_EQ(fb[9], 206);
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, len, 0), LWS_RTX_KEYFRAME);
+    ASSERT_EQ(lws_rtx_pli_write(PEER_SSRC, MEDIA_SSRC, fb, 16), -1);
+
+    len = lws_rtx_pli_write(PEER_SSRC, PEER_SSRC, fb, sizeof(fb));
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, len, 0), 0);
+
+    /* FIR：媒体SSRC在FCI中，序号相同为重发 */
+    len = make_fb(fb, 4, 206, 5, 0);
+    fb[12] = 0x11; fb[13] = 0x22; fb[14] = 0x33; fb[15] = 0x44;
+    fb[16] = 7; fb[17] = fb[18] = fb[19] = 0;
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, len, 0), LWS_RTX_KEYFRAME);
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, len, 0), 0);
+    fb[16] = 8;
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, len, 0), LWS_RTX_KEYFRAME);
+    ASSERT_EQ(s.keyframe_requests, 3);
+
+    /* 截断的复合包 */
+    ASSERT_EQ(lws_rtx_feedback(&s, fb, len - 4, 0), 0);
+
+    lws_rtx_sender_free(&s);
+}
+
+TEST(pacer_spreads_frame)
+{
+    lws_rtx_sender_t s;
+    uint8_t pkt[1000];
+    uint64_t t;
+    int at_half = -1;
+    int i;
+
+    g_packet_count = 0;
+    ASSERT_EQ(lws_rtx_sender_init(&s, 64, MEDIA_SSRC, on_send, NULL), 0);
+
+    /* 20个1000字节的包在20ms内发完：1,000,000字节/秒 */
+    for (i = 0; i < 20; i++) {
+        lws_rtx_enqueue(&s, pkt, make_packet(pkt, (uint16_t)i, MEDIA_PT, MEDIA_SSRC, 1000),
+                        1000000);
+    }
+    lws_rtx_pace_frame(&s, 20000);
+    ASSERT_EQ(s.rate, 1000000);
+
+    for (t = 1000000; t <= 1030000; t += 250) {
+        lws_rtx_pace(&s, t);
+        if (t == 1010000) {
+            at_half = g_packet_count;
+        }
+    }
+
+    ASSERT_EQ(g_packet_count, 20);
+    ASSERT_TRUE(at_half >= 10 && at_half <= 12);
+    ASSERT_EQ(s.paced, 20);
+    ASSERT_TRUE(s.delay_max_us >= 18000 && s.delay_max_us <= 20000);
+    ASSERT_TRUE(s.delay_total_us / s.paced >= 9000 && s.delay_total_us / s.paced <= 11000);
+
+    /* 下一帧很小：速率随之降低，欠账不带入 */
+    lws_rtx_enqueue(&s, pkt, make_packet(pkt, 20, MEDIA_PT, MEDIA_SSRC, 500), 1040000);
+    lws_rtx_pace_frame(&s, 20000);
+    ASSERT_EQ(s.rate, 25000);
+    ASSERT_EQ(lws_rtx_pace(&s, 1040000), 1);
+
+    lws_rtx_sender_free(&s);
+}
+
+/* ========================================
+ * Receiver
+ * ======================================== */
+
+TEST(receiver_reorders_and_nacks)
+{
+    lws_rtx_receiver_t r;
+    uint8_t pkt[200];
+    uint8_t rtcp[64];
+    int len;
+
+    g_packet_count = 0;
+    ASSERT_EQ(lws_rtx_receiver_init(&r, 64, PEER_SSRC, on_deliver, NULL), 0);
+    r.nack = 1;
+    r.wait_us = LWS_RTX_WAIT_US;
+    r.rtx_pt = RTX_PT;
+    r.apt = MEDIA_PT;
+
+    lws_rtx_receive(&r, pkt, make_packet(pkt, 100, MEDIA_PT, MEDIA_SSRC, 50), 0);
+    lws_rtx_receive(&r, pkt, make_packet(pkt, 101, MEDIA_PT, MEDIA_SSRC, 50), 0);
+    lws_rtx_receive(&r, pkt, make_packet(pkt, 104, MEDIA_PT, MEDIA_SSRC, 50), 1000);
+    ASSERT_EQ(g_packet_count, 2);
+
+    /* 102、103缺失：RR + NACK(PID=102, BLP=0x0001) */
+    len = lws_rtx_receiver_poll(&r, 2000, rtcp, sizeof(rtcp));
+    ASSERT_EQ(len, 8 + 16);
+    ASSERT_EQ(rtcp[1], 201);
+    ASSERT_EQ(rtcp[8], 0x81);
+    ASSERT_EQ(rtcp[9], 205);
+    ASSERT_EQ(rtcp[11], 3);
+    ASSERT_EQ(u32_at(rtcp + 12), PEER_SSRC);
+    ASSERT_EQ(u32_at(rtcp + 16), MEDIA_SSRC);
+    ASSERT_EQ(rtcp[20], 0);
+    ASSERT_EQ(rtcp[21], 102);
+    ASSERT_EQ(rtcp[23], 1);
+    ASSERT_EQ(r.nacks, 2);
+
+    /* 重试间隔内不再请求 */
+    ASSERT_EQ(lws_rtx_receiver_poll(&r, 3000, rtcp, sizeof(rtcp)), 0);
+
+    /* 103以RTX到达（RTX SSRC、序号、OSN）：还原后等待102 */
+    make_packet(pkt, 7, RTX_PT, RTX_SSRC, 52);
+    pkt[12] = 0;
+    pkt[13] = 103;
+    memset(pkt + 14, 103, 38);
+    lws_rtx_receive(&r, pkt, 52, 4000);
+    ASSERT_EQ(g_packet_count, 2);
+
+    /* 102乱序到达：按序交付102/103/104 */
+    lws_rtx_receive(&r, pkt, make_packet(pkt, 102, MEDIA_PT, MEDIA_SSRC, 50), 5000);
+    ASSERT_EQ(g_packet_count, 5);
+    ASSERT_EQ(seq_of(2), 102);
+    ASSERT_EQ(seq_of(3), 103);
+    ASSERT_EQ(seq_of(4), 104);
+    ASSERT_EQ(g_packet_len[3], 50);
+    ASSERT_EQ(g_packets[3][1], MEDIA_PT);
+    ASSERT_EQ(u32_at(g_packets[3] + 8), MEDIA_SSRC);
+    ASSERT_EQ(g_packets[3][12], 103);
+    ASSERT_EQ(r.recovered, 2);
+
+    /* 重复/迟到的包丢弃 */
+    lws_rtx_receive(&r, pkt, make_packet(pkt, 103, MEDIA_PT, MEDIA_SSRC, 50), 6000);
+    ASSERT_EQ(g_packet_count, 5);
+    ASSERT_EQ(lws_rtx_receiver_poll(&r, 100000, rtcp, sizeof(rtcp)), 0);
+
+    lws_rtx_receiver_free(&r);
+}
+
+TEST(receiver_gives_up_after_wait)
+{
+    lws_rtx_receiver_t r;
+    uint8_t pkt[200];
+    uint8_t rtcp[64];
+    uint64_t t;
+    int nack_packets = 0;
+
+    g_packet_count = 0;
+    ASSERT_EQ(lws_rtx_receiver_init(&r, 32, PEER_SSRC, on_deliver, NULL), 0);
+    r.nack = 1;
+    r.wait_us = LWS_RTX_WAIT_US;
+
+    lws_rtx_receive(&r, pkt, make_packet(pkt, 10, MEDIA_PT, MEDIA_SSRC, 40), 0);
+    lws_rtx_receive(&r, pkt, make_packet(pkt, 12, MEDIA_PT, MEDIA_SSRC, 40), 0);
+    ASSERT_EQ(g_packet_count, 1);
+
+    /* 最多LWS_RTX_NACK_TRIES次请求，超时后放弃11，交付12 */
+    for (t = 0; t < LWS_RTX_WAIT_US; t += 10000) {
+        if (lws_rtx_receiver_poll(&r, t, rtcp, sizeof(rtcp)) > 0) {
+            nack_packets++;
+        }
+    }
+    ASSERT_EQ(nack_packets, LWS_RTX_NACK_TRIES);
+    ASSERT_EQ(g_packet_count, 1);
+    ASSERT_EQ(lws_rtx_receiver_poll(&r, LWS_RTX_WAIT_US, rtcp, sizeof(rtcp)), 0);
+    ASSERT_EQ(g_packet_count, 2);
+    ASSERT_EQ(seq_of(1), 12);
+    ASSERT_EQ(r.lost, 1);
+
+    /* 序号大跳变（超出窗口）：直接重新对齐 */
+    lws_rtx_receive(&r, pkt, make_packet(pkt, 5000, MEDIA_PT, MEDIA_SSRC, 40), 300000);
+    ASSERT_EQ(g_packet_count, 3);
+    lws_rtx_receive(&r, pkt, make_packet(pkt, 5001, MEDIA_PT, MEDIA_SSRC, 40), 300000);
+    ASSERT_EQ(g_packet_count, 4);
+
+    /* 新SSRC：重新开始，不对旧流NACK */
+    lws_rtx_receive(&r, pkt, make_packet(pkt, 9, MEDIA_PT, PEER_SSRC, 40), 310000);
+    ASSERT_EQ(g_packet_count, 5);
+    ASSERT_EQ(r.media_ssrc, PEER_SSRC);
+    ASSERT_EQ(lws_rtx_receiver_poll(&r, 320000, rtcp, sizeof(rtcp)), 0);
+
+    lws_rtx_receiver_free(&r);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_rtx Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_nack_retransmits_rtx();
+    run_test_pli_and_fir();
+    run_test_pacer_spreads_frame();
+    run_test_receiver_reorders_and_nacks();
+    run_test_receiver_gives_up_after_wait();
+
+    printf("\n");
+    printf("==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,625 @@
+/**
+ * @file lwsip_sdp_test.c
+ * @brief Unit tests and benchmark for lws_sdp.c (single-pass SDP parser)
+ *
+ * Test coverage:
+ * - Origin, session/media connection and direction inheritance
+ * - m= port/count, proto, payload list with rtpmap/fmtp/ptime
+ * - ICE credentials (session and media level), candidates, ice-lite
+ * - SDES a=crypto lines
+ * - DTLS-SRTP a=fingerprint / a=setup (session and media level)
+ * - Malformed input and limits
+ * - Benchmark against the previous strstr/sscanf extraction on real-world SDPs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lws_sdp.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+#define ASSERT_NULL(ptr) ASSERT_TRUE((ptr) == NULL)
+#define ASSERT_NOT_NULL(ptr) ASSERT_TRUE((ptr) != NULL)
+#define ASSERT_SLICE(s, str) ASSERT_TRUE(lws_sdp_str_eq((s), (str)))
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* ========================================
+ * Real-world SDPs
+ * ======================================== */
+
+/* Asterisk 18 offer (RTP/AVP, no ICE) */
+static const char* SDP_ASTERISK =
+    "v=0\r\n"
+    "o=- 1713245123 1713245124 IN IP4 203.0.113.10\r\n"
+    "s=Asterisk\r\n"
+    "c=IN IP4 203.0.113.10\r\n"
+    "t=0 0\r\n"
+    "m=audio 14568 RTP/AVP 0 8 3 111 101\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n"
+    "a=rtpmap:8 PCMA/8000\r\n"
+    "a=rtpmap:3 GSM/8000\r\n"
+    "a=rtpmap:111 G726-32/8000\r\n"
+    "a=rtpmap:101 telephone-event/8000\r\n"
+    "a=fmtp:101 0-16\r\n"
+    "a=ptime:20\r\n"
+    "a=maxptime:150\r\n"
+    "a=sendrecv\r\n";
+
+/* Linphone offer (ICE, a=rtcp, session-level credentials) */
+static const char* SDP_LINPHONE =
+    "v=0\r\n"
+    "o=1001 3129 1853 IN IP4 192.168.1.20\r\n"
+    "s=Talk\r\n"
+    "c=IN IP4 192.168.1.20\r\n"
+    "t=0 0\r\n"
+    "a=ice-pwd:a4b3f0c3e26f1d2e0b8e6c1f\r\n"
+    "a=ice-ufrag:9f0e3c1a\r\n"
+    "a=rtcp-xr:rcvr-rtt=all:10000 stat-summary=loss,dup,jitt,TTL voip-metrics\r\n"
+    "m=audio 7078 RTP/AVP 96 97 98 0 8 101\r\n"
+    "a=rtpmap:96 opus/48000/2\r\n"
+    "a=fmtp:96 useinbandfec=1\r\n"
+    "a=rtpmap:97 speex/16000\r\n"
+    "a=fmtp:97 vbr=on\r\n"
+    "a=rtpmap:98 speex/8000\r\n"
+    "a=fmtp:98 vbr=on\r\n"
+    "a=rtpmap:101 telephone-event/8000\r\n"
+    "a=rtcp:7079\r\n"
+    "a=candidate:1 1 UDP 2130706431 192.168.1.20 7078 typ host\r\n"
+    "a=candidate:1 2 UDP 2130706430 192.168.1.20 7079 typ host\r\n"
+    "a=candidate:2 1 UDP 1694498815 198.51.100.7 61322 typ srflx raddr 192.168.1.20 rport 7078\r\n"
+    "a=candidate:2 2 UDP 1694498814 198.51.100.7 61323 typ srflx raddr 192.168.1.20 rport 7079\r\n";
+
+/* Chrome WebRTC offer (BUNDLE, media-level credentials, video) */
+static const char* SDP_CHROME =
+    "v=0\r\n"
+    "o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+    "s=-\r\n"
+    "t=0 0\r\n"
+    "a=group:BUNDLE 0 1\r\n"
+    "a=extmap-allow-mixed\r\n"
+    "a=msid-semantic: WMS stream0\r\n"
+    "m=audio 9 UDP/TLS/RTP/SAVPF 111 63 9 0 8 13 110 126\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "a=rtcp:9 IN IP4 0.0.0.0\r\n"
+    "a=candidate:1467250027 1 udp 2122260223 192.168.0.196 46243 typ host generation 0\r\n"
+    "a=candidate:435653019 1 tcp 1845501695 192.168.0.196 0 typ host tcptype active generation 0\r\n"
+    "a=candidate:1853887674 1 udp 1518280447 47.61.61.61 36768 typ srflx raddr 192.168.0.196 rport 36768 generation 0\r\n"
+    "a=ice-ufrag:Oyef7uvBlwafI3hT\r\n"
+    "a=ice-pwd:T0teqPLNQQOf+5W+ls+P2p16\r\n"
+    "a=ice-options:trickle\r\n"
+    "a=fingerprint:sha-256 49:66:12:17:0D:1C:91:AE:57:4C:C6:36:DD:D5:97:D2:7D:62:C9:9A:7F:B9:A3:F1:EC:CF:A8:97:28:3B:3F:56\r\n"
+    "a=setup:actpass\r\n"
+    "a=mid:0\r\n"
+    "a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+    "a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+    "a=extmap:3 http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n"
+    "a=extmap:4 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+    "a=sendrecv\r\n"
+    "a=msid:stream0 audio0\r\n"
+    "a=rtcp-mux\r\n"
+    "a=rtpmap:111 opus/48000/2\r\n"
+    "a=rtcp-fb:111 transport-cc\r\n"
+    "a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+    "a=rtpmap:63 red/48000/2\r\n"
+    "a=fmtp:63 111/111\r\n"
+    "a=rtpmap:9 G722/8000\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n"
+    "a=rtpmap:8 PCMA/8000\r\n"
+    "a=rtpmap:13 CN/8000\r\n"
+    "a=rtpmap:110 telephone-event/48000\r\n"
+    "a=rtpmap:126 telephone-event/8000\r\n"
+    "a=ssrc:3735928559 cname:4TOk42mSjXCkVIa6\r\n"
+    "a=ssrc:3735928559 msid:stream0 audio0\r\n"
+    "m=video 9 UDP/TLS/RTP/SAVPF 96 97 102 103\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "a=rtcp:9 IN IP4 0.0.0.0\r\n"
+    "a=ice-ufrag:Oyef7uvBlwafI3hT\r\n"
+    "a=ice-pwd:T0teqPLNQQOf+5W+ls+P2p16\r\n"
+    "a=mid:1\r\n"
+    "a=extmap:4/recvonly urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+    "a=recvonly\r\n"
+    "a=rtcp-mux\r\n"
+    "a=rtcp-rsize\r\n"
+    "a=rtpmap:96 VP8/90000\r\n"
+    "a=rtcp-fb:96 nack\r\n"
+    "a=rtcp-fb:96 nack pli\r\n"
+    "a=rtpmap:97 rtx/90000\r\n"
+    "a=fmtp:97 apt=96\r\n"
+    "a=rtpmap:102 H264/90000\r\n"
+    "a=fmtp:102 level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=42001f\r\n"
+    "a=rtpmap:103 rtx/90000\r\n"
+    "a=fmtp:103 apt=102\r\n";
+
+/* ========================================
+ * Previous extraction code (baseline for the benchmark)
+ * ======================================== */
+
+static int legacy_has_ice(const char* sdp)
+{
+    return strstr(sdp, "a=ice-ufrag:") || strstr(sdp, "a=ice-pwd:") ||
+           strstr(sdp, "a=candidate:");
+}
+
+static int legacy_attribute(const char* sdp, const char* attr, char* value, size_t size)
+{
+    char search[128];
+    snprintf(search, sizeof(search), "a=%s:", attr);
+    const char* line = strstr(sdp, search);
+    if (!line) {
+        return -1;
+    }
+    line += strlen(search);
+    const char* end = strchr(line, '\r');
+    if (!end) end = strchr(line, '\n');
+    if (!end) end = line + strlen(line);
+    size_t n = (size_t)(end - line) < size ? (size_t)(end - line) : size - 1;
+    memcpy(value, line, n);
+    value[n] = '\0';
+    return 0;
+}
+
+static int legacy_candidates(const char* sdp)
+{
+    const char* line = sdp;
+    int count = 0;
+
+    while ((line = strstr(line, "a=candidate:")) != NULL) {
+        char foundation[33], transport[10], ip[64], type[16];
+        unsigned short component, port;
+        unsigned int priority;
+        if (sscanf(line, "a=candidate:%32s %hu %9s %u %63s %hu typ %15s",
+                   foundation, &component, transport, &priority, ip, &port, type) == 7) {
+            count++;
+        }
+        line += 12;
+    }
+
+    return count;
+}
+
+static int legacy_audio(const char* sdp, char* ip, size_t ip_size, int* port, int* pt_count)
+{
+    const char* m = strstr(sdp, "m=audio ");
+    const char* c;
+    char fmt_list[256];
+
+    if (!m) {
+        return -1;
+    }
+    *port = atoi(m + 8);
+    *pt_count = 0;
+    if (sscanf(m, "m=audio %*d %*s %255[^\r\n]", fmt_list) == 1) {
+        char* save = NULL;
+        char* tok = strtok_r(fmt_list, " ", &save);
+        while (tok) {
+            (*pt_count)++;
+            tok = strtok_r(NULL, " ", &save);
+        }
+    }
+    c = strstr(m, "c=IN IP4 ");
+    if (!c) {
+        c = strstr(sdp, "c=IN IP4 ");
+    }
+    if (c) {
+        char fmt[16];
+        snprintf(fmt, sizeof(fmt), "%%%zus", ip_size - 1);
+        sscanf(c + 9, fmt, ip);
+    }
+    return 0;
+}
+
+/* 旧实现处理一份SDP需要的全部提取：ICE检测、凭证、候选、音频地址与编码列表 */
+static int legacy_extract(const char* sdp)
+{
+    char ufrag[256], pwd[256], ip[64] = "";
+    int port = 0, pts = 0, cands = 0;
+
+    if (legacy_has_ice(sdp)) {
+        legacy_attribute(sdp, "ice-ufrag", ufrag, sizeof(ufrag));
+        legacy_attribute(sdp, "ice-pwd", pwd, sizeof(pwd));
+        cands = legacy_candidates(sdp);
+    }
+    legacy_audio(sdp, ip, sizeof(ip), &port, &pts);
+    return port + pts + cands + (int)ip[0];
+}
+
+/* ========================================
+ * Parser tests
+ * ======================================== */
+
+TEST(sdp_parse_asterisk)
+{
+    lws_sdp_t sdp;
+    ASSERT_EQ(lws_sdp_parse(&sdp, SDP_ASTERISK, -1), 0);
+
+    ASSERT_EQ(sdp.sess_id, 1713245123ULL);
+    ASSERT_EQ(sdp.sess_version, 1713245124ULL);
+    ASSERT_SLICE(sdp.origin_addr, "203.0.113.10");
+    ASSERT_SLICE(sdp.conn.addrtype, "IP4");
+    ASSERT_SLICE(sdp.conn.addr, "203.0.113.10");
+    ASSERT_EQ(sdp.media_count, 1);
+
+    const lws_sdp_media_t* audio = lws_sdp_find_media(&sdp, "audio");
+    ASSERT_NOT_NULL(audio);
+    ASSERT_EQ(audio->port, 14568);
+    ASSERT_EQ(audio->port_count, 1);
+    ASSERT_SLICE(audio->proto, "RTP/AVP");
+    ASSERT_EQ(audio->fmt_count, 5);
+    ASSERT_EQ(audio->fmts[0].pt, 0);
+    ASSERT_EQ(audio->fmts[4].pt, 101);
+    ASSERT_SLICE(audio->fmts[1].encoding, "PCMA");
+    ASSERT_EQ(audio->fmts[1].clock_rate, 8000);
+    ASSERT_SLICE(lws_sdp_find_fmt(audio, 101)->fmtp, "0-16");
+    ASSERT_EQ(audio->ptime, 20);
+    ASSERT_EQ(audio->maxptime, 150);
+
+    /* 媒体级无c=时继承会话级 */
+    ASSERT_SLICE(lws_sdp_media_conn(&sdp, audio)->addr, "203.0.113.10");
+    ASSERT_EQ(lws_sdp_media_dir(&sdp, audio), LWS_MEDIA_DIR_SENDRECV);
+
+    lws_sdp_str_t ufrag, pwd;
+    ASSERT_EQ(lws_sdp_media_ice(&sdp, audio, &ufrag, &pwd), 0);
+    ASSERT_EQ(audio->cand_count, 0);
+    ASSERT_NULL(lws_sdp_find_media(&sdp, "video"));
+}
+
+TEST(sdp_parse_linphone_ice)
+{
+    lws_sdp_t sdp;
+    char buf[64];
+    ASSERT_EQ(lws_sdp_parse(&sdp, SDP_LINPHONE, -1), 0);
+
+    const lws_sdp_media_t* audio = lws_sdp_find_media(&sdp, "audio");
+    ASSERT_NOT_NULL(audio);
+    ASSERT_EQ(audio->rtcp_port, 7079);
+    ASSERT_EQ(audio->rtcp_conn.addr.n, 0);
+    ASSERT_EQ(audio->mid.n, 0);
+    ASSERT_EQ(audio->mid_ext, 0);
+    ASSERT_EQ(lws_sdp_bundled(&sdp, audio), 0);
+
+    /* opus/48000/2 */
+    const lws_sdp_fmt_t* opus = lws_sdp_find_fmt(audio, 96);
+    ASSERT_NOT_NULL(opus);
+    ASSERT_SLICE(opus->encoding, "opus");
+    ASSERT_EQ(opus->clock_rate, 48000);
+    ASSERT_EQ(opus->channels, 2);
+    ASSERT_SLICE(opus->fmtp, "useinbandfec=1");
+    ASSERT_EQ(lws_sdp_find_fmt(audio, 0)->channels, 1);
+    ASSERT_EQ(lws_sdp_find_fmt(audio, 0)->encoding.n, 0);   /* 静态PT无rtpmap */
+
+    /* 会话级ICE凭证 */
+    lws_sdp_str_t ufrag, pwd;
+    ASSERT_EQ(lws_sdp_media_ice(&sdp, audio, &ufrag, &pwd), 1);
+    lws_sdp_str_copy(buf, sizeof(buf), ufrag);
+    ASSERT_TRUE(strcmp(buf, "9f0e3c1a") == 0);
+    ASSERT_SLICE(pwd, "a4b3f0c3e26f1d2e0b8e6c1f");
+
+    ASSERT_EQ(audio->cand_count, 4);
+    ASSERT_SLICE(audio->cands[0].foundation, "1");
+    ASSERT_EQ(audio->cands[1].component, 2);
+    ASSERT_SLICE(audio->cands[2].type, "srflx");
+    ASSERT_SLICE(audio->cands[2].addr, "198.51.100.7");
+    ASSERT_EQ(audio->cands[2].port, 61322);
+    ASSERT_EQ(audio->cands[2].priority, 1694498815u);
+    ASSERT_SLICE(audio->cands[2].raddr, "192.168.1.20");
+    ASSERT_EQ(audio->cands[2].rport, 7078);
+}
+
+TEST(sdp_parse_chrome_bundle)
+{
+    lws_sdp_t sdp;
+    ASSERT_EQ(lws_sdp_parse(&sdp, SDP_CHROME, -1), 0);
+
+    ASSERT_EQ(sdp.sess_id, 4611731400430051336ULL);
+    ASSERT_EQ(sdp.sess_version, 2ULL);
+    ASSERT_EQ(sdp.conn.addr.n, 0);
+    ASSERT_EQ(sdp.media_count, 2);
+
+    const lws_sdp_media_t* audio = lws_sdp_find_media(&sdp, "audio");
+    const lws_sdp_media_t* video = lws_sdp_find_media(&sdp, "video");
+    ASSERT_NOT_NULL(audio);
+    ASSERT_NOT_NULL(video);
+
+    ASSERT_SLICE(audio->proto, "UDP/TLS/RTP/SAVPF");
+    ASSERT_SLICE(lws_sdp_media_conn(&sdp, audio)->addr, "0.0.0.0");
+    ASSERT_EQ(audio->rtcp_mux, 1);
+    ASSERT_EQ(audio->rtcp_port, 9);
+    ASSERT_SLICE(audio->rtcp_conn.addrtype, "IP4");
+    ASSERT_SLICE(audio->rtcp_conn.addr, "0.0.0.0");
+    ASSERT_EQ(audio->ssrc, 3735928559u);
+    ASSERT_EQ(audio->fmt_count, 8);
+    ASSERT_SLICE(lws_sdp_find_fmt(audio, 111)->fmtp, "minptime=10;useinbandfec=1");
+    ASSERT_EQ(lws_sdp_find_fmt(audio, 110)->clock_rate, 48000);
+    ASSERT_EQ(audio->cand_count, 3);
+    ASSERT_SLICE(audio->cands[1].transport, "tcp");
+
+    lws_sdp_str_t ufrag, pwd;
+    ASSERT_EQ(lws_sdp_media_ice(&sdp, audio, &ufrag, &pwd), 1);
+    ASSERT_SLICE(ufrag, "Oyef7uvBlwafI3hT");
+    ASSERT_SLICE(pwd, "T0teqPLNQQOf+5W+ls+P2p16");
+    ASSERT_EQ(audio->ice_trickle, 1);
+    ASSERT_EQ(sdp.ice_trickle, 0);
+    ASSERT_EQ(audio->end_of_candidates, 0);
+
+    /* 视频的方向不影响音频 */
+    ASSERT_EQ(lws_sdp_media_dir(&sdp, audio), LWS_MEDIA_DIR_SENDRECV);
+    ASSERT_EQ(lws_sdp_media_dir(&sdp, video), LWS_MEDIA_DIR_RECVONLY);
+    ASSERT_SLICE(lws_sdp_find_fmt(video, 102)->encoding, "H264");
+    ASSERT_SLICE(lws_sdp_find_fmt(video, 97)->fmtp, "apt=96");
+    ASSERT_EQ(lws_sdp_find_fmt(video, 96)->rtcp_fb, LWS_SDP_FB_NACK | LWS_SDP_FB_PLI);
+    ASSERT_EQ(lws_sdp_find_fmt(video, 102)->rtcp_fb, 0);
+    ASSERT_EQ(lws_sdp_find_fmt(audio, 111)->rtcp_fb, 0);    /* transport-cc不记录 */
+
+    /* BUNDLE：两个m=行共用传输，MID头扩展用于分流 */
+    ASSERT_SLICE(sdp.bundle, "0 1");
+    ASSERT_SLICE(audio->mid, "0");
+    ASSERT_SLICE(video->mid, "1");
+    ASSERT_EQ(audio->mid_ext, 4);
+    ASSERT_EQ(video->mid_ext, 4);
+    ASSERT_EQ(lws_sdp_bundled(&sdp, audio), 1);
+    ASSERT_EQ(lws_sdp_bundled(&sdp, video), 1);
+}
+
+TEST(sdp_parse_trickle)
+{
+    static const char* text =
+        "v=0\r\n"
+        "o=- 1 1 IN IP4 203.0.113.5\r\n"
+        "s=-\r\n"
+        "c=IN IP4 203.0.113.5\r\n"
+        "t=0 0\r\n"
+        "a=ice-options:ice2 trickle\r\n"
+        "a=ice-ufrag:abcd\r\n"
+        "a=ice-pwd:0123456789abcdef012345\r\n"
+        "m=audio 40000 RTP/AVP 0\r\n"
+        "a=candidate:1 1 udp 2130706431 203.0.113.5 40000 typ host\r\n"
+        "a=end-of-candidates\r\n"
+        "m=video 0 RTP/AVP 96\r\n"
+        "a=ice-options:trickled\r\n";
+    lws_sdp_t sdp;
+
+    ASSERT_EQ(lws_sdp_parse(&sdp, text, -1), 0);
+    ASSERT_EQ(sdp.ice_trickle, 1);
+    ASSERT_EQ(sdp.end_of_candidates, 0);
+    ASSERT_EQ(sdp.media[0].end_of_candidates, 1);
+    ASSERT_EQ(sdp.media[0].cand_count, 1);
+    ASSERT_EQ(sdp.media[1].ice_trickle, 0);     /* 按token匹配 */
+    ASSERT_EQ(sdp.media[1].end_of_candidates, 0);
+}
+
+TEST(sdp_parse_session_dir_and_lf)
+{
+    /* 仅LF换行，会话级方向，媒体级c=覆盖，m= port/count */
+    const char* text =
+        "v=0\n"
+        "o=- 1 7 IN IP4 10.0.0.1\n"
+        "s=-\n"
+        "c=IN IP4 10.0.0.1\n"
+        "t=0 0\n"
+        "a=sendonly\n"
+        "m=audio 4000/2 RTP/AVP 8\n"
+        "c=IN IP4 10.0.0.2/127\n"
+        "m=video 0 RTP/AVP 96\n"
+        "a=inactive";
+    lws_sdp_t sdp;
+    ASSERT_EQ(lws_sdp_parse(&sdp, text, -1), 0);
+    ASSERT_EQ(sdp.sess_version, 7ULL);
+    ASSERT_EQ(sdp.media_count, 2);
+
+    const lws_sdp_media_t* audio = &sdp.media[0];
+    ASSERT_EQ(audio->port, 4000);
+    ASSERT_EQ(audio->port_count, 2);
+    ASSERT_SLICE(lws_sdp_media_conn(&sdp, audio)->addr, "10.0.0.2");
+    ASSERT_EQ(lws_sdp_media_dir(&sdp, audio), LWS_MEDIA_DIR_SENDONLY);
+
+    ASSERT_EQ(sdp.media[1].port, 0);
+    ASSERT_EQ(lws_sdp_media_dir(&sdp, &sdp.media[1]), LWS_MEDIA_DIR_INACTIVE);
+}
+
+TEST(sdp_parse_sdes)
+{
+    /* RFC 4568 §9.1的offer：两个a=crypto，第二个带会话参数 */
+    const char* text =
+        "v=0\r\n"
+        "o=sam 2890844526 2890842807 IN IP4 10.47.16.5\r\n"
+        "s=SRTP Discussion\r\n"
+        "c=IN IP4 168.2.17.12\r\n"
+        "t=2873397496 2873404696\r\n"
+        "m=audio 49170 RTP/SAVP 0\r\n"
+        "a=crypto:1 AES_CM_128_HMAC_SHA1_80 "
+        "inline:WVNfX19zZW1jdGwgKCkgewkyMjA7fQp9CnVubGVz|2^20|1:4\r\n"
+        "a=crypto:2 AES_CM_128_HMAC_SHA1_32 "
+        "inline:NzB4d1BINUAvLEw6UzF3WSJ+PSdFcGdUJShpX1Zj|2^20|1:32 UNENCRYPTED_SRTCP\r\n"
+        "a=crypto:x broken\r\n";
+    lws_sdp_t sdp;
+    ASSERT_EQ(lws_sdp_parse(&sdp, text, -1), 0);
+
+    const lws_sdp_media_t* audio = &sdp.media[0];
+    ASSERT_SLICE(audio->proto, "RTP/SAVP");
+    ASSERT_EQ(audio->crypto_count, 2);
+    ASSERT_EQ(audio->cryptos[0].tag, 1);
+    ASSERT_SLICE(audio->cryptos[0].suite, "AES_CM_128_HMAC_SHA1_80");
+    ASSERT_SLICE(audio->cryptos[0].key, "inline:WVNfX19zZW1jdGwgKCkgewkyMjA7fQp9CnVubGVz|2^20|1:4");
+    ASSERT_EQ(audio->cryptos[1].tag, 2);
+    ASSERT_SLICE(audio->cryptos[1].key, "inline:NzB4d1BINUAvLEw6UzF3WSJ+PSdFcGdUJShpX1Zj|2^20|1:32");
+}
+
+TEST(sdp_parse_dtls)
+{
+    /* 会话级fingerprint，第二个m=行覆盖 */
+    const char* text =
+        "v=0\r\n"
+        "o=- 1 1 IN IP4 127.0.0.1\r\n"
+        "s=-\r\n"
+        "c=IN IP4 10.0.0.1\r\n"
+        "t=0 0\r\n"
+        "a=fingerprint:sha-256 4A:AD:B9:B1:3F:82:18:3B\r\n"
+        "m=audio 9 UDP/TLS/RTP/SAVPF 111\r\n"
+        "a=setup:actpass\r\n"
+        "m=video 9 UDP/TLS/RTP/SAVPF 96\r\n"
+        "a=fingerprint:sha-1 00:11:22\r\n"
+        "a=setup:active\r\n"
+        "m=audio 10 RTP/AVP 0\r\n";
+    lws_sdp_t sdp;
+    lws_sdp_str_t fp, setup;
+    ASSERT_EQ(lws_sdp_parse(&sdp, text, -1), 0);
+    ASSERT_EQ(sdp.media_count, 3);
+
+    ASSERT_EQ(lws_sdp_media_dtls(&sdp, &sdp.media[0], &fp, &setup), 1);
+    ASSERT_SLICE(fp, "sha-256 4A:AD:B9:B1:3F:82:18:3B");
+    ASSERT_SLICE(setup, "actpass");
+    ASSERT_EQ(lws_sdp_media_dtls(&sdp, &sdp.media[1], &fp, &setup), 1);
+    ASSERT_SLICE(fp, "sha-1 00:11:22");
+    ASSERT_SLICE(setup, "active");
+    ASSERT_EQ(lws_sdp_media_dtls(&sdp, &sdp.media[2], &fp, &setup), 1);
+    ASSERT_EQ(setup.n, 0);
+}
+
+TEST(sdp_parse_malformed)
+{
+    lws_sdp_t sdp;
+    lws_sdp_cand_t cand;
+
+    ASSERT_EQ(lws_sdp_parse(&sdp, "", -1), -1);
+    ASSERT_EQ(lws_sdp_parse(&sdp, "hello world", -1), -1);
+    ASSERT_EQ(lws_sdp_parse(&sdp, "v=0\r\nm=audio 1 RTP/AVP 0\r\n", -1), -1);
+    ASSERT_EQ(lws_sdp_parse(NULL, SDP_ASTERISK, -1), -1);
+
+    /* 长度参数：截断在m=之前 */
+    const char* m = strstr(SDP_ASTERISK, "m=audio");
+    ASSERT_EQ(lws_sdp_parse(&sdp, SDP_ASTERISK, (int)(m - SDP_ASTERISK)), 0);
+    ASSERT_EQ(sdp.media_count, 0);
+
+    /* 畸形candidate被跳过 */
+    ASSERT_EQ(lws_sdp_parse_candidate(&cand, "1 1 UDP 100 10.0.0.1 5000 host", -1), -1);
+    ASSERT_EQ(lws_sdp_parse_candidate(&cand, "1 x UDP 100 10.0.0.1 5000 typ host", -1), -1);
+    ASSERT_EQ(lws_sdp_parse_candidate(&cand, "a=candidate:1 1 UDP 100 10.0.0.1 5000 typ host\r\n", -1), 0);
+    ASSERT_SLICE(cand.type, "host");
+    ASSERT_EQ(cand.port, 5000);
+}
+
+TEST(sdp_parse_limits)
+{
+    char text[4096];
+    int len = snprintf(text, sizeof(text), "v=0\r\no=- 1 1 IN IP4 10.0.0.1\r\ns=-\r\nt=0 0\r\n");
+    int i;
+
+    /* 超过LWS_SDP_MAX_MEDIA的m=及其属性被丢弃 */
+    for (i = 0; i < LWS_SDP_MAX_MEDIA + 2; i++) {
+        len += snprintf(text + len, sizeof(text) - len,
+                        "m=audio %d RTP/AVP 0\r\na=ptime:%d\r\n", 1000 + i, 10 + i);
+    }
+    lws_sdp_t sdp;
+    ASSERT_EQ(lws_sdp_parse(&sdp, text, len), 0);
+    ASSERT_EQ(sdp.media_count, LWS_SDP_MAX_MEDIA);
+    ASSERT_EQ(sdp.media[LWS_SDP_MAX_MEDIA - 1].ptime, 10 + LWS_SDP_MAX_MEDIA - 1);
+}
+
+/* ========================================
+ * Benchmark
+ * ======================================== */
+
+#define BENCH_ITERATIONS 100000
+
+static void bench_one(const char* name, const char* text)
+{
+    volatile int sink = 0;
+    double t0, t1, legacy_ns, parse_ns;
+    int i;
+
+    t0 = now_sec();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += legacy_extract(text);
+    }
+    t1 = now_sec();
+    legacy_ns = (t1 - t0) * 1e9 / BENCH_ITERATIONS;
+
+    t0 = now_sec();
+    for (i = 0; i < BENCH_ITERATIONS; i++) {
+        lws_sdp_t sdp;
+        lws_sdp_parse(&sdp, text, -1);
+        sink += sdp.media_count;
+    }
+    t1 = now_sec();
+    parse_ns = (t1 - t0) * 1e9 / BENCH_ITERATIONS;
+
+    printf("    %-9s %5zu bytes: strstr %6.0f ns, single-pass %6.0f ns (%.1fx)\n",
+           name, strlen(text), legacy_ns, parse_ns, legacy_ns / parse_ns);
+    (void)sink;
+}
+
+TEST(sdp_bench)
+{
+    bench_one("asterisk", SDP_ASTERISK);
+    bench_one("linphone", SDP_LINPHONE);
+    bench_one("chrome", SDP_CHROME);
+    printf("    sizeof(lws_sdp_t) = %zu bytes\n", sizeof(lws_sdp_t));
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_sdp Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_sdp_parse_asterisk();
+    run_test_sdp_parse_linphone_ice();
+    run_test_sdp_parse_chrome_bundle();
+    run_test_sdp_parse_trickle();
+    run_test_sdp_parse_session_dir_and_lf();
+    run_test_sdp_parse_sdes();
+    run_test_sdp_parse_dtls();
+    run_test_sdp_parse_malformed();
+    run_test_sdp_parse_limits();
+    run_test_sdp_bench();
+
+    printf("\n==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
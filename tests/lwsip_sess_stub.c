@@ -128,6 +128,59 @@ int lws_dev_write_audio(void* dev, const void* data, int len) {
     return 0;
 }
 
+/* 直通录音：测试设置设备接受的编码包格式（lws_audio_format_t，-1为不接受） */
+int g_stub_audio_packet_format = -1;
+int g_stub_audio_packets_written = 0;
+
+int lws_dev_audio_packet_supported(void* dev, int format) {
+    (void)dev;
+    return g_stub_audio_packet_format >= 0 && format == g_stub_audio_packet_format;
+}
+
+int lws_dev_write_audio_packet(void* dev, const void* data, int bytes,
+                               int64_t pts, int samples) {
+    (void)dev;
+    (void)data;
+    (void)bytes;
+    (void)pts;
+    g_stub_audio_packets_written++;
+    return samples;
+}
+
+/* 分段：切换设备的音频格式（直通判断随之改变），g_stub_audio_segment_fail时不支持 */
+int g_stub_audio_segments = 0;
+int g_stub_audio_segment_fail = 0;
+
+int lws_dev_next_audio_segment(void* dev, int format, int sample_rate) {
+    (void)dev;
+    (void)sample_rate;
+    if (g_stub_audio_segment_fail) {
+        return -1;
+    }
+    g_stub_audio_packet_format = format;
+    g_stub_audio_segments++;
+    return 0;
+}
+
+int lws_dev_read_video(void* dev, void* buf, int size) {
+    (void)dev;
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+int lws_dev_write_video(void* dev, const void* data, int size) {
+    (void)dev;
+    (void)data;
+    (void)size;
+    return 0;
+}
+
+int lws_dev_request_keyframe(void* dev) {
+    (void)dev;
+    return -1;
+}
+
 /* Stub for lws_trans functions */
 void* lws_trans_create(const void* config, const void* handler) {
     (void)config;
@@ -222,12 +275,40 @@ int rtp_payload_encode_input(void* encoder, const void* data, int len, void* out
     return 0;
 }
 
-void* rtp_payload_decode_create(int payload_type, const void* config) {
+void rtp_payload_encode_getinfo(void* encoder, uint16_t* seq, uint32_t* timestamp) {
+    (void)encoder;
+    *seq = 0;
+    *timestamp = 0;
+}
+
+/* librtp struct rtp_payload_t：保存解码回调，测试经stub_rtp_deliver()模拟收到的负载 */
+typedef struct {
+    void* (*alloc)(void* param, int bytes);
+    void (*free)(void* param, void* packet);
+    int (*packet)(void* param, const void* packet, int bytes, uint32_t timestamp, int flags);
+} stub_rtp_payload_t;
+
+static stub_rtp_payload_t s_rtp_decoder;
+static void* s_rtp_decoder_param = NULL;
+
+void* rtp_payload_decode_create(int payload_type, const char* name,
+                                const void* handler, void* param) {
     (void)payload_type;
-    (void)config;
+    (void)name;
+    if (handler) {
+        memcpy(&s_rtp_decoder, handler, sizeof(s_rtp_decoder));
+        s_rtp_decoder_param = param;
+    }
     return (void*)0x8888;
 }
 
+int stub_rtp_deliver(const void* payload, int bytes, uint32_t timestamp) {
+    if (!s_rtp_decoder.packet) {
+        return -1;
+    }
+    return s_rtp_decoder.packet(s_rtp_decoder_param, payload, bytes, timestamp, 0);
+}
+
 void rtp_payload_decode_destroy(void* decoder) {
     (void)decoder;
 }
@@ -253,6 +334,13 @@ int rtp_rtcp_report(void* rtp, void* buf, int size) {
     return 0;
 }
 
+int rtp_onsend(void* rtp, const void* data, int len) {
+    (void)rtp;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
 int rtp_onreceived_rtcp(void* rtp, const void* data, int len) {
     (void)rtp;
     (void)data;
@@ -15,8 +15,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "lws_sess.h"
+#include "lws_stun.h"
+#include "lws_ice.h"
+#include "lws_red.h"
 #include "lws_err.h"
 #include "lws_mem.h"
 #include "lws_log.h"
@@ -62,6 +71,7 @@ static int g_test_failed = 0;
 static int g_on_state_changed_called = 0;
 static int g_on_sdp_ready_called = 0;
 static int g_on_candidate_called = 0;
+static int g_on_gathering_done_called = 0;
 static int g_on_connected_called = 0;
 static int g_on_disconnected_called = 0;
 static int g_on_error_called = 0;
@@ -76,6 +86,7 @@ static void reset_mocks(void) {
     g_on_state_changed_called = 0;
     g_on_sdp_ready_called = 0;
     g_on_candidate_called = 0;
+    g_on_gathering_done_called = 0;
     g_on_connected_called = 0;
     g_on_disconnected_called = 0;
     g_on_error_called = 0;
@@ -117,7 +128,6 @@ static void mock_on_sdp_ready(
     }
 }
 
-__attribute__((unused))
 static void mock_on_candidate(
     lws_sess_t* sess,
     const char* candidate,
@@ -132,6 +142,16 @@ static void mock_on_candidate(
     }
 }
 
+static void mock_on_gathering_done(
+    lws_sess_t* sess,
+    void* userdata)
+{
+    (void)sess;
+    (void)userdata;
+
+    g_on_gathering_done_called++;
+}
+
 __attribute__((unused))
 static void mock_on_connected(
     lws_sess_t* sess,
@@ -332,6 +352,1380 @@ TEST(sess_stop_null) {
     ASSERT_TRUE(1);
 }
 
+TEST(sess_update_remote_sdp) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    const char* sdp;
+    unsigned long long version = 0;
+    unsigned long long new_version = 0;
+
+    reset_mocks();
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    memset(&handler, 0, sizeof(handler));
+    handler.on_sdp_ready = mock_on_sdp_ready;
+
+    lws_sess_t* sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+
+    /* 初始offer/answer */
+    ASSERT_EQ(lws_sess_set_remote_sdp(sess,
+        "v=0\r\no=peer 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 0 8\r\na=sendrecv\r\n"), 0);
+    ASSERT_EQ(lws_sess_gather_candidates(sess), 0);
+    ASSERT_EQ(g_on_sdp_ready_called, 1);
+    sdp = lws_sess_get_local_sdp(sess);
+    ASSERT_NOT_NULL(sdp);
+    ASSERT_NOT_NULL(strstr(sdp, "a=sendrecv"));
+    sscanf(strstr(sdp, "o="), "o=%*s %*s %llu", &version);
+
+    /* 相同版本：无变化 */
+    ASSERT_EQ(lws_sess_update_remote_sdp(sess,
+        "v=0\r\no=peer 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 0 8\r\na=recvonly\r\n"), 0);
+
+    /* 对端保持：方向变化，应答为recvonly且版本递增 */
+    ASSERT_EQ(lws_sess_update_remote_sdp(sess,
+        "v=0\r\no=peer 1 2 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 0 8\r\na=sendonly\r\n"), LWS_SESS_CHANGE_DIR);
+    sdp = lws_sess_get_local_sdp(sess);
+    ASSERT_NOT_NULL(strstr(sdp, "a=recvonly"));
+    sscanf(strstr(sdp, "o="), "o=%*s %*s %llu", &new_version);
+    ASSERT_EQ(new_version, version + 1);
+    ASSERT_EQ(g_on_sdp_ready_called, 1);
+
+    /* 恢复并更换地址、编码和SSRC */
+    ASSERT_EQ(lws_sess_update_remote_sdp(sess,
+        "v=0\r\no=peer 1 3 IN IP4 10.0.0.3\r\ns=-\r\nc=IN IP4 10.0.0.3\r\nt=0 0\r\n"
+        "m=audio 4002 RTP/AVP 8\r\na=ssrc:1234 cname:x\r\n"),
+        LWS_SESS_CHANGE_DIR | LWS_SESS_CHANGE_ADDR | LWS_SESS_CHANGE_CODEC | LWS_SESS_CHANGE_SSRC);
+    sdp = lws_sess_get_local_sdp(sess);
+    ASSERT_NOT_NULL(strstr(sdp, "a=sendrecv"));
+    ASSERT_NOT_NULL(strstr(sdp, "RTP/AVP 8\r\n"));
+
+    /* c=0.0.0.0 (RFC 2543保持) */
+    ASSERT_EQ(lws_sess_update_remote_sdp(sess,
+        "v=0\r\no=peer 1 4 IN IP4 10.0.0.3\r\ns=-\r\nc=IN IP4 0.0.0.0\r\nt=0 0\r\n"
+        "m=audio 4002 RTP/AVP 8\r\na=ssrc:1234\r\n"),
+        LWS_SESS_CHANGE_DIR | LWS_SESS_CHANGE_ADDR);
+    ASSERT_NOT_NULL(strstr(lws_sess_get_local_sdp(sess), "a=recvonly"));
+
+    /* 无共同编码：拒绝，保持原协商结果 */
+    ASSERT_EQ(lws_sess_update_remote_sdp(sess,
+        "v=0\r\no=peer 1 5 IN IP4 10.0.0.3\r\ns=-\r\nc=IN IP4 10.0.0.3\r\nt=0 0\r\n"
+        "m=audio 4002 RTP/AVP 18\r\n"), -1);
+    ASSERT_NOT_NULL(strstr(lws_sess_get_local_sdp(sess), "RTP/AVP 8\r\n"));
+
+    /* 本端保持：offer为sendonly */
+    ASSERT_EQ(lws_sess_set_media_dir(sess, LWS_MEDIA_DIR_SENDONLY), 0);
+    ASSERT_NOT_NULL(strstr(lws_sess_get_local_sdp(sess), "a=sendonly"));
+
+    /* offer发出后，版本未变的answer同样结束offer */
+    ASSERT_EQ(lws_sess_set_offer_pending(sess, 1), 0);
+    ASSERT_EQ(lws_sess_update_remote_sdp(sess,
+        "v=0\r\no=peer 1 4 IN IP4 10.0.0.3\r\ns=-\r\nc=IN IP4 0.0.0.0\r\nt=0 0\r\n"
+        "m=audio 4002 RTP/AVP 8\r\na=ssrc:1234\r\n"), 0);
+
+    /* 之后对端的新offer按offer协商：改用PCMU（按answer处理则无共同编码） */
+    ASSERT_TRUE(lws_sess_update_remote_sdp(sess,
+        "v=0\r\no=peer 1 6 IN IP4 10.0.0.3\r\ns=-\r\nc=IN IP4 10.0.0.3\r\nt=0 0\r\n"
+        "m=audio 4002 RTP/AVP 0\r\na=ssrc:1234\r\n") & LWS_SESS_CHANGE_CODEC);
+    ASSERT_NOT_NULL(strstr(lws_sess_get_local_sdp(sess), "RTP/AVP 0\r\n"));
+
+    /* 修改方向本身不使对端的下一个SDP变成answer */
+    ASSERT_EQ(lws_sess_set_media_dir(sess, LWS_MEDIA_DIR_SENDRECV), 0);
+    ASSERT_TRUE(lws_sess_update_remote_sdp(sess,
+        "v=0\r\no=peer 1 7 IN IP4 10.0.0.3\r\ns=-\r\nc=IN IP4 10.0.0.3\r\nt=0 0\r\n"
+        "m=audio 4002 RTP/AVP 8\r\na=ssrc:1234\r\n") & LWS_SESS_CHANGE_CODEC);
+
+    lws_sess_destroy(sess);
+}
+
+TEST(sess_codec_negotiation) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_codec_t codecs[LWS_MAX_CODECS];
+    const char* sdp;
+
+    reset_mocks();
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    config.audio_codecs[0] = LWS_RTP_PAYLOAD_OPUS;
+    config.audio_codecs[1] = LWS_RTP_PAYLOAD_PCMA;
+    config.audio_codec_count = 2;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_sdp_ready = mock_on_sdp_ready;
+
+    lws_sess_t* sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+
+    /* 本端offer：按优先级列出，每个时钟频率一个telephone-event */
+    ASSERT_EQ(lws_sess_gather_candidates(sess), 0);
+    sdp = lws_sess_get_local_sdp(sess);
+    ASSERT_NOT_NULL(sdp);
+    ASSERT_NOT_NULL(strstr(sdp, "RTP/AVP 96 8 101 97\r\n"));
+    ASSERT_NOT_NULL(strstr(sdp, "a=rtpmap:96 opus/48000/2\r\n"));
+    ASSERT_EQ(lws_sess_get_codecs(sess, codecs, LWS_MAX_CODECS), 4);
+
+    /* 对端以不同的动态PT应答 */
+    ASSERT_EQ(lws_sess_set_remote_sdp(sess,
+        "v=0\r\no=peer 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 111 110\r\na=rtpmap:111 opus/48000/2\r\n"
+        "a=rtpmap:110 telephone-event/48000\r\n"), 0);
+    ASSERT_EQ(lws_sess_get_codecs(sess, codecs, LWS_MAX_CODECS), 2);
+    ASSERT_EQ(codecs[0].codec, LWS_RTP_PAYLOAD_OPUS);
+    ASSERT_EQ(codecs[0].send_pt, 111);
+    ASSERT_EQ(codecs[0].recv_pt, 96);
+    ASSERT_EQ(codecs[1].send_pt, 110);
+    ASSERT_EQ(codecs[1].recv_pt, 101);
+
+    /* 对端re-INVITE改为只提供PCMA：作为应答方选择PCMA */
+    ASSERT_EQ(lws_sess_update_remote_sdp(sess,
+        "v=0\r\no=peer 1 2 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 8 0 101\r\na=rtpmap:101 telephone-event/8000\r\n"),
+        LWS_SESS_CHANGE_CODEC);
+    ASSERT_NOT_NULL(strstr(lws_sess_get_local_sdp(sess), "RTP/AVP 8 101\r\n"));
+    ASSERT_EQ(lws_sess_get_codecs(sess, codecs, 1), 1);
+    ASSERT_EQ(codecs[0].codec, LWS_RTP_PAYLOAD_PCMA);
+
+    lws_sess_destroy(sess);
+}
+
+/* 收到的DTMF */
+static char g_dtmf_digits[8];
+static int g_dtmf_durations[8];
+static int g_dtmf_count = 0;
+
+static void mock_on_dtmf(lws_sess_t* sess, char digit, int duration_ms, void* userdata) {
+    (void)sess;
+    (void)userdata;
+    if (g_dtmf_count < (int)sizeof(g_dtmf_digits)) {
+        g_dtmf_digits[g_dtmf_count] = digit;
+        g_dtmf_durations[g_dtmf_count] = duration_ms;
+        g_dtmf_count++;
+    }
+}
+
+/* 把SDP的c=地址改为127.0.0.1，两个会话在本机环回收发 */
+static void loopback_sdp(const char* sdp, char* out, size_t size) {
+    const char* c = strstr(sdp, "c=IN IP4 ");
+    const char* end = c ? strstr(c, "\r\n") : NULL;
+    if (!c || !end) {
+        snprintf(out, size, "%s", sdp);
+        return;
+    }
+    snprintf(out, size, "%.*sc=IN IP4 127.0.0.1%s", (int)(c - sdp), sdp, end);
+}
+
+TEST(sess_dtmf_loopback) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    char sdp[2048];
+    int i;
+
+    reset_mocks();
+    g_dtmf_count = 0;
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    memset(&handler, 0, sizeof(handler));
+    handler.on_dtmf = mock_on_dtmf;
+
+    lws_sess_t* a = lws_sess_create(&config, &handler);
+    lws_sess_t* b = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+
+    /* A offer -> B answer -> A，RTP直连 */
+    ASSERT_EQ(lws_sess_gather_candidates(a), 0);
+    loopback_sdp(lws_sess_get_local_sdp(a), sdp, sizeof(sdp));
+    ASSERT_EQ(lws_sess_set_remote_sdp(b, sdp), 0);
+    ASSERT_EQ(lws_sess_gather_candidates(b), 0);
+    loopback_sdp(lws_sess_get_local_sdp(b), sdp, sizeof(sdp));
+    ASSERT_NOT_NULL(strstr(sdp, "a=rtpmap:101 telephone-event/8000\r\n"));
+    ASSERT_EQ(lws_sess_set_remote_sdp(a, sdp), 0);
+    ASSERT_EQ(lws_sess_start_ice(a), 0);
+    ASSERT_EQ(lws_sess_start_ice(b), 0);
+
+    /* 非法按键 */
+    ASSERT_EQ(lws_sess_send_dtmf(a, "5x", 80), -1);
+    ASSERT_EQ(lws_sess_send_dtmf(a, "", 80), -1);
+
+    ASSERT_EQ(lws_sess_send_dtmf(a, "5#", 80), 0);
+    for (i = 0; i < 400 && g_dtmf_count < 2; i++) {
+        lws_sess_loop(a, 0);
+        lws_sess_loop(b, 0);
+        usleep(5000);
+    }
+
+    /* 每个事件只上报一次（结束包发送3次） */
+    ASSERT_EQ(g_dtmf_count, 2);
+    ASSERT_EQ(g_dtmf_digits[0], '5');
+    ASSERT_EQ(g_dtmf_digits[1], '#');
+    ASSERT_EQ(g_dtmf_durations[0], 80);
+    ASSERT_EQ(g_dtmf_durations[1], 80);
+
+    lws_sess_destroy(a);
+    lws_sess_destroy(b);
+
+    /* 未协商telephone-event */
+    config.telephone_event = 0;
+    a = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_EQ(lws_sess_send_dtmf(a, "1", 100), -1);
+    lws_sess_destroy(a);
+}
+
+TEST(sess_srtp_loopback) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    char sdp[2048];
+    const char* p;
+    int lines;
+    int i;
+
+    reset_mocks();
+    g_dtmf_count = 0;
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    config.srtp_mode = LWS_SRTP_MODE_REQUIRED;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_dtmf = mock_on_dtmf;
+
+    lws_sess_t* a = lws_sess_create(&config, &handler);
+    lws_sess_t* b = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+
+    /* offer: RTP/SAVP，列出全部套件 */
+    ASSERT_EQ(lws_sess_gather_candidates(a), 0);
+    loopback_sdp(lws_sess_get_local_sdp(a), sdp, sizeof(sdp));
+    ASSERT_NOT_NULL(strstr(sdp, "RTP/SAVP 0 8 9 101\r\n"));
+    ASSERT_NOT_NULL(strstr(sdp, "a=crypto:1 AES_CM_128_HMAC_SHA1_80 inline:"));
+    ASSERT_NOT_NULL(strstr(sdp, "a=crypto:4 AEAD_AES_256_GCM inline:"));
+    ASSERT_EQ(lws_sess_set_remote_sdp(b, sdp), 0);
+
+    /* answer: 只保留选中的套件 */
+    ASSERT_EQ(lws_sess_gather_candidates(b), 0);
+    loopback_sdp(lws_sess_get_local_sdp(b), sdp, sizeof(sdp));
+    for (lines = 0, p = sdp; (p = strstr(p, "a=crypto:")) != NULL; p++) {
+        lines++;
+    }
+    ASSERT_EQ(lines, 1);
+    ASSERT_NOT_NULL(strstr(sdp, "a=crypto:1 AES_CM_128_HMAC_SHA1_80 inline:"));
+    ASSERT_EQ(lws_sess_set_remote_sdp(a, sdp), 0);
+    ASSERT_EQ(lws_sess_start_ice(a), 0);
+    ASSERT_EQ(lws_sess_start_ice(b), 0);
+
+    /* DTMF经SRTP传输 */
+    ASSERT_EQ(lws_sess_send_dtmf(a, "7", 80), 0);
+    for (i = 0; i < 400 && g_dtmf_count < 1; i++) {
+        lws_sess_loop(a, 0);
+        lws_sess_loop(b, 0);
+        usleep(5000);
+    }
+    ASSERT_EQ(g_dtmf_count, 1);
+    ASSERT_EQ(g_dtmf_digits[0], '7');
+    ASSERT_EQ(lws_sess_get_stats(b, &stats), 0);
+    ASSERT_EQ(stats.srtp_dropped, 0);
+
+    lws_sess_destroy(a);
+    lws_sess_destroy(b);
+
+    /* 要求SRTP时拒绝明文应答 */
+    a = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_EQ(lws_sess_gather_candidates(a), 0);
+    ASSERT_NE(lws_sess_set_remote_sdp(a,
+        "v=0\r\no=peer 1 1 IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n"
+        "m=audio 4000 RTP/AVP 0\r\n"), 0);
+    lws_sess_destroy(a);
+}
+
+/**
+ * @brief Local STUN server stand-in: UDP socket on 127.0.0.1
+ */
+static int stun_standin_open(uint16_t* port)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+/**
+ * @brief Answer pending Binding requests with the source address
+ * @return Requests answered
+ */
+static int stun_standin_serve(int fd)
+{
+    uint8_t req[LWS_STUN_MAX_MESSAGE];
+    uint8_t rsp[LWS_STUN_MAX_MESSAGE];
+    struct sockaddr_in from;
+    socklen_t len = sizeof(from);
+    int answered = 0;
+    ssize_t bytes;
+    int n;
+
+    while ((bytes = recvfrom(fd, req, sizeof(req), 0, (struct sockaddr*)&from, &len)) > 0) {
+        if (!lws_stun_is_message(req, (int)bytes) ||
+            lws_stun_type(req) != LWS_STUN_BINDING_REQUEST) {
+            continue;
+        }
+        n = lws_stun_init(rsp, sizeof(rsp), LWS_STUN_BINDING_SUCCESS, lws_stun_msg_tid(req));
+        n = lws_stun_add_xor_addr(rsp, sizeof(rsp), n, LWS_STUN_ATTR_XOR_MAPPED_ADDRESS, &from);
+        n = lws_stun_add_fingerprint(rsp, sizeof(rsp), n);
+        sendto(fd, rsp, n, 0, (struct sockaddr*)&from, len);
+        answered++;
+        len = sizeof(from);
+    }
+    return answered;
+}
+
+/**
+ * @brief Replace the m=audio port (peer behind a NAT: signalled port unreachable)
+ */
+static void sdp_set_audio_port(char* sdp, size_t size, uint16_t port) {
+    char out[2048];
+    char* m = strstr(sdp, "m=audio ");
+    char* rest = m ? strchr(m + 8, ' ') : NULL;
+    if (!rest) {
+        return;
+    }
+    snprintf(out, sizeof(out), "%.*sm=audio %u%s", (int)(m - sdp), sdp, (unsigned)port, rest);
+    snprintf(sdp, size, "%s", out);
+}
+
+static uint16_t sdp_audio_port(const char* sdp) {
+    const char* m = strstr(sdp, "m=audio ");
+    return m ? (uint16_t)atoi(m + 8) : 0;
+}
+
+TEST(sess_symmetric_rtp) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    struct sockaddr_in to;
+    uint8_t rtp[12 + 160];
+    char sdp[2048];
+    char line[32];
+    uint16_t a_port;
+    uint16_t dead_port;
+    int fd;
+    int i;
+
+    reset_mocks();
+    g_dtmf_count = 0;
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    ASSERT_EQ(config.symmetric_rtp, 1);
+    memset(&handler, 0, sizeof(handler));
+    handler.on_dtmf = mock_on_dtmf;
+
+    lws_sess_t* a = lws_sess_create(&config, &handler);
+    lws_sess_t* b = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+
+    /* RTCP与RTP同端口 (a=rtcp) */
+    ASSERT_EQ(lws_sess_gather_candidates(a), 0);
+    loopback_sdp(lws_sess_get_local_sdp(a), sdp, sizeof(sdp));
+    a_port = sdp_audio_port(sdp);
+    snprintf(line, sizeof(line), "a=rtcp:%u\r\n", (unsigned)a_port);
+    ASSERT_NOT_NULL(strstr(sdp, line));
+    ASSERT_EQ(lws_sess_set_remote_sdp(b, sdp), 0);
+
+    /* B在NAT后：A收到的SDP端口不可达（用一个已关闭的端口） */
+    ASSERT_EQ(lws_sess_gather_candidates(b), 0);
+    loopback_sdp(lws_sess_get_local_sdp(b), sdp, sizeof(sdp));
+    fd = stun_standin_open(&dead_port);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+    sdp_set_audio_port(sdp, sizeof(sdp), dead_port);
+    ASSERT_EQ(lws_sess_set_remote_sdp(a, sdp), 0);
+    ASSERT_EQ(lws_sess_start_ice(a), 0);
+    ASSERT_EQ(lws_sess_start_ice(b), 0);
+
+    /* B -> A：A锁定B的实际源地址 */
+    ASSERT_EQ(lws_sess_send_dtmf(b, "2", 80), 0);
+    for (i = 0; i < 400 && g_dtmf_count < 1; i++) {
+        lws_sess_loop(a, 0);
+        lws_sess_loop(b, 0);
+        usleep(5000);
+    }
+    ASSERT_EQ(g_dtmf_count, 1);
+    ASSERT_EQ(lws_sess_get_stats(a, &stats), 0);
+    ASSERT_EQ(stats.rtp_latches, 1u);
+
+    /* A -> B：经锁定的地址到达 */
+    ASSERT_EQ(lws_sess_send_dtmf(a, "3", 80), 0);
+    for (i = 0; i < 400 && g_dtmf_count < 2; i++) {
+        lws_sess_loop(a, 0);
+        lws_sess_loop(b, 0);
+        usleep(5000);
+    }
+    ASSERT_EQ(g_dtmf_count, 2);
+    ASSERT_EQ(g_dtmf_digits[1], '3');
+
+    /* 其他源地址、其他SSRC的RTP被丢弃，不改变目的地址 */
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_TRUE(fd >= 0);
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    to.sin_port = htons(a_port);
+    memset(rtp, 0xff, sizeof(rtp));
+    rtp[0] = 0x80;
+    rtp[1] = 0;
+    rtp[8] = 0xde; rtp[9] = 0xad; rtp[10] = 0xbe; rtp[11] = 0xef;
+    for (i = 0; i < 5; i++) {
+        rtp[3] = (uint8_t)i;
+        sendto(fd, rtp, sizeof(rtp), 0, (struct sockaddr*)&to, sizeof(to));
+    }
+    for (i = 0; i < 10; i++) {
+        lws_sess_loop(a, 0);
+        usleep(2000);
+    }
+    close(fd);
+    ASSERT_EQ(lws_sess_get_stats(a, &stats), 0);
+    ASSERT_EQ(stats.rtp_source_dropped, 5u);
+    ASSERT_EQ(stats.rtp_latches, 1u);
+
+    lws_sess_destroy(a);
+    lws_sess_destroy(b);
+}
+
+static uint16_t sdp_video_port(const char* sdp) {
+    const char* m = strstr(sdp, "m=video ");
+    return m ? (uint16_t)atoi(m + 8) : 0;
+}
+
+static void sdp_remove_lines(char* sdp, const char* line) {
+    char* p;
+    size_t n = strlen(line);
+    while ((p = strstr(sdp, line)) != NULL) {
+        memmove(p, p + n, strlen(p + n) + 1);
+    }
+}
+
+static void inject_packet(uint16_t port, const uint8_t* data, int bytes) {
+    struct sockaddr_in to;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    to.sin_port = htons(port);
+    sendto(fd, data, bytes, 0, (struct sockaddr*)&to, sizeof(to));
+    close(fd);
+}
+
+/* 视频RTP（MID头扩展 "1"）、SR与RR的测试包 */
+static const uint8_t g_video_mid_rtp[] = {
+    0x90, 97, 0x00, 0x01, 0, 0, 0, 0, 0x11, 0x11, 0x11, 0x11,
+    0xbe, 0xde, 0x00, 0x01, 0x10, '1', 0x00, 0x00,
+    0x65, 0x88, 0x84, 0x00
+};
+static const uint8_t g_video_sr[] = {
+    0x80, 200, 0x00, 0x06, 0x11, 0x11, 0x11, 0x11,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+static const uint8_t g_audio_rr[] = {
+    0x81, 201, 0x00, 0x07, 0x22, 0x22, 0x22, 0x22,
+    0x33, 0x33, 0x33, 0x33, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static void loop_sessions(lws_sess_t* a, lws_sess_t* b, int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        lws_sess_loop(a, 0);
+        lws_sess_loop(b, 0);
+        usleep(2000);
+    }
+}
+
+TEST(sess_bundle) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    char offer[4096];
+    char answer[4096];
+    uint16_t b_port;
+
+    reset_mocks();
+
+    lws_sess_init_av_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU, LWS_RTP_PAYLOAD_H264);
+    ASSERT_EQ(config.bundle, 1);
+    config.symmetric_rtp = 0;       /* 测试包从其他socket注入 */
+    memset(&handler, 0, sizeof(handler));
+
+    lws_sess_t* a = lws_sess_create(&config, &handler);
+    lws_sess_t* b = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+
+    /* offer：BUNDLE组、rtcp-mux、MID头扩展，视频仍有独立端口（对端可能不支持） */
+    ASSERT_EQ(lws_sess_gather_candidates(a), 0);
+    loopback_sdp(lws_sess_get_local_sdp(a), offer, sizeof(offer));
+    ASSERT_NOT_NULL(strstr(offer, "a=group:BUNDLE 0 1\r\n"));
+    ASSERT_NOT_NULL(strstr(offer, "a=mid:1\r\n"));
+    ASSERT_NOT_NULL(strstr(offer, "a=extmap:1 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"));
+    ASSERT_NOT_NULL(strstr(offer, "a=rtcp-mux\r\n"));
+    ASSERT_TRUE(sdp_video_port(offer) != 0);
+    ASSERT_TRUE(sdp_video_port(offer) != sdp_audio_port(offer));
+
+    /* answer：接受BUNDLE，视频与音频同端口 */
+    ASSERT_EQ(lws_sess_set_remote_sdp(b, offer), 0);
+    ASSERT_EQ(lws_sess_gather_candidates(b), 0);
+    loopback_sdp(lws_sess_get_local_sdp(b), answer, sizeof(answer));
+    ASSERT_NOT_NULL(strstr(answer, "a=group:BUNDLE 0 1\r\n"));
+    ASSERT_NOT_NULL(strstr(answer, "a=rtcp-mux\r\n"));
+    b_port = sdp_audio_port(answer);
+    ASSERT_EQ(sdp_video_port(answer), b_port);
+    ASSERT_EQ(lws_sess_set_remote_sdp(a, answer), 0);
+
+    /* 同一端口上：按MID识别视频并记下SSRC，之后该SSRC的RTCP归视频 */
+    inject_packet(b_port, g_video_mid_rtp, sizeof(g_video_mid_rtp));
+    inject_packet(b_port, g_video_sr, sizeof(g_video_sr));
+    inject_packet(b_port, g_audio_rr, sizeof(g_audio_rr));
+    loop_sessions(a, b, 10);
+
+    ASSERT_EQ(lws_sess_get_stats(b, &stats), 0);
+    ASSERT_EQ(stats.video_stats.rtcp_recv, 1u);
+    ASSERT_EQ(stats.audio_stats.rtcp_recv, 1u);
+
+    lws_sess_destroy(a);
+    lws_sess_destroy(b);
+}
+
+TEST(sess_bundle_fallback) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    char offer[4096];
+    char answer[4096];
+
+    reset_mocks();
+
+    lws_sess_init_av_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU, LWS_RTP_PAYLOAD_H264);
+    config.symmetric_rtp = 0;
+    memset(&handler, 0, sizeof(handler));
+
+    lws_sess_t* a = lws_sess_create(&config, &handler);
+    config.bundle = 0;
+    lws_sess_t* b = lws_sess_create(&config, &handler);
+    config.bundle = 1;
+    lws_sess_t* c = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+    ASSERT_NOT_NULL(c);
+
+    ASSERT_EQ(lws_sess_gather_candidates(a), 0);
+    loopback_sdp(lws_sess_get_local_sdp(a), offer, sizeof(offer));
+
+    /* 对端不支持BUNDLE：answer不带组，视频用独立端口 */
+    ASSERT_EQ(lws_sess_set_remote_sdp(b, offer), 0);
+    ASSERT_EQ(lws_sess_gather_candidates(b), 0);
+    loopback_sdp(lws_sess_get_local_sdp(b), answer, sizeof(answer));
+    ASSERT_NULL(strstr(answer, "a=group:BUNDLE"));
+    ASSERT_NULL(strstr(answer, "a=mid:"));
+    ASSERT_TRUE(sdp_video_port(answer) != 0);
+    ASSERT_TRUE(sdp_video_port(answer) != sdp_audio_port(answer));
+    ASSERT_EQ(lws_sess_set_remote_sdp(a, answer), 0);
+
+    /* offerer保留视频端口：其上的RTCP照常归视频 */
+    inject_packet(sdp_video_port(offer), g_video_sr, sizeof(g_video_sr));
+    loop_sessions(a, b, 10);
+    ASSERT_EQ(lws_sess_get_stats(a, &stats), 0);
+    ASSERT_EQ(stats.video_stats.rtcp_recv, 1u);
+
+    /* offer没有rtcp-mux：answer的音频也不带，且不BUNDLE (RFC 5761 §5.1.1) */
+    sdp_remove_lines(offer, "a=rtcp-mux\r\n");
+    ASSERT_EQ(lws_sess_set_remote_sdp(c, offer), 0);
+    ASSERT_EQ(lws_sess_gather_candidates(c), 0);
+    loopback_sdp(lws_sess_get_local_sdp(c), answer, sizeof(answer));
+    ASSERT_NULL(strstr(answer, "a=group:BUNDLE"));
+    ASSERT_TRUE(sdp_video_port(answer) != sdp_audio_port(answer));
+    *strstr(answer, "m=video ") = '\0';
+    ASSERT_NULL(strstr(answer, "a=rtcp-mux"));
+
+    lws_sess_destroy(a);
+    lws_sess_destroy(b);
+    lws_sess_destroy(c);
+}
+
+/* 按序号生成PCMU帧（载荷0xff，20ms） */
+static int make_pcmu_frame(uint8_t* buf, uint16_t seq) {
+    uint32_t ts = (uint32_t)seq * 160;
+    memset(buf, 0xff, 12 + 160);
+    buf[0] = 0x80;
+    buf[1] = 0;
+    buf[2] = (uint8_t)(seq >> 8);
+    buf[3] = (uint8_t)seq;
+    buf[4] = (uint8_t)(ts >> 24);
+    buf[5] = (uint8_t)(ts >> 16);
+    buf[6] = (uint8_t)(ts >> 8);
+    buf[7] = (uint8_t)ts;
+    buf[8] = 0x44; buf[9] = 0x44; buf[10] = 0x44; buf[11] = 0x44;
+    return 12 + 160;
+}
+
+TEST(sess_red) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    lws_red_sender_t red;
+    uint8_t frame[12 + 160];
+    uint8_t wire[LWS_RED_MAX_PACKET];
+    char offer[4096];
+    char answer[4096];
+    int n;
+    int i;
+
+    reset_mocks();
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    ASSERT_EQ(config.audio_red, 0);
+    config.audio_red = 2;
+    config.symmetric_rtp = 0;       /* 测试包从其他socket注入 */
+    memset(&handler, 0, sizeof(handler));
+
+    lws_sess_t* a = lws_sess_create(&config, &handler);
+    lws_sess_t* b = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+
+    /* offer：每个音频编码一个RED；answer只保留所选编码的 */
+    ASSERT_EQ(lws_sess_gather_candidates(a), 0);
+    loopback_sdp(lws_sess_get_local_sdp(a), offer, sizeof(offer));
+    ASSERT_NOT_NULL(strstr(offer, "a=rtpmap:103 red/8000\r\na=fmtp:103 0/0\r\n"));
+    ASSERT_EQ(lws_sess_set_remote_sdp(b, offer), 0);
+    ASSERT_EQ(lws_sess_gather_candidates(b), 0);
+    loopback_sdp(lws_sess_get_local_sdp(b), answer, sizeof(answer));
+    ASSERT_NOT_NULL(strstr(answer, "a=rtpmap:103 red/8000\r\na=fmtp:103 0/0\r\n"));
+    ASSERT_NULL(strstr(answer, "a=fmtp:96 8/8"));
+    ASSERT_EQ(lws_sess_set_remote_sdp(a, answer), 0);
+
+    ASSERT_EQ(lws_sess_get_stats(a, &stats), 0);
+    ASSERT_EQ(stats.audio_red_level, 1);
+
+    /* 对端发送1-6，丢失3、4：由5的冗余块恢复 */
+    lws_red_sender_init(&red, 103, 2);
+    lws_red_adapt(&red, 20);
+    for (i = 1; i <= 6; i++) {
+        n = make_pcmu_frame(frame, (uint16_t)i);
+        n = lws_red_encode(&red, frame, n, wire, sizeof(wire));
+        if (i == 3 || i == 4) {
+            continue;
+        }
+        if (n > 0) {
+            inject_packet(sdp_audio_port(offer), wire, n);
+        } else {
+            inject_packet(sdp_audio_port(offer), frame, sizeof(frame));
+        }
+    }
+    loop_sessions(a, b, 10);
+
+    ASSERT_EQ(lws_sess_get_stats(a, &stats), 0);
+    ASSERT_EQ(stats.audio_stats.lost_packets, 2u);
+    ASSERT_EQ(stats.audio_red_recovered, 2u);
+    ASSERT_TRUE(stats.audio_stats.loss_rate > 0.3);
+    ASSERT_TRUE(stats.audio_effective_loss < 0.001);
+
+    lws_sess_destroy(a);
+    lws_sess_destroy(b);
+}
+
+TEST(sess_ptime) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    char offer[4096];
+    char answer[4096];
+
+    reset_mocks();
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    ASSERT_EQ(config.audio_ptime, 0);
+    memset(&handler, 0, sizeof(handler));
+
+    lws_sess_t* a = lws_sess_create(&config, &handler);
+    config.audio_ptime = 40;
+    lws_sess_t* b = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+
+    /* 未协商前每包一帧；offer只声明接收上限 */
+    ASSERT_EQ(lws_sess_get_stats(a, &stats), 0);
+    ASSERT_EQ(stats.audio_ptime, 20);
+    ASSERT_EQ(lws_sess_gather_candidates(a), 0);
+    loopback_sdp(lws_sess_get_local_sdp(a), offer, sizeof(offer));
+    ASSERT_NULL(strstr(offer, "a=ptime:"));
+    ASSERT_NOT_NULL(strstr(offer, "a=maxptime:60\r\n"));
+
+    /* b按配置的40ms发送，并以a=ptime声明 */
+    ASSERT_EQ(lws_sess_set_remote_sdp(b, offer), 0);
+    ASSERT_EQ(lws_sess_get_stats(b, &stats), 0);
+    ASSERT_EQ(stats.audio_ptime, 40);
+    ASSERT_EQ(lws_sess_gather_candidates(b), 0);
+    loopback_sdp(lws_sess_get_local_sdp(b), answer, sizeof(answer));
+    ASSERT_NOT_NULL(strstr(answer, "a=ptime:40\r\na=maxptime:60\r\n"));
+
+    /* a按对端的a=ptime发送 */
+    ASSERT_EQ(lws_sess_set_remote_sdp(a, answer), 0);
+    ASSERT_EQ(lws_sess_get_stats(a, &stats), 0);
+    ASSERT_EQ(stats.audio_ptime, 40);
+
+    lws_sess_destroy(a);
+    lws_sess_destroy(b);
+}
+
+static int tap_process(void* ctx, lws_graph_node_t* node, lws_frame_t* frame) {
+    (void)ctx;
+    (void)node;
+    (void)frame;
+    return 0;
+}
+
+TEST(sess_graph) {
+    static const lws_node_ops_t tap_ops = { "tap", LWS_NODE_SINK, tap_process, NULL };
+    static const lws_node_ops_t eq_ops = { "eq", LWS_NODE_FILTER, tap_process, NULL };
+    lws_node_def_t rx_nodes[] = { { &tap_ops, NULL }, { &eq_ops, NULL } };
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_node_stats_t stats;
+    lws_graph_t* graph;
+    int dev;
+
+    reset_mocks();
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    config.audio_capture_dev = (lws_dev_t*)&dev;
+    config.audio_playback_dev = (lws_dev_t*)&dev;
+    config.audio_rx_nodes = rx_nodes;
+    config.audio_rx_node_count = 2;
+    memset(&handler, 0, sizeof(handler));
+
+    lws_sess_t* sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+
+    /* 标准链路与配置中的节点 */
+    graph = lws_sess_get_graph(sess);
+    ASSERT_NOT_NULL(graph);
+    ASSERT_NOT_NULL(lws_graph_find(graph, "capture"));
+    ASSERT_NOT_NULL(lws_graph_find(graph, "audio-proc"));
+    ASSERT_NOT_NULL(lws_graph_find(graph, "encoder"));
+    ASSERT_NOT_NULL(lws_graph_find(graph, "rtp"));
+    ASSERT_NOT_NULL(lws_graph_find(graph, "eq"));
+    ASSERT_NOT_NULL(lws_graph_find(graph, "tap"));
+    ASSERT_NOT_NULL(lws_graph_find(graph, "playback"));
+    ASSERT_NULL(lws_graph_find(graph, "record"));   /* 未配置录音设备 */
+
+    /* eq在rtp之后，tap与playback并联在eq上 */
+    ASSERT_EQ(lws_graph_link(lws_graph_find(graph, "eq"), lws_graph_find(graph, "tap")), -1);
+    ASSERT_EQ(lws_graph_unlink(lws_graph_find(graph, "eq"), lws_graph_find(graph, "tap")), 0);
+    ASSERT_EQ(lws_graph_unlink(lws_graph_find(graph, "eq"), lws_graph_find(graph, "playback")), 0);
+    ASSERT_EQ(lws_graph_node_stats(lws_graph_find(graph, "encoder"), &stats), 0);
+    ASSERT_EQ(stats.frames, 0u);
+
+    lws_sess_destroy(sess);
+
+    /* 未启用音频时没有处理图 */
+    config.enable_audio = 0;
+    config.enable_video = 1;
+    sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+    ASSERT_NULL(lws_sess_get_graph(sess));
+    lws_sess_destroy(sess);
+    ASSERT_NULL(lws_sess_get_graph(NULL));
+}
+
+TEST(sess_record_async) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    lws_graph_node_t* rtp;
+    lws_frame_t* frame;
+    int dev;
+    int i;
+
+    reset_mocks();
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    config.audio_record_dev = (lws_dev_t*)&dev;
+    memset(&handler, 0, sizeof(handler));
+
+    lws_sess_t* sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+    rtp = lws_graph_find(lws_sess_get_graph(sess), "rtp");
+    ASSERT_NOT_NULL(rtp);
+    ASSERT_NOT_NULL(lws_graph_find(lws_sess_get_graph(sess), "record"));
+
+    /* 接收链路的帧进入录音队列，挂断时全部写出 */
+    frame = lws_frame_alloc(160 * (int)sizeof(int16_t));
+    ASSERT_NOT_NULL(frame);
+    frame->kind = LWS_FRAME_AUDIO;
+    frame->size = 160 * (int)sizeof(int16_t);
+    frame->samples = 160;
+    frame->sample_rate = 8000;
+    frame->channels = 1;
+    for (i = 0; i < 5; i++) {
+        ASSERT_EQ(lws_graph_emit(rtp, frame), 1);
+    }
+    lws_sess_stop(sess);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 5u);
+    ASSERT_EQ(stats.record_dropped, 0u);
+
+    /* 挂断后不再录音 */
+    ASSERT_EQ(lws_graph_emit(rtp, frame), 1);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 5u);
+    ASSERT_EQ(frame->refcount, 1);
+    lws_sess_destroy(sess);
+
+    /* -1：在媒体线程同步写入，不经过队列 */
+    config.record_queue_ms = -1;
+    sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+    rtp = lws_graph_find(lws_sess_get_graph(sess), "rtp");
+    ASSERT_EQ(lws_graph_emit(rtp, frame), 1);
+    ASSERT_EQ(frame->refcount, 1);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 0u);
+    lws_sess_destroy(sess);
+    lws_frame_unref(frame);
+}
+
+TEST(sess_record_stereo) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    lws_graph_t* graph;
+    lws_frame_t* frame;
+    int dev;
+    int i;
+
+    reset_mocks();
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    config.audio_capture_dev = (lws_dev_t*)&dev;
+    config.audio_record_dev = (lws_dev_t*)&dev;
+    config.record_stereo = 1;
+    config.record_queue_ms = -1;    /* 双方录音总是后台写入 */
+    memset(&handler, 0, sizeof(handler));
+
+    lws_sess_t* sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+    graph = lws_sess_get_graph(sess);
+    ASSERT_NOT_NULL(lws_graph_find(graph, "record"));
+    ASSERT_NOT_NULL(lws_graph_find(graph, "record-local"));
+
+    /* 本端（采集链路）与对端（接收链路）各3帧 */
+    frame = lws_frame_alloc(160 * (int)sizeof(int16_t));
+    ASSERT_NOT_NULL(frame);
+    frame->kind = LWS_FRAME_AUDIO;
+    frame->size = 160 * (int)sizeof(int16_t);
+    frame->samples = 160;
+    frame->sample_rate = 8000;
+    frame->channels = 1;
+    for (i = 0; i < 3; i++) {
+        frame->timestamp = (uint32_t)(i * 160);
+        frame->time_us = 1000000 + (uint64_t)i * 20000;
+        ASSERT_TRUE(lws_graph_emit(lws_graph_find(graph, "capture"), frame) > 0);
+        ASSERT_EQ(lws_graph_emit(lws_graph_find(graph, "rtp"), frame), 1);
+    }
+    lws_sess_stop(sess);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 6u);
+    ASSERT_EQ(stats.record_dropped, 0u);
+    lws_sess_destroy(sess);
+
+    /* 没有录音设备时不录本端 */
+    config.audio_record_dev = NULL;
+    sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+    ASSERT_NULL(lws_graph_find(lws_sess_get_graph(sess), "record-local"));
+    lws_sess_destroy(sess);
+    lws_frame_unref(frame);
+}
+
+extern int g_stub_audio_packet_format;
+extern int g_stub_audio_packets_written;
+extern int g_stub_audio_segments;
+extern int g_stub_audio_segment_fail;
+int stub_rtp_deliver(const void* payload, int bytes, uint32_t timestamp);
+
+#define RECORD_OFFER(version, pt) \
+    "v=0\r\no=peer 1 " version " IN IP4 10.0.0.2\r\ns=-\r\nc=IN IP4 10.0.0.2\r\nt=0 0\r\n" \
+    "m=audio 4000 RTP/AVP " pt "\r\na=sendrecv\r\n"
+
+/**
+ * @brief Create a session recording to a device that takes @p format packets
+ */
+static lws_sess_t* record_sess_create(lws_sess_config_t* config, int format)
+{
+    static int dev;
+    lws_sess_handler_t handler;
+
+    lws_sess_init_audio_config(config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    config->audio_record_dev = (lws_dev_t*)&dev;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_sdp_ready = mock_on_sdp_ready;
+
+    g_stub_audio_packet_format = format;
+    g_stub_audio_packets_written = 0;
+    g_stub_audio_segments = 0;
+    g_stub_audio_segment_fail = 0;
+    return lws_sess_create(config, &handler);
+}
+
+TEST(sess_record_passthrough) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    lws_graph_node_t* rtp;
+    lws_frame_t* frame;
+    uint8_t payload[160];
+    lws_sess_t* sess;
+
+    reset_mocks();
+    memset(payload, 0xff, sizeof(payload));
+
+    frame = lws_frame_alloc(160 * (int)sizeof(int16_t));
+    ASSERT_NOT_NULL(frame);
+    frame->kind = LWS_FRAME_AUDIO;
+    frame->size = 160 * (int)sizeof(int16_t);
+    frame->samples = 160;
+    frame->sample_rate = 8000;
+    frame->channels = 1;
+
+    /* 设备接受PCMU包、协商出PCMU：录收到的负载，解码输出不进录音队列 */
+    sess = record_sess_create(&config, LWS_AUDIO_FMT_PCMU);
+    ASSERT_NOT_NULL(sess);
+    rtp = lws_graph_find(lws_sess_get_graph(sess), "rtp");
+    ASSERT_NOT_NULL(rtp);
+    ASSERT_EQ(lws_graph_emit(rtp, frame), 1);       /* 协商前不录 */
+    ASSERT_EQ(frame->refcount, 1);
+    ASSERT_EQ(lws_sess_set_remote_sdp(sess, RECORD_OFFER("1", "0")), 0);
+    ASSERT_EQ(stub_rtp_deliver(payload, sizeof(payload), 0), 0);
+    ASSERT_EQ(lws_graph_emit(rtp, frame), 1);
+    lws_sess_stop(sess);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 1u);
+    ASSERT_EQ(g_stub_audio_packets_written, 1);
+    lws_sess_destroy(sess);
+
+    /* 优先PCMU但对端只提供PCMA：设备不接受PCMA包，改录解码音频而不是空文件 */
+    sess = record_sess_create(&config, LWS_AUDIO_FMT_PCMU);
+    ASSERT_NOT_NULL(sess);
+    ASSERT_EQ(lws_sess_set_remote_sdp(sess, RECORD_OFFER("1", "8")), 0);
+    ASSERT_EQ(stub_rtp_deliver(payload, sizeof(payload), 0), 0);
+    lws_sess_stop(sess);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 1u);
+    ASSERT_EQ(g_stub_audio_packets_written, 0);
+    lws_sess_destroy(sess);
+
+    /* 协商出的编码与config.audio_codec不同但设备接受：直通录音 */
+    sess = record_sess_create(&config, LWS_AUDIO_FMT_PCMA);
+    ASSERT_NOT_NULL(sess);
+    ASSERT_EQ(lws_sess_set_remote_sdp(sess, RECORD_OFFER("1", "8")), 0);
+    ASSERT_EQ(stub_rtp_deliver(payload, sizeof(payload), 0), 0);
+    ASSERT_EQ(stub_rtp_deliver(payload, sizeof(payload), 160), 0);
+    lws_sess_stop(sess);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 2u);
+    ASSERT_EQ(g_stub_audio_packets_written, 2);
+    lws_sess_destroy(sess);
+
+    /* 通话中切换到另一个能直通的编码：新分段按新编码建轨道，继续直通 */
+    sess = record_sess_create(&config, LWS_AUDIO_FMT_PCMU);
+    ASSERT_NOT_NULL(sess);
+    ASSERT_EQ(lws_sess_set_remote_sdp(sess, RECORD_OFFER("1", "0 8")), 0);
+    ASSERT_EQ(lws_sess_gather_candidates(sess), 0);
+    ASSERT_EQ(stub_rtp_deliver(payload, sizeof(payload), 0), 0);
+    ASSERT_EQ(lws_sess_update_remote_sdp(sess, RECORD_OFFER("2", "8")) & LWS_SESS_CHANGE_CODEC,
+              LWS_SESS_CHANGE_CODEC);
+    ASSERT_EQ(g_stub_audio_segments, 1);
+    ASSERT_EQ(g_stub_audio_packet_format, LWS_AUDIO_FMT_PCMA);
+    ASSERT_EQ(stub_rtp_deliver(payload, sizeof(payload), 160), 0);
+    lws_sess_stop(sess);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 2u);
+    ASSERT_EQ(g_stub_audio_packets_written, 2);
+    lws_sess_destroy(sess);
+
+    /* 切换到不能直通的编码：新分段为PCM轨道，之后录解码音频 */
+    sess = record_sess_create(&config, LWS_AUDIO_FMT_PCMU);
+    ASSERT_NOT_NULL(sess);
+    ASSERT_EQ(lws_sess_set_remote_sdp(sess, RECORD_OFFER("1", "0 9")), 0);
+    ASSERT_EQ(lws_sess_gather_candidates(sess), 0);
+    ASSERT_EQ(stub_rtp_deliver(payload, sizeof(payload), 0), 0);
+    ASSERT_EQ(lws_sess_update_remote_sdp(sess, RECORD_OFFER("2", "9")) & LWS_SESS_CHANGE_CODEC,
+              LWS_SESS_CHANGE_CODEC);
+    ASSERT_EQ(g_stub_audio_segments, 1);
+    ASSERT_EQ(g_stub_audio_packet_format, LWS_AUDIO_FMT_PCM_S16LE);
+    ASSERT_EQ(stub_rtp_deliver(payload, sizeof(payload), 160), 0);
+    lws_sess_stop(sess);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 2u);
+    ASSERT_EQ(g_stub_audio_packets_written, 1);
+    lws_sess_destroy(sess);
+
+    /* 设备不能分段：停止录音，不把新编码写进原轨道 */
+    sess = record_sess_create(&config, LWS_AUDIO_FMT_PCMU);
+    ASSERT_NOT_NULL(sess);
+    g_stub_audio_segment_fail = 1;
+    ASSERT_EQ(lws_sess_set_remote_sdp(sess, RECORD_OFFER("1", "0 9")), 0);
+    ASSERT_EQ(lws_sess_gather_candidates(sess), 0);
+    ASSERT_EQ(stub_rtp_deliver(payload, sizeof(payload), 0), 0);
+    ASSERT_EQ(lws_sess_update_remote_sdp(sess, RECORD_OFFER("2", "9")) & LWS_SESS_CHANGE_CODEC,
+              LWS_SESS_CHANGE_CODEC);
+    ASSERT_EQ(stub_rtp_deliver(payload, sizeof(payload), 160), 0);
+    lws_sess_stop(sess);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 1u);
+    ASSERT_EQ(g_stub_audio_packets_written, 1);
+    lws_sess_destroy(sess);
+    g_stub_audio_segment_fail = 0;
+
+    /* 要求转码：从一开始录解码输出 */
+    memset(&handler, 0, sizeof(handler));
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    config.audio_record_dev = (lws_dev_t*)&handler;
+    config.record_transcode = 1;
+    g_stub_audio_packet_format = LWS_AUDIO_FMT_PCMU;
+    sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+    rtp = lws_graph_find(lws_sess_get_graph(sess), "rtp");
+    ASSERT_EQ(lws_graph_emit(rtp, frame), 1);
+    lws_sess_stop(sess);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 1u);
+    lws_sess_destroy(sess);
+
+    /* 设备不接受编码包时同样录解码输出 */
+    config.record_transcode = 0;
+    g_stub_audio_packet_format = -1;
+    sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+    rtp = lws_graph_find(lws_sess_get_graph(sess), "rtp");
+    ASSERT_EQ(lws_graph_emit(rtp, frame), 1);
+    lws_sess_stop(sess);
+    ASSERT_EQ(lws_sess_get_stats(sess, &stats), 0);
+    ASSERT_EQ(stats.record_frames, 1u);
+    lws_sess_destroy(sess);
+    lws_frame_unref(frame);
+}
+
+TEST(sess_ice_gathering) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    char server[32];
+    const char* sdp;
+    const char* p;
+    uint16_t port;
+    int answered = 0;
+    int lines;
+    int fd;
+    int i;
+
+    reset_mocks();
+
+    fd = stun_standin_open(&port);
+    ASSERT_TRUE(fd >= 0);
+    snprintf(server, sizeof(server), "127.0.0.1:%u", (unsigned)port);
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    config.enable_ice = 1;
+    config.stun_servers[0] = server;
+    config.stun_servers[1] = "127.0.0.1:9";     /* 无响应：不影响已得到的候选 */
+    config.ice_gather_timeout_ms = 1000;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_state_changed = mock_on_state_changed;
+    handler.on_sdp_ready = mock_on_sdp_ready;
+    handler.on_candidate = mock_on_candidate;
+    handler.on_gathering_done = mock_on_gathering_done;
+
+    lws_sess_t* sess = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(sess);
+    ASSERT_NULL(lws_sess_get_ice(sess));
+
+    ASSERT_EQ(lws_sess_gather_candidates(sess), 0);
+    ASSERT_NOT_NULL(lws_sess_get_ice(sess));
+    ASSERT_EQ(lws_sess_get_state(sess), LWS_SESS_STATE_GATHERING);
+    ASSERT_EQ(g_on_sdp_ready_called, 0);
+
+    for (i = 0; i < 400 && g_on_gathering_done_called == 0; i++) {
+        lws_sess_loop(sess, 0);
+        answered += stun_standin_serve(fd);
+        usleep(5000);
+    }
+    close(fd);
+
+    ASSERT_EQ(g_on_gathering_done_called, 1);
+    ASSERT_EQ(g_on_sdp_ready_called, 1);
+    ASSERT_EQ(lws_sess_get_state(sess), LWS_SESS_STATE_GATHERED);
+
+    /* SDP携带ICE凭证和全部已上报的候选 */
+    sdp = lws_sess_get_local_sdp(sess);
+    ASSERT_NOT_NULL(strstr(sdp, "a=ice-ufrag:"));
+    ASSERT_NOT_NULL(strstr(sdp, "a=ice-pwd:"));
+    for (lines = 0, p = sdp; (p = strstr(p, "a=candidate:")) != NULL; p++) {
+        lines++;
+    }
+    ASSERT_EQ(lines, g_on_candidate_called);
+
+    /* 有可用接口时：向stand-in查询并得到server-reflexive候选 */
+    if (g_on_candidate_called > 0) {
+        ASSERT_EQ(answered, 1);
+        ASSERT_NOT_NULL(strstr(sdp, "typ srflx raddr"));
+        ASSERT_NOT_NULL(strstr(sdp, "c=IN IP4 127.0.0.1\r\n"));
+    }
+
+    lws_sess_destroy(sess);
+}
+
+/**
+ * @brief One side of the trickle ICE loopback: candidates queued for the peer
+ */
+typedef struct {
+    char cands[8][LWS_ICE_CAND_SIZE];
+    int count;
+    int end;                        /* on_gathering_done: end-of-candidates */
+    int connected;
+    uint64_t connected_us;
+} trickle_side_t;
+
+static uint64_t test_now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+}
+
+static void trickle_on_candidate(lws_sess_t* sess, const char* candidate, void* userdata)
+{
+    trickle_side_t* side = (trickle_side_t*)userdata;
+    (void)sess;
+
+    if (side->count < 8) {
+        strncpy(side->cands[side->count++], candidate, LWS_ICE_CAND_SIZE - 1);
+    }
+}
+
+static void trickle_on_gathering_done(lws_sess_t* sess, void* userdata)
+{
+    (void)sess;
+    ((trickle_side_t*)userdata)->end = 1;
+}
+
+static void trickle_on_connected(lws_sess_t* sess, void* userdata)
+{
+    trickle_side_t* side = (trickle_side_t*)userdata;
+    (void)sess;
+
+    side->connected++;
+    side->connected_us = test_now_us();
+}
+
+/**
+ * @brief Deliver queued candidates (as SIP INFO would) and end-of-candidates
+ */
+static void trickle_flush(trickle_side_t* from, lws_sess_t* to)
+{
+    int i;
+
+    for (i = 0; i < from->count; i++) {
+        lws_sess_add_remote_candidate(to, from->cands[i]);     /* SDP中已有的返回-1 */
+    }
+    from->count = 0;
+    if (from->end) {
+        lws_sess_end_of_candidates(to);
+    }
+}
+
+TEST(sess_ice_loopback) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    trickle_side_t sa, sb;
+    char offer[2048];
+    uint64_t start;
+    int i;
+
+    reset_mocks();
+    g_dtmf_count = 0;
+    memset(&sa, 0, sizeof(sa));
+    memset(&sb, 0, sizeof(sb));
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    config.enable_ice = 1;
+    config.trickle_ice = 1;
+    config.ice_aggressive = 1;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_sdp_ready = mock_on_sdp_ready;
+    handler.on_candidate = trickle_on_candidate;
+    handler.on_gathering_done = trickle_on_gathering_done;
+    handler.on_connected = trickle_on_connected;
+    handler.on_error = mock_on_error;
+    handler.on_dtmf = mock_on_dtmf;
+
+    handler.userdata = &sa;
+    lws_sess_t* a = lws_sess_create(&config, &handler);
+    config.enable_ice = 0;          /* 应答方随对端offer启用ICE */
+    handler.userdata = &sb;
+    lws_sess_t* b = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+
+    /* Half trickle：offer在收集开始时发出，不含a=end-of-candidates */
+    ASSERT_EQ(lws_sess_gather_candidates(a), 0);
+    ASSERT_EQ(g_on_sdp_ready_called, 1);
+    strcpy(offer, g_last_sdp);
+    if (!strstr(offer, "a=candidate:")) {
+        /* 没有可用接口（只有回环）时无法配对 */
+        lws_sess_destroy(a);
+        lws_sess_destroy(b);
+        return;
+    }
+    ASSERT_NOT_NULL(strstr(offer, "a=ice-options:trickle\r\n"));
+    ASSERT_NOT_NULL(strstr(offer, "a=rtcp-mux\r\n"));
+    ASSERT_NULL(strstr(offer, "a=end-of-candidates"));
+
+    ASSERT_EQ(lws_sess_set_remote_sdp(b, offer), 0);
+    ASSERT_NOT_NULL(lws_sess_get_ice(b));
+    ASSERT_EQ(lws_sess_gather_candidates(b), 0);
+    ASSERT_EQ(lws_sess_set_remote_sdp(a, lws_sess_get_local_sdp(b)), 0);
+    trickle_flush(&sa, b);
+    trickle_flush(&sb, a);
+    ASSERT_EQ(lws_sess_add_remote_candidate(a, "candidate:garbage"), -1);
+
+    start = test_now_us();
+    ASSERT_EQ(lws_sess_start_ice(a), 0);
+    ASSERT_EQ(lws_sess_start_ice(b), 0);
+    ASSERT_EQ(lws_sess_get_state(a), LWS_SESS_STATE_CONNECTING);
+    for (i = 0; i < 400 && (!sa.connected || !sb.connected); i++) {
+        lws_sess_loop(a, 0);
+        lws_sess_loop(b, 0);
+        usleep(1000);
+    }
+    ASSERT_EQ(sa.connected, 1);
+    ASSERT_EQ(sb.connected, 1);
+    ASSERT_EQ(g_on_error_called, 0);
+    ASSERT_EQ(lws_sess_get_state(a), LWS_SESS_STATE_CONNECTED);
+
+    ASSERT_EQ(lws_sess_get_stats(a, &stats), 0);
+    ASSERT_TRUE(stats.ice_connect_ms >= 0);
+    ASSERT_TRUE(stats.ice_checks_sent > 0);
+    printf("    time to connected (loopback): offerer %d ms, answerer %d ms\n",
+           (int)((sa.connected_us - start) / 1000), (int)((sb.connected_us - start) / 1000));
+
+    /* 媒体经选定候选对传输 */
+    ASSERT_EQ(lws_sess_send_dtmf(a, "5", 80), 0);
+    for (i = 0; i < 400 && g_dtmf_count < 1; i++) {
+        lws_sess_loop(a, 0);
+        lws_sess_loop(b, 0);
+        usleep(5000);
+    }
+    ASSERT_EQ(g_dtmf_count, 1);
+    ASSERT_EQ(g_dtmf_digits[0], '5');
+
+    lws_sess_destroy(a);
+    lws_sess_destroy(b);
+}
+
+TEST(sess_ice_lite) {
+    lws_sess_config_t config;
+    lws_sess_handler_t handler;
+    lws_sess_stats_t stats;
+    trickle_side_t sa, sb;
+    char offer[2048];
+    int i;
+
+    reset_mocks();
+    g_dtmf_count = 0;
+    memset(&sa, 0, sizeof(sa));
+    memset(&sb, 0, sizeof(sb));
+
+    lws_sess_init_audio_config(&config, NULL, LWS_RTP_PAYLOAD_PCMU);
+    config.enable_ice = 1;
+    memset(&handler, 0, sizeof(handler));
+    handler.on_sdp_ready = mock_on_sdp_ready;
+    handler.on_connected = trickle_on_connected;
+    handler.on_error = mock_on_error;
+    handler.on_dtmf = mock_on_dtmf;
+
+    handler.userdata = &sa;
+    lws_sess_t* a = lws_sess_create(&config, &handler);
+    config.enable_ice = 0;
+    config.ice_lite = 1;
+    config.trickle_ice = 1;         /* lite忽略trickle */
+    handler.userdata = &sb;
+    lws_sess_t* b = lws_sess_create(&config, &handler);
+    ASSERT_NOT_NULL(a);
+    ASSERT_NOT_NULL(b);
+
+    ASSERT_EQ(lws_sess_gather_candidates(a), 0);
+    ASSERT_EQ(g_on_sdp_ready_called, 1);
+    strcpy(offer, g_last_sdp);
+    if (!strstr(offer, "a=candidate:")) {
+        lws_sess_destroy(a);
+        lws_sess_destroy(b);
+        return;
+    }
+
+    /* lite应答与RTP直连一样同步生成：会话级a=ice-lite，只有host候选 */
+    ASSERT_EQ(lws_sess_set_remote_sdp(b, offer), 0);
+    ASSERT_EQ(lws_sess_gather_candidates(b), 0);
+    ASSERT_EQ(g_on_sdp_ready_called, 2);
+    ASSERT_NOT_NULL(strstr(g_last_sdp, "t=0 0\r\na=ice-lite\r\n"));
+    ASSERT_NOT_NULL(strstr(g_last_sdp, "typ host"));
+    ASSERT_NULL(strstr(g_last_sdp, "typ srflx"));
+    ASSERT_NULL(strstr(g_last_sdp, "a=ice-options:trickle"));
+    ASSERT_EQ(lws_sess_set_remote_sdp(a, lws_sess_get_local_sdp(b)), 0);
+
+    ASSERT_EQ(lws_sess_start_ice(a), 0);
+    ASSERT_EQ(lws_sess_start_ice(b), 0);
+    for (i = 0; i < 400 && (!sa.connected || !sb.connected); i++) {
+        lws_sess_loop(a, 0);
+        lws_sess_loop(b, 0);
+        usleep(1000);
+    }
+    ASSERT_EQ(sa.connected, 1);
+    ASSERT_EQ(sb.connected, 1);
+    ASSERT_EQ(g_on_error_called, 0);
+
+    /* lite端不发检查，媒体发往提名的地址 */
+    ASSERT_EQ(lws_sess_get_stats(b, &stats), 0);
+    ASSERT_EQ(stats.ice_checks_sent, 0u);
+    ASSERT_EQ(lws_sess_send_dtmf(b, "7", 80), 0);
+    for (i = 0; i < 400 && g_dtmf_count < 1; i++) {
+        lws_sess_loop(a, 0);
+        lws_sess_loop(b, 0);
+        usleep(5000);
+    }
+    ASSERT_EQ(g_dtmf_count, 1);
+    ASSERT_EQ(g_dtmf_digits[0], '7');
+
+    lws_sess_destroy(a);
+    lws_sess_destroy(b);
+}
+
 #endif /* !DEBUG_SESS */
 
 /* ========================================
@@ -367,6 +1761,22 @@ int main(int argc, char* argv[]) {
     run_test_sess_set_remote_sdp_null_sdp();
     run_test_sess_start_ice_null();
     run_test_sess_stop_null();
+    run_test_sess_update_remote_sdp();
+    run_test_sess_codec_negotiation();
+    run_test_sess_dtmf_loopback();
+    run_test_sess_srtp_loopback();
+    run_test_sess_symmetric_rtp();
+    run_test_sess_bundle();
+    run_test_sess_bundle_fallback();
+    run_test_sess_red();
+    run_test_sess_ptime();
+    run_test_sess_graph();
+    run_test_sess_record_async();
+    run_test_sess_record_stereo();
+    run_test_sess_record_passthrough();
+    run_test_sess_ice_gathering();
+    run_test_sess_ice_loopback();
+    run_test_sess_ice_lite();
 #endif
 
     printf("\n==================================================\n");
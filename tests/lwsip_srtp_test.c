@@ -0,0 +1,390 @@
+/**
+ * @file lwsip_srtp_test.c
+ * @brief Unit tests and benchmark for lws_srtp.c (SRTP/SRTCP, SDES)
+ *
+ * Test coverage:
+ * - AES_CM_128_HMAC_SHA1_80 known answer (RFC 3711 B.3 master key)
+ * - RTP and RTCP round trip for every suite, in place
+ * - Tampered packets, replays and packets older than the window
+ * - ROC rollover and reordering across it
+ * - SDES a=crypto key encoding, lifetime and MKI handling
+ * - Benchmark: protect + unprotect packets per second on one core
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lws_srtp.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+
+#define TEST_SSRC       0xcafebabeu
+
+/* ========================================
+ * Helpers
+ * ======================================== */
+
+/* RFC 3711 B.3 master key and salt (AES-256 suites use the key twice) */
+static const uint8_t s_master[LWS_SRTP_MAX_MASTER] = {
+    0xe1, 0xf9, 0x7a, 0x0d, 0x3e, 0x01, 0x8b, 0xe0,
+    0xd6, 0x4f, 0xa3, 0x2c, 0x06, 0xde, 0x41, 0x39,
+    0x0e, 0xc6, 0x75, 0xad, 0x49, 0x8a, 0xfe, 0xeb,
+    0xb6, 0x96, 0x0b, 0x3a, 0xab, 0xe6, 0xe1, 0xf9,
+    0x7a, 0x0d, 0x3e, 0x01, 0x8b, 0xe0, 0xd6, 0x4f,
+    0xa3, 0x2c, 0x06, 0xde, 0x41, 0x39,
+};
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int make_rtp(uint8_t* buf, uint16_t seq, uint32_t ssrc, int payload)
+{
+    int i;
+
+    buf[0] = 0x80;
+    buf[1] = 0;
+    buf[2] = (uint8_t)(seq >> 8);
+    buf[3] = (uint8_t)seq;
+    buf[4] = 0; buf[5] = 0; buf[6] = 0x12; buf[7] = 0x34;
+    buf[8] = (uint8_t)(ssrc >> 24);
+    buf[9] = (uint8_t)(ssrc >> 16);
+    buf[10] = (uint8_t)(ssrc >> 8);
+    buf[11] = (uint8_t)ssrc;
+    for (i = 0; i < payload; i++) {
+        buf[12 + i] = (uint8_t)(seq + i);
+    }
+    return 12 + payload;
+}
+
+/* Empty RR with a sender SSRC, padded with an APP-like body */
+static int make_rtcp(uint8_t* buf, uint32_t ssrc, int body)
+{
+    int i;
+
+    buf[0] = 0x80;
+    buf[1] = 201;
+    buf[2] = 0;
+    buf[3] = (uint8_t)(1 + body / 4);
+    buf[4] = (uint8_t)(ssrc >> 24);
+    buf[5] = (uint8_t)(ssrc >> 16);
+    buf[6] = (uint8_t)(ssrc >> 8);
+    buf[7] = (uint8_t)ssrc;
+    for (i = 0; i < body; i++) {
+        buf[8 + i] = (uint8_t)i;
+    }
+    return 8 + body;
+}
+
+/* ========================================
+ * Tests
+ * ======================================== */
+
+TEST(srtp_known_answer)
+{
+    /* RFC 3711 B.3的master key保护一个16字节0xab负载的RTP包 */
+    static const uint8_t plain[28] = {
+        0x80, 0x0f, 0x12, 0x34, 0xde, 0xca, 0xfb, 0xad,
+        0xca, 0xfe, 0xba, 0xbe, 0xab, 0xab, 0xab, 0xab,
+        0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xab, 0xab,
+        0xab, 0xab, 0xab, 0xab,
+    };
+    static const uint8_t cipher[38] = {
+        0x80, 0x0f, 0x12, 0x34, 0xde, 0xca, 0xfb, 0xad,
+        0xca, 0xfe, 0xba, 0xbe, 0x4e, 0x55, 0xdc, 0x4c,
+        0xe7, 0x99, 0x78, 0xd8, 0x8c, 0xa4, 0xd2, 0x15,
+        0x94, 0x9d, 0x24, 0x02, 0xb7, 0x8d, 0x6a, 0xcc,
+        0x99, 0xea, 0x17, 0x9b, 0x8d, 0xbb,
+    };
+    uint8_t buf[64];
+    lws_srtp_t* tx = lws_srtp_create(LWS_SRTP_AES_CM_128_HMAC_SHA1_80, s_master);
+    lws_srtp_t* rx = lws_srtp_create(LWS_SRTP_AES_CM_128_HMAC_SHA1_80, s_master);
+    ASSERT_TRUE(tx && rx);
+
+    memcpy(buf, plain, sizeof(plain));
+    ASSERT_EQ(lws_srtp_protect(tx, buf, sizeof(plain), sizeof(buf)), (int)sizeof(cipher));
+    ASSERT_TRUE(memcmp(buf, cipher, sizeof(cipher)) == 0);
+
+    ASSERT_EQ(lws_srtp_unprotect(rx, buf, sizeof(cipher)), (int)sizeof(plain));
+    ASSERT_TRUE(memcmp(buf, plain, sizeof(plain)) == 0);
+
+    lws_srtp_destroy(tx);
+    lws_srtp_destroy(rx);
+}
+
+TEST(srtp_round_trip_all_suites)
+{
+    uint8_t buf[1200 + LWS_SRTP_MAX_TRAILER];
+    uint8_t ref[1200];
+    int suite;
+
+    for (suite = 0; suite < LWS_SRTP_SUITE_COUNT; suite++) {
+        lws_srtp_t* tx = lws_srtp_create((lws_srtp_suite_t)suite, s_master);
+        lws_srtp_t* rx = lws_srtp_create((lws_srtp_suite_t)suite, s_master);
+        int n, len, i;
+        ASSERT_TRUE(tx && rx);
+
+        for (i = 0; i < 3; i++) {
+            n = make_rtp(ref, (uint16_t)(100 + i), TEST_SSRC, 160 + i * 400);
+            memcpy(buf, ref, n);
+            len = lws_srtp_protect(tx, buf, n, sizeof(buf));
+            ASSERT_TRUE(len > n && len <= n + LWS_SRTP_MAX_TRAILER);
+            ASSERT_TRUE(memcmp(buf, ref, 12) == 0);            /* Header in clear */
+            ASSERT_FALSE(memcmp(buf + 12, ref + 12, n - 12) == 0);
+            ASSERT_EQ(lws_srtp_unprotect(rx, buf, len), n);
+            ASSERT_TRUE(memcmp(buf, ref, n) == 0);
+        }
+
+        n = make_rtcp(ref, TEST_SSRC, 24);
+        memcpy(buf, ref, n);
+        len = lws_srtp_protect_rtcp(tx, buf, n, sizeof(buf));
+        ASSERT_TRUE(len > n && len <= n + LWS_SRTP_MAX_TRAILER);
+        ASSERT_TRUE(memcmp(buf, ref, 8) == 0);
+        ASSERT_EQ(lws_srtp_unprotect_rtcp(rx, buf, len), n);
+        ASSERT_TRUE(memcmp(buf, ref, n) == 0);
+
+        /* 缓冲区不足以放下标签 */
+        n = make_rtp(buf, 200, TEST_SSRC, 20);
+        ASSERT_EQ(lws_srtp_protect(tx, buf, n, n + 3), LWS_SRTP_ERR_FORMAT);
+
+        lws_srtp_destroy(tx);
+        lws_srtp_destroy(rx);
+    }
+}
+
+TEST(srtp_auth_and_replay)
+{
+    uint8_t pkt[8][200];
+    int len[8];
+    uint8_t buf[200];
+    lws_srtp_t* tx = lws_srtp_create(LWS_SRTP_AES_CM_128_HMAC_SHA1_32, s_master);
+    lws_srtp_t* rx = lws_srtp_create(LWS_SRTP_AES_CM_128_HMAC_SHA1_32, s_master);
+    lws_srtp_t* other;
+    int i, n;
+    ASSERT_TRUE(tx && rx);
+
+    for (i = 0; i < 8; i++) {
+        n = make_rtp(pkt[i], (uint16_t)(1000 + i), TEST_SSRC, 80);
+        len[i] = lws_srtp_protect(tx, pkt[i], n, sizeof(pkt[i]));
+        ASSERT_TRUE(len[i] > 0);
+    }
+
+    /* 篡改负载 / 标签 */
+    memcpy(buf, pkt[0], len[0]);
+    buf[20] ^= 1;
+    ASSERT_EQ(lws_srtp_unprotect(rx, buf, len[0]), LWS_SRTP_ERR_AUTH);
+    memcpy(buf, pkt[0], len[0]);
+    buf[len[0] - 1] ^= 0x80;
+    ASSERT_EQ(lws_srtp_unprotect(rx, buf, len[0]), LWS_SRTP_ERR_AUTH);
+
+    /* 乱序到达可接受，重复的被拒绝 */
+    memcpy(buf, pkt[3], len[3]);
+    ASSERT_EQ(lws_srtp_unprotect(rx, buf, len[3]), 92);
+    memcpy(buf, pkt[1], len[1]);
+    ASSERT_EQ(lws_srtp_unprotect(rx, buf, len[1]), 92);
+    memcpy(buf, pkt[3], len[3]);
+    ASSERT_EQ(lws_srtp_unprotect(rx, buf, len[3]), LWS_SRTP_ERR_REPLAY);
+    memcpy(buf, pkt[1], len[1]);
+    ASSERT_EQ(lws_srtp_unprotect(rx, buf, len[1]), LWS_SRTP_ERR_REPLAY);
+    memcpy(buf, pkt[2], len[2]);
+    ASSERT_EQ(lws_srtp_unprotect(rx, buf, len[2]), 92);
+
+    /* 超出64包窗口的旧包 */
+    n = make_rtp(buf, 1100, TEST_SSRC, 80);
+    n = lws_srtp_protect(tx, buf, n, sizeof(buf));
+    ASSERT_EQ(lws_srtp_unprotect(rx, buf, n), 92);
+    memcpy(buf, pkt[4], len[4]);
+    ASSERT_EQ(lws_srtp_unprotect(rx, buf, len[4]), LWS_SRTP_ERR_REPLAY);
+
+    /* 不同密钥 */
+    other = lws_srtp_create(LWS_SRTP_AES_CM_128_HMAC_SHA1_32, s_master + 1);
+    ASSERT_TRUE(other != NULL);
+    memcpy(buf, pkt[5], len[5]);
+    ASSERT_EQ(lws_srtp_unprotect(other, buf, len[5]), LWS_SRTP_ERR_AUTH);
+
+    /* SRTCP重放 */
+    n = make_rtcp(buf, TEST_SSRC, 0);
+    n = lws_srtp_protect_rtcp(tx, buf, n, sizeof(buf));
+    memcpy(pkt[0], buf, n);
+    ASSERT_EQ(lws_srtp_unprotect_rtcp(rx, buf, n), 8);
+    ASSERT_EQ(lws_srtp_unprotect_rtcp(rx, pkt[0], n), LWS_SRTP_ERR_REPLAY);
+
+    lws_srtp_destroy(other);
+    lws_srtp_destroy(tx);
+    lws_srtp_destroy(rx);
+}
+
+TEST(srtp_roc_rollover)
+{
+    static const uint16_t order[] = { 65533, 65534, 0, 65535, 1, 2 };
+    uint8_t pkt[6][100];
+    int len[6];
+    uint8_t ref[100];
+    lws_srtp_t* tx = lws_srtp_create(LWS_SRTP_AEAD_AES_128_GCM, s_master);
+    lws_srtp_t* rx = lws_srtp_create(LWS_SRTP_AEAD_AES_128_GCM, s_master);
+    int i, n;
+    ASSERT_TRUE(tx && rx);
+
+    /* 发送端跨越65535，ROC加一；65535晚于0发出（重传）仍用旧ROC */
+    for (i = 0; i < 6; i++) {
+        n = make_rtp(pkt[i], order[i], TEST_SSRC, 40);
+        len[i] = lws_srtp_protect(tx, pkt[i], n, sizeof(pkt[i]));
+        ASSERT_TRUE(len[i] > 0);
+    }
+
+    /* 接收端从回绕前的包开始（ROC初值0），之后逆序收到 */
+    for (i = 0; i < 6; i++) {
+        int k = i == 0 ? 0 : 6 - i;
+        n = make_rtp(ref, order[k], TEST_SSRC, 40);
+        ASSERT_EQ(lws_srtp_unprotect(rx, pkt[k], len[k]), n);
+        ASSERT_TRUE(memcmp(pkt[k], ref, n) == 0);
+    }
+
+    lws_srtp_destroy(tx);
+    lws_srtp_destroy(rx);
+}
+
+TEST(srtp_sdes)
+{
+    uint8_t master[LWS_SRTP_MAX_MASTER];
+    char line[128];
+    const char* key;
+    int n;
+
+    ASSERT_EQ(lws_srtp_suite_parse("AES_CM_128_HMAC_SHA1_80", -1), LWS_SRTP_AES_CM_128_HMAC_SHA1_80);
+    ASSERT_EQ(lws_srtp_suite_parse("AEAD_AES_256_GCM", -1), LWS_SRTP_AEAD_AES_256_GCM);
+    ASSERT_EQ(lws_srtp_suite_parse("AES_CM_128_HMAC_SHA1", -1), -1);
+    ASSERT_EQ(lws_srtp_suite_parse("F8_128_HMAC_SHA1_80", -1), -1);
+    ASSERT_EQ(lws_srtp_master_len(LWS_SRTP_AES_CM_128_HMAC_SHA1_80), 30);
+    ASSERT_EQ(lws_srtp_master_len(LWS_SRTP_AEAD_AES_128_GCM), 28);
+    ASSERT_EQ(lws_srtp_master_len(LWS_SRTP_AEAD_AES_256_GCM), 44);
+
+    /* RFC 4568 §9.1的示例key */
+    key = "inline:PS1uQCVeeCFCanVmcjkpPywjNWhcYD0mXXtxaVBR|2^20|1:32";
+    ASSERT_EQ(lws_srtp_sdes_key(LWS_SRTP_AES_CM_128_HMAC_SHA1_80, key, (int)strlen(key), master), -1);
+    key = "inline:PS1uQCVeeCFCanVmcjkpPywjNWhcYD0mXXtxaVBR|2^20";
+    ASSERT_EQ(lws_srtp_sdes_key(LWS_SRTP_AES_CM_128_HMAC_SHA1_80, key, (int)strlen(key), master), 0);
+    ASSERT_EQ(master[0], 0x3d);
+    ASSERT_EQ(master[29], 0x51);
+    key = "inline:PS1uQCVeeCFCanVmcjkpPywjNWhcYD0mXXtxaVBR";
+    ASSERT_EQ(lws_srtp_sdes_key(LWS_SRTP_AEAD_AES_128_GCM, key, (int)strlen(key), master), -1);
+    ASSERT_EQ(lws_srtp_sdes_key(LWS_SRTP_AES_CM_128_HMAC_SHA1_80, key + 7, (int)strlen(key) - 7,
+                                master), -1);
+
+    /* 写出再解析 */
+    n = lws_srtp_sdes_write(1, LWS_SRTP_AEAD_AES_256_GCM, s_master, line, sizeof(line));
+    ASSERT_TRUE(n > 0);
+    ASSERT_TRUE(strncmp(line, "a=crypto:1 AEAD_AES_256_GCM inline:", 35) == 0);
+    ASSERT_TRUE(strcmp(line + n - 2, "\r\n") == 0);
+    ASSERT_EQ(lws_srtp_sdes_key(LWS_SRTP_AEAD_AES_256_GCM, line + 28, n - 30, master), 0);
+    ASSERT_TRUE(memcmp(master, s_master, 44) == 0);
+    ASSERT_EQ(lws_srtp_sdes_write(1, LWS_SRTP_AEAD_AES_256_GCM, s_master, line, 40), -1);
+
+    ASSERT_EQ(lws_srtp_random(master, sizeof(master)), 0);
+}
+
+/* ========================================
+ * Benchmark
+ * ======================================== */
+
+#define BENCH_PACKETS 200000
+
+static void bench_one(lws_srtp_suite_t suite, int payload)
+{
+    uint8_t buf[1500];
+    lws_srtp_t* tx = lws_srtp_create(suite, s_master);
+    lws_srtp_t* rx = lws_srtp_create(suite, s_master);
+    volatile int sink = 0;
+    double t0, t1;
+    int i, n;
+
+    if (!tx || !rx) {
+        lws_srtp_destroy(tx);
+        lws_srtp_destroy(rx);
+        return;
+    }
+
+    t0 = now_sec();
+    for (i = 0; i < BENCH_PACKETS; i++) {
+        n = make_rtp(buf, (uint16_t)i, TEST_SSRC, payload);
+        n = lws_srtp_protect(tx, buf, n, sizeof(buf));
+        sink += lws_srtp_unprotect(rx, buf, n);
+    }
+    t1 = now_sec();
+
+    printf("    %-24s %4d bytes: %8.0f packets/s (protect + unprotect)\n",
+           lws_srtp_suite_name(suite), payload, BENCH_PACKETS / (t1 - t0));
+    (void)sink;
+    lws_srtp_destroy(tx);
+    lws_srtp_destroy(rx);
+}
+
+TEST(srtp_bench)
+{
+    int suite;
+    for (suite = 0; suite < LWS_SRTP_SUITE_COUNT; suite++) {
+        bench_one((lws_srtp_suite_t)suite, 160);       /* G.711 20 ms */
+        bench_one((lws_srtp_suite_t)suite, 1200);      /* Video */
+    }
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_srtp Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_srtp_known_answer();
+    run_test_srtp_round_trip_all_suites();
+    run_test_srtp_auth_and_replay();
+    run_test_srtp_roc_rollover();
+    run_test_srtp_sdes();
+    run_test_srtp_bench();
+
+    printf("\n==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,956 @@
+/**
+ * @file lwsip_turn_test.c
+ * @brief Unit tests for lws_turn.c
+ *
+ * Test coverage (against an in-memory TURN server stand-in that enforces
+ * long-term credentials, permissions, channel bindings and lifetimes):
+ * - Allocate with the 401 challenge, wrong password, stale nonce (438)
+ * - ChannelData framing vs Send indications, and the relayed return path
+ *   (ChannelData and Data indications)
+ * - Allocation, permission and channel refresh over 20 simulated minutes
+ * - Deallocation on destroy
+ * - ICE over the relay from a network where only the TURN server is reachable
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "lws_stun.h"
+#include "lws_turn.h"
+#include "lws_ice.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+
+/* ========================================
+ * In-memory network and TURN server stand-in
+ * ======================================== */
+
+#define MAX_PACKETS     128
+#define PACKET_SIZE     1600
+#define STEP_US         10000       /* 10ms per loop iteration */
+#define LATENCY_US      5000        /* One-way delay */
+#define SRV_MAX         8
+
+#define USERNAME        "alice"
+#define PASSWORD        "correct-horse"
+#define REALM           "lwsip.test"
+
+typedef struct {
+    int to;                         /* 0 = client A (via TURN), 1 = peer B */
+    struct sockaddr_in from;
+    uint8_t data[PACKET_SIZE];
+    int bytes;
+    uint64_t deliver_us;
+} packet_t;
+
+typedef struct turn_net turn_net_t;
+
+typedef struct {
+    turn_net_t* net;
+    int side;
+} ice_side_t;
+
+struct turn_net {
+    uint64_t now;
+    struct sockaddr_in server;      /* TURN server */
+    struct sockaddr_in relay;       /* Relayed transport address it allocates */
+    struct sockaddr_in a_host;      /* Client A, private */
+    struct sockaddr_in a_nat;       /* A's mapping towards the server */
+    struct sockaddr_in b_host;      /* Peer B, public */
+
+    /* Server state */
+    char nonce[32];
+    int nonce_gen;
+    uint8_t key[16];
+    int allocated;
+    uint64_t alloc_expires;
+    struct { uint32_t ip; uint64_t expires; } perms[SRV_MAX];
+    int perm_count;
+    struct { uint16_t number; struct sockaddr_in peer; uint64_t expires; } chans[SRV_MAX];
+    int chan_count;
+    int stale;                      /* Answer the next authenticated request with 438 */
+    int no_channels;                /* Reject ChannelBind */
+
+    /* Server counters */
+    int challenges;
+    int stale_sent;
+    int allocates;
+    int refreshes;
+    int deallocs;
+    int permissions;
+    int binds;
+    int send_ind;
+    int channel_data;
+    int last_client_bytes;          /* Size of the last data-carrying datagram from A */
+
+    /* Peer B without an ICE agent: what the relay delivered */
+    int peer_rx;
+    uint8_t peer_data[PACKET_SIZE];
+    int peer_bytes;
+
+    /* Client A */
+    lws_turn_t* turn;
+    int on_allocated;
+    struct sockaddr_in cb_relayed;
+    struct sockaddr_in cb_mapped;
+    int failed_code;
+    int client_rx;                  /* Relayed datagrams not consumed by ICE */
+    struct sockaddr_in client_rx_peer;
+    uint8_t client_rx_data[PACKET_SIZE];
+    int client_rx_bytes;
+
+    /* ICE over the relay */
+    lws_ice_t* ice[2];
+    ice_side_t side[2];
+    lws_ice_state_t state[2];
+    int media[2];
+
+    packet_t packets[MAX_PACKETS];
+    int packet_count;
+};
+
+static void make_addr(struct sockaddr_in* addr, const char* ip, int port)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)port);
+    inet_pton(AF_INET, ip, &addr->sin_addr);
+}
+
+static int addr_eq(const struct sockaddr_in* a, const struct sockaddr_in* b)
+{
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+static void net_queue(turn_net_t* net, int to, const struct sockaddr_in* from,
+                      const uint8_t* data, int bytes)
+{
+    packet_t* pkt;
+
+    if (net->packet_count >= MAX_PACKETS || bytes > PACKET_SIZE) {
+        return;
+    }
+    pkt = &net->packets[net->packet_count++];
+    pkt->to = to;
+    pkt->from = *from;
+    memcpy(pkt->data, data, bytes);
+    pkt->bytes = bytes;
+    pkt->deliver_us = net->now + LATENCY_US;
+}
+
+static void put16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static int srv_permitted(const turn_net_t* net, const struct sockaddr_in* peer)
+{
+    int i;
+
+    if (!net->allocated || net->now >= net->alloc_expires) {
+        return 0;
+    }
+    for (i = 0; i < net->perm_count; i++) {
+        if (net->perms[i].ip == peer->sin_addr.s_addr && net->now < net->perms[i].expires) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void srv_permit(turn_net_t* net, const struct sockaddr_in* peer)
+{
+    int i;
+
+    for (i = 0; i < net->perm_count && net->perms[i].ip != peer->sin_addr.s_addr; i++) {
+    }
+    if (i == net->perm_count) {
+        if (net->perm_count >= SRV_MAX) {
+            return;
+        }
+        net->perm_count++;
+    }
+    net->perms[i].ip = peer->sin_addr.s_addr;
+    net->perms[i].expires = net->now + (uint64_t)LWS_TURN_PERMISSION_S * 1000000;
+}
+
+static void srv_rotate_nonce(turn_net_t* net)
+{
+    snprintf(net->nonce, sizeof(net->nonce), "nonce-%d", ++net->nonce_gen);
+}
+
+/**
+ * @brief Success or error response, authenticated once the client sent credentials
+ */
+static void srv_reply(turn_net_t* net, const uint8_t* req, int code, int lifetime, int auth)
+{
+    uint8_t rsp[LWS_STUN_MAX_MESSAGE];
+    uint16_t method = LWS_STUN_METHOD(lws_stun_type(req));
+    int size = sizeof(rsp);
+    int n;
+
+    n = lws_stun_init(rsp, size, (uint16_t)(method | (code ? 0x0110 : 0x0100)),
+                      lws_stun_msg_tid(req));
+    if (code) {
+        n = lws_stun_add_error(rsp, size, n, code, code == 438 ? "Stale Nonce" : "Unauthorized");
+        if (code == 401 || code == 438) {
+            n = lws_stun_add(rsp, size, n, LWS_STUN_ATTR_REALM, REALM, (int)strlen(REALM));
+            n = lws_stun_add(rsp, size, n, LWS_STUN_ATTR_NONCE, net->nonce, (int)strlen(net->nonce));
+        }
+    } else {
+        if (method == LWS_STUN_ALLOCATE) {
+            n = lws_stun_add_xor_addr(rsp, size, n, LWS_STUN_ATTR_XOR_RELAYED_ADDRESS, &net->relay);
+            n = lws_stun_add_xor_addr(rsp, size, n, LWS_STUN_ATTR_XOR_MAPPED_ADDRESS, &net->a_nat);
+        }
+        if (method == LWS_STUN_ALLOCATE || method == LWS_STUN_REFRESH) {
+            n = lws_stun_add_u32(rsp, size, n, LWS_STUN_ATTR_LIFETIME, (uint32_t)lifetime);
+        }
+    }
+    if (auth) {
+        n = lws_stun_add_integrity(rsp, size, n, net->key, sizeof(net->key));
+    }
+    n = lws_stun_add_fingerprint(rsp, size, n);
+    net_queue(net, 0, &net->server, rsp, n);
+}
+
+/**
+ * @brief Relay to a peer: B's agent when present, otherwise recorded
+ */
+static void srv_to_peer(turn_net_t* net, const struct sockaddr_in* peer,
+                        const uint8_t* data, int bytes)
+{
+    if (net->ice[1] && addr_eq(peer, &net->b_host)) {
+        net_queue(net, 1, &net->relay, data, bytes);
+        return;
+    }
+    net->peer_rx++;
+    memcpy(net->peer_data, data, bytes);
+    net->peer_bytes = bytes;
+}
+
+/**
+ * @brief Datagram from a peer to the relayed address
+ */
+static void srv_from_peer(turn_net_t* net, const struct sockaddr_in* from,
+                          const uint8_t* data, int bytes)
+{
+    uint8_t buf[PACKET_SIZE];
+    uint8_t tid[LWS_STUN_TID_SIZE];
+    int n;
+    int i;
+
+    if (!srv_permitted(net, from)) {
+        return;
+    }
+    for (i = 0; i < net->chan_count; i++) {
+        if (addr_eq(&net->chans[i].peer, from) && net->now < net->chans[i].expires) {
+            put16(buf, net->chans[i].number);
+            put16(buf + 2, (uint16_t)bytes);
+            memcpy(buf + 4, data, bytes);
+            net_queue(net, 0, &net->server, buf, 4 + bytes);
+            return;
+        }
+    }
+    memset(tid, 0x5a, sizeof(tid));
+    n = lws_stun_init(buf, sizeof(buf), LWS_STUN_DATA_INDICATION, tid);
+    n = lws_stun_add_xor_addr(buf, sizeof(buf), n, LWS_STUN_ATTR_XOR_PEER_ADDRESS, from);
+    n = lws_stun_add(buf, sizeof(buf), n, LWS_STUN_ATTR_DATA, data, bytes);
+    net_queue(net, 0, &net->server, buf, n);
+}
+
+/**
+ * @brief Datagram from client A (through its NAT) to the server
+ */
+static void srv_from_client(turn_net_t* net, const uint8_t* data, int bytes)
+{
+    struct sockaddr_in peer;
+    const uint8_t* value;
+    uint16_t type;
+    uint32_t u32 = 0;
+    int vlen = 0;
+    int i;
+
+    /* ChannelData */
+    if (bytes >= 4 && LWS_TURN_IS_CHANNEL_DATA(data[0])) {
+        uint16_t number = (uint16_t)(data[0] << 8 | data[1]);
+        int len = data[2] << 8 | data[3];
+
+        for (i = 0; i < net->chan_count; i++) {
+            if (net->chans[i].number == number && net->now < net->chans[i].expires &&
+                srv_permitted(net, &net->chans[i].peer) && 4 + len <= bytes) {
+                net->channel_data++;
+                net->last_client_bytes = bytes;
+                srv_to_peer(net, &net->chans[i].peer, data + 4, len);
+            }
+        }
+        return;
+    }
+    if (!lws_stun_is_message(data, bytes)) {
+        return;
+    }
+
+    type = lws_stun_type(data);
+    if (type == LWS_STUN_SEND_INDICATION) {
+        value = lws_stun_find(data, bytes, LWS_STUN_ATTR_DATA, &vlen);
+        if (value && lws_stun_xor_addr(data, bytes, LWS_STUN_ATTR_XOR_PEER_ADDRESS, &peer) == 0 &&
+            srv_permitted(net, &peer)) {
+            net->send_ind++;
+            net->last_client_bytes = bytes;
+            srv_to_peer(net, &peer, value, vlen);
+        }
+        return;
+    }
+    if (!LWS_STUN_IS_REQUEST(type)) {
+        return;
+    }
+
+    /* 长期凭据：无MI则401；MI错误仍401；nonce过期438 */
+    value = lws_stun_find(data, bytes, LWS_STUN_ATTR_USERNAME, &vlen);
+    if (!lws_stun_find(data, bytes, LWS_STUN_ATTR_MESSAGE_INTEGRITY, NULL) ||
+        !value || vlen != (int)strlen(USERNAME) || memcmp(value, USERNAME, vlen) != 0 ||
+        lws_stun_check_integrity(data, bytes, net->key, sizeof(net->key)) != 0) {
+        net->challenges++;
+        srv_reply(net, data, 401, 0, 0);
+        return;
+    }
+    value = lws_stun_find(data, bytes, LWS_STUN_ATTR_NONCE, &vlen);
+    if (net->stale || !value || vlen != (int)strlen(net->nonce) ||
+        memcmp(value, net->nonce, vlen) != 0) {
+        if (net->stale) {
+            net->stale = 0;
+            srv_rotate_nonce(net);
+        }
+        net->stale_sent++;
+        srv_reply(net, data, 438, 0, 0);
+        return;
+    }
+
+    switch (LWS_STUN_METHOD(type)) {
+    case LWS_STUN_ALLOCATE:
+        lws_stun_get_u32(data, bytes, LWS_STUN_ATTR_LIFETIME, &u32);
+        net->allocates++;
+        net->allocated = 1;
+        net->alloc_expires = net->now + (uint64_t)u32 * 1000000;
+        srv_reply(net, data, 0, (int)u32, 1);
+        break;
+
+    case LWS_STUN_REFRESH:
+        if (!net->allocated || net->now >= net->alloc_expires) {
+            srv_reply(net, data, 437, 0, 1);
+            break;
+        }
+        lws_stun_get_u32(data, bytes, LWS_STUN_ATTR_LIFETIME, &u32);
+        if (u32 == 0) {
+            net->deallocs++;
+            net->allocated = 0;
+        } else {
+            net->refreshes++;
+            net->alloc_expires = net->now + (uint64_t)u32 * 1000000;
+        }
+        srv_reply(net, data, 0, (int)u32, 1);
+        break;
+
+    case LWS_STUN_CREATE_PERMISSION:
+        if (lws_stun_xor_addr(data, bytes, LWS_STUN_ATTR_XOR_PEER_ADDRESS, &peer) != 0) {
+            srv_reply(net, data, 400, 0, 1);
+            break;
+        }
+        net->permissions++;
+        srv_permit(net, &peer);
+        srv_reply(net, data, 0, 0, 1);
+        break;
+
+    case LWS_STUN_CHANNEL_BIND:
+        if (net->no_channels ||
+            lws_stun_get_u32(data, bytes, LWS_STUN_ATTR_CHANNEL_NUMBER, &u32) != 0 ||
+            lws_stun_xor_addr(data, bytes, LWS_STUN_ATTR_XOR_PEER_ADDRESS, &peer) != 0) {
+            srv_reply(net, data, 400, 0, 1);
+            break;
+        }
+        for (i = 0; i < net->chan_count && net->chans[i].number != (uint16_t)(u32 >> 16); i++) {
+        }
+        if (i == net->chan_count && net->chan_count < SRV_MAX) {
+            net->chan_count++;
+        }
+        net->chans[i].number = (uint16_t)(u32 >> 16);
+        net->chans[i].peer = peer;
+        net->chans[i].expires = net->now + (uint64_t)LWS_TURN_CHANNEL_S * 1000000;
+        net->binds++;
+        srv_permit(net, &peer);     /* ChannelBind也安装许可 */
+        srv_reply(net, data, 0, 0, 1);
+        break;
+    }
+}
+
+/* A的网络只允许访问TURN服务器 */
+static int client_send(void* param, const struct sockaddr_in* to, const uint8_t* data, int bytes)
+{
+    turn_net_t* net = (turn_net_t*)param;
+
+    if (addr_eq(to, &net->server)) {
+        srv_from_client(net, data, bytes);
+    }
+    return 0;
+}
+
+static void client_on_allocated(void* param, const struct sockaddr_in* relayed,
+                                const struct sockaddr_in* mapped)
+{
+    turn_net_t* net = (turn_net_t*)param;
+
+    net->on_allocated++;
+    net->cb_relayed = *relayed;
+    net->cb_mapped = *mapped;
+    if (net->ice[0]) {
+        lws_ice_set_relay(net->ice[0], relayed, mapped, net->now);
+    }
+}
+
+static void client_on_failed(void* param, int code)
+{
+    turn_net_t* net = (turn_net_t*)param;
+    net->failed_code = code;
+}
+
+static void net_init(turn_net_t* net, const char* password, int lifetime_s)
+{
+    lws_turn_config_t config;
+    lws_turn_handler_t handler;
+
+    memset(net, 0, sizeof(*net));
+    make_addr(&net->server, "203.0.113.50", 3478);
+    make_addr(&net->relay, "203.0.113.50", 49152);
+    make_addr(&net->a_host, "192.168.1.10", 40000);
+    make_addr(&net->a_nat, "203.0.113.1", 61000);
+    make_addr(&net->b_host, "198.51.100.20", 50000);
+    net->now = 1000000;
+    srv_rotate_nonce(net);
+    lws_stun_long_term_key(USERNAME, REALM, PASSWORD, net->key);
+
+    memset(&config, 0, sizeof(config));
+    config.server = net->server;
+    strcpy(config.username, USERNAME);
+    strcpy(config.password, password);
+    config.lifetime_s = lifetime_s;
+
+    memset(&handler, 0, sizeof(handler));
+    handler.send = client_send;
+    handler.on_allocated = client_on_allocated;
+    handler.on_failed = client_on_failed;
+    handler.param = net;
+    net->turn = lws_turn_create(&config, &handler);
+}
+
+static void net_step(turn_net_t* net)
+{
+    int i = 0;
+
+    net->now += STEP_US;
+    while (i < net->packet_count) {
+        packet_t pkt = net->packets[i];
+        struct sockaddr_in peer;
+        int offset = 0;
+        int len = 0;
+
+        if (pkt.deliver_us > net->now) {
+            i++;
+            continue;
+        }
+        net->packet_count--;
+        memmove(&net->packets[i], &net->packets[i + 1], (net->packet_count - i) * sizeof(packet_t));
+
+        if (pkt.to == 1) {
+            if (!lws_ice_input(net->ice[1], &pkt.from, pkt.data, pkt.bytes, net->now)) {
+                net->media[1]++;
+            }
+            continue;
+        }
+        if (lws_turn_input(net->turn, &pkt.from, pkt.data, pkt.bytes, net->now,
+                           &peer, &offset, &len) != 2) {
+            continue;
+        }
+        if (net->ice[0] &&
+            lws_ice_relay_input(net->ice[0], &peer, pkt.data + offset, len, net->now)) {
+            continue;
+        }
+        net->client_rx++;
+        net->client_rx_peer = peer;
+        memcpy(net->client_rx_data, pkt.data + offset, len);
+        net->client_rx_bytes = len;
+        net->media[0]++;
+    }
+
+    lws_turn_poll(net->turn, net->now);
+    if (net->ice[0]) {
+        lws_ice_poll(net->ice[0], net->now);
+        lws_ice_poll(net->ice[1], net->now);
+    }
+}
+
+static void net_run(turn_net_t* net, int ms)
+{
+    uint64_t end = net->now + (uint64_t)ms * 1000;
+
+    while (net->now < end) {
+        net_step(net);
+    }
+}
+
+/**
+ * @brief Allocate and install a channel towards B
+ */
+static int net_ready(turn_net_t* net)
+{
+    lws_turn_allocate(net->turn, net->now);
+    net_run(net, 100);
+    if (lws_turn_state(net->turn) != LWS_TURN_READY) {
+        return -1;
+    }
+    lws_turn_permit(net->turn, &net->b_host);
+    net_run(net, 100);
+    return 0;
+}
+
+/* ========================================
+ * ICE over the relay
+ * ======================================== */
+
+/* A：只能经中继发送；B：发往A的私网地址不可达，只能到达中继地址 */
+static int ice_send(void* param, const struct sockaddr_in* to, const uint8_t* data, int bytes)
+{
+    ice_side_t* side = (ice_side_t*)param;
+    turn_net_t* net = side->net;
+
+    if (side->side == 1 && addr_eq(to, &net->relay)) {
+        srv_from_peer(net, &net->b_host, data, bytes);
+    }
+    return 0;
+}
+
+static int ice_relay_send(void* param, const struct sockaddr_in* to, const uint8_t* data, int bytes)
+{
+    ice_side_t* side = (ice_side_t*)param;
+    return lws_turn_send(side->net->turn, to, data, bytes);
+}
+
+static void ice_on_state(void* param, lws_ice_state_t state)
+{
+    ice_side_t* side = (ice_side_t*)param;
+    side->net->state[side->side] = state;
+}
+
+static lws_ice_t* ice_agent(turn_net_t* net, int side)
+{
+    lws_ice_config_t config;
+    lws_ice_handler_t handler;
+    lws_ice_t* ice;
+
+    memset(&config, 0, sizeof(config));
+    config.relay = side == 0;
+    config.aggressive = 1;
+    memset(&handler, 0, sizeof(handler));
+    handler.send = ice_send;
+    handler.relay_send = ice_relay_send;
+    handler.on_state = ice_on_state;
+    net->side[side].net = net;
+    net->side[side].side = side;
+    handler.param = &net->side[side];
+
+    ice = lws_ice_create(&config, &handler);
+    if (!ice) {
+        return NULL;
+    }
+    lws_ice_add_host(ice, side == 0 ? &net->a_host : &net->b_host);
+    lws_ice_gather(ice, net->now);
+    lws_ice_set_local_auth(ice, side == 0 ? "AAAA" : "BBBB",
+                           side == 0 ? "a-password-0123456789ab" : "b-password-0123456789ab");
+    lws_ice_set_remote_auth(ice, side == 0 ? "BBBB" : "AAAA",
+                            side == 0 ? "b-password-0123456789ab" : "a-password-0123456789ab");
+    lws_ice_set_controlling(ice, side == 0);
+    return ice;
+}
+
+/* ========================================
+ * Allocation Tests
+ * ======================================== */
+
+TEST(turn_allocate_auth) {
+    turn_net_t net;
+    struct sockaddr_in relayed;
+
+    net_init(&net, PASSWORD, 0);
+    ASSERT_TRUE(net.turn != NULL);
+    ASSERT_EQ(lws_turn_state(net.turn), LWS_TURN_IDLE);
+    ASSERT_EQ(lws_turn_relayed(net.turn, &relayed), -1);
+
+    ASSERT_EQ(lws_turn_allocate(net.turn, net.now), 0);
+    ASSERT_EQ(lws_turn_state(net.turn), LWS_TURN_ALLOCATING);
+    net_run(&net, 100);
+
+    /* 不带凭据的Allocate被401挑战，带MI重发后成功 */
+    ASSERT_EQ(net.challenges, 1);
+    ASSERT_EQ(net.allocates, 1);
+    ASSERT_EQ(lws_turn_state(net.turn), LWS_TURN_READY);
+    ASSERT_EQ(net.on_allocated, 1);
+    ASSERT_TRUE(addr_eq(&net.cb_relayed, &net.relay));
+    ASSERT_TRUE(addr_eq(&net.cb_mapped, &net.a_nat));
+    ASSERT_EQ(lws_turn_relayed(net.turn, &relayed), 0);
+    ASSERT_TRUE(addr_eq(&relayed, &net.relay));
+    ASSERT_TRUE(net.alloc_expires > net.now + (uint64_t)(LWS_TURN_LIFETIME_S - 1) * 1000000);
+
+    lws_turn_destroy(net.turn);
+}
+
+TEST(turn_bad_password) {
+    turn_net_t net;
+
+    net_init(&net, "wrong-password", 0);
+    lws_turn_allocate(net.turn, net.now);
+    net_run(&net, 100);
+
+    /* 认证后的401即凭据错误，不再重试 */
+    ASSERT_EQ(net.challenges, 2);
+    ASSERT_EQ(net.allocates, 0);
+    ASSERT_EQ(lws_turn_state(net.turn), LWS_TURN_FAILED);
+    ASSERT_EQ(net.failed_code, 401);
+    ASSERT_EQ(net.on_allocated, 0);
+    ASSERT_EQ(lws_turn_permit(net.turn, &net.b_host), -1);
+
+    lws_turn_destroy(net.turn);
+}
+
+TEST(turn_stale_nonce) {
+    turn_net_t net;
+    uint8_t payload[20];
+
+    net_init(&net, PASSWORD, 0);
+    lws_turn_allocate(net.turn, net.now);
+    net_run(&net, 100);
+    ASSERT_EQ(lws_turn_state(net.turn), LWS_TURN_READY);
+
+    /* 服务器轮换nonce：CreatePermission/ChannelBind收到438后用新nonce重发 */
+    net.stale = 1;
+    ASSERT_EQ(lws_turn_permit(net.turn, &net.b_host), 0);
+    net_run(&net, 100);
+    ASSERT_TRUE(net.stale_sent >= 1);
+    ASSERT_EQ(net.permissions, 1);
+    ASSERT_EQ(net.binds, 1);
+    ASSERT_EQ(lws_turn_state(net.turn), LWS_TURN_READY);
+
+    memset(payload, 0xab, sizeof(payload));
+    ASSERT_EQ(lws_turn_send(net.turn, &net.b_host, payload, sizeof(payload)), 0);
+    ASSERT_EQ(net.peer_rx, 1);
+
+    lws_turn_destroy(net.turn);
+}
+
+/* ========================================
+ * Data Tests
+ * ======================================== */
+
+TEST(turn_channel_data) {
+    turn_net_t net;
+    lws_turn_stats_t stats;
+    uint8_t payload[160];
+    int i;
+
+    for (i = 0; i < (int)sizeof(payload); i++) {
+        payload[i] = (uint8_t)i;
+    }
+
+    net_init(&net, PASSWORD, 0);
+    lws_turn_allocate(net.turn, net.now);
+    net_run(&net, 100);
+    ASSERT_EQ(lws_turn_permit(net.turn, &net.b_host), 0);
+
+    /* 通道绑定完成前：Send indication，36字节开销 */
+    ASSERT_EQ(lws_turn_send(net.turn, &net.b_host, payload, sizeof(payload)), 0);
+    ASSERT_EQ(net.send_ind, 1);
+    ASSERT_EQ(net.last_client_bytes, 36 + (int)sizeof(payload));
+    ASSERT_EQ(net.peer_rx, 1);
+    ASSERT_EQ(net.peer_bytes, (int)sizeof(payload));
+    ASSERT_EQ(memcmp(net.peer_data, payload, sizeof(payload)), 0);
+
+    /* 绑定后：ChannelData，4字节头 */
+    net_run(&net, 100);
+    ASSERT_EQ(net.binds, 1);
+    ASSERT_EQ(lws_turn_send(net.turn, &net.b_host, payload, sizeof(payload)), 0);
+    ASSERT_EQ(net.channel_data, 1);
+    ASSERT_EQ(net.last_client_bytes, LWS_TURN_CHANNEL_HEADER + (int)sizeof(payload));
+    ASSERT_EQ(net.peer_rx, 2);
+    ASSERT_EQ(memcmp(net.peer_data, payload, sizeof(payload)), 0);
+
+    /* 对端 -> 中继 -> A：ChannelData解出对端地址与数据 */
+    srv_from_peer(&net, &net.b_host, payload, 33);
+    net_run(&net, 20);
+    ASSERT_EQ(net.client_rx, 1);
+    ASSERT_TRUE(addr_eq(&net.client_rx_peer, &net.b_host));
+    ASSERT_EQ(net.client_rx_bytes, 33);
+    ASSERT_EQ(memcmp(net.client_rx_data, payload, 33), 0);
+
+    /* 未许可的对端被服务器丢弃 */
+    make_addr(&net.client_rx_peer, "198.51.100.99", 7000);
+    srv_from_peer(&net, &net.client_rx_peer, payload, 33);
+    net_run(&net, 20);
+    ASSERT_EQ(net.client_rx, 1);
+
+    lws_turn_get_stats(net.turn, &stats);
+    ASSERT_EQ(stats.send_indications, 1u);
+    ASSERT_EQ(stats.channel_data, 1u);
+
+    lws_turn_destroy(net.turn);
+}
+
+TEST(turn_send_indication_fallback) {
+    turn_net_t net;
+    uint8_t payload[40];
+
+    memset(payload, 0x11, sizeof(payload));
+
+    /* 服务器拒绝ChannelBind：继续用Send/Data indication */
+    net_init(&net, PASSWORD, 0);
+    net.no_channels = 1;
+    ASSERT_EQ(net_ready(&net), 0);
+    ASSERT_EQ(net.permissions, 1);
+    ASSERT_EQ(lws_turn_state(net.turn), LWS_TURN_READY);
+
+    ASSERT_EQ(lws_turn_send(net.turn, &net.b_host, payload, sizeof(payload)), 0);
+    ASSERT_EQ(net.send_ind, 1);
+    ASSERT_EQ(net.channel_data, 0);
+    ASSERT_EQ(net.peer_rx, 1);
+
+    srv_from_peer(&net, &net.b_host, payload, sizeof(payload));
+    net_run(&net, 20);
+    ASSERT_EQ(net.client_rx, 1);
+    ASSERT_TRUE(addr_eq(&net.client_rx_peer, &net.b_host));
+    ASSERT_EQ(net.client_rx_bytes, (int)sizeof(payload));
+
+    lws_turn_destroy(net.turn);
+}
+
+/* ========================================
+ * Lifetime Tests
+ * ======================================== */
+
+TEST(turn_refresh) {
+    turn_net_t net;
+    lws_turn_stats_t stats;
+    uint8_t payload[20];
+
+    memset(payload, 0x22, sizeof(payload));
+
+    /* 20分钟：分配与通道600s、许可300s，都在过期前刷新 */
+    net_init(&net, PASSWORD, 0);
+    ASSERT_EQ(net_ready(&net), 0);
+    net_run(&net, 20 * 60 * 1000);
+
+    ASSERT_EQ(lws_turn_state(net.turn), LWS_TURN_READY);
+    ASSERT_EQ(net.refreshes, 2);            /* 540s, 1080s */
+    ASSERT_TRUE(net.permissions >= 5);      /* 每240s */
+    ASSERT_TRUE(net.binds >= 3);            /* 每540s */
+    ASSERT_EQ(net.allocates, 1);
+
+    /* 许可与通道仍然有效 */
+    ASSERT_EQ(lws_turn_send(net.turn, &net.b_host, payload, sizeof(payload)), 0);
+    ASSERT_EQ(net.channel_data, 1);
+    ASSERT_EQ(net.peer_rx, 1);
+    srv_from_peer(&net, &net.b_host, payload, sizeof(payload));
+    net_run(&net, 20);
+    ASSERT_EQ(net.client_rx, 1);
+
+    lws_turn_get_stats(net.turn, &stats);
+    ASSERT_TRUE(stats.refreshes >= 2u + 4u + 2u);
+
+    lws_turn_destroy(net.turn);
+}
+
+TEST(turn_short_lifetime) {
+    turn_net_t net;
+
+    /* 寿命不足两倍余量时在一半处刷新 */
+    net_init(&net, PASSWORD, 60);
+    lws_turn_allocate(net.turn, net.now);
+    net_run(&net, 100);
+    ASSERT_EQ(lws_turn_state(net.turn), LWS_TURN_READY);
+    net_run(&net, 95 * 1000);
+    ASSERT_EQ(net.refreshes, 3);            /* 30s, 60s, 90s */
+    ASSERT_TRUE(net.allocated && net.alloc_expires > net.now);
+
+    lws_turn_destroy(net.turn);
+}
+
+TEST(turn_destroy_dealloc) {
+    turn_net_t net;
+
+    net_init(&net, PASSWORD, 0);
+    ASSERT_EQ(net_ready(&net), 0);
+    ASSERT_EQ(net.allocated, 1);
+
+    /* LIFETIME 0的Refresh释放分配 */
+    lws_turn_destroy(net.turn);
+    ASSERT_EQ(net.deallocs, 1);
+    ASSERT_EQ(net.allocated, 0);
+}
+
+/* ========================================
+ * ICE Tests
+ * ======================================== */
+
+TEST(turn_ice_relay) {
+    turn_net_t net;
+    const lws_ice_cand_t* locals;
+    lws_ice_cand_t local;
+    struct sockaddr_in remote;
+    lws_turn_stats_t stats;
+    uint8_t media[20] = { 0x80, 0 };
+    int count;
+    int i;
+
+    net_init(&net, PASSWORD, 0);
+    net.ice[0] = ice_agent(&net, 0);
+    net.ice[1] = ice_agent(&net, 1);
+    ASSERT_TRUE(net.ice[0] && net.ice[1]);
+
+    /* 收集等待中继候选 */
+    ASSERT_FALSE(lws_ice_gathering_done(net.ice[0]));
+    lws_turn_allocate(net.turn, net.now);
+    net_run(&net, 100);
+    ASSERT_TRUE(lws_ice_gathering_done(net.ice[0]));
+    count = lws_ice_local_candidates(net.ice[0], &locals);
+    ASSERT_EQ(count, 2);
+    ASSERT_EQ(locals[1].type, LWS_ICE_CAND_RELAY);
+    ASSERT_TRUE(addr_eq(&locals[1].addr, &net.relay));
+    ASSERT_TRUE(addr_eq(&locals[1].base, &net.a_nat));
+
+    /* 交换候选：A的host不可达，A也不能直接发往B */
+    lws_ice_local_candidates(net.ice[1], &locals);
+    lws_ice_add_remote(net.ice[0], &locals[0]);
+    lws_turn_permit(net.turn, &locals[0].addr);
+    lws_ice_local_candidates(net.ice[0], &locals);
+    lws_ice_add_remote(net.ice[1], &locals[0]);
+    lws_ice_add_remote(net.ice[1], &locals[1]);
+    lws_ice_end_of_candidates(net.ice[0]);
+    lws_ice_end_of_candidates(net.ice[1]);
+
+    lws_ice_start(net.ice[0], net.now);
+    lws_ice_start(net.ice[1], net.now);
+    for (i = 0; i < 2000 && (net.state[0] != LWS_ICE_CONNECTED ||
+                             net.state[1] != LWS_ICE_CONNECTED); i++) {
+        net_step(&net);
+    }
+    ASSERT_EQ(net.state[0], LWS_ICE_CONNECTED);
+    ASSERT_EQ(net.state[1], LWS_ICE_CONNECTED);
+    ASSERT_EQ(lws_ice_selected(net.ice[0], &local, &remote), 0);
+    ASSERT_EQ(local.type, LWS_ICE_CAND_RELAY);
+    ASSERT_TRUE(addr_eq(&remote, &net.b_host));
+    ASSERT_EQ(lws_ice_selected(net.ice[1], NULL, &remote), 0);
+    ASSERT_TRUE(addr_eq(&remote, &net.relay));
+
+    /* 媒体双向经中继 */
+    ASSERT_EQ(lws_ice_send(net.ice[0], media, sizeof(media)), 0);
+    ASSERT_EQ(lws_ice_send(net.ice[1], media, sizeof(media)), 0);
+    net_run(&net, 50);
+    ASSERT_EQ(net.media[0], 1);
+    ASSERT_EQ(net.media[1], 1);
+    lws_turn_get_stats(net.turn, &stats);
+    ASSERT_TRUE(stats.channel_data > 0);
+
+    lws_ice_destroy(net.ice[0]);
+    lws_ice_destroy(net.ice[1]);
+    lws_turn_destroy(net.turn);
+}
+
+TEST(turn_ice_relay_failed) {
+    turn_net_t net;
+    const lws_ice_cand_t* locals;
+
+    /* 分配失败：收集不再等待中继候选 */
+    net_init(&net, "wrong-password", 0);
+    net.ice[0] = ice_agent(&net, 0);
+    net.ice[1] = ice_agent(&net, 1);
+    lws_turn_allocate(net.turn, net.now);
+    net_run(&net, 100);
+    ASSERT_EQ(lws_turn_state(net.turn), LWS_TURN_FAILED);
+    ASSERT_FALSE(lws_ice_gathering_done(net.ice[0]));
+    ASSERT_EQ(lws_ice_set_relay(net.ice[0], NULL, NULL, net.now), 0);
+    ASSERT_TRUE(lws_ice_gathering_done(net.ice[0]));
+    ASSERT_EQ(lws_ice_local_candidates(net.ice[0], &locals), 1);
+
+    lws_ice_destroy(net.ice[0]);
+    lws_ice_destroy(net.ice[1]);
+    lws_turn_destroy(net.turn);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_turn Unit Tests\n");
+    printf("==================================================\n\n");
+
+    printf("Allocation Tests:\n");
+    printf("--------------------------------------------------\n");
+    run_test_turn_allocate_auth();
+    run_test_turn_bad_password();
+    run_test_turn_stale_nonce();
+
+    printf("\nData Tests:\n");
+    printf("--------------------------------------------------\n");
+    run_test_turn_channel_data();
+    run_test_turn_send_indication_fallback();
+
+    printf("\nLifetime Tests:\n");
+    printf("--------------------------------------------------\n");
+    run_test_turn_refresh();
+    run_test_turn_short_lifetime();
+    run_test_turn_destroy_dealloc();
+
+    printf("\nICE Tests:\n");
+    printf("--------------------------------------------------\n");
+    run_test_turn_ice_relay();
+    run_test_turn_ice_relay_failed();
+
+    printf("\n==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
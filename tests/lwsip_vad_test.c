@@ -0,0 +1,249 @@
+/**
+ * @file lwsip_vad_test.c
+ * @brief Unit tests for lws_vad.c (VAD and RFC 3389 comfort noise)
+ *
+ * Test coverage:
+ * - Silence and background noise are classified as non-speech
+ * - Speech-like bursts over noise are detected, hangover keeps them active
+ * - CN payload encode/decode round trip
+ * - Generated comfort noise matches the signalled level
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lws_vad.h"
+
+/* ========================================
+ * Test Framework
+ * ======================================== */
+
+static int g_test_passed = 0;
+static int g_test_failed = 0;
+
+#define TEST(name) \
+    static void test_##name(void); \
+    static void run_test_##name(void) { \
+        printf("[ RUN      ] " #name "\n"); \
+        test_##name(); \
+        printf("[       OK ] " #name "\n"); \
+        g_test_passed++; \
+    } \
+    static void test_##name(void)
+
+#define ASSERT_TRUE(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("[  FAILED  ] Assertion failed: %s (line %d)\n", #cond, __LINE__); \
+            g_test_failed++; \
+            return; \
+        } \
+    } while(0)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+#define ASSERT_EQ(a, b) ASSERT_TRUE((a) == (b))
+
+#define FRAME_SAMPLES   160     /* 20ms @ 8kHz */
+
+/* ========================================
+ * Signal helpers
+ * ======================================== */
+
+static uint32_t g_seed = 12345;
+
+static int noise_sample(int amplitude)
+{
+    g_seed = g_seed * 1103515245u + 12345u;
+    return (int)((g_seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+static void make_noise(int16_t* pcm, int amplitude)
+{
+    int i;
+    for (i = 0; i < FRAME_SAMPLES; i++) {
+        pcm[i] = (int16_t)noise_sample(amplitude);
+    }
+}
+
+/* 浊音近似：200Hz基频的脉冲串经过两个共振（周期40个采样点） */
+static void make_voiced(int16_t* pcm, int amplitude, int noise)
+{
+    static const int8_t shape[40] = {
+        0, 90, 100, 60, 0, -50, -70, -40, 0, 30, 45, 25, 0, -20, -28, -15,
+        0, 10, 16, 8, 0, -6, -9, -4, 0, 3, 5, 2, 0, -2, -3, -1,
+        0, 1, 1, 0, 0, 0, 0, 0
+    };
+    int i;
+    for (i = 0; i < FRAME_SAMPLES; i++) {
+        pcm[i] = (int16_t)(shape[i % 40] * amplitude / 100 + noise_sample(noise));
+    }
+}
+
+static double mean_square(const int16_t* pcm, int samples)
+{
+    double acc = 0.0;
+    int i;
+    for (i = 0; i < samples; i++) {
+        acc += (double)pcm[i] * pcm[i];
+    }
+    return acc / samples;
+}
+
+/* ========================================
+ * VAD
+ * ======================================== */
+
+TEST(vad_silence_and_noise)
+{
+    lws_vad_t vad;
+    int16_t pcm[FRAME_SAMPLES];
+    int i;
+
+    lws_vad_init(&vad, 200, 20);
+
+    memset(pcm, 0, sizeof(pcm));
+    for (i = 0; i < 10; i++) {
+        ASSERT_EQ(lws_vad_process(&vad, pcm, FRAME_SAMPLES), 0);
+    }
+
+    /* 稳定的背景噪声在2个跟踪窗口内学习到，之后判为静音 */
+    for (i = 0; i < 120; i++) {
+        make_noise(pcm, 300);
+        lws_vad_process(&vad, pcm, FRAME_SAMPLES);
+    }
+    for (i = 0; i < 20; i++) {
+        make_noise(pcm, 300);
+        ASSERT_EQ(lws_vad_process(&vad, pcm, FRAME_SAMPLES), 0);
+    }
+
+    /* 噪声电平：300幅度的均匀噪声约-44dBov */
+    ASSERT_TRUE(lws_vad_noise(&vad)->level >= 41 && lws_vad_noise(&vad)->level <= 47);
+}
+
+TEST(vad_speech_hangover)
+{
+    lws_vad_t vad;
+    int16_t pcm[FRAME_SAMPLES];
+    int i;
+
+    lws_vad_init(&vad, 200, 20);
+    for (i = 0; i < 50; i++) {
+        make_noise(pcm, 100);
+        lws_vad_process(&vad, pcm, FRAME_SAMPLES);
+    }
+
+    for (i = 0; i < 10; i++) {
+        make_voiced(pcm, 8000, 100);
+        ASSERT_EQ(lws_vad_process(&vad, pcm, FRAME_SAMPLES), 1);
+    }
+
+    /* 语音结束后保持200ms（10帧） */
+    for (i = 0; i < 10; i++) {
+        make_noise(pcm, 100);
+        ASSERT_EQ(lws_vad_process(&vad, pcm, FRAME_SAMPLES), 1);
+    }
+    make_noise(pcm, 100);
+    ASSERT_EQ(lws_vad_process(&vad, pcm, FRAME_SAMPLES), 0);
+
+    /* 低电平浊音（高于噪声约5dB）依靠频谱形状判为语音 */
+    make_voiced(pcm, 900, 100);
+    ASSERT_EQ(lws_vad_process(&vad, pcm, FRAME_SAMPLES), 1);
+}
+
+/* ========================================
+ * Comfort noise
+ * ======================================== */
+
+TEST(cn_payload_roundtrip)
+{
+    lws_cn_params_t in, out;
+    uint8_t buf[16];
+    int i;
+
+    memset(&in, 0, sizeof(in));
+    in.level = 45;
+    in.order = 4;
+    in.k[0] = -0.5f;
+    in.k[1] = 0.25f;
+    in.k[2] = 0.99f;
+    in.k[3] = -1.0f;
+
+    ASSERT_EQ(lws_cn_encode(&in, buf, sizeof(buf)), 5);
+    ASSERT_EQ(buf[0], 45);
+    ASSERT_EQ(buf[1], 63);
+    ASSERT_EQ(buf[2], 159);
+    ASSERT_EQ(buf[4], 0);
+    ASSERT_EQ(lws_cn_encode(&in, buf, 3), -1);
+
+    ASSERT_EQ(lws_cn_decode(&out, buf, 5), 0);
+    ASSERT_EQ(out.level, 45);
+    ASSERT_EQ(out.order, 4);
+    for (i = 0; i < 4; i++) {
+        float d = out.k[i] - in.k[i];
+        ASSERT_TRUE(d < 0.01f && d > -0.01f);
+    }
+
+    /* 仅电平（无频谱信息） */
+    ASSERT_EQ(lws_cn_decode(&out, buf, 1), 0);
+    ASSERT_EQ(out.order, 0);
+    ASSERT_EQ(lws_cn_decode(&out, buf, 0), -1);
+}
+
+TEST(cn_generate_level)
+{
+    lws_cn_params_t params;
+    lws_cn_gen_t gen;
+    int16_t pcm[1600];
+    double power;
+
+    lws_cn_gen_init(&gen, 1);
+    lws_cn_generate(&gen, pcm, 160);
+    ASSERT_EQ(mean_square(pcm, 160), 0.0);
+
+    /* -40dBov：满幅方波功率的1e-4 */
+    memset(&params, 0, sizeof(params));
+    params.level = 40;
+    lws_cn_gen_update(&gen, &params);
+    lws_cn_generate(&gen, pcm, 1600);
+    power = mean_square(pcm, 1600) / (32768.0 * 32768.0);
+    ASSERT_TRUE(power > 0.8e-4 && power < 1.25e-4);
+
+    /* 有频谱形状时电平不变 */
+    params.order = 2;
+    params.k[0] = -0.8f;
+    params.k[1] = 0.3f;
+    lws_cn_gen_update(&gen, &params);
+    lws_cn_generate(&gen, pcm, 1600);
+    lws_cn_generate(&gen, pcm, 1600);
+    power = mean_square(pcm, 1600) / (32768.0 * 32768.0);
+    ASSERT_TRUE(power > 0.6e-4 && power < 1.6e-4);
+}
+
+/* ========================================
+ * Main
+ * ======================================== */
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+
+    printf("==================================================\n");
+    printf("  lws_vad Unit Tests\n");
+    printf("==================================================\n\n");
+
+    run_test_vad_silence_and_noise();
+    run_test_vad_speech_hangover();
+    run_test_cn_payload_roundtrip();
+    run_test_cn_generate_level();
+
+    printf("\n");
+    printf("==================================================\n");
+    printf("  Test Results\n");
+    printf("==================================================\n");
+    printf("Passed: %d\n", g_test_passed);
+    printf("Failed: %d\n", g_test_failed);
+    printf("\n");
+
+    return (g_test_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file msg_bench.c
+ * @brief SIP MESSAGE throughput benchmark against sip_server
+ *
+ * This program:
+ * - Sends N MESSAGE requests through lws_agent_send_message()
+ * - Keeps up to WINDOW transactions in flight (pipelining)
+ * - Reports messages/sec and delivery latency (avg/p50/p99/max)
+ *
+ * Usage:
+ *   ./build/tests/sip_server --quiet
+ *   ./build/tests/msg_bench [count] [window]
+ */
+
+#include "../include/lwsip.h"
+#include "../include/lws_agent.h"
+#include "../osal/include/lws_mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* ========================================
+ * Configuration
+ * ======================================== */
+
+#define SIP_SERVER "127.0.0.1:5060"
+#define USERNAME "1001"
+#define TARGET_URI "sip:1000@127.0.0.1"
+#define DEFAULT_COUNT 10000
+#define DEFAULT_WINDOW 64
+#define TIMEOUT_SEC 60
+
+/* ========================================
+ * Global State
+ * ======================================== */
+
+typedef struct {
+    int completed;
+    int failed;
+    uint32_t* latencies;    /**< 按完成顺序记录的时延（微秒） */
+} bench_ctx_t;
+
+static bench_ctx_t g_ctx = {0};
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static int cmp_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* ========================================
+ * SIP Agent Callbacks
+ * ======================================== */
+
+static void agent_on_message_result(lws_agent_t* agent, uint32_t msg_id,
+                                    int status_code, uint32_t latency_us,
+                                    void* userdata)
+{
+    if (status_code < 200 || status_code >= 300) {
+        g_ctx.failed++;
+    }
+    g_ctx.latencies[g_ctx.completed++] = latency_us;
+
+    (void)agent;
+    (void)msg_id;
+    (void)userdata;
+}
+
+/* ========================================
+ * Main Function
+ * ======================================== */
+
+int main(int argc, char* argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : DEFAULT_COUNT;
+    int window = argc > 2 ? atoi(argv[2]) : DEFAULT_WINDOW;
+    if (count <= 0 || window <= 0) {
+        printf("Usage: %s [count] [window]\n", argv[0]);
+        return 1;
+    }
+
+    printf("========================================\n");
+    printf("SIP MESSAGE Benchmark\n");
+    printf("========================================\n");
+    printf("SIP Server: %s\n", SIP_SERVER);
+    printf("Target: %s\n", TARGET_URI);
+    printf("Messages: %d, window: %d\n", count, window);
+    printf("========================================\n\n");
+    fflush(stdout);
+
+    g_ctx.latencies = (uint32_t*)lws_calloc(count, sizeof(uint32_t));
+    if (!g_ctx.latencies) {
+        printf("ERROR: Out of memory\n");
+        return 1;
+    }
+
+    lws_agent_config_t agent_cfg;
+    lws_agent_init_default_config(&agent_cfg, USERNAME, "", "127.0.0.1", NULL);
+    snprintf(agent_cfg.registrar, sizeof(agent_cfg.registrar), "%s", SIP_SERVER);
+    agent_cfg.auto_register = 0;
+    agent_cfg.media_socket_pool = 0;
+    agent_cfg.message_window = window;
+    snprintf(agent_cfg.user_agent, sizeof(agent_cfg.user_agent), "lwsip-msg-bench/1.0");
+
+    lws_agent_handler_t agent_handler;
+    memset(&agent_handler, 0, sizeof(agent_handler));
+    agent_handler.on_message_result = agent_on_message_result;
+
+    lws_agent_t* agent = lws_agent_create(&agent_cfg, &agent_handler);
+    if (!agent) {
+        printf("ERROR: Failed to create SIP agent\n");
+        lws_free(g_ctx.latencies);
+        return 1;
+    }
+
+    /* 一次性提交：超出窗口的部分由agent排队，随响应逐个发出 */
+    char body[128];
+    uint64_t start = now_us();
+    for (int i = 0; i < count; i++) {
+        int len = snprintf(body, sizeof(body),
+                           "{\"seq\":%d,\"temp\":%d,\"battery\":%d}", i, 20 + i % 10, 90);
+        if (lws_agent_send_message(agent, TARGET_URI, "application/json", body, len) < 0) {
+            printf("ERROR: Failed to submit message %d\n", i);
+            break;
+        }
+    }
+
+    while (g_ctx.completed < count && now_us() - start < (uint64_t)TIMEOUT_SEC * 1000000) {
+        lws_agent_loop(agent, 1);
+    }
+    uint64_t elapsed = now_us() - start;
+
+    printf("Completed: %d/%d (failed: %d)\n", g_ctx.completed, count, g_ctx.failed);
+    if (g_ctx.completed > 0) {
+        uint64_t sum = 0;
+        for (int i = 0; i < g_ctx.completed; i++) {
+            sum += g_ctx.latencies[i];
+        }
+        qsort(g_ctx.latencies, g_ctx.completed, sizeof(uint32_t), cmp_u32);
+
+        printf("Elapsed: %.3f s\n", elapsed / 1e6);
+        printf("Throughput: %.0f msgs/sec\n", g_ctx.completed * 1e6 / (double)elapsed);
+        printf("Latency (us): avg=%llu p50=%u p99=%u max=%u\n",
+               (unsigned long long)(sum / g_ctx.completed),
+               g_ctx.latencies[g_ctx.completed / 2],
+               g_ctx.latencies[(int)(g_ctx.completed * 0.99)],
+               g_ctx.latencies[g_ctx.completed - 1]);
+    }
+
+    lws_agent_destroy(agent);
+    lws_free(g_ctx.latencies);
+
+    return g_ctx.completed == count && g_ctx.failed == 0 ? 0 : 1;
+}
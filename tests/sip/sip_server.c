@@ -7,6 +7,7 @@
  * - INVITE: Route from caller to callee OR simulate UAS scenarios
  * - ACK: Forward acknowledgments
  * - BYE: Terminate calls
+ * - MESSAGE: Answer 200 OK and forward to registered target
  *
  * Supports test scenarios for simulating different UAS behaviors:
  * - normal: Accept call (200 OK)
@@ -22,6 +23,7 @@
  *   sip_fake --scenario=normal  # UAS mode: accept calls
  *   sip_fake --scenario=busy    # UAS mode: busy
  *   sip_fake --scenario=reject  # UAS mode: reject calls
+ *   sip_fake --quiet            # No per-packet logging (benchmarks)
  */
 
 #include <stdio.h>
@@ -57,6 +59,7 @@ typedef enum {
 } test_scenario_t;
 
 static test_scenario_t g_scenario = SCENARIO_NONE;  /**< Current scenario */
+static int g_quiet = 0;                             /**< Suppress per-packet logging */
 
 /* ========================================
  * Registration Table
@@ -950,6 +953,75 @@ static void handle_bye(
     }
 }
 
+/**
+ * @brief Handle MESSAGE request (RFC 3428)
+ *
+ * The server acts as the message endpoint: it answers 200 OK to the sender
+ * and, if the target is registered, forwards a copy (like BYE).
+ */
+static void handle_message(
+    int sock,
+    const char* sip_msg,
+    struct sockaddr_in* client_addr)
+{
+    if (!g_quiet) {
+        printf("[SIP_FAKE] Handling MESSAGE\n");
+    }
+
+    // Extract headers
+    const char* from = extract_from(sip_msg);
+    const char* to = extract_to(sip_msg);
+    const char* call_id = extract_call_id(sip_msg);
+    const char* cseq = extract_cseq(sip_msg);
+    const char* via = extract_via(sip_msg);
+
+    if (!from || !to || !call_id || !cseq || !via) {
+        printf("[SIP_FAKE]   ERROR: Missing required headers\n");
+        return;
+    }
+
+    // Final response needs a To tag
+    char to_tagged[512];
+    if (strstr(to, "tag=")) {
+        snprintf(to_tagged, sizeof(to_tagged), "%s", to);
+    } else {
+        snprintf(to_tagged, sizeof(to_tagged), "%s;tag=sipfake", to);
+    }
+
+    char response[MAX_PACKET_SIZE];
+    int response_len = generate_response(
+        response, sizeof(response),
+        200, "OK",
+        via, from, to_tagged, call_id, cseq, NULL);
+
+    if (sendto(sock, response, response_len, 0,
+               (struct sockaddr*)client_addr, sizeof(*client_addr)) < 0) {
+        printf("[SIP_FAKE]   ERROR: Failed to send response: %s\n", strerror(errno));
+        return;
+    }
+
+    // Forward MESSAGE to registered target
+    char target_username[MAX_USERNAME_LEN];
+    if (extract_username(to, target_username, sizeof(target_username)) == 0) {
+        registration_t* target = find_registration(target_username);
+        if (target) {
+            if (!g_quiet) {
+                printf("[SIP_FAKE]   Forwarding MESSAGE to %s (%s:%u)\n",
+                       target_username, target->ip, target->port);
+            }
+
+            struct sockaddr_in target_addr;
+            memset(&target_addr, 0, sizeof(target_addr));
+            target_addr.sin_family = AF_INET;
+            target_addr.sin_port = htons(target->port);
+            inet_pton(AF_INET, target->ip, &target_addr.sin_addr);
+
+            sendto(sock, sip_msg, strlen(sip_msg), 0,
+                   (struct sockaddr*)&target_addr, sizeof(target_addr));
+        }
+    }
+}
+
 /**
  * @brief Handle SIP response (200 OK, etc.)
  *
@@ -1032,6 +1104,8 @@ static void parse_args(int argc, char* argv[])
                 printf("Valid scenarios: normal, busy, reject, timeout, unavailable\n");
                 exit(1);
             }
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            g_quiet = 1;
         }
     }
 }
@@ -1120,6 +1194,12 @@ int main(int argc, char* argv[])
         inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
         uint16_t client_port = ntohs(client_addr.sin_port);
 
+        // Determine message type and handle (MESSAGE first: benchmark hot path)
+        if (strncmp(buffer, "MESSAGE ", 8) == 0) {
+            handle_message(sock, buffer, &client_addr);
+            continue;
+        }
+
         printf("[SIP_FAKE] Received %zd bytes from %s:%u\n", recv_len, client_ip, client_port);
         fflush(stdout);
 
@@ -1133,7 +1213,6 @@ int main(int argc, char* argv[])
             fflush(stdout);
         }
 
-        // Determine message type and handle
         if (strncmp(buffer, "REGISTER ", 9) == 0) {
             handle_register(sock, buffer, &client_addr);
         } else if (strncmp(buffer, "INVITE ", 7) == 0) {
@@ -12,6 +12,7 @@
 #include "list.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/time.h>
 
 /* ========================================
@@ -45,6 +46,23 @@ typedef struct {
     /* Response queue */
     struct list_head response_queue;          /**< Pending responses */
 
+    /* Responses sent by the agent (UAS side) */
+    struct {
+        int code;
+        char call_id[128];
+    } sent[64];
+    int sent_count;
+
+    /* Requests sent by the agent (UAC side) */
+    char requests[64][16];
+    int request_count;
+
+    /* Dialog of the last initial INVITE, for trans_stub_inject_peer_request() */
+    char dlg_call_id[128];
+    char dlg_local[256];                      /**< Agent's From */
+    char dlg_remote[300];                     /**< Agent's To with the stub tag */
+    int dlg_cseq;
+
     int initialized;                          /**< Init flag */
 } trans_stub_state_t;
 
@@ -499,7 +517,9 @@ static int generate_invite_200_ok(const char* request, int req_len,
         "t=0 0\r\n"
         "m=audio 9000 RTP/AVP 0 8\r\n"
         "a=rtpmap:0 PCMU/8000\r\n"
-        "a=rtpmap:8 PCMA/8000\r\n";
+        "a=rtpmap:8 PCMA/8000\r\n"
+        "a=ice-ufrag:stubpeer\r\n"
+        "a=ice-pwd:stubpeerpassword0123456\r\n";
 
     return snprintf(response, resp_size,
         "SIP/2.0 200 OK\r\n"
@@ -584,6 +604,70 @@ static int generate_invite_603_decline(const char* request, int req_len,
         via, from, to_with_tag, call_id, cseq);
 }
 
+/**
+ * @brief Generate an error response for a re-INVITE/UPDATE (488, 491)
+ */
+static int generate_reoffer_error(const char* request, int req_len, int code,
+                                  const char* reason, char* response, size_t resp_size)
+{
+    char call_id[128], cseq[64], via[256], from[256], to[256];
+
+    extract_call_id(request, req_len, call_id, sizeof(call_id));
+    extract_cseq(request, req_len, cseq, sizeof(cseq));
+    extract_via(request, req_len, via, sizeof(via));
+    extract_from(request, req_len, from, sizeof(from));
+    extract_to(request, req_len, to, sizeof(to));
+
+    return snprintf(response, resp_size,
+        "SIP/2.0 %d %s\r\n"
+        "Via: %s\r\n"
+        "From: %s\r\n"
+        "To: %s\r\n"
+        "Call-ID: %s\r\n"
+        "CSeq: %s\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n",
+        code, reason, via, from, to, call_id, cseq);
+}
+
+/**
+ * @brief Answer a re-INVITE/UPDATE according to the scenario
+ * @return Response length, 0 for no response
+ */
+static int generate_reoffer_response(const char* request, int req_len,
+                                     char* response, size_t resp_size)
+{
+    switch (g_stub_state.scenario) {
+    case TRANS_STUB_SCENARIO_REOFFER_SUCCESS:
+        return generate_invite_200_ok(request, req_len, response, resp_size);
+
+    case TRANS_STUB_SCENARIO_REOFFER_REJECTED:
+        return generate_reoffer_error(request, req_len, 488, "Not Acceptable Here",
+                                      response, resp_size);
+
+    case TRANS_STUB_SCENARIO_REOFFER_GLARE:
+        return generate_reoffer_error(request, req_len, 491, "Request Pending",
+                                      response, resp_size);
+
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Remember the dialog established by an initial INVITE
+ */
+static void remember_dialog(const char* request, int req_len)
+{
+    char to[256];
+
+    extract_call_id(request, req_len, g_stub_state.dlg_call_id, sizeof(g_stub_state.dlg_call_id));
+    extract_from(request, req_len, g_stub_state.dlg_local, sizeof(g_stub_state.dlg_local));
+    extract_to(request, req_len, to, sizeof(to));
+    snprintf(g_stub_state.dlg_remote, sizeof(g_stub_state.dlg_remote), "%s;tag=stub-to-tag", to);
+    g_stub_state.dlg_cseq = 100;
+}
+
 /**
  * @brief Generate 200 OK response for BYE
  */
@@ -636,6 +720,32 @@ static int generate_cancel_200_ok(const char* request, int req_len,
         via, from, to, call_id, cseq);
 }
 
+/**
+ * @brief Generate 200 OK response for MESSAGE
+ */
+static int generate_message_200_ok(const char* request, int req_len,
+                                   char* response, size_t resp_size)
+{
+    char call_id[128], cseq[64], via[256], from[256], to[256];
+
+    extract_call_id(request, req_len, call_id, sizeof(call_id));
+    extract_cseq(request, req_len, cseq, sizeof(cseq));
+    extract_via(request, req_len, via, sizeof(via));
+    extract_from(request, req_len, from, sizeof(from));
+    extract_to(request, req_len, to, sizeof(to));
+
+    return snprintf(response, resp_size,
+        "SIP/2.0 200 OK\r\n"
+        "Via: %s\r\n"
+        "From: %s\r\n"
+        "To: %s;tag=stub-msg\r\n"
+        "Call-ID: %s\r\n"
+        "CSeq: %s\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n",
+        via, from, to, call_id, cseq);
+}
+
 /* ========================================
  * Request Handler
  * ======================================== */
@@ -652,12 +762,30 @@ static int handle_sip_request(const char* data, int len, const lws_addr_t* dest)
     char response[4096];
     int resp_len = 0;
 
+    /* 本端作为UAS发出的响应：只记录 */
+    if (len > 12 && strncmp(data, "SIP/2.0 ", 8) == 0) {
+        if (g_stub_state.sent_count < (int)(sizeof(g_stub_state.sent) / sizeof(g_stub_state.sent[0]))) {
+            int i = g_stub_state.sent_count++;
+            g_stub_state.sent[i].code = atoi(data + 8);
+            if (extract_call_id(data, len, g_stub_state.sent[i].call_id,
+                                sizeof(g_stub_state.sent[i].call_id)) != 0) {
+                g_stub_state.sent[i].call_id[0] = '\0';
+            }
+        }
+        return 0;
+    }
+
     const char* method = parse_sip_method(data, len);
     if (!method) {
         lws_log_error(0, "Failed to parse SIP method\n");
         return -1;
     }
 
+    if (g_stub_state.request_count < (int)(sizeof(g_stub_state.requests) / sizeof(g_stub_state.requests[0]))) {
+        snprintf(g_stub_state.requests[g_stub_state.request_count++],
+                 sizeof(g_stub_state.requests[0]), "%s", method);
+    }
+
     /* Always print for debugging */
     printf("[TRANS_STUB] Received %s request (len=%d), scenario=%d\n", method, len, g_stub_state.scenario);
     lws_log_debug("Stub received %s request, scenario=%d\n", method, g_stub_state.scenario);
@@ -688,6 +816,19 @@ static int handle_sip_request(const char* data, int len, const lws_addr_t* dest)
             return 0; /* No response for SCENARIO_NONE */
         }
     } else if (strcmp(method, "INVITE") == 0) {
+        char to[256];
+
+        /* To带tag：会话中的re-INVITE */
+        if (extract_to(data, len, to, sizeof(to)) == 0 && strstr(to, "tag=")) {
+            resp_len = generate_reoffer_response(data, len, response, sizeof(response));
+            if (resp_len <= 0) {
+                return 0;
+            }
+            return queue_response(response, resp_len, dest);
+        }
+
+        remember_dialog(data, len);
+
         switch (g_stub_state.scenario) {
         case TRANS_STUB_SCENARIO_INVITE_SUCCESS:
             /* Send 180 Ringing first, then 200 OK */
@@ -728,6 +869,17 @@ static int handle_sip_request(const char* data, int len, const lws_addr_t* dest)
         default:
             return 0;
         }
+    } else if (strcmp(method, "MESSAGE") == 0) {
+        switch (g_stub_state.scenario) {
+        case TRANS_STUB_SCENARIO_MESSAGE_SUCCESS:
+            resp_len = generate_message_200_ok(data, len, response, sizeof(response));
+            break;
+
+        default:
+            return 0;
+        }
+    } else if (strcmp(method, "UPDATE") == 0) {
+        resp_len = generate_reoffer_response(data, len, response, sizeof(response));
     } else {
         lws_log_warn(0, "Unhandled SIP method: %s\n", method);
         return 0;
@@ -860,6 +1012,97 @@ int trans_stub_get_response_delay(void)
     return g_stub_state.response_delay_ms;
 }
 
+int trans_stub_inject_request(const char* data, int len)
+{
+    lws_addr_t from;
+
+    if (!g_stub_state.initialized || !data || len <= 0) {
+        return -1;
+    }
+
+    memset(&from, 0, sizeof(from));
+    strcpy(from.ip, "127.0.0.1");
+    from.port = 5070;
+    from.family = 2;  /* AF_INET */
+    return queue_response(data, len, &from);
+}
+
+int trans_stub_count_sent(int code, const char* call_id)
+{
+    int count = 0;
+
+    for (int i = 0; i < g_stub_state.sent_count; i++) {
+        if (g_stub_state.sent[i].code == code &&
+            (!call_id || strcmp(g_stub_state.sent[i].call_id, call_id) == 0)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void trans_stub_clear_sent(void)
+{
+    g_stub_state.sent_count = 0;
+    g_stub_state.request_count = 0;
+}
+
+int trans_stub_count_requests(const char* method)
+{
+    int count = 0;
+
+    for (int i = 0; i < g_stub_state.request_count; i++) {
+        if (method && strcmp(g_stub_state.requests[i], method) == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int trans_stub_inject_peer_request(const char* method, const char* content_type,
+                                   const char* body)
+{
+    char request[2048];
+    char ctype[128] = "";
+    int len;
+    int cseq;
+
+    if (!method || g_stub_state.dlg_call_id[0] == '\0') {
+        return -1;
+    }
+
+    if (body && content_type) {
+        snprintf(ctype, sizeof(ctype), "Content-Type: %s\r\n", content_type);
+    }
+
+    cseq = g_stub_state.dlg_cseq++;
+    len = snprintf(request, sizeof(request),
+        "%s sip:1001@127.0.0.1:5060 SIP/2.0\r\n"
+        "Via: SIP/2.0/UDP 127.0.0.1:5070;branch=z9hG4bK-peer-%d\r\n"
+        "Max-Forwards: 70\r\n"
+        "From: %s\r\n"
+        "To: %s\r\n"
+        "Call-ID: %s\r\n"
+        "CSeq: %d %s\r\n"
+        "Contact: <sip:callee@127.0.0.1:5060>\r\n"
+        "%s"
+        "Content-Length: %d\r\n"
+        "\r\n"
+        "%s",
+        method, cseq, g_stub_state.dlg_remote, g_stub_state.dlg_local,
+        g_stub_state.dlg_call_id, cseq, method, ctype,
+        body ? (int)strlen(body) : 0, body ? body : "");
+    if (len <= 0 || len >= (int)sizeof(request)) {
+        return -1;
+    }
+
+    return trans_stub_inject_request(request, len);
+}
+
+int trans_stub_inject_peer_offer(const char* method, const char* sdp)
+{
+    return trans_stub_inject_peer_request(method, "application/sdp", sdp);
+}
+
 /* ========================================
  * Internal API (called by lwsip_agent_stub.c)
  * ======================================== */
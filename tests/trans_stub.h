@@ -33,6 +33,14 @@ typedef enum {
 
     /* CANCEL scenarios */
     TRANS_STUB_SCENARIO_CANCEL_SUCCESS,     /**< CANCEL → 200 OK */
+
+    /* MESSAGE scenarios */
+    TRANS_STUB_SCENARIO_MESSAGE_SUCCESS,    /**< MESSAGE → 200 OK */
+
+    /* Mid-dialog offer scenarios (re-INVITE / UPDATE) */
+    TRANS_STUB_SCENARIO_REOFFER_SUCCESS,    /**< re-INVITE/UPDATE → 200 OK with SDP answer */
+    TRANS_STUB_SCENARIO_REOFFER_REJECTED,   /**< re-INVITE/UPDATE → 488 Not Acceptable Here */
+    TRANS_STUB_SCENARIO_REOFFER_GLARE,      /**< re-INVITE/UPDATE → 491 Request Pending */
 } trans_stub_scenario_t;
 
 /**
@@ -98,4 +106,57 @@ void trans_stub_set_response_delay(int delay_ms);
  */
 int trans_stub_get_response_delay(void);
 
+/**
+ * @brief Queue an incoming SIP request, delivered like a response
+ *
+ * Lets a test play the remote UAC (e.g. an INVITE to the agent).
+ *
+ * @param data SIP request
+ * @param len Request length
+ * @return 0 on success, -1 on error
+ */
+int trans_stub_inject_request(const char* data, int len);
+
+/**
+ * @brief Count SIP responses sent by the agent
+ * @param code Status code
+ * @param call_id Call-ID to match, NULL for any
+ * @return Number of matching responses since the last trans_stub_clear_sent()
+ */
+int trans_stub_count_sent(int code, const char* call_id);
+
+/**
+ * @brief Forget the responses and requests sent so far
+ */
+void trans_stub_clear_sent(void);
+
+/**
+ * @brief Count SIP requests sent by the agent
+ * @param method Request method, e.g. "INVITE" (re-INVITEs included)
+ * @return Number of matching requests since the last trans_stub_clear_sent()
+ */
+int trans_stub_count_requests(const char* method);
+
+/**
+ * @brief Queue a mid-dialog offer from the remote party
+ *
+ * Uses the dialog of the last initial INVITE sent by the agent
+ * (answered by the INVITE_SUCCESS scenario), so the request matches it.
+ *
+ * @param method "INVITE" or "UPDATE"
+ * @param sdp Offer body, NULL for an offer-less re-INVITE
+ * @return 0 on success, -1 if no dialog is known
+ */
+int trans_stub_inject_peer_offer(const char* method, const char* sdp);
+
+/**
+ * @brief Queue a mid-dialog request from the remote party
+ * @param method Request method, e.g. "INFO"
+ * @param content_type Body type, NULL for no body
+ * @param body Request body, NULL for none
+ * @return 0 on success, -1 if no dialog is known
+ */
+int trans_stub_inject_peer_request(const char* method, const char* content_type,
+                                   const char* body);
+
 #endif /* __TRANS_STUB_H__ */